@@ -119,4 +119,11 @@ tests {
     unittests.file = tests/unittests/unittests.pro
     unittests.depends = libretroshare librssimulator
     unittests.target = unittests
+
+    # the test HTTP server uses POSIX sockets
+    retroshare_plugins:unix {
+        SUBDIRS += feedreader_tests
+        feedreader_tests.file = tests/feedreader/feedreader_tests.pro
+        feedreader_tests.target = feedreader_tests
+    }
 }
@@ -190,7 +190,6 @@ int main(int argc, char *argv[])
 				QMap<QString,MethodParam> paramsMap;
 				QStringList orderedParamNames;
 				bool hasInput = false;
-				bool hasOutput = false;
 				bool hasSingleCallback = false;
 				bool hasMultiCallback = false;
 				QString callbackName;
@@ -246,11 +245,7 @@ int main(int argc, char *argv[])
 						tmpParam.in = true;
 						hasInput = true;
 					}
-					if(tmpD.contains("out"))
-					{
-						tmpParam.out = true;
-						hasOutput = true;
-					}
+					if(tmpD.contains("out")) tmpParam.out = true;
 				}
 
 				// Params sanity check
@@ -265,10 +260,7 @@ int main(int argc, char *argv[])
 
 				QString functionCall("\t\t");
 				if(retvalType != "void")
-				{
 					functionCall += retvalType + " retval = ";
-					hasOutput = true;
-				}
 				functionCall += instanceName + "->" + methodName + "(";
 				functionCall += orderedParamNames.join(", ") + ");\n";
 
@@ -289,14 +281,7 @@ int main(int argc, char *argv[])
 					        "\t\t\tRsGenericSerializer::SerializeJob j(RsGenericSerializer::FROM_JSON);\n";
 				}
 
-				QString outputParamsSerialization;
-				if(hasOutput)
-				{
-					outputParamsSerialization +=
-					        "\t\t{\n"
-					        "\t\t\tRsGenericSerializer::SerializeContext& ctx(cAns);\n"
-					        "\t\t\tRsGenericSerializer::SerializeJob j(RsGenericSerializer::TO_JSON);\n";
-				}
+				QString outputParamsStreaming;
 
 				QString paramsDeclaration;
 				for (const QString& pn : orderedParamNames)
@@ -310,15 +295,14 @@ int main(int argc, char *argv[])
 						inputParamsDeserialization += "\t\t\tRS_SERIAL_PROCESS("
 						        + mp.name + ");\n";
 					if(mp.out)
-						outputParamsSerialization += "\t\t\tRS_SERIAL_PROCESS("
+						outputParamsStreaming += "\t\tRS_JSON_STREAM_PROCESS("
 						        + mp.name + ");\n";
 				}
 
 				if(hasInput) inputParamsDeserialization += "\t\t}\n";
 				if(retvalType != "void")
-					outputParamsSerialization +=
-					        "\t\t\tRS_SERIAL_PROCESS(retval);\n";
-				if(hasOutput) outputParamsSerialization += "\t\t}\n";
+					outputParamsStreaming +=
+					        "\t\tRS_JSON_STREAM_PROCESS(retval);\n";
 
 				QString captureVars;
 
@@ -375,7 +359,7 @@ int main(int argc, char *argv[])
 				QMap<QString,QString> substitutionsMap;
 				substitutionsMap.insert("paramsDeclaration", paramsDeclaration);
 				substitutionsMap.insert("inputParamsDeserialization", inputParamsDeserialization);
-				substitutionsMap.insert("outputParamsSerialization", outputParamsSerialization);
+				substitutionsMap.insert("outputParamsStreaming", outputParamsStreaming);
 				substitutionsMap.insert("instanceName", instanceName);
 				substitutionsMap.insert("functionCall", functionCall);
 				substitutionsMap.insert("apiPath", apiPath);
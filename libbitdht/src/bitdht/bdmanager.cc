@@ -1278,7 +1278,11 @@ int     bdNodeManager::isBitDhtPacket(char *data, int size, struct sockaddr_in &
 
 	/* try to parse it! */
         /* convert to a be_node */
-        be_node *node = be_decoden(data, size);
+	char arena_mem[BITDHT_MSG_ARENA_SIZE];
+	be_arena arena;
+	be_arena_init(&arena, arena_mem, sizeof(arena_mem));
+
+        be_node *node = be_decoden_arena(&arena, data, size);
         if (!node)
         {
                 /* invalid decode */
@@ -1312,13 +1316,14 @@ int     bdNodeManager::isBitDhtPacket(char *data, int size, struct sockaddr_in &
 		std::cerr << "bdNodeManager::BadPacket ******************************";
 		std::cerr << std::endl;
 #endif
+		be_arena_release(&arena);
 		return 0;
 	}
 
         /* find message type */
         uint32_t beType = beMsgType(node);	
 	int ans = (beType != BITDHT_MSG_TYPE_UNKNOWN);
-	be_free(node);
+	be_arena_release(&arena);
 
 #ifdef DEBUG_MGR_PKT
 	if (ans)
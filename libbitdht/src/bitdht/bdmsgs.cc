@@ -468,10 +468,13 @@ be_node *beMsgGetDictNode(be_node *node, const char *key)
 	}
 
 	/* get dictionary entry 'y' */
+	/* keys are not '\0' terminated when decoded into an arena */
+	long long keylen = strlen(key);
 	int i;
 	for(i = 0; node->val.d[i].val; i++)
 	{
-		if (0 == strcmp(key, node->val.d[i].key))
+		if ((keylen == node->val.d[i].key_len) &&
+			(0 == memcmp(key, node->val.d[i].key, keylen)))
 		{
 			return node->val.d[i].val;
 		}
@@ -509,7 +512,7 @@ uint32_t beMsgGetY(be_node *n)
 	if(val == NULL)
 		return BE_Y_UNKNOWN ;
 
-	if (val->type != BE_STR)	
+	if ((val->type != BE_STR) || (be_str_len(val) < 1))
 	{
 		return BE_Y_UNKNOWN;
 	}
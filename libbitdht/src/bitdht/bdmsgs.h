@@ -57,6 +57,11 @@
 #define BITDHT_COMPACTNODEID_LEN 	26
 #define BITDHT_COMPACTPEERID_LEN 	6
 
+/* stack memory used to decode an incoming packet, see be_decoden_arena().
+ * Bigger trees spill into heap blocks.
+ */
+#define BITDHT_MSG_ARENA_SIZE		4096
+
 #define BE_Y_UNKNOWN    0
 #define BE_Y_R          1
 #define BE_Y_Q          2
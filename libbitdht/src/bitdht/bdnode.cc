@@ -1184,8 +1184,14 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 	std::cerr << std::endl;
 #endif
 
-	/* convert to a be_node */
-	be_node *node = be_decoden(msg, len);
+	/* convert to a be_node. The tree is built in a per-packet arena,
+	 * and its strings point into msg.
+	 */
+	char arena_mem[BITDHT_MSG_ARENA_SIZE];
+	be_arena arena;
+	be_arena_init(&arena, arena_mem, sizeof(arena_mem));
+
+	be_node *node = be_decoden_arena(&arena, msg, len);
 	if (!node)
 	{
 		/* invalid decode */
@@ -1208,6 +1214,7 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 		}
 		std::cerr << std::endl;
 #endif
+		be_arena_release(&arena);
 		return;
 	}
 
@@ -1222,7 +1229,7 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 		std::cerr << std::endl;
 #endif
 		/* invalid message */
-		be_free(node);
+		be_arena_release(&arena);
 		return;
 	}
 
@@ -1239,7 +1246,7 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 		std::cerr << "bdNode::recvPkt() TransId Failure. Dropping Msg";
 		std::cerr << std::endl;
 #endif
-		be_free(node);
+		be_arena_release(&arena);
 		return;
 	}
 
@@ -1259,7 +1266,7 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 		std::cerr << "bdNode::recvPkt() Missing Data Body. Dropping Msg";
 		std::cerr << std::endl;
 #endif
-		be_free(node);
+		be_arena_release(&arena);
 		return;
 	}
 
@@ -1272,7 +1279,7 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 		std::cerr << "bdNode::recvPkt() Missing Peer Id. Dropping Msg";
 		std::cerr << std::endl;
 #endif
-		be_free(node);
+		be_arena_release(&arena);
 		return;
 	}
 
@@ -1320,7 +1327,7 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 			std::cerr << "bdNode::recvPkt() Missing Target / Info_Hash. Dropping Msg";
 			std::cerr << std::endl;
 #endif
-			be_free(node);
+			be_arena_release(&arena);
 			return;
 		}
 
@@ -1335,7 +1342,7 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 			std::cerr << "bdNode::recvPkt() Missing Target / Info_Hash. Dropping Msg";
 			std::cerr << std::endl;
 #endif
-			be_free(node);
+			be_arena_release(&arena);
 			return;
 		}
 	}
@@ -1358,7 +1365,7 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 			std::cerr << "bdNode::recvPkt() Missing Nodes. Dropping Msg";
 			std::cerr << std::endl;
 #endif
-			be_free(node);
+			be_arena_release(&arena);
 			return;
 		}
 	}
@@ -1380,7 +1387,7 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 			std::cerr << "bdNode::recvPkt() Missing Values. Dropping Msg";
 			std::cerr << std::endl;
 #endif
-			be_free(node);
+			be_arena_release(&arena);
 			return;
 		}
 	}
@@ -1404,7 +1411,7 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 			std::cerr << "bdNode::recvPkt() Missing Token. Dropping Msg";
 			std::cerr << std::endl;
 #endif
-			be_free(node);
+			be_arena_release(&arena);
 			return;
 		}
 	}
@@ -1426,7 +1433,7 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 			std::cerr << "bdNode::recvPkt() POST_HASH Missing Port. Dropping Msg";
 			std::cerr << std::endl;
 #endif
-			be_free(node);
+			be_arena_release(&arena);
 			return;
 		}
 	}
@@ -1460,7 +1467,7 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 			std::cerr << "bdNode::recvPkt() CONNECT Missing SrcAddr. Dropping Msg";
 			std::cerr << std::endl;
 #endif
-			be_free(node);
+			be_arena_release(&arena);
 			return;
 		}
 
@@ -1472,7 +1479,7 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 			std::cerr << "bdNode::recvPkt() CONNECT Missing DestAddr. Dropping Msg";
 			std::cerr << std::endl;
 #endif
-			be_free(node);
+			be_arena_release(&arena);
 			return;
 		}
 
@@ -1484,7 +1491,7 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 			std::cerr << "bdNode::recvPkt() CONNECT Missing Mode. Dropping Msg";
 			std::cerr << std::endl;
 #endif
-			be_free(node);
+			be_arena_release(&arena);
 			return;
 		}
 
@@ -1496,7 +1503,7 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 			std::cerr << "bdNode::recvPkt() CONNECT Missing Param. Dropping Msg";
 			std::cerr << std::endl;
 #endif
-			be_free(node);
+			be_arena_release(&arena);
 			return;
 		}
 
@@ -1508,7 +1515,7 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 			std::cerr << "bdNode::recvPkt() CONNECT Missing Status. Dropping Msg";
 			std::cerr << std::endl;
 #endif
-			be_free(node);
+			be_arena_release(&arena);
 			return;
 		}
 
@@ -1520,7 +1527,7 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 			std::cerr << "bdNode::recvPkt() CONNECT Missing Type. Dropping Msg";
 			std::cerr << std::endl;
 #endif
-			be_free(node);
+			be_arena_release(&arena);
 			return;
 		}
 	}
@@ -1707,7 +1714,7 @@ void    bdNode::recvPkt(char *msg, int len, struct sockaddr_in addr)
 		}
 	}
 
-	be_free(node);
+	be_arena_release(&arena);
 	return;
 }
 
@@ -68,10 +68,16 @@ static long long _be_decode_int(const char **data, long long *data_len)
 }
 
 long long be_str_len(be_node *node)
+{
+	return node->len;
+}
+
+/* length of a string allocated by _be_decode_str() */
+static long long _be_alloc_str_len(const char *str)
 {
 	long long ret = 0;
-	if (node->val.s)
-		memcpy(&ret, node->val.s - sizeof(ret), sizeof(ret));
+	if (str)
+		memcpy(&ret, str - sizeof(ret), sizeof(ret));
 	return ret;
 }
 
@@ -224,6 +230,7 @@ static be_node *_be_decode(const char **data, long long *data_len)
 #endif
 				ret->val.d = (be_dict *) realloc(ret->val.d, (i + 2) * sizeof(*ret->val.d));
 				ret->val.d[i].key = _be_decode_str(data, data_len);
+				ret->val.d[i].key_len = _be_alloc_str_len(ret->val.d[i].key);
 #ifdef BE_DEBUG_DECODE 
 			fprintf(stderr, "bencode::_be_decode() dictionary get val\n");
 #endif
@@ -289,6 +296,7 @@ static be_node *_be_decode(const char **data, long long *data_len)
 #endif
 
 			ret->val.s = _be_decode_str(data, data_len);
+			ret->len = _be_alloc_str_len(ret->val.s);
 
 			return ret;
 		}
@@ -315,6 +323,264 @@ be_node *be_decode(const char *data)
 	return be_decoden(data, strlen(data));
 }
 
+/******************** Arena decoding *************
+ * Incoming packets are decoded into a per-packet arena: no malloc per
+ * node, no string copies, no realloc of lists. Unlike _be_decode(), the
+ * input is never read past data_len, so it doesn't need '\0' termination.
+ */
+
+#define BE_ARENA_ALIGN		8
+#define BE_ARENA_BLOCK_SIZE	4096
+#define BE_ARENA_MAX_DEPTH	64	/* deeper trees are not valid DHT messages */
+
+typedef struct be_arena_block {
+	struct be_arena_block *next;
+	long long align; /* keeps the memory following the header aligned */
+} be_arena_block;
+
+/* list and dictionary items, gathered before their final array is allocated */
+typedef struct be_arena_item {
+	char *key;
+	long long key_len;
+	be_node *node;
+	struct be_arena_item *next;
+} be_arena_item;
+
+void be_arena_init(be_arena *arena, void *mem, unsigned long size)
+{
+	unsigned long pad = (BE_ARENA_ALIGN - ((unsigned long) mem % BE_ARENA_ALIGN)) % BE_ARENA_ALIGN;
+
+	if ((mem == NULL) || (size < pad))
+	{
+		mem = NULL;
+		size = 0;
+		pad = 0;
+	}
+
+	arena->init_mem = (char *) mem + pad;
+	arena->init_size = size - pad;
+	arena->mem = arena->init_mem;
+	arena->size = arena->init_size;
+	arena->used = 0;
+	arena->blocks = NULL;
+}
+
+void be_arena_release(be_arena *arena)
+{
+	while (arena->blocks)
+	{
+		be_arena_block *next = arena->blocks->next;
+		free(arena->blocks);
+		arena->blocks = next;
+	}
+
+	arena->mem = arena->init_mem;
+	arena->size = arena->init_size;
+	arena->used = 0;
+}
+
+static void *be_arena_alloc(be_arena *arena, unsigned long size)
+{
+	size = (size + BE_ARENA_ALIGN - 1) & ~((unsigned long) BE_ARENA_ALIGN - 1);
+
+	if (arena->used + size > arena->size)
+	{
+		unsigned long bsize = (size > BE_ARENA_BLOCK_SIZE) ? size : BE_ARENA_BLOCK_SIZE;
+		be_arena_block *block = (be_arena_block *) malloc(sizeof(be_arena_block) + bsize);
+
+		if (block == NULL)
+		{
+			fprintf(stderr, "(EE) bencode::be_arena_alloc(): "
+			                "ERROR. cannot allocate memory for %lu bytes.\n", bsize);
+			return NULL;
+		}
+
+		block->next = arena->blocks;
+		arena->blocks = block;
+		arena->mem = (char *) (block + 1);
+		arena->size = bsize;
+		arena->used = 0;
+	}
+
+	void *ret = arena->mem + arena->used;
+	arena->used += size;
+	return ret;
+}
+
+static be_node *be_arena_node(be_arena *arena, be_type type)
+{
+	be_node *ret = (be_node *) be_arena_alloc(arena, sizeof(*ret));
+	if (ret) {
+		memset(ret, 0x00, sizeof(*ret));
+		ret->type = type;
+	}
+	return ret;
+}
+
+/* parses [-]digits up to the terminating char, which is consumed */
+static int _be_arena_int(const char **data, long long *data_len, char term, long long *val)
+{
+	const char *p = *data;
+	const char *end = *data + *data_len;
+	int neg = 0;
+	int ndigits = 0;
+	long long ret = 0;
+
+	if ((p < end) && (*p == '-'))
+	{
+		neg = 1;
+		++p;
+	}
+
+	for(; (p < end) && (*p >= '0') && (*p <= '9'); ++p)
+	{
+		if (++ndigits > 18) /* would overflow */
+			return 0;
+		ret = ret * 10 + (*p - '0');
+	}
+
+	if ((ndigits == 0) || (p >= end) || (*p != term))
+		return 0;
+
+	++p;
+	*data_len -= p - *data;
+	*data = p;
+	*val = neg ? -ret : ret;
+	return 1;
+}
+
+static int _be_arena_str(const char **data, long long *data_len, char **str, long long *len)
+{
+	long long slen;
+
+	if (!_be_arena_int(data, data_len, ':', &slen) || (slen < 0) || (slen > *data_len))
+		return 0;
+
+	*str = (char *) *data;
+	*len = slen;
+	*data += slen;
+	*data_len -= slen;
+	return 1;
+}
+
+static be_node *_be_decode_arena(be_arena *arena, const char **data, long long *data_len, int depth)
+{
+	be_node *ret = NULL;
+
+	if ((*data_len <= 0) || (depth > BE_ARENA_MAX_DEPTH))
+		return NULL;
+
+	switch (**data) {
+		/* lists and dictionaries */
+		case 'l':
+		case 'd': {
+			int is_dict = (**data == 'd');
+			be_arena_item *first = NULL;
+			be_arena_item **last = &first;
+			unsigned int n = 0;
+			unsigned int i;
+
+			ret = be_arena_node(arena, is_dict ? BE_DICT : BE_LIST);
+			if (ret == NULL)
+				return NULL;
+
+			--(*data_len);
+			++(*data);
+			while ((*data_len > 0) && (**data != 'e'))
+			{
+				be_arena_item *item = (be_arena_item *) be_arena_alloc(arena, sizeof(*item));
+				if (item == NULL)
+					return NULL;
+
+				item->key = NULL;
+				item->key_len = 0;
+				item->next = NULL;
+
+				if (is_dict && !_be_arena_str(data, data_len, &item->key, &item->key_len))
+					return NULL;
+
+				item->node = _be_decode_arena(arena, data, data_len, depth + 1);
+				if (item->node == NULL)
+					return NULL;
+
+				*last = item;
+				last = &item->next;
+				++n;
+			}
+
+			if (*data_len <= 0) /* missing 'e' */
+				return NULL;
+
+			--(*data_len);
+			++(*data);
+
+			/* both arrays are terminated by a NULL node */
+			if (is_dict)
+			{
+				ret->val.d = (be_dict *) be_arena_alloc(arena, (n + 1) * sizeof(*ret->val.d));
+				if (ret->val.d == NULL)
+					return NULL;
+
+				for(i = 0; first; first = first->next, ++i)
+				{
+					ret->val.d[i].key = first->key;
+					ret->val.d[i].key_len = first->key_len;
+					ret->val.d[i].val = first->node;
+				}
+				ret->val.d[n].key = NULL;
+				ret->val.d[n].key_len = 0;
+				ret->val.d[n].val = NULL;
+			}
+			else
+			{
+				ret->val.l = (be_node **) be_arena_alloc(arena, (n + 1) * sizeof(*ret->val.l));
+				if (ret->val.l == NULL)
+					return NULL;
+
+				for(i = 0; first; first = first->next, ++i)
+					ret->val.l[i] = first->node;
+				ret->val.l[n] = NULL;
+			}
+			return ret;
+		}
+
+		/* integers */
+		case 'i': {
+			ret = be_arena_node(arena, BE_INT);
+			if (ret == NULL)
+				return NULL;
+
+			--(*data_len);
+			++(*data);
+			if (!_be_arena_int(data, data_len, 'e', &ret->val.i))
+				return NULL;
+
+			return ret;
+		}
+
+		/* byte strings */
+		case '0'...'9': {
+			ret = be_arena_node(arena, BE_STR);
+			if (ret == NULL)
+				return NULL;
+
+			if (!_be_arena_str(data, data_len, &ret->val.s, &ret->len))
+				return NULL;
+
+			return ret;
+		}
+
+		/* invalid */
+		default:
+			return NULL;
+	}
+}
+
+be_node *be_decoden_arena(be_arena *arena, const char *data, long long len)
+{
+	return _be_decode_arena(arena, &data, &len, 0);
+}
+
 static inline void _be_free_str(char *str)
 {
 	if (str)
@@ -392,7 +658,7 @@ static void _be_dump(be_node *node, ssize_t indent)
 
 			for (i = 0; node->val.d[i].val; ++i) {
 				_be_dump_indent(indent + 1);
-				printf("%s => ", node->val.d[i].key);
+				printf("%.*s => ", (int) node->val.d[i].key_len, node->val.d[i].key);
 				_be_dump(node->val.d[i].val, -(indent + 1));
 			}
 
@@ -480,11 +746,12 @@ int be_encode(be_node *node, char *str, int len)
 
 			for (i = 0; node->val.d[i].val; ++i) {
 				
-				/* assumption that key must be ascii! */
-				snprintf(&(str[loc]), len-loc, "%i:%s", 
-						(int) strlen(node->val.d[i].key),
-						node->val.d[i].key);
+				snprintf(&(str[loc]), len-loc, "%i:",
+						(int) node->val.d[i].key_len);
 				loc += strlen(&(str[loc]));
+
+				memcpy(&(str[loc]), node->val.d[i].key, node->val.d[i].key_len);
+				loc += node->val.d[i].key_len;
 				loc += be_encode(node->val.d[i].val, &(str[loc]), len-loc);
 			}
 
@@ -534,6 +801,7 @@ be_node *be_create_str(const char *str)
 	ret[len] = '\0';
 
 	n->val.s = ret;
+	n->len = len;
 	
 	return n;
 }
@@ -561,6 +829,7 @@ be_node *be_create_str_wlen(const char *str, int len) /* not including \0 */
 	ret[len] = '\0';
 
 	n->val.s = ret;
+	n->len = len;
 	
 	return n;
 }
@@ -613,6 +882,7 @@ int be_add_keypair(be_node *dict, const char *str, be_node *node)
 	ret[len] = '\0';
 
         dict->val.d[i].key = ret;
+        dict->val.d[i].key_len = len;
         dict->val.d[i].val = node;
 	i++;
         dict->val.d[i].val = NULL;
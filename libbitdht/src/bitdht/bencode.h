@@ -27,6 +27,14 @@
  *  - pass the string full of the bencoded data to be_decode()
  *  - parse the resulting tree however you like
  *  - call be_free() on the tree to release resources
+ *
+ * ARENA USAGE (incoming packets):
+ *  - init a be_arena, optionally on a stack buffer, with be_arena_init()
+ *  - pass it with the data to be_decoden_arena(). Nodes are carved out of
+ *    the arena, and strings point directly into the decoded data: they are
+ *    NOT '\0' terminated, always use be_str_len() / key_len.
+ *  - the data must outlive the tree.
+ *  - call be_arena_release() (never be_free()) to release resources.
  */
 
 #ifdef __cplusplus
@@ -49,11 +57,13 @@ struct be_node;
 
 typedef struct be_dict {
 	char *key;
+	long long key_len;
 	struct be_node *val;
 } be_dict;
 
 typedef struct be_node {
 	be_type type;
+	long long len; /* length of val.s, for BE_STR */
 	union {
 		char *s;
 		long long i;
@@ -62,6 +72,17 @@ typedef struct be_node {
 	} val;
 } be_node;
 
+struct be_arena_block;
+
+typedef struct be_arena {
+	char *mem;
+	unsigned long size;
+	unsigned long used;
+	char *init_mem;
+	unsigned long init_size;
+	struct be_arena_block *blocks;
+} be_arena;
+
 extern long long be_str_len(be_node *node);
 // This function uses strlen, so is unreliable.
 //extern be_node *be_decode(const char *bencode);
@@ -70,6 +91,11 @@ extern void be_free(be_node *node);
 extern void be_dump(be_node *node);
 extern void be_dump_str(be_node *node);
 
+/* Arena decoding */
+extern void be_arena_init(be_arena *arena, void *mem, unsigned long size);
+extern void be_arena_release(be_arena *arena);
+extern be_node *be_decoden_arena(be_arena *arena, const char *bencode, long long bencode_len);
+
 // New Functions for the other half of the work - encoding */
 
 extern int be_encode(be_node *node, char *str, int len);
@@ -28,14 +28,35 @@
 #include "bitdht/bdmsgs.h"
 #include "bitdht/bdstddht.h"
 #include <string.h>
+#include <time.h>
+#include <vector>
+#include <string>
 
 /*******************************************************************
  * Test of bencode message creation functions in bdmsgs.cc
  *
- * Create a couple of each type.
+ * Create a couple of each type, check that they decode the same with
+ * be_decoden() and be_decoden_arena(), and measure how many packets/s
+ * each decoder can parse.
  */
 
 #define MAX_MESSAGE_LEN	10240
+#define BENCH_ROUNDS	100000
+
+/* what bdNode::recvPkt() looks at first */
+static int parse_msg(be_node *node)
+{
+	int ok = (beMsgType(node) != BITDHT_MSG_TYPE_UNKNOWN);
+
+	be_node *data = beMsgGetDictNode(node, "a");
+	if (!data)
+		data = beMsgGetDictNode(node, "r");
+
+	bdNodeId id;
+	ok &= (data != NULL) && (beMsgGetDictNode(node, "t") != NULL);
+	ok &= (data != NULL) && beMsgGetNodeId(beMsgGetDictNode(data, "id"), id);
+	return ok;
+}
 
 int main(int argc, char **argv)
 {
@@ -82,21 +103,96 @@ int main(int argc, char **argv)
 
         uint32_t port = 1234;
 
-	bitdht_create_ping_msg(&tid, &ownId, msg, avail);
-	bitdht_response_ping_msg(&tid, &ownId, &vid, msg, avail);
-
-	bitdht_find_node_msg(&tid, &ownId, &target, msg, avail);
-	bitdht_resp_node_msg(&tid, &ownId, nodes, msg, avail);
+	std::vector<std::string> msgs;
+	int len;
+
+	len = bitdht_create_ping_msg(&tid, &ownId, &vid, msg, avail);
+	msgs.push_back(std::string(msg, len));
+	len = bitdht_response_ping_msg(&tid, &ownId, &vid, msg, avail);
+	msgs.push_back(std::string(msg, len));
+
+	len = bitdht_find_node_msg(&tid, &ownId, &target, false, msg, avail);
+	msgs.push_back(std::string(msg, len));
+	len = bitdht_resp_node_msg(&tid, &ownId, nodes, msg, avail);
+	msgs.push_back(std::string(msg, len));
+
+	len = bitdht_get_peers_msg(&tid, &ownId, &info_hash, msg, avail);
+	msgs.push_back(std::string(msg, len));
+	len = bitdht_peers_reply_hash_msg(&tid, &ownId, &token, values, msg, avail);
+	msgs.push_back(std::string(msg, len));
+	len = bitdht_peers_reply_closest_msg(&tid, &ownId, &token, nodes, msg, avail);
+	msgs.push_back(std::string(msg, len));
+
+	len = bitdht_announce_peers_msg(&tid, &ownId, &info_hash, port, &token, msg, avail);
+	msgs.push_back(std::string(msg, len));
+	len = bitdht_reply_announce_msg(&tid, &ownId, msg, avail);
+	msgs.push_back(std::string(msg, len));
+
+	/***** check both decoders agree *****/
+	int failures = 0;
+	for(unsigned int i = 0; i < msgs.size(); i++)
+	{
+		char arena_mem[BITDHT_MSG_ARENA_SIZE];
+		be_arena arena;
+		be_arena_init(&arena, arena_mem, sizeof(arena_mem));
+
+		be_node *n1 = be_decoden(msgs[i].c_str(), msgs[i].length());
+		be_node *n2 = be_decoden_arena(&arena, msgs[i].c_str(), msgs[i].length());
+
+		if (!n1 || !n2 || !parse_msg(n1) || !parse_msg(n2) || (beMsgType(n1) != beMsgType(n2)))
+		{
+			fprintf(stderr, "message %d: decoders disagree\n", i);
+			failures++;
+		}
+		else
+		{
+			/* re-encoding the arena tree must give back the packet */
+			char out[MAX_MESSAGE_LEN];
+			int olen = be_encode(n2, out, MAX_MESSAGE_LEN);
+			if ((olen != (int) msgs[i].length()) || memcmp(out, msgs[i].c_str(), olen))
+			{
+				fprintf(stderr, "message %d: arena tree does not re-encode\n", i);
+				failures++;
+			}
+		}
+
+		if (n1)
+			be_free(n1);
+		be_arena_release(&arena);
+	}
 
-	bitdht_get_peers_msg(&tid, &ownId, &info_hash, msg, avail);
-	bitdht_peers_reply_hash_msg(&tid, &ownId, &token, values, msg, avail);
-	bitdht_peers_reply_closest_msg(&tid, &ownId, &token, nodes, msg, avail);
+	/***** benchmark *****/
+	clock_t start = clock();
+	for(int r = 0; r < BENCH_ROUNDS; r++)
+	{
+		for(unsigned int i = 0; i < msgs.size(); i++)
+		{
+			be_node *n = be_decoden(msgs[i].c_str(), msgs[i].length());
+			parse_msg(n);
+			be_free(n);
+		}
+	}
+	double t_malloc = (double) (clock() - start) / CLOCKS_PER_SEC;
 
-	bitdht_announce_peers_msg(&tid, &ownId, &info_hash, port, &token, msg, avail);
-	bitdht_reply_announce_msg(&tid, &ownId, msg, avail);
+	start = clock();
+	for(int r = 0; r < BENCH_ROUNDS; r++)
+	{
+		for(unsigned int i = 0; i < msgs.size(); i++)
+		{
+			char arena_mem[BITDHT_MSG_ARENA_SIZE];
+			be_arena arena;
+			be_arena_init(&arena, arena_mem, sizeof(arena_mem));
+
+			be_node *n = be_decoden_arena(&arena, msgs[i].c_str(), msgs[i].length());
+			parse_msg(n);
+			be_arena_release(&arena);
+		}
+	}
+	double t_arena = (double) (clock() - start) / CLOCKS_PER_SEC;
 
+	double npkts = (double) BENCH_ROUNDS * msgs.size();
+	fprintf(stderr, "be_decoden():       %.0f packets/s\n", npkts / (t_malloc > 0 ? t_malloc : 1e-9));
+	fprintf(stderr, "be_decoden_arena(): %.0f packets/s\n", npkts / (t_arena > 0 ? t_arena : 1e-9));
 
-	return 1;
+	return failures;
 }
-
-
@@ -26,6 +26,33 @@
 
 #include "bitdht/bencode.h"
 #include <stdio.h>
+#include <string.h>
+
+/* The arena decoder must survive the same bad packets, and never read past len */
+static void check_arena(const char *msg, int len)
+{
+	char arena_mem[1024];
+	be_arena arena;
+	be_arena_init(&arena, arena_mem, sizeof(arena_mem));
+
+	/* copy to an exact size buffer, so that overreads show up in valgrind */
+	char *copy = new char[len];
+	memcpy(copy, msg, len);
+
+	be_node *n = be_decoden_arena(&arena, copy, len);
+
+	if (n)
+	{
+		be_dump(n);
+	}
+	else
+	{
+		fprintf(stderr, "arena didn't crash!\n");
+	}
+
+	be_arena_release(&arena);
+	delete[] copy;
+}
 
 int main(int argc, char **argv)
 {
@@ -56,6 +83,7 @@ int main(int argc, char **argv)
 	msg[21] = '#';
 
 	be_node *n = be_decoden(msg, 16);
+	check_arena(msg, 16);
 
 	if (n)
 	{
@@ -91,6 +119,7 @@ int main(int argc, char **argv)
 	msg[21] = '#';
 
 	n = be_decoden(msg, 14);
+	check_arena(msg, 14);
 
 	if (n)
 	{
@@ -165,6 +194,7 @@ int main(int argc, char **argv)
 	msg[60] = '\0';
 
 	n = be_decoden(msg, 58);
+	check_arena(msg, 58);
 
 	if (n)
 	{
@@ -176,6 +206,18 @@ int main(int argc, char **argv)
 		fprintf(stderr, "didn't crash!\n");
 	}
 
+	/* truncated, unterminated and too deep trees, arena only */
+	const char *bad[] = { "d1:t", "l", "li12", "i-e", "4:ab", "d1:ti1ee1", NULL };
+	for(int i = 0; bad[i]; i++)
+	{
+		check_arena(bad[i], strlen(bad[i]));
+	}
+
+	char deep[200];
+	memset(deep, 'l', 100);
+	memset(&deep[100], 'e', 100);
+	check_arena(deep, 200);
+
 	return 1;
 }
 
@@ -24,6 +24,7 @@
 #include "util/rstime.h"
 #include "util/rsdir.h"
 #include "util/rsprint.h"
+#include "util/rsrandom.h"
 #include "retroshare/rsexpr.h"
 
 #include "dir_hierarchy.h"
@@ -34,93 +35,283 @@
 
 typedef FileListIO::read_error read_error;
 
+static const uint32_t NAME_POOL_MIN_TABLE_SIZE  = 1024 ;	// slots in the name hash table. Always a power of 2.
+static const uint32_t HASH_INDEX_MIN_TABLE_SIZE = 1024 ;	// same for hash indexes
+static const uint32_t HASH_INDEX_EMPTY_SLOT     = DirectoryStorage::NO_INDEX ;
+
 /******************************************************************************************************************/
-/*                                              Internal File Hierarchy Storage                                   */
+/*                                                   Name pool                                                    */
 /******************************************************************************************************************/
 
-template<class T> typename std::set<T>::iterator erase_from_set(typename std::set<T>& s,const typename std::set<T>::iterator& it)
+uint32_t InternalFileHierarchyStorage::NamePool::hashName(const char *data,uint32_t len)
 {
-    typename std::set<T>::iterator tmp(it);
-    ++tmp;
-    s.erase(it) ;
-    return tmp;
+    // FNV-1a, with a random basis so that the slots cannot be predicted by friends sending names.
+
+    static const uint32_t seed = RsRandom::random_u32() ;
+    uint32_t h = 2166136261u ^ seed ;
+
+    for(uint32_t i=0;i<len;++i)
+    {
+        h ^= (uint8_t)data[i] ;
+        h *= 16777619u ;
+    }
+    return h ;
 }
 
-// This class handles the file hierarchy
-// A Mutex is used to ensure total coherence at this level. So only abstracted operations are allowed,
-// so that the hierarchy stays completely coherent between calls.
+uint32_t InternalFileHierarchyStorage::NamePool::nameSize(uint32_t id) const
+{
+    uint32_t size ;
+    memcpy(&size,&mData[id],sizeof(uint32_t)) ;
+    return size ;
+}
 
-InternalFileHierarchyStorage::InternalFileHierarchyStorage() : mRoot(0)
+const char *InternalFileHierarchyStorage::NamePool::nameData(uint32_t id,uint32_t& size) const
 {
-    DirEntry *de = new DirEntry("") ;
+    if(id + sizeof(uint32_t) > mData.size())
+    {
+        size = 0 ;
+        return NULL ;
+    }
+    size = nameSize(id) ;
+    return &mData[id + sizeof(uint32_t)] ;
+}
 
-    de->row=0;
-    de->parent_index=0;
-    de->dir_modtime=0;
-    de->dir_hash=RsFileHash() ; // null hash is root by convention.
+std::string InternalFileHierarchyStorage::NamePool::name(uint32_t id) const
+{
+    uint32_t size ;
+    const char *data = nameData(id,size) ;
 
-    mNodes.push_back(de) ;
-    mDirHashes[de->dir_hash] = 0 ;
+    return data?std::string(data,size):std::string() ;
+}
 
-    mTotalSize = 0 ;
-    mTotalFiles = 0 ;
+void InternalFileHierarchyStorage::NamePool::growTable()
+{
+    std::vector<uint32_t> old_table ;
+    old_table.swap(mTable) ;
+
+    mTable.resize(std::max(NAME_POOL_MIN_TABLE_SIZE,(uint32_t)old_table.size()*2),0) ;
+    uint32_t mask = mTable.size()-1 ;
+
+    for(uint32_t i=0;i<old_table.size();++i)
+        if(old_table[i] != 0)
+        {
+            uint32_t size ;
+            const char *data = nameData(old_table[i]-1,size) ;
+
+            uint32_t j = hashName(data,size) & mask ;
+
+            while(mTable[j] != 0)
+                j = (j+1) & mask ;
+
+            mTable[j] = old_table[i] ;
+        }
 }
 
-bool InternalFileHierarchyStorage::getDirHashFromIndex(const DirectoryStorage::EntryIndex& index,RsFileHash& hash) const
+uint32_t InternalFileHierarchyStorage::NamePool::intern(const char *data,uint32_t size)
 {
-    if(!checkIndex(index,FileStorageNode::TYPE_DIR))
-        return false ;
+    if(2*(mCount+1) > mTable.size())
+        growTable() ;
 
-    hash = static_cast<DirEntry*>(mNodes[index])->dir_hash ;
+    uint32_t mask = mTable.size()-1 ;
 
-    return true;
+    for(uint32_t i = hashName(data,size) & mask;;i = (i+1) & mask)
+    {
+        if(mTable[i] == 0)
+        {
+            uint32_t id = mData.size() ;
+
+            mData.resize(id + sizeof(uint32_t) + size) ;
+            memcpy(&mData[id],&size,sizeof(uint32_t)) ;
+            memcpy(&mData[id + sizeof(uint32_t)],data,size) ;
+
+            mTable[i] = id+1 ;
+            ++mCount ;
+
+            return id ;
+        }
+
+        uint32_t id = mTable[i]-1 ;
+
+        if(nameSize(id) == size && !memcmp(&mData[id + sizeof(uint32_t)],data,size))
+            return id ;
+    }
 }
-bool InternalFileHierarchyStorage::getIndexFromDirHash(const RsFileHash& hash,DirectoryStorage::EntryIndex& index)
+
+void InternalFileHierarchyStorage::NamePool::clear()
 {
-    std::map<RsFileHash,DirectoryStorage::EntryIndex>::iterator it = mDirHashes.find(hash) ;
+    std::vector<char>().swap(mData) ;
+    std::vector<uint32_t>().swap(mTable) ;
+    mCount = 0 ;
+}
 
-    if(it == mDirHashes.end())
-        return false;
+/******************************************************************************************************************/
+/*                                                   Hash index                                                   */
+/******************************************************************************************************************/
+
+InternalFileHierarchyStorage::HashIndex::HashIndex(const InternalFileHierarchyStorage *storage,KeyFunction key)
+    : mStorage(storage), mKey(key), mCount(0), mSeed(RsRandom::random_u64()) {}
+
+uint32_t InternalFileHierarchyStorage::HashIndex::slotOf(const RsFileHash& hash,uint32_t mask) const
+{
+    // Hashes are sent by friends, so they are mixed with a random seed rather than used as is.
 
-    index = it->second;
+    const unsigned char *bytes = hash.toByteArray() ;
+    uint64_t x = mSeed ;
 
-    // make sure the hash actually points to some existing file. If not, remove it. This is a lazy update of dir hashes: when we need them, we check them.
-    if(!checkIndex(index, FileStorageNode::TYPE_DIR) || static_cast<DirEntry*>(mNodes[index])->dir_hash != hash)
+    for(uint32_t i=0;i+sizeof(uint32_t)<=RsFileHash::SIZE_IN_BYTES;i+=sizeof(uint32_t))
     {
-        std::cerr << "(II) removing non existing hash from dir hash list: " << hash << std::endl;
+        uint32_t w ;
+        memcpy(&w,&bytes[i],sizeof(uint32_t)) ;
 
-        mDirHashes.erase(it) ;
-        return false ;
+        x = (x ^ w) * 0x9E3779B97F4A7C15ull ;
+        x ^= x >> 29 ;
     }
-    return true;
+    return (uint32_t)(x >> 32) & mask ;
 }
-bool InternalFileHierarchyStorage::getIndexFromFileHash(const RsFileHash& hash,DirectoryStorage::EntryIndex& index)
+
+uint32_t InternalFileHierarchyStorage::HashIndex::findSlot(const RsFileHash& hash) const
 {
-    std::map<RsFileHash,DirectoryStorage::EntryIndex>::iterator it = mFileHashes.find(hash) ;
+    if(mSlots.empty())
+        return DirectoryStorage::NO_INDEX ;
 
-    if(it == mFileHashes.end())
-        return false;
+    uint32_t mask = mSlots.size()-1 ;
 
-    index = it->second;
+    for(uint32_t i = slotOf(hash,mask);mSlots[i] != DirectoryStorage::NO_INDEX;i = (i+1) & mask)
+        if((mStorage->*mKey)(mSlots[i]) == hash)
+            return i ;
 
-    // make sure the hash actually points to some existing file. If not, remove it. This is a lazy update of file hashes: when we need them, we check them.
-    if(!checkIndex(it->second, FileStorageNode::TYPE_FILE) || static_cast<FileEntry*>(mNodes[index])->file_hash != hash)
-    {
-        std::cerr << "(II) removing non existing hash from file hash list: " << hash << std::endl;
+    return DirectoryStorage::NO_INDEX ;
+}
 
-        mFileHashes.erase(it) ;
+bool InternalFileHierarchyStorage::HashIndex::find(const RsFileHash& hash,DirectoryStorage::EntryIndex& index) const
+{
+    uint32_t i = findSlot(hash) ;
+
+    if(i == DirectoryStorage::NO_INDEX)
         return false ;
+
+    index = mSlots[i] ;
+    return true ;
+}
+
+void InternalFileHierarchyStorage::HashIndex::grow()
+{
+    std::vector<uint32_t> old_slots ;
+    old_slots.swap(mSlots) ;
+
+    mSlots.resize(std::max(HASH_INDEX_MIN_TABLE_SIZE,(uint32_t)old_slots.size()*2),HASH_INDEX_EMPTY_SLOT) ;
+    uint32_t mask = mSlots.size()-1 ;
+
+    for(uint32_t i=0;i<old_slots.size();++i)
+        if(old_slots[i] != DirectoryStorage::NO_INDEX)
+        {
+            uint32_t j = slotOf((mStorage->*mKey)(old_slots[i]),mask) ;
+
+            while(mSlots[j] != DirectoryStorage::NO_INDEX)
+                j = (j+1) & mask ;
+
+            mSlots[j] = old_slots[i] ;
+        }
+}
+
+void InternalFileHierarchyStorage::HashIndex::insert(const RsFileHash& hash,DirectoryStorage::EntryIndex index)
+{
+    // Keep the table at most half full, since probing reads the key of each visited entry.
+
+    if(2*(mCount+1) > mSlots.size())
+        grow() ;
+
+    uint32_t mask = mSlots.size()-1 ;
+
+    for(uint32_t i = slotOf(hash,mask);;i = (i+1) & mask)
+        if(mSlots[i] == DirectoryStorage::NO_INDEX)
+        {
+            mSlots[i] = index ;
+            ++mCount ;
+            return ;
+        }
+        else if((mStorage->*mKey)(mSlots[i]) == hash)
+        {
+            mSlots[i] = index ;
+            return ;
+        }
+}
+
+void InternalFileHierarchyStorage::HashIndex::erase(const RsFileHash& hash,DirectoryStorage::EntryIndex index)
+{
+    uint32_t i = findSlot(hash) ;
+
+    if(i == DirectoryStorage::NO_INDEX || mSlots[i] != index)
+        return ;
+
+    // Backward shift deletion: move back the following entries of the cluster that would not be found anymore.
+
+    uint32_t mask = mSlots.size()-1 ;
+
+    for(uint32_t j = (i+1) & mask;mSlots[j] != DirectoryStorage::NO_INDEX;j = (j+1) & mask)
+    {
+        uint32_t home = slotOf((mStorage->*mKey)(mSlots[j]),mask) ;
+
+        if(((j - home) & mask) >= ((j - i) & mask))
+        {
+            mSlots[i] = mSlots[j] ;
+            i = j ;
+        }
     }
 
+    mSlots[i] = DirectoryStorage::NO_INDEX ;
+    --mCount ;
+}
+
+void InternalFileHierarchyStorage::HashIndex::clear()
+{
+    std::vector<uint32_t>().swap(mSlots) ;
+    mCount = 0 ;
+}
+
+/******************************************************************************************************************/
+/*                                              Internal File Hierarchy Storage                                   */
+/******************************************************************************************************************/
+
+// This class handles the file hierarchy
+// A Mutex is used to ensure total coherence at this level. So only abstracted operations are allowed,
+// so that the hierarchy stays completely coherent between calls.
+
+InternalFileHierarchyStorage::InternalFileHierarchyStorage()
+    : mRoot(0),
+      mFileHashes(this,&InternalFileHierarchyStorage::getFileHash),
+      mDirHashes(this,&InternalFileHierarchyStorage::getDirHash)
+{
+    createDirEntry(appendNewIndex(),"",RsFileHash()) ; // null hash is root by convention.
+
+    mTotalSize = 0 ;
+    mTotalFiles = 0 ;
+}
+
+bool InternalFileHierarchyStorage::getDirHashFromIndex(const DirectoryStorage::EntryIndex& index,RsFileHash& hash) const
+{
+    if(!checkIndex(index,FileStorageNode::TYPE_DIR))
+        return false ;
+
+    hash = dirEntry(index).dir_hash ;
+
     return true;
 }
+bool InternalFileHierarchyStorage::getIndexFromDirHash(const RsFileHash& hash,DirectoryStorage::EntryIndex& index)
+{
+    return mDirHashes.find(hash,index) ;
+}
+bool InternalFileHierarchyStorage::getIndexFromFileHash(const RsFileHash& hash,DirectoryStorage::EntryIndex& index)
+{
+    return mFileHashes.find(hash,index) ;
+}
 
 bool InternalFileHierarchyStorage::getChildIndex(DirectoryStorage::EntryIndex e,int row,DirectoryStorage::EntryIndex& c) const
 {
     if(!checkIndex(e,FileStorageNode::TYPE_DIR))
         return false ;
 
-    const DirEntry& d = *static_cast<DirEntry*>(mNodes[e]) ;
+    const DirEntry& d = dirEntry(e) ;
 
     if((uint32_t)row < d.subdirs.size())
     {
@@ -141,14 +332,14 @@ int InternalFileHierarchyStorage::parentRow(DirectoryStorage::EntryIndex e)
     if(!checkIndex(e,FileStorageNode::TYPE_DIR | FileStorageNode::TYPE_FILE) || e==0)
         return -1 ;
 
-    return mNodes[mNodes[e]->parent_index]->row;
+    return mNodes.rows[mNodes.parents[e]];
 }
 
 // high level modification routines
 
 bool InternalFileHierarchyStorage::isIndexValid(DirectoryStorage::EntryIndex e) const
 {
-    return e < mNodes.size() && mNodes[e] != NULL ;
+    return e < mNodes.size() && mNodes.types[e] != FileStorageNode::TYPE_UNKNOWN ;
 }
 
 bool InternalFileHierarchyStorage::updateSubDirectoryList(const DirectoryStorage::EntryIndex& indx, const std::set<std::string>& subdirs, const RsFileHash& random_hash_seed)
@@ -156,48 +347,50 @@ bool InternalFileHierarchyStorage::updateSubDirectoryList(const DirectoryStorage
     if(!checkIndex(indx,FileStorageNode::TYPE_DIR))
         return false;
 
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[indx])) ;
-
     std::set<std::string> should_create(subdirs);
 
-    for(uint32_t i=0;i<d.subdirs.size();)
-        if(subdirs.find(static_cast<DirEntry*>(mNodes[d.subdirs[i]])->dir_name) == subdirs.end())
+    for(uint32_t i=0;i<dirEntry(indx).subdirs.size();)
+    {
+        DirectoryStorage::EntryIndex subdir = dirEntry(indx).subdirs[i] ;
+        std::string subdir_name = getName(subdir) ;
+
+        if(subdirs.find(subdir_name) == subdirs.end())
         {
 #ifdef DEBUG_DIRECTORY_STORAGE
-            std::cerr << "[directory storage] Removing subdirectory " << static_cast<DirEntry*>(mNodes[d.subdirs[i]])->dir_name << " with index " << d.subdirs[i] << std::endl;
+            std::cerr << "[directory storage] Removing subdirectory " << subdir_name << " with index " << subdir << std::endl;
 #endif
 
-            if( !removeDirectory(d.subdirs[i]))
+            if( !removeDirectory(subdir))
                 i++ ;
         }
         else
         {
 #ifdef DEBUG_DIRECTORY_STORAGE
-            std::cerr << "[directory storage] Keeping existing subdirectory " << static_cast<DirEntry*>(mNodes[d.subdirs[i]])->dir_name << " with index " << d.subdirs[i] << std::endl;
+            std::cerr << "[directory storage] Keeping existing subdirectory " << subdir_name << " with index " << subdir << std::endl;
 #endif
 
-            should_create.erase(static_cast<DirEntry*>(mNodes[d.subdirs[i]])->dir_name) ;
+            should_create.erase(subdir_name) ;
             ++i;
         }
+    }
+
+    RsFileHash dir_hash = dirEntry(indx).dir_hash ;
 
     for(std::set<std::string>::const_iterator it(should_create.begin());it!=should_create.end();++it)
     {
+        DirectoryStorage::EntryIndex new_index = appendNewIndex() ;
+
 #ifdef DEBUG_DIRECTORY_STORAGE
-        std::cerr << "[directory storage] adding new subdirectory " << it->first << " at index " << mNodes.size() << std::endl;
+        std::cerr << "[directory storage] adding new subdirectory " << *it << " at index " << new_index << std::endl;
 #endif
 
-        DirEntry *de = new DirEntry(*it) ;
-
-        de->row = mNodes.size();
-        de->parent_index = indx;
-        de->dir_modtime = 0;// forces parsing.it->second;
-		de->dir_parent_path = RsDirUtil::makePath(d.dir_parent_path, d.dir_name) ;
-        de->dir_hash = createDirHash(de->dir_name,d.dir_hash,random_hash_seed) ;
+        createDirEntry(new_index,*it,createDirHash(*it,dir_hash,random_hash_seed)) ;
 
-        mDirHashes[de->dir_hash] = mNodes.size() ;
+        mNodes.rows[new_index] = new_index;
+        mNodes.parents[new_index] = indx;
+        dirEntry(new_index).dir_modtime = 0;// forces parsing.
 
-        d.subdirs.push_back(mNodes.size()) ;
-        mNodes.push_back(de) ;
+        dirEntry(indx).subdirs.push_back(new_index) ;
     }
 
     return true;
@@ -248,8 +441,7 @@ bool InternalFileHierarchyStorage::removeDirectory(DirectoryStorage::EntryIndex
 #endif
     // remove from parent
 
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[indx])) ;
-    DirEntry& parent_dir(*static_cast<DirEntry*>(mNodes[d.parent_index]));
+    DirEntry& parent_dir(dirEntry(mNodes.parents[indx]));
 
     for(uint32_t i=0;i<parent_dir.subdirs.size();++i)
         if(parent_dir.subdirs[i] == indx)
@@ -257,7 +449,7 @@ bool InternalFileHierarchyStorage::removeDirectory(DirectoryStorage::EntryIndex
             parent_dir.subdirs[i] = parent_dir.subdirs.back() ;
             parent_dir.subdirs.pop_back();
 
-            recursRemoveDirectory(indx) ;
+            recursRemoveDirectory(indx) ;	// parent_dir cannot be used after this, since the dir table changes.
 #ifdef DEBUG_DIRECTORY_STORAGE
             print();
             std::string err ;
@@ -271,10 +463,10 @@ bool InternalFileHierarchyStorage::removeDirectory(DirectoryStorage::EntryIndex
 
 bool InternalFileHierarchyStorage::checkIndex(DirectoryStorage::EntryIndex indx,uint8_t type) const
 {
-    if(mNodes.empty() || indx==DirectoryStorage::NO_INDEX || indx >= mNodes.size() || mNodes[indx] == NULL)
+    if(indx==DirectoryStorage::NO_INDEX || indx >= mNodes.size() || mNodes.types[indx] == FileStorageNode::TYPE_UNKNOWN)
         return nodeAccessError("checkIndex(): Node does not exist") ;
 
-    if(! (mNodes[indx]->type() & type))
+    if(! (mNodes.types[indx] & type))
         return nodeAccessError("checkIndex(): Node is of wrong type") ;
 
     return true;
@@ -285,53 +477,62 @@ bool InternalFileHierarchyStorage::updateSubFilesList(const DirectoryStorage::En
     if(!checkIndex(indx,FileStorageNode::TYPE_DIR))
         return false;
 
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[indx])) ;
     new_files = subfiles ;
 
     // remove from new_files the ones that already exist and have a modf time that is not older.
 
-    for(uint32_t i=0;i<d.subfiles.size();)
+    for(uint32_t i=0;i<dirEntry(indx).subfiles.size();)
     {
-        FileEntry& f(*static_cast<FileEntry*>(mNodes[d.subfiles[i]])) ;
-        std::map<std::string,DirectoryStorage::FileTS>::const_iterator it = subfiles.find(f.file_name) ;
+        DirectoryStorage::EntryIndex file_index = dirEntry(indx).subfiles[i] ;
+        uint32_t slot = mNodes.slots[file_index] ;
+        std::string file_name = mNames.name(mFiles.names[slot]) ;
+
+        std::map<std::string,DirectoryStorage::FileTS>::const_iterator it = subfiles.find(file_name) ;
 
         if(it == subfiles.end())				// file does not exist anymore => delete
         {
 #ifdef DEBUG_DIRECTORY_STORAGE
-            std::cerr << "[directory storage] removing non existing file " << f.file_name << " at index " << d.subfiles[i] << std::endl;
+            std::cerr << "[directory storage] removing non existing file " << file_name << " at index " << file_index << std::endl;
 #endif
 
-            deleteFileNode(d.subfiles[i]) ;
+            deleteFileNode(file_index) ;
 
+            DirEntry& d(dirEntry(indx)) ;
             d.subfiles[i] = d.subfiles[d.subfiles.size()-1] ;
             d.subfiles.pop_back();
             continue;
         }
 
-        if(it->second.modtime != f.file_modtime || it->second.size != f.file_size)	// file is newer and/or has different size
+        if((uint32_t)it->second.modtime != mFiles.modtimes[slot] || it->second.size != mFiles.sizes[slot])	// file is newer and/or has different size
         {
-            f.file_hash.clear();																// hash needs recomputing
-            f.file_modtime = it->second.modtime;
-            f.file_size = it->second.size;
+            if(!mFiles.hashes[slot].isNull())
+                mFileHashes.erase(mFiles.hashes[slot],file_index) ;
 
-            mTotalSize -= f.file_size ;
+            mTotalSize -= mFiles.sizes[slot] ;
             mTotalSize += it->second.size ;
+
+            mFiles.hashes[slot].clear();																// hash needs recomputing
+            mFiles.modtimes[slot] = it->second.modtime;
+            mFiles.sizes[slot] = it->second.size;
         }
-        new_files.erase(f.file_name) ;
+        new_files.erase(file_name) ;
 
         ++i;
     }
 
     for(std::map<std::string,DirectoryStorage::FileTS>::const_iterator it(new_files.begin());it!=new_files.end();++it)
     {
+        DirectoryStorage::EntryIndex file_index = appendNewIndex() ;
+
 #ifdef DEBUG_DIRECTORY_STORAGE
-        std::cerr << "[directory storage] adding new file " << it->first << " at index " << mNodes.size() << std::endl;
+        std::cerr << "[directory storage] adding new file " << it->first << " at index " << file_index << std::endl;
 #endif
 
-        d.subfiles.push_back(mNodes.size()) ;
-        mNodes.push_back(new FileEntry(it->first,it->second.size,it->second.modtime));
-        mNodes.back()->row = mNodes.size()-1;
-        mNodes.back()->parent_index = indx;
+        createFileEntry(file_index,it->first,it->second.size,it->second.modtime,RsFileHash()) ;
+
+        mNodes.rows[file_index] = file_index;
+        mNodes.parents[file_index] = indx;
+        dirEntry(indx).subfiles.push_back(file_index) ;
 
         mTotalSize  += it->second.size;
         mTotalFiles += 1;
@@ -349,11 +550,16 @@ bool InternalFileHierarchyStorage::updateHash(const DirectoryStorage::EntryIndex
     std::cerr << "[directory storage] updating hash at index " << file_index << ", hash=" << hash << std::endl;
 #endif
 
-    RsFileHash& old_hash (static_cast<FileEntry*>(mNodes[file_index])->file_hash) ;
-    mFileHashes[hash] = file_index ;
+    RsFileHash& old_hash (mFiles.hashes[mNodes.slots[file_index]]) ;
+
+    if(!old_hash.isNull())
+        mFileHashes.erase(old_hash,file_index) ;
 
     old_hash = hash ;
 
+    if(!hash.isNull())
+        mFileHashes.insert(hash,file_index) ;
+
     return true;
 }
 bool InternalFileHierarchyStorage::updateFile(const DirectoryStorage::EntryIndex& file_index,const RsFileHash& hash, const std::string& fname,uint64_t size, const rstime_t modf_time)
@@ -364,67 +570,162 @@ bool InternalFileHierarchyStorage::updateFile(const DirectoryStorage::EntryIndex
         return false;
     }
 
-    FileEntry& fe(*static_cast<FileEntry*>(mNodes[file_index])) ;
+    uint32_t slot = mNodes.slots[file_index] ;
 
 #ifdef DEBUG_DIRECTORY_STORAGE
-    std::cerr << "[directory storage] updating file entry at index " << file_index << ", name=" << fe.file_name << " size=" << fe.file_size << ", hash=" << fe.file_hash << std::endl;
+    std::cerr << "[directory storage] updating file entry at index " << file_index << ", name=" << getName(file_index) << " size=" << mFiles.sizes[slot] << ", hash=" << mFiles.hashes[slot] << std::endl;
 #endif
-    if(mTotalSize >= fe.file_size)
-		mTotalSize -= fe.file_size;
+    if(mTotalSize >= mFiles.sizes[slot])
+		mTotalSize -= mFiles.sizes[slot];
 
 	mTotalSize += size ;
 
-    fe.file_hash = hash;
-    fe.file_size = size;
-    fe.file_modtime = modf_time;
-    fe.file_name = fname;
+    if(!mFiles.hashes[slot].isNull())
+        mFileHashes.erase(mFiles.hashes[slot],file_index) ;
+
+    mFiles.hashes[slot] = hash;
+    mFiles.sizes[slot] = size;
+    mFiles.modtimes[slot] = modf_time;
+    mFiles.names[slot] = mNames.intern(fname);
 
     if(!hash.isNull())
-        mFileHashes[hash] = file_index ;
+        mFileHashes.insert(hash,file_index) ;
 
     return true;
 }
 
 void InternalFileHierarchyStorage::deleteFileNode(uint32_t index)
 {
-	if(mNodes[index] != NULL)
+	if(index < mNodes.size() && mNodes.types[index] == FileStorageNode::TYPE_FILE)
 	{
-		FileEntry& fe(*static_cast<FileEntry*>(mNodes[index])) ;
+        uint32_t slot = mNodes.slots[index] ;
 
-        if(mTotalSize >= fe.file_size)
-			mTotalSize -= fe.file_size ;
+        if(mTotalSize >= mFiles.sizes[slot])
+			mTotalSize -= mFiles.sizes[slot] ;
 
         if(mTotalFiles > 0)
 			mTotalFiles -= 1;
 
-		delete mNodes[index] ;
-		mFreeNodes.push_back(index) ;
-		mNodes[index] = NULL ;
+		deleteNode(index) ;
 	}
 }
 void InternalFileHierarchyStorage::deleteNode(uint32_t index)
 {
-    if(mNodes[index] != NULL)
+    if(mNodes.types[index] == FileStorageNode::TYPE_FILE)
+    {
+        uint32_t slot = mNodes.slots[index] ;
+
+        if(!mFiles.hashes[slot].isNull())
+            mFileHashes.erase(mFiles.hashes[slot],index) ;
+
+        removeFileSlot(slot) ;
+    }
+    else if(mNodes.types[index] == FileStorageNode::TYPE_DIR)
+    {
+        mDirHashes.erase(dirEntry(index).dir_hash,index) ;
+        removeDirSlot(mNodes.slots[index]) ;
+    }
+    else
+        return ;
+
+    mNodes.types[index] = FileStorageNode::TYPE_UNKNOWN ;
+    mFreeNodes.push_back(index) ;
+}
+
+void InternalFileHierarchyStorage::removeFileSlot(uint32_t slot)
+{
+    // move the last file into the free slot, so that the table stays dense
+
+    uint32_t last = mFiles.size()-1 ;
+
+    if(slot != last)
     {
-        delete mNodes[index] ;
-        mFreeNodes.push_back(index) ;
-        mNodes[index] = NULL ;
+        mFiles.names   [slot] = mFiles.names   [last] ;
+        mFiles.sizes   [slot] = mFiles.sizes   [last] ;
+        mFiles.modtimes[slot] = mFiles.modtimes[last] ;
+        mFiles.hashes  [slot] = mFiles.hashes  [last] ;
+        mFiles.nodes   [slot] = mFiles.nodes   [last] ;
+
+        mNodes.slots[mFiles.nodes[slot]] = slot ;
     }
+
+    mFiles.names.pop_back() ;
+    mFiles.sizes.pop_back() ;
+    mFiles.modtimes.pop_back() ;
+    mFiles.hashes.pop_back() ;
+    mFiles.nodes.pop_back() ;
+}
+
+void InternalFileHierarchyStorage::removeDirSlot(uint32_t slot)
+{
+    uint32_t last = mDirs.size()-1 ;
+
+    if(slot != last)
+    {
+        std::swap(mDirs.entries[slot],mDirs.entries[last]) ;
+        mDirs.nodes[slot] = mDirs.nodes[last] ;
+
+        mNodes.slots[mDirs.nodes[slot]] = slot ;
+    }
+
+    mDirs.entries.pop_back() ;
+    mDirs.nodes.pop_back() ;
+}
+
+void InternalFileHierarchyStorage::createFileEntry(DirectoryStorage::EntryIndex indx,const std::string& name,uint64_t size,rstime_t modtime,const RsFileHash& hash)
+{
+    mNodes.types[indx] = FileStorageNode::TYPE_FILE ;
+    mNodes.slots[indx] = mFiles.size() ;
+
+    mFiles.names.push_back(mNames.intern(name)) ;
+    mFiles.sizes.push_back(size) ;
+    mFiles.modtimes.push_back(modtime) ;
+    mFiles.hashes.push_back(hash) ;
+    mFiles.nodes.push_back(indx) ;
+
+    if(!hash.isNull())
+        mFileHashes.insert(hash,indx) ;
+}
+
+void InternalFileHierarchyStorage::createDirEntry(DirectoryStorage::EntryIndex indx,const std::string& name,const RsFileHash& hash)
+{
+    mNodes.types[indx] = FileStorageNode::TYPE_DIR ;
+    mNodes.slots[indx] = mDirs.size() ;
+
+    mDirs.entries.push_back(DirEntry()) ;
+    mDirs.entries.back().dir_name_id = mNames.intern(name) ;
+    mDirs.entries.back().dir_hash = hash ;
+    mDirs.nodes.push_back(indx) ;
+
+    mDirHashes.insert(hash,indx) ;
+}
+
+void InternalFileHierarchyStorage::resizeNodeTable(uint32_t size)
+{
+    mNodes.types.resize(size,FileStorageNode::TYPE_UNKNOWN) ;
+    mNodes.parents.resize(size,0) ;
+    mNodes.rows.resize(size,0) ;
+    mNodes.slots.resize(size,0) ;
+}
+
+DirectoryStorage::EntryIndex InternalFileHierarchyStorage::appendNewIndex()
+{
+    resizeNodeTable(mNodes.size()+1) ;
+    return mNodes.size()-1 ;
 }
 
 DirectoryStorage::EntryIndex InternalFileHierarchyStorage::allocateNewIndex()
 {
     while(!mFreeNodes.empty())
     {
-        uint32_t index = mFreeNodes.front();
-        mFreeNodes.pop_front();
+        uint32_t index = mFreeNodes.back();
+        mFreeNodes.pop_back();
 
-        if(mNodes[index] == NULL)
+        if(index < mNodes.size() && mNodes.types[index] == FileStorageNode::TYPE_UNKNOWN)
             return DirectoryStorage::EntryIndex(index) ;
     }
 
-	mNodes.push_back(NULL) ;
-	return mNodes.size()-1 ;
+	return appendNewIndex() ;
 }
 
 bool InternalFileHierarchyStorage::updateDirEntry(const DirectoryStorage::EntryIndex& indx,const std::string& dir_name,rstime_t most_recent_time,rstime_t dir_modtime,const std::vector<RsFileHash>& subdirs_hash,const std::vector<FileEntry>& subfiles_array)
@@ -434,23 +735,32 @@ bool InternalFileHierarchyStorage::updateDirEntry(const DirectoryStorage::EntryI
         std::cerr << "[directory storage] (EE) cannot update dir at index " << indx << ". Not a valid index, or not an existing dir." << std::endl;
         return false;
     }
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[indx])) ;
 
 #ifdef DEBUG_DIRECTORY_STORAGE
     std::cerr << "Updating dir entry: name=\"" << dir_name << "\", most_recent_time=" << most_recent_time << ", modtime=" << dir_modtime << std::endl;
 #endif
 
-    d.dir_most_recent_time = most_recent_time;
-    d.dir_modtime      = dir_modtime;
-    d.dir_update_time  = time(NULL);
-    d.dir_name         = dir_name;
+    // Creating entries moves the dir table around, so dirEntry(indx) is fetched again after each change.
+
+    {
+        DirEntry& d(dirEntry(indx)) ;
+
+        d.dir_most_recent_time = most_recent_time;
+        d.dir_modtime      = dir_modtime;
+        d.dir_update_time  = time(NULL);
+        d.dir_name_id      = mNames.intern(dir_name);
+    }
 
     std::map<RsFileHash,DirectoryStorage::EntryIndex> existing_subdirs ;
 
-    for(uint32_t i=0;i<d.subdirs.size();++i)
-        existing_subdirs[static_cast<DirEntry*>(mNodes[d.subdirs[i]])->dir_hash] = d.subdirs[i] ;
+    for(uint32_t i=0;i<dirEntry(indx).subdirs.size();++i)
+    {
+        DirectoryStorage::EntryIndex subdir = dirEntry(indx).subdirs[i] ;
+        existing_subdirs[dirEntry(subdir).dir_hash] = subdir ;
+    }
 
-    d.subdirs.clear();
+    std::vector<DirectoryStorage::EntryIndex> new_subdirs ;
+    new_subdirs.reserve(subdirs_hash.size()) ;
 
     // check that all subdirs already exist. If not, create.
     for(uint32_t i=0;i<subdirs_hash.size();++i)
@@ -462,7 +772,7 @@ bool InternalFileHierarchyStorage::updateDirEntry(const DirectoryStorage::EntryI
         std::map<RsFileHash,DirectoryStorage::EntryIndex>::iterator it = existing_subdirs.find(subdirs_hash[i]) ;
         DirectoryStorage::EntryIndex dir_index = 0;
 
-        if(it != existing_subdirs.end() && mNodes[it->second] != NULL && mNodes[it->second]->type() == FileStorageNode::TYPE_DIR)
+        if(it != existing_subdirs.end() && mNodes.types[it->second] == FileStorageNode::TYPE_DIR)
         {
             dir_index = it->second ;
 
@@ -476,23 +786,18 @@ bool InternalFileHierarchyStorage::updateDirEntry(const DirectoryStorage::EntryI
         {
             dir_index = allocateNewIndex() ;
 
-            DirEntry *de = new DirEntry("") ;
-
-            mNodes[dir_index] = de ;
-
-			de->dir_parent_path = RsDirUtil::makePath(d.dir_parent_path, dir_name) ;
-            de->dir_hash        = subdirs_hash[i];
-
-            mDirHashes[subdirs_hash[i]] = dir_index ;
+            createDirEntry(dir_index,"",subdirs_hash[i]) ;
 
 #ifdef DEBUG_DIRECTORY_STORAGE
             std::cerr << " created, at new index " << dir_index << std::endl;
 #endif
         }
 
-        d.subdirs.push_back(dir_index) ;
-        mDirHashes[subdirs_hash[i]] = dir_index ;
+        new_subdirs.push_back(dir_index) ;
+        mDirHashes.insert(subdirs_hash[i],dir_index) ;
     }
+    dirEntry(indx).subdirs.swap(new_subdirs) ;
+
     // remove subdirs that do not exist anymore
 
     for(std::map<RsFileHash,DirectoryStorage::EntryIndex>::const_iterator it = existing_subdirs.begin();it!=existing_subdirs.end();++it)
@@ -513,10 +818,14 @@ bool InternalFileHierarchyStorage::updateDirEntry(const DirectoryStorage::EntryI
 
     std::map<std::string,DirectoryStorage::EntryIndex> existing_subfiles ;
 
-    for(uint32_t i=0;i<d.subfiles.size();++i)
-        existing_subfiles[static_cast<FileEntry*>(mNodes[d.subfiles[i]])->file_name] = d.subfiles[i] ;
+    for(uint32_t i=0;i<dirEntry(indx).subfiles.size();++i)
+    {
+        DirectoryStorage::EntryIndex file_index = dirEntry(indx).subfiles[i] ;
+        existing_subfiles[getName(file_index)] = file_index ;
+    }
 
-    d.subfiles.clear();
+    std::vector<DirectoryStorage::EntryIndex> new_subfiles ;
+    new_subfiles.reserve(subfiles_array.size()) ;
 
     for(uint32_t i=0;i<subfiles_array.size();++i)
     {
@@ -528,7 +837,7 @@ bool InternalFileHierarchyStorage::updateDirEntry(const DirectoryStorage::EntryI
         std::cerr << "  subfile name = " << subfiles_array[i].file_name << ": " ;
 #endif
 
-        if(it != existing_subfiles.end() && mNodes[it->second] != NULL && mNodes[it->second]->type() == FileStorageNode::TYPE_FILE)
+        if(it != existing_subfiles.end() && mNodes.types[it->second] == FileStorageNode::TYPE_FILE)
         {
             file_index = it->second ;
 
@@ -545,8 +854,7 @@ bool InternalFileHierarchyStorage::updateDirEntry(const DirectoryStorage::EntryI
         {
             file_index = allocateNewIndex() ;
 
-            mNodes[file_index] = new FileEntry(f.file_name,f.file_size,f.file_modtime,f.file_hash) ;
-            mFileHashes[f.file_hash] = file_index ;
+            createFileEntry(file_index,f.file_name,f.file_size,f.file_modtime,f.file_hash) ;
             mTotalSize += f.file_size ;
             mTotalFiles++;
 
@@ -555,8 +863,10 @@ bool InternalFileHierarchyStorage::updateDirEntry(const DirectoryStorage::EntryI
 #endif
         }
 
-        d.subfiles.push_back(file_index) ;
+        new_subfiles.push_back(file_index) ;
     }
+    dirEntry(indx).subfiles.swap(new_subfiles) ;
+
     // remove subfiles that do not exist anymore
 
     for(std::map<std::string,DirectoryStorage::EntryIndex>::const_iterator it = existing_subfiles.begin();it!=existing_subfiles.end();++it)
@@ -575,18 +885,20 @@ bool InternalFileHierarchyStorage::updateDirEntry(const DirectoryStorage::EntryI
 
     // now update row and parent index for all subnodes
 
+    const DirEntry& d(dirEntry(indx)) ;
+
     uint32_t n=0;
     for(uint32_t i=0;i<d.subdirs.size();++i)
     {
-        static_cast<DirEntry*>(mNodes[d.subdirs[i]])->dir_update_time = 0 ;	// force the update of the subdir.
+        dirEntry(d.subdirs[i]).dir_update_time = 0 ;	// force the update of the subdir.
 
-        mNodes[d.subdirs[i]]->parent_index = indx ;
-        mNodes[d.subdirs[i]]->row = n++ ;
+        mNodes.parents[d.subdirs[i]] = indx ;
+        mNodes.rows[d.subdirs[i]] = n++ ;
     }
     for(uint32_t i=0;i<d.subfiles.size();++i)
     {
-        mNodes[d.subfiles[i]]->parent_index = indx ;
-        mNodes[d.subfiles[i]]->row = n++ ;
+        mNodes.parents[d.subfiles[i]] = indx ;
+        mNodes.rows[d.subfiles[i]] = n++ ;
     }
 
 
@@ -599,6 +911,70 @@ void InternalFileHierarchyStorage::getStatistics(SharedDirStats& stats) const
     stats.total_shared_size = mTotalSize ;
 }
 
+void InternalFileHierarchyStorage::getSyncEntries(std::vector<DirectoryStorage::EntryIndex>& entries) const
+{
+    entries.clear() ;
+    entries.push_back(mRoot) ;
+
+    for(uint32_t i=0;i<mDirs.size();++i)
+        if(mDirs.nodes[i] != mRoot && mDirs.entries[i].dir_update_time == 0)
+            entries.push_back(mDirs.nodes[i]) ;
+}
+
+void InternalFileHierarchyStorage::getSummary(DirectoryStorage::Summary& summary) const
+{
+    summary.clear() ;
+    getStatistics(summary.stats) ;
+
+    std::vector<DirectoryStorage::EntryIndex> entries ;
+    getSyncEntries(entries) ;
+
+    for(uint32_t i=0;i<entries.size();++i)
+    {
+        const DirEntry& de(dirEntry(entries[i])) ;
+        DirectoryStorage::Summary::DirSyncInfo info ;
+
+        info.index          = entries[i] ;
+        info.hash           = de.dir_hash ;
+        info.update_TS      = de.dir_update_time ;
+        info.recurs_modf_TS = de.dir_most_recent_time ;
+
+        summary.dirs.push_back(info) ;
+    }
+
+    summary.initFileHashFilter(mFiles.size()) ;
+
+    for(uint32_t i=0;i<mFiles.size();++i)
+        if(!mFiles.hashes[i].isNull())
+            summary.addFileHash(mFiles.hashes[i]) ;
+}
+
+uint64_t InternalFileHierarchyStorage::memoryUsage() const
+{
+    uint64_t res = sizeof(*this) ;
+
+    res += mNodes.types.capacity()*sizeof(uint8_t) + (mNodes.parents.capacity() + mNodes.rows.capacity() + mNodes.slots.capacity())*sizeof(uint32_t) ;
+    res += (mFiles.names.capacity() + mFiles.modtimes.capacity() + mFiles.nodes.capacity())*sizeof(uint32_t) + mFiles.sizes.capacity()*sizeof(uint64_t) + mFiles.hashes.capacity()*sizeof(RsFileHash) ;
+    res += mDirs.entries.capacity()*sizeof(DirEntry) + mDirs.nodes.capacity()*sizeof(uint32_t) ;
+
+    for(uint32_t i=0;i<mDirs.size();++i)
+        res += (mDirs.entries[i].subdirs.capacity() + mDirs.entries[i].subfiles.capacity())*sizeof(DirectoryStorage::EntryIndex) ;
+
+    res += mFreeNodes.capacity()*sizeof(uint32_t) + mNames.memoryUsage() + mFileHashes.memoryUsage() + mDirHashes.memoryUsage() ;
+
+    return res ;
+}
+
+void InternalFileHierarchyStorage::clear()
+{
+    clearTables() ;
+    createDirEntry(appendNewIndex(),"",RsFileHash()) ;
+
+    mRoot = 0 ;
+    mTotalSize = 0 ;
+    mTotalFiles = 0 ;
+}
+
 bool InternalFileHierarchyStorage::getTS(const DirectoryStorage::EntryIndex& index,rstime_t& TS,rstime_t DirEntry::* m) const
 {
     if(!checkIndex(index,FileStorageNode::TYPE_DIR))
@@ -607,9 +983,7 @@ bool InternalFileHierarchyStorage::getTS(const DirectoryStorage::EntryIndex& ind
         return false;
     }
 
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[index])) ;
-
-    TS = d.*m ;
+    TS = dirEntry(index).*m ;
 
     return true;
 }
@@ -622,9 +996,7 @@ bool InternalFileHierarchyStorage::setTS(const DirectoryStorage::EntryIndex& ind
         return false;
     }
 
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[index])) ;
-
-    d.*m = TS;
+    dirEntry(index).*m = TS;
 
     return true;
 }
@@ -633,17 +1005,17 @@ bool InternalFileHierarchyStorage::setTS(const DirectoryStorage::EntryIndex& ind
 
 rstime_t InternalFileHierarchyStorage::recursUpdateLastModfTime(const DirectoryStorage::EntryIndex& dir_index,bool& unfinished_files_present)
 {
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[dir_index])) ;
+    DirEntry& d(dirEntry(dir_index)) ;	// the dir table is not modified below, so the reference stays valid.
 
     rstime_t largest_modf_time = d.dir_modtime ;
     unfinished_files_present = false ;
 
     for(uint32_t i=0;i<d.subfiles.size();++i)
     {
-        FileEntry *f = static_cast<FileEntry*>(mNodes[d.subfiles[i]]) ;
+        uint32_t slot = mNodes.slots[d.subfiles[i]] ;
 
-        if(!f->file_hash.isNull())
-            largest_modf_time = std::max(largest_modf_time, f->file_modtime) ;	// only account for hashed files, since we never send unhashed files to friends.
+        if(!mFiles.hashes[slot].isNull())
+            largest_modf_time = std::max(largest_modf_time, (rstime_t)mFiles.modtimes[slot]) ;	// only account for hashed files, since we never send unhashed files to friends.
         else
             unfinished_files_present = true ;
     }
@@ -668,55 +1040,104 @@ rstime_t InternalFileHierarchyStorage::recursUpdateLastModfTime(const DirectoryS
 
 // Low level stuff. Should normally not be used externally.
 
-const InternalFileHierarchyStorage::FileStorageNode *InternalFileHierarchyStorage::getNode(DirectoryStorage::EntryIndex indx) const
-{
-    if(checkIndex(indx,FileStorageNode::TYPE_FILE | FileStorageNode::TYPE_DIR))
-        return mNodes[indx] ;
-    else
-        return NULL ;
-}
-
 const InternalFileHierarchyStorage::DirEntry *InternalFileHierarchyStorage::getDirEntry(DirectoryStorage::EntryIndex indx) const
 {
     if(!checkIndex(indx,FileStorageNode::TYPE_DIR))
         return NULL ;
 
-    return static_cast<DirEntry*>(mNodes[indx]) ;
-}
-const InternalFileHierarchyStorage::FileEntry *InternalFileHierarchyStorage::getFileEntry(DirectoryStorage::EntryIndex indx) const
-{
-    if(!checkIndex(indx,FileStorageNode::TYPE_FILE))
-        return NULL ;
-
-    return static_cast<FileEntry*>(mNodes[indx]) ;
+    return &dirEntry(indx) ;
 }
 uint32_t InternalFileHierarchyStorage::getType(DirectoryStorage::EntryIndex indx) const
 {
     if(checkIndex(indx,FileStorageNode::TYPE_FILE | FileStorageNode::TYPE_DIR))
-        return mNodes[indx]->type() ;
+        return mNodes.types[indx] ;
     else
         return FileStorageNode::TYPE_UNKNOWN;
 }
+DirectoryStorage::EntryIndex InternalFileHierarchyStorage::getParentIndex(DirectoryStorage::EntryIndex indx) const
+{
+    if(checkIndex(indx,FileStorageNode::TYPE_FILE | FileStorageNode::TYPE_DIR))
+        return mNodes.parents[indx] ;
+    else
+        return DirectoryStorage::NO_INDEX;
+}
 
 DirectoryStorage::EntryIndex InternalFileHierarchyStorage::getSubFileIndex(DirectoryStorage::EntryIndex parent_index,uint32_t file_tab_index)
 {
     if(!checkIndex(parent_index,FileStorageNode::TYPE_DIR))
         return DirectoryStorage::NO_INDEX;
 
-    if(static_cast<DirEntry*>(mNodes[parent_index])->subfiles.size() <= file_tab_index)
+    if(dirEntry(parent_index).subfiles.size() <= file_tab_index)
         return DirectoryStorage::NO_INDEX;
 
-    return static_cast<DirEntry*>(mNodes[parent_index])->subfiles[file_tab_index];
+    return dirEntry(parent_index).subfiles[file_tab_index];
 }
 DirectoryStorage::EntryIndex InternalFileHierarchyStorage::getSubDirIndex(DirectoryStorage::EntryIndex parent_index,uint32_t dir_tab_index)
 {
     if(!checkIndex(parent_index,FileStorageNode::TYPE_DIR))
         return DirectoryStorage::NO_INDEX;
 
-    if(static_cast<DirEntry*>(mNodes[parent_index])->subdirs.size() <= dir_tab_index)
+    if(dirEntry(parent_index).subdirs.size() <= dir_tab_index)
         return DirectoryStorage::NO_INDEX;
 
-    return static_cast<DirEntry*>(mNodes[parent_index])->subdirs[dir_tab_index];
+    return dirEntry(parent_index).subdirs[dir_tab_index];
+}
+
+std::string InternalFileHierarchyStorage::getName(DirectoryStorage::EntryIndex indx) const
+{
+    if(!checkIndex(indx,FileStorageNode::TYPE_FILE | FileStorageNode::TYPE_DIR))
+        return std::string() ;
+
+    if(mNodes.types[indx] == FileStorageNode::TYPE_FILE)
+        return mNames.name(mFiles.names[mNodes.slots[indx]]) ;
+    else
+        return mNames.name(dirEntry(indx).dir_name_id) ;
+}
+uint64_t InternalFileHierarchyStorage::getFileSize(DirectoryStorage::EntryIndex indx) const
+{
+    return checkIndex(indx,FileStorageNode::TYPE_FILE)?mFiles.sizes[mNodes.slots[indx]]:0 ;
+}
+rstime_t InternalFileHierarchyStorage::getFileModTime(DirectoryStorage::EntryIndex indx) const
+{
+    return checkIndex(indx,FileStorageNode::TYPE_FILE)?(rstime_t)mFiles.modtimes[mNodes.slots[indx]]:0 ;
+}
+RsFileHash InternalFileHierarchyStorage::getFileHash(DirectoryStorage::EntryIndex indx) const
+{
+    return checkIndex(indx,FileStorageNode::TYPE_FILE)?mFiles.hashes[mNodes.slots[indx]]:RsFileHash() ;
+}
+RsFileHash InternalFileHierarchyStorage::getDirHash(DirectoryStorage::EntryIndex indx) const
+{
+    return checkIndex(indx,FileStorageNode::TYPE_DIR)?dirEntry(indx).dir_hash:RsFileHash() ;
+}
+
+// The parent path used to be stored in each directory. It is now rebuilt from the names of the parent directories.
+
+std::string InternalFileHierarchyStorage::getDirParentPath(DirectoryStorage::EntryIndex indx) const
+{
+    std::vector<DirectoryStorage::EntryIndex> parents ;
+
+    // the size limit protects against parent loops in a corrupted hierarchy
+
+    for(DirectoryStorage::EntryIndex i=indx;i != 0 && parents.size() < mNodes.size();)
+    {
+        i = getParentIndex(i) ;
+
+        if(i == DirectoryStorage::NO_INDEX)
+            break ;
+
+        parents.push_back(i) ;
+    }
+
+    std::string path ;
+
+    for(uint32_t i=parents.size();i>0;--i)
+        path = RsDirUtil::makePath(path,getName(parents[i-1])) ;
+
+    return path ;
+}
+std::string InternalFileHierarchyStorage::getDirPath(DirectoryStorage::EntryIndex indx) const
+{
+    return RsDirUtil::makePath(getDirParentPath(indx),getName(indx)) ;
 }
 
 bool InternalFileHierarchyStorage::searchHash(const RsFileHash& hash,DirectoryStorage::EntryIndex& result)
@@ -724,31 +1145,44 @@ bool InternalFileHierarchyStorage::searchHash(const RsFileHash& hash,DirectorySt
     return getIndexFromFileHash(hash,result);
 }
 
+void InternalFileHierarchyStorage::getFileHashes(std::vector<RsFileHash>& hashes) const
+{
+    const std::vector<uint32_t>& slots(mFileHashes.slots()) ;
+
+    hashes.reserve(hashes.size() + mFileHashes.size()) ;
+
+    for(uint32_t i=0;i<slots.size();++i)
+        if(slots[i] != DirectoryStorage::NO_INDEX)
+            hashes.push_back(getFileHash(slots[i])) ;
+}
+
 class DirectoryStorageExprFileEntry: public RsRegularExpression::ExpFileEntry
 {
 public:
-    DirectoryStorageExprFileEntry(const InternalFileHierarchyStorage::FileEntry& fe,const InternalFileHierarchyStorage::DirEntry& parent) : mFe(fe),mDe(parent) {}
-
-    inline virtual const std::string& file_name()       const { return mFe.file_name ; }
-    inline virtual uint64_t           file_size()       const { return mFe.file_size ; }
-    inline virtual const RsFileHash&  file_hash()       const { return mFe.file_hash ; }
-    inline virtual rstime_t             file_modtime()    const { return mFe.file_modtime ; }
-	inline virtual std::string        file_parent_path()const { return RsDirUtil::makePath(mDe.dir_parent_path, mDe.dir_name) ; }
+    DirectoryStorageExprFileEntry(const InternalFileHierarchyStorage& storage,DirectoryStorage::EntryIndex indx)
+        : mStorage(storage),mIndex(indx),mName(storage.getName(indx)),mHash(storage.getFileHash(indx)) {}
+
+    inline virtual const std::string& file_name()       const { return mName ; }
+    inline virtual uint64_t           file_size()       const { return mStorage.getFileSize(mIndex) ; }
+    inline virtual const RsFileHash&  file_hash()       const { return mHash ; }
+    inline virtual rstime_t             file_modtime()    const { return mStorage.getFileModTime(mIndex) ; }
+	inline virtual std::string        file_parent_path()const { return mStorage.getDirPath(mStorage.getParentIndex(mIndex)) ; }
     inline virtual uint32_t           file_popularity() const { NOT_IMPLEMENTED() ; return 0; }
 
 private:
-    const InternalFileHierarchyStorage::FileEntry& mFe ;
-    const InternalFileHierarchyStorage::DirEntry& mDe ;
+    const InternalFileHierarchyStorage& mStorage ;
+    DirectoryStorage::EntryIndex mIndex ;
+    std::string mName ;
+    RsFileHash mHash ;
 };
 
 int InternalFileHierarchyStorage::searchBoolExp(RsRegularExpression::Expression * exp, std::list<DirectoryStorage::EntryIndex> &results) const
 {
-    for(std::map<RsFileHash,DirectoryStorage::EntryIndex>::const_iterator it(mFileHashes.begin());it!=mFileHashes.end();++it)
-        if(mNodes[it->second] != NULL && exp->eval(
-                    DirectoryStorageExprFileEntry(*static_cast<const FileEntry*>(mNodes[it->second]),
-                                                  *static_cast<const DirEntry*>(mNodes[mNodes[it->second]->parent_index])
-                                                  )))
-            results.push_back(it->second);
+    const std::vector<uint32_t>& slots(mFileHashes.slots()) ;
+
+    for(uint32_t i=0;i<slots.size();++i)
+        if(slots[i] != DirectoryStorage::NO_INDEX && exp->eval(DirectoryStorageExprFileEntry(*this,slots[i])))
+            results.push_back(slots[i]);
 
     return 0;
 }
@@ -758,19 +1192,22 @@ int InternalFileHierarchyStorage::searchTerms(const std::list<std::string>& term
     // most entries are likely to be files, so we could do a linear search over the entries tab.
     // instead we go through the table of hashes.
 
-    for(std::map<RsFileHash,DirectoryStorage::EntryIndex>::const_iterator it(mFileHashes.begin());it!=mFileHashes.end();++it)
-        if(mNodes[it->second] != NULL)
+    const std::vector<uint32_t>& slots(mFileHashes.slots()) ;
+
+    for(uint32_t i=0;i<slots.size();++i)
+        if(slots[i] != DirectoryStorage::NO_INDEX)
         {
-            const std::string &str1 = static_cast<FileEntry*>(mNodes[it->second])->file_name;
+            uint32_t size ;
+            const char *str1 = mNames.nameData(mFiles.names[mNodes.slots[slots[i]]],size) ;
 
             for(std::list<std::string>::const_iterator iter(terms.begin()); iter != terms.end(); ++iter)
             {
                 /* always ignore case */
                 const std::string &str2 = (*iter);
 
-                if(str1.end() != std::search( str1.begin(), str1.end(), str2.begin(), str2.end(), RsRegularExpression::CompareCharIC() ))
+                if(str1 + size != std::search( str1, str1 + size, str2.begin(), str2.end(), RsRegularExpression::CompareCharIC() ))
                 {
-                    results.push_back(it->second);
+                    results.push_back(slots[i]);
                     break;
                 }
             }
@@ -795,14 +1232,14 @@ bool InternalFileHierarchyStorage::check(std::string& error_string) // checks co
     mFreeNodes.clear();
 
     for(uint32_t i=0;i<mNodes.size();++i)
-        if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_DIR)
+        if(mNodes.types[i] == FileStorageNode::TYPE_DIR)
         {
             // stamp the kids
-            DirEntry& de = *static_cast<DirEntry*>(mNodes[i]) ;
+            DirEntry& de = dirEntry(i) ;
 
             for(uint32_t j=0;j<de.subdirs.size();)
             {
-                if(de.subdirs[j] >= mNodes.size())
+                if(de.subdirs[j] >= mNodes.size() || mNodes.types[de.subdirs[j]] != FileStorageNode::TYPE_DIR)
                 {
                     if(!bDirOut){ error_string += " - Node child dir out of tab!"; bDirOut = true;}
                     de.subdirs[j] = de.subdirs.back() ;
@@ -822,7 +1259,7 @@ bool InternalFileHierarchyStorage::check(std::string& error_string) // checks co
             }
             for(uint32_t j=0;j<de.subfiles.size();)
             {
-                if(de.subfiles[j] >= mNodes.size())
+                if(de.subfiles[j] >= mNodes.size() || mNodes.types[de.subfiles[j]] != FileStorageNode::TYPE_FILE)
                 {
                     if(!bFileOut){ error_string += " - Node child file out of tab!"; bFileOut = true;}
                     de.subfiles[j] = de.subfiles.back() ;
@@ -841,20 +1278,56 @@ bool InternalFileHierarchyStorage::check(std::string& error_string) // checks co
                 }
             }
         }
-        else if( mNodes[i] == NULL )
+        else if( mNodes.types[i] == FileStorageNode::TYPE_UNKNOWN )
             mFreeNodes.push_back(i) ;
 
     for(uint32_t i=0;i<hits.size();++i)
-        if(hits[i] == 0 && mNodes[i] != NULL)
+        if(hits[i] == 0 && mNodes.types[i] != FileStorageNode::TYPE_UNKNOWN)
         {
             if(!bOrphean){ error_string += " - Orphean node!"; bOrphean = true;}
 
             deleteNode(i) ;	// we don't care if it's a file or a dir.
         }
 
+    rebuildNamePool() ;
+
     return error_string.empty();;
 }
 
+// Drops the names that are not used anymore, e.g. after files were renamed or removed.
+
+void InternalFileHierarchyStorage::rebuildNamePool()
+{
+    NamePool names ;
+    uint32_t size ;
+
+    for(uint32_t i=0;i<mFiles.size();++i)
+    {
+        const char *data = mNames.nameData(mFiles.names[i],size) ;
+        mFiles.names[i] = names.intern(data,size) ;
+    }
+
+    for(uint32_t i=0;i<mDirs.size();++i)
+    {
+        const char *data = mNames.nameData(mDirs.entries[i].dir_name_id,size) ;
+        mDirs.entries[i].dir_name_id = names.intern(data,size) ;
+    }
+
+    std::swap(mNames,names) ;
+}
+
+void InternalFileHierarchyStorage::clearTables()
+{
+    mNodes = NodeTable() ;
+    mFiles = FileTable() ;
+    mDirs = DirTable() ;
+
+    std::vector<uint32_t>().swap(mFreeNodes) ;
+    mNames.clear() ;
+    mFileHashes.clear() ;
+    mDirHashes.clear() ;
+}
+
 void InternalFileHierarchyStorage::print() const
 {
     int nfiles = 0 ;
@@ -863,19 +1336,19 @@ void InternalFileHierarchyStorage::print() const
     int nunknown = 0;
 
     for(uint32_t i=0;i<mNodes.size();++i)
-        if(mNodes[i] == NULL)
+        if(mNodes.types[i] == FileStorageNode::TYPE_UNKNOWN)
         {
             //std::cerr << "  Node " << i << ": empty " << std::endl;
             ++nempty ;
         }
-        else if(mNodes[i]->type() == FileStorageNode::TYPE_DIR)
+        else if(mNodes.types[i] == FileStorageNode::TYPE_DIR)
         {
-            std::cerr << "  Node " << i << ": type=" << mNodes[i]->type() << std::endl;
+            std::cerr << "  Node " << i << ": type=" << (int)mNodes.types[i] << std::endl;
             ++ndirs;
         }
-        else if(mNodes[i]->type() == FileStorageNode::TYPE_FILE)
+        else if(mNodes.types[i] == FileStorageNode::TYPE_FILE)
         {
-            std::cerr << "  Node " << i << ": type=" << mNodes[i]->type() << std::endl;
+            std::cerr << "  Node " << i << ": type=" << (int)mNodes.types[i] << std::endl;
             ++nfiles;
         }
         else
@@ -887,30 +1360,33 @@ void InternalFileHierarchyStorage::print() const
     std::cerr << "Total nodes: " << mNodes.size() << " (" << nfiles << " files, " << ndirs << " dirs, " << nempty << " empty slots";
     if (nunknown > 0) std::cerr << ", " << nunknown << " unknown";
     std::cerr << ")" << std::endl;
+    std::cerr << "Name pool: " << mNames.dataSize() << " bytes" << std::endl;
 
 
     recursPrint(0,DirectoryStorage::EntryIndex(0));
 
     std::cerr << "Known dir hashes: " << std::endl;
-    for(std::map<RsFileHash,DirectoryStorage::EntryIndex>::const_iterator  it(mDirHashes.begin());it!=mDirHashes.end();++it)
-        std::cerr << "  " << it->first << " at index " << it->second << std::endl;
+    for(uint32_t i=0;i<mDirHashes.slots().size();++i)
+        if(mDirHashes.slots()[i] != DirectoryStorage::NO_INDEX)
+            std::cerr << "  " << getDirHash(mDirHashes.slots()[i]) << " at index " << mDirHashes.slots()[i] << std::endl;
 
     std::cerr << "Known file hashes: " << std::endl;
-    for(std::map<RsFileHash,DirectoryStorage::EntryIndex>::const_iterator  it(mFileHashes.begin());it!=mFileHashes.end();++it)
-        std::cerr << "  " << it->first << " at index " << it->second << std::endl;
+    for(uint32_t i=0;i<mFileHashes.slots().size();++i)
+        if(mFileHashes.slots()[i] != DirectoryStorage::NO_INDEX)
+            std::cerr << "  " << getFileHash(mFileHashes.slots()[i]) << " at index " << mFileHashes.slots()[i] << std::endl;
 }
 void InternalFileHierarchyStorage::recursPrint(int depth,DirectoryStorage::EntryIndex node) const
 {
     std::string indent(2*depth,' ');
 
-    if(mNodes[node] == NULL)
+    if(mNodes.types[node] != FileStorageNode::TYPE_DIR)
     {
         std::cerr << "EMPTY NODE !!" << std::endl;
         return ;
     }
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[node]));
+    const DirEntry& d(dirEntry(node));
 
-    std::cerr << indent << "dir hash=" << d.dir_hash << ". name:" << d.dir_name << ", parent_path:" << d.dir_parent_path << ", modf time: " << d.dir_modtime << ", recurs_last_modf_time: " << d.dir_most_recent_time << ", parent: " << d.parent_index << ", row: " << d.row << ", subdirs: " ;
+    std::cerr << indent << "dir hash=" << d.dir_hash << ". name:" << getName(node) << ", parent_path:" << getDirParentPath(node) << ", modf time: " << d.dir_modtime << ", recurs_last_modf_time: " << d.dir_most_recent_time << ", parent: " << mNodes.parents[node] << ", row: " << mNodes.rows[node] << ", subdirs: " ;
 
     for(uint32_t i=0;i<d.subdirs.size();++i)
         std::cerr << d.subdirs[i] << " " ;
@@ -920,10 +1396,10 @@ void InternalFileHierarchyStorage::recursPrint(int depth,DirectoryStorage::Entry
         recursPrint(depth+1,d.subdirs[i]) ;
 
     for(uint32_t i=0;i<d.subfiles.size();++i)
-        if(mNodes[d.subfiles[i]] != NULL)
+        if(mNodes.types[d.subfiles[i]] == FileStorageNode::TYPE_FILE)
         {
-            FileEntry& f(*static_cast<FileEntry*>(mNodes[d.subfiles[i]]));
-            std::cerr << indent << "  hash:" << f.file_hash << " ts:" << (uint64_t)f.file_modtime << "  " << f.file_size << "  " << f.file_name << ", parent: " << f.parent_index << ", row: " << f.row << std::endl;
+            DirectoryStorage::EntryIndex f = d.subfiles[i] ;
+            std::cerr << indent << "  hash:" << getFileHash(f) << " ts:" << (uint64_t)getFileModTime(f) << "  " << getFileSize(f) << "  " << getName(f) << ", parent: " << mNodes.parents[f] << ", row: " << mNodes.rows[f] << std::endl;
         }
 }
 
@@ -937,27 +1413,84 @@ bool InternalFileHierarchyStorage::nodeAccessError(const std::string& s)
 
 bool InternalFileHierarchyStorage::recursRemoveDirectory(DirectoryStorage::EntryIndex dir)
 {
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[dir])) ;
+    std::vector<DirectoryStorage::EntryIndex> subdirs ;
+    std::vector<DirectoryStorage::EntryIndex> subfiles ;
 
-    RsFileHash hash = d.dir_hash ;
+    // the dir table changes while removing, so take the children out first.
 
-    for(uint32_t i=0;i<d.subdirs.size();++i)
-        recursRemoveDirectory(d.subdirs[i]);
+    subdirs.swap(dirEntry(dir).subdirs) ;
+    subfiles.swap(dirEntry(dir).subfiles) ;
 
-    for(uint32_t i=0;i<d.subfiles.size();++i)
-        deleteFileNode(d.subfiles[i]);
+    for(uint32_t i=0;i<subdirs.size();++i)
+        recursRemoveDirectory(subdirs[i]);
 
-    deleteNode(dir) ;
+    for(uint32_t i=0;i<subfiles.size();++i)
+        deleteFileNode(subfiles[i]);
 
-    mDirHashes.erase(hash) ;
+    deleteNode(dir) ;	// also removes the dir hash
 
     return true ;
 }
 
 bool InternalFileHierarchyStorage::save(const std::string& fname)
+{
+    DirectoryStorage::Summary summary ;
+    getSummary(summary) ;
+
+    unsigned char *summary_data = NULL ;
+    unsigned char *hierarchy_data = NULL ;
+    uint32_t summary_size = 0 ;
+    uint32_t hierarchy_size = 0 ;
+
+    bool res = summary.serialise(summary_data,summary_size) && serialise(hierarchy_data,hierarchy_size) ;
+
+    if(res)
+    {
+        std::vector<const unsigned char*> sections(2) ;
+        std::vector<uint32_t> sizes(2) ;
+
+        sections[FILE_LIST_IO_SECTION_DIRECTORY_SUMMARY  ] = summary_data ;
+        sections[FILE_LIST_IO_SECTION_DIRECTORY_HIERARCHY] = hierarchy_data ;
+        sizes   [FILE_LIST_IO_SECTION_DIRECTORY_SUMMARY  ] = summary_size ;
+        sizes   [FILE_LIST_IO_SECTION_DIRECTORY_HIERARCHY] = hierarchy_size ;
+
+        res = FileListIO::saveEncryptedSectionsToFile(fname,sections,sizes) ;
+    }
+
+    free(summary_data) ;
+    free(hierarchy_data) ;
+
+    return res ;
+}
+
+bool InternalFileHierarchyStorage::load(const std::string& fname,bool& old_format)
 {
     unsigned char *buffer = NULL ;
     uint32_t buffer_size = 0 ;
+
+    old_format = false ;
+
+    if(!FileListIO::loadEncryptedSectionFromFile(fname,FILE_LIST_IO_SECTION_DIRECTORY_HIERARCHY,buffer,buffer_size))
+    {
+        if(!FileListIO::loadEncryptedDataFromFile(fname,buffer,buffer_size))
+            return false ;
+
+        old_format = true ;
+    }
+
+    bool res = deserialise(buffer,buffer_size) ;
+
+    free(buffer) ;
+
+    if(!res)
+        clear() ;
+
+    return res ;
+}
+
+bool InternalFileHierarchyStorage::serialise(unsigned char *& buffer,uint32_t& size) const
+{
+    uint32_t buffer_size = 0 ;
     uint32_t buffer_offset = 0 ;
 
     unsigned char *tmp_section_data = (unsigned char*)rs_malloc(FL_BASE_TMP_SECTION_SIZE) ;
@@ -977,34 +1510,33 @@ bool InternalFileHierarchyStorage::save(const std::string& fname)
         // Write all file/dir entries
 
         for(uint32_t i=0;i<mNodes.size();++i)
-            if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_FILE)
+            if(mNodes.types[i] == FileStorageNode::TYPE_FILE)
             {
-                const FileEntry& fe(*static_cast<const FileEntry*>(mNodes[i])) ;
-
+                uint32_t slot = mNodes.slots[i] ;
                 uint32_t file_section_offset = 0 ;
 
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_PARENT_INDEX  ,(uint32_t)fe.parent_index)) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_ROW           ,(uint32_t)fe.row         )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_ENTRY_INDEX   ,(uint32_t)i              )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_NAME     ,fe.file_name             )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SIZE     ,fe.file_size             )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SHA1_HASH,fe.file_hash             )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_MODIF_TS      ,(uint32_t)fe.file_modtime)) throw std::runtime_error("Write error") ;
+                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_PARENT_INDEX  ,(uint32_t)mNodes.parents[i]        )) throw std::runtime_error("Write error") ;
+                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_ROW           ,(uint32_t)mNodes.rows[i]           )) throw std::runtime_error("Write error") ;
+                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_ENTRY_INDEX   ,(uint32_t)i                        )) throw std::runtime_error("Write error") ;
+                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_NAME     ,mNames.name(mFiles.names[slot])    )) throw std::runtime_error("Write error") ;
+                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SIZE     ,mFiles.sizes[slot]                 )) throw std::runtime_error("Write error") ;
+                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SHA1_HASH,mFiles.hashes[slot]                )) throw std::runtime_error("Write error") ;
+                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_MODIF_TS      ,(uint32_t)mFiles.modtimes[slot]    )) throw std::runtime_error("Write error") ;
 
                 if(!FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_FILE_ENTRY,tmp_section_data,file_section_offset)) throw std::runtime_error("Write error") ;
             }
-            else if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_DIR)
+            else if(mNodes.types[i] == FileStorageNode::TYPE_DIR)
             {
-                const DirEntry& de(*static_cast<const DirEntry*>(mNodes[i])) ;
+                const DirEntry& de(dirEntry(i)) ;
 
                 uint32_t dir_section_offset = 0 ;
 
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_PARENT_INDEX   ,(uint32_t)de.parent_index      )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_ROW            ,(uint32_t)de.row               )) throw std::runtime_error("Write error") ;
+                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_PARENT_INDEX   ,(uint32_t)mNodes.parents[i]     )) throw std::runtime_error("Write error") ;
+                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_ROW            ,(uint32_t)mNodes.rows[i]        )) throw std::runtime_error("Write error") ;
                 if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_ENTRY_INDEX    ,(uint32_t)i                    )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_FILE_NAME      ,de.dir_name                    )) throw std::runtime_error("Write error") ;
+                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_FILE_NAME      ,mNames.name(de.dir_name_id)     )) throw std::runtime_error("Write error") ;
                 if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_DIR_HASH       ,de.dir_hash                    )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_FILE_SIZE      ,de.dir_parent_path             )) throw std::runtime_error("Write error") ;
+                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_FILE_SIZE      ,getDirParentPath(i)             )) throw std::runtime_error("Write error") ;
                 if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_MODIF_TS       ,(uint32_t)de.dir_modtime       )) throw std::runtime_error("Write error") ;
                 if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_UPDATE_TS      ,(uint32_t)de.dir_update_time   )) throw std::runtime_error("Write error") ;
                 if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RECURS_MODIF_TS,(uint32_t)de.dir_most_recent_time  )) throw std::runtime_error("Write error") ;
@@ -1022,12 +1554,10 @@ bool InternalFileHierarchyStorage::save(const std::string& fname)
                 if(!FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIR_ENTRY,tmp_section_data,dir_section_offset)) throw std::runtime_error("Write error") ;
             }
 
-        bool res = FileListIO::saveEncryptedDataToFile(fname,buffer,buffer_offset) ;
-
-        free(buffer) ;
+        size = buffer_offset ;
         free(tmp_section_data) ;
 
-        return res ;
+        return true ;
     }
     catch(std::exception& e)
     {
@@ -1036,6 +1566,9 @@ bool InternalFileHierarchyStorage::save(const std::string& fname)
         if(buffer != NULL)
             free(buffer) ;
 
+        buffer = NULL ;
+        size = 0 ;
+
         if(tmp_section_data != NULL)
 			free(tmp_section_data) ;
 
@@ -1043,10 +1576,8 @@ bool InternalFileHierarchyStorage::save(const std::string& fname)
     }
 }
 
-bool InternalFileHierarchyStorage::load(const std::string& fname)
+bool InternalFileHierarchyStorage::deserialise(const unsigned char *buffer,uint32_t buffer_size)
 {
-    unsigned char *buffer = NULL ;
-    uint32_t buffer_size = 0 ;
     uint32_t buffer_offset = 0 ;
 
     mFreeNodes.clear();
@@ -1055,28 +1586,21 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
 
     try
     {
-        if(!FileListIO::loadEncryptedDataFromFile(fname,buffer,buffer_size) )
-            throw read_error("Cannot decrypt") ;
-
         // Read some header
 
         uint32_t version, n_nodes ;
 
         if(!FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION,version)) throw read_error(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION) ;
-        if(version != (uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0001) throw std::runtime_error("Wrong version number") ;
+        if(version != (uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0001) throw read_error("Wrong version number") ;
 
         if(!FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_RAW_NUMBER,n_nodes)) throw read_error(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_RAW_NUMBER) ;
 
         // Write all file/dir entries
 
-        for(uint32_t i=0;i<mNodes.size();++i)
-            if(mNodes[i])
-                delete mNodes[i] ;
-
-        mNodes.clear();
-        mNodes.resize(n_nodes,NULL) ;
+        clearTables() ;
+        resizeNodeTable(n_nodes) ;
 
-        for(uint32_t i=0;i<mNodes.size() && buffer_offset < buffer_size;++i)	// only the 2nd condition really is needed. The first one ensures that the loop wont go forever.
+        for(uint32_t i=0;i<n_nodes && buffer_offset < buffer_size;++i)	// only the 2nd condition really is needed. The first one ensures that the loop wont go forever.
         {
             unsigned char *node_section_data = NULL ;
             uint32_t node_section_size = 0 ;
@@ -1103,16 +1627,19 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
                 if(!FileListIO::readField(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_FILE_SHA1_HASH,file_hash   )) throw read_error(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_FILE_SHA1_HASH) ;
                 if(!FileListIO::readField(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_MODIF_TS      ,file_modtime)) throw read_error(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_MODIF_TS      ) ;
 
+                if(node_index == DirectoryStorage::NO_INDEX)
+                    throw read_error("Wrong node index") ;
+
                 if(node_index >= mNodes.size())
-                    mNodes.resize(node_index+1,NULL) ;
+                    resizeNodeTable(node_index+1) ;
 
-                FileEntry *fe = new FileEntry(file_name,file_size,file_modtime,file_hash);
+                deleteFileNode(node_index) ;	// only when the file mentions the same node twice
+                deleteNode(node_index) ;
 
-                fe->parent_index = parent_index ;
-                fe->row = row ;
+                createFileEntry(node_index,file_name,file_size,file_modtime,file_hash) ;
 
-                mNodes[node_index] = fe ;
-                mFileHashes[fe->file_hash] = node_index ;
+                mNodes.parents[node_index] = parent_index ;
+                mNodes.rows[node_index] = row ;
 
                 mTotalFiles++ ;
                 mTotalSize += file_size ;
@@ -1139,19 +1666,26 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
                 if(!FileListIO::readField(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_UPDATE_TS      ,dir_update_time      )) throw read_error(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_UPDATE_TS      ) ;
                 if(!FileListIO::readField(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_RECURS_MODIF_TS,dir_most_recent_time )) throw read_error(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_RECURS_MODIF_TS) ;
 
+                if(node_index == DirectoryStorage::NO_INDEX)
+                    throw read_error("Wrong node index") ;
+
                 if(node_index >= mNodes.size())
-                    mNodes.resize(node_index+1,NULL) ;
+                    resizeNodeTable(node_index+1) ;
+
+                deleteFileNode(node_index) ;	// only when the file mentions the same node twice
+                deleteNode(node_index) ;
 
-                DirEntry *de = new DirEntry(dir_name) ;
-                de->dir_name         = dir_name ;
-                de->dir_parent_path  = dir_parent_path ;
-                de->dir_hash         = dir_hash ;
+                // the parent path is not stored anymore, since it is rebuilt from the parent names.
+
+                createDirEntry(node_index,dir_name,dir_hash) ;
+
+                DirEntry *de = &dirEntry(node_index) ;
                 de->dir_modtime      = dir_modtime ;
                 de->dir_update_time  = dir_update_time ;
                 de->dir_most_recent_time = dir_most_recent_time ;
 
-                de->parent_index = parent_index ;
-                de->row = row ;
+                mNodes.parents[node_index] = parent_index ;
+                mNodes.rows[node_index] = row ;
 
                 uint32_t n_subdirs = 0 ;
                 uint32_t n_subfiles = 0 ;
@@ -1173,20 +1707,17 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
                     if(!FileListIO::readField(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,fi)) throw read_error(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER) ;
                     de->subfiles.push_back(fi) ;
                 }
-                mNodes[node_index] = de ;
-                mDirHashes[de->dir_hash] = node_index ;
             }
             else
                 throw read_error(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_FILE_ENTRY) ;
 
             free(node_section_data) ;
         }
-        free(buffer) ;
 
         std::string err_str ;
 
         if(!check(err_str))
-            std::cerr << "(EE) Error while loading file hierarchy " << fname << std::endl;
+            std::cerr << "(EE) Error while loading file hierarchy: " << err_str << std::endl;
 
         return true ;
     }
@@ -1195,9 +1726,6 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
 #ifdef DEBUG_DIRECTORY_STORAGE
         std::cerr << "Error while reading: " << e.what() << std::endl;
 #endif
-
-        if(buffer != NULL)
-            free(buffer) ;
         return false;
     }
 }
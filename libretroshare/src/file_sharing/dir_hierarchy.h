@@ -33,44 +33,37 @@ public:
     class FileStorageNode
     {
     public:
+        // Node types. The nodes themselves are rows of the tables below.
+
         static const uint32_t TYPE_UNKNOWN = 0x0000 ;
         static const uint32_t TYPE_FILE    = 0x0001 ;
         static const uint32_t TYPE_DIR     = 0x0002 ;
+    };
 
-        virtual ~FileStorageNode() {}
-        virtual uint32_t type() const =0;
+    // Used to pass file information in and out of the storage.
 
-        DirectoryStorage::EntryIndex parent_index;
-        uint32_t row ;
-    };
-    class FileEntry: public FileStorageNode
+    class FileEntry
     {
     public:
         FileEntry() : file_size(0), file_modtime(0) {}
         FileEntry(const std::string& name,uint64_t size,rstime_t modtime) : file_name(name),file_size(size),file_modtime(modtime) {}
         FileEntry(const std::string& name,uint64_t size,rstime_t modtime,const RsFileHash& hash) : file_name(name),file_size(size),file_modtime(modtime),file_hash(hash) {}
 
-        virtual uint32_t type() const { return FileStorageNode::TYPE_FILE ; }
-        virtual ~FileEntry() {}
-
-        // local stuff
         std::string file_name ;
         uint64_t    file_size ;
         rstime_t      file_modtime;
         RsFileHash  file_hash ;
     };
 
-    class DirEntry: public FileStorageNode
+    // Directory specific information. Directories are much less numerous than files, so they are kept in a single table.
+    // The name and parent are stored in the name pool and node table, and the parent path is computed when needed.
+
+    class DirEntry
     {
     public:
-        explicit DirEntry(const std::string& name) : dir_name(name), dir_modtime(0),dir_most_recent_time(0),dir_update_time(0) {}
-        virtual ~DirEntry() {}
-
-        virtual uint32_t type() const { return FileStorageNode::TYPE_DIR ; }
+        DirEntry() : dir_name_id(0), dir_modtime(0),dir_most_recent_time(0),dir_update_time(0) {}
 
-        // local stuff
-        std::string dir_name ;
-        std::string dir_parent_path ;
+        uint32_t    dir_name_id ;	// offset of the name in the name pool
         RsFileHash  dir_hash ;
 
         std::vector<DirectoryStorage::EntryIndex> subdirs ;
@@ -84,9 +77,21 @@ public:
     // class stuff
     InternalFileHierarchyStorage() ;
 
-    bool load(const std::string& fname) ;
+    // Files are saved with a summary section first, so that the summary can be read without the hierarchy.
+    // old_format is set when the file was written by an older version, and only holds the hierarchy.
+
+    bool load(const std::string& fname,bool& old_format) ;
     bool save(const std::string& fname) ;
 
+    bool serialise(unsigned char *& buffer,uint32_t& buffer_size) const ;
+    bool deserialise(const unsigned char *buffer,uint32_t buffer_size) ;
+
+    void getSummary(DirectoryStorage::Summary& summary) const ;
+    void getSyncEntries(std::vector<DirectoryStorage::EntryIndex>& entries) const ;	// root, and directories that have never been updated
+
+    uint64_t memoryUsage() const ;	// approximate, in bytes
+    void clear() ;					// removes everything but the root directory, and gives the memory back
+
     int parentRow(DirectoryStorage::EntryIndex e);
     bool isIndexValid(DirectoryStorage::EntryIndex e) const;
     bool getChildIndex(DirectoryStorage::EntryIndex e,int row,DirectoryStorage::EntryIndex& c) const;
@@ -118,8 +123,6 @@ public:
     bool findSubDirectory(DirectoryStorage::EntryIndex e,const std::string& s) const ;	// returns true when s is the name of a sub-directory in the given entry e
 
     uint32_t mRoot ;
-    std::list<uint32_t > mFreeNodes ;	// keeps a list of free nodes in order to make insert effcieint
-    std::vector<FileStorageNode*> mNodes;// uses pointers to keep information about valid/invalid objects.
 
     void compress() ;					// use empty space in the vector, mostly due to deleted entries. This is a complicated operation, mostly due to
                                             // all the indirections used. Nodes need to be moved, renamed, etc. The operation discards all file entries that
@@ -130,16 +133,24 @@ public:
 
     // Low level stuff. Should normally not be used externally.
 
-    const FileStorageNode *getNode(DirectoryStorage::EntryIndex indx) const;
-    const DirEntry *getDirEntry(DirectoryStorage::EntryIndex indx) const;
-    const FileEntry *getFileEntry(DirectoryStorage::EntryIndex indx) const;
+    const DirEntry *getDirEntry(DirectoryStorage::EntryIndex indx) const;	// the pointer is only valid until the hierarchy is modified
     uint32_t getType(DirectoryStorage::EntryIndex indx) const;
+    DirectoryStorage::EntryIndex getParentIndex(DirectoryStorage::EntryIndex indx) const;
     DirectoryStorage::EntryIndex getSubFileIndex(DirectoryStorage::EntryIndex parent_index,uint32_t file_tab_index);
     DirectoryStorage::EntryIndex getSubDirIndex(DirectoryStorage::EntryIndex parent_index,uint32_t dir_tab_index);
 
-    // search. SearchHash is logarithmic. The other two are linear.
+    // Field access. Return an empty value when the index is not of the right type.
+
+    std::string getName(DirectoryStorage::EntryIndex indx) const;			// file or directory name
+    std::string getDirPath(DirectoryStorage::EntryIndex indx) const;			// path of the directory, including its own name
+    uint64_t    getFileSize(DirectoryStorage::EntryIndex indx) const;
+    rstime_t      getFileModTime(DirectoryStorage::EntryIndex indx) const;
+    RsFileHash  getFileHash(DirectoryStorage::EntryIndex indx) const;
+
+    // search. SearchHash is constant time. The other two are linear.
 
     bool searchHash(const RsFileHash& hash, DirectoryStorage::EntryIndex &result);
+    void getFileHashes(std::vector<RsFileHash>& hashes) const ;	// appends the hashes of all files
     int searchBoolExp(RsRegularExpression::Expression * exp, std::list<DirectoryStorage::EntryIndex> &results) const ;
     int searchTerms(const std::list<std::string>& terms, std::list<DirectoryStorage::EntryIndex> &results) const ;		// does a logical OR between items of the list of terms
 
@@ -152,13 +163,89 @@ public:
     void getStatistics(SharedDirStats& stats) const ;
 
 private:
+    // Stores each distinct name only once, and refers to it by its offset. Names are mostly
+    // repeated between friends and directories (e.g. "01 - Intro.mp3", "cover.jpg").
+    // Names of deleted entries are only reclaimed when the pool is rebuilt by check().
+
+    class NamePool
+    {
+    public:
+        NamePool() : mCount(0) {}
+
+        uint32_t intern(const std::string& name) { return intern(name.c_str(),name.size()) ; }
+        uint32_t intern(const char *data,uint32_t size) ;
+
+        std::string name(uint32_t id) const ;
+        const char *nameData(uint32_t id,uint32_t& size) const ;
+
+        size_t dataSize() const { return mData.size() ; }
+        size_t memoryUsage() const { return mData.capacity() + mTable.capacity()*sizeof(uint32_t) ; }
+        void clear() ;
+
+    private:
+        static uint32_t hashName(const char *data,uint32_t len) ;
+        uint32_t nameSize(uint32_t id) const ;
+        void growTable() ;
+
+        std::vector<char> mData ;		// for each name, its size on 4 bytes followed by its characters
+        std::vector<uint32_t> mTable ;	// open addressing hash table of id+1, 0 meaning an empty slot
+        uint32_t mCount ;
+    };
+
+    // Map from file or directory hashes to entry indexes. Slots only hold the entry index; the key
+    // is read back from the entry itself. So the index must be updated each time a hash changes or
+    // an entry is removed. Uses linear probing, with a 4 bytes slot instead of a ~80 bytes std::map node.
+
+    class HashIndex
+    {
+    public:
+        typedef RsFileHash (InternalFileHierarchyStorage::*KeyFunction)(DirectoryStorage::EntryIndex) const ;
+
+        HashIndex(const InternalFileHierarchyStorage *storage,KeyFunction key) ;
+
+        bool find(const RsFileHash& hash,DirectoryStorage::EntryIndex& index) const ;
+        void insert(const RsFileHash& hash,DirectoryStorage::EntryIndex index) ;	// replaces the entry with the same hash, if any
+        void erase(const RsFileHash& hash,DirectoryStorage::EntryIndex index) ;	// only if the hash points to that index
+        void clear() ;
+
+        uint32_t size() const { return mCount ; }
+        size_t memoryUsage() const { return mSlots.capacity()*sizeof(uint32_t) ; }
+        const std::vector<uint32_t>& slots() const { return mSlots ; }	// for iterating. Empty slots are NO_INDEX.
+
+    private:
+        uint32_t slotOf(const RsFileHash& hash,uint32_t mask) const ;
+        uint32_t findSlot(const RsFileHash& hash) const ;	// returns NO_INDEX when absent
+        void grow() ;
+
+        const InternalFileHierarchyStorage *mStorage ;
+        KeyFunction mKey ;
+        std::vector<uint32_t> mSlots ;
+        uint32_t mCount ;
+        uint64_t mSeed ;
+    };
+
     void recursPrint(int depth,DirectoryStorage::EntryIndex node) const;
     static bool nodeAccessError(const std::string& s);
     static RsFileHash createDirHash(const std::string& dir_name, const RsFileHash &dir_parent_hash, const RsFileHash &random_hash_salt) ;
 
+    std::string getDirParentPath(DirectoryStorage::EntryIndex indx) const ;
+    RsFileHash getDirHash(DirectoryStorage::EntryIndex indx) const ;
+
     // Allocates a new entry in mNodes, possible re-using an empty slot and returns its index.
 
     DirectoryStorage::EntryIndex allocateNewIndex();
+    DirectoryStorage::EntryIndex appendNewIndex();
+    void resizeNodeTable(uint32_t size) ;
+
+    // Fill a free node with a new file or directory.
+
+    void createFileEntry(DirectoryStorage::EntryIndex indx,const std::string& name,uint64_t size,rstime_t modtime,const RsFileHash& hash) ;
+    void createDirEntry(DirectoryStorage::EntryIndex indx,const std::string& name,const RsFileHash& hash) ;
+    void removeFileSlot(uint32_t slot) ;
+    void removeDirSlot(uint32_t slot) ;
+
+    DirEntry& dirEntry(DirectoryStorage::EntryIndex indx) { return mDirs.entries[mNodes.slots[indx]] ; }
+    const DirEntry& dirEntry(DirectoryStorage::EntryIndex indx) const { return mDirs.entries[mNodes.slots[indx]] ; }
 
     // Deletes an existing entry in mNodes, and keeps record of the indices that get freed.
 
@@ -170,12 +257,51 @@ private:
 
     bool recursRemoveDirectory(DirectoryStorage::EntryIndex dir);
 
-    // Map of the hash of all files. The file hashes are the sha1sum of the file data.
+    void clearTables() ;
+    void rebuildNamePool() ;
+
+    // The node table gives the type and place in the hierarchy of each entry index. Type specific
+    // information is in the file and dir tables, at the position given by "slots". Tables are
+    // kept dense: removing an entry moves the last one in its place.
+
+    struct NodeTable
+    {
+        std::vector<uint8_t>  types ;		// TYPE_UNKNOWN for free nodes
+        std::vector<uint32_t> parents ;
+        std::vector<uint32_t> rows ;
+        std::vector<uint32_t> slots ;
+
+        uint32_t size() const { return types.size() ; }
+    } mNodes ;
+
+    struct FileTable
+    {
+        std::vector<uint32_t>   names ;		// ids in mNames
+        std::vector<uint64_t>   sizes ;
+        std::vector<uint32_t>   modtimes ;	// 32 bits, like in the file list format
+        std::vector<RsFileHash> hashes ;
+        std::vector<uint32_t>   nodes ;		// entry index of each file
+
+        uint32_t size() const { return nodes.size() ; }
+    } mFiles ;
+
+    struct DirTable
+    {
+        std::vector<DirEntry> entries ;
+        std::vector<uint32_t> nodes ;		// entry index of each directory
+
+        uint32_t size() const { return nodes.size() ; }
+    } mDirs ;
+
+    std::vector<uint32_t> mFreeNodes ;	// keeps a list of free nodes in order to make insert effcieint
+    NamePool mNames ;
+
+    // Index of the hash of all files. The file hashes are the sha1sum of the file data.
     // is used for fast search access for FT.
-    // Note: We should try something faster than std::map. hash_map??
     // Unlike directories, multiple files may have the same hash. So this cannot be used for anything else than FT.
+    // Files that are not hashed yet are not in the index.
 
-    std::map<RsFileHash,DirectoryStorage::EntryIndex> mFileHashes ;
+    HashIndex mFileHashes ;
 
     // The directory hashes are the sha1sum of the
     // full public path to the directory.
@@ -184,11 +310,10 @@ private:
     // This is kept separate from mFileHashes because the two are used
     // in very different ways.
     //
-    std::map<RsFileHash,DirectoryStorage::EntryIndex> mDirHashes ;
+    HashIndex mDirHashes ;
 
     // high level statistics on the full hierarchy. Should be kept up to date.
 
     uint32_t mTotalFiles ;
     uint64_t mTotalSize ;
 };
-
@@ -29,6 +29,7 @@
 #include "directory_storage.h"
 #include "dir_hierarchy.h"
 #include "filelist_io.h"
+#include "turtle/turtlehashfilter.h"
 
 //#define DEBUG_REMOTE_DIRECTORY_STORAGE 1
 
@@ -68,27 +69,135 @@ DirectoryStorage::EntryIndex DirectoryStorage::DirIterator ::operator*() const {
 DirectoryStorage::FileIterator::operator bool() const { return **this != DirectoryStorage::NO_INDEX; }
 DirectoryStorage::DirIterator ::operator bool() const { return **this != DirectoryStorage::NO_INDEX; }
 
-RsFileHash  DirectoryStorage::FileIterator::hash()     const { const InternalFileHierarchyStorage::FileEntry *f = mStorage->getFileEntry(**this) ; return f?(f->file_hash):RsFileHash(); }
-uint64_t    DirectoryStorage::FileIterator::size()     const { const InternalFileHierarchyStorage::FileEntry *f = mStorage->getFileEntry(**this) ; return f?(f->file_size):0; }
-std::string DirectoryStorage::FileIterator::name()     const { const InternalFileHierarchyStorage::FileEntry *f = mStorage->getFileEntry(**this) ; return f?(f->file_name):std::string(); }
-rstime_t      DirectoryStorage::FileIterator::modtime()  const { const InternalFileHierarchyStorage::FileEntry *f = mStorage->getFileEntry(**this) ; return f?(f->file_modtime):0; }
+RsFileHash  DirectoryStorage::FileIterator::hash()     const { return mStorage->getFileHash(**this) ; }
+uint64_t    DirectoryStorage::FileIterator::size()     const { return mStorage->getFileSize(**this) ; }
+std::string DirectoryStorage::FileIterator::name()     const { return mStorage->getName(**this) ; }
+rstime_t      DirectoryStorage::FileIterator::modtime()  const { return mStorage->getFileModTime(**this) ; }
 
-std::string DirectoryStorage::DirIterator::name()      const { const InternalFileHierarchyStorage::DirEntry *d = mStorage->getDirEntry(**this) ; return d?(d->dir_name):std::string(); }
+std::string DirectoryStorage::DirIterator::name()      const { return mStorage->getName(**this) ; }
 
 /******************************************************************************************************************/
 /*                                                 Directory Storage                                              */
 /******************************************************************************************************************/
 
-DirectoryStorage::DirectoryStorage(const RsPeerId &pid,const std::string& fname)
-    : mPeerId(pid), mDirStorageMtx("Directory storage "+pid.toStdString()),mLastSavedTime(0),mChanged(false),mFileName(fname)
+DirectoryStorage::DirectoryStorage(const RsPeerId &pid,const std::string& fname,bool load_on_demand)
+    : mPeerId(pid), mDirStorageMtx("Directory storage "+pid.toStdString()),mLastSavedTime(0),mChanged(false),mFileName(fname),mLoaded(true),mLastAccessTime(time(NULL))
 {
 	{
 		RS_STACK_MUTEX(mDirStorageMtx) ;
 		mFileHierarchy = new InternalFileHierarchyStorage();
+
+        if(load_on_demand && locked_loadSummary(fname))
+        {
+            mLoaded = false ;
+            return ;
+        }
 	}
     load(fname) ;
 }
 
+InternalFileHierarchyStorage *DirectoryStorage::locked_getHierarchy() const
+{
+    mLastAccessTime = time(NULL) ;
+
+    if(mLoaded)
+        return mFileHierarchy ;
+
+    bool old_format = false ;
+
+    if(mFileHierarchy->load(mFileName,old_format))
+    {
+        // time stamps may have been updated since the summary was saved
+
+        for(uint32_t i=0;i<mSummary.dirs.size();++i)
+        {
+            rstime_t update_TS = mSummary.dirs[i].update_TS ;
+            rstime_t recurs_modf_TS = mSummary.dirs[i].recurs_modf_TS ;
+
+            mFileHierarchy->setTS(mSummary.dirs[i].index,update_TS,&InternalFileHierarchyStorage::DirEntry::dir_update_time) ;
+            mFileHierarchy->setTS(mSummary.dirs[i].index,recurs_modf_TS,&InternalFileHierarchyStorage::DirEntry::dir_most_recent_time) ;
+        }
+    }
+    else
+        std::cerr << "(EE) Cannot load file list " << mFileName << ". It will be synced again." << std::endl;	// the root update TS is 0, so the list will be requested again
+
+    mSummary.clear() ;
+    mLoaded = true ;
+
+    return mFileHierarchy ;
+}
+
+bool DirectoryStorage::locked_loadSummary(const std::string& local_file_name)
+{
+    unsigned char *data = NULL ;
+    uint32_t size = 0 ;
+
+    if(!FileListIO::loadEncryptedSectionFromFile(local_file_name,FILE_LIST_IO_SECTION_DIRECTORY_SUMMARY,data,size))
+        return false ;
+
+    bool res = mSummary.deserialise(data,size) ;
+    free(data) ;
+
+    if(!res)
+        mSummary.clear() ;
+
+    return res ;
+}
+
+bool DirectoryStorage::unload()
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    if(!mLoaded)
+        return true ;
+
+    if(mChanged)
+    {
+        locked_check();
+
+        if(!mFileHierarchy->save(mFileName))
+            return false ;
+
+        mLastSavedTime = time(NULL) ;
+        mChanged = false ;
+    }
+
+    mFileHierarchy->getSummary(mSummary) ;
+    mFileHierarchy->clear() ;
+    mLoaded = false ;
+
+    return true ;
+}
+
+bool DirectoryStorage::isLoaded() const
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+    return mLoaded ;
+}
+rstime_t DirectoryStorage::lastAccessTime() const
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+    return mLastAccessTime ;
+}
+uint64_t DirectoryStorage::memoryUsage() const
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+    return mFileHierarchy->memoryUsage() + mSummary.memoryUsage() ;
+}
+
+void DirectoryStorage::getSyncEntries(std::vector<EntryIndex>& entries) const
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    if(mLoaded)
+        return mFileHierarchy->getSyncEntries(entries) ;
+
+    entries.clear() ;
+
+    for(uint32_t i=0;i<mSummary.dirs.size();++i)
+        entries.push_back(mSummary.dirs[i].index) ;
+}
+
 DirectoryStorage::EntryIndex DirectoryStorage::root() const
 {
     return EntryIndex(0) ;
@@ -97,20 +206,20 @@ int DirectoryStorage::parentRow(EntryIndex e) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
 
-    return mFileHierarchy->parentRow(e) ;
+    return locked_getHierarchy()->parentRow(e) ;
 }
 bool DirectoryStorage::getChildIndex(EntryIndex e,int row,EntryIndex& c) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
 
-    return mFileHierarchy->getChildIndex(e,row,c) ;
+    return locked_getHierarchy()->getChildIndex(e,row,c) ;
 }
 
 uint32_t DirectoryStorage::getEntryType(const EntryIndex& indx)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
 
-    switch(mFileHierarchy->getType(indx))
+    switch(locked_getHierarchy()->getType(indx))
     {
     case InternalFileHierarchyStorage::FileStorageNode::TYPE_DIR:  return DIR_TYPE_DIR ;
     case InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE: return DIR_TYPE_FILE ;
@@ -119,32 +228,62 @@ uint32_t DirectoryStorage::getEntryType(const EntryIndex& indx)
     }
 }
 
-bool DirectoryStorage::getDirectoryUpdateTime   (EntryIndex index,rstime_t& update_TS) const { RS_STACK_MUTEX(mDirStorageMtx) ; return mFileHierarchy->getTS(index,update_TS,&InternalFileHierarchyStorage::DirEntry::dir_update_time     ); }
-bool DirectoryStorage::getDirectoryRecursModTime(EntryIndex index,rstime_t& rec_md_TS) const { RS_STACK_MUTEX(mDirStorageMtx) ; return mFileHierarchy->getTS(index,rec_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_most_recent_time); }
-bool DirectoryStorage::getDirectoryLocalModTime (EntryIndex index,rstime_t& loc_md_TS) const { RS_STACK_MUTEX(mDirStorageMtx) ; return mFileHierarchy->getTS(index,loc_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_modtime         ); }
+// The update and recursive modification TS of the directories in the summary are used by the sync system,
+// and can be read and written without loading the hierarchy.
+
+bool DirectoryStorage::locked_getSummaryTS(EntryIndex index,rstime_t& TS,rstime_t Summary::DirSyncInfo::* m) const
+{
+    if(mLoaded)
+        return false ;
+
+    Summary::DirSyncInfo *info = mSummary.findDir(index) ;
+
+    if(!info)
+        return false ;
+
+    TS = info->*m ;
+    return true ;
+}
+bool DirectoryStorage::locked_setSummaryTS(EntryIndex index,rstime_t TS,rstime_t Summary::DirSyncInfo::* m)
+{
+    if(mLoaded)
+        return false ;
+
+    Summary::DirSyncInfo *info = mSummary.findDir(index) ;
+
+    if(!info)
+        return false ;
+
+    info->*m = TS ;
+    return true ;
+}
+
+bool DirectoryStorage::getDirectoryUpdateTime   (EntryIndex index,rstime_t& update_TS) const { RS_STACK_MUTEX(mDirStorageMtx) ; return locked_getSummaryTS(index,update_TS,&Summary::DirSyncInfo::update_TS     ) || locked_getHierarchy()->getTS(index,update_TS,&InternalFileHierarchyStorage::DirEntry::dir_update_time     ); }
+bool DirectoryStorage::getDirectoryRecursModTime(EntryIndex index,rstime_t& rec_md_TS) const { RS_STACK_MUTEX(mDirStorageMtx) ; return locked_getSummaryTS(index,rec_md_TS,&Summary::DirSyncInfo::recurs_modf_TS) || locked_getHierarchy()->getTS(index,rec_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_most_recent_time); }
+bool DirectoryStorage::getDirectoryLocalModTime (EntryIndex index,rstime_t& loc_md_TS) const { RS_STACK_MUTEX(mDirStorageMtx) ; return locked_getHierarchy()->getTS(index,loc_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_modtime         ); }
 
-bool DirectoryStorage::setDirectoryUpdateTime   (EntryIndex index,rstime_t  update_TS) { RS_STACK_MUTEX(mDirStorageMtx) ; return mFileHierarchy->setTS(index,update_TS,&InternalFileHierarchyStorage::DirEntry::dir_update_time     ); }
-bool DirectoryStorage::setDirectoryRecursModTime(EntryIndex index,rstime_t  rec_md_TS) { RS_STACK_MUTEX(mDirStorageMtx) ; return mFileHierarchy->setTS(index,rec_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_most_recent_time); }
-bool DirectoryStorage::setDirectoryLocalModTime (EntryIndex index,rstime_t  loc_md_TS) { RS_STACK_MUTEX(mDirStorageMtx) ; return mFileHierarchy->setTS(index,loc_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_modtime         ); }
+bool DirectoryStorage::setDirectoryUpdateTime   (EntryIndex index,rstime_t  update_TS) { RS_STACK_MUTEX(mDirStorageMtx) ; return locked_setSummaryTS(index,update_TS,&Summary::DirSyncInfo::update_TS     ) || locked_getHierarchy()->setTS(index,update_TS,&InternalFileHierarchyStorage::DirEntry::dir_update_time     ); }
+bool DirectoryStorage::setDirectoryRecursModTime(EntryIndex index,rstime_t  rec_md_TS) { RS_STACK_MUTEX(mDirStorageMtx) ; return locked_setSummaryTS(index,rec_md_TS,&Summary::DirSyncInfo::recurs_modf_TS) || locked_getHierarchy()->setTS(index,rec_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_most_recent_time); }
+bool DirectoryStorage::setDirectoryLocalModTime (EntryIndex index,rstime_t  loc_md_TS) { RS_STACK_MUTEX(mDirStorageMtx) ; return locked_getHierarchy()->setTS(index,loc_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_modtime         ); }
 
 bool DirectoryStorage::updateSubDirectoryList(const EntryIndex& indx, const std::set<std::string> &subdirs, const RsFileHash& hash_salt)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    bool res = mFileHierarchy->updateSubDirectoryList(indx,subdirs,hash_salt) ;
+    bool res = locked_getHierarchy()->updateSubDirectoryList(indx,subdirs,hash_salt) ;
     mChanged = true ;
     return res ;
 }
 bool DirectoryStorage::updateSubFilesList(const EntryIndex& indx,const std::map<std::string,FileTS>& subfiles,std::map<std::string,FileTS>& new_files)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    bool res = mFileHierarchy->updateSubFilesList(indx,subfiles,new_files) ;
+    bool res = locked_getHierarchy()->updateSubFilesList(indx,subfiles,new_files) ;
     mChanged = true ;
     return res ;
 }
 bool DirectoryStorage::removeDirectory(const EntryIndex& indx)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    bool res = mFileHierarchy->removeDirectory(indx);
+    bool res = locked_getHierarchy()->removeDirectory(indx);
     mChanged = true ;
 
     return res ;
@@ -160,49 +299,65 @@ void DirectoryStorage::locked_check()
 void DirectoryStorage::getStatistics(SharedDirStats& stats)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    if(!mLoaded)
+    {
+        stats = mSummary.stats ;
+        return ;
+    }
     mFileHierarchy->getStatistics(stats);
 }
 
 bool DirectoryStorage::load(const std::string& local_file_name)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    mChanged = false ;
-    return mFileHierarchy->load(local_file_name);
+
+    bool old_format = false ;
+    bool res = mFileHierarchy->load(local_file_name,old_format);
+
+    mLoaded = true ;
+    mChanged = res && old_format ;	// files from older versions are saved again in the new format
+
+    return res ;
 }
 void DirectoryStorage::save(const std::string& local_file_name)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    mFileHierarchy->save(local_file_name);
+
+    if(mLoaded)	// otherwise the file is already up to date
+        mFileHierarchy->save(local_file_name);
 }
 void DirectoryStorage::print()
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    mFileHierarchy->print();
+    locked_getHierarchy()->print();
 }
 
 int DirectoryStorage::searchTerms(const std::list<std::string>& terms, std::list<EntryIndex> &results) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    return mFileHierarchy->searchTerms(terms,results);
+    return locked_getHierarchy()->searchTerms(terms,results);
 }
 int DirectoryStorage::searchBoolExp(RsRegularExpression::Expression * exp, std::list<EntryIndex> &results) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    return mFileHierarchy->searchBoolExp(exp,results);
+    return locked_getHierarchy()->searchBoolExp(exp,results);
 }
 
 bool DirectoryStorage::extractData(const EntryIndex& indx,DirDetails& d)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
 
+    InternalFileHierarchyStorage *hierarchy = locked_getHierarchy() ;
+
     d.children.clear() ;
-    uint32_t type = mFileHierarchy->getType(indx) ;
+    uint32_t type = hierarchy->getType(indx) ;
 
     d.ref = (void*)(intptr_t)indx ;
 
     if (type == InternalFileHierarchyStorage::FileStorageNode::TYPE_DIR) /* has children --- fill */
     {
-        const InternalFileHierarchyStorage::DirEntry *dir_entry = mFileHierarchy->getDirEntry(indx) ;
+        const InternalFileHierarchyStorage::DirEntry *dir_entry = hierarchy->getDirEntry(indx) ;
 
         /* extract all the entries */
 
@@ -231,9 +386,9 @@ bool DirectoryStorage::extractData(const EntryIndex& indx,DirDetails& d)
         d.count   = dir_entry->subdirs.size() + dir_entry->subfiles.size();
         d.max_mtime = dir_entry->dir_most_recent_time ;
         d.mtime     = dir_entry->dir_modtime ;
-        d.name    = dir_entry->dir_name;
-		d.path    = RsDirUtil::makePath(dir_entry->dir_parent_path, dir_entry->dir_name) ;
-        d.parent  = (void*)(intptr_t)dir_entry->parent_index ;
+        d.name    = hierarchy->getName(indx);
+		d.path    = hierarchy->getDirPath(indx) ;
+        d.parent  = (void*)(intptr_t)hierarchy->getParentIndex(indx) ;
 
         if(indx == 0)
         {
@@ -243,20 +398,18 @@ bool DirectoryStorage::extractData(const EntryIndex& indx,DirDetails& d)
     }
     else if(type == InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE)
     {
-        const InternalFileHierarchyStorage::FileEntry *file_entry = mFileHierarchy->getFileEntry(indx) ;
+        DirectoryStorage::EntryIndex parent_index = hierarchy->getParentIndex(indx) ;
 
         d.type    = DIR_TYPE_FILE;
-        d.count   = file_entry->file_size;
-        d.max_mtime = file_entry->file_modtime ;
-        d.name    = file_entry->file_name;
-        d.hash    = file_entry->file_hash;
-        d.mtime     = file_entry->file_modtime;
-        d.parent  = (void*)(intptr_t)file_entry->parent_index ;
-
-        const InternalFileHierarchyStorage::DirEntry *parent_dir_entry = mFileHierarchy->getDirEntry(file_entry->parent_index);
-
-        if(parent_dir_entry != NULL)
-			d.path = RsDirUtil::makePath(parent_dir_entry->dir_parent_path, parent_dir_entry->dir_name) ;
+        d.count   = hierarchy->getFileSize(indx);
+        d.max_mtime = hierarchy->getFileModTime(indx) ;
+        d.name    = hierarchy->getName(indx);
+        d.hash    = hierarchy->getFileHash(indx);
+        d.mtime     = d.max_mtime;
+        d.parent  = (void*)(intptr_t)parent_index ;
+
+        if(hierarchy->getType(parent_index) == InternalFileHierarchyStorage::FileStorageNode::TYPE_DIR)
+			d.path = hierarchy->getDirPath(parent_index) ;
         else
             d.path = "" ;
     }
@@ -271,12 +424,28 @@ bool DirectoryStorage::extractData(const EntryIndex& indx,DirDetails& d)
 bool DirectoryStorage::getDirHashFromIndex(const EntryIndex& index,RsFileHash& hash) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    return mFileHierarchy->getDirHashFromIndex(index,hash) ;
+
+    Summary::DirSyncInfo *info = mLoaded?NULL:mSummary.findDir(index) ;
+
+    if(info)
+    {
+        hash = info->hash ;
+        return true ;
+    }
+    return locked_getHierarchy()->getDirHashFromIndex(index,hash) ;
 }
 bool DirectoryStorage::getIndexFromDirHash(const RsFileHash& hash,EntryIndex& index) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    return mFileHierarchy->getIndexFromDirHash(hash,index) ;
+
+    Summary::DirSyncInfo *info = mLoaded?NULL:mSummary.findDir(hash) ;
+
+    if(info)
+    {
+        index = info->index ;
+        return true ;
+    }
+    return locked_getHierarchy()->getIndexFromDirHash(hash,index) ;
 }
 
 void DirectoryStorage::checkSave()
@@ -299,6 +468,185 @@ void DirectoryStorage::checkSave()
 	   }
 	}
 }
+
+/******************************************************************************************************************/
+/*                                           Directory Storage Summary                                            */
+/******************************************************************************************************************/
+
+void DirectoryStorage::Summary::clear()
+{
+    std::vector<DirSyncInfo>().swap(dirs) ;
+    std::vector<uint8_t>().swap(mFileHashFilter) ;
+
+    stats.total_number_of_files = 0 ;
+    stats.total_shared_size = 0 ;
+}
+
+DirectoryStorage::Summary::DirSyncInfo *DirectoryStorage::Summary::findDir(EntryIndex index)
+{
+    for(uint32_t i=0;i<dirs.size();++i)
+        if(dirs[i].index == index)
+            return &dirs[i] ;
+
+    return NULL ;
+}
+DirectoryStorage::Summary::DirSyncInfo *DirectoryStorage::Summary::findDir(const RsFileHash& hash)
+{
+    for(uint32_t i=0;i<dirs.size();++i)
+        if(dirs[i].hash == hash)
+            return &dirs[i] ;
+
+    return NULL ;
+}
+
+// The bit positions are computed from two words of the hash (Kirsch-Mitzenmacher), since file hashes are already uniformly distributed.
+
+static void fileHashFilterProbes(const RsFileHash& hash,uint32_t& h1,uint32_t& h2)
+{
+    const unsigned char *bytes = hash.toByteArray() ;
+
+    h1 = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24) ;
+    h2 = (uint32_t)bytes[4] | ((uint32_t)bytes[5] << 8) | ((uint32_t)bytes[6] << 16) | ((uint32_t)bytes[7] << 24) ;
+    h2 |= 1 ;
+}
+
+void DirectoryStorage::Summary::initFileHashFilter(uint32_t n_files)
+{
+    if(n_files == 0)
+        std::vector<uint8_t>().swap(mFileHashFilter) ;
+    else
+        std::vector<uint8_t>(std::max(8u,(n_files*FILE_HASH_FILTER_BITS_PER_FILE + 7)/8),0).swap(mFileHashFilter) ;
+}
+
+void DirectoryStorage::Summary::addFileHash(const RsFileHash& hash)
+{
+    if(mFileHashFilter.empty())
+        initFileHashFilter(1) ;
+
+    uint32_t nbits = mFileHashFilter.size()*8 ;
+    uint32_t h1,h2 ;
+    fileHashFilterProbes(hash,h1,h2) ;
+
+    for(uint32_t i=0;i<FILE_HASH_FILTER_NB_HASH_FUNCTIONS;++i)
+    {
+        uint32_t bit = (h1 + i*h2) % nbits ;
+        mFileHashFilter[bit >> 3] |= 1 << (bit & 7) ;
+    }
+}
+
+bool DirectoryStorage::Summary::mayContainFileHash(const RsFileHash& hash) const
+{
+    if(mFileHashFilter.empty())
+        return false ;
+
+    uint32_t nbits = mFileHashFilter.size()*8 ;
+    uint32_t h1,h2 ;
+    fileHashFilterProbes(hash,h1,h2) ;
+
+    for(uint32_t i=0;i<FILE_HASH_FILTER_NB_HASH_FUNCTIONS;++i)
+    {
+        uint32_t bit = (h1 + i*h2) % nbits ;
+
+        if(!(mFileHashFilter[bit >> 3] & (1 << (bit & 7))))
+            return false ;
+    }
+    return true ;
+}
+
+uint64_t DirectoryStorage::Summary::memoryUsage() const
+{
+    return sizeof(*this) + dirs.capacity()*sizeof(DirSyncInfo) + mFileHashFilter.capacity() ;
+}
+
+bool DirectoryStorage::Summary::serialise(unsigned char *& data,uint32_t& size) const
+{
+    unsigned char *buffer = NULL ;
+    uint32_t buffer_size = 0 ;
+    uint32_t offset = 0 ;
+
+    bool ok = FileListIO::writeField(buffer,buffer_size,offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION,(uint32_t)FILE_LIST_IO_DIRECTORY_SUMMARY_VERSION_0001)
+            && FileListIO::writeField(buffer,buffer_size,offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)stats.total_number_of_files)
+            && FileListIO::writeField(buffer,buffer_size,offset,FILE_LIST_IO_TAG_FILE_SIZE ,(uint64_t)stats.total_shared_size)
+            && FileListIO::writeField(buffer,buffer_size,offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)dirs.size()) ;
+
+    for(uint32_t i=0;ok && i<dirs.size();++i)
+        ok = FileListIO::writeField(buffer,buffer_size,offset,FILE_LIST_IO_TAG_ENTRY_INDEX    ,(uint32_t)dirs[i].index)
+                && FileListIO::writeField(buffer,buffer_size,offset,FILE_LIST_IO_TAG_DIR_HASH       ,dirs[i].hash)
+                && FileListIO::writeField(buffer,buffer_size,offset,FILE_LIST_IO_TAG_UPDATE_TS      ,(uint32_t)dirs[i].update_TS)
+                && FileListIO::writeField(buffer,buffer_size,offset,FILE_LIST_IO_TAG_RECURS_MODIF_TS,(uint32_t)dirs[i].recurs_modf_TS) ;
+
+    ok = ok && FileListIO::writeField(buffer,buffer_size,offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)mFileHashFilter.size())
+            && FileListIO::writeField(buffer,buffer_size,offset,FILE_LIST_IO_TAG_BINARY_DATA,mFileHashFilter.empty()?NULL:&mFileHashFilter[0],(uint32_t)mFileHashFilter.size()) ;
+
+    if(!ok)
+    {
+        free(buffer) ;
+        return false ;
+    }
+
+    data = buffer ;
+    size = offset ;
+
+    return true ;
+}
+
+bool DirectoryStorage::Summary::deserialise(const unsigned char *data,uint32_t size)
+{
+    uint32_t offset = 0 ;
+    uint32_t version = 0 ;
+    uint32_t n_files = 0 ;
+    uint64_t total_size = 0 ;
+    uint32_t n_dirs = 0 ;
+
+    clear() ;
+
+    if(!FileListIO::readField(data,size,offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION,version) || version != FILE_LIST_IO_DIRECTORY_SUMMARY_VERSION_0001
+            || !FileListIO::readField(data,size,offset,FILE_LIST_IO_TAG_RAW_NUMBER,n_files)
+            || !FileListIO::readField(data,size,offset,FILE_LIST_IO_TAG_FILE_SIZE ,total_size)
+            || !FileListIO::readField(data,size,offset,FILE_LIST_IO_TAG_RAW_NUMBER,n_dirs))
+        return false ;
+
+    stats.total_number_of_files = n_files ;
+    stats.total_shared_size = total_size ;
+
+    for(uint32_t i=0;i<n_dirs;++i)
+    {
+        DirSyncInfo info ;
+        uint32_t update_TS = 0 ;
+        uint32_t recurs_modf_TS = 0 ;
+
+        if(!FileListIO::readField(data,size,offset,FILE_LIST_IO_TAG_ENTRY_INDEX    ,info.index)
+                || !FileListIO::readField(data,size,offset,FILE_LIST_IO_TAG_DIR_HASH       ,info.hash)
+                || !FileListIO::readField(data,size,offset,FILE_LIST_IO_TAG_UPDATE_TS      ,update_TS)
+                || !FileListIO::readField(data,size,offset,FILE_LIST_IO_TAG_RECURS_MODIF_TS,recurs_modf_TS))
+            return false ;
+
+        info.update_TS = update_TS ;
+        info.recurs_modf_TS = recurs_modf_TS ;
+
+        dirs.push_back(info) ;
+    }
+
+    // readField() returns the size of the allocated memory, so the size of the filter is stored before it.
+
+    unsigned char *filter_data = NULL ;
+    uint32_t filter_buffer_size = 0 ;
+    uint32_t filter_size = 0 ;
+
+    if(!FileListIO::readField(data,size,offset,FILE_LIST_IO_TAG_RAW_NUMBER,filter_size)
+            || !FileListIO::readField(data,size,offset,FILE_LIST_IO_TAG_BINARY_DATA,filter_data,filter_buffer_size)
+            || filter_size > filter_buffer_size)
+    {
+        free(filter_data) ;
+        return false ;
+    }
+
+    mFileHashFilter.assign(filter_data,filter_data+filter_size) ;
+    free(filter_data) ;
+
+    return !dirs.empty() ;	// the root is always there
+}
+
 /******************************************************************************************************************/
 /*                                           Local Directory Storage                                              */
 /******************************************************************************************************************/
@@ -306,6 +654,7 @@ void DirectoryStorage::checkSave()
 LocalDirectoryStorage::LocalDirectoryStorage(const std::string& fname,const RsPeerId& own_id)
     : DirectoryStorage(own_id,fname)
 {
+	mHashFilter = NULL ;
 	mTSChanged = false ;
 }
 
@@ -339,6 +688,22 @@ int LocalDirectoryStorage::searchHash(const RsFileHash& hash, RsFileHash& real_h
     return false ;
 }
 
+void LocalDirectoryStorage::setHashFilter(TurtleHashFilter *filter)
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+    mHashFilter = filter ;
+}
+
+void LocalDirectoryStorage::getFileHashes(std::vector<RsFileHash>& hashes) const
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    mFileHierarchy->getFileHashes(hashes) ;
+
+    for(std::map<RsFileHash,RsFileHash>::const_iterator it(mEncryptedHashes.begin());it!=mEncryptedHashes.end();++it)
+        hashes.push_back(it->first) ;
+}
+
 void LocalDirectoryStorage::setSharedDirectoryList(const std::list<SharedDirInfo>& lst)
 {
 	std::set<std::string> dirs_with_new_virtualname ;
@@ -505,9 +870,17 @@ bool LocalDirectoryStorage::updateHash(const EntryIndex& index, const RsFileHash
 {
 	RS_STACK_MUTEX(mDirStorageMtx) ;
 
-	mEncryptedHashes[makeEncryptedHash(hash)] = hash ;
+	RsFileHash encrypted_hash = makeEncryptedHash(hash) ;
+
+	mEncryptedHashes[encrypted_hash] = hash ;
 	mChanged = true ;
 
+	if(mHashFilter != NULL)
+	{
+		mHashFilter->add(hash) ;
+		mHashFilter->add(encrypted_hash) ;
+	}
+
 #ifdef DEBUG_LOCAL_DIRECTORY_STORAGE
     std::cerr << "Updating index of hash " << hash << " update_internal=" << update_internal_hierarchy << std::endl;
 #endif
@@ -594,24 +967,24 @@ bool LocalDirectoryStorage::locked_getFileSharingPermissions(const EntryIndex& i
 
     std::string base_dir;
 
-    const InternalFileHierarchyStorage::FileStorageNode *n = mFileHierarchy->getNode(indx) ;
+    uint32_t type = mFileHierarchy->getType(indx) ;
 
-    if(n == NULL)
+    if(type == InternalFileHierarchyStorage::FileStorageNode::TYPE_UNKNOWN)
         return false ;
 
-    for(DirectoryStorage::EntryIndex i=((n->type()==InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE)?((intptr_t)n->parent_index):indx);;)
+    for(DirectoryStorage::EntryIndex i=((type==InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE)?mFileHierarchy->getParentIndex(indx):indx);;)
     {
-        const InternalFileHierarchyStorage::DirEntry *e = mFileHierarchy->getDirEntry(i) ;
-
-        if(e == NULL)
+        if(mFileHierarchy->getType(i) != InternalFileHierarchyStorage::FileStorageNode::TYPE_DIR)
             break ;
 
-        if(e->parent_index == 0)
+        DirectoryStorage::EntryIndex parent_index = mFileHierarchy->getParentIndex(i) ;
+
+        if(parent_index == 0)
         {
-            base_dir = e->dir_name ;
+            base_dir = mFileHierarchy->getName(i) ;
             break ;
         }
-        i = e->parent_index ;
+        i = parent_index ;
     }
 
     if(!base_dir.empty())
@@ -636,16 +1009,16 @@ std::string LocalDirectoryStorage::locked_getVirtualDirName(EntryIndex indx) con
     if(indx == 0)
         return std::string() ;
 
-    const InternalFileHierarchyStorage::DirEntry *dir = mFileHierarchy->getDirEntry(indx);
+    std::string dir_name = mFileHierarchy->getName(indx) ;
 
-    if(dir->parent_index != 0)
-        return dir->dir_name ;
+    if(mFileHierarchy->getParentIndex(indx) != 0)
+        return dir_name ;
 
-   std::map<std::string,SharedDirInfo>::const_iterator it = mLocalDirs.find(dir->dir_name) ;
+   std::map<std::string,SharedDirInfo>::const_iterator it = mLocalDirs.find(dir_name) ;
 
    if(it == mLocalDirs.end())
    {
-       std::cerr << "(EE) Cannot find real name " << dir->dir_name << " at level 1 among shared dirs. Bug?" << std::endl;
+       std::cerr << "(EE) Cannot find real name " << dir_name << " at level 1 among shared dirs. Bug?" << std::endl;
        return std::string() ;
    }
 
@@ -657,19 +1030,20 @@ std::string LocalDirectoryStorage::locked_getVirtualPath(EntryIndex indx) const
         return std::string() ;
 
     std::string res ;
-    const InternalFileHierarchyStorage::DirEntry *dir = mFileHierarchy->getDirEntry(indx);
+    EntryIndex dir = indx ;
 
-    while(dir->parent_index != 0)
+    for(EntryIndex parent = mFileHierarchy->getParentIndex(dir);parent != 0 && parent != DirectoryStorage::NO_INDEX;parent = mFileHierarchy->getParentIndex(dir))
     {
-        dir = mFileHierarchy->getDirEntry(dir->parent_index) ;
-        res += dir->dir_name + "/"+ res ;
+        dir = parent ;
+        res += mFileHierarchy->getName(dir) + "/"+ res ;
     }
 
-   std::map<std::string,SharedDirInfo>::const_iterator it = mLocalDirs.find(dir->dir_name) ;
+   std::string dir_name = mFileHierarchy->getName(dir) ;
+   std::map<std::string,SharedDirInfo>::const_iterator it = mLocalDirs.find(dir_name) ;
 
    if(it == mLocalDirs.end())
    {
-       std::cerr << "(EE) Cannot find real name " << dir->dir_name << " at level 1 among shared dirs. Bug?" << std::endl;
+       std::cerr << "(EE) Cannot find real name " << dir_name << " at level 1 among shared dirs. Bug?" << std::endl;
        return std::string() ;
    }
    return it->second.virtualname + "/" + res;
@@ -722,8 +1096,7 @@ bool LocalDirectoryStorage::serialiseDirEntry(const EntryIndex& indx,RsTlvBinary
 
     for(uint32_t i=0;i<dir->subfiles.size();++i)
     {
-        const InternalFileHierarchyStorage::FileEntry *file = mFileHierarchy->getFileEntry(dir->subfiles[i]) ;
-        if(file != NULL && !file->file_hash.isNull())
+        if(!mFileHierarchy->getFileHash(dir->subfiles[i]).isNull())
             allowed_subfiles++ ;
     }
 
@@ -772,25 +1145,26 @@ bool LocalDirectoryStorage::serialiseDirEntry(const EntryIndex& indx,RsTlvBinary
     {
         uint32_t file_section_offset = 0 ;
 
-        const InternalFileHierarchyStorage::FileEntry *file = mFileHierarchy->getFileEntry(dir->subfiles[i]) ;
+        EntryIndex file = dir->subfiles[i] ;
+        RsFileHash file_hash = mFileHierarchy->getFileHash(file) ;
 
-        if(file == NULL || file->file_hash.isNull())
+        if(file_hash.isNull())
         {
             std::cerr << "(II) skipping unhashed or Null file entry " << dir->subfiles[i] << " to get/send file info." << std::endl;
             continue ;
         }
 
-        if(!FileListIO::writeField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_NAME     ,file->file_name   )) { free(section_data);free(file_section_data);return false ;}
-        if(!FileListIO::writeField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SIZE     ,file->file_size   )) { free(section_data);free(file_section_data);return false ;}
-        if(!FileListIO::writeField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SHA1_HASH,file->file_hash   )) { free(section_data);free(file_section_data);return false ;}
-        if(!FileListIO::writeField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_MODIF_TS      ,(uint32_t)file->file_modtime)) { free(section_data);free(file_section_data);return false ;}
+        if(!FileListIO::writeField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_NAME     ,mFileHierarchy->getName(file)     )) { free(section_data);free(file_section_data);return false ;}
+        if(!FileListIO::writeField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SIZE     ,mFileHierarchy->getFileSize(file) )) { free(section_data);free(file_section_data);return false ;}
+        if(!FileListIO::writeField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SHA1_HASH,file_hash                         )) { free(section_data);free(file_section_data);return false ;}
+        if(!FileListIO::writeField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_MODIF_TS      ,(uint32_t)mFileHierarchy->getFileModTime(file))) { free(section_data);free(file_section_data);return false ;}
 
         // now write the whole string into a single section in the file
 
         if(!FileListIO::writeField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_REMOTE_FILE_ENTRY,file_section_data,file_section_offset)) { free(section_data); free(file_section_data);return false ;}
 
 #ifdef DEBUG_LOCAL_DIRECTORY_STORAGE
-        std::cerr << "  pushing subfile " << file->hash << ", array position=" << i << " indx=" << dir->subfiles[i] << std::endl;
+        std::cerr << "  pushing subfile " << file_hash << ", array position=" << i << " indx=" << dir->subfiles[i] << std::endl;
 #endif
     }
 	free(file_section_data) ;
@@ -810,8 +1184,8 @@ bool LocalDirectoryStorage::serialiseDirEntry(const EntryIndex& indx,RsTlvBinary
 /*                                           Remote Directory Storage                                              */
 /******************************************************************************************************************/
 
-RemoteDirectoryStorage::RemoteDirectoryStorage(const RsPeerId& pid,const std::string& fname)
-    : DirectoryStorage(pid,fname)
+RemoteDirectoryStorage::RemoteDirectoryStorage(const RsPeerId& pid,const std::string& fname,bool load_on_demand)
+    : DirectoryStorage(pid,fname,load_on_demand)
 {
     mLastSweepTime = time(NULL) - (RSRandom::random_u32() % DELAY_BETWEEN_REMOTE_DIRECTORIES_SWEEP) ;
 
@@ -909,7 +1283,7 @@ bool RemoteDirectoryStorage::deserialiseUpdateDirEntry(const EntryIndex& indx,co
 #endif
 
     // First create the entries for each subdir and each subfile, if needed.
-    if(!mFileHierarchy->updateDirEntry(indx,dir_name,most_recent_time,dir_modtime,subdirs_hashes,subfiles_array))
+    if(!locked_getHierarchy()->updateDirEntry(indx,dir_name,most_recent_time,dir_modtime,subdirs_hashes,subfiles_array))
     {
         std::cerr << "(EE) Cannot update dir entry with index " << indx << ": entry does not exist." << std::endl;
         return false ;
@@ -924,7 +1298,12 @@ int RemoteDirectoryStorage::searchHash(const RsFileHash& hash, EntryIndex& resul
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
 
-    return mFileHierarchy->searchHash(hash,result);
+    // Searches by hash are done for every download, against every friend list. Do not load lists that cannot have the file.
+
+    if(!mLoaded && !mSummary.mayContainFileHash(hash))
+        return false ;
+
+    return locked_getHierarchy()->searchHash(hash,result);
 }
 
 
@@ -24,6 +24,7 @@
 #include <string>
 #include <stdint.h>
 #include <list>
+#include <vector>
 
 #include "retroshare/rsids.h"
 #include "retroshare/rsfiles.h"
@@ -33,17 +34,60 @@
 
 class RsTlvBinaryData ;
 class InternalFileHierarchyStorage ;
+class TurtleHashFilter ;
 class RsTlvBinaryData ;
 
 class DirectoryStorage
 {
 	public:
-        DirectoryStorage(const RsPeerId& pid, const std::string& fname) ;
+        // When load_on_demand is true, only the summary is read from the file. The full hierarchy is then loaded the first
+        // time it is needed, and can be released again with unload().
+
+        DirectoryStorage(const RsPeerId& pid, const std::string& fname, bool load_on_demand = false) ;
         virtual ~DirectoryStorage() {}
 
         typedef uint32_t EntryIndex ;
         static const EntryIndex NO_INDEX = 0xffffffff;
 
+        // What is kept in memory about a file list that is not loaded: enough to keep it in sync with the
+        // friend it comes from, and to tell whether it may contain a given file hash.
+
+        class Summary
+        {
+        public:
+            struct DirSyncInfo
+            {
+                EntryIndex index ;
+                RsFileHash hash ;
+                rstime_t   update_TS ;
+                rstime_t   recurs_modf_TS ;
+            };
+
+            Summary() {}
+
+            void clear() ;
+
+            DirSyncInfo *findDir(EntryIndex index) ;
+            DirSyncInfo *findDir(const RsFileHash& hash) ;
+
+            // Bloom filter of the hashes of all files. mayContainFileHash() can return false positives, but no false negatives.
+
+            void initFileHashFilter(uint32_t n_files) ;
+            void addFileHash(const RsFileHash& hash) ;
+            bool mayContainFileHash(const RsFileHash& hash) const ;
+
+            bool serialise(unsigned char *& data,uint32_t& size) const ;
+            bool deserialise(const unsigned char *data,uint32_t size) ;
+
+            uint64_t memoryUsage() const ;
+
+            std::vector<DirSyncInfo> dirs ;		// root directory first, then directories that have never been updated
+            SharedDirStats stats ;
+
+        private:
+            std::vector<uint8_t> mFileHashFilter ;
+        };
+
 		void save() const ;
 
         // These functions are to be used by file transfer and file search.
@@ -66,7 +110,7 @@ class DirectoryStorage
 
 		// This class allows to abstractly browse the stored directory hierarchy in a depth-first manner.
         // It gives access to sub-files and sub-directories below. When using it, the client should make sure
-        // that the DirectoryStorage is properly locked, since the iterator cannot lock it.
+        // that the DirectoryStorage is properly locked, since the iterator cannot lock it, and that the hierarchy is loaded.
 		//
 		class DirIterator
 		{
@@ -139,6 +183,11 @@ class DirectoryStorage
         bool getDirHashFromIndex(const EntryIndex& index,RsFileHash& hash) const ;	// constant cost
         bool getIndexFromDirHash(const RsFileHash& hash,EntryIndex& index) const ;	// log cost.
 
+        // Directories that the sync system needs to look at: the root, and directories that have never been updated.
+        // Does not need the hierarchy to be loaded.
+
+        void getSyncEntries(std::vector<EntryIndex>& entries) const ;
+
         // gathers statistics from the internal directory structure
 
         void getStatistics(SharedDirStats& stats) ;
@@ -154,15 +203,36 @@ class DirectoryStorage
 
 		const std::string& filename() const { return mFileName ; }
 
+        /*!
+         * \brief unload
+         * 			Saves the hierarchy if needed, and releases it, keeping only the summary in memory. The hierarchy is
+         * 			loaded again from disk the next time it is needed.
+         * \return false if the hierarchy could not be saved, in which case it stays in memory.
+         */
+        bool unload() ;
+        bool isLoaded() const ;
+
+        uint64_t memoryUsage() const ;			// approximate memory used by the hierarchy and summary, in bytes
+        rstime_t lastAccessTime() const ;		// last time the hierarchy was needed. Used to choose which lists to unload.
+
     protected:
         bool load(const std::string& local_file_name) ;
 		void save(const std::string& local_file_name) ;
 
+        // Returns the hierarchy, after loading it if needed. All methods that cannot be answered from the summary
+        // should use this instead of mFileHierarchy.
+
+        InternalFileHierarchyStorage *locked_getHierarchy() const ;
+
     private:
 
         // debug
         void locked_check();
 
+        bool locked_loadSummary(const std::string& local_file_name) ;
+        bool locked_getSummaryTS(EntryIndex index,rstime_t& TS,rstime_t Summary::DirSyncInfo::* m) const ;
+        bool locked_setSummaryTS(EntryIndex index,rstime_t  TS,rstime_t Summary::DirSyncInfo::* m) ;
+
         // storage of internal structure. Totally hidden from the outside. EntryIndex is simply the index of the entry in the vector.
 
         RsPeerId mPeerId;
@@ -175,12 +245,16 @@ class DirectoryStorage
 		rstime_t mLastSavedTime ;
 		bool mChanged ;
 		std::string mFileName;
+
+        mutable bool mLoaded ;
+        mutable rstime_t mLastAccessTime ;
+        mutable Summary mSummary ;				// only valid when the hierarchy is not loaded
 };
 
 class RemoteDirectoryStorage: public DirectoryStorage
 {
 public:
-    RemoteDirectoryStorage(const RsPeerId& pid,const std::string& fname) ;
+    RemoteDirectoryStorage(const RsPeerId& pid,const std::string& fname,bool load_on_demand = false) ;
     virtual ~RemoteDirectoryStorage() {}
 
     /*!
@@ -247,6 +321,19 @@ public:
      */
     virtual int searchHash(const RsFileHash& hash, RsFileHash &real_hash, EntryIndex &results) const ;
 
+    /*!
+     * \brief setHashFilter
+     * 				Sets a filter that is kept informed of every hash searchHash() may find, i.e. real hashes and encrypted hashes
+     * 				of the local files, as soon as they are known. The filter is not owned.
+     */
+    void setHashFilter(TurtleHashFilter *filter) ;
+
+    /*!
+     * \brief getFileHashes
+     * 				Appends all the hashes that searchHash() can find to the given list.
+     */
+    void getFileHashes(std::vector<RsFileHash>& hashes) const ;
+
     /*!
      * \brief updateTimeStamps
      * 			Checks recursive TS and update the if needed.
@@ -303,6 +390,7 @@ private:
 	std::map<std::string,SharedDirInfo> mLocalDirs ;	// map is better for search. it->first=it->second.filename
 	std::map<RsFileHash,RsFileHash> mEncryptedHashes;	// map such that hash(it->second) = it->first
 
+	TurtleHashFilter *mHashFilter ;
 	bool mTSChanged ;
 };
 
@@ -41,6 +41,7 @@ static const std::string IGNORED_PREFIXES_SS                    = "IGNORED_PREFI
 static const std::string IGNORED_SUFFIXES_SS                    = "IGNORED_SUFFIXES"; 	 	             // ignore file suffixes
 static const std::string IGNORE_LIST_FLAGS_SS                   = "IGNORED_FLAGS"; 	 	 	             // ignore file flags
 static const std::string MAX_SHARE_DEPTH                        = "MAX_SHARE_DEPTH"; 	 	             // maximum depth of shared directories
+static const std::string REMOTE_LISTS_MEMORY_BUDGET_SS          = "REMOTE_LISTS_MEMORY_BUDGET"; 	     // memory for friend file lists, in MB, before unloading the least recently used ones
 
 static const std::string FILE_SHARING_DIR_NAME       = "file_sharing" ;			 // hard-coded directory name to store friend file lists, hash cache, etc.
 static const std::string HASH_CACHE_FILE_NAME        = "hash_cache.bin" ;		 // hard-coded directory name to store encrypted hash cache.
@@ -48,6 +49,10 @@ static const std::string LOCAL_SHARED_DIRS_FILE_NAME = "local_dir_hierarchy.bin"
 
 static const uint32_t MIN_INTERVAL_BETWEEN_HASH_CACHE_SAVE         = 20 ;    // never save hash cache more often than every 20 secs.
 static const uint32_t MIN_INTERVAL_BETWEEN_REMOTE_DIRECTORY_SAVE   = 23 ;    // never save remote directories more often than this
+static const uint32_t DEFAULT_REMOTE_LISTS_MEMORY_BUDGET_MB        = 64 ;    // 0 means no limit
+static const uint32_t MIN_DELAY_BEFORE_UNLOADING_REMOTE_LIST        = 60 ;    // never unload a friend file list that was used less than a minute ago
+static const uint32_t FILE_HASH_FILTER_BITS_PER_FILE                = 10 ;    // ~1% false positives in the file hash bloom filter of unloaded file lists
+static const uint32_t FILE_HASH_FILTER_NB_HASH_FUNCTIONS            = 7 ;
 static const uint32_t MIN_TIME_AFTER_LAST_MODIFICATION             = 20 ;    // never hash a file that is just being modified, otherwise we end up with a corrupted hash
 
 static const uint32_t MAX_DIR_SYNC_RESPONSE_DATA_SIZE              = 20000 ; // Maximum RsItem data size in bytes for serialised directory transmission
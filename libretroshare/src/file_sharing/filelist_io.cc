@@ -25,9 +25,16 @@
 #include "util/rsdir.h"
 #include "util/rsprint.h"
 #include "serialiser/rsbaseserial.h"
+#include "crypto/chacha20.h"
+#include "util/rsrandom.h"
 #include "filelist_io.h"
 
-FileListIO::read_error::read_error(unsigned char *sec,uint32_t size,uint32_t offset,uint8_t expected_tag)
+static const uint32_t SECTION_FILE_KEY_SIZE        = 32 ;
+static const uint32_t SECTION_FILE_TAG_SIZE        = 16 ;
+static const uint32_t SECTION_FILE_MAX_SECTIONS    = 16 ;
+static const uint32_t SECTION_FILE_MAX_SEALED_KEY  = 4096 ;	// the sealed key is a few hundred bytes, depending on our own key size
+
+FileListIO::read_error::read_error(const unsigned char *sec,uint32_t size,uint32_t offset,uint8_t expected_tag)
 {
 	std::ostringstream s ;
 	s << "At offset " << offset << "/" << size << ": expected section tag " << std::hex << (int)expected_tag << std::dec << " but got " << RsUtil::BinToHex(&sec[offset],std::min((int)size-(int)offset, 15)) << "..." << std::endl;
@@ -238,3 +245,226 @@ bool FileListIO::loadEncryptedDataFromFile(const std::string& fname,unsigned cha
 
     return true;
 }
+
+// Each section is encrypted with the file key and a nonce made from its index. The key is new for every save,
+// so nonces are never reused. The position and size of the section are authenticated as well.
+
+static bool cryptSection(uint8_t key[SECTION_FILE_KEY_SIZE],uint32_t section,uint32_t offset,unsigned char *data,uint32_t size,uint8_t tag[SECTION_FILE_TAG_SIZE],bool encrypt)
+{
+    uint8_t nonce[12] ;
+    uint8_t aad[8] ;
+    uint32_t aad_offset = 0 ;
+    uint32_t nonce_offset = 0 ;
+
+    memset(nonce,0,12) ;
+    setRawUInt32(nonce,12,&nonce_offset,section) ;
+
+    setRawUInt32(aad,8,&aad_offset,offset) ;
+    setRawUInt32(aad,8,&aad_offset,size) ;
+
+    return librs::crypto::AEAD_chacha20_sha256(key,nonce,data,size,aad,8,tag,encrypt) ;
+}
+
+bool FileListIO::saveEncryptedSectionsToFile(const std::string& fname,const std::vector<const unsigned char*>& sections,const std::vector<uint32_t>& sizes)
+{
+    if(sections.size() != sizes.size() || sections.size() > SECTION_FILE_MAX_SECTIONS)
+        return false ;
+
+    uint8_t key[SECTION_FILE_KEY_SIZE] ;
+    RsRandom::random_bytes(key,SECTION_FILE_KEY_SIZE) ;
+
+    void *sealed_key = NULL ;
+    int sealed_key_size = 0 ;
+
+    if(!AuthSSL::getAuthSSL()->encrypt( sealed_key, sealed_key_size, key,SECTION_FILE_KEY_SIZE, AuthSSL::getAuthSSL()->OwnId()))
+    {
+        std::cerr << "Cannot encrypt file key. Something's wrong." << std::endl;
+        return false;
+    }
+
+    // header, then the table of section offsets and sizes, then the sections, each preceded by its tag.
+
+    uint32_t header_size = 4*sizeof(uint32_t) + sealed_key_size + 2*sizeof(uint32_t)*sections.size() ;
+    uint64_t total_size = header_size ;
+
+    for(uint32_t i=0;i<sizes.size();++i)
+        total_size += SECTION_FILE_TAG_SIZE + sizes[i] ;
+
+    if(total_size > 0x8fffffff)
+    {
+        free(sealed_key) ;
+        return false ;
+    }
+
+    RsTemporaryMemory buffer(total_size) ;
+
+    if(buffer == NULL)
+    {
+        free(sealed_key) ;
+        return false ;
+    }
+
+    uint32_t offset = 0 ;
+    bool ok = true ;
+
+    ok = ok && setRawUInt32(buffer,total_size,&offset,FILE_LIST_IO_SECTION_FILE_MAGIC) ;
+    ok = ok && setRawUInt32(buffer,total_size,&offset,FILE_LIST_IO_SECTION_FILE_VERSION_0001) ;
+    ok = ok && setRawUInt32(buffer,total_size,&offset,(uint32_t)sealed_key_size) ;
+
+    memcpy(&buffer[offset],sealed_key,sealed_key_size) ;
+    offset += sealed_key_size ;
+    free(sealed_key) ;
+
+    ok = ok && setRawUInt32(buffer,total_size,&offset,(uint32_t)sections.size()) ;
+
+    uint32_t section_offset = header_size ;
+
+    for(uint32_t i=0;i<sections.size();++i)
+    {
+        ok = ok && setRawUInt32(buffer,total_size,&offset,section_offset) ;
+        ok = ok && setRawUInt32(buffer,total_size,&offset,sizes[i]) ;
+
+        if(!ok)
+            break ;
+
+        memcpy(&buffer[section_offset + SECTION_FILE_TAG_SIZE],sections[i],sizes[i]) ;
+        cryptSection(key,i,section_offset,&buffer[section_offset + SECTION_FILE_TAG_SIZE],sizes[i],&buffer[section_offset],true) ;
+
+        section_offset += SECTION_FILE_TAG_SIZE + sizes[i] ;
+    }
+    memset(key,0,SECTION_FILE_KEY_SIZE) ;
+
+    if(!ok)
+    {
+        std::cerr << "Cannot serialise section file header. Something's wrong." << std::endl;
+        return false ;
+    }
+
+    FILE *F = fopen( (fname+".tmp").c_str(),"wb" ) ;
+
+    if(!F)
+    {
+        std::cerr << "Cannot open encrypted file for writing: " << fname+".tmp" << std::endl;
+        return false;
+    }
+    if(fwrite(buffer,1,total_size,F) != total_size)
+    {
+        std::cerr << "Could not write entire encrypted file. Out of disc space??" << std::endl;
+        fclose(F) ;
+        return false;
+    }
+
+    fclose(F) ;
+
+    return RsDirUtil::renameFile(fname+".tmp",fname) ;
+}
+
+bool FileListIO::loadEncryptedSectionFromFile(const std::string& fname,uint32_t section,unsigned char *& data,uint32_t& size)
+{
+    uint64_t file_size ;
+
+    if(!RsDirUtil::checkFile( fname,file_size,true ) )
+        return false;
+
+    FILE *F = fopen( fname.c_str(),"rb") ;
+
+    if (!F)
+    {
+       std::cerr << "Cannot open encrypted file, filename " << fname << std::endl;
+       return false;
+    }
+
+    // Only read the header and the requested section.
+
+    unsigned char header[3*sizeof(uint32_t)] ;
+    uint32_t magic=0, version=0, sealed_key_size=0, offset=0 ;
+
+    if(fread(header,1,sizeof(header),F) != sizeof(header)
+            || !getRawUInt32(header,sizeof(header),&offset,&magic)
+            || !getRawUInt32(header,sizeof(header),&offset,&version)
+            || !getRawUInt32(header,sizeof(header),&offset,&sealed_key_size)
+            || magic != FILE_LIST_IO_SECTION_FILE_MAGIC
+            || version != FILE_LIST_IO_SECTION_FILE_VERSION_0001
+            || sealed_key_size > SECTION_FILE_MAX_SEALED_KEY)
+    {
+        fclose(F) ;
+        return false ;	// not a section file. Probably an older file list format.
+    }
+
+    RsTemporaryMemory sealed_key(sealed_key_size + sizeof(uint32_t)) ;
+    uint32_t n_sections = 0 ;
+    offset = 0 ;
+
+    if(sealed_key == NULL
+            || fread(sealed_key,1,sealed_key_size + sizeof(uint32_t),F) != sealed_key_size + sizeof(uint32_t)
+            || (offset = sealed_key_size, !getRawUInt32(sealed_key,sealed_key_size + sizeof(uint32_t),&offset,&n_sections))
+            || section >= n_sections || n_sections > SECTION_FILE_MAX_SECTIONS)
+    {
+        std::cerr << "Cannot read section " << section << " from file " << fname << std::endl;
+        fclose(F) ;
+        return false ;
+    }
+
+    unsigned char table[2*sizeof(uint32_t)*SECTION_FILE_MAX_SECTIONS] ;
+    uint32_t section_offset=0, section_size=0 ;
+    offset = 2*sizeof(uint32_t)*section ;
+
+    if(fread(table,1,2*sizeof(uint32_t)*n_sections,F) != 2*sizeof(uint32_t)*n_sections
+            || !getRawUInt32(table,sizeof(table),&offset,&section_offset)
+            || !getRawUInt32(table,sizeof(table),&offset,&section_size)
+            || (uint64_t)section_offset + SECTION_FILE_TAG_SIZE + section_size > file_size
+            || fseek(F,section_offset,SEEK_SET) != 0)
+    {
+        std::cerr << "Cannot read section " << section << " from file " << fname << ": corrupted section table." << std::endl;
+        fclose(F) ;
+        return false ;
+    }
+
+    uint8_t tag[SECTION_FILE_TAG_SIZE] ;
+    unsigned char *section_data = (unsigned char*)rs_malloc(section_size+1) ;	// +1 so that empty sections are still allocated
+
+    if(!section_data)
+    {
+        fclose(F) ;
+        return false ;
+    }
+
+    if(fread(tag,1,SECTION_FILE_TAG_SIZE,F) != SECTION_FILE_TAG_SIZE || fread(section_data,1,section_size,F) != section_size)
+    {
+        std::cerr << "Cannot read from file " + fname << ": something's wrong." << std::endl;
+        free(section_data) ;
+        fclose(F) ;
+        return false;
+    }
+    fclose(F) ;
+
+    // now decrypt the file key, and the section
+
+    void *key = NULL ;
+    int key_size = 0 ;
+
+    if(!AuthSSL::getAuthSSL()->decrypt(key, key_size, sealed_key, sealed_key_size) || key_size != (int)SECTION_FILE_KEY_SIZE)
+    {
+       std::cerr << "Cannot decrypt file key of " << fname << ". Something's wrong." << std::endl;
+       free(key) ;
+       free(section_data) ;
+       return false;
+    }
+
+    bool res = cryptSection((uint8_t*)key,section,section_offset,section_data,section_size,tag,false) ;
+
+    memset(key,0,SECTION_FILE_KEY_SIZE) ;
+    free(key) ;
+
+    if(!res)
+    {
+       std::cerr << "Cannot authenticate section " << section << " of file " << fname << ". The file is corrupted." << std::endl;
+       free(section_data) ;
+       return false;
+    }
+
+    data = section_data ;
+    size = section_size ;
+
+    return true;
+}
@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <vector>
 
 #include "util/rsmemory.h"
 
@@ -33,6 +34,15 @@
 static const uint32_t FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0001 =  0x00000001 ;
 static const uint32_t FILE_LIST_IO_LOCAL_DIRECTORY_TREE_VERSION_0001    =  0x00010001 ;
 
+static const uint32_t FILE_LIST_IO_SECTION_FILE_MAGIC                   =  0x52534c53 ;	// "RSLS"
+static const uint32_t FILE_LIST_IO_SECTION_FILE_VERSION_0001            =  0x00000001 ;
+static const uint32_t FILE_LIST_IO_DIRECTORY_SUMMARY_VERSION_0001       =  0x00020001 ;
+
+// sections of saved directory storage files
+
+static const uint32_t FILE_LIST_IO_SECTION_DIRECTORY_SUMMARY            =  0x00000000 ;
+static const uint32_t FILE_LIST_IO_SECTION_DIRECTORY_HIERARCHY          =  0x00000001 ;
+
 static const uint8_t FILE_LIST_IO_TAG_UNKNOWN                   =  0x00 ;
 static const uint8_t FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION   =  0x01 ;
 
@@ -93,7 +103,7 @@ public:
 	class read_error
 	{
 	public:
-		read_error(unsigned char *sec,uint32_t size,uint32_t offset,uint8_t expected_tag);
+		read_error(const unsigned char *sec,uint32_t size,uint32_t offset,uint8_t expected_tag);
 		read_error(const std::string& s) : err_string(s) {}
 
 		const std::string& what() const { return err_string ; }
@@ -112,6 +122,13 @@ public:
     static bool saveEncryptedDataToFile(const std::string& fname,const unsigned char *data,uint32_t total_size);
     static bool loadEncryptedDataFromFile(const std::string& fname,unsigned char *& data,uint32_t& total_size);
 
+    // Files made of separately encrypted sections. The sections are encrypted with a random key that is itself encrypted
+    // with our own key, so that a single section can be read without reading and decrypting the whole file.
+    // loadEncryptedSectionFromFile() returns false if the file is not in this format.
+
+    static bool saveEncryptedSectionsToFile(const std::string& fname,const std::vector<const unsigned char*>& sections,const std::vector<uint32_t>& sizes);
+    static bool loadEncryptedSectionFromFile(const std::string& fname,uint32_t section,unsigned char *& data,uint32_t& size);
+
 private:
     static bool write125Size(unsigned char *data,uint32_t total_size,uint32_t& offset,uint32_t size) ;
     static bool read125Size (const unsigned char *data,uint32_t total_size,uint32_t& offset,uint32_t& size) ;
@@ -72,6 +72,7 @@ p3FileDatabase::p3FileDatabase(p3ServiceControl *mpeers)
 
     mUpdateFlags = P3FILELISTS_UPDATE_FLAG_NOTHING_CHANGED ;
     mLastRemoteDirSweepTS = 0 ;
+    mRemoteListsMemoryBudget = DEFAULT_REMOTE_LISTS_MEMORY_BUDGET_MB ;
     mLastExtraFilesCacheUpdate = 0;
     mLastCleanupTime = 0 ;
     mLastDataRecvTS = 0 ;
@@ -232,13 +233,15 @@ int p3FileDatabase::tick()
                   mRemoteDirectories[i]->print();
 #endif
 
-                  locked_recursSweepRemoteDirectory(mRemoteDirectories[i],mRemoteDirectories[i]->root(),0) ;
+                  locked_sweepRemoteDirectory(mRemoteDirectories[i]) ;
                   mRemoteDirectories[i]->lastSweepTime() = now ;
                }
 
                mRemoteDirectories[i]->checkSave() ;
             }
 
+        locked_unloadRemoteDirectories() ;
+
         mLastRemoteDirSweepTS = now;
 		mLocalSharedDirs->checkSave() ;
 
@@ -358,6 +361,17 @@ cleanup = true;
         kv.key = MAX_SHARE_DEPTH;
         kv.value = s ;
 
+        rskv->tlvkvs.pairs.push_back(kv);
+    }
+	{
+        std::string s ;
+        rs_sprintf(s, "%u", remoteFileListsMemoryBudget()) ;
+
+        RsTlvKeyValue kv;
+
+        kv.key = REMOTE_LISTS_MEMORY_BUDGET_SS;
+        kv.value = s ;
+
         rskv->tlvkvs.pairs.push_back(kv);
     }
 	{
@@ -540,6 +554,15 @@ bool p3FileDatabase::loadList(std::list<RsItem *>& load)
                 if(sscanf(kit->value.c_str(),"%d",&t) == 1)
                     max_share_depth = (uint32_t)t ;
 			}
+			else if(kit->key == REMOTE_LISTS_MEMORY_BUDGET_SS)
+			{
+                uint32_t t=0 ;
+                if(sscanf(kit->value.c_str(),"%u",&t) == 1)
+                {
+                    RS_STACK_MUTEX(mFLSMtx) ;
+                    mRemoteListsMemoryBudget = t ;
+                }
+			}
 
             delete *it ;
             continue ;
@@ -729,7 +752,7 @@ uint32_t p3FileDatabase::locked_getFriendIndex(const RsPeerId& pid)
         if(!found)
         {
             found = mRemoteDirectories.size();
-            mRemoteDirectories.push_back(new RemoteDirectoryStorage(pid,makeRemoteFileName(pid)));
+            mRemoteDirectories.push_back(new RemoteDirectoryStorage(pid,makeRemoteFileName(pid),true));
 
             mUpdateFlags |= P3FILELISTS_UPDATE_FLAG_REMOTE_DIRS_CHANGED ;
             mUpdateFlags |= P3FILELISTS_UPDATE_FLAG_REMOTE_MAP_CHANGED ;
@@ -761,7 +784,7 @@ uint32_t p3FileDatabase::locked_getFriendIndex(const RsPeerId& pid)
         if(mRemoteDirectories.size() <= it->second)
         {
             mRemoteDirectories.resize(it->second+1,NULL) ;
-            mRemoteDirectories[it->second] = new RemoteDirectoryStorage(pid,makeRemoteFileName(pid));
+            mRemoteDirectories[it->second] = new RemoteDirectoryStorage(pid,makeRemoteFileName(pid),true);
 
             mUpdateFlags |= P3FILELISTS_UPDATE_FLAG_REMOTE_DIRS_CHANGED ;
             mUpdateFlags |= P3FILELISTS_UPDATE_FLAG_REMOTE_MAP_CHANGED ;
@@ -1280,6 +1303,17 @@ int  p3FileDatabase::maxShareDepth() const
     RS_STACK_MUTEX(mFLSMtx) ;
     return mLocalDirWatcher->maxShareDepth() ;
 }
+void p3FileDatabase::setRemoteFileListsMemoryBudget(uint32_t mb)
+{
+    RS_STACK_MUTEX(mFLSMtx) ;
+    mRemoteListsMemoryBudget = mb ;
+    IndicateConfigChanged();
+}
+uint32_t p3FileDatabase::remoteFileListsMemoryBudget() const
+{
+    RS_STACK_MUTEX(mFLSMtx) ;
+    return mRemoteListsMemoryBudget ;
+}
 void p3FileDatabase::setWatchEnabled(bool b)
 {
     RS_STACK_MUTEX(mFLSMtx) ;
@@ -1421,6 +1455,18 @@ int p3FileDatabase::SearchBoolExp(RsRegularExpression::Expression *exp, std::lis
     return !results.empty() ;
 
 }
+void p3FileDatabase::setTunnelHashFilter(TurtleHashFilter *filter)
+{
+    RS_STACK_MUTEX(mFLSMtx) ;
+    mLocalSharedDirs->setHashFilter(filter) ;
+}
+
+void p3FileDatabase::getLocalFileHashes(std::vector<RsFileHash>& hashes) const
+{
+    RS_STACK_MUTEX(mFLSMtx) ;
+    mLocalSharedDirs->getFileHashes(hashes) ;
+}
+
 bool p3FileDatabase::search(const RsFileHash &hash, FileSearchFlags hintflags, FileInfo &info) const
 {
     RS_STACK_MUTEX(mFLSMtx) ;
@@ -1895,41 +1941,82 @@ void p3FileDatabase::handleDirSyncResponse(RsFileListsSyncResponseItem*& sitem)
 
 }
 
-void p3FileDatabase::locked_recursSweepRemoteDirectory(RemoteDirectoryStorage *rds,DirectoryStorage::EntryIndex e,int depth)
+void p3FileDatabase::locked_sweepRemoteDirectory(RemoteDirectoryStorage *rds)
 {
    rstime_t now = time(NULL) ;
 
-   //std::string indent(2*depth,' ') ;
+   // Requests are only sent for the root, and for directories that were never updated. The list of these
+   // is kept with the summary of the file list, so the sweep does not need the file list to be loaded.
 
-   // if not up to date, request update, and return (content is not certified, so no need to recurs yet).
-   // if up to date, return, because TS is about the last modif TS below, so no need to recurs either.
+   std::vector<DirectoryStorage::EntryIndex> entries ;
+   rds->getSyncEntries(entries) ;
 
-   // get the info for this entry
+   for(uint32_t i=0;i<entries.size();++i)
+   {
+       DirectoryStorage::EntryIndex e = entries[i] ;
+       rstime_t local_update_TS;
 
 #ifdef DEBUG_P3FILELISTS
-   P3FILELISTS_DEBUG() << "currently at entry index " << e << std::endl;
+       P3FILELISTS_DEBUG() << "currently at entry index " << e << std::endl;
 #endif
 
-   rstime_t local_update_TS;
+       if(!rds->getDirectoryUpdateTime(e,local_update_TS))
+       {
+           P3FILELISTS_ERROR() << "  (EE) locked_sweepRemoteDirectory(): cannot get update TS for directory with index " << e << ". This is a consistency bug." << std::endl;
+           continue;
+       }
 
-   if(!rds->getDirectoryUpdateTime(e,local_update_TS))
-   {
-       P3FILELISTS_ERROR() << "  (EE) lockec_recursSweepRemoteDirectory(): cannot get update TS for directory with index " << e << ". This is a consistency bug." << std::endl;
-       return;
+       // compare TS
+
+       if((e == 0 && now > local_update_TS + DELAY_BETWEEN_REMOTE_DIRECTORY_SYNC_REQ) || local_update_TS == 0)	// we need to compare local times only. We cannot compare local (now) with remote time.
+           if(locked_generateAndSendSyncRequest(rds,e))
+           {
+#ifdef DEBUG_P3FILELISTS
+               P3FILELISTS_DEBUG() << "  Asking for sync of directory " << e << " to peer " << rds->peerId() << " because it's " << (now - local_update_TS) << " secs old since last check." << std::endl;
+#endif
+           }
    }
+}
 
-   // compare TS
+void p3FileDatabase::locked_unloadRemoteDirectories()
+{
+    if(mRemoteListsMemoryBudget == 0)
+        return ;
+
+    rstime_t now = time(NULL) ;
+    uint64_t budget = (uint64_t)mRemoteListsMemoryBudget << 20 ;
+    uint64_t total_memory = 0 ;
+
+    std::vector<std::pair<rstime_t,RemoteDirectoryStorage*> > loaded_lists ;	// lists that can be unloaded, with their last access time
+
+    for(uint32_t i=0;i<mRemoteDirectories.size();++i)
+        if(mRemoteDirectories[i] != NULL)
+        {
+            total_memory += mRemoteDirectories[i]->memoryUsage() ;
+
+            if(mRemoteDirectories[i]->isLoaded() && mRemoteDirectories[i]->lastAccessTime() + MIN_DELAY_BEFORE_UNLOADING_REMOTE_LIST < now)
+                loaded_lists.push_back(std::make_pair(mRemoteDirectories[i]->lastAccessTime(),mRemoteDirectories[i])) ;
+        }
+
+    if(total_memory <= budget)
+        return ;
+
+    std::sort(loaded_lists.begin(),loaded_lists.end()) ;
+
+    for(uint32_t i=0;i<loaded_lists.size() && total_memory > budget;++i)
+    {
+        uint64_t size_before = loaded_lists[i].second->memoryUsage() ;
+
+        if(!loaded_lists[i].second->unload())
+            continue ;
+
+        uint64_t size_after = loaded_lists[i].second->memoryUsage() ;
 
-   if((e == 0 && now > local_update_TS + DELAY_BETWEEN_REMOTE_DIRECTORY_SYNC_REQ) || local_update_TS == 0)	// we need to compare local times only. We cannot compare local (now) with remote time.
-       if(locked_generateAndSendSyncRequest(rds,e))
-       {
 #ifdef DEBUG_P3FILELISTS
-           P3FILELISTS_DEBUG() << "  Asking for sync of directory " << e << " to peer " << rds->peerId() << " because it's " << (now - local_update_TS) << " secs old since last check." << std::endl;
+        P3FILELISTS_DEBUG() << "Unloaded file list of friend " << loaded_lists[i].second->peerId() << ": " << size_before << " -> " << size_after << " bytes." << std::endl;
 #endif
-       }
-
-   for(DirectoryStorage::DirIterator it(rds,e);it;++it)
-       locked_recursSweepRemoteDirectory(rds,*it,depth+1);
+        total_memory -= std::min(total_memory,size_before - std::min(size_before,size_after)) ;
+    }
 }
 
 p3FileDatabase::DirSyncRequestId p3FileDatabase::makeDirSyncReqId(const RsPeerId& peer_id,const RsFileHash& hash)
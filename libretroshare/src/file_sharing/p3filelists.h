@@ -112,6 +112,12 @@ class p3FileDatabase: public p3Service, public p3Config, public ftSearch //, pub
         // Extra file list
         virtual void removeExtraFile(const RsFileHash& hash);
 
+        // Filter of the local hashes that search() can find with RS_FILE_HINTS_LOCAL. The filter is kept informed of new hashes,
+        // and getLocalFileHashes() lists them all for rebuilding it.
+        //
+        void setTunnelHashFilter(TurtleHashFilter *filter) ;
+        void getLocalFileHashes(std::vector<RsFileHash>& hashes) const ;
+
 		// Interface for browsing dir hierarchy
 		//
 
@@ -145,6 +151,11 @@ class p3FileDatabase: public p3Service, public p3Config, public ftSearch //, pub
 		void setMaxShareDepth(int i) ;
 		int  maxShareDepth() const ;
 
+		// Friend file lists are loaded when needed, and the least recently used ones are unloaded when they use more than this. 0 means no limit.
+
+		void setRemoteFileListsMemoryBudget(uint32_t mb) ;
+		uint32_t remoteFileListsMemoryBudget() const ;
+
 		bool banFile(const RsFileHash& real_file_hash, const std::string& filename, uint64_t file_size) ;
 		bool unbanFile(const RsFileHash& real_file_hash);
         bool isFileBanned(const RsFileHash& hash) ;
@@ -254,7 +265,10 @@ class p3FileDatabase: public p3Service, public p3Config, public ftSearch //, pub
         std::map<DirSyncRequestId,DirSyncRequestData> mPendingSyncRequests ; // pending requests, waiting for an answer
         std::map<DirSyncRequestId,RsFileListsSyncResponseItem *> mPartialResponseItems;
 
-        void locked_recursSweepRemoteDirectory(RemoteDirectoryStorage *rds, DirectoryStorage::EntryIndex e, int depth);
+        void locked_sweepRemoteDirectory(RemoteDirectoryStorage *rds);
+        void locked_unloadRemoteDirectories();
+
+        uint32_t mRemoteListsMemoryBudget ;	// in MB
 
         // We use a shared file cache as well, to avoid re-hashing files with known modification TS and equal name.
 		//
@@ -37,6 +37,11 @@ static const uint32_t SOURCE_CHUNK_MAP_UPDATE_PERIOD	=   60 ; //! TTL for chunkm
 static const uint32_t INACTIVE_CHUNK_TIME_LAPSE 		= 3600 ; //! TTL for an inactive chunk
 static const uint32_t FT_CHUNKMAP_MAX_CHUNK_JUMP		=   50 ; //! Maximum chunk jump in progressive DL mode
 static const uint32_t FT_CHUNKMAP_MAX_SLICE_REASK_DELAY =   10 ; //! Maximum time to re-ask a slice to another peer at end of transfer
+static const uint32_t FT_CHUNKMAP_PIPELINE_DURATION     =   10 ; //! Seconds of data a source can have requested and not sent yet
+static const uint32_t FT_CHUNKMAP_MIN_SOURCE_WINDOW     = 128*1024 ;      //! Pending data always allowed, so that slow sources still progress
+static const uint32_t FT_CHUNKMAP_MAX_SOURCE_WINDOW     = 32*1024*1024 ;  //! Maximum pending data for the fastest sources
+static const float    FT_CHUNKMAP_FASTER_SOURCE_FACTOR  =  4.0f ; //! How much sooner a source must be able to send a slice to take it over
+static const float    FT_CHUNKMAP_RATE_DECAY            = 0.75f ; //! Weight of the previous rate estimate after one second
 
 std::ostream& operator<<(std::ostream& o,const ftChunk& c)
 {
@@ -150,8 +155,9 @@ void ChunkMap::dataReceived(const ftChunk::OffsetInFile& cid)
 
 	_total_downloaded += it->second.size ;
 	itc->second._remains -= it->second.size ;
+	releasePendingSlice(it->second) ;
 	itc->second._slices.erase(it) ;
-	itc->second._last_data_received = time(NULL) ;	// update time stamp
+	itc->second._last_data_received = currentTime() ;	// update time stamp
 
 #ifdef DEBUG_FTCHUNK
 	std::cerr << "*** ChunkMap::dataReceived: received data chunk " << cid << " for chunk number " << n << ", local remains=" << itc->second._remains << ", total downloaded=" << _total_downloaded << ", remains=" << _file_size - _total_downloaded << std::endl ;
@@ -258,32 +264,71 @@ bool ChunkMap::reAskPendingChunk( const RsPeerId& peer_id,
                                   uint32_t /*size_hint*/,
                                   uint64_t& offset, uint32_t& size)
 {
-	// make sure that we're at the end of the file. No need to be too greedy in the middle of it.
+	// At the end of the file (end-game mode), any late slice is re-asked. In the middle of it, we only take over
+	// slices that the sources they were asked to would send much later than we would.
+
+	bool end_game = true ;
 
 	for(uint32_t i=0;i<_map.size();++i)
 		if(_map[i] == FileChunksInfo::CHUNK_OUTSTANDING)
-			return false ;
+		{
+			end_game = false ;
+			break ;
+		}
+
+	rstime_t now = currentTime();
+	uint64_t room = sourceWindowRoom(peer_id,now) ;
 
-	rstime_t now = time(NULL);
+	if(room == 0)
+		return false ;
+
+	SourceChunksInfo *sci = getSourceChunksInfo(peer_id) ;
+	ChunkDownloadInfo::SliceRequestInfo *best_slice = NULL ;
+	float best_delay = 0.0f ;
 
 	for(std::map<uint32_t,ChunkDownloadInfo>::iterator it(_slices_to_download.begin());it!=_slices_to_download.end();++it)
+	{
+		if(!sci->hasData(it->first*(uint64_t)_chunk_size,_chunk_size))
+			continue ;
+
 		for(std::map<ftChunk::OffsetInFile,ChunkDownloadInfo::SliceRequestInfo >::iterator it2(it->second._slices.begin());it2!=it->second._slices.end();++it2)
-			if(it2->second.request_time + FT_CHUNKMAP_MAX_SLICE_REASK_DELAY < now && it2->second.peers.end()==it2->second.peers.find(peer_id))
+		{
+			if(it2->second.request_time + FT_CHUNKMAP_MAX_SLICE_REASK_DELAY >= now || it2->second.size > room || it2->second.peers.end()!=it2->second.peers.find(peer_id))
+				continue ;
+
+			// The slice will be received when the fastest of the sources it was asked to sends it.
+
+			float delay = 1e9f ;
+
+			for(std::set<RsPeerId>::const_iterator pit(it2->second.peers.begin());pit!=it2->second.peers.end();++pit)
+				delay = std::min(delay,sourceCompletionTime(*pit,0,now)) ;
+
+			if(!end_game && delay < FT_CHUNKMAP_FASTER_SOURCE_FACTOR * sourceCompletionTime(peer_id,it2->second.size,now))
+				continue ;
+
+			if(best_slice == NULL || delay > best_delay)
 			{
-				offset = it2->first;
-				size   = it2->second.size ;
+				best_slice = &it2->second ;
+				best_delay = delay ;
+				offset = it2->first ;
+			}
+		}
+	}
+
+	if(best_slice == NULL)
+		return false ;
+
+	size = best_slice->size ;
 
 #ifdef DEBUG_FTCHUNK
-				std::cerr << "*** ChunkMap::reAskPendingChunk: re-asking slice (" << offset << ", " << size << ") to peer " << peer_id << std::endl;
+	std::cerr << "*** ChunkMap::reAskPendingChunk: re-asking slice (" << offset << ", " << size << ") to peer " << peer_id << ", end game=" << end_game << std::endl;
 #endif
 
-				it2->second.request_time = now ;
-				it2->second.peers.insert(peer_id) ;
-
-				return true ;
-			}
+	best_slice->request_time = now ;
+	best_slice->peers.insert(peer_id) ;
+	getSourceThroughputInfo(peer_id,now).pending_bytes += size ;
 
-	return false ;
+	return true ;
 }
 
 // Warning: a chunk may be empty, but still being downloaded, so asking new slices from it
@@ -303,6 +348,16 @@ bool ChunkMap::getDataChunk(const RsPeerId& peer_id,uint32_t size_hint,ftChunk&
 #ifdef DEBUG_FTCHUNK
 	std::cerr << "*** ChunkMap::getDataChunk: size_hint = " << size_hint << std::endl ;
 #endif
+	// 0 - don't give more data to this source than it can send in FT_CHUNKMAP_PIPELINE_DURATION seconds.
+	//
+	rstime_t now = currentTime() ;
+	uint64_t room = sourceWindowRoom(peer_id,now) ;
+
+	if(room == 0)
+		return false ;
+
+	size_hint = std::min((uint64_t)size_hint,room) ;
+
 	// 1 - find if this peer already has an active chunk.
 	//
 	std::map<RsPeerId,Chunk>::iterator it = _active_chunks_feed.find(peer_id) ;
@@ -378,15 +433,16 @@ bool ChunkMap::getDataChunk(const RsPeerId& peer_id,uint32_t size_hint,ftChunk&
 	// Get the first slice of the chunk, that is at most of length size
 	//
 	it->second.getSlice(size_hint,chunk) ;
-	_slices_to_download[chunk.offset/_chunk_size]._last_data_received = time(NULL) ;
+	_slices_to_download[chunk.offset/_chunk_size]._last_data_received = now ;
 
 	ChunkDownloadInfo::SliceRequestInfo& r(_slices_to_download[chunk.offset/_chunk_size]._slices[chunk.id]);
 
 	r.size = chunk.size ;
-	r.request_time = time(NULL);
+	r.request_time = now;
 	r.peers.insert(peer_id);
 
 	chunk.peer_id = peer_id ;
+	getSourceThroughputInfo(peer_id,now).pending_bytes += chunk.size ;
 
 #ifdef DEBUG_FTCHUNK
 	std::cout << "*** ChunkMap::getDataChunk: returning slice " << chunk << " for peer " << it->first << std::endl ;
@@ -400,7 +456,7 @@ bool ChunkMap::getDataChunk(const RsPeerId& peer_id,uint32_t size_hint,ftChunk&
 void ChunkMap::removeInactiveChunks(std::vector<ftChunk::OffsetInFile>& to_remove)
 {
 	to_remove.clear() ;
-	rstime_t now = time(NULL) ;
+	rstime_t now = currentTime() ;
 
 	for(std::map<ChunkNumber,ChunkDownloadInfo>::iterator it(_slices_to_download.begin());it!=_slices_to_download.end();)
 		if(now - it->second._last_data_received > (int)INACTIVE_CHUNK_TIME_LAPSE)
@@ -413,7 +469,10 @@ void ChunkMap::removeInactiveChunks(std::vector<ftChunk::OffsetInFile>& to_remov
 			std::map<ChunkNumber,ChunkDownloadInfo>::iterator tmp(it) ;
 
 			for(std::map<ftChunk::OffsetInFile,ChunkDownloadInfo::SliceRequestInfo>::const_iterator it2(it->second._slices.begin());it2!=it->second._slices.end();++it2)
+			{
 				to_remove.push_back(it2->first) ;
+				releasePendingSlice(it2->second) ;
+			}
 
 			_map[it->first] = FileChunksInfo::CHUNK_OUTSTANDING ;	// reset the chunk
 
@@ -490,7 +549,7 @@ void ChunkMap::setPeerAvailabilityMap(const RsPeerId& peer_id,const CompressedCh
 	//
 	SourceChunksInfo& mi(_peers_chunks_availability[peer_id]) ;
 	mi.cmap = cmap ;
-	mi.TS = time(NULL) ;
+	mi.TS = currentTime() ;
 	mi.is_full = true ;
 
 	// Checks wether the map is full of not.
@@ -573,7 +632,7 @@ uint32_t ChunkMap::getAvailableChunk(const RsPeerId& peer_id,bool& map_is_too_ol
 	// useful to get a new map that will also be full, but because we need to be careful not to mislead information,
 	// we still keep asking.
 	//
-	rstime_t now = time(NULL) ;
+	rstime_t now = currentTime() ;
 
 	if((!peer_chunks->is_full) && ((int)now - (int)peer_chunks->TS > (int)SOURCE_CHUNK_MAP_UPDATE_PERIOD)) 
 	{
@@ -649,10 +708,115 @@ void ChunkMap::getChunksInfo(FileChunksInfo& info) const
 
 	for(std::map<RsPeerId,SourceChunksInfo>::const_iterator it(_peers_chunks_availability.begin());it!=_peers_chunks_availability.end();++it)
 		info.compressed_peer_availability_maps[it->first] = it->second.cmap ;
+
+	getSourceRates(info.source_rates) ;
+}
+
+SourceThroughputInfo& ChunkMap::getSourceThroughputInfo(const RsPeerId& peer_id,rstime_t now)
+{
+	std::map<RsPeerId,SourceThroughputInfo>::iterator it(_sources_throughput.find(peer_id)) ;
+
+	if(it == _sources_throughput.end())
+	{
+		SourceThroughputInfo& info(_sources_throughput[peer_id]) ;
+
+		info.first_request_TS = now ;
+		info.last_update_TS = now ;
+
+		return info ;
+	}
+	return it->second ;
+}
+
+void ChunkMap::updateSourceRate(SourceThroughputInfo& info,rstime_t now)
+{
+	if(now <= info.last_update_TS)
+		return ;
+
+	// Wait for the first data before estimating the rate, since tunnels can take a few seconds to start. A source
+	// that sends nothing at all is eventually considered to have a null rate.
+
+	if(!info.has_rate && info.received_bytes == 0 && now < info.first_request_TS + (rstime_t)FT_CHUNKMAP_MAX_SLICE_REASK_DELAY)
+		return ;
+
+	float dt = now - info.last_update_TS ;
+	float instant_rate = info.received_bytes / dt ;
+
+	if(info.has_rate)
+	{
+		float decay = pow(FT_CHUNKMAP_RATE_DECAY,dt) ;
+		info.rate = decay * info.rate + (1.0f - decay) * instant_rate ;
+	}
+	else
+		info.rate = instant_rate ;
+
+	info.has_rate = true ;
+	info.received_bytes = 0 ;
+	info.last_update_TS = now ;
+}
+
+void ChunkMap::sourceDataReceived(const RsPeerId& peer_id,uint32_t size)
+{
+	rstime_t now = currentTime() ;
+	SourceThroughputInfo& info(getSourceThroughputInfo(peer_id,now)) ;
+
+	if(info.received_bytes == 0 && !info.has_rate)
+		info.last_update_TS = now ;	// the rate is measured from the first data received
+
+	updateSourceRate(info,now) ;
+	info.received_bytes += size ;
+}
+
+void ChunkMap::getSourceRates(std::map<RsPeerId,uint32_t>& rates) const
+{
+	rates.clear() ;
+
+	for(std::map<RsPeerId,SourceThroughputInfo>::const_iterator it(_sources_throughput.begin());it!=_sources_throughput.end();++it)
+		if(it->second.has_rate)
+			rates[it->first] = (uint32_t)it->second.rate ;
+}
+
+uint64_t ChunkMap::sourceWindowRoom(const RsPeerId& peer_id,rstime_t now)
+{
+	SourceThroughputInfo& info(getSourceThroughputInfo(peer_id,now)) ;
+	updateSourceRate(info,now) ;
+
+	// Until the rate is known, a source gets one chunk, as if it was the only one.
+
+	uint64_t window = _chunk_size ;
+
+	if(info.has_rate)
+		window = std::max((uint64_t)FT_CHUNKMAP_MIN_SOURCE_WINDOW,std::min((uint64_t)FT_CHUNKMAP_MAX_SOURCE_WINDOW,(uint64_t)(info.rate * FT_CHUNKMAP_PIPELINE_DURATION))) ;
+
+	return (window > info.pending_bytes)?(window - info.pending_bytes):0 ;
+}
+
+float ChunkMap::sourceCompletionTime(const RsPeerId& peer_id,uint64_t additional_size,rstime_t now)
+{
+	SourceThroughputInfo& info(getSourceThroughputInfo(peer_id,now)) ;
+	updateSourceRate(info,now) ;
+
+	if(!info.has_rate || info.rate < 1.0f)
+		return 1e9f ;
+
+	return (info.pending_bytes + additional_size) / info.rate ;
+}
+
+void ChunkMap::releasePendingSlice(const ChunkDownloadInfo::SliceRequestInfo& slice)
+{
+	for(std::set<RsPeerId>::const_iterator it(slice.peers.begin());it!=slice.peers.end();++it)
+	{
+		std::map<RsPeerId,SourceThroughputInfo>::iterator sit(_sources_throughput.find(*it)) ;
+
+		if(sit != _sources_throughput.end())
+			sit->second.pending_bytes -= std::min((uint64_t)slice.size,sit->second.pending_bytes) ;
+	}
 }
 
 void ChunkMap::removeFileSource(const RsPeerId& peer_id)
 {
+	_sources_throughput.erase(peer_id) ;
+
 	std::map<RsPeerId,SourceChunksInfo>::iterator it(_peers_chunks_availability.find(peer_id)) ;
 
 	if(it == _peers_chunks_availability.end())
@@ -24,6 +24,7 @@
 
 #include <map>
 #include "retroshare/rstypes.h"
+#include "util/rstime.h"
 
 // ftChunkMap: 
 // 	- handles chunk map over a complete file
@@ -125,6 +126,22 @@ class SourceChunksInfo
 		}
 };
 
+// Download rate and pending requests of a source, used to give each source as much data to send as it can
+// handle, and to move requests from stalled sources to faster ones.
+//
+class SourceThroughputInfo
+{
+	public:
+		SourceThroughputInfo() : rate(0.0f), has_rate(false), received_bytes(0), first_request_TS(0), last_update_TS(0), pending_bytes(0) {}
+
+		float rate ;						//! estimated download rate in bytes/s. Only valid when has_rate is true.
+		bool has_rate ;					//! false until the source has sent data, or failed to do so for some time.
+		uint64_t received_bytes ;		//! data received since last_update_TS, not yet accounted for in the rate.
+		rstime_t first_request_TS ;	//! time data was first requested to this source
+		rstime_t last_update_TS ;		//! last time the rate was updated
+		uint64_t pending_bytes ;		//! size of the slices requested to this source and not received yet
+};
+
 class ChunkMap
 {
    public:
@@ -149,8 +166,9 @@ class ChunkMap
 
       virtual bool getDataChunk(const RsPeerId& peer_id,uint32_t size_hint,ftChunk& chunk,bool& source_chunk_map_needed) ; 
 
-		/// Returns an already pending slice that was being downloaded but hasn't arrived yet. This is mostly used at the end of the file
-		/// in order to re-ask pendign slices to active peers while slow peers take a lot of time to send their remaining slices.
+		/// Returns an already pending slice that was being downloaded but hasn't arrived yet. At the end of the file, any slice that
+		/// is late is re-asked to active peers while slow peers take a lot of time to send their remaining slices. In the middle
+		/// of the file, only slices of sources that would take much longer than the requesting peer to send them are re-asked.
 		///
 		bool reAskPendingChunk(const RsPeerId& peer_id,uint32_t size_hint,uint64_t& offset,uint32_t& size);
 
@@ -162,6 +180,17 @@ class ChunkMap
 
 		virtual void dataReceived(const ftChunk::OffsetInFile& c_id) ;
 
+		/// Accounts for data received from the given source, in order to estimate its download rate. Sources
+		/// only get new slices while their pending data can be sent in a few seconds at their rate, which lets
+		/// fast sources pipeline several slices and chunks, while slow sources don't hold chunks for ages.
+		///
+		void sourceDataReceived(const RsPeerId& peer_id,uint32_t size) ;
+
+		/// Returns the estimated download rate of each source, in bytes per second. Sources that have not sent
+		/// data yet are not listed.
+		///
+		void getSourceRates(std::map<RsPeerId,uint32_t>& rates) const ;
+
       /// Decides how chunks are selected. 
       ///    STREAMING: the 1st chunk is always returned
       ///       RANDOM: a uniformly random chunk is selected among available chunks for the current source.
@@ -241,7 +270,22 @@ class ChunkMap
 		//
 		uint32_t getAvailableChunk(const RsPeerId& peer_id,bool& chunk_map_too_old) ;
 
+		/// Current time. Overloaded by simulations.
+		virtual rstime_t currentTime() const { return time(NULL) ; }
+
 	private:
+		SourceThroughputInfo& getSourceThroughputInfo(const RsPeerId& peer_id,rstime_t now) ;
+		static void updateSourceRate(SourceThroughputInfo& info,rstime_t now) ;
+
+		/// Amount of data that can still be requested to this source.
+		uint64_t sourceWindowRoom(const RsPeerId& peer_id,rstime_t now) ;
+
+		/// Time the source should need to send what it has pending, plus the given size. Very large when the rate is unknown or null.
+		float sourceCompletionTime(const RsPeerId& peer_id,uint64_t additional_size,rstime_t now) ;
+
+		/// Removes the slice from the pending data of all the sources it was requested to.
+		void releasePendingSlice(const ChunkDownloadInfo::SliceRequestInfo& slice) ;
+
         bool hasChunkState(uint64_t offset, uint32_t chunk_size, FileChunksInfo::ChunkState state) const;
 
 		uint64_t												_file_size ;						//! total size of the file in bytes.
@@ -251,6 +295,7 @@ class ChunkMap
 		std::map<ChunkNumber,ChunkDownloadInfo>	_slices_to_download ; 			//! list of (slice offset,slice size) currently being downloaded
 		std::vector<FileChunksInfo::ChunkState>	_map ;								//! vector of chunk state over the whole file
 		std::map<RsPeerId,SourceChunksInfo>		_peers_chunks_availability ;	//! what does each source peer have
+		std::map<RsPeerId,SourceThroughputInfo>	_sources_throughput ;			//! download rate and pending data of each source
 		uint64_t												_total_downloaded ;				//! completion for the file
 		bool													_file_is_complete ;           //! set to true when the file is complete.
 		bool													_assume_availability ;			//! true if all sources always have the complete file.
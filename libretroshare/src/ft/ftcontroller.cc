@@ -49,6 +49,7 @@
 #include "ft/ftserver.h"
 
 #include "turtle/p3turtle.h"
+#include "turtle/turtlehashfilter.h"
 
 #include "util/rsdir.h"
 #include "rsserver/p3face.h"
@@ -102,6 +103,7 @@ ftController::ftController(ftDataMultiplex *dm, p3ServiceControl *sc, uint32_t f
     mExtraList(NULL),
     mTurtle(NULL),
     mFtServer(NULL),
+    mHashFilter(NULL),
     mServiceCtrl(sc),
     mFtServiceType(ftServiceId),
     mDefaultEncryptionPolicy(RS_FILE_CTRL_ENCRYPTION_POLICY_PERMISSIVE),
@@ -119,6 +121,7 @@ ftController::ftController(ftDataMultiplex *dm, p3ServiceControl *sc, uint32_t f
 
 void ftController::setTurtleRouter(p3turtle *pt) { mTurtle = pt ; }
 void ftController::setFtServer(ftServer *ft) { mFtServer = ft ; }
+void ftController::setHashFilter(TurtleHashFilter *f) { mHashFilter = f ; }
 
 void ftController::setFtSearchNExtra(ftSearch *search, ftExtraList *list)
 {
@@ -1216,6 +1219,9 @@ bool 	ftController::FileRequest(const std::string& fname, const RsFileHash& hash
 		/* add to ClientModule */
 		mDataplex->addTransferModule(tm, fc);
 		mDownloads[hash] = ftfc;
+
+		if(mHashFilter != NULL)
+			mHashFilter->add(hash) ;
 	}
 
 	IndicateConfigChanged(); /* completed transfer -> save */
@@ -44,6 +44,7 @@ class ftExtraList;
 class ftDataMultiplex;
 class p3turtle ;
 class p3ServiceControl;
+class TurtleHashFilter ;
 
 #include "util/rsthreads.h"
 #include "pqi/pqiservicemonitor.h"
@@ -119,6 +120,7 @@ class ftController: public RsTickingThread, public pqiServiceMonitor, public p3C
 		void	setFtSearchNExtra(ftSearch *, ftExtraList *);
 		void	setTurtleRouter(p3turtle *) ;
 		void	setFtServer(ftServer *) ;
+		void	setHashFilter(TurtleHashFilter *) ;	// kept informed of the hashes of new downloads
 		bool    activate();
 		bool 	isActiveAndNoPending();
 
@@ -235,6 +237,7 @@ class ftController: public RsTickingThread, public pqiServiceMonitor, public p3C
 		ftExtraList *mExtraList;
 		p3turtle *mTurtle ;
 		ftServer *mFtServer ;
+		TurtleHashFilter *mHashFilter ;
 		p3ServiceControl *mServiceCtrl;
 		uint32_t mFtServiceType;
 		uint32_t mDefaultEncryptionPolicy;
@@ -28,6 +28,7 @@
 #include <retroshare/rsfiles.h>
 #include "ft/ftextralist.h"
 #include "rsitems/rsconfigitems.h"
+#include "turtle/turtlehashfilter.h"
 #include "util/rsdir.h"
 #include "util/rstime.h"
 #include <stdio.h>
@@ -39,12 +40,43 @@
  *****/
 
 ftExtraList::ftExtraList()
-	:p3Config(), extMutex("p3Config")
+	:p3Config(), extMutex("p3Config"), mHashFilter(NULL)
 {
     cleanup = 0;
     return;
 }
 
+void ftExtraList::locked_addFile(const FileDetails& details)
+{
+	RsFileHash encrypted_hash = makeEncryptedHash(details.info.hash) ;
+
+	mFiles[details.info.hash] = details;
+	mHashOfHash[encrypted_hash] = details.info.hash ;
+
+	if(mHashFilter != NULL)
+	{
+		mHashFilter->add(details.info.hash) ;
+		mHashFilter->add(encrypted_hash) ;
+	}
+}
+
+void ftExtraList::setHashFilter(TurtleHashFilter *filter)
+{
+	RS_STACK_MUTEX(extMutex);
+	mHashFilter = filter ;
+}
+
+void ftExtraList::getExtraFileHashes(std::vector<RsFileHash>& hashes) const
+{
+	RS_STACK_MUTEX(extMutex);
+
+	for(std::map<RsFileHash, FileDetails>::const_iterator it(mFiles.begin());it!=mFiles.end();++it)
+		hashes.push_back(it->first) ;
+
+	for(std::map<RsFileHash, RsFileHash>::const_iterator it(mHashOfHash.begin());it!=mHashOfHash.end();++it)
+		hashes.push_back(it->first) ;
+}
+
 
 void ftExtraList::data_tick()
 {
@@ -118,8 +150,7 @@ void ftExtraList::hashAFile()
 		RS_STACK_MUTEX(extMutex);
 
 		/* stick it in the available queue */
-		mFiles[details.info.hash] = details;
-        mHashOfHash[makeEncryptedHash(details.info.hash)] = details.info.hash ;
+		locked_addFile(details) ;
 
 		/* add to the path->hash map */
 		mHashedList[details.info.path] = details.info.hash;
@@ -157,8 +188,7 @@ bool	ftExtraList::addExtraFile(std::string path, const RsFileHash& hash,
 	details.info.transfer_info_flags = flags ;
 
 	/* stick it in the available queue */
-	mFiles[details.info.hash] = details;
-	mHashOfHash[makeEncryptedHash(details.info.hash)] = details.info.hash ;
+	locked_addFile(details) ;
 
 	IndicateConfigChanged();
 
@@ -498,8 +528,7 @@ bool    ftExtraList::loadList(std::list<RsItem *>& load)
 		details.info.transfer_info_flags = TransferRequestFlags(fi->flags);
 	
 		/* stick it in the available queue */
-		mFiles[details.info.hash] = details;
-        mHashOfHash[makeEncryptedHash(details.info.hash)] = details.info.hash ;
+		locked_addFile(details) ;
 
 		delete (*it);
 
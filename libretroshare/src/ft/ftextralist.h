@@ -60,6 +60,8 @@
 #include "pqi/p3cfgmgr.h"
 #include "util/rstime.h"
 
+class TurtleHashFilter ;
+
 class FileDetails
 {
 	public:
@@ -146,6 +148,14 @@ public:
      */
     void getExtraFileList(std::vector<FileInfo>& files) const ;
 
+    /*!
+     * \brief setHashFilter
+     * 				Sets a filter that is kept informed of every hash search() may find (real and encrypted hashes of extra files).
+     * 				getExtraFileHashes() lists them all. The filter is not owned.
+     */
+    void setHashFilter(TurtleHashFilter *filter) ;
+    void getExtraFileHashes(std::vector<RsFileHash>& hashes) const ;
+
 	/***
 		 * Thread Main Loop
 		 **/
@@ -169,6 +179,7 @@ private:
 	void	hashAFile();
 	bool	cleanupOldFiles();
 	bool    cleanupEntry(std::string path, TransferRequestFlags flags);
+	void    locked_addFile(const FileDetails& details);
 
 	mutable RsMutex extMutex;
 
@@ -178,6 +189,8 @@ private:
 	std::map<RsFileHash, FileDetails> mFiles;
 	std::map<RsFileHash, RsFileHash>  mHashOfHash;	/* sha1(hash) map so as to answer requests to encrypted transfers */
 
+	TurtleHashFilter *mHashFilter;
+
 	rstime_t cleanup ;
 };
 
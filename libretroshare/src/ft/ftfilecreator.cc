@@ -304,6 +304,12 @@ void ftFileCreator::removeFileSource(const RsPeerId& peer_id)
 	chunkMap.removeFileSource(peer_id) ;
 }
 
+void ftFileCreator::sourceDataReceived(const RsPeerId& peer_id,uint32_t size)
+{
+	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+	chunkMap.sourceDataReceived(peer_id,size) ;
+}
+
 int ftFileCreator::locked_initializeFileAttrs()
 {
 #ifdef FILE_DEBUG
@@ -98,6 +98,9 @@ class ftFileCreator: public ftFileProvider
 		// removes the designated file source from the chunkmap.
 		void removeFileSource(const RsPeerId& peer_id) ;
 
+		// accounts for data received from the given source, in order to estimate its rate.
+		void sourceDataReceived(const RsPeerId& peer_id,uint32_t size) ;
+
 		// Get all available sources for this chunk
 		//
 		void getSourcesList(uint32_t chunk_number,std::vector<RsPeerId>& sources) ;
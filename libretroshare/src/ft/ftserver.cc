@@ -64,6 +64,7 @@
 
 static const rstime_t FILE_TRANSFER_LOW_PRIORITY_TASKS_PERIOD = 5 ;           // low priority tasks handling every 5 seconds
 static const rstime_t FILE_TRANSFER_MAX_DELAY_BEFORE_DROP_USAGE_RECORD = 10 ; // keep usage records for 10 secs at most.
+static const rstime_t FILE_TRANSFER_TUNNEL_FILTER_REBUILD_PERIOD       = 600 ; // forget about removed files every 10 minutes.
 
 /* Setup */
 ftServer::ftServer(p3PeerMgr *pm, p3ServiceControl *sc)
@@ -72,6 +73,7 @@ ftServer::ftServer(p3PeerMgr *pm, p3ServiceControl *sc)
       mFileDatabase(NULL),
       mFtController(NULL), mFtExtra(NULL),
       mFtDataplex(NULL), mFtSearch(NULL), srvMutex("ftServer"),
+      mLastTunnelFilterRebuildTime(0),
       mSearchCallbacksMapMutex("ftServer callbacks map")
 {
 	addSerialType(new RsFileTransferSerialiser()) ;
@@ -149,6 +151,9 @@ void ftServer::SetupFtServer()
 	mFtController = new ftController(mFtDataplex, mServiceCtrl, getServiceInfo().mServiceType);
 	mFtController -> setFtSearchNExtra(mFtSearch, mFtExtra);
 
+	mFtExtra->setHashFilter(&mTunnelFilter);
+	mFtController->setHashFilter(&mTunnelFilter);
+
 	std::string emergencySaveDir = RsAccounts::AccountDirectory();
 	std::string emergencyPartialsDir = RsAccounts::AccountDirectory();
 
@@ -179,6 +184,7 @@ void ftServer::connectToFileDatabase(p3FileDatabase *fdb)
 	mFtSearch->addSearchMode(fdb, RS_FILE_HINTS_REMOTE);
 
     mFileDatabase->setExtraList(mFtExtra);
+    mFileDatabase->setTunnelHashFilter(&mTunnelFilter);
 }
 void ftServer::connectToTurtleRouter(p3turtle *fts)
 {
@@ -280,6 +286,7 @@ bool ftServer::activateTunnels(const RsFileHash& hash,uint32_t encryption_policy
 
 	encryptHash(hash,hash_of_hash) ;
 	mEncryptedHashes.insert(std::make_pair(hash_of_hash,hash)) ;
+	mTunnelFilter.add(hash_of_hash) ;
 
 	if(onoff)
 	{
@@ -860,12 +867,14 @@ int  ftServer::watchPeriod() const                 { return mFileDatabase->watch
 bool ftServer::followSymLinks() const              { return mFileDatabase->followSymLinks() ; }
 bool ftServer::ignoreDuplicates()                  { return mFileDatabase->ignoreDuplicates() ; }
 int  ftServer::maxShareDepth() const               { return mFileDatabase->maxShareDepth() ; }
+uint32_t ftServer::remoteFileListsMemoryBudget() const { return mFileDatabase->remoteFileListsMemoryBudget() ; }
 
 void ftServer::setWatchEnabled(bool b)             { mFileDatabase->setWatchEnabled(b) ; }
 void ftServer::setWatchPeriod(int minutes)         { mFileDatabase->setWatchPeriod(minutes*60) ; }
 void ftServer::setFollowSymLinks(bool b)           { mFileDatabase->setFollowSymLinks(b) ; }
 void ftServer::setIgnoreDuplicates(bool ignore)    { mFileDatabase->setIgnoreDuplicates(ignore); }
 void ftServer::setMaxShareDepth(int depth)         { mFileDatabase->setMaxShareDepth(depth) ; }
+void ftServer::setRemoteFileListsMemoryBudget(uint32_t mb) { mFileDatabase->setRemoteFileListsMemoryBudget(mb) ; }
 
 void ftServer::togglePauseHashingProcess()  { mFileDatabase->togglePauseHashingProcess() ; }
 bool ftServer::hashingProcessPaused() { return mFileDatabase->hashingProcessPaused() ; }
@@ -1638,11 +1647,47 @@ int	ftServer::tick()
 		mFtDataplex->handlePendingCrcRequests() ;
 		mFtDataplex->dispatchReceivedChunkCheckSum() ;
 		cleanTimedOutSearches();
+
+		if(!mTunnelFilter.isBuilt() || mTunnelFilter.isOverloaded() || mLastTunnelFilterRebuildTime + FILE_TRANSFER_TUNNEL_FILTER_REBUILD_PERIOD < now)
+		{
+			mLastTunnelFilterRebuildTime = now ;
+			rebuildTunnelFilter() ;
+		}
 	}
 
 	return moreToTick;
 }
 
+void ftServer::rebuildTunnelFilter()
+{
+	// The components keep adding new hashes to the filter while we collect the existing ones. The filter keeps them
+	// aside until the rebuild is finished, so that no hash can be missed.
+
+	mTunnelFilter.beginRebuild() ;
+
+	std::vector<RsFileHash> hashes ;
+	std::list<RsFileHash> downloads ;
+
+	mFileDatabase->getLocalFileHashes(hashes) ;
+	mFtExtra->getExtraFileHashes(hashes) ;
+	mFtController->FileDownloads(downloads) ;
+
+	hashes.insert(hashes.end(),downloads.begin(),downloads.end()) ;
+
+	{
+		RS_STACK_MUTEX(srvMutex) ;
+
+		for(std::map<RsFileHash,RsFileHash>::const_iterator it(mEncryptedHashes.begin());it!=mEncryptedHashes.end();++it)
+			hashes.push_back(it->first) ;
+	}
+
+	mTunnelFilter.finishRebuild(hashes) ;
+
+#ifdef SERVER_DEBUG
+	FTSERVER_DEBUG() << "Rebuilt tunnel request filter with " << hashes.size() << " hashes. Memory usage: " << mTunnelFilter.memoryUsage() << " bytes." << std::endl;
+#endif
+}
+
 bool ftServer::checkUploadLimit(const RsPeerId& pid,const RsFileHash& hash)
 {
     // No need for this extra cost if the value means "unlimited"
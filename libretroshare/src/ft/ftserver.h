@@ -44,6 +44,7 @@
 
 #include "ft/ftdata.h"
 #include "turtle/turtleclientservice.h"
+#include "turtle/turtlehashfilter.h"
 #include "services/p3service.h"
 #include "retroshare/rsfiles.h"
 
@@ -97,6 +98,7 @@ public:
 
     uint16_t serviceId() const { return RS_SERVICE_TYPE_FILE_TRANSFER ; }
     virtual bool handleTunnelRequest(const RsFileHash& hash,const RsPeerId& peer_id) ;
+    virtual const TurtleHashFilter *tunnelRequestFilter() const { return &mTunnelFilter ; }
     virtual void receiveTurtleData(const RsTurtleGenericTunnelItem *item,const RsFileHash& hash,const RsPeerId& virtual_peer_id,RsTurtleGenericTunnelItem::Direction direction) ;
 	virtual void ftReceiveSearchResult(RsTurtleFTSearchResultItem *item);	// We dont use TurtleClientService::receiveSearchResult() because of backward compatibility.
     virtual RsItem *create_item(uint16_t service,uint8_t item_type) const ;
@@ -252,6 +254,9 @@ public:
 	virtual void setMaxShareDepth(int depth) ;
 	virtual int  maxShareDepth() const;
 
+	virtual void setRemoteFileListsMemoryBudget(uint32_t mb) ;
+	virtual uint32_t remoteFileListsMemoryBudget() const ;
+
 	virtual bool ignoreDuplicates() ;
 	virtual void setIgnoreDuplicates(bool ignore) ;
 
@@ -303,6 +308,10 @@ protected:
     bool findRealHash(const RsFileHash& hash, RsFileHash& real_hash);
     bool findEncryptedHash(const RsPeerId& virtual_peer_id, RsFileHash& encrypted_hash);
 
+    // Rebuilds the filter of all the hashes handleTunnelRequest() may accept: local and extra files (real and encrypted hashes),
+    // downloads and encrypted hashes of downloads. In between, the components add new hashes to the filter themselves.
+    void rebuildTunnelFilter();
+
 	bool checkUploadLimit(const RsPeerId& pid,const RsFileHash& hash);
 private:
 
@@ -333,6 +342,9 @@ private:
     std::map<RsPeerId,RsFileHash> mEncryptedPeerIds ;  // This map holds the hash to be used with each peer id
     std::map<RsPeerId,std::map<RsFileHash,rstime_t> > mUploadLimitMap ;
 
+    TurtleHashFilter mTunnelFilter ;
+    rstime_t mLastTunnelFilterRebuildTime ;
+
 	/** Store search callbacks with timeout*/
 	std::map<
 	    TurtleRequestId,
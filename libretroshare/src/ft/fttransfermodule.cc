@@ -327,6 +327,7 @@ bool ftTransferModule::recvFileData(const RsPeerId& peerId, uint64_t offset, uin
 	ok = locked_recvPeerData(mit->second, offset, chunk_size, data);
 
 	locked_storeData(offset, chunk_size, data);
+	mFileCreator->sourceDataReceived(peerId, chunk_size);
 
 	_last_activity_time_stamp = time(NULL) ;
 
@@ -24,6 +24,7 @@
 #include "pqi/authgpg.h"
 #include "util/rsdir.h"
 #include "util/rsmemory.h"
+#include "util/rsrandom.h"
 //#include "retroshare/rspeers.h"
 
 /****
@@ -34,6 +35,8 @@ static const uint32_t MULTI_ENCRYPTION_FORMAT_v001_HEADER              = 0xFACE;
 static const uint32_t MULTI_ENCRYPTION_FORMAT_v001_HEADER_SIZE         = 2 ;
 static const uint32_t MULTI_ENCRYPTION_FORMAT_v001_NUMBER_OF_KEYS_SIZE = 2 ;
 static const uint32_t MULTI_ENCRYPTION_FORMAT_v001_ENCRYPTED_KEY_SIZE  = 256 ;
+
+const uint32_t GxsSecurity::SESSION_KEY_SIZE ;
         
 static RsGxsId getRsaKeyFingerprint_old_insecure_method(RSA *pubkey)
 {
@@ -787,6 +790,93 @@ bool GxsSecurity::encrypt(uint8_t *& out, uint32_t &outlen, const uint8_t *in, u
 	}
 }
 
+bool GxsSecurity::encryptWithSessionKey(uint8_t *&out, uint32_t &outlen, const uint8_t *in, uint32_t inlen, const uint8_t *session_key)
+{
+	// The format of the encrypted data is:
+	//
+	//   [---      IV     ---|---- Encrypted data ---]
+	//       16 bytes           Rest of packet
+
+	out = NULL ;
+	outlen = 0 ;
+
+	const EVP_CIPHER *cipher = EVP_aes_128_cbc();
+	const int iv_size = EVP_CIPHER_iv_length(cipher) ;
+	const int max_outlen = iv_size + inlen + EVP_CIPHER_block_size(cipher) ;
+
+	out = (uint8_t*)rs_malloc(max_outlen) ;
+
+	if(out == NULL)
+		return false ;
+
+	RsRandom::random_bytes(out,iv_size) ;
+
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	int out_offset = iv_size ;
+	int len = 0 ;
+
+	bool ok = EVP_EncryptInit_ex(ctx,cipher,NULL,session_key,out) == 1 ;
+	ok = ok && EVP_EncryptUpdate(ctx,out + out_offset,&len,in,inlen) == 1 ;
+	out_offset += len ;
+	ok = ok && EVP_EncryptFinal_ex(ctx,out + out_offset,&len) == 1 ;
+	out_offset += len ;
+
+	EVP_CIPHER_CTX_free(ctx);
+
+	if(!ok || out_offset > max_outlen)
+	{
+		std::cerr << "(EE) " << __PRETTY_FUNCTION__ << ": encryption failed." << std::endl;
+		free(out) ;
+		out = NULL ;
+		return false ;
+	}
+
+	outlen = out_offset ;
+	return true ;
+}
+
+bool GxsSecurity::decryptWithSessionKey(uint8_t *&out, uint32_t &outlen, const uint8_t *in, uint32_t inlen, const uint8_t *session_key)
+{
+	out = NULL ;
+	outlen = 0 ;
+
+	const EVP_CIPHER *cipher = EVP_aes_128_cbc();
+	const int iv_size = EVP_CIPHER_iv_length(cipher) ;
+
+	if(inlen <= (uint32_t)iv_size)
+	{
+		std::cerr << "(EE) " << __PRETTY_FUNCTION__ << ": encrypted data is too short (" << inlen << " bytes)" << std::endl;
+		return false ;
+	}
+
+	out = (uint8_t*)rs_malloc(inlen) ;
+
+	if(out == NULL)
+		return false ;
+
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	int out_offset = 0 ;
+	int len = 0 ;
+
+	bool ok = EVP_DecryptInit_ex(ctx,cipher,NULL,session_key,in) == 1 ;
+	ok = ok && EVP_DecryptUpdate(ctx,out,&len,in + iv_size,inlen - iv_size) == 1 ;
+	out_offset += len ;
+	ok = ok && EVP_DecryptFinal_ex(ctx,out + out_offset,&len) == 1 ;
+	out_offset += len ;
+
+	EVP_CIPHER_CTX_free(ctx);
+
+	if(!ok)
+	{
+		free(out) ;
+		out = NULL ;
+		return false ;
+	}
+
+	outlen = out_offset ;
+	return true ;
+}
+
 bool GxsSecurity::decrypt(uint8_t *& out, uint32_t & outlen, const uint8_t *in, uint32_t inlen, const RsTlvPrivateRSAKey &key)
 {
 	// Decrypts (in,inlen) into (out,outlen) using the given RSA public key.
@@ -76,6 +76,23 @@ class GxsSecurity
 		static bool decrypt(uint8_t *&out, uint32_t &outlen, const uint8_t *in, uint32_t inlen, const RsTlvPrivateRSAKey& key) ;
 		static bool decrypt(uint8_t *& out, uint32_t & outlen, const uint8_t *in, uint32_t inlen, const std::vector<RsTlvPrivateRSAKey>& keys);
 
+		/*!
+		 * Size of the symmetric keys used by encryptWithSessionKey() and
+		 * decryptWithSessionKey()
+		 */
+		static const uint32_t SESSION_KEY_SIZE = 16 ;
+
+		/*!
+		 * Encrypts data with AES-128-CBC using a session key that was shared
+		 * beforehand, typically itself sent with the multi-key encrypt() above.
+		 * Much cheaper than a RSA envelope when many pieces of data go to the
+		 * same recipients.
+		 * @param out random IV followed by the encrypted data, to be freed by the caller
+		 * @param session_key SESSION_KEY_SIZE bytes
+		 */
+		static bool encryptWithSessionKey(uint8_t *&out, uint32_t &outlen, const uint8_t *in, uint32_t inlen, const uint8_t *session_key) ;
+		static bool decryptWithSessionKey(uint8_t *&out, uint32_t &outlen, const uint8_t *in, uint32_t inlen, const uint8_t *session_key) ;
+
 		/*!
 		 * uses grp signature to check if group has been
 		 * tampered with
@@ -41,6 +41,7 @@
 #define MSG_TABLE_NAME std::string("MESSAGES")
 #define GRP_TABLE_NAME std::string("GROUPS")
 #define DATABASE_RELEASE_TABLE_NAME std::string("DATABASE_RELEASE")
+#define INTEGRITY_CHECK_TABLE_NAME std::string("INTEGRITY_CHECK")
 
 #define GRP_LAST_POST_UPDATE_TRIGGER std::string("LAST_POST_UPDATE")
 
@@ -49,6 +50,7 @@
 // generic
 #define KEY_NXS_DATA        std::string("nxsData")
 #define KEY_NXS_DATA_LEN    std::string("nxsDataLen")
+#define KEY_NXS_DATA_EXT    std::string("nxsDataExt")
 #define KEY_NXS_IDENTITY    std::string("identity")
 #define KEY_GRP_ID          std::string("grpId")
 #define KEY_ORIG_GRP_ID     std::string("origGrpId")
@@ -100,6 +102,14 @@
 #define KEY_DATABASE_RELEASE_ID_VALUE 1
 #define KEY_DATABASE_RELEASE std::string("release")
 
+// integrity check columns
+#define KEY_INTEGRITY_CHECK_ID std::string("id")
+#define KEY_INTEGRITY_CHECK_ID_VALUE 1
+#define KEY_INTEGRITY_LAST_PASS_TS std::string("lastPassTs")
+#define KEY_INTEGRITY_LAST_FULL_PASS_TS std::string("lastFullPassTs")
+#define KEY_INTEGRITY_PASS_START_TS std::string("passStartTs")
+#define KEY_INTEGRITY_LAST_GRP_ID std::string("lastGrpId")
+
 const std::string RsGeneralDataService::GRP_META_SERV_STRING = KEY_NXS_SERV_STRING;
 const std::string RsGeneralDataService::GRP_META_STATUS = KEY_GRP_STATUS;
 const std::string RsGeneralDataService::GRP_META_SUBSCRIBE_FLAG = KEY_GRP_SUBCR_FLAG;
@@ -111,6 +121,10 @@ const std::string RsGeneralDataService::MSG_META_STATUS = KEY_MSG_STATUS;
 const uint32_t RsGeneralDataService::GXS_MAX_ITEM_SIZE = 1572864; // 1.5 Mbytes
 
 static const uint32_t CACHE_ENTRY_GRACE_PERIOD = 600 ; // 10 minutes
+static const uint32_t READ_POOL_MAX_CONNECTIONS = 4 ;
+static const int      DB_BUSY_TIMEOUT_MS        = 5000 ;
+static const uint32_t BLOB_MIGRATION_BATCH_SIZE = 20 ;  // payloads moved to the blob store per call, the database is locked meanwhile
+static const uint32_t BLOB_MIGRATION_SCAN_SIZE  = 500 ; // rows looked at per call when listing the payloads to move
 
 static int addColumn(std::list<std::string> &list, const std::string &attribute)
 {
@@ -120,15 +134,28 @@ static int addColumn(std::list<std::string> &list, const std::string &attribute)
 
 RsDataService::RsDataService(const std::string &serviceDir, const std::string &dbName, uint16_t serviceType,
                              RsGxsSearchModule * /* mod */, const std::string& key)
-    : RsGeneralDataService(), mDbMutex("RsDataService"), mServiceDir(serviceDir), mDbName(dbName), mDbPath(mServiceDir + "/" + dbName), mServType(serviceType), mDb(NULL)
+    : RsGeneralDataService(), mDbMutex("RsDataService"), mServiceDir(serviceDir), mDbName(dbName), mDbPath(mServiceDir + "/" + dbName), mServType(serviceType), mDb(NULL), mReadPool(NULL),
+      mBlobStore(mDbPath + "_blobs", key), mExternalDataThreshold(0), mMigrationPending(false), mMigrationRowId(0), mMigrationMaxRowId(-1),
+      mMigrationMoved(0)
 {
     bool isNewDatabase = !RsDirUtil::fileExists(mDbPath);
     mGrpMetaDataCache_ContainsAllDatabase = false ;
+    mGrpMetaCacheGeneration = 0 ;
 
     mDb = new RetroDb(mDbPath, RetroDb::OPEN_READWRITE_CREATE, key);
+    mDb->setBusyTimeout(DB_BUSY_TIMEOUT_MS);
+
+    // With WAL, readers see the last committed state of the database while a
+    // write transaction is in progress, so reads can use their own connections.
+    bool wal = mDb->enableWriteAheadLog();
 
     initialise(isNewDatabase);
 
+    if(wal)
+        mReadPool = new RetroDbReadPool(mDbPath, key, READ_POOL_MAX_CONNECTIONS);
+    else
+        std::cerr << "RsDataService: cannot enable WAL on " << mDbName << ", reads will be serialised with writes." << std::endl;
+
     // for retrieving msg meta
     mColMsgMeta_GrpId         = addColumn(mMsgMetaColumns, KEY_GRP_ID);
     mColMsgMeta_TimeStamp     = addColumn(mMsgMetaColumns, KEY_TIME_STAMP);
@@ -152,6 +179,8 @@ RsDataService::RsDataService(const std::string &serviceDir, const std::string &d
     mColMsg_NxsData = addColumn(mMsgColumns, KEY_NXS_DATA);
     mColMsg_MetaData = addColumn(mMsgColumns, KEY_NXS_META);
     mColMsg_MsgId = addColumn(mMsgColumns, KEY_MSG_ID);
+    mColMsg_NxsDataExt = addColumn(mMsgColumns, KEY_NXS_DATA_EXT);
+    mColMsg_Hash = addColumn(mMsgColumns, KEY_NXS_HASH);
 
     // for retrieving msg data with meta
     mMsgColumnsWithMeta = mMsgColumns;
@@ -209,10 +238,23 @@ RsDataService::~RsDataService(){
     std::cerr << std::endl;
 #endif
 
+    // close readers first, so that the last connection to close checkpoints the WAL
+    delete mReadPool;
+
     mDb->closeDb();
     delete mDb;
 }
 
+RsDataService::DbReader::DbReader(RsDataService& service)
+    : mHandle(service.mReadPool), mDb(mHandle.db())
+{
+    if(!mDb)
+    {
+        mStack.reset(new RsStackMutex(service.mDbMutex));
+        mDb = service.mDb;
+    }
+}
+
 static bool moveDataFromFileToDatabase(RetroDb *db, const std::string serviceDir, const std::string &tableName, const std::string &keyId, std::list<std::string> &files)
 {
     bool ok = true;
@@ -292,7 +334,7 @@ static bool moveDataFromFileToDatabase(RetroDb *db, const std::string serviceDir
 
 void RsDataService::initialise(bool isNewDatabase)
 {
-    const int databaseRelease = 1;
+    const int databaseRelease = 3;
     int currentDatabaseRelease = 0;
     bool ok = true;
 
@@ -319,6 +361,7 @@ void RsDataService::initialise(bool isNewDatabase)
                      KEY_SIGN_SET + " BLOB," +
                      KEY_NXS_DATA + " BLOB,"+
                      KEY_NXS_DATA_LEN + " INT," +
+                     KEY_NXS_DATA_EXT + " INT DEFAULT 0," +
                      KEY_MSG_STATUS + " INT," +
                      KEY_CHILD_TS + " INT," +
                      KEY_NXS_META + " BLOB," +
@@ -368,6 +411,8 @@ void RsDataService::initialise(bool isNewDatabase)
 
         mDb->execSQL("CREATE INDEX " + MSG_INDEX_GRPID + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID +  ");");
 
+        locked_createIntegrityCheckTable();
+
         // Insert release, no need to upgrade
         ContentValue cv;
         cv.put(KEY_DATABASE_RELEASE_ID, KEY_DATABASE_RELEASE_ID_VALUE);
@@ -442,6 +487,32 @@ void RsDataService::initialise(bool isNewDatabase)
                 currentDatabaseRelease = newRelease;
             }
         }
+
+        // Release 2
+        newRelease = 2;
+        if (ok && currentDatabaseRelease < newRelease) {
+            // Message payloads can be stored out of the database
+            ok = startReleaseUpdate(newRelease);
+            ok = ok && mDb->execSQL("ALTER TABLE " + MSG_TABLE_NAME + " ADD COLUMN " + KEY_NXS_DATA_EXT + " INT DEFAULT 0;");
+            ok = finishReleaseUpdate(newRelease, ok);
+
+            if (ok) {
+                currentDatabaseRelease = newRelease;
+            }
+        }
+
+        // Release 3
+        newRelease = 3;
+        if (ok && currentDatabaseRelease < newRelease) {
+            // The integrity check keeps its progress in the database
+            ok = startReleaseUpdate(newRelease);
+            ok = ok && locked_createIntegrityCheckTable();
+            ok = finishReleaseUpdate(newRelease, ok);
+
+            if (ok) {
+                currentDatabaseRelease = newRelease;
+            }
+        }
     }
 
     if (ok) {
@@ -451,6 +522,16 @@ void RsDataService::initialise(bool isNewDatabase)
     }
 }
 
+bool RsDataService::locked_createIntegrityCheckTable()
+{
+    return mDb->execSQL("CREATE TABLE " + INTEGRITY_CHECK_TABLE_NAME + "(" +
+                        KEY_INTEGRITY_CHECK_ID + " INT PRIMARY KEY," +
+                        KEY_INTEGRITY_LAST_PASS_TS + " INT," +
+                        KEY_INTEGRITY_LAST_FULL_PASS_TS + " INT," +
+                        KEY_INTEGRITY_PASS_START_TS + " INT," +
+                        KEY_INTEGRITY_LAST_GRP_ID + " TEXT);");
+}
+
 bool RsDataService::startReleaseUpdate(int release)
 {
     // Update database
@@ -738,7 +819,19 @@ RsNxsMsg* RsDataService::locked_getMessage(RetroCursor &c)
 
     /* now retrieve msg data */
     offset = 0; data_len = 0;
-    if(ok){
+    if(ok && c.getInt32(mColMsg_NxsDataExt))
+    {
+        c.getString(mColMsg_Hash, temp);
+
+        uint8_t *blob = NULL;
+        ok = mBlobStore.load(RsFileHash(temp), blob, data_len);
+
+        if(ok)
+            ok = msg->msg.GetTlv(blob, data_len, &offset);
+
+        free(blob);
+    }
+    else if(ok){
         data = (char*)c.getData(mColMsg_NxsData, data_len);
         if(data)
             ok &= msg->msg.GetTlv(data, data_len, &offset);
@@ -788,7 +881,17 @@ int RsDataService::storeMessage(const std::list<RsNxsMsg*>& msg)
         char msgData[dataLen];
         uint32_t offset = 0;
         msgPtr->msg.SetTlv(msgData, dataLen, &offset);
-        cv.put(KEY_NXS_DATA, dataLen, msgData);
+
+        // The blob is written before the row is committed, and blobs are only
+        // removed once no row refers to them, see removeUnreferencedData()
+        bool external = mExternalDataThreshold > 0 && dataLen > mExternalDataThreshold
+                && !msgMetaPtr->mHash.isNull()
+                && mBlobStore.store(msgMetaPtr->mHash, (uint8_t*)msgData, dataLen);
+
+        if(!external)
+            cv.put(KEY_NXS_DATA, dataLen, msgData);
+
+        cv.put(KEY_NXS_DATA_EXT, (int32_t)external);
 
         cv.put(KEY_NXS_DATA_LEN, (int32_t)dataLen);
         cv.put(KEY_MSG_ID, msgMetaPtr->mMsgId.toStdString());
@@ -950,6 +1053,8 @@ void RsDataService::locked_updateGrpMetaCache(const RsGxsGrpMetaData& meta)
 		*(it->second) = meta ;
     else
         mGrpMetaDataCache[meta.mGroupId] = new RsGxsGrpMetaData(meta) ;
+
+    ++mGrpMetaCacheGeneration ;
 }
 
 void RsDataService::locked_clearGrpMetaCache(const RsGxsGroupId& gid)
@@ -957,6 +1062,8 @@ void RsDataService::locked_clearGrpMetaCache(const RsGxsGroupId& gid)
 	rstime_t now = time(NULL) ;
     auto it = mGrpMetaDataCache.find(gid) ;
 
+    ++mGrpMetaCacheGeneration ;
+
 	// We dont actually delete the item, because it might be used by a calling client.
 	// In this case, the memory will not be used for long, so we keep it into a list for a safe amount
 	// of time and delete it later. Using smart pointers here would be more elegant, but that would need
@@ -1087,6 +1194,7 @@ int RsDataService::updateGroupKeys(const RsGxsGroupId& grpId,const RsTlvSecurity
     cv.put(KEY_GRP_SUBCR_FLAG, (int32_t)subscribe_flags);
 
     mDb->sqlUpdate(GRP_TABLE_NAME, "grpId='" + grpId.toStdString() + "'", cv);
+    ++mGrpMetaCacheGeneration ;
 
     // finish transaction
     return  mDb->commitTransaction();
@@ -1207,6 +1315,8 @@ int RsDataService::retrieveNxsMsgs(
     int resultCount = 0;
 #endif
 
+    DbReader reader(*this);
+
 	for(auto mit = reqIds.begin(); mit != reqIds.end(); ++mit)
     {
 
@@ -1218,9 +1328,7 @@ int RsDataService::retrieveNxsMsgs(
 
 		if(msgIdV.empty())
 		{
-			RS_STACK_MUTEX(mDbMutex);
-
-            RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, withMeta ? mMsgColumnsWithMeta : mMsgColumns, KEY_GRP_ID+ "='" + grpId.toStdString() + "'", "");
+            RetroCursor* c = reader.db()->sqlQuery(MSG_TABLE_NAME, withMeta ? mMsgColumnsWithMeta : mMsgColumns, KEY_GRP_ID+ "='" + grpId.toStdString() + "'", "");
 
             if(c)
             {
@@ -1231,15 +1339,13 @@ int RsDataService::retrieveNxsMsgs(
 		}
 		else
 		{
-			RS_STACK_MUTEX(mDbMutex);
-
             // request each grp
 			for( std::set<RsGxsMessageId>::const_iterator sit = msgIdV.begin();
 			     sit!=msgIdV.end();++sit )
 			{
                 const RsGxsMessageId& msgId = *sit;
 
-                RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, withMeta ? mMsgColumnsWithMeta : mMsgColumns, KEY_GRP_ID+ "='" + grpId.toStdString()
+                RetroCursor* c = reader.db()->sqlQuery(MSG_TABLE_NAME, withMeta ? mMsgColumnsWithMeta : mMsgColumns, KEY_GRP_ID+ "='" + grpId.toStdString()
                                                + "' AND " + KEY_MSG_ID + "='" + msgId.toStdString() + "'", "");
 
                 if(c)
@@ -1287,7 +1393,7 @@ void RsDataService::locked_retrieveMessages(RetroCursor *c, std::vector<RsNxsMsg
 
 int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaResult &msgMeta)
 {
-    RsStackMutex stack(mDbMutex);
+    DbReader reader(*this);
 
 #ifdef RS_DATA_SERVICE_DEBUG_TIME
     rstime::RsScopeTimer timer("");
@@ -1306,7 +1412,7 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
         std::vector<RsGxsMsgMetaData*> metaSet;
 
         if(msgIdV.empty()){
-            RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID+ "='" + grpId.toStdString() + "'", "");
+            RetroCursor* c = reader.db()->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID+ "='" + grpId.toStdString() + "'", "");
 
             if (c)
             {
@@ -1322,7 +1428,7 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
 
             for(; sit!=msgIdV.end(); ++sit){
                 const RsGxsMessageId& msgId = *sit;
-                RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID+ "='" + grpId.toStdString()
+                RetroCursor* c = reader.db()->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID+ "='" + grpId.toStdString()
                                                + "' AND " + KEY_MSG_ID + "='" + msgId.toStdString() + "'", "");
 
                 if (c)
@@ -1374,126 +1480,143 @@ int RsDataService::retrieveGxsGrpMetaData(RsGxsGrpMetaTemporaryMap& grp)
     std::cerr << std::endl;
 #endif
 
-	RS_STACK_MUTEX(mDbMutex);
-
 #ifdef RS_DATA_SERVICE_DEBUG_TIME
     rstime::RsScopeTimer timer("");
-    int resultCount = 0;
     int requestedGroups = grp.size();
 #endif
 
-    if(grp.empty())
+    bool retrieveAll = grp.empty();
+    std::vector<RsGxsGroupId> missingIds;
+    uint64_t generation;
+
     {
-        if(mGrpMetaDataCache_ContainsAllDatabase)	// grab all the stash from the cache, so as to avoid decryption costs.
+        RS_STACK_MUTEX(mDbMutex);
+
+        if(retrieveAll)
         {
+            if(mGrpMetaDataCache_ContainsAllDatabase)	// grab all the stash from the cache, so as to avoid decryption costs.
+            {
 #ifdef RS_DATA_SERVICE_DEBUG_CACHE
-        std::cerr << (void*)this << ": RsDataService::retrieveGxsGrpMetaData() retrieving all from cache!" << std::endl;
+                std::cerr << (void*)this << ": RsDataService::retrieveGxsGrpMetaData() retrieving all from cache!" << std::endl;
 #endif
-
-			grp = mGrpMetaDataCache ;
+                grp = mGrpMetaDataCache ;
+                return 1;
+            }
         }
         else
-		{
-#ifdef RS_DATA_SERVICE_DEBUG
-			std::cerr << "RsDataService::retrieveGxsGrpMetaData() retrieving all" << std::endl;
+        {
+            for(auto mit = grp.begin(); mit != grp.end(); ++mit)
+            {
+                auto itt = mGrpMetaDataCache.find(mit->first) ;
+
+                if(itt != mGrpMetaDataCache.end())
+                {
+#ifdef RS_DATA_SERVICE_DEBUG_CACHE
+                    std::cerr << "Retrieving Grp metadata grpId=" << mit->first << " from cache!" << std::endl;
 #endif
-			// clear the cache
+                    mit->second = itt->second ;
+                }
+                else
+                    missingIds.push_back(mit->first);
+            }
 
-			RetroCursor* c = mDb->sqlQuery(GRP_TABLE_NAME, mGrpMetaColumns, "", "");
+            if(missingIds.empty())
+                return 1;
+        }
 
-			if(c)
-			{
-				bool valid = c->moveToFirst();
+        generation = mGrpMetaCacheGeneration ;
+    }
 
-				while(valid)
-				{
-					RsGxsGrpMetaData* g = locked_getGrpMeta(*c, 0,true);
+    // Read the missing meta data without holding mDbMutex, so that a large
+    // write transaction does not block us. They can only be added to the
+    // cache if no grp meta data was written in the meantime.
 
-					if(g)
-					{
-						grp[g->mGroupId] = g;
-#ifdef RS_DATA_SERVICE_DEBUG_CACHE
-						std::cerr << (void *)this << ": Retrieving (all) Grp metadata grpId=" << g->mGroupId << std::endl;
-#endif
-					}
-					valid = c->moveToNext();
+    std::vector<RsGxsGrpMetaData*> metas;
+    bool pooled = false;
 
-#ifdef RS_DATA_SERVICE_DEBUG_TIME
-					++resultCount;
-#endif
-				}
-				delete c;
-			}
+    if(mReadPool)
+    {
+        DbReader reader(*this);
+        pooled = reader.pooled();
 
-			mGrpMetaDataCache_ContainsAllDatabase = true ;
-		}
+        if(pooled)
+            retrieveGrpMeta(reader.db(), missingIds, false, metas);
+    }
+
+    RS_STACK_MUTEX(mDbMutex);
+
+    if(pooled && generation == mGrpMetaCacheGeneration)
+    {
+        for(uint32_t i=0;i<metas.size();++i)
+        {
+            // another reader may have cached the same group since we looked
+            RsGxsGrpMetaData*& entry = mGrpMetaDataCache[metas[i]->mGroupId] ;
 
+            if(entry)
+                delete metas[i];
+            else
+                entry = metas[i];
+
+            grp[entry->mGroupId] = entry;
+        }
     }
-	else
+    else
     {
-		std::map<RsGxsGroupId, RsGxsGrpMetaData *>::iterator mit = grp.begin();
+        for(uint32_t i=0;i<metas.size();++i)
+            delete metas[i];
 
-          for(; mit != grp.end(); ++mit)
-          {
-              std::map<RsGxsGroupId, RsGxsGrpMetaData*>::const_iterator itt = mGrpMetaDataCache.find(mit->first) ;
+        metas.clear();
+        retrieveGrpMeta(mDb, missingIds, true, metas);
 
-              if(itt != mGrpMetaDataCache.end())
-              {
-#ifdef RS_DATA_SERVICE_DEBUG_CACHE
-          std::cerr << "Retrieving Grp metadata grpId=" << mit->first << " from cache!" << std::endl;
-#endif
-		  			grp[mit->first] = itt->second ;
-              }
-              else
-			  {
-#ifdef RS_DATA_SERVICE_DEBUG_CACHE
-				  std::cerr << "Retrieving Grp metadata grpId=" << mit->first ;
+        for(uint32_t i=0;i<metas.size();++i)
+            grp[metas[i]->mGroupId] = metas[i];
+    }
+
+    if(retrieveAll)
+        mGrpMetaDataCache_ContainsAllDatabase = true ;
+
+#ifdef RS_DATA_SERVICE_DEBUG_TIME
+    std::cerr << "RsDataService::retrieveGxsGrpMetaData() " << mDbName << ", Requests: " << requestedGroups << ", Results: " << metas.size() << ", Time: " << timer.duration() << std::endl;
 #endif
 
-				  const RsGxsGroupId& grpId = mit->first;
-				  RetroCursor* c = mDb->sqlQuery(GRP_TABLE_NAME, mGrpMetaColumns, "grpId='" + grpId.toStdString() + "'", "");
+    return 1;
+}
+
+void RsDataService::retrieveGrpMeta(RetroDb* db, const std::vector<RsGxsGroupId>& grpIds, bool use_cache,
+                                    std::vector<RsGxsGrpMetaData*>& metas)
+{
+    std::vector<std::string> selections;
 
-				  if(c)
-				  {
-					  bool valid = c->moveToFirst();
+    if(grpIds.empty())
+        selections.push_back("");
+    else
+        for(uint32_t i=0;i<grpIds.size();++i)
+            selections.push_back("grpId='" + grpIds[i].toStdString() + "'");
 
-#ifdef RS_DATA_SERVICE_DEBUG_CACHE
-					  if(!valid)
-						  std::cerr << " Empty query! GrpId " << grpId << " is not in database" << std::endl;
-#endif
-					  while(valid)
-					  {
-						  RsGxsGrpMetaData* g = locked_getGrpMeta(*c, 0,true);
+    for(uint32_t i=0;i<selections.size();++i)
+    {
+        RetroCursor* c = db->sqlQuery(GRP_TABLE_NAME, mGrpMetaColumns, selections[i], "");
 
-						  if(g)
-						  {
-							  grp[g->mGroupId] = g;
-#ifdef RS_DATA_SERVICE_DEBUG_CACHE
-							  std::cerr << ". Got it. Updating cache." << std::endl;
-#endif
-						  }
-						  valid = c->moveToNext();
+        if(!c)
+            continue;
+
+        bool valid = c->moveToFirst();
 
-#ifdef RS_DATA_SERVICE_DEBUG_TIME
-						  ++resultCount;
-#endif
-					  }
-					  delete c;
-				  }
 #ifdef RS_DATA_SERVICE_DEBUG_CACHE
-				  else
-					  std::cerr << ". not found!" << std::endl;
+        if(!valid && !grpIds.empty())
+            std::cerr << " Empty query! GrpId " << grpIds[i] << " is not in database" << std::endl;
 #endif
-			  }
-          }
-
-      }
+        while(valid)
+        {
+            RsGxsGrpMetaData* g = locked_getGrpMeta(*c, 0, use_cache);
 
-#ifdef RS_DATA_SERVICE_DEBUG_TIME
-    std::cerr << "RsDataService::retrieveGxsGrpMetaData() " << mDbName << ", Requests: " << requestedGroups << ", Results: " << resultCount << ", Time: " << timer.duration() << std::endl;
-#endif
+            if(g)
+                metas.push_back(g);
 
-    return 1;
+            valid = c->moveToNext();
+        }
+        delete c;
+    }
 }
 
 int RsDataService::resetDataStore()
@@ -1511,6 +1634,11 @@ int RsDataService::resetDataStore()
         mDb->execSQL("DROP TABLE " + MSG_TABLE_NAME);
         mDb->execSQL("DROP TABLE " + GRP_TABLE_NAME);
         mDb->execSQL("DROP TRIGGER " + GRP_LAST_POST_UPDATE_TRIGGER);
+        ++mGrpMetaCacheGeneration ;
+
+        mBlobStore.removeAllExcept(std::set<RsFileHash>());
+        mMigrationCandidates.clear();
+        mMigrationPending = false;
     }
 
     // recreate database
@@ -1519,6 +1647,268 @@ int RsDataService::resetDataStore()
     return 1;
 }
 
+void RsDataService::setExternalDataThreshold(uint32_t threshold)
+{
+    RS_STACK_MUTEX(mDbMutex);
+
+    mExternalDataThreshold = threshold;
+
+    // payloads already stored are moved by migrateExternalData(), called from the service tick
+    mMigrationPending = threshold > 0;
+    mMigrationCandidates.clear();
+    mMigrationRowId = 0;
+    mMigrationMaxRowId = -1;
+    mMigrationMoved = 0;
+}
+
+bool RsDataService::migrateExternalData()
+{
+    RS_STACK_MUTEX(mDbMutex);
+
+    if(!mMigrationPending)
+        return true;
+
+    if(mMigrationCandidates.empty())
+        locked_findMigrationCandidates();
+
+    mMigrationMoved += locked_moveDataToBlobStore();
+
+    if(mMigrationCandidates.empty() && mMigrationRowId >= mMigrationMaxRowId)
+    {
+        // The freed pages are reused by the messages stored afterwards. The database is not vacuumed,
+        // since that would rewrite it entirely.
+        if(mMigrationMoved > 0)
+            std::cerr << "RsDataService: moved " << mMigrationMoved << " message payloads of " << mDbName << " to the blob store." << std::endl;
+
+        mMigrationPending = false;
+    }
+
+    return !mMigrationPending;
+}
+
+void RsDataService::locked_findMigrationCandidates()
+{
+    // Rows are looked at by ranges of rowids, since reading the columns that follow the payload in a row
+    // means reading the payload pages. Messages stored after the threshold was set are not concerned.
+
+    if(mMigrationMaxRowId < 0)
+    {
+        std::list<std::string> maxColumn;
+        maxColumn.push_back("MAX(_rowid_)");
+
+        RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, maxColumn, "", "");
+
+        mMigrationMaxRowId = (c && c->moveToFirst()) ? c->getInt64(0) : 0;
+        delete c;
+    }
+
+    if(mMigrationRowId >= mMigrationMaxRowId)
+        return;
+
+    std::list<std::string> idColumns;
+    idColumns.push_back(KEY_MSG_ID);
+    idColumns.push_back(KEY_NXS_HASH);
+
+    std::string where;
+    rs_sprintf(where, "_rowid_>%lld AND _rowid_<=%lld AND %s=0 AND %s>%u AND %s<>''", (long long)mMigrationRowId,
+               (long long)(mMigrationRowId + BLOB_MIGRATION_SCAN_SIZE), KEY_NXS_DATA_EXT.c_str(), KEY_NXS_DATA_LEN.c_str(),
+               mExternalDataThreshold, KEY_NXS_HASH.c_str());
+
+    mMigrationRowId += BLOB_MIGRATION_SCAN_SIZE;
+
+    RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, idColumns, where, "");
+
+    if(!c)
+        return;
+
+    bool valid = c->moveToFirst();
+
+    while(valid)
+    {
+        std::string msgId, hash;
+        c->getString(0, msgId);
+        c->getString(1, hash);
+        mMigrationCandidates.push_back(std::make_pair(msgId, hash));
+
+        valid = c->moveToNext();
+    }
+    delete c;
+}
+
+uint32_t RsDataService::locked_moveDataToBlobStore()
+{
+    if(mMigrationCandidates.empty())
+        return 0;
+
+    std::list<std::string> dataColumn;
+    dataColumn.push_back(KEY_NXS_DATA);
+
+    uint32_t moved = 0;
+
+    mDb->beginTransaction();
+
+    for(uint32_t i = 0; i < BLOB_MIGRATION_BATCH_SIZE && !mMigrationCandidates.empty(); ++i)
+    {
+        std::string msgId = mMigrationCandidates.front().first;
+        RsFileHash hash(mMigrationCandidates.front().second);
+        mMigrationCandidates.pop_front();
+
+        if(hash.isNull())
+            continue;
+
+        // the message may have been removed meanwhile, or already moved
+        RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, dataColumn, KEY_MSG_ID + "='" + msgId + "' AND " + KEY_NXS_DATA_EXT + "=0", "");
+
+        bool stored = false;
+
+        if(c && c->moveToFirst())
+        {
+            uint32_t len = 0;
+            const uint8_t *data = (const uint8_t*)c->getData(0, len);
+
+            stored = data != NULL && mBlobStore.store(hash, data, len);
+        }
+        delete c;
+
+        if(stored && mDb->execSQL("UPDATE " + MSG_TABLE_NAME + " SET " + KEY_NXS_DATA + "=NULL, " + KEY_NXS_DATA_EXT + "=1 WHERE "
+                                  + KEY_MSG_ID + "='" + msgId + "';"))
+            ++moved;
+    }
+
+    mDb->commitTransaction();
+
+    return moved;
+}
+
+int RsDataService::removeUnreferencedData()
+{
+    // Hold the lock while listing the blobs, so that a message being stored
+    // cannot have its blob removed before its row is committed.
+    RS_STACK_MUTEX(mDbMutex);
+
+    std::list<std::string> columns;
+    columns.push_back(KEY_NXS_HASH);
+
+    std::set<RsFileHash> hashes;
+    RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, columns, KEY_NXS_DATA_EXT + "=1", "");
+
+    if(!c)
+        return 0;
+
+    bool valid = c->moveToFirst();
+
+    while(valid)
+    {
+        std::string hash;
+        c->getString(0, hash);
+        hashes.insert(RsFileHash(hash));
+
+        valid = c->moveToNext();
+    }
+    delete c;
+
+    return mBlobStore.removeAllExcept(hashes) ? 1 : 0;
+}
+
+int RsDataService::retrieveMsgIdsWithoutData(const RsGxsGroupId& grpId, std::set<RsGxsMessageId>& msgIds)
+{
+    RS_STACK_MUTEX(mDbMutex);
+
+    msgIds.clear();
+
+    std::list<std::string> columns;
+    columns.push_back(KEY_MSG_ID);
+    columns.push_back(KEY_NXS_DATA_EXT);
+    columns.push_back(KEY_NXS_HASH);
+
+    // length() of a blob only reads the row header, not the payload
+    std::string where = KEY_GRP_ID + "='" + grpId.toStdString() + "' AND (" + KEY_NXS_DATA_EXT + "=1 OR IFNULL(length("
+                        + KEY_NXS_DATA + "),0)=0)";
+
+    RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, columns, where, "");
+
+    if(!c)
+        return 0;
+
+    bool valid = c->moveToFirst();
+
+    while(valid)
+    {
+        std::string msgId, hash;
+        c->getString(0, msgId);
+        c->getString(2, hash);
+
+        if(c->getInt32(1) == 0 || !mBlobStore.contains(RsFileHash(hash)))
+            msgIds.insert(RsGxsMessageId(msgId));
+
+        valid = c->moveToNext();
+    }
+    delete c;
+
+    return 1;
+}
+
+int RsDataService::retrieveIntegrityCheckpoint(RsGxsIntegrityCheckpoint& checkpoint)
+{
+    RS_STACK_MUTEX(mDbMutex);
+
+    checkpoint = RsGxsIntegrityCheckpoint();
+
+    std::list<std::string> columns;
+    columns.push_back(KEY_INTEGRITY_LAST_PASS_TS);
+    columns.push_back(KEY_INTEGRITY_LAST_FULL_PASS_TS);
+    columns.push_back(KEY_INTEGRITY_PASS_START_TS);
+    columns.push_back(KEY_INTEGRITY_LAST_GRP_ID);
+
+    std::string where;
+    rs_sprintf(where, "%s=%d", KEY_INTEGRITY_CHECK_ID.c_str(), KEY_INTEGRITY_CHECK_ID_VALUE);
+
+    RetroCursor* c = mDb->sqlQuery(INTEGRITY_CHECK_TABLE_NAME, columns, where, "");
+
+    if(!c)
+        return 0;
+
+    if(c->moveToFirst())
+    {
+        checkpoint.mLastPassTS = c->getInt32(0);
+        checkpoint.mLastFullPassTS = c->getInt32(1);
+        checkpoint.mPassStartTS = c->getInt32(2);
+
+        std::string grpId;
+        c->getString(3, grpId);
+        checkpoint.mLastGrpId = RsGxsGroupId(grpId);
+    }
+    delete c;
+
+    return 1;
+}
+
+int RsDataService::storeIntegrityCheckpoint(const RsGxsIntegrityCheckpoint& checkpoint)
+{
+    RS_STACK_MUTEX(mDbMutex);
+
+    std::string where;
+    rs_sprintf(where, "%s=%d", KEY_INTEGRITY_CHECK_ID.c_str(), KEY_INTEGRITY_CHECK_ID_VALUE);
+
+    ContentValue cv;
+    cv.put(KEY_INTEGRITY_CHECK_ID, KEY_INTEGRITY_CHECK_ID_VALUE);
+    cv.put(KEY_INTEGRITY_LAST_PASS_TS, (int32_t)checkpoint.mLastPassTS);
+    cv.put(KEY_INTEGRITY_LAST_FULL_PASS_TS, (int32_t)checkpoint.mLastFullPassTS);
+    cv.put(KEY_INTEGRITY_PASS_START_TS, (int32_t)checkpoint.mPassStartTS);
+    cv.put(KEY_INTEGRITY_LAST_GRP_ID, checkpoint.mLastGrpId.toStdString());
+
+    bool ok = mDb->beginTransaction();
+    ok = ok && mDb->sqlDelete(INTEGRITY_CHECK_TABLE_NAME, where, "");
+    ok = ok && mDb->sqlInsert(INTEGRITY_CHECK_TABLE_NAME, "", cv);
+
+    if(ok)
+        ok = mDb->commitTransaction();
+    else
+        mDb->rollbackTransaction();
+
+    return ok ? 1 : 0;
+}
+
 int RsDataService::updateGroupMetaData(GrpLocMetaData &meta)
 {
 #ifdef RS_DATA_SERVICE_DEBUG_CACHE
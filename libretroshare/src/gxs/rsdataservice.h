@@ -22,7 +22,10 @@
 #ifndef RSDATASERVICE_H
 #define RSDATASERVICE_H
 
+#include <memory>
+
 #include "gxs/rsgds.h"
+#include "gxs/rsgxsblobstore.h"
 #include "util/retrodb.h"
 
 class MsgUpdate
@@ -163,6 +166,30 @@ public:
      */
     int resetDataStore();
 
+    /*!
+     * Store the payload of messages bigger than \p threshold bytes in a
+     * blob directory next to the database instead of the database itself,
+     * and move there the ones already stored. Payloads already moved are
+     * still read from the blob directory when the threshold is lowered or
+     * set back to 0 (the default, all new payloads in the database).
+     * Payloads already stored are moved by migrateExternalData().
+     */
+    void setExternalDataThreshold(uint32_t threshold);
+
+    bool migrateExternalData();
+
+    /*!
+     * Remove the payloads of the blob directory which no longer belong to a
+     * message, payloads of removed messages are not deleted before that
+     * @return error code
+     */
+    int removeUnreferencedData();
+
+    int retrieveMsgIdsWithoutData(const RsGxsGroupId& grpId, std::set<RsGxsMessageId>& msgIds);
+
+    int retrieveIntegrityCheckpoint(RsGxsIntegrityCheckpoint& checkpoint);
+    int storeIntegrityCheckpoint(const RsGxsIntegrityCheckpoint& checkpoint);
+
     bool validSize(RsNxsMsg* msg) const;
     bool validSize(RsNxsGrp* grp) const;
 
@@ -210,6 +237,16 @@ private:
      */
     RsGxsGrpMetaData* locked_getGrpMeta(RetroCursor& c, int colOffset, bool use_cache);
 
+    /*!
+     * Reads grp meta data from the database
+     * @param db connection to query, mDbMutex must be held if it is mDb or if use_cache is true
+     * @param grpIds groups to retrieve, all groups are retrieved if empty
+     * @param use_cache store results in (and take them from) the grp meta cache
+     * @param metas retrieved meta data, owned by the cache if use_cache is true
+     */
+    void retrieveGrpMeta(RetroDb* db, const std::vector<RsGxsGroupId>& grpIds, bool use_cache,
+                         std::vector<RsGxsGrpMetaData*>& metas);
+
     /*!
      * extracts a msg item from a cursor at its
      * current position
@@ -236,6 +273,17 @@ private:
     bool locked_removeMessageEntries(const GxsMsgReq& msgIds);
     bool locked_removeGroupEntries(const std::vector<RsGxsGroupId>& grpIds);
 
+    /*!
+     * List the payloads above mExternalDataThreshold still stored in the database
+     */
+    void locked_findMigrationCandidates();
+
+    /*!
+     * Move a batch of the listed payloads from the database to the blob store
+     * @return number of payloads moved
+     */
+    uint32_t locked_moveDataToBlobStore();
+
 private:
     /*!
      * Start release update
@@ -244,6 +292,11 @@ private:
      */
     bool startReleaseUpdate(int release);
 
+    /*!
+     * Creates the table keeping the integrity check progress
+     */
+    bool locked_createIntegrityCheckTable();
+
     /*!
      * Finish release update
      * @param release
@@ -254,6 +307,25 @@ private:
 
 private:
 
+    /*!
+     * Gives access to a connection to read from: a pooled one when
+     * available, so that reads are not serialised with writes, otherwise
+     * mDb with mDbMutex held
+     */
+    class DbReader
+    {
+    public:
+        explicit DbReader(RsDataService& service);
+
+        RetroDb* db() const { return mDb; }
+        bool pooled() const { return !mStack; }
+
+    private:
+        RetroDbReadHandle mHandle;
+        std::unique_ptr<RsStackMutex> mStack;
+        RetroDb* mDb;
+    };
+
     RsMutex mDbMutex;
 
     std::list<std::string> mMsgColumns;
@@ -289,6 +361,8 @@ private:
     int mColMsg_NxsData;
     int mColMsg_MetaData;
     int mColMsg_MsgId;
+    int mColMsg_NxsDataExt;
+    int mColMsg_Hash;
 
     // Message columns with meta
     int mColMsg_WithMetaOffset;
@@ -340,6 +414,18 @@ private:
     uint16_t mServType;
 
     RetroDb* mDb;
+
+    // query-only connections used for reading, NULL if the database could not be switched to WAL mode
+    RetroDbReadPool* mReadPool;
+
+    // payloads of large messages, see setExternalDataThreshold()
+    RsGxsBlobStore mBlobStore;
+    uint32_t mExternalDataThreshold;
+    bool mMigrationPending;
+    std::list<std::pair<std::string, std::string> > mMigrationCandidates;	// (msgId, hash) of the payloads to move
+    int64_t mMigrationRowId;		// rows up to this one were listed
+    int64_t mMigrationMaxRowId;	// last row stored before the migration started, -1 until known
+    uint32_t mMigrationMoved;
     
     // used to store metadata instead of reading it from the database.
     // The boolean variable below is also used to force re-reading when 
@@ -352,6 +438,10 @@ private:
 	std::list<std::pair<rstime_t,RsGxsGrpMetaData*> > mOldCachedItems ;
 
     bool mGrpMetaDataCache_ContainsAllDatabase ;
+
+    // incremented each time grp meta data are written, so that meta data read
+    // without mDbMutex held are only added to the cache if they are still up to date
+    uint64_t mGrpMetaCacheGeneration;
 };
 
 #endif // RSDATASERVICE_H
@@ -91,6 +91,25 @@ struct RsGroupNetworkStats
 	rstime_t   mLastGroupModificationTS;
 };
 
+/*!
+ * Progress of the integrity check of a data store. It is kept in the store
+ * itself so that an interrupted pass resumes where it stopped after a restart.
+ */
+struct RsGxsIntegrityCheckpoint
+{
+	RsGxsIntegrityCheckpoint() :
+	    mLastPassTS(0), mLastFullPassTS(0), mPassStartTS(0) {}
+
+	/// start time of the last completed pass, rows received before are known good
+	uint32_t mLastPassTS;
+	/// start time of the last completed pass which checked every row
+	uint32_t mLastFullPassTS;
+	/// start time of the pass in progress, 0 when no pass is in progress
+	uint32_t mPassStartTS;
+	/// last group checked by the pass in progress
+	RsGxsGroupId mLastGrpId;
+};
+
 typedef std::map<RsGxsGroupId,      std::vector<RsNxsMsg*> > NxsMsgDataResult;
 typedef std::map<RsGxsGrpMsgIdPair, std::vector<RsNxsMsg*> > NxsMsgRelatedDataResult;
 typedef std::map<RsGxsGroupId,      std::vector<RsNxsMsg*> > GxsMsgResult; // <grpId, msgs>
@@ -274,6 +293,45 @@ public:
      */
     virtual bool validSize(RsNxsGrp* grp) const = 0 ;
 
+    /*!
+     * Remove data kept outside of the store itself (e.g. large message
+     * payloads) which no longer belongs to any message
+     * @return error code
+     */
+    virtual int removeUnreferencedData() = 0;
+
+    /*!
+     * Moves a bounded batch of payloads to the data kept outside of the
+     * store, when the store was told to keep large payloads there. Called
+     * regularly, so that an existing store is converted without blocking.
+     * @return true when there is nothing left to move
+     */
+    virtual bool migrateExternalData() = 0;
+
+    /*!
+     * Retrieves the messages of a group whose payload is missing, either in
+     * the store or in the data kept outside of it. Payloads are not read.
+     * @param grpId group to check
+     * @param msgIds is set to the ids of these messages
+     * @return error code
+     */
+    virtual int retrieveMsgIdsWithoutData(const RsGxsGroupId& grpId, std::set<RsGxsMessageId>& msgIds) = 0;
+
+    /*!
+     * Retrieves the progress of the integrity check, a default constructed
+     * checkpoint is returned if none was stored yet
+     * @param checkpoint is set to the stored checkpoint
+     * @return error code
+     */
+    virtual int retrieveIntegrityCheckpoint(RsGxsIntegrityCheckpoint& checkpoint) = 0;
+
+    /*!
+     * Stores the progress of the integrity check
+     * @param checkpoint the checkpoint to store
+     * @return error code
+     */
+    virtual int storeIntegrityCheckpoint(const RsGxsIntegrityCheckpoint& checkpoint) = 0;
+
 };
 
 
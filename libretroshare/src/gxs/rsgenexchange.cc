@@ -134,10 +134,12 @@ bool RsGenExchange::getGroupServerUpdateTS(const RsGxsGroupId& gid, rstime_t& gr
 
 void RsGenExchange::data_tick()
 {
-	static const double timeDelta = 0.1; // slow tick in sec
+	static const std::chrono::milliseconds timeDelta(100); // slow tick
 
 	tick();
-	rstime::rs_usleep((int) (timeDelta * 1000 *1000)); // timeDelta sec
+
+	// Requests submitted meanwhile wake us up, so that they are served at once
+	mDataAccess->waitForNewRequests(timeDelta);
 }
 
 void RsGenExchange::tick()
@@ -172,6 +174,9 @@ void RsGenExchange::tick()
 	// implemented service tick function
 	service_tick();
 
+	// large payloads of an existing database are moved out of it a few at a time
+	mDataStore->migrateExternalData();
+
 	rstime_t now = time(NULL);
     
 	if((mLastClean + MSG_CLEANUP_PERIOD < now) || mCleaning)
@@ -180,6 +185,17 @@ void RsGenExchange::tick()
 		{
 			if(mMsgCleanUp->clean())
 			{
+				GxsMsgReq msgIds;
+				mMsgCleanUp->getDeletedIds(msgIds);
+
+				if(!msgIds.empty())
+				{
+					RS_STACK_MUTEX(mGenMtx) ;
+					RsGxsMsgChange* c = new RsGxsMsgChange(RsGxsNotify::TYPE_PROCESSED, false);
+					c->msgChangeMap = msgIds;
+					mNotifications.push_back(c);
+				}
+
 				mCleaning = false;
 				delete mMsgCleanUp;
 				mMsgCleanUp = NULL;
@@ -2358,6 +2374,9 @@ void RsGenExchange::publishMsgs()
 		RsGxsMsgChange* ch = new RsGxsMsgChange(RsGxsNotify::TYPE_PUBLISHED, false);
 		ch->msgChangeMap = msgChangeMap;
 		mNotifications.push_back(ch);
+
+		if(mNetService != NULL)
+			mNetService->announceNewMessages(msgChangeMap) ;
 	}
 
 }
@@ -2508,6 +2527,8 @@ void RsGenExchange::processMessageDelete()
 	std::map<uint32_t, GrpNote> toNotify;
 #endif
 
+	GxsMsgReq msgDeleted;
+
 	for( std::vector<MsgDeletePublish>::iterator vit = mMsgDeletePublish.begin(); vit != mMsgDeletePublish.end(); ++vit)
 	{
 #ifdef TODO 
@@ -2516,6 +2537,16 @@ void RsGenExchange::processMessageDelete()
 		toNotify.insert(std::make_pair( token, GrpNote(true, groupId)));
 #endif
 		mDataStore->removeMsgs( (*vit).mMsgs );
+
+		for(auto it((*vit).mMsgs.begin()); it != (*vit).mMsgs.end(); ++it)
+			msgDeleted[it->first].insert(it->second.begin(), it->second.end());
+	}
+
+	if(!msgDeleted.empty())
+	{
+		RsGxsMsgChange* c = new RsGxsMsgChange(RsGxsNotify::TYPE_PROCESSED, false);
+		c->msgChangeMap = msgDeleted;
+		mNotifications.push_back(c);
 	}
 
 
@@ -2899,6 +2930,7 @@ void RsGenExchange::computeHash(const RsTlvBinaryData& data, RsFileHash& hash)
 void RsGenExchange::processRecvdMessages()
 {
     std::list<RsGxsMessageId> messages_to_reject ;
+    GxsMsgReq stored_msgs ;
 
     {
 	    RS_STACK_MUTEX(mGenMtx) ;
@@ -3074,6 +3106,8 @@ void RsGenExchange::processRecvdMessages()
 		    RsGxsMsgChange* c = new RsGxsMsgChange(RsGxsNotify::TYPE_RECEIVED_NEW, false);
 		    c->msgChangeMap = msgIds;
 		    mNotifications.push_back(c);
+
+		    stored_msgs = msgIds ;
 	    }
     }
 
@@ -3082,6 +3116,9 @@ void RsGenExchange::processRecvdMessages()
     if(mNetService != NULL)
 	    for(std::list<RsGxsMessageId>::const_iterator it(messages_to_reject.begin());it!=messages_to_reject.end();++it)
 		    mNetService->rejectMessage(*it) ;
+
+    if(mNetService != NULL && !stored_msgs.empty())
+	    mNetService->announceNewMessages(stored_msgs) ;
 }
 
 bool RsGenExchange::acceptNewGroup(const RsGxsGrpMetaData* /*grpMeta*/ ) { return true; }
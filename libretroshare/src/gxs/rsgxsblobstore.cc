@@ -0,0 +1,172 @@
+/*******************************************************************************
+ * libretroshare/src/gxs: rsgxsblobstore.cc                                    *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#include <cstdio>
+#include <cstring>
+
+#include "gxs/rsgxsblobstore.h"
+#include "util/rsdir.h"
+#include "util/rsmemory.h"
+
+static const std::string BLOB_TMP_SUFFIX = ".tmp" ;
+
+RsGxsBlobStore::RsGxsBlobStore(const std::string& directory, const std::string& key)
+    : mDirectory(directory), mEncrypted(!key.empty())
+{
+	memset(mKey, 0, sizeof(mKey));
+	memset(mNameSalt, 0, sizeof(mNameSalt));
+
+	if(mEncrypted)
+	{
+		// Don't use the database key itself, derive both the file key and the name salt from it.
+		std::string seed = "RsGxsBlobStore:" + key;
+		Sha256CheckSum h = RsDirUtil::sha256sum((const uint8_t*)seed.data(), seed.size());
+
+		memcpy(mKey, h.toByteArray(), sizeof(mKey));
+		memcpy(mNameSalt, h.toByteArray() + sizeof(mKey), sizeof(mNameSalt));
+	}
+}
+
+std::string RsGxsBlobStore::fileName(const RsFileHash& hash) const
+{
+	if(!mEncrypted)
+		return hash.toStdString();
+
+	uint8_t buf[sizeof(mNameSalt) + RsFileHash::SIZE_IN_BYTES];
+	memcpy(buf, mNameSalt, sizeof(mNameSalt));
+	memcpy(buf + sizeof(mNameSalt), hash.toByteArray(), RsFileHash::SIZE_IN_BYTES);
+
+	return RsDirUtil::sha1sum(buf, sizeof(buf)).toStdString();
+}
+
+bool RsGxsBlobStore::store(const RsFileHash& hash, const uint8_t *data, uint32_t size)
+{
+	std::string path = mDirectory + "/" + fileName(hash);
+
+	if(RsDirUtil::fileExists(path))
+		return true;
+
+	if(!RsDirUtil::checkCreateDirectory(mDirectory))
+	{
+		std::cerr << __PRETTY_FUNCTION__ << " cannot create directory " << mDirectory << std::endl;
+		return false;
+	}
+
+	uint8_t *encrypted = NULL;
+	uint32_t encrypted_len = 0;
+
+	if(mEncrypted)
+	{
+		if(!GxsSecurity::encryptWithSessionKey(encrypted, encrypted_len, data, size, mKey))
+			return false;
+
+		data = encrypted;
+		size = encrypted_len;
+	}
+
+	// Write to a temporary file first, so that a file with the final name is always complete.
+	std::string tmpPath = path + BLOB_TMP_SUFFIX;
+	FILE *f = RsDirUtil::rs_fopen(tmpPath.c_str(), "wb");
+	bool ok = (f != NULL);
+
+	if(ok)
+	{
+		ok = (size == 0 || fwrite(data, size, 1, f) == 1);
+		ok = (fclose(f) == 0) && ok;
+	}
+
+	free(encrypted);
+
+	if(ok)
+		ok = RsDirUtil::renameFile(tmpPath, path);
+
+	if(!ok)
+	{
+		std::cerr << __PRETTY_FUNCTION__ << " cannot write " << path << std::endl;
+		RsDirUtil::removeFile(tmpPath);
+	}
+	return ok;
+}
+
+bool RsGxsBlobStore::contains(const RsFileHash& hash) const
+{
+	return RsDirUtil::fileExists(mDirectory + "/" + fileName(hash));
+}
+
+bool RsGxsBlobStore::load(const RsFileHash& hash, uint8_t *& data, uint32_t& size) const
+{
+	data = NULL;
+	size = 0;
+
+	std::string path = mDirectory + "/" + fileName(hash);
+	FILE *f = RsDirUtil::rs_fopen(path.c_str(), "rb");
+
+	if(!f)
+	{
+		std::cerr << __PRETTY_FUNCTION__ << " missing payload " << hash << std::endl;
+		return false;
+	}
+
+	bool ok = (fseek(f, 0, SEEK_END) == 0);
+	long len = ok ? ftell(f) : -1;
+	ok = ok && len >= 0 && fseek(f, 0, SEEK_SET) == 0;
+
+	uint8_t *buf = NULL;
+
+	if(ok && len > 0)
+	{
+		buf = (uint8_t*)rs_malloc(len);
+		ok = (buf != NULL) && fread(buf, len, 1, f) == 1;
+	}
+	fclose(f);
+
+	if(!ok)
+	{
+		std::cerr << __PRETTY_FUNCTION__ << " cannot read " << path << std::endl;
+		free(buf);
+		return false;
+	}
+
+	if(!mEncrypted)
+	{
+		data = buf;
+		size = len;
+		return true;
+	}
+
+	ok = GxsSecurity::decryptWithSessionKey(data, size, buf, len, mKey);
+	free(buf);
+
+	if(!ok)
+		std::cerr << __PRETTY_FUNCTION__ << " cannot decrypt payload " << hash << std::endl;
+
+	return ok;
+}
+
+bool RsGxsBlobStore::removeAllExcept(const std::set<RsFileHash>& hashes)
+{
+	std::set<std::string> keep;
+
+	for(std::set<RsFileHash>::const_iterator it = hashes.begin(); it != hashes.end(); ++it)
+		keep.insert(fileName(*it));
+
+	return RsDirUtil::cleanupDirectory(mDirectory, keep);
+}
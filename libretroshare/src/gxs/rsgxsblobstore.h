@@ -0,0 +1,82 @@
+/*******************************************************************************
+ * libretroshare/src/gxs: rsgxsblobstore.h                                     *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <set>
+#include <string>
+
+#include "retroshare/rstypes.h"
+#include "gxs/gxssecurity.h"
+
+/*!
+ * Directory of large GXS message payloads, kept out of the service database
+ * so that it does not grow with data that is only read when the message
+ * itself is displayed.
+ * Payloads are addressed by their hash (the mHash of the message meta data),
+ * so identical payloads are stored once and a file never changes after it
+ * has been written: reading needs no lock, writing and removing must be
+ * serialised by the caller.
+ * When a key is given, as for the encrypted database they complement, files
+ * are encrypted and their names are derived from the key and the hash.
+ */
+class RsGxsBlobStore
+{
+public:
+
+	/*!
+	 * @param directory where to store the files, created on first write
+	 * @param key database key, files are stored in clear if empty
+	 */
+	RsGxsBlobStore(const std::string& directory, const std::string& key);
+
+	/*!
+	 * Store a payload, nothing is done if it is already stored
+	 * @return false if the file could not be written
+	 */
+	bool store(const RsFileHash& hash, const uint8_t *data, uint32_t size);
+
+	/*!
+	 * @param data payload, allocated with rs_malloc, to be freed by the caller
+	 * @return false if the payload is missing or unreadable
+	 */
+	bool load(const RsFileHash& hash, uint8_t *& data, uint32_t& size) const;
+
+	/*!
+	 * @return true if the payload is stored. Its content is not checked.
+	 */
+	bool contains(const RsFileHash& hash) const;
+
+	/*!
+	 * Remove all payloads but the ones in \p hashes, and leftovers of
+	 * interrupted writes
+	 */
+	bool removeAllExcept(const std::set<RsFileHash>& hashes);
+
+private:
+
+	std::string fileName(const RsFileHash& hash) const;
+
+	std::string mDirectory;
+	bool mEncrypted;
+	uint8_t mKey[GxsSecurity::SESSION_KEY_SIZE];
+	uint8_t mNameSalt[GxsSecurity::SESSION_KEY_SIZE];
+};
@@ -31,7 +31,8 @@
  **********/
 
 RsGxsDataAccess::RsGxsDataAccess(RsGeneralDataService* ds) :
-    mDataStore(ds), mDataMutex("RsGxsDataAccess"), mNextToken(0) {}
+    mDataStore(ds), mDataMutex("RsGxsDataAccess"), mNextToken(0),
+    mHasNewRequest(false) {}
 
 
 RsGxsDataAccess::~RsGxsDataAccess()
@@ -302,10 +303,58 @@ void RsGxsDataAccess::setReq(GxsRequest* req, uint32_t token, uint32_t ansType,
 }
 void RsGxsDataAccess::storeRequest(GxsRequest* req)
 {
-	RS_STACK_MUTEX(mDataMutex);
-	req->status = PENDING;
-	req->reqTime = time(NULL);
-	mRequests[req->token] = req;
+	{
+		RS_STACK_MUTEX(mDataMutex);
+		req->status = PENDING;
+		req->reqTime = time(NULL);
+		mRequests[req->token] = req;
+	}
+	notifyNewRequest();
+}
+
+RsTokenService::GxsRequestStatus RsGxsDataAccess::waitToken(
+        uint32_t token, std::chrono::milliseconds maxWait,
+        std::chrono::milliseconds /*checkEvery*/ )
+{
+	auto timeout = std::chrono::steady_clock::now() + maxWait;
+
+	std::unique_lock<std::mutex> lock(mTokenWaitMtx);
+	auto st = requestStatus(token);
+
+	while( !(st == RsTokenService::FAILED || st >= RsTokenService::COMPLETE) )
+	{
+		if( mTokenWaitCv.wait_until(lock, timeout) == std::cv_status::timeout )
+			return requestStatus(token);
+
+		st = requestStatus(token);
+	}
+	return st;
+}
+
+void RsGxsDataAccess::notifyTokenStatusChanged()
+{
+	/* Taking the mutex guarantees that a waiter that just checked the status
+	 * is already waiting on the condition, so the notification is not lost */
+	{ std::lock_guard<std::mutex> lock(mTokenWaitMtx); }
+	mTokenWaitCv.notify_all();
+}
+
+void RsGxsDataAccess::notifyNewRequest()
+{
+	{
+		std::lock_guard<std::mutex> lock(mNewRequestMtx);
+		mHasNewRequest = true;
+	}
+	mNewRequestCv.notify_one();
+}
+
+bool RsGxsDataAccess::waitForNewRequests(std::chrono::milliseconds maxWait)
+{
+	std::unique_lock<std::mutex> lock(mNewRequestMtx);
+	bool woken = mNewRequestCv.wait_for(
+	            lock, maxWait, [this]() { return mHasNewRequest; } );
+	mHasNewRequest = false;
+	return woken;
 }
 
 RsTokenService::GxsRequestStatus RsGxsDataAccess::requestStatus(uint32_t token)
@@ -331,15 +380,18 @@ RsTokenService::GxsRequestStatus RsGxsDataAccess::requestStatus(uint32_t token)
 
 bool RsGxsDataAccess::cancelRequest(const uint32_t& token)
 {
-	RsStackMutex stack(mDataMutex); /****** LOCKED *****/
-
-	GxsRequest* req = locked_retrieveRequest(token);
-	if (!req)
 	{
-		return false;
-	}
+		RsStackMutex stack(mDataMutex); /****** LOCKED *****/
+
+		GxsRequest* req = locked_retrieveRequest(token);
+		if (!req)
+		{
+			return false;
+		}
 
-	req->status = CANCELLED;
+		req->status = CANCELLED;
+	}
+	notifyTokenStatusChanged();
 
 	return true;
 }
@@ -866,6 +918,8 @@ void RsGxsDataAccess::processRequests()
 				req->status = ok ? COMPLETE : FAILED;
 			}
 		} // END OF MUTEX.
+
+		notifyTokenStatusChanged();
 	}
 }
 
@@ -1872,6 +1926,7 @@ uint32_t RsGxsDataAccess::generatePublicToken()
 		RS_STACK_MUTEX(mDataMutex);
 		mPublicToken[token] = RsTokenService::PENDING;
 	}
+	notifyNewRequest();
 
 	return token;
 }
@@ -1881,11 +1936,14 @@ uint32_t RsGxsDataAccess::generatePublicToken()
 bool RsGxsDataAccess::updatePublicRequestStatus(
         uint32_t token, RsTokenService::GxsRequestStatus status )
 {
-	RS_STACK_MUTEX(mDataMutex);
-	std::map<uint32_t, RsTokenService::GxsRequestStatus>::iterator mit =
-	        mPublicToken.find(token);
-	if(mit != mPublicToken.end()) mit->second = status;
-	else return false;
+	{
+		RS_STACK_MUTEX(mDataMutex);
+		std::map<uint32_t, RsTokenService::GxsRequestStatus>::iterator mit =
+		        mPublicToken.find(token);
+		if(mit != mPublicToken.end()) mit->second = status;
+		else return false;
+	}
+	notifyTokenStatusChanged();
 	return true;
 }
 
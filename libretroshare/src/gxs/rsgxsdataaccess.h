@@ -22,6 +22,9 @@
 #ifndef RSGXSDATAACCESS_H
 #define RSGXSDATAACCESS_H
 
+#include <mutex>
+#include <condition_variable>
+
 #include "retroshare/rstokenservice.h"
 #include "rsgxsrequesttypes.h"
 #include "rsgds.h"
@@ -121,6 +124,15 @@ public:
     /* Poll */
 	GxsRequestStatus requestStatus(const uint32_t token);
 
+	/*!
+	 * Wait for the token status to change instead of polling it. The caller is
+	 * woken up as soon as the request has been served.
+	 * @param checkEvery unused
+	 */
+	GxsRequestStatus waitToken(
+	        uint32_t token, std::chrono::milliseconds maxWait,
+	        std::chrono::milliseconds checkEvery = std::chrono::milliseconds(2) );
+
     /* Cancel Request */
     bool cancelRequest(const uint32_t &token);
 
@@ -171,6 +183,14 @@ public:
      */
     void processRequests();
 
+    /*!
+     * Sleep until a new request or public token is submitted, or maxWait
+     * expires. To be used by the service thread between two calls to
+     * processRequests(), so that requests are served as soon as they arrive.
+     * @return true if woken up by a new request
+     */
+    bool waitForNewRequests(std::chrono::milliseconds maxWait);
+
     /*!
      * @param token
      * @param grpStatistic
@@ -494,6 +514,19 @@ private:
 	std::map<uint32_t, GxsRequestStatus> mPublicToken;
     std::map<uint32_t, GxsRequest*> mRequests;
 
+	/* Signals token status changes to waitToken() callers. Status is checked
+	 * with mTokenWaitMtx held, so this must never be locked while holding
+	 * mDataMutex. */
+	void notifyTokenStatusChanged();
+	std::mutex mTokenWaitMtx;
+	std::condition_variable mTokenWaitCv;
+
+	/* Wakes up the service thread when new work is submitted */
+	void notifyNewRequest();
+	std::mutex mNewRequestMtx;
+	std::condition_variable mNewRequestCv;
+	bool mHasNewRequest;
+
 
 
 };
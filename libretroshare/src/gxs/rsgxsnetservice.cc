@@ -255,6 +255,7 @@
 #include "util/rsdir.h"
 #include "util/rstime.h"
 #include "util/rsmemory.h"
+#include "util/rsrandom.h"
 #include "util/stacktrace.h"
 
 #ifdef RS_DEEP_SEARCH
@@ -284,8 +285,6 @@
 //#define NXS_NET_DEBUG_7 	1
 //#define NXS_NET_DEBUG_8 	1
 
-//#define NXS_FRAG
-
 // The constant below have a direct influence on how fast forums/channels/posted/identity groups propagate and on the overloading of queues:
 //
 // Channels/forums will update at a rate of SYNC_PERIOD*MAX_REQLIST_SIZE/60 messages per minute.
@@ -306,6 +305,13 @@ static const uint32_t GROUP_STATS_UPDATE_DELAY                =          240; //
 static const uint32_t GROUP_STATS_UPDATE_NB_PEERS             =            2; // number of peers to which the group stats are asked
 static const uint32_t MAX_ALLOWED_GXS_MESSAGE_SIZE            =       199000; // 200,000 bytes including signature and headers
 static const uint32_t MIN_DELAY_BETWEEN_GROUP_SEARCH          =           40; // dont search same group more than every 40 secs.
+static const uint32_t MAX_GROUPS_PER_SYNC_MSG_BATCH           =          500; // 24 bytes per group => batched sync requests stay below 12KB.
+static const uint32_t MIN_DELAY_BETWEEN_MSG_ANNOUNCES         =            2; // push new messages to friends at most every 2 secs.
+static const uint32_t MAX_MSGS_PER_ANNOUNCE_ROUND             =          100; // no more than 100 message ids pushed per round, the rest waits for the next round.
+static const uint32_t MAX_PENDING_MSG_ANNOUNCES               =         1000; // above this, new messages are left to the periodic sync.
+static const uint32_t MSG_ANNOUNCE_MEMORY_PERIOD              =         3600; // never announce the same message twice within an hour.
+static const uint32_t MIN_DELAY_BETWEEN_ANNOUNCE_REQUESTS     =            5; // don't sync a group with a peer that announced new messages more than every 5 secs.
+static const uint32_t MAX_FRAGMENTED_MSGS_SIZE_PER_PEER       =  6*1024*1024; // no more than 6MB (4 messages of max size) reserved for fragmented messages being received from a peer.
 
 static const uint32_t RS_NXS_ITEM_ENCRYPTION_STATUS_UNKNOWN             = 0x00 ;
 static const uint32_t RS_NXS_ITEM_ENCRYPTION_STATUS_NO_ERROR            = 0x01 ;
@@ -314,6 +320,19 @@ static const uint32_t RS_NXS_ITEM_ENCRYPTION_STATUS_ENCRYPTION_ERROR    = 0x03 ;
 static const uint32_t RS_NXS_ITEM_ENCRYPTION_STATUS_SERIALISATION_ERROR = 0x04 ;
 static const uint32_t RS_NXS_ITEM_ENCRYPTION_STATUS_GXS_KEY_MISSING     = 0x05 ;
 
+// Formats of the encrypted data of RsNxsEncryptedDataItem in transactions flagged with RsNxsTransacItem::FLAG_ENCRYPTED_BATCH.
+// Both start with the format id and the index of the session key in the transaction:
+//
+//   key  item: [--- ID ---|--- key index ---|--- session key, multi-encrypted for the circle with GxsSecurity::encrypt() ---]
+//   data item: [--- ID ---|--- key index ---|--- item, encrypted with GxsSecurity::encryptWithSessionKey() ---]
+//                 2 bytes      2 bytes
+//
+// The multi-encryption format of GxsSecurity uses 0xFACE, so these cannot be mistaken for a per-item encrypted item.
+
+static const uint16_t NXS_BATCH_ENCRYPTION_KEY_FORMAT  = 0xFB01 ;
+static const uint16_t NXS_BATCH_ENCRYPTION_DATA_FORMAT = 0xFB02 ;
+static const uint32_t NXS_BATCH_ENCRYPTION_HEADER_SIZE = 4 ;
+
 // Debug system to allow to print only for some IDs (group, Peer, etc)
 
 #if defined(NXS_NET_DEBUG_0) || defined(NXS_NET_DEBUG_1) || defined(NXS_NET_DEBUG_2)  || defined(NXS_NET_DEBUG_3) \
@@ -376,7 +395,12 @@ RsGxsNetService::RsGxsNetService(uint16_t servType, RsGeneralDataService *gds,
                                    mReputations(reputations), mPgpUtils(pgpUtils), mGxsNetTunnel(mGxsNT),
                                    mGrpAutoSync(grpAutoSync), mAllowMsgSync(msgAutoSync),mAllowDistSync(distSync),
                                    mServiceInfo(serviceInfo), mDefaultMsgStorePeriod(default_store_period),
-                                   mDefaultMsgSyncPeriod(default_sync_period)
+                                   mDefaultMsgSyncPeriod(default_sync_period),
+                                   mBatchedSyncMinVersionMajor(0), mBatchedSyncMinVersionMinor(0),
+                                   mPushAnnounceMinVersionMajor(0), mPushAnnounceMinVersionMinor(0),
+                                   mFragmentedMsgMinVersionMajor(0), mFragmentedMsgMinVersionMinor(0),
+                                   mPendingAnnounceCount(0), mLastAnnounceTS(0),
+                                   mDecryptionPool("gxs decrypt")
 {
 	addSerialType(new RsNxsSerialiser(mServType));
 	mOwnId = mNetMgr->getOwnId();
@@ -405,13 +429,25 @@ void RsGxsNetService::getItemNames(std::map<uint8_t,std::string>& names) const
 	names[RS_PKT_SUBTYPE_NXS_SESSION_KEY_ITEM     ] = "Session Key" ;
 	names[RS_PKT_SUBTYPE_NXS_SYNC_MSG_ITEM        ] = "Message Sync" ;
 	names[RS_PKT_SUBTYPE_NXS_SYNC_MSG_REQ_ITEM    ] = "Message Sync Request" ;
+	names[RS_PKT_SUBTYPE_NXS_SYNC_MSG_BATCH_REQ_ITEM] = "Batched Message Sync Request" ;
+	names[RS_PKT_SUBTYPE_NXS_SYNC_MSG_DIGEST_ITEM ] = "Message Sync Digest" ;
+	names[RS_PKT_SUBTYPE_NXS_MSG_ANNOUNCE_ITEM    ] = "New Messages Announce" ;
 	names[RS_PKT_SUBTYPE_NXS_MSG_ITEM             ] = "Message Data" ;
 	names[RS_PKT_SUBTYPE_NXS_TRANSAC_ITEM         ] = "Transaction" ;
 	names[RS_PKT_SUBTYPE_NXS_GRP_PUBLISH_KEY_ITEM ] = "Publish key" ;
 }
 
+NxsBatchEncryptionContext::~NxsBatchEncryptionContext()
+{
+	for(std::list<RsNxsItem*>::iterator it(mKeyItems.begin());it!=mKeyItems.end();++it)
+		delete *it ;
+}
+
 RsGxsNetService::~RsGxsNetService()
 {
+    // pending decryptions need the mutex to hand over their transaction
+    mDecryptionPool.stop();
+
     RS_STACK_MUTEX(mNxsMutex) ;
 
     for(TransactionsPeerMap::iterator it = mTransactions.begin();it!=mTransactions.end();++it)
@@ -460,6 +496,8 @@ int RsGxsNetService::tick()
     	mSyncTs = now;
     }
 
+    sendPendingAnnounces() ;
+
     if(now > 10 + mLastKeyPublishTs)
     {
         sharePublishKeysPending() ;
@@ -471,6 +509,7 @@ int RsGxsNetService::tick()
     {
         mLastCleanRejectedMessages = now ;
         cleanRejectedMessages() ;
+        cleanAnnounceRecords() ;
     }
     return 1;
 }
@@ -648,22 +687,19 @@ void RsGxsNetService::syncWithPeers()
     // recent modification the peer has sent. If the peer has more recent messages he will send them, because its latest
     // modifications will be more recent. This ensures that we always compare timestamps all taken in the same
     // computer (the peer's computer in this case)
+    //
+    // Peers that support it get the time stamps of all the groups sent in clear in a few batched requests, and answer
+    // with the list of groups that changed. Only those groups are then requested individually.
 
     for(; sit != peers.end(); ++sit)
     {
         const RsPeerId& peerId = *sit;
 
-        // now see if you have an updateTS so optimise whether you need
-        // to get a new list of peer data
-        const RsGxsMsgUpdate *mui = NULL;
-
-        ClientMsgMap::const_iterator cit = mClientMsgUpdateMap.find(peerId);
-
-        if(cit != mClientMsgUpdateMap.end())
-            mui = &cit->second;
+        const bool batched = locked_peerSupportsBatchedSync(peerId);
+        RsNxsSyncMsgBatchReqItem *batch_item = NULL;
 
 #ifdef NXS_NET_DEBUG_0
-	GXSNETDEBUG_P_(peerId) << "  syncing messages with peer " << peerId << std::endl;
+	GXSNETDEBUG_P_(peerId) << "  syncing messages with peer " << peerId << (batched?" (batched)":"") << std::endl;
 #endif
 
         RsGxsGrpMetaTemporaryMap::const_iterator mmit = toRequest.begin();
@@ -684,61 +720,169 @@ void RsGxsNetService::syncWithPeers()
 		    GXSNETDEBUG_PG(peerId,grpId) << " request should be sent in clear." << std::endl;
 
 #endif
-            // On default, the info has never been received so the TS is 0, meaning the peer has sent that it had no information.
+            RsNxsSyncMsgReqItem* msg = locked_createSyncMsgReqItem(peerId, grpId, encrypt_to_this_circle_id);
 
-            uint32_t updateTS = 0;
+            // Circle restricted groups are requested with a hashed group id, which the batched request cannot carry.
 
-            if(mui)
+            if(batched && encrypt_to_this_circle_id.isNull())
             {
-                std::map<RsGxsGroupId, RsGxsMsgUpdateItem::MsgUpdateInfo>::const_iterator cit2 = mui->msgUpdateInfos.find(grpId);
+                if(batch_item == NULL)
+                {
+                    batch_item = new RsNxsSyncMsgBatchReqItem(mServType);
+                    batch_item->PeerId(peerId);
+                    batch_item->flag = msg->flag;
+                }
+
+                RsNxsSyncMsgBatchReqItem::GroupEntry entry;
+                entry.grpId = grpId;
+                entry.updateTS = msg->updateTS;
+                batch_item->groups.push_back(entry);
 
-                if(cit2 != mui->msgUpdateInfos.end())
-                    updateTS = cit2->second.time_stamp;
+                delete msg;
+
+                if(batch_item->groups.size() >= MAX_GROUPS_PER_SYNC_MSG_BATCH)
+                {
+                    generic_sendItem(batch_item);
+                    batch_item = NULL;
+                }
+                continue;
             }
 
-            // get sync params for this group
+#ifdef NXS_NET_DEBUG_7
+	    GXSNETDEBUG_PG(*sit,grpId) << "    Service " << std::hex << ((mServiceInfo.mServiceType >> 8)& 0xffff) << std::dec << "  sending message TS of peer id: " << *sit << " ts=" << nice_time_stamp(time(NULL),msg->updateTS) << " (secs ago) for group " << grpId << " to himself - in clear " << std::endl;
+#endif
+#ifdef NXS_NET_DEBUG_5
+		GXSNETDEBUG_PG(*sit,grpId) << "Service "<< std::hex << ((mServiceInfo.mServiceType >> 8)& 0xffff) << std::dec << "  sending global message TS of peer id: " << *sit << " ts=" << nice_time_stamp(time(NULL),msg->updateTS) << " (secs ago) for group " << grpId << " to himself" << std::endl;
+#endif
+		generic_sendItem(msg);
+        }
 
-            RsNxsSyncMsgReqItem* msg = new RsNxsSyncMsgReqItem(mServType);
+        if(batch_item != NULL)
+            generic_sendItem(batch_item);
+    }
 
-            msg->clear();
-            msg->PeerId(peerId);
-            msg->updateTS = updateTS;
+#endif
+}
 
-            int req_delay  = (int)locked_getGrpConfig(grpId).msg_req_delay ;
-            int keep_delay = (int)locked_getGrpConfig(grpId).msg_keep_delay ;
+RsNxsSyncMsgReqItem *RsGxsNetService::locked_createSyncMsgReqItem(const RsPeerId& peerId, const RsGxsGroupId& grpId, const RsGxsCircleId& encrypt_to_this_circle_id)
+{
+    // On default, the info has never been received so the TS is 0, meaning the peer has sent that it had no information.
 
-            // If we store for less than we request, we request less, otherwise the posts will be deleted after being obtained.
+    uint32_t updateTS = 0;
 
-            if(keep_delay > 0 && req_delay > 0 && keep_delay < req_delay)
-                req_delay = keep_delay ;
+    ClientMsgMap::const_iterator cit = mClientMsgUpdateMap.find(peerId);
 
-            // The last post will be set to TS 0 if the req delay is 0, which means "Indefinitly"
+    if(cit != mClientMsgUpdateMap.end())
+    {
+        std::map<RsGxsGroupId, RsGxsMsgUpdateItem::MsgUpdateInfo>::const_iterator cit2 = cit->second.msgUpdateInfos.find(grpId);
 
-            if(req_delay > 0)
-				msg->createdSinceTS = std::max(0,(int)time(NULL) - req_delay);
-			else
-				msg->createdSinceTS = 0 ;
+        if(cit2 != cit->second.msgUpdateInfos.end())
+            updateTS = cit2->second.time_stamp;
+    }
 
-            if(encrypt_to_this_circle_id.isNull())
-                msg->grpId = grpId;
-            else
-            {
-                msg->grpId = hashGrpId(grpId,mNetMgr->getOwnId()) ;
-                msg->flag |= RsNxsSyncMsgReqItem::FLAG_USE_HASHED_GROUP_ID ;
-            }
+    // get sync params for this group
 
-#ifdef NXS_NET_DEBUG_7
-	    GXSNETDEBUG_PG(*sit,grpId) << "    Service " << std::hex << ((mServiceInfo.mServiceType >> 8)& 0xffff) << std::dec << "  sending message TS of peer id: " << *sit << " ts=" << nice_time_stamp(time(NULL),updateTS) << " (secs ago) for group " << grpId << " to himself - in clear " << std::endl;
-#endif
-		generic_sendItem(msg);
+    RsNxsSyncMsgReqItem* msg = new RsNxsSyncMsgReqItem(mServType);
 
-#ifdef NXS_NET_DEBUG_5
-		GXSNETDEBUG_PG(*sit,grpId) << "Service "<< std::hex << ((mServiceInfo.mServiceType >> 8)& 0xffff) << std::dec << "  sending global message TS of peer id: " << *sit << " ts=" << nice_time_stamp(time(NULL),updateTS) << " (secs ago) for group " << grpId << " to himself" << std::endl;
-#endif
-        }
+    msg->clear();
+    msg->PeerId(peerId);
+    msg->updateTS = updateTS;
+
+    int req_delay  = (int)locked_getGrpConfig(grpId).msg_req_delay ;
+    int keep_delay = (int)locked_getGrpConfig(grpId).msg_keep_delay ;
+
+    // If we store for less than we request, we request less, otherwise the posts will be deleted after being obtained.
+
+    if(keep_delay > 0 && req_delay > 0 && keep_delay < req_delay)
+        req_delay = keep_delay ;
+
+    // The last post will be set to TS 0 if the req delay is 0, which means "Indefinitly"
+
+    if(req_delay > 0)
+        msg->createdSinceTS = std::max(0,(int)time(NULL) - req_delay);
+    else
+        msg->createdSinceTS = 0 ;
+
+    if(encrypt_to_this_circle_id.isNull())
+        msg->grpId = grpId;
+    else
+    {
+        msg->grpId = hashGrpId(grpId,mNetMgr->getOwnId()) ;
+        msg->flag |= RsNxsSyncMsgReqItem::FLAG_USE_HASHED_GROUP_ID ;
     }
+    msg->flag |= RsNxsSyncMsgReqItem::FLAG_ACCEPTS_ENCRYPTED_BATCH ;
 
-#endif
+    return msg;
+}
+
+void RsGxsNetService::setBatchedSyncMinVersion(uint16_t major, uint16_t minor)
+{
+    RS_STACK_MUTEX(mNxsMutex) ;
+
+    mBatchedSyncMinVersionMajor = major;
+    mBatchedSyncMinVersionMinor = minor;
+}
+
+void RsGxsNetService::setPushAnnounceMinVersion(uint16_t major, uint16_t minor)
+{
+    RS_STACK_MUTEX(mNxsMutex) ;
+
+    mPushAnnounceMinVersionMajor = major;
+    mPushAnnounceMinVersionMinor = minor;
+}
+
+void RsGxsNetService::setFragmentedMsgMinVersion(uint16_t major, uint16_t minor)
+{
+    RS_STACK_MUTEX(mNxsMutex) ;
+
+    mFragmentedMsgMinVersionMajor = major;
+    mFragmentedMsgMinVersionMinor = minor;
+}
+
+bool RsGxsNetService::locked_peerSupportsBatchedSync(const RsPeerId& peer) const
+{
+    if(mBatchedSyncMinVersionMajor == 0)
+        return false;
+
+    return locked_peerHasServiceVersion(peer, mBatchedSyncMinVersionMajor, mBatchedSyncMinVersionMinor);
+}
+
+bool RsGxsNetService::locked_peerSupportsMsgAnnounces(const RsPeerId& peer) const
+{
+    if(mPushAnnounceMinVersionMajor == 0)
+        return false;
+
+    return locked_peerHasServiceVersion(peer, mPushAnnounceMinVersionMajor, mPushAnnounceMinVersionMinor);
+}
+
+bool RsGxsNetService::locked_peerSupportsFragmentedMsgs(const RsPeerId& peer) const
+{
+    if(mFragmentedMsgMinVersionMajor == 0)
+        return false;
+
+    return locked_peerHasServiceVersion(peer, mFragmentedMsgMinVersionMajor, mFragmentedMsgMinVersionMinor);
+}
+
+static bool serviceVersionAtLeast(uint16_t major, uint16_t minor, uint16_t min_major, uint16_t min_minor)
+{
+    return major > min_major || (major == min_major && minor >= min_minor);
+}
+
+bool RsGxsNetService::locked_peerHasServiceVersion(const RsPeerId& peer, uint16_t min_major, uint16_t min_minor) const
+{
+    // Both sides must speak the version: a feature enabled above the version we advertise is never used.
+
+    if(!serviceVersionAtLeast(mServiceInfo.mVersionMajor, mServiceInfo.mVersionMinor, min_major, min_minor))
+        return false;
+
+    // Distant peers are not listed by the service control, so they never match.
+
+    uint16_t major = 0, minor = 0;
+
+    if(!mNetMgr->getPeerServiceVersion(peer, mServiceInfo.mServiceType, major, minor))
+        return false;
+
+    return serviceVersionAtLeast(major, minor, min_major, min_minor);
 }
 
 void RsGxsNetService::generic_sendItem(RsNxsItem *si)
@@ -1050,28 +1194,31 @@ void RsGxsNetService::subscribeStatusChanged(const RsGxsGroupId& grpId,bool subs
 bool RsGxsNetService::fragmentMsg(RsNxsMsg& msg, MsgFragments& msgFragments) const
 {
 	// first determine how many fragments
-	uint32_t msgSize = msg.msg.TlvSize();
+	uint32_t msgSize = msg.msg.bin_len;
 	uint32_t dataLeft = msgSize;
-	uint8_t nFragments = ceil(float(msgSize)/FRAGMENT_SIZE);
+	uint32_t nFragments = (msgSize + FRAGMENT_SIZE - 1) / FRAGMENT_SIZE;
 
-    	RsTemporaryMemory buffer(FRAGMENT_SIZE);
-	int currPos = 0;
+	if(nFragments > 255)	// pos and count are 8 bits
+		return false;
 
+	uint32_t currPos = 0;
 
 	for(uint8_t i=0; i < nFragments; ++i)
 	{
 		RsNxsMsg* msgFrag = new RsNxsMsg(mServType);
 		msgFrag->grpId = msg.grpId;
 		msgFrag->msgId = msg.msgId;
-		msgFrag->meta = msg.meta;
 		msgFrag->transactionNumber = msg.transactionNumber;
 		msgFrag->pos = i;
 		msgFrag->PeerId(msg.PeerId());
 		msgFrag->count = nFragments;
 		uint32_t fragSize = std::min(dataLeft, FRAGMENT_SIZE);
 
-		memcpy(buffer, ((char*)msg.msg.bin_data) + currPos, fragSize);
-		msgFrag->msg.setBinData(buffer, fragSize);
+		// the receiving side only reads the meta data of the first fragment
+		if(i == 0)
+			msgFrag->meta = msg.meta;
+
+		msgFrag->msg.setBinData(((char*)msg.msg.bin_data) + currPos, fragSize);
 
 		currPos += fragSize;
 		dataLeft -= fragSize;
@@ -1111,81 +1258,6 @@ bool RsGxsNetService::fragmentGrp(RsNxsGrp& grp, GrpFragments& grpFragments) con
 	return true;
 }
 
-RsNxsMsg* RsGxsNetService::deFragmentMsg(MsgFragments& msgFragments) const
-{
-	if(msgFragments.empty()) return NULL;
-
-	// if there is only one fragment with a count 1 or less then
-	// the fragment is the msg
-	if(msgFragments.size() == 1)
-	{
-		RsNxsMsg* m  = msgFragments.front();
-
-		if(m->count > 1)	// normally mcount should be exactly 1, but if not initialised (old versions) it's going to be 0
-            	{
-            		// delete everything
-            		std::cerr << "(WW) Cannot deFragment message set. m->count=" << m->count << ", but msgFragments.size()=" << msgFragments.size() << ". Incomplete? Dropping all." << std::endl;
-
-            		for(uint32_t i=0;i<msgFragments.size();++i)
-                        	delete msgFragments[i] ;
-
-                    	msgFragments.clear();
-			return NULL;
-            	}
-		else
-            	{
-            		// single piece. No need to say anything. Just return it.
-
-                    	msgFragments.clear();
-			return m;
-            	}
-	}
-
-	// first determine total size for binary data
-	MsgFragments::iterator mit = msgFragments.begin();
-	uint32_t datSize = 0;
-
-	for(; mit != msgFragments.end(); ++mit)
-		datSize += (*mit)->msg.bin_len;
-
-    	RsTemporaryMemory data(datSize) ;
-
-        if(!data)
-        {
-	    for(uint32_t i=0;i<msgFragments.size();++i)
-		    delete msgFragments[i] ;
-
-	    msgFragments.clear();
-            return NULL ;
-        }
-
-	uint32_t currPos = 0;
-
-        std::cerr << "(II) deFragmenting long message of size " << datSize << ", from " << msgFragments.size() << " pieces." << std::endl;
-
-	for(mit = msgFragments.begin(); mit != msgFragments.end(); ++mit)
-	{
-		RsNxsMsg* msg = *mit;
-		memcpy(data + (currPos), msg->msg.bin_data, msg->msg.bin_len);
-		currPos += msg->msg.bin_len;
-	}
-
-	RsNxsMsg* msg = new RsNxsMsg(mServType);
-	const RsNxsMsg& m = *(*(msgFragments.begin()));
-	msg->msg.setBinData(data, datSize);
-	msg->msgId = m.msgId;
-	msg->grpId = m.grpId;
-	msg->transactionNumber = m.transactionNumber;
-	msg->meta = m.meta;
-
-        // now clean!
-	for(uint32_t i=0;i<msgFragments.size();++i)
-		delete msgFragments[i] ;
-
-	msgFragments.clear();
-
-	return msg;
-}
 
 // This is unused apparently, since groups are never large. Anyway, we keep it in case we need it.
 
@@ -1367,6 +1439,8 @@ bool RsGxsNetService::locked_createTransactionFromPending(MsgCircleIdsRequestVet
 
 	uint32_t transN = locked_getTransactionId();
     	RsGxsGroupId grp_id ;
+	NxsBatchEncryptionContext batch ;
+	NxsBatchEncryptionContext *pbatch = locked_peerAcceptsEncryptedBatches(msgPend->mPeerId)?(&batch):NULL ;
 
 	for(; vit != msgPend->mMsgs.end(); ++vit)
 	{
@@ -1386,7 +1460,7 @@ bool RsGxsNetService::locked_createTransactionFromPending(MsgCircleIdsRequestVet
                     RsNxsItem *encrypted_item = NULL ;
                     uint32_t status = RS_NXS_ITEM_ENCRYPTION_STATUS_UNKNOWN ;
 
-                    if(encryptSingleNxsItem(mItem,msgPend->mCircleId,msgPend->mGrpId,encrypted_item,status))
+                    if(encryptSingleNxsItem(mItem,msgPend->mCircleId,msgPend->mGrpId,encrypted_item,status,pbatch))
                     {
                         itemL.push_back(encrypted_item) ;
                         delete mItem ;
@@ -1394,6 +1468,10 @@ bool RsGxsNetService::locked_createTransactionFromPending(MsgCircleIdsRequestVet
                     else
                     {
                         std::cerr << "(EE) cannot encrypt Msg ids in circle-restriced response to grp " << msgPend->mGrpId << " for circle " << msgPend->mCircleId << std::endl;
+
+                        for(std::list<RsNxsItem*>::const_iterator it(itemL.begin());it!=itemL.end();++it)
+                            delete *it ;
+                        delete mItem ;
                         return false ;
                     }
                 }
@@ -1402,7 +1480,7 @@ bool RsGxsNetService::locked_createTransactionFromPending(MsgCircleIdsRequestVet
 	}
 
 	if(!itemL.empty())
-		locked_pushMsgRespFromList(itemL, msgPend->mPeerId,grp_id, transN);
+		locked_pushMsgRespFromList(itemL, msgPend->mPeerId,grp_id, transN,pbatch);
 
     return true ;
 }
@@ -1482,57 +1560,6 @@ void RsGxsNetService::collateGrpFragments(GrpFragments fragments,
 	fragments.clear();
 }
 
-struct MsgFragCollate
-{
-	RsGxsMessageId mMsgId;
-	MsgFragCollate(const RsGxsMessageId& msgId) : mMsgId(msgId){ }
-	bool operator()(RsNxsMsg* msg) { return msg->msgId == mMsgId;}
-};
-
-void RsGxsNetService::collateMsgFragments(MsgFragments& fragments, std::map<RsGxsMessageId, MsgFragments>& partFragments) const
-{
-	// get all unique message Ids;
-	MsgFragments::iterator vit = fragments.begin();
-	std::set<RsGxsMessageId> msgIds;
-
-	for(; vit != fragments.end(); ++vit)
-		msgIds.insert( (*vit)->msgId );
-
-
-	std::set<RsGxsMessageId>::iterator sit = msgIds.begin();
-
-	for(; sit != msgIds.end(); ++sit)
-	{
-		const RsGxsMessageId& msgId = *sit;
-		MsgFragments::iterator bound = std::partition(
-					fragments.begin(), fragments.end(),
-					MsgFragCollate(msgId));
-
-		// something will always be found for a group id
-		for(vit = fragments.begin(); vit != bound; ++vit )
-		{
-			partFragments[msgId].push_back(*vit);
-		}
-
-		fragments.erase(fragments.begin(), bound);
-		MsgFragments& f = partFragments[msgId];
-		RsNxsMsg* msg = *(f.begin());
-
-		// if counts of fragments is incorrect remove
-		// from coalescion
-		if(msg->count != f.size())
-		{
-			MsgFragments::iterator vit2 = f.begin();
-
-			for(; vit2 != f.end(); ++vit2)
-				delete *vit2;
-
-			partFragments.erase(msgId);
-		}
-	}
-
-	fragments.clear();
-}
 
 class StoreHere
 {
@@ -1767,6 +1794,9 @@ void RsGxsNetService::recvNxsItemQueue()
             case RS_PKT_SUBTYPE_NXS_SYNC_GRP_STATS_ITEM: handleRecvSyncGrpStatistics   (dynamic_cast<RsNxsSyncGrpStatsItem*>(ni)) ; break ;
             case RS_PKT_SUBTYPE_NXS_SYNC_GRP_REQ_ITEM:   handleRecvSyncGroup           (dynamic_cast<RsNxsSyncGrpReqItem*>(ni)) ; break ;
             case RS_PKT_SUBTYPE_NXS_SYNC_MSG_REQ_ITEM:   handleRecvSyncMessage         (dynamic_cast<RsNxsSyncMsgReqItem*>(ni),item_was_encrypted) ; break ;
+            case RS_PKT_SUBTYPE_NXS_SYNC_MSG_BATCH_REQ_ITEM: handleRecvSyncMsgBatch    (dynamic_cast<RsNxsSyncMsgBatchReqItem*>(ni)) ; break ;
+            case RS_PKT_SUBTYPE_NXS_SYNC_MSG_DIGEST_ITEM:    handleRecvSyncMsgDigest   (dynamic_cast<RsNxsSyncMsgDigestItem*>(ni)) ; break ;
+            case RS_PKT_SUBTYPE_NXS_MSG_ANNOUNCE_ITEM:       handleRecvMsgAnnounce     (dynamic_cast<RsNxsMsgAnnounceItem*>(ni)) ; break ;
             case RS_PKT_SUBTYPE_NXS_GRP_PUBLISH_KEY_ITEM:handleRecvPublishKeys         (dynamic_cast<RsNxsGroupPublishKeyItem*>(ni)) ; break ;
 
             default:
@@ -1835,7 +1865,31 @@ bool RsGxsNetService::handleTransaction(RsNxsItem* item)
 #endif
 
             tr = transMap[transN];
-            tr->mItems.push_back(item);
+            ++tr->mNbReceivedItems;
+
+            RsNxsMsg* msg = dynamic_cast<RsNxsMsg*>(item);
+
+            if(msg && msg->count > 1)
+            {
+                locked_addMsgFragment(peer, tr, msg);
+
+                // the sending side keeps the transaction alive as long as fragments keep coming
+                tr->mTimeOut = time(NULL) + mTransactionTimeOut;
+
+                // acks are only understood by the peers that negotiated fragmented messages
+                if(!locked_peerSupportsFragmentedMsgs(peer))
+                    return true;
+
+                RsNxsTransacItem* ack = new RsNxsTransacItem(mServType);
+                ack->transactFlag = RsNxsTransacItem::FLAG_FRAGMENT_ACK | RsNxsTransacItem::FLAG_TYPE_MSGS;
+                ack->transactionNumber = transN;
+                ack->nItems = tr->mNbReceivedItems;
+                ack->timestamp = time(NULL);
+                ack->PeerId(peer);
+                generic_sendItem(ack);
+            }
+            else
+                tr->mItems.push_back(item);
 
             return true;
         }
@@ -1866,7 +1920,7 @@ bool RsGxsNetService::locked_processTransac(RsNxsTransacItem *item)
 	RsPeerId peer;
 
 	// for outgoing transaction use own id
-	if(item->transactFlag & (RsNxsTransacItem::FLAG_BEGIN_P2 | RsNxsTransacItem::FLAG_END_SUCCESS))
+	if(item->transactFlag & (RsNxsTransacItem::FLAG_BEGIN_P2 | RsNxsTransacItem::FLAG_END_SUCCESS | RsNxsTransacItem::FLAG_FRAGMENT_ACK))
 		peer = mOwnId;
 	else
 		peer = item->PeerId();
@@ -1977,10 +2031,53 @@ bool RsGxsNetService::locked_processTransac(RsNxsTransacItem *item)
         delete item;
         return true;
     }
+    else if(item->transactFlag & RsNxsTransacItem::FLAG_FRAGMENT_ACK)
+    {
+        if(!peerTrExists || !transExists)
+            return false;
+
+        // the peer is still receiving fragments of this transaction, do not time it out
+        NxsTransaction* tr = mTransactions[mOwnId][transN];
+
+        if(!tr->fragmentsAcknowledged(item->nItems, time(NULL), mTransactionTimeOut))
+        {
+            std::cerr << "(WW) invalid fragment ack for " << item->nItems << " items of transaction " << transN << " from peer " << item->PeerId() << std::endl;
+            delete item;
+            return true;
+        }
+
+#ifdef NXS_NET_DEBUG_1
+        GXSNETDEBUG_P_(item->PeerId()) << "  peer acknowledged " << item->nItems << " items of transaction " << transN << std::endl;
+#endif
+        delete item;
+        return true;
+    }
     else
         return false;
 }
 
+void RsGxsNetService::locked_addMsgFragment(const RsPeerId& peer, NxsTransaction* tr, RsNxsMsg* fragment)
+{
+    if(!tr->mMsgFragments)
+        tr->mMsgFragments = new NxsMsgReassembler(FRAGMENT_SIZE, RsGeneralDataService::GXS_MAX_ITEM_SIZE, tr->mTransaction->nItems);
+
+    // memory reserved for the messages of all the transactions of this peer that are being received in fragments
+
+    uint64_t reserved = 0;
+    TransactionIdMap& transMap = mTransactions[peer];
+
+    for(TransactionIdMap::const_iterator it = transMap.begin(); it != transMap.end(); ++it)
+        if(it->second->mMsgFragments)
+            reserved += it->second->mMsgFragments->reservedSize();
+
+    uint64_t budget = (reserved < MAX_FRAGMENTED_MSGS_SIZE_PER_PEER) ? (MAX_FRAGMENTED_MSGS_SIZE_PER_PEER - reserved) : 0;
+
+    RsNxsMsg* msg = tr->mMsgFragments->addFragment(fragment, budget);
+
+    if(msg)
+        tr->mItems.push_back(msg);
+}
+
 void RsGxsNetService::data_tick()
 {
     static const double timeDelta = 0.5;
@@ -2406,7 +2503,7 @@ void RsGxsNetService::processTransactions()
                     // then transaction is marked as completed
                     // to be moved to complete transations
                     // check if done
-                    if(tr->mItems.size() == tr->mTransaction->nItems)
+                    if(tr->mNbReceivedItems == tr->mTransaction->nItems)
                     {
                         tr->mFlag = NxsTransaction::FLAG_STATE_COMPLETED;
 #ifdef NXS_NET_DEBUG_1
@@ -2431,30 +2528,22 @@ void RsGxsNetService::processTransactions()
 
                     // move to completed transactions
 
-                    // Try to decrypt the items that need to be decrypted. This function returns true if the transaction is not encrypted.
+                    // Encrypted transactions are decrypted in the worker pool, which adds them to the completed list once done.
 
-                    if(processTransactionForDecryption(tr))
-		    {
+                    if(!locked_processTransactionForDecryption(tr))
+			    mComplTransactions.push_back(tr);
 #ifdef NXS_NET_DEBUG_7
-			    GXSNETDEBUG_P_(tr->mTransaction->PeerId()) << "   successfully decrypted/processed transaction " << transN << ". Adding to completed list." << std::endl;
+		    else
+			    GXSNETDEBUG_P_(tr->mTransaction->PeerId()) << "   transaction " << transN << " queued for decryption." << std::endl;
 #endif
-			    mComplTransactions.push_back(tr);
 
-			    // transaction processing done
-			    // for this id, add to removal list
-			    toRemove.push_back(mmit->first);
+		    // transaction processing done
+		    // for this id, add to removal list
+		    toRemove.push_back(mmit->first);
 #ifdef NXS_NET_DEBUG_1
-			    int total_transaction_time = (int)time(NULL) - (tr->mTimeOut - mTransactionTimeOut) ;
-			    GXSNETDEBUG_P_(mit->first) << "    incoming completed " << tr->mTransaction->nItems << " items transaction in " << total_transaction_time << " seconds." << std::endl;
-#endif
-		    }
-		    else
-		    {
-#ifdef NXS_NET_DEBUG_7
-			    GXSNETDEBUG_P_(tr->mTransaction->PeerId()) << "   no decryption occurred because of unloaded keys. Will retry later. TransN=" << transN << std::endl;
+		    int total_transaction_time = (int)time(NULL) - (tr->mTimeOut - mTransactionTimeOut) ;
+		    GXSNETDEBUG_P_(mit->first) << "    incoming completed " << tr->mTransaction->nItems << " items transaction in " << total_transaction_time << " seconds." << std::endl;
 #endif
-		    }
-
 
                 }
                 else if(flag & NxsTransaction::FLAG_STATE_STARTING)
@@ -2665,6 +2754,18 @@ void RsGxsNetService::locked_processCompletedIncomingTrans(NxsTransaction* tr)
 
                     tr->mItems.pop_front();
 
+                    // fragments of encrypted transactions are only readable now
+                    if(msg->count > 1)
+                    {
+                        if(!tr->mMsgFragments)
+                            tr->mMsgFragments = new NxsMsgReassembler(FRAGMENT_SIZE, RsGeneralDataService::GXS_MAX_ITEM_SIZE, tr->mTransaction->nItems);
+
+                        msg = tr->mMsgFragments->addFragment(msg);
+
+                        if(!msg)
+                            continue;
+                    }
+
 					msgs.push_back(msg);
 #ifdef NXS_NET_DEBUG_0
                     GXSNETDEBUG_PG(tr->mTransaction->PeerId(),msg->grpId) << "    pushing grpId="<< msg->grpId << ", msgsId=" << msg->msgId << " to list of incoming messages" << std::endl;
@@ -2677,25 +2778,8 @@ void RsGxsNetService::locked_processCompletedIncomingTrans(NxsTransaction* tr)
 //#warning We need here to queue all incoming items into a list where the vetting will be checked
 //#warning in order to avoid someone without the proper rights to post in a group protected with an external circle
 
-#ifdef NXS_FRAG
-            // (cyril) This code does not work. Since we do not really need message fragmenting, I won't fix it.
-
-            std::map<RsGxsMessageId, MsgFragments > collatedMsgs;
-            collateMsgFragments(msgs, collatedMsgs);			// this destroys msgs whatsoever and recovers memory when needed
-
-            msgs.clear();
-
-            std::map<RsGxsMessageId, MsgFragments >::iterator mit = collatedMsgs.begin();
-            for(; mit != collatedMsgs.end(); ++mit)
-            {
-                MsgFragments& f = mit->second;
-                RsNxsMsg* msg = deFragmentMsg(f);
-
-                if(msg)
-                    msgs.push_back(msg);
-            }
-            collatedMsgs.clear();
-#endif
+            if(tr->mMsgFragments && tr->mMsgFragments->pendingCount() > 0)
+                std::cerr << "(WW) " << tr->mMsgFragments->pendingCount() << " fragmented messages of transaction " << tr->mTransaction->transactionNumber << " are incomplete. Dropping them." << std::endl;
 #ifdef NXS_NET_DEBUG_0
             GXSNETDEBUG_PG(tr->mTransaction->PeerId(),grpId) << "  ...and notifying observer of " << msgs.size() << " new messages." << std::endl;
 #endif
@@ -3560,6 +3644,10 @@ void RsGxsNetService::locked_genSendMsgsTransaction(NxsTransaction* tr)
     RsPeerId peerId = tr->mTransaction->PeerId();
     uint32_t msgSize = 0;
 
+    // peers reassembling fragments can receive messages up to the storage limit
+    bool fragmented = locked_peerSupportsFragmentedMsgs(peerId);
+    uint32_t maxMsgSize = fragmented ? RsGeneralDataService::GXS_MAX_ITEM_SIZE : MAX_ALLOWED_GXS_MESSAGE_SIZE;
+
     for(;mit != msgs.end(); ++mit)
     {
 	    std::vector<RsNxsMsg*>& msgV = mit->second;
@@ -3574,33 +3662,32 @@ void RsGxsNetService::locked_genSendMsgsTransaction(NxsTransaction* tr)
 		    // Quick trick to clamp messages with an exceptionnally large size. Signature will fail on client side, and the message
 		    // will be rejected.
 
-		    if(msg->msg.bin_len > MAX_ALLOWED_GXS_MESSAGE_SIZE)
+		    if(msg->msg.bin_len > maxMsgSize)
 		    {
-			    std::cerr << "(WW) message with ID " << msg->msgId << " in group " << msg->grpId << " exceeds size limit of " << MAX_ALLOWED_GXS_MESSAGE_SIZE << " bytes. Actual size is " << msg->msg.bin_len << " bytes. Message will be truncated and rejected at client." << std::endl;
+			    std::cerr << "(WW) message with ID " << msg->msgId << " in group " << msg->grpId << " exceeds size limit of " << maxMsgSize << " bytes. Actual size is " << msg->msg.bin_len << " bytes. Message will be truncated and rejected at client." << std::endl;
 			    msg->msg.bin_len = 1 ;	// arbitrary small size, but not 0. No need to send the data since it's going to be rejected.
 		    }
 
-#ifdef 	NXS_FRAG
 		    MsgFragments fragments;
-		    fragmentMsg(*msg, fragments);
-
-		    delete msg ;
 
-		    MsgFragments::iterator mit = fragments.begin();
+		    if(fragmented && msg->msg.bin_len > FRAGMENT_SIZE && fragmentMsg(*msg, fragments))
+		    {
+			    delete msg ;
 
-		    for(; mit != fragments.end(); ++mit)
+			    for(MsgFragments::iterator fit = fragments.begin(); fit != fragments.end(); ++fit)
+			    {
+				    newTr->mItems.push_back(*fit);
+				    msgSize++;
+			    }
+		    }
+		    else
 		    {
-			    newTr->mItems.push_back(*mit);
+			    msg->count = 1;	// only one piece
+			    msg->pos = 0;
+
+			    newTr->mItems.push_back(msg);
 			    msgSize++;
 		    }
-#else
-
-		    msg->count = 1;	// only one piece. This is to keep compatibility if we ever implement fragmenting in the future.
-		    msg->pos = 0;
-
-		    newTr->mItems.push_back(msg);
-		    msgSize++;
-#endif
 
 #ifdef CODE_TO_ENCRYPT_MESSAGE_DATA
 		    // encrypt
@@ -3694,17 +3781,8 @@ bool RsGxsNetService::locked_addTransaction(NxsTransaction* tr)
     return true;
 }
 
-// Turns a single RsNxsItem into an encrypted one, suitable for the supplied destination circle.
-// Returns false when the keys are not loaded. Question to solve: what do we do if we miss some keys??
-// We should probably send anyway.
-
-bool RsGxsNetService::encryptSingleNxsItem(RsNxsItem *item, const RsGxsCircleId& destination_circle, const RsGxsGroupId& destination_group, RsNxsItem *&encrypted_item, uint32_t& status)
+bool RsGxsNetService::locked_getCircleRecipientKeys(const RsGxsCircleId& destination_circle, const RsGxsGroupId& destination_group, std::vector<RsTlvPublicRSAKey>& recipient_keys, uint32_t& status)
 {
-        encrypted_item = NULL ;
-	status = RS_NXS_ITEM_ENCRYPTION_STATUS_UNKNOWN ;
-#ifdef NXS_NET_DEBUG_7
-	GXSNETDEBUG_P_ (item->PeerId()) << "Service " << std::hex << ((mServiceInfo.mServiceType >> 8)& 0xffff) << std::dec << " - Encrypting single item for peer " << item->PeerId() << ", for circle ID " << destination_circle  << std::endl;
-#endif
 	// 1 - Find out the list of GXS ids to encrypt for
 	//     We could do smarter things (like see if the peer_id owns one of the circle's identities
 	//     but for now we aim at the simplest solution: encrypt for all identities in the circle.
@@ -3721,16 +3799,14 @@ bool RsGxsNetService::encryptSingleNxsItem(RsNxsItem *item, const RsGxsCircleId&
     	if(recipients.empty())
         {
 #ifdef NXS_NET_DEBUG_7
-            GXSNETDEBUG_P_(item->PeerId()) << "  (EE) No recipients found for circle " << destination_circle << ". Circle not in cache, or empty circle?" << std::endl;
+            GXSNETDEBUG___ << "  (EE) No recipients found for circle " << destination_circle << ". Circle not in cache, or empty circle?" << std::endl;
 #endif
             return false ;
         }
 
 #ifdef NXS_NET_DEBUG_7
-	GXSNETDEBUG_P_ (item->PeerId()) << "  Dest  Ids: " << std::endl;
+	GXSNETDEBUG___ << "  Dest  Ids: " << std::endl;
 #endif
-	std::vector<RsTlvPublicRSAKey> recipient_keys ;
-
 	for(std::list<RsGxsId>::const_iterator it(recipients.begin());it!=recipients.end();++it)
 	{
 		RsTlvPublicRSAKey pkey ;
@@ -3744,30 +3820,152 @@ bool RsGxsNetService::encryptSingleNxsItem(RsNxsItem *item, const RsGxsCircleId&
 			continue ;
 		}
 #ifdef NXS_NET_DEBUG_7
-		GXSNETDEBUG_P_ (item->PeerId()) << "  added key " << *it << std::endl;
+		GXSNETDEBUG___ << "  added key " << *it << std::endl;
 #endif
 		recipient_keys.push_back(pkey) ;
 	}
+	return true ;
+}
 
-	// 2 - call GXSSecurity to make a header item that encrypts for the given list of peers.
-
-#ifdef NXS_NET_DEBUG_7
-	GXSNETDEBUG_P_ (item->PeerId()) << "  Encrypting..." << std::endl;
-#endif
-	uint32_t size = RsNxsSerialiser(mServType).size(item) ;
-	RsTemporaryMemory tempmem( size ) ;
+static void writeBatchEncryptionHeader(uint8_t *mem,uint16_t format,uint16_t key_index)
+{
+	mem[0] =  format          & 0xff ;
+	mem[1] = (format    >> 8) & 0xff ;
+	mem[2] =  key_index       & 0xff ;
+	mem[3] = (key_index >> 8) & 0xff ;
+}
 
-	if(!RsNxsSerialiser(mServType).serialise(item,tempmem,&size))
-	{
-		std::cerr << "  (EE) Cannot serialise item. Something went wrong." << std::endl;
-		status = RS_NXS_ITEM_ENCRYPTION_STATUS_SERIALISATION_ERROR ;
+static bool readBatchEncryptionHeader(const RsTlvBinaryData& data,uint16_t& format,uint16_t& key_index)
+{
+	if(data.bin_len < NXS_BATCH_ENCRYPTION_HEADER_SIZE)
 		return false ;
-	}
 
-	unsigned char *encrypted_data = NULL ;
+	const uint8_t *mem = (const uint8_t*)data.bin_data ;
+
+	format    = mem[0] + (mem[1] << 8) ;
+	key_index = mem[2] + (mem[3] << 8) ;
+
+	return format == NXS_BATCH_ENCRYPTION_KEY_FORMAT || format == NXS_BATCH_ENCRYPTION_DATA_FORMAT ;
+}
+
+// Turns a single RsNxsItem into an encrypted one, suitable for the supplied destination circle.
+// Returns false when the keys are not loaded. Question to solve: what do we do if we miss some keys??
+// We should probably send anyway.
+
+bool RsGxsNetService::encryptSingleNxsItem(RsNxsItem *item, const RsGxsCircleId& destination_circle, const RsGxsGroupId& destination_group, RsNxsItem *&encrypted_item, uint32_t& status, NxsBatchEncryptionContext *batch)
+{
+        encrypted_item = NULL ;
+	status = RS_NXS_ITEM_ENCRYPTION_STATUS_UNKNOWN ;
+#ifdef NXS_NET_DEBUG_7
+	GXSNETDEBUG_P_ (item->PeerId()) << "Service " << std::hex << ((mServiceInfo.mServiceType >> 8)& 0xffff) << std::dec << " - Encrypting single item for peer " << item->PeerId() << ", for circle ID " << destination_circle  << std::endl;
+#endif
+	// With a batch, the costly RSA part is only done once per circle, when creating the session key.
+
+	const NxsBatchEncryptionContext::SessionKey *session_key = NULL ;
+
+	if(batch != NULL)
+	{
+		std::pair<RsGxsCircleId,RsGxsGroupId> key_id(destination_circle,destination_group) ;
+		std::map<std::pair<RsGxsCircleId,RsGxsGroupId>,NxsBatchEncryptionContext::SessionKey>::const_iterator it = batch->mKeys.find(key_id) ;
+
+		if(it == batch->mKeys.end())
+		{
+			std::vector<RsTlvPublicRSAKey> recipient_keys ;
+
+			if(!locked_getCircleRecipientKeys(destination_circle,destination_group,recipient_keys,status))
+				return false ;
+
+			NxsBatchEncryptionContext::SessionKey skey ;
+			skey.index = batch->mKeys.size() ;
+			RsRandom::random_bytes(skey.key,GxsSecurity::SESSION_KEY_SIZE) ;
+
+			unsigned char *encrypted_key = NULL ;
+			uint32_t encrypted_key_len  = 0 ;
+
+			if(!GxsSecurity::encrypt(encrypted_key, encrypted_key_len,skey.key,GxsSecurity::SESSION_KEY_SIZE,recipient_keys))
+			{
+				std::cerr << "  (EE) Cannot multi-encrypt session key. Something went wrong." << std::endl;
+				status = RS_NXS_ITEM_ENCRYPTION_STATUS_ENCRYPTION_ERROR ;
+				return false ;
+			}
+
+			uint8_t *key_data = (uint8_t*)rs_malloc(NXS_BATCH_ENCRYPTION_HEADER_SIZE + encrypted_key_len) ;
+
+			if(key_data == NULL)
+			{
+				free(encrypted_key) ;
+				status = RS_NXS_ITEM_ENCRYPTION_STATUS_ENCRYPTION_ERROR ;
+				return false ;
+			}
+			writeBatchEncryptionHeader(key_data,NXS_BATCH_ENCRYPTION_KEY_FORMAT,skey.index) ;
+			memcpy(key_data + NXS_BATCH_ENCRYPTION_HEADER_SIZE,encrypted_key,encrypted_key_len) ;
+			free(encrypted_key) ;
+
+			RsNxsEncryptedDataItem *key_item = new RsNxsEncryptedDataItem(mServType) ;
+
+			key_item->encrypted_data.bin_len  = NXS_BATCH_ENCRYPTION_HEADER_SIZE + encrypted_key_len ;
+			key_item->encrypted_data.bin_data = key_data ;
+
+			key_item->transactionNumber = item->transactionNumber ;
+			key_item->PeerId(item->PeerId()) ;
+
+			batch->mKeyItems.push_back(key_item) ;
+			it = batch->mKeys.insert(std::make_pair(key_id,skey)).first ;
+#ifdef NXS_NET_DEBUG_7
+			GXSNETDEBUG_P_(item->PeerId()) << "    created session key #" << skey.index << " for circle " << destination_circle << std::endl;
+#endif
+		}
+		session_key = &it->second ;
+	}
+
+	std::vector<RsTlvPublicRSAKey> recipient_keys ;
+
+	if(session_key == NULL && !locked_getCircleRecipientKeys(destination_circle,destination_group,recipient_keys,status))
+		return false ;
+
+	// 2 - call GXSSecurity to make a header item that encrypts for the given list of peers.
+
+#ifdef NXS_NET_DEBUG_7
+	GXSNETDEBUG_P_ (item->PeerId()) << "  Encrypting..." << std::endl;
+#endif
+	uint32_t size = RsNxsSerialiser(mServType).size(item) ;
+	RsTemporaryMemory tempmem( size ) ;
+
+	if(!RsNxsSerialiser(mServType).serialise(item,tempmem,&size))
+	{
+		std::cerr << "  (EE) Cannot serialise item. Something went wrong." << std::endl;
+		status = RS_NXS_ITEM_ENCRYPTION_STATUS_SERIALISATION_ERROR ;
+		return false ;
+	}
+
+	unsigned char *encrypted_data = NULL ;
 	uint32_t encrypted_len  = 0 ;
 
-	if(!GxsSecurity::encrypt(encrypted_data, encrypted_len,tempmem,size,recipient_keys))
+	if(session_key != NULL)
+	{
+		unsigned char *data = NULL ;
+		uint32_t len = 0 ;
+
+		if(!GxsSecurity::encryptWithSessionKey(data, len,tempmem,size,session_key->key))
+		{
+			std::cerr << "  (EE) Cannot encrypt item with session key. Something went wrong." << std::endl;
+			status = RS_NXS_ITEM_ENCRYPTION_STATUS_ENCRYPTION_ERROR ;
+			return false ;
+		}
+		encrypted_len = NXS_BATCH_ENCRYPTION_HEADER_SIZE + len ;
+		encrypted_data = (unsigned char*)rs_malloc(encrypted_len) ;
+
+		if(encrypted_data == NULL)
+		{
+			free(data) ;
+			status = RS_NXS_ITEM_ENCRYPTION_STATUS_ENCRYPTION_ERROR ;
+			return false ;
+		}
+		writeBatchEncryptionHeader(encrypted_data,NXS_BATCH_ENCRYPTION_DATA_FORMAT,session_key->index) ;
+		memcpy(encrypted_data + NXS_BATCH_ENCRYPTION_HEADER_SIZE,data,len) ;
+		free(data) ;
+	}
+	else if(!GxsSecurity::encrypt(encrypted_data, encrypted_len,tempmem,size,recipient_keys))
 	{
 		std::cerr << "  (EE) Cannot multi-encrypt item. Something went wrong." << std::endl;
 		status = RS_NXS_ITEM_ENCRYPTION_STATUS_ENCRYPTION_ERROR ;
@@ -3792,55 +3990,186 @@ bool RsGxsNetService::encryptSingleNxsItem(RsNxsItem *item, const RsGxsCircleId&
 
 	return true ;
 }
+// Decrypts the transaction in the worker pool. Private keys are loaded first, then all items are processed.
+// Encrypted items that cannot be decrypted are discarded.
 
-// Tries to decrypt the transaction. First load the keys and process all items.
-// If keys are loaded, encrypted items that cannot be decrypted are discarded.
-// Otherwise the transaction is untouched for retry later.
-
-bool RsGxsNetService::processTransactionForDecryption(NxsTransaction *tr)
+bool RsGxsNetService::locked_processTransactionForDecryption(NxsTransaction *tr)
 {
 #ifdef NXS_NET_DEBUG_7
     RsPeerId peerId = tr->mTransaction->PeerId() ;
     GXSNETDEBUG_P_(peerId) << "RsGxsNetService::decryptTransaction()" << std::endl;
 #endif
+    bool has_encrypted_items = false ;
+
+    for(std::list<RsNxsItem*>::const_iterator it(tr->mItems.begin());it!=tr->mItems.end() && !has_encrypted_items;++it)
+        has_encrypted_items = (dynamic_cast<RsNxsEncryptedDataItem*>(*it) != NULL) ;
+
+    if(!has_encrypted_items)
+        return false ;
+
+    // Get all private keys. Normally we should look into the circle name and only supply the keys that we have.
+    // This is the only part that needs mGixs, so it is done here rather than in the worker thread.
 
-    std::list<RsNxsItem*> decrypted_items ;
     std::vector<RsTlvPrivateRSAKey> private_keys ;
+    std::list<RsGxsId> own_keys ;
+    mGixs->getOwnIds(own_keys) ;
+
+    for(std::list<RsGxsId>::const_iterator it(own_keys.begin());it!=own_keys.end();++it)
+    {
+	    RsTlvPrivateRSAKey private_key ;
 
-    // get all private keys. Normally we should look into the circle name and only supply the keys that we have
+	    if(mGixs->getPrivateKey(*it,private_key))
+		    private_keys.push_back(private_key) ;
+	    else
+	    {
+		    // Encrypted items will be dropped, as they were before when keys could not be loaded.
+		    std::cerr << "    (EE) Cannot retrieve private key for ID " << *it << std::endl;
+		    private_keys.clear() ;
+		    break ;
+	    }
+    }
 
-    for(std::list<RsNxsItem*>::iterator it(tr->mItems.begin());it!=tr->mItems.end();)
+    mDecryptionPool.run([this,tr,private_keys]()
     {
-        RsNxsEncryptedDataItem *encrypted_item = dynamic_cast<RsNxsEncryptedDataItem*>(*it) ;
+        decryptTransactionItems(tr,private_keys) ;
 
-        if(encrypted_item == NULL)
-        {
+        RS_STACK_MUTEX(mNxsMutex) ;
+        mComplTransactions.push_back(tr) ;
+    });
+
+    return true ;
+}
+
+void RsGxsNetService::decryptTransactionItems(NxsTransaction *tr, const std::vector<RsTlvPrivateRSAKey>& private_keys)
+{
+    const bool batch = tr->mTransaction->transactFlag & RsNxsTransacItem::FLAG_ENCRYPTED_BATCH ;
+    std::map<uint16_t,std::vector<uint8_t> > session_keys ;
+
+    // First decrypt the session keys. There is normally a single one per transaction, so this is where
+    // the only RSA decryption happens.
+
+    if(batch)
+	    for(std::list<RsNxsItem*>::iterator it(tr->mItems.begin());it!=tr->mItems.end();)
+	    {
+		    RsNxsEncryptedDataItem *encrypted_item = dynamic_cast<RsNxsEncryptedDataItem*>(*it) ;
+		    uint16_t format,key_index ;
+
+		    if(encrypted_item == NULL || !readBatchEncryptionHeader(encrypted_item->encrypted_data,format,key_index) || format != NXS_BATCH_ENCRYPTION_KEY_FORMAT)
+		    {
+			    ++it ;
+			    continue ;
+		    }
+		    it = tr->mItems.erase(it) ;
+
+		    uint8_t *key = NULL ;
+		    uint32_t key_len = 0 ;
+
+		    if(!private_keys.empty() && GxsSecurity::decrypt(key,key_len,(uint8_t*)encrypted_item->encrypted_data.bin_data + NXS_BATCH_ENCRYPTION_HEADER_SIZE,encrypted_item->encrypted_data.bin_len - NXS_BATCH_ENCRYPTION_HEADER_SIZE,private_keys) && key_len == GxsSecurity::SESSION_KEY_SIZE)
+			    session_keys[key_index] = std::vector<uint8_t>(key,key+key_len) ;
 #ifdef NXS_NET_DEBUG_7
-            GXSNETDEBUG_P_(peerId) << "  skipping unencrypted item..." << std::endl;
+		    else
+			    GXSNETDEBUG_P_(tr->mTransaction->PeerId()) << "    Cannot decrypt session key #" << key_index << ". Items using it will be dropped." << std::endl;
 #endif
-            ++it ;
-            continue ;
-        }
+		    free(key) ;
+		    delete encrypted_item ;
+	    }
 
-        // remove the encrypted item. After that it points to the next item to handle
-        it = tr->mItems.erase(it) ;
+    // Then decrypt all items in parallel. Each job only writes its own slot.
 
-        RsNxsItem *nxsitem = NULL ;
+    std::vector<RsNxsItem*> items(tr->mItems.begin(),tr->mItems.end()) ;
+    std::vector<RsNxsItem*> results(items.size(),NULL) ;
+    std::vector<std::function<void()> > jobs ;
 
-        if(decryptSingleNxsItem(encrypted_item,nxsitem,&private_keys))
-	{
+    for(uint32_t i=0;i<items.size();++i)
+    {
+	    const RsNxsEncryptedDataItem *encrypted_item = dynamic_cast<RsNxsEncryptedDataItem*>(items[i]) ;
+
+	    if(encrypted_item == NULL)
+	    {
+		    results[i] = items[i] ;
+		    items[i] = NULL ;
+		    continue ;
+	    }
+
+	    const uint8_t *data = (const uint8_t*)encrypted_item->encrypted_data.bin_data ;
+	    uint32_t len = encrypted_item->encrypted_data.bin_len ;
+	    const uint8_t *session_key = NULL ;
+	    uint16_t format,key_index ;
+
+	    if(batch && readBatchEncryptionHeader(encrypted_item->encrypted_data,format,key_index))
+	    {
+		    std::map<uint16_t,std::vector<uint8_t> >::const_iterator kit = session_keys.find(key_index) ;
+
+		    if(format != NXS_BATCH_ENCRYPTION_DATA_FORMAT || kit == session_keys.end())
+			    continue ;
+
+		    session_key = kit->second.data() ;
+		    data += NXS_BATCH_ENCRYPTION_HEADER_SIZE ;
+		    len  -= NXS_BATCH_ENCRYPTION_HEADER_SIZE ;
+	    }
+	    else if(private_keys.empty())
+		    continue ;
+
+	    RsNxsItem **result = &results[i] ;
+	    const RsPeerId peer = encrypted_item->PeerId() ;
+
+	    jobs.push_back([this,data,len,&private_keys,session_key,peer,result]()
+	    {
+		    decryptNxsItemData(data,len,private_keys,session_key,peer,*result) ;
+	    });
+    }
+
+    mDecryptionPool.runAndWait(jobs) ;
+
+    tr->mItems.clear() ;
+
+    for(uint32_t i=0;i<items.size();++i)
+    {
+	    delete items[i] ;
+
+	    if(results[i] != NULL)
+		    tr->mItems.push_back(results[i]) ;
+    }
 #ifdef NXS_NET_DEBUG_7
-		GXSNETDEBUG_P_(peerId) << "    Replacing the encrypted item with the clear one." << std::endl;
+    GXSNETDEBUG_P_(tr->mTransaction->PeerId()) << "    decrypted transaction, " << tr->mItems.size() << " items left." << std::endl;
 #endif
-		tr->mItems.insert(it,nxsitem) ;	// inserts before it, so no need to ++it
-	}
+}
+
+bool RsGxsNetService::decryptNxsItemData(const uint8_t *data, uint32_t len, const std::vector<RsTlvPrivateRSAKey>& private_keys, const uint8_t *session_key, const RsPeerId& peer, RsNxsItem *& nxsitem) const
+{
+    nxsitem = NULL ;
 
-        delete encrypted_item ;
+    uint8_t *decrypted_mem = NULL;
+    uint32_t decrypted_len = 0;
+
+    bool ok = (session_key != NULL)?
+	                GxsSecurity::decryptWithSessionKey(decrypted_mem,decrypted_len,data,len,session_key)
+	              : GxsSecurity::decrypt(decrypted_mem,decrypted_len,data,len,private_keys) ;
+
+    if(!ok || decrypted_mem == NULL)
+    {
+#ifdef NXS_NET_DEBUG_7
+	    GXSNETDEBUG_P_(peer) << "    Failed! Cannot decrypt this item." << std::endl;
+#endif
+	    return false ;
     }
 
-    return true ;
-}
+    RsItem *ditem = RsNxsSerialiser(mServType).deserialise(decrypted_mem,&decrypted_len) ;
+    free(decrypted_mem) ;
 
+    if(ditem != NULL)
+    {
+	    ditem->PeerId(peer) ;	// This is needed because the deserialised item has no peer id
+	    nxsitem = dynamic_cast<RsNxsItem*>(ditem) ;
+
+	    if(nxsitem == NULL)
+		    delete ditem ;
+    }
+    else
+	    std::cerr << "    Cannot deserialise. Item encoding error!" << std::endl;
+
+    return nxsitem != NULL ;
+}
 bool RsGxsNetService::decryptSingleNxsItem(const RsNxsEncryptedDataItem *encrypted_item, RsNxsItem *& nxsitem,std::vector<RsTlvPrivateRSAKey> *pprivate_keys)
 {
     // if private_keys storage is supplied use/update them, otherwise, find which key should be used, and store them in a local std::vector.
@@ -4295,6 +4624,11 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
     bool grp_is_known = false;
     bool was_circle_protected = item_was_encrypted || bool(item->flag & RsNxsSyncMsgReqItem::FLAG_USE_HASHED_GROUP_ID);
 
+    if(item->flag & RsNxsSyncMsgReqItem::FLAG_ACCEPTS_ENCRYPTED_BATCH)
+	    mEncryptedBatchPeers.insert(peer) ;
+    else
+	    mEncryptedBatchPeers.erase(peer) ;
+
     bool peer_can_receive_update = locked_CanReceiveUpdate(item, grp_is_known);
 
     if(item_was_encrypted)
@@ -4382,6 +4716,8 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
 
     uint32_t transN = locked_getTransactionId();
     RsGxsCircleId should_encrypt_to_this_circle_id ;
+    NxsBatchEncryptionContext batch ;
+    NxsBatchEncryptionContext *pbatch = locked_peerAcceptsEncryptedBatches(peer)?(&batch):NULL ;
 
     rstime_t now = time(NULL) ;
 
@@ -4446,7 +4782,7 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
 				RsNxsItem *encrypted_item = NULL ;
 				uint32_t status = RS_NXS_ITEM_ENCRYPTION_STATUS_UNKNOWN ;
 
-				if(encryptSingleNxsItem(mItem, grpMeta->mCircleId,m->mGroupId, encrypted_item,status))
+				if(encryptSingleNxsItem(mItem, grpMeta->mCircleId,m->mGroupId, encrypted_item,status,pbatch))
 				{
 					itemL.push_back(encrypted_item) ;
 					delete mItem ;
@@ -4484,7 +4820,7 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
 #ifdef NXS_NET_DEBUG_0
 	    GXSNETDEBUG_PG(item->PeerId(),item->grpId) << "  sending final msg info list of " << itemL.size() << " items." << std::endl;
 #endif
-	    locked_pushMsgRespFromList(itemL, peer, item->grpId,transN);
+	    locked_pushMsgRespFromList(itemL, peer, item->grpId,transN,pbatch);
     }
 #ifdef NXS_NET_DEBUG_0
     else
@@ -4497,7 +4833,116 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
 	    delete *vit;
 }
 
-void RsGxsNetService::locked_pushMsgRespFromList(std::list<RsNxsItem*>& itemL, const RsPeerId& sslId, const RsGxsGroupId& grp_id,const uint32_t& transN)
+void RsGxsNetService::handleRecvSyncMsgBatch(RsNxsSyncMsgBatchReqItem *item)
+{
+    if (!item)
+	    return;
+
+    RS_STACK_MUTEX(mNxsMutex) ;
+
+    const RsPeerId& peer = item->PeerId();
+
+    if(item->flag & RsNxsSyncMsgReqItem::FLAG_ACCEPTS_ENCRYPTED_BATCH)
+	    mEncryptedBatchPeers.insert(peer) ;
+    else
+	    mEncryptedBatchPeers.erase(peer) ;
+
+#ifdef NXS_NET_DEBUG_0
+    GXSNETDEBUG_P_(peer) << "handleRecvSyncMsgBatch(): received last update TS of " << item->groups.size() << " groups from peer " << peer << std::endl;
+#endif
+
+    // Same logic as handleRecvSyncMessage(), except that only the group meta data is needed: the peer will request
+    // the message list of each changed group separately.
+
+    RsGxsGrpMetaTemporaryMap grpMetas;
+
+    for(std::vector<RsNxsSyncMsgBatchReqItem::GroupEntry>::const_iterator it(item->groups.begin());it!=item->groups.end();++it)
+    {
+	    ServerMsgMap::const_iterator cit = mServerMsgUpdateMap.find(it->grpId);
+	    bool grp_is_known = (cit != mServerMsgUpdateMap.end());
+
+	    if(grp_is_known || mServerGrpConfigMap.find(it->grpId)!=mServerGrpConfigMap.end())
+		    locked_getGrpConfig(it->grpId).suppliers.ids.insert(peer) ;
+
+	    if(grp_is_known && it->updateTS < cit->second.msgUpdateTS)
+		    grpMetas[it->grpId] = NULL;
+    }
+
+    if(grpMetas.empty())
+    {
+#ifdef NXS_NET_DEBUG_0
+	    GXSNETDEBUG_P_(peer) << "  no update will be sent." << std::endl;
+#endif
+	    return;
+    }
+
+    mDataStore->retrieveGxsGrpMetaData(grpMetas);
+
+    RsNxsSyncMsgDigestItem *digest = new RsNxsSyncMsgDigestItem(mServType);
+    digest->PeerId(peer);
+
+    for(RsGxsGrpMetaTemporaryMap::const_iterator mit(grpMetas.begin());mit!=grpMetas.end();++mit)
+    {
+	    const RsGxsGrpMetaData *grpMeta = mit->second;
+
+	    // Groups tied to an external circle are only synced through hashed and encrypted requests.
+
+	    if(grpMeta == NULL || !(grpMeta->mSubscribeFlags & GXS_SERV::GROUP_SUBSCRIBE_SUBSCRIBED) || grpMeta->mCircleType == GXS_CIRCLE_TYPE_EXTERNAL)
+		    continue;
+
+	    digest->changedGroups.push_back(mit->first);
+    }
+
+#ifdef NXS_NET_DEBUG_0
+    GXSNETDEBUG_P_(peer) << "  sending digest of " << digest->changedGroups.size() << " changed groups." << std::endl;
+#endif
+
+    if(digest->changedGroups.empty())
+	    delete digest;
+    else
+	    generic_sendItem(digest);
+}
+
+void RsGxsNetService::handleRecvSyncMsgDigest(RsNxsSyncMsgDigestItem *item)
+{
+    if (!item)
+	    return;
+
+    RS_STACK_MUTEX(mNxsMutex) ;
+
+    if(!mAllowMsgSync)
+	    return ;
+
+    const RsPeerId& peerId = item->PeerId();
+
+    RsGxsGrpMetaTemporaryMap grpMetas;
+
+    for(std::vector<RsGxsGroupId>::const_iterator it(item->changedGroups.begin());it!=item->changedGroups.end();++it)
+	    grpMetas[*it] = NULL;
+
+    mDataStore->retrieveGxsGrpMetaData(grpMetas);
+
+    for(RsGxsGrpMetaTemporaryMap::const_iterator mit(grpMetas.begin());mit!=grpMetas.end();++mit)
+    {
+	    const RsGxsGrpMetaData *meta = mit->second;
+	    RsGxsCircleId encrypt_to_this_circle_id ;
+
+	    // Only request what syncWithPeers() would have put in the batched request in the first place.
+
+	    if(meta == NULL || !(meta->mSubscribeFlags & GXS_SERV::GROUP_SUBSCRIBE_SUBSCRIBED))
+		    continue;
+
+	    if(!checkCanRecvMsgFromPeer(peerId, *meta, encrypt_to_this_circle_id) || !encrypt_to_this_circle_id.isNull())
+		    continue;
+
+#ifdef NXS_NET_DEBUG_0
+	    GXSNETDEBUG_PG(peerId,mit->first) << "handleRecvSyncMsgDigest(): group " << mit->first << " changed at peer " << peerId << ". Requesting message list." << std::endl;
+#endif
+	    generic_sendItem(locked_createSyncMsgReqItem(peerId, mit->first, encrypt_to_this_circle_id));
+    }
+}
+
+void RsGxsNetService::locked_pushMsgRespFromList(std::list<RsNxsItem*>& itemL, const RsPeerId& sslId, const RsGxsGroupId& grp_id,const uint32_t& transN,NxsBatchEncryptionContext *batch)
 {
 #ifdef NXS_NET_DEBUG_1
     GXSNETDEBUG_PG(sslId,grp_id) << "locked_pushMsgResponseFromList()" << std::endl;
@@ -4511,7 +4956,18 @@ void RsGxsNetService::locked_pushMsgRespFromList(std::list<RsNxsItem*>& itemL, c
 
 	RsNxsTransacItem* trItem = new RsNxsTransacItem(mServType);
     trItem->transactFlag = RsNxsTransacItem::FLAG_BEGIN_P1 | RsNxsTransacItem::FLAG_TYPE_MSG_LIST_RESP;
-    trItem->nItems = itemL.size();
+
+    // session keys go first, so that the receiver has them when decrypting the data items
+
+    if(batch != NULL && !batch->mKeyItems.empty())
+    {
+	    for(std::list<RsNxsItem*>::iterator it(batch->mKeyItems.begin());it!=batch->mKeyItems.end();++it)
+		    (*it)->transactionNumber = transN ;
+
+	    tr->mItems.splice(tr->mItems.begin(),batch->mKeyItems) ;
+	    trItem->transactFlag |= RsNxsTransacItem::FLAG_ENCRYPTED_BATCH ;
+    }
+    trItem->nItems = tr->mItems.size();
 	trItem->timestamp = 0;
 	trItem->PeerId(sslId);
 	trItem->transactionNumber = transN;
@@ -5116,6 +5572,213 @@ bool RsGxsNetService::locked_stampMsgServerUpdateTS(const RsGxsGroupId& gid)
     return true;
 }
 
+void RsGxsNetService::announceNewMessages(const GxsMsgReq& msgIds)
+{
+    RS_STACK_MUTEX(mNxsMutex) ;
+
+    // no peer can negotiate announces when we advertise an older version
+    if(mPushAnnounceMinVersionMajor == 0 || !serviceVersionAtLeast(mServiceInfo.mVersionMajor, mServiceInfo.mVersionMinor, mPushAnnounceMinVersionMajor, mPushAnnounceMinVersionMinor))
+        return ;
+
+    rstime_t now = time(NULL) ;
+
+    for(GxsMsgReq::const_iterator it(msgIds.begin());it!=msgIds.end();++it)
+        for(std::set<RsGxsMessageId>::const_iterator it2(it->second.begin());it2!=it->second.end();++it2)
+        {
+            // Past this limit, the periodic sync takes over.
+
+            if(mPendingAnnounceCount >= MAX_PENDING_MSG_ANNOUNCES)
+                return ;
+
+            if(!mAnnouncedMsgs.insert(std::make_pair(*it2,now)).second)
+                continue ;
+
+            if(mPendingAnnounces[it->first].insert(*it2).second)
+                ++mPendingAnnounceCount ;
+        }
+}
+
+void RsGxsNetService::sendPendingAnnounces()
+{
+    RS_STACK_MUTEX(mNxsMutex) ;
+
+    rstime_t now = time(NULL) ;
+
+    if(mPendingAnnounces.empty() || mLastAnnounceTS + MIN_DELAY_BETWEEN_MSG_ANNOUNCES > now)
+        return ;
+
+    mLastAnnounceTS = now ;
+
+    // Take at most MAX_MSGS_PER_ANNOUNCE_ROUND message ids from the queue
+
+    GxsMsgReq to_announce ;
+    uint32_t n = 0 ;
+
+    for(GxsMsgReq::iterator it(mPendingAnnounces.begin());it!=mPendingAnnounces.end() && n < MAX_MSGS_PER_ANNOUNCE_ROUND;)
+    {
+        std::set<RsGxsMessageId>& ids(it->second) ;
+
+        while(!ids.empty() && n < MAX_MSGS_PER_ANNOUNCE_ROUND)
+        {
+            to_announce[it->first].insert(*ids.begin()) ;
+            ids.erase(ids.begin()) ;
+            ++n ;
+        }
+
+        if(ids.empty())
+            it = mPendingAnnounces.erase(it) ;
+        else
+            ++it ;
+    }
+    mPendingAnnounceCount -= n ;
+
+    std::set<RsPeerId> online_peers;
+    mNetMgr->getOnlineList(mServiceInfo.mServiceType, online_peers);
+
+    RsGxsGrpMetaTemporaryMap grpMetas;
+
+    for(GxsMsgReq::const_iterator it(to_announce.begin());it!=to_announce.end();++it)
+        grpMetas[it->first] = NULL ;
+
+    mDataStore->retrieveGxsGrpMetaData(grpMetas);
+
+    std::map<RsPeerId,RsNxsMsgAnnounceItem*> items ;
+
+    for(GxsMsgReq::const_iterator it(to_announce.begin());it!=to_announce.end();++it)
+    {
+        const RsGxsGrpMetaData *grpMeta = grpMetas[it->first] ;
+
+        // Only public groups are announced. Circle restricted groups would need the announce to be encrypted,
+        // and are left to the periodic sync.
+
+        if(grpMeta == NULL || grpMeta->mCircleType != GXS_CIRCLE_TYPE_PUBLIC || !(grpMeta->mSubscribeFlags & GXS_SERV::GROUP_SUBSCRIBE_SUBSCRIBED))
+            continue ;
+
+        GrpConfigMap::const_iterator cit = mServerGrpConfigMap.find(it->first) ;
+
+        if(cit == mServerGrpConfigMap.end())
+            continue ;
+
+        // The suppliers of a group are the friends that sent us sync requests for it, hence the ones that are subscribed to it.
+
+        for(std::set<RsPeerId>::const_iterator pit(cit->second.suppliers.ids.begin());pit!=cit->second.suppliers.ids.end();++pit)
+        {
+            if(online_peers.find(*pit) == online_peers.end() || !locked_peerSupportsMsgAnnounces(*pit))
+                continue ;
+
+            RsNxsMsgAnnounceItem *& item(items[*pit]) ;
+
+            if(item == NULL)
+            {
+                item = new RsNxsMsgAnnounceItem(mServType) ;
+                item->PeerId(*pit) ;
+            }
+
+            for(std::set<RsGxsMessageId>::const_iterator mit(it->second.begin());mit!=it->second.end();++mit)
+            {
+                RsNxsMsgAnnounceItem::MsgEntry entry ;
+                entry.grpId = it->first ;
+                entry.msgId = *mit ;
+                item->msgs.push_back(entry) ;
+            }
+        }
+    }
+
+    for(std::map<RsPeerId,RsNxsMsgAnnounceItem*>::const_iterator it(items.begin());it!=items.end();++it)
+    {
+#ifdef NXS_NET_DEBUG_0
+        GXSNETDEBUG_P_(it->first) << "  announcing " << it->second->msgs.size() << " new messages to peer " << it->first << std::endl;
+#endif
+        generic_sendItem(it->second) ;
+    }
+}
+
+void RsGxsNetService::cleanAnnounceRecords()
+{
+    RS_STACK_MUTEX(mNxsMutex) ;
+    rstime_t now = time(NULL) ;
+
+    for(std::map<RsGxsMessageId,rstime_t>::iterator it(mAnnouncedMsgs.begin());it!=mAnnouncedMsgs.end();)
+        if(it->second + MSG_ANNOUNCE_MEMORY_PERIOD < now)
+            it = mAnnouncedMsgs.erase(it) ;
+        else
+            ++it ;
+
+    for(std::map<std::pair<RsPeerId,RsGxsGroupId>,rstime_t>::iterator it(mAnnounceTriggeredRequests.begin());it!=mAnnounceTriggeredRequests.end();)
+        if(it->second + MIN_DELAY_BETWEEN_ANNOUNCE_REQUESTS < now)
+            it = mAnnounceTriggeredRequests.erase(it) ;
+        else
+            ++it ;
+}
+
+void RsGxsNetService::handleRecvMsgAnnounce(RsNxsMsgAnnounceItem *item)
+{
+    if (!item)
+	    return;
+
+    RS_STACK_MUTEX(mNxsMutex) ;
+
+    if(!mAllowMsgSync)
+	    return ;
+
+    const RsPeerId& peerId = item->PeerId();
+    rstime_t now = time(NULL) ;
+
+    GxsMsgReq announced ;
+
+    for(std::vector<RsNxsMsgAnnounceItem::MsgEntry>::const_iterator it(item->msgs.begin());it!=item->msgs.end();++it)
+	    if(mRejectedMessages.find(it->msgId) == mRejectedMessages.end())
+		    announced[it->grpId].insert(it->msgId) ;
+
+    if(announced.empty())
+	    return ;
+
+    RsGxsGrpMetaTemporaryMap grpMetas;
+
+    for(GxsMsgReq::const_iterator it(announced.begin());it!=announced.end();++it)
+	    grpMetas[it->first] = NULL ;
+
+    mDataStore->retrieveGxsGrpMetaData(grpMetas);
+
+    // Messages we already have were most likely received from another friend: skip them.
+
+    GxsMsgMetaResult known ;
+    mDataStore->retrieveGxsMsgMetaData(announced, known);
+
+    for(GxsMsgReq::const_iterator it(announced.begin());it!=announced.end();++it)
+    {
+	    const RsGxsGrpMetaData *meta = grpMetas[it->first] ;
+	    RsGxsCircleId encrypt_to_this_circle_id ;
+
+	    if(meta == NULL || !(meta->mSubscribeFlags & GXS_SERV::GROUP_SUBSCRIBE_SUBSCRIBED))
+		    continue;
+
+	    if(known[it->first].size() >= it->second.size())
+		    continue;
+
+	    rstime_t& last_request_TS(mAnnounceTriggeredRequests[std::make_pair(peerId,it->first)]) ;
+
+	    if(last_request_TS + MIN_DELAY_BETWEEN_ANNOUNCE_REQUESTS > now)
+		    continue;
+
+	    if(!checkCanRecvMsgFromPeer(peerId, *meta, encrypt_to_this_circle_id) || !encrypt_to_this_circle_id.isNull())
+		    continue;
+
+	    last_request_TS = now ;
+
+#ifdef NXS_NET_DEBUG_0
+	    GXSNETDEBUG_PG(peerId,it->first) << "handleRecvMsgAnnounce(): peer " << peerId << " announced new messages in group " << it->first << ". Requesting message list." << std::endl;
+#endif
+	    // The usual msg list exchange follows, so that reputation and circle vetting apply to these messages as well.
+
+	    generic_sendItem(locked_createSyncMsgReqItem(peerId, it->first, encrypt_to_this_circle_id));
+    }
+
+    for(GxsMsgMetaResult::iterator it(known.begin());it!=known.end();++it)
+	    for(std::vector<RsGxsMsgMetaData*>::iterator vit(it->second.begin());vit!=it->second.end();++vit)
+		    delete *vit ;
+}
+
 TurtleRequestId RsGxsNetService::turtleGroupRequest(const RsGxsGroupId& group_id)
 {
 	RS_STACK_MUTEX(mNxsMutex) ;
@@ -35,7 +35,9 @@
 #include "rsgxsnetutils.h"
 #include "pqi/p3cfgmgr.h"
 #include "rsgixs.h"
+#include "gxssecurity.h"
 #include "util/rssharedptr.h"
+#include "util/rsworkerpool.h"
 
 /// keep track of transaction number
 typedef std::map<uint32_t, NxsTransaction*> TransactionIdMap;
@@ -45,6 +47,34 @@ typedef std::map<RsPeerId, TransactionIdMap > TransactionsPeerMap;
 
 class PgpAuxUtils;
 
+/*!
+ * Session keys used while encrypting the items of a single transaction,
+ * one per destination circle and group. Each key is sent once, RSA encrypted
+ * for all the circle members, in its own item at the beginning of the
+ * transaction; items themselves are then only AES encrypted.
+ */
+class NxsBatchEncryptionContext
+{
+public:
+	NxsBatchEncryptionContext() {}
+	~NxsBatchEncryptionContext();
+
+	struct SessionKey
+	{
+		uint16_t index ;
+		uint8_t key[GxsSecurity::SESSION_KEY_SIZE] ;
+	};
+
+	std::map<std::pair<RsGxsCircleId,RsGxsGroupId>,SessionKey> mKeys ;
+
+	/// encrypted session key items, to be sent ahead of the data items
+	std::list<RsNxsItem*> mKeyItems ;
+
+private:
+	NxsBatchEncryptionContext(const NxsBatchEncryptionContext&) = delete;
+	NxsBatchEncryptionContext& operator=(const NxsBatchEncryptionContext&) = delete;
+};
+
 class RsGroupNetworkStatsRecord
 {
     public:
@@ -126,6 +156,37 @@ public:
 	virtual void setDefaultKeepAge(uint32_t t) { mDefaultMsgStorePeriod = t ; }
 	virtual void setDefaultSyncAge(uint32_t t) { mDefaultMsgSyncPeriod = t ; }
 
+    /// Minor version of services at major version 1 from which batched message sync is understood
+    static const uint16_t BATCHED_SYNC_MINOR_VERSION = 1;
+
+    /*!
+     * Enables batched message sync (RsNxsSyncMsgBatchReqItem) with the peers
+     * when the version negotiated with them, which is the lower of ours and
+     * theirs, is at least the given one. Other peers keep receiving one
+     * RsNxsSyncMsgReqItem per group.
+     */
+    void setBatchedSyncMinVersion(uint16_t major, uint16_t minor);
+
+    /// Minor version of services at major version 1 from which RsNxsMsgAnnounceItem is understood
+    static const uint16_t MSG_ANNOUNCE_MINOR_VERSION = 2;
+
+    /*!
+     * Enables push mode: new messages are announced right away to the online
+     * suppliers of their group whose negotiated version of this service is at
+     * least the given one, instead of waiting for their next sync round.
+     */
+    void setPushAnnounceMinVersion(uint16_t major, uint16_t minor);
+
+    /// Minor version of services at major version 1 from which fragmented messages are reassembled and acknowledged
+    static const uint16_t FRAGMENTED_MSG_MINOR_VERSION = 3;
+
+    /*!
+     * Messages larger than FRAGMENT_SIZE are sent in fragments to the peers
+     * whose negotiated version of this service is at least the given one.
+     * These peers rebuild them while receiving, and acknowledge each fragment.
+     */
+    void setFragmentedMsgMinVersion(uint16_t major, uint16_t minor);
+
     /*!
      * \brief Search methods.
      * 			These four methods are used to request distant search and receive the results.
@@ -190,6 +251,7 @@ public:
     
     virtual bool getGroupServerUpdateTS(const RsGxsGroupId& gid,rstime_t& grp_server_update_TS,rstime_t& msg_server_update_TS) ;
     virtual bool stampMsgServerUpdateTS(const RsGxsGroupId& gid) ;
+    virtual void announceNewMessages(const GxsMsgReq& msgIds) ;
     virtual bool removeGroups(const std::list<RsGxsGroupId>& groups);
     virtual bool isDistantPeer(const RsPeerId& pid);
 
@@ -378,6 +440,27 @@ private:
      */
     void handleRecvSyncMessage(RsNxsSyncMsgReqItem* item,bool item_was_encrypted);
 
+    /*!
+     * Handles a batched msgs synchronisation request: answers with a single
+     * digest of the groups that have new messages for the peer.
+     * @param item contains the last update time stamps of many groups
+     */
+    void handleRecvSyncMsgBatch(RsNxsSyncMsgBatchReqItem* item);
+
+    /*!
+     * Handles the answer to a batched msgs synchronisation request, by
+     * requesting the message lists of the groups that changed.
+     * @param item contains the ids of the changed groups
+     */
+    void handleRecvSyncMsgDigest(RsNxsSyncMsgDigestItem* item);
+
+    /*!
+     * Handles new messages pushed by a peer, by requesting the message lists
+     * of the groups in which some of them are missing.
+     * @param item contains the ids of the new messages
+     */
+    void handleRecvMsgAnnounce(RsNxsMsgAnnounceItem* item);
+
     /*!
      * Handles an nxs item for group publish key
      * @param item contaims keys/grp info
@@ -417,7 +500,7 @@ private:
     void locked_pushGrpTransactionFromList(std::list<RsNxsItem*>& reqList, const RsPeerId& peerId, const uint32_t& transN); // forms a grp list request
     void locked_pushMsgTransactionFromList(std::list<RsNxsItem*>& reqList, const RsPeerId& peerId, const uint32_t& transN);	// forms a msg list request
     void locked_pushGrpRespFromList(std::list<RsNxsItem*>& respList, const RsPeerId& peer, const uint32_t& transN);
-    void locked_pushMsgRespFromList(std::list<RsNxsItem*>& itemL, const RsPeerId& sslId, const RsGxsGroupId &grp_id, const uint32_t& transN);
+    void locked_pushMsgRespFromList(std::list<RsNxsItem*>& itemL, const RsPeerId& sslId, const RsGxsGroupId &grp_id, const uint32_t& transN, NxsBatchEncryptionContext *batch = NULL);
     
 	void checkDistantSyncState();
     void syncWithPeers();
@@ -470,15 +553,6 @@ private:
      */
     bool fragmentGrp(RsNxsGrp& grp, GrpFragments& grpFragments) const;
 
-    /*!
-     * Fragment a message into individual fragments which are at most 150kb
-     * @param msg message to fragment
-     * @param msgFragments fragmented message
-     * @return NULL if not possible to reconstruct message from fragment,
-     *              pointer to defragments nxs message is possible
-     */
-    RsNxsMsg* deFragmentMsg(MsgFragments& msgFragments) const;
-
     /*!
      * Fragment a group into individual fragments which are at most 150kb
      * @param grp group to fragment
@@ -490,11 +564,10 @@ private:
 
 
     /*!
-     * Note that if all fragments for a message are not found then its fragments are dropped
-     * @param fragments message fragments which are not necessarily from the same message
-     * @param partFragments the partitioned fragments (into message ids)
+     * Feeds a fragment received in an incoming transaction to its reassembler,
+     * and adds the message to the transaction items once complete
      */
-    void collateMsgFragments(MsgFragments &fragments, std::map<RsGxsMessageId, MsgFragments>& partFragments) const;
+    void locked_addMsgFragment(const RsPeerId& peer, NxsTransaction* tr, RsNxsMsg* fragment);
 
     /*!
 	 * Note that if all fragments for a group are not found then its fragments are dropped
@@ -511,10 +584,61 @@ private:
 
     /*!
     * encrypts/decrypts the transaction for the destination circle id.
+    * When a batch context is supplied, the item is encrypted with the session key of the
+    * circle, which is created and added to the context's key items the first time.
     */
-    bool encryptSingleNxsItem(RsNxsItem *item, const RsGxsCircleId& destination_circle, const RsGxsGroupId &destination_group, RsNxsItem *& encrypted_item, uint32_t &status) ;
+    bool encryptSingleNxsItem(RsNxsItem *item, const RsGxsCircleId& destination_circle, const RsGxsGroupId &destination_group, RsNxsItem *& encrypted_item, uint32_t &status, NxsBatchEncryptionContext *batch = NULL) ;
     bool decryptSingleNxsItem(const RsNxsEncryptedDataItem *encrypted_item, RsNxsItem *&nxsitem, std::vector<RsTlvPrivateRSAKey> *private_keys=NULL);
-    bool processTransactionForDecryption(NxsTransaction *tr); // return false when the keys are not loaded => need retry later
+
+    /*!
+    * Queues the decryption of the encrypted items of a completed incoming transaction in the
+    * worker pool, which moves it to the completed transactions once done.
+    * Returns false if the transaction has nothing to decrypt, in which case it is left untouched.
+    */
+    bool locked_processTransactionForDecryption(NxsTransaction *tr);
+
+    /*!
+    * Decrypts all items of the transaction, using the session keys it contains if any. Items that
+    * cannot be decrypted are dropped. Does not need the mutex, and does not use mGixs.
+    */
+    void decryptTransactionItems(NxsTransaction *tr, const std::vector<RsTlvPrivateRSAKey>& private_keys);
+    bool decryptNxsItemData(const uint8_t *data, uint32_t len, const std::vector<RsTlvPrivateRSAKey>& private_keys, const uint8_t *session_key, const RsPeerId& peer, RsNxsItem *& nxsitem) const;
+
+    bool locked_getCircleRecipientKeys(const RsGxsCircleId& destination_circle, const RsGxsGroupId& destination_group, std::vector<RsTlvPublicRSAKey>& recipient_keys, uint32_t& status);
+
+    /*!
+    * Peers that told us in their sync requests that they can decrypt batch encrypted transactions.
+    */
+    bool locked_peerAcceptsEncryptedBatches(const RsPeerId& peer) const { return mEncryptedBatchPeers.find(peer) != mEncryptedBatchPeers.end(); }
+
+    /*!
+    * Peers that advertise a version of the service that understands RsNxsSyncMsgBatchReqItem.
+    */
+    bool locked_peerSupportsBatchedSync(const RsPeerId& peer) const;
+
+    /*!
+    * Peers that advertise a version of the service that understands RsNxsMsgAnnounceItem.
+    */
+    bool locked_peerSupportsMsgAnnounces(const RsPeerId& peer) const;
+
+    /*!
+    * Peers that advertise a version of the service that reassembles fragmented messages.
+    */
+    bool locked_peerSupportsFragmentedMsgs(const RsPeerId& peer) const;
+
+    /*!
+    * True if the service version negotiated with the peer, that is the lower of
+    * ours and the one it advertises, is at least min_major.min_minor.
+    */
+    bool locked_peerHasServiceVersion(const RsPeerId& peer, uint16_t min_major, uint16_t min_minor) const;
+
+    /*!
+    * Sends the messages queued by announceNewMessages(), at most once every few seconds.
+    */
+    void sendPendingAnnounces();
+    void cleanAnnounceRecords();
+
+    RsNxsSyncMsgReqItem *locked_createSyncMsgReqItem(const RsPeerId& peerId, const RsGxsGroupId& grpId, const RsGxsCircleId& encrypt_to_this_circle_id);
 
     void cleanRejectedMessages();
     void processObserverNotifications();
@@ -621,6 +745,26 @@ private:
     std::map<TurtleRequestId,RsGxsGroupId> mSearchRequests;
     std::map<RsGxsGroupId,GroupRequestRecord> mSearchedGroups ;
     rstime_t mLastCacheReloadTS ;
+
+    std::set<RsPeerId> mEncryptedBatchPeers ;
+
+    uint16_t mBatchedSyncMinVersionMajor ;	// 0 means batched sync is disabled
+    uint16_t mBatchedSyncMinVersionMinor ;
+
+    uint16_t mPushAnnounceMinVersionMajor ;	// 0 means push mode is disabled
+    uint16_t mPushAnnounceMinVersionMinor ;
+
+    uint16_t mFragmentedMsgMinVersionMajor ;	// 0 means messages are never fragmented
+    uint16_t mFragmentedMsgMinVersionMinor ;
+
+    GxsMsgReq mPendingAnnounces ;						// new messages not announced yet
+    uint32_t mPendingAnnounceCount ;
+    std::map<RsGxsMessageId,rstime_t> mAnnouncedMsgs ;	// avoids announcing the same message twice
+    std::map<std::pair<RsPeerId,RsGxsGroupId>,rstime_t> mAnnounceTriggeredRequests ;	// limits the sync requests caused by announces
+    rstime_t mLastAnnounceTS ;
+
+    /// Decrypts circle restricted transactions. Declared last so that it is stopped first.
+    RsWorkerPool mDecryptionPool ;
 };
 
 #endif // RSGXSNETSERVICE_H
@@ -20,9 +20,13 @@
  *                                                                             *
  *******************************************************************************/
 
+#include <string.h>
+#include <algorithm>
+
 #include "rsgxsnetutils.h"
 #include "pqi/p3servicecontrol.h"
 #include "pgp/pgpauxutils.h"
+#include "util/rsmemory.h"
 
  const rstime_t AuthorPending::EXPIRY_PERIOD_OFFSET = 30; // 30 seconds
  const int AuthorPending::MSG_PEND = 1;
@@ -158,7 +162,7 @@ const uint8_t NxsTransaction::FLAG_STATE_COMPLETED       = 0x0080;	// originaly
 
 
 NxsTransaction::NxsTransaction()
-    : mFlag(0), mTimeOut(0), mTransaction(NULL) {
+    : mFlag(0), mTimeOut(0), mTransaction(NULL), mNbReceivedItems(0), mMsgFragments(NULL) {
 
 }
 
@@ -176,6 +180,135 @@ NxsTransaction::~NxsTransaction(){
 		delete mTransaction;
 
 	mTransaction = NULL;
+
+	delete mMsgFragments;
+}
+
+bool NxsTransaction::fragmentsAcknowledged(uint32_t nItems, uint32_t now, uint32_t timeOut)
+{
+	if(!mTransaction || nItems == 0 || nItems > mTransaction->nItems)
+		return false;
+
+	// only our own clock is used: the peer's one may be anything
+	mTimeOut = std::max(mTimeOut, now + timeOut);
+	return true;
+}
+
+/** NxsMsgReassembler definition **/
+
+NxsMsgReassembler::NxsMsgReassembler(uint32_t fragmentSize, uint32_t maxMsgSize, uint32_t maxFragments)
+    : mFragmentSize(fragmentSize), mMaxMsgSize(maxMsgSize), mMaxFragments(maxFragments), mAnnouncedFragments(0), mReservedSize(0)
+{
+}
+
+NxsMsgReassembler::~NxsMsgReassembler()
+{
+	for(std::map<RsGxsMessageId, PendingMsg>::iterator it = mPending.begin(); it != mPending.end(); ++it)
+	{
+		delete it->second.mMsg;
+		free(it->second.mData);
+	}
+}
+
+RsNxsMsg* NxsMsgReassembler::addFragment(RsNxsMsg* fragment, uint64_t maxReservation)
+{
+	if(fragment->count < 2)
+		return fragment;
+
+	bool last = fragment->pos + 1 == fragment->count;
+
+	if( fragment->pos >= fragment->count
+	        || (fragment->count - 1) * mFragmentSize >= mMaxMsgSize
+	        || fragment->msg.bin_len > mFragmentSize
+	        || (!last && fragment->msg.bin_len != mFragmentSize)
+	        || fragment->msg.bin_len == 0 )
+	{
+		std::cerr << "(WW) dropping invalid fragment " << (int)fragment->pos << "/" << (int)fragment->count << " of size " << fragment->msg.bin_len
+		          << " for message " << fragment->msgId << std::endl;
+		delete fragment;
+		return NULL;
+	}
+
+	std::map<RsGxsMessageId, PendingMsg>::iterator it = mPending.find(fragment->msgId);
+
+	if(it == mPending.end())
+	{
+		// don't let a peer make us reserve memory for fragments it will never send
+
+		uint64_t size = fragment->count * (uint64_t)mFragmentSize;
+
+		if(mAnnouncedFragments + fragment->count > mMaxFragments || size > maxReservation)
+		{
+			std::cerr << "(WW) dropping fragment " << (int)fragment->pos << "/" << (int)fragment->count << " for message " << fragment->msgId
+			          << ": more fragments than the transaction has left, or too much memory already reserved." << std::endl;
+			delete fragment;
+			return NULL;
+		}
+
+		PendingMsg pm;
+		pm.mData = (uint8_t*)rs_malloc(size);
+
+		if(!pm.mData)
+		{
+			delete fragment;
+			return NULL;
+		}
+
+		pm.mMsg = fragment;
+		pm.mSize = 0;
+		pm.mReceived.resize(fragment->count, false);
+		pm.mNbReceived = 0;
+
+		mAnnouncedFragments += fragment->count;
+		mReservedSize += size;
+
+		it = mPending.insert(std::make_pair(fragment->msgId, pm)).first;
+	}
+
+	PendingMsg& pm = it->second;
+
+	if(pm.mReceived.size() != fragment->count || pm.mReceived[fragment->pos])
+	{
+		std::cerr << "(WW) dropping duplicate or inconsistent fragment " << (int)fragment->pos << "/" << (int)fragment->count
+		          << " for message " << fragment->msgId << std::endl;
+
+		if(pm.mMsg != fragment)
+			delete fragment;
+		return NULL;
+	}
+
+	memcpy(pm.mData + fragment->pos * mFragmentSize, fragment->msg.bin_data, fragment->msg.bin_len);
+	pm.mReceived[fragment->pos] = true;
+	++pm.mNbReceived;
+
+	if(last)
+		pm.mSize = fragment->pos * mFragmentSize + fragment->msg.bin_len;
+
+	// the meta data only travels with the first fragment
+	if(fragment->pos == 0 && pm.mMsg != fragment)
+		pm.mMsg->meta.setBinData(fragment->meta.bin_data, fragment->meta.bin_len);
+
+	if(pm.mMsg == fragment)
+		fragment->msg.TlvClear();
+	else
+		delete fragment;
+
+	if(pm.mNbReceived < pm.mReceived.size())
+		return NULL;
+
+	RsNxsMsg* msg = pm.mMsg;
+
+	// hand over the buffer, no further copy
+	msg->msg.TlvClear();
+	msg->msg.bin_data = pm.mData;
+	msg->msg.bin_len = pm.mSize;
+	msg->pos = 0;
+	msg->count = 1;
+
+	mReservedSize -= pm.mReceived.size() * (uint64_t)mFragmentSize;
+	mPending.erase(it);
+
+	return msg;
 }
 
 
@@ -198,6 +331,23 @@ void RsNxsNetMgrImpl::getOnlineList(const uint32_t serviceId, std::set<RsPeerId>
     mServiceCtrl->getPeersConnected(serviceId, ssl_peers);
 }
 
+bool RsNxsNetMgrImpl::getPeerServiceVersion(const RsPeerId& peer, const uint32_t serviceId, uint16_t& major, uint16_t& minor)
+{
+    RsPeerServiceInfo info;
+
+    if(!mServiceCtrl->getServicesProvided(peer, info))
+        return false;
+
+    std::map<uint32_t, RsServiceInfo>::const_iterator it = info.mServiceList.find(serviceId);
+
+    if(it == info.mServiceList.end())
+        return false;
+
+    major = it->second.mVersionMajor;
+    minor = it->second.mVersionMinor;
+    return true;
+}
+
 const rstime_t GrpCircleVetting::EXPIRY_PERIOD_OFFSET = 5; // 10 seconds
 const int GrpCircleVetting::GRP_ID_PEND = 1;
 const int GrpCircleVetting::GRP_ITEM_PEND = 2;
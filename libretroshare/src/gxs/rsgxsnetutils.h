@@ -31,6 +31,66 @@
 class p3ServiceControl;
 class PgpAuxUtils;
 
+/*!
+ * Rebuilds the messages sent as several RsNxsMsg fragments while the
+ * fragments arrive. The payload of a message is copied once, at its final
+ * offset, into a buffer allocated when its first fragment is received, and
+ * each fragment is deleted as soon as it is consumed.
+ */
+class NxsMsgReassembler
+{
+public:
+
+    /*!
+     * @param fragmentSize size of all the fragments of a message but the last one
+     * @param maxMsgSize messages announcing more fragments than needed for this size are dropped
+     * @param maxFragments number of items of the transaction. Messages announcing more fragments than
+     *                     the transaction has left are dropped
+     */
+    NxsMsgReassembler(uint32_t fragmentSize, uint32_t maxMsgSize, uint32_t maxFragments);
+    ~NxsMsgReassembler();
+
+    /*!
+     * Consumes a fragment. The fragment is deleted unless it is a whole message.
+     * @param fragment fragment located in its message by its pos and count fields
+     * @param maxReservation the first fragment of a message is dropped if the buffer of the whole
+     *                       message would be larger than this
+     * @return the rebuilt message once all its fragments were received, NULL otherwise
+     */
+    RsNxsMsg* addFragment(RsNxsMsg* fragment, uint64_t maxReservation = ~0ull);
+
+    /*!
+     * @return number of messages still waiting for some fragments
+     */
+    uint32_t pendingCount() const { return mPending.size(); }
+
+    /*!
+     * @return size of the buffers allocated for the messages still waiting for some fragments
+     */
+    uint64_t reservedSize() const { return mReservedSize; }
+
+private:
+
+    NxsMsgReassembler(const NxsMsgReassembler&);
+    NxsMsgReassembler& operator=(const NxsMsgReassembler&);
+
+    struct PendingMsg
+    {
+        RsNxsMsg* mMsg;			// first fragment received, receives the rebuilt payload
+        uint8_t* mData;
+        uint32_t mSize;
+        std::vector<bool> mReceived;
+        uint32_t mNbReceived;
+    };
+
+    std::map<RsGxsMessageId, PendingMsg> mPending;
+    uint32_t mFragmentSize;
+    uint32_t mMaxMsgSize;
+    uint32_t mMaxFragments;
+    uint32_t mAnnouncedFragments;	// fragments of all the messages started so far
+    uint64_t mReservedSize;
+};
+
 /*!
  * This represents a transaction made
  * with the NxsNetService in all states
@@ -52,6 +112,16 @@ public:
     NxsTransaction();
     ~NxsTransaction();
 
+    /*!
+     * Called on the sending side when the peer acknowledges fragments, which means
+     * the transfer is progressing: the timeout is pushed back.
+     * @param nItems number of items the peer says it received
+     * @param now local time
+     * @param timeOut transaction timeout period
+     * @return false if the acknowledgement doesn't match the transaction
+     */
+    bool fragmentsAcknowledged(uint32_t nItems, uint32_t now, uint32_t timeOut);
+
     uint32_t mFlag; // current state of transaction
     uint32_t mTimeOut;
 
@@ -65,6 +135,9 @@ public:
      */
     RsNxsTransacItem* mTransaction;
     std::list<RsNxsItem*> mItems; // items received or sent
+
+    uint32_t mNbReceivedItems; // items received, including the fragments already consumed by mMsgFragments
+    NxsMsgReassembler* mMsgFragments; // messages of an incoming transaction being rebuilt, created with the first fragment
 };
 
 /*!
@@ -82,6 +155,11 @@ public:
     virtual const RsPeerId& getOwnId() = 0;
     virtual void getOnlineList(const uint32_t serviceId, std::set<RsPeerId>& ssl_peers) = 0;
 
+    /*!
+     * Version of the given service advertised by a connected peer.
+     * \return false when the peer did not advertise that service
+     */
+    virtual bool getPeerServiceVersion(const RsPeerId& /*peer*/, const uint32_t /*serviceId*/, uint16_t& /*major*/, uint16_t& /*minor*/) { return false; }
 };
 
 class RsNxsNetMgrImpl : public RsNxsNetMgr
@@ -94,6 +172,7 @@ public:
 
     virtual const RsPeerId& getOwnId();
     virtual void getOnlineList(const uint32_t serviceId, std::set<RsPeerId>& ssl_peers);
+    virtual bool getPeerServiceVersion(const RsPeerId& peer, const uint32_t serviceId, uint16_t& major, uint16_t& minor);
 
 private:
 
@@ -21,6 +21,14 @@
  *                                                                             *
  *******************************************************************************/
 
+#include <algorithm>
+
+#ifdef __linux__
+#	include <sys/resource.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#endif
+
 #include "util/rstime.h"
 
 #include "rsgxsutil.h"
@@ -36,6 +44,10 @@
 #endif
 
 static const uint32_t MAX_GXS_IDS_REQUESTS_NET   =  10 ; // max number of requests from cache/net (avoids killing the system!)
+static const uint32_t INTEGRITY_GRP_BATCH_SIZE   =  20 ; // groups checked between two checkpoints
+static const uint32_t INTEGRITY_MSG_BATCH_SIZE   = 100 ; // messages loaded at once when hashing
+static const uint32_t INTEGRITY_BATCH_PAUSE_MS   =  50 ; // leaves the database to the other threads between batches
+static const uint32_t INTEGRITY_FULL_PASS_PERIOD = 86400*30 ; // every row is hashed again once a month
 
 //#define DEBUG_GXSUTIL 1
 
@@ -138,6 +150,9 @@ bool RsGxsMessageCleanUp::clean()
 
 		mDs->removeMsgs(req);
 
+		for(auto it(req.begin()); it != req.end(); ++it)
+			mDeletedMsgs[it->first].insert(it->second.begin(), it->second.end());
+
 		i++;
 		if(i > CHUNK_SIZE) break;
 	}
@@ -160,6 +175,11 @@ RsGxsIntegrityCheck::RsGxsIntegrityCheck(
 
 void RsGxsIntegrityCheck::run()
 {
+#ifdef __linux__
+	// Linux applies nice values per thread, only this one is slowed down
+	setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+#endif
+
 	check();
 
 	RS_STACK_MUTEX(mIntegrityMutex);
@@ -168,67 +188,189 @@ void RsGxsIntegrityCheck::run()
 
 bool RsGxsIntegrityCheck::check()
 {
-#ifdef RS_DEEP_SEARCH
-	bool isGxsChannels = mGenExchangeClient->serviceType() == RS_SERVICE_GXS_TYPE_CHANNELS;
-	std::set<RsGxsGroupId> indexedGroups;
+	RsGxsIntegrityCheckpoint checkpoint;
+	mDs->retrieveIntegrityCheckpoint(checkpoint);
+
+	uint32_t now = time(NULL);
+
+	if(!checkpoint.mPassStartTS)
+	{
+		checkpoint.mPassStartTS = now;
+		checkpoint.mLastGrpId.clear();
+
+		// forgetting the last pass makes this pass hash every row
+		if(checkpoint.mLastFullPassTS + INTEGRITY_FULL_PASS_PERIOD < now)
+			checkpoint.mLastPassTS = 0;
+	}
+
+#ifdef DEBUG_GXSUTIL
+	GXSUTIL_DEBUG() << "Checking service " << std::hex << mGenExchangeClient->serviceType() << std::dec << " rows received since " << checkpoint.mLastPassTS << ", resuming after group " << checkpoint.mLastGrpId << std::endl;
 #endif
 
-    // first take out all the groups
-    std::map<RsGxsGroupId, RsNxsGrp*> grp;
-    mDs->retrieveNxsGrps(grp, true, true);
-    std::vector<RsGxsGroupId> grpsToDel;
-    GxsMsgReq msgIds;
-    GxsMsgReq grps;
+	std::vector<RsGxsGroupId> grpIds;
+	mDs->retrieveGroupIds(grpIds);
+	std::sort(grpIds.begin(), grpIds.end());
+
+	std::vector<RsGxsGroupId>::const_iterator git = grpIds.begin();
+
+	if(!checkpoint.mLastGrpId.isNull())
+		git = std::upper_bound(grpIds.begin(), grpIds.end(), checkpoint.mLastGrpId);
 
-    std::map<RsGxsId,RsIdentityUsage> used_gxs_ids ;
-    std::set<RsGxsGroupId> subscribed_groups ;
+	std::map<RsGxsId,RsIdentityUsage> used_gxs_ids ;
 
-    // compute hash and compare to stored value, if it fails then simply add it
-	// to list
-	for( std::map<RsGxsGroupId, RsNxsGrp*>::iterator git = grp.begin();
-	     git != grp.end(); ++git )
+	while(git != grpIds.end())
 	{
-		RsNxsGrp* grp = git->second;
-		RsFileHash currHash;
-		pqihash pHash;
-		pHash.addData(grp->grp.bin_data, grp->grp.bin_len);
-		pHash.Complete(currHash);
+		if(shouldStop())
+			return false;	// the checkpoint lets the next run resume from here
+
+		std::vector<RsGxsGroupId>::const_iterator end = git + std::min<size_t>(INTEGRITY_GRP_BATCH_SIZE, grpIds.end() - git);
+		std::vector<RsGxsGroupId> batch(git, end);
+		git = end;
+
+		checkGroups(batch, checkpoint.mLastPassTS, used_gxs_ids);
+
+		checkpoint.mLastGrpId = batch.back();
+		mDs->storeIntegrityCheckpoint(checkpoint);
+
+		rstime::rs_usleep(INTEGRITY_BATCH_PAUSE_MS * 1000);
+	}
+
+	if(!checkpoint.mLastPassTS)
+		checkpoint.mLastFullPassTS = checkpoint.mPassStartTS;
+
+	checkpoint.mLastPassTS = checkpoint.mPassStartTS;
+	checkpoint.mPassStartTS = 0;
+	checkpoint.mLastGrpId.clear();
+	mDs->storeIntegrityCheckpoint(checkpoint);
+
+	// payloads stored out of the database are only released here
+	mDs->removeUnreferencedData();
+
+	{
+		RS_STACK_MUTEX(mIntegrityMutex);
+
+#ifdef DEBUG_GXSUTIL
+		GXSUTIL_DEBUG() << "At end of pass, this is the list used GXS ids: " << std::endl;
+		GXSUTIL_DEBUG() << "  requesting them to GXS identity service to enforce loading." << std::endl;
+#endif
+
+		std::list<RsPeerId> connected_friends ;
+		rsPeers->getOnlineList(connected_friends) ;
+
+		std::vector<std::pair<RsGxsId,RsIdentityUsage> > gxs_ids ;
+
+		for(std::map<RsGxsId,RsIdentityUsage>::const_iterator it(used_gxs_ids.begin());it!=used_gxs_ids.end();++it)
+		{
+			gxs_ids.push_back(*it) ;
+#ifdef DEBUG_GXSUTIL
+			GXSUTIL_DEBUG() << "    " << it->first <<  std::endl;
+#endif
+		}
+		uint32_t nb_requested_not_in_cache = 0;
+
+#ifdef DEBUG_GXSUTIL
+		GXSUTIL_DEBUG() << "  issuing random get on friends for non existing IDs" << std::endl;
+#endif
+
+		// now request a cache update for them, which triggers downloading from friends, if missing.
 
-		if(currHash == grp->metaData->mHash)
+		for(;nb_requested_not_in_cache<MAX_GXS_IDS_REQUESTS_NET && !gxs_ids.empty();)
 		{
-			// get all message ids of group
-			if (mDs->retrieveMsgIds(grp->grpId, msgIds[grp->grpId]) == 1)
+			uint32_t n = RSRandom::random_u32() % gxs_ids.size() ;
+#ifdef DEBUG_GXSUTIL
+			GXSUTIL_DEBUG() << "    requesting ID " << gxs_ids[n].first ;
+#endif
+
+			if(!mGixs->haveKey(gxs_ids[n].first))	// checks if we have it already in the cache (conservative way to ensure that we atually have it)
 			{
-				// store the group for retrieveNxsMsgs
-				grps[grp->grpId];
+				mGixs->requestKey(gxs_ids[n].first,connected_friends,gxs_ids[n].second);
 
-				if(grp->metaData->mSubscribeFlags & GXS_SERV::GROUP_SUBSCRIBE_SUBSCRIBED)
-				{
-					subscribed_groups.insert(git->first);
+				++nb_requested_not_in_cache ;
+#ifdef DEBUG_GXSUTIL
+				GXSUTIL_DEBUG() << "  ... from cache/net" << std::endl;
+#endif
+			}
+			else
+			{
+#ifdef DEBUG_GXSUTIL
+				GXSUTIL_DEBUG() << "  ... already in cache" << std::endl;
+#endif
+			}
+			mGixs->timeStampKey(gxs_ids[n].first,gxs_ids[n].second);
 
-					if(!grp->metaData->mAuthorId.isNull())
-					{
+			gxs_ids[n] = gxs_ids[gxs_ids.size()-1] ;
+			gxs_ids.pop_back() ;
+		}
 #ifdef DEBUG_GXSUTIL
-						GXSUTIL_DEBUG() << "TimeStamping group authors' key ID " << grp->metaData->mAuthorId << " in group ID " << grp->grpId << std::endl;
+		GXSUTIL_DEBUG() << "  total actual cache requests: "<< nb_requested_not_in_cache << std::endl;
 #endif
-						if( rsReputations &&
-						        rsReputations->overallReputationLevel(
-						            grp->metaData->mAuthorId ) >
-						        RsReputationLevel::LOCALLY_NEGATIVE )
-							used_gxs_ids.insert(std::make_pair(grp->metaData->mAuthorId, RsIdentityUsage(mGenExchangeClient->serviceType(), RsIdentityUsage::GROUP_AUTHOR_KEEP_ALIVE,grp->grpId)));
-					}
-				}
+	}
+
+    return true;
+}
+
+void RsGxsIntegrityCheck::checkGroups(
+        const std::vector<RsGxsGroupId>& grpIds, uint32_t changedSince,
+        std::map<RsGxsId,RsIdentityUsage>& used_gxs_ids )
+{
+#ifdef RS_DEEP_SEARCH
+	bool isGxsChannels = mGenExchangeClient->serviceType() == RS_SERVICE_GXS_TYPE_CHANNELS;
+#endif
+
+	// meta data are cheap and come from the cache, data is only loaded for
+	// the groups which changed since the last pass
+	RsGxsGrpMetaTemporaryMap grpMetas;
+	RsNxsGrpDataTemporaryMap changedGrps;
+
+	for(uint32_t i=0;i<grpIds.size();++i)
+		grpMetas[grpIds[i]] = NULL;
+
+	mDs->retrieveGxsGrpMetaData(grpMetas);
+
+	for(RsGxsGrpMetaTemporaryMap::const_iterator mit = grpMetas.begin(); mit != grpMetas.end(); ++mit)
+		if(mit->second && mit->second->mRecvTS >= changedSince)
+			changedGrps[mit->first] = NULL;
+
+	if(!changedGrps.empty())
+		mDs->retrieveNxsGrps(changedGrps, true, false);
+
+	std::vector<RsGxsGroupId> grpsToDel;
+	GxsMsgReq msgsToDel;
+
+	for(RsGxsGrpMetaTemporaryMap::const_iterator mit = grpMetas.begin(); mit != grpMetas.end(); ++mit)
+	{
+		const RsGxsGrpMetaData* meta = mit->second;
+
+		if(!meta)
+			continue;
+
+		const RsGxsGroupId& grpId = mit->first;
+		bool subscribed = meta->mSubscribeFlags & GXS_SERV::GROUP_SUBSCRIBE_SUBSCRIBED;
+
+		RsNxsGrpDataTemporaryMap::const_iterator cit = changedGrps.find(grpId);
+
+		if(cit != changedGrps.end() && cit->second)
+		{
+			RsNxsGrp* grp = cit->second;
+			RsFileHash currHash;
+			pqihash pHash;
+			pHash.addData(grp->grp.bin_data, grp->grp.bin_len);
+			pHash.Complete(currHash);
+
+			if(currHash != grp->metaData->mHash)
+			{
+				grpsToDel.push_back(grpId);
+#ifdef RS_DEEP_SEARCH
+				if(isGxsChannels) DeepSearch::removeChannelFromIndex(grpId);
+#endif
+				continue;
 			}
-			else msgIds.erase(msgIds.find(grp->grpId));
 
 #ifdef RS_DEEP_SEARCH
 			if( isGxsChannels
-			        && grp->metaData->mCircleType == GXS_CIRCLE_TYPE_PUBLIC
-			        && grp->metaData->mSubscribeFlags & GXS_SERV::GROUP_SUBSCRIBE_SUBSCRIBED )
+			        && meta->mCircleType == GXS_CIRCLE_TYPE_PUBLIC
+			        && subscribed )
 			{
-				RsGxsGrpMetaData meta;
-				meta.deserialise(grp->meta.bin_data, grp->meta.bin_len);
-
 				uint32_t blz = grp->grp.bin_len;
 				RsItem* rIt = mSerializer.deserialise(grp->grp.bin_data,
 				                                      &blz);
@@ -238,16 +380,15 @@ bool RsGxsIntegrityCheck::check()
 				{
 					RsGxsChannelGroup cg;
 					cgIt->toChannelGroup(cg, false);
-					cg.mMeta = meta;
+					cg.mMeta = *meta;
 
-					indexedGroups.insert(grp->grpId);
 					DeepSearch::indexChannelGroup(cg);
 				}
 				else
 				{
 					std::cerr << __PRETTY_FUNCTION__ << " Group: "
-					          << meta.mGroupId.toStdString() << " "
-					          << meta.mGroupName
+					          << meta->mGroupId.toStdString() << " "
+					          << meta->mGroupName
 					          << " doesn't seems a channel, please "
 					          << "report to developers"
 					          << std::endl;
@@ -258,228 +399,195 @@ bool RsGxsIntegrityCheck::check()
 			}
 #endif
 		}
-		else
-		{
-			grpsToDel.push_back(grp->grpId);
-#ifdef RS_DEEP_SEARCH
-			if(isGxsChannels) DeepSearch::removeChannelFromIndex(grp->grpId);
-#endif
-		}
 
-		if( !(grp->metaData->mSubscribeFlags & GXS_SERV::GROUP_SUBSCRIBE_SUBSCRIBED) &&
-		        !(grp->metaData->mSubscribeFlags & GXS_SERV::GROUP_SUBSCRIBE_ADMIN) &&
-		        !(grp->metaData->mSubscribeFlags & GXS_SERV::GROUP_SUBSCRIBE_PUBLISH) )
+		if( !subscribed &&
+		        !(meta->mSubscribeFlags & GXS_SERV::GROUP_SUBSCRIBE_ADMIN) &&
+		        !(meta->mSubscribeFlags & GXS_SERV::GROUP_SUBSCRIBE_PUBLISH) )
 		{
 			RsGroupNetworkStats stats;
-			mGenExchangeClient->getGroupNetworkStats(grp->grpId,stats);
+			mGenExchangeClient->getGroupNetworkStats(grpId,stats);
 
 			if( stats.mSuppliers == 0 && stats.mMaxVisibleCount == 0
 			        && stats.mGrpAutoSync )
 			{
 #ifdef DEBUG_GXSUTIL
-				GXSUTIL_DEBUG() << "Scheduling group \"" << grp->metaData->mGroupName << "\" ID=" << grp->grpId << " in service " << std::hex << mGenExchangeClient->serviceType() << std::dec << " for deletion because it has no suppliers not any visible data at friends." << std::endl;
+				GXSUTIL_DEBUG() << "Scheduling group \"" << meta->mGroupName << "\" ID=" << grpId << " in service " << std::hex << mGenExchangeClient->serviceType() << std::dec << " for deletion because it has no suppliers not any visible data at friends." << std::endl;
 #endif
-				grpsToDel.push_back(grp->grpId);
+				grpsToDel.push_back(grpId);
+				continue;
 			}
 		}
 
-		delete grp;
-	}
-
-    mDs->removeGroups(grpsToDel);
-
-    // now messages
-    GxsMsgReq msgsToDel;
-    GxsMsgResult msgs;
-
-    mDs->retrieveNxsMsgs(grps, msgs, false, true);
-
-    // check msg ids and messages
-    GxsMsgReq::iterator msgIdsIt;
-    for (msgIdsIt = msgIds.begin(); msgIdsIt != msgIds.end(); ++msgIdsIt)
-    {
-	    const RsGxsGroupId& grpId = msgIdsIt->first;
-	    std::set<RsGxsMessageId> &msgIdV = msgIdsIt->second;
-
-	    std::set<RsGxsMessageId>::iterator msgIdIt;
-	    for (msgIdIt = msgIdV.begin(); msgIdIt != msgIdV.end(); ++msgIdIt)
-	    {
-		    const RsGxsMessageId& msgId = *msgIdIt;
-		    std::vector<RsNxsMsg*> &nxsMsgV = msgs[grpId];
-
-		    std::vector<RsNxsMsg*>::iterator nxsMsgIt;
-		    for (nxsMsgIt = nxsMsgV.begin(); nxsMsgIt != nxsMsgV.end(); ++nxsMsgIt)
-		    {
-			    RsNxsMsg *nxsMsg = *nxsMsgIt;
-			    if (nxsMsg && msgId == nxsMsg->msgId)
-			    {
-				    break;
-			    }
-		    }
-
-		    if (nxsMsgIt == nxsMsgV.end())
-			{
-				msgsToDel[grpId].insert(msgId);
-#ifdef RS_DEEP_SEARCH
-				if(isGxsChannels)
-					DeepSearch::removeChannelPostFromIndex(grpId, msgId);
+		if(subscribed && !meta->mAuthorId.isNull())
+		{
+#ifdef DEBUG_GXSUTIL
+			GXSUTIL_DEBUG() << "TimeStamping group authors' key ID " << meta->mAuthorId << " in group ID " << grpId << std::endl;
 #endif
-		    }
-	    }
-    }
+			if( rsReputations &&
+			        rsReputations->overallReputationLevel(
+			            meta->mAuthorId ) >
+			        RsReputationLevel::LOCALLY_NEGATIVE )
+				used_gxs_ids.insert(std::make_pair(meta->mAuthorId, RsIdentityUsage(mGenExchangeClient->serviceType(), RsIdentityUsage::GROUP_AUTHOR_KEEP_ALIVE,grpId)));
+		}
 
-	GxsMsgResult::iterator mit = msgs.begin();
-	for(; mit != msgs.end(); ++mit)
-	{
-		std::vector<RsNxsMsg*>& msgV = mit->second;
-		std::vector<RsNxsMsg*>::iterator vit = msgV.begin();
+		// now messages, the meta data of the whole group is small enough
+		GxsMsgReq req;
+		GxsMsgMetaResult msgMetas;
+		req[grpId];
+		mDs->retrieveGxsMsgMetaData(req, msgMetas);
+
+		std::vector<RsGxsMsgMetaData*>& metaV = msgMetas[grpId];
+		std::set<RsGxsMessageId> changedMsgs;
 
-		for(; vit != msgV.end(); ++vit)
+		for(uint32_t i=0;i<metaV.size();++i)
 		{
-			RsNxsMsg* msg = *vit;
-			RsFileHash currHash;
-			pqihash pHash;
-			pHash.addData(msg->msg.bin_data, msg->msg.bin_len);
-			pHash.Complete(currHash);
+			RsGxsMsgMetaData* msgMeta = metaV[i];
+
+			if(msgMeta->recvTS >= changedSince)
+				changedMsgs.insert(msgMeta->mMsgId);
 
-			if(msg->metaData == NULL || currHash != msg->metaData->mHash)
+			if(subscribed && !msgMeta->mAuthorId.isNull())
 			{
-				std::cerr << __PRETTY_FUNCTION__ <<" (EE) deleting message data"
-				          << " with wrong hash or null meta data. meta="
-				          << (void*)msg->metaData << std::endl;
-				msgsToDel[msg->grpId].insert(msg->msgId);
-#ifdef RS_DEEP_SEARCH
-				if(isGxsChannels)
-					DeepSearch::removeChannelPostFromIndex(msg->grpId, msg->msgId);
+#ifdef DEBUG_GXSUTIL
+				GXSUTIL_DEBUG() << "TimeStamping message authors' key ID " << msgMeta->mAuthorId << " in message " << msgMeta->mMsgId << ", group ID " << grpId << std::endl;
 #endif
+				if( rsReputations &&
+				        rsReputations->overallReputationLevel(
+				            msgMeta->mAuthorId ) >
+				        RsReputationLevel::LOCALLY_NEGATIVE )
+					used_gxs_ids.insert(std::make_pair(msgMeta->mAuthorId,RsIdentityUsage(mGenExchangeClient->serviceType(),RsIdentityUsage::MESSAGE_AUTHOR_KEEP_ALIVE,grpId,msgMeta->mMsgId))) ;
 			}
-			else if (subscribed_groups.count(msg->metaData->mGroupId))
-			{
+
+			delete msgMeta;
+		}
+		metaV.clear();
+
+		// Rows received before the last pass are not hashed again, but their payload may have gone
+		// missing since then. Checking that it is still there is cheap, and it lets them be re-synced.
+		std::set<RsGxsMessageId> noDataMsgs;
+		mDs->retrieveMsgIdsWithoutData(grpId, noDataMsgs);
+		changedMsgs.insert(noDataMsgs.begin(), noDataMsgs.end());
+
+		bool indexPosts = false;
 #ifdef RS_DEEP_SEARCH
-				if( isGxsChannels
-				        && indexedGroups.count(msg->metaData->mGroupId) )
-				{
-					RsGxsMsgMetaData meta;
-					meta.deserialise(msg->meta.bin_data, &msg->meta.bin_len);
-
-					uint32_t blz = msg->msg.bin_len;
-					RsItem* rIt = mSerializer.deserialise(msg->msg.bin_data,
-					                                      &blz);
-
-					if( RsGxsChannelPostItem* cgIt =
-					        dynamic_cast<RsGxsChannelPostItem*>(rIt) )
-					{
-						RsGxsChannelPost cg;
-						cgIt->toChannelPost(cg, false);
-						cg.mMeta = meta;
-
-						DeepSearch::indexChannelPost(cg);
-					}
-					else if(dynamic_cast<RsGxsCommentItem*>(rIt)) {}
-					else if(dynamic_cast<RsGxsVoteItem*>(rIt)) {}
-					else
-					{
-						std::cerr << __PRETTY_FUNCTION__ << " Message: "
-						          << meta.mMsgId.toStdString()
-						          << " in group: "
-						          << meta.mGroupId.toStdString() << " "
-						          << " doesn't seems a channel post, please "
-						          << "report to developers"
-						          << std::endl;
-						print_stacktrace();
-					}
-
-					delete rIt;
-				}
+		indexPosts = isGxsChannels && subscribed
+		        && meta->mCircleType == GXS_CIRCLE_TYPE_PUBLIC;
 #endif
 
-				if(!msg->metaData->mAuthorId.isNull())
-				{
-#ifdef DEBUG_GXSUTIL
-					GXSUTIL_DEBUG() << "TimeStamping message authors' key ID " << msg->metaData->mAuthorId << " in message " << msg->msgId << ", group ID " << msg->grpId<< std::endl;
-#endif
-					if( rsReputations &&
-					        rsReputations->overallReputationLevel(
-					            msg->metaData->mAuthorId ) >
-					        RsReputationLevel::LOCALLY_NEGATIVE )
-						used_gxs_ids.insert(std::make_pair(msg->metaData->mAuthorId,RsIdentityUsage(mGenExchangeClient->serviceType(),RsIdentityUsage::MESSAGE_AUTHOR_KEEP_ALIVE,msg->metaData->mGroupId,msg->metaData->mMsgId))) ;
-				}
+		std::set<RsGxsMessageId> msgBatch;
+
+		for(std::set<RsGxsMessageId>::const_iterator it = changedMsgs.begin(); it != changedMsgs.end(); ++it)
+		{
+			msgBatch.insert(*it);
+
+			if(msgBatch.size() >= INTEGRITY_MSG_BATCH_SIZE)
+			{
+				checkMsgs(grpId, msgBatch, indexPosts, msgsToDel);
+				msgBatch.clear();
 			}
+		}
 
-		    delete msg;
-	    }
-    }
+		if(!msgBatch.empty())
+			checkMsgs(grpId, msgBatch, indexPosts, msgsToDel);
+	}
 
-    mDs->removeMsgs(msgsToDel);
+	if(!grpsToDel.empty())
+		mDs->removeGroups(grpsToDel);
 
-	{
-		RS_STACK_MUTEX(mIntegrityMutex);
+	if(!msgsToDel.empty())
+		mDs->removeMsgs(msgsToDel);
 
-		std::vector<RsGxsGroupId>::iterator grpIt;
-		for(grpIt = grpsToDel.begin(); grpIt != grpsToDel.end(); ++grpIt)
-		{
-			mDeletedGrps.push_back(*grpIt);
-		}
-		mDeletedMsgs = msgsToDel;
+	RS_STACK_MUTEX(mIntegrityMutex);
 
-#ifdef DEBUG_GXSUTIL
-		GXSUTIL_DEBUG() << "At end of pass, this is the list used GXS ids: " << std::endl;
-		GXSUTIL_DEBUG() << "  requesting them to GXS identity service to enforce loading." << std::endl;
+	mDeletedGrps.insert(mDeletedGrps.end(), grpsToDel.begin(), grpsToDel.end());
+
+	for(GxsMsgReq::const_iterator it = msgsToDel.begin(); it != msgsToDel.end(); ++it)
+		mDeletedMsgs[it->first].insert(it->second.begin(), it->second.end());
+}
+
+void RsGxsIntegrityCheck::checkMsgs(
+        const RsGxsGroupId& grpId, const std::set<RsGxsMessageId>& msgIds,
+        bool
+#ifdef RS_DEEP_SEARCH
+             indexPosts
 #endif
+                       , GxsMsgReq& msgsToDel )
+{
+	GxsMsgReq req;
+	req[grpId] = msgIds;
 
-		std::list<RsPeerId> connected_friends ;
-		rsPeers->getOnlineList(connected_friends) ;
+	RsNxsMsgDataTemporaryMap msgs;
+	mDs->retrieveNxsMsgs(req, msgs, false, true);
 
-		std::vector<std::pair<RsGxsId,RsIdentityUsage> > gxs_ids ;
+	std::vector<RsNxsMsg*>& msgV = msgs[grpId];
+	std::set<RsGxsMessageId> missing = msgIds;
 
-		for(std::map<RsGxsId,RsIdentityUsage>::const_iterator it(used_gxs_ids.begin());it!=used_gxs_ids.end();++it)
+	for(uint32_t i=0;i<msgV.size();++i)
+	{
+		RsNxsMsg* msg = msgV[i];
+		missing.erase(msg->msgId);
+
+		RsFileHash currHash;
+		pqihash pHash;
+		pHash.addData(msg->msg.bin_data, msg->msg.bin_len);
+		pHash.Complete(currHash);
+
+		if(msg->metaData == NULL || currHash != msg->metaData->mHash)
 		{
-			gxs_ids.push_back(*it) ;
-#ifdef DEBUG_GXSUTIL
-			GXSUTIL_DEBUG() << "    " << it->first <<  std::endl;
+			std::cerr << __PRETTY_FUNCTION__ <<" (EE) deleting message data"
+			          << " with wrong hash or null meta data. meta="
+			          << (void*)msg->metaData << std::endl;
+			msgsToDel[grpId].insert(msg->msgId);
+#ifdef RS_DEEP_SEARCH
+			if(indexPosts)
+				DeepSearch::removeChannelPostFromIndex(grpId, msg->msgId);
 #endif
+			continue;
 		}
-		uint32_t nb_requested_not_in_cache = 0;
-
-#ifdef DEBUG_GXSUTIL
-		GXSUTIL_DEBUG() << "  issuing random get on friends for non existing IDs" << std::endl;
-#endif
-
-		// now request a cache update for them, which triggers downloading from friends, if missing.
 
-		for(;nb_requested_not_in_cache<MAX_GXS_IDS_REQUESTS_NET && !gxs_ids.empty();)
+#ifdef RS_DEEP_SEARCH
+		if(indexPosts)
 		{
-			uint32_t n = RSRandom::random_u32() % gxs_ids.size() ;
-#ifdef DEBUG_GXSUTIL
-			GXSUTIL_DEBUG() << "    requesting ID " << gxs_ids[n].first ;
-#endif
+			uint32_t blz = msg->msg.bin_len;
+			RsItem* rIt = mSerializer.deserialise(msg->msg.bin_data, &blz);
 
-			if(!mGixs->haveKey(gxs_ids[n].first))	// checks if we have it already in the cache (conservative way to ensure that we atually have it)
+			if( RsGxsChannelPostItem* cgIt =
+			        dynamic_cast<RsGxsChannelPostItem*>(rIt) )
 			{
-				mGixs->requestKey(gxs_ids[n].first,connected_friends,gxs_ids[n].second);
+				RsGxsChannelPost cg;
+				cgIt->toChannelPost(cg, false);
+				cg.mMeta = *msg->metaData;
 
-				++nb_requested_not_in_cache ;
-#ifdef DEBUG_GXSUTIL
-				GXSUTIL_DEBUG() << "  ... from cache/net" << std::endl;
-#endif
+				DeepSearch::indexChannelPost(cg);
 			}
+			else if(dynamic_cast<RsGxsCommentItem*>(rIt)) {}
+			else if(dynamic_cast<RsGxsVoteItem*>(rIt)) {}
 			else
 			{
-#ifdef DEBUG_GXSUTIL
-				GXSUTIL_DEBUG() << "  ... already in cache" << std::endl;
-#endif
+				std::cerr << __PRETTY_FUNCTION__ << " Message: "
+				          << msg->msgId.toStdString()
+				          << " in group: "
+				          << grpId.toStdString() << " "
+				          << " doesn't seems a channel post, please "
+				          << "report to developers"
+				          << std::endl;
+				print_stacktrace();
 			}
-			mGixs->timeStampKey(gxs_ids[n].first,gxs_ids[n].second);
 
-			gxs_ids[n] = gxs_ids[gxs_ids.size()-1] ;
-			gxs_ids.pop_back() ;
+			delete rIt;
 		}
-#ifdef DEBUG_GXSUTIL
-		GXSUTIL_DEBUG() << "  total actual cache requests: "<< nb_requested_not_in_cache << std::endl;
 #endif
 	}
 
-    return true;
+	// rows whose data could not be read back at all
+	for(std::set<RsGxsMessageId>::const_iterator it = missing.begin(); it != missing.end(); ++it)
+	{
+		msgsToDel[grpId].insert(*it);
+#ifdef RS_DEEP_SEARCH
+		if(indexPosts)
+			DeepSearch::removeChannelPostFromIndex(grpId, *it);
+#endif
+	}
 }
 
 bool RsGxsIntegrityCheck::isDone()
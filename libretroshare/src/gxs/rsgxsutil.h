@@ -30,6 +30,7 @@
 class RsGixs ;
 class RsGenExchange ;
 class RsGeneralDataService ;
+struct RsIdentityUsage ;
 
 // temporary holds a map of pointers to class T, and destroys all pointers on delete.
 
@@ -166,6 +167,11 @@ public:
 	 */
 	bool clean();
 
+	/*!
+	 * @param msgIds messages removed by the clean() calls made so far
+	 */
+	void getDeletedIds(GxsMsgReq& msgIds) const { msgIds = mDeletedMsgs; }
+
 	/*!
 	 * TODO: Rather than manual progressions consider running through a thread
 	 */
@@ -177,11 +183,16 @@ private:
     RsGenExchange *mGenExchangeClient;
 	uint32_t CHUNK_SIZE;
 	std::vector<const RsGxsGrpMetaData*> mGrpMeta;
+	GxsMsgReq mDeletedMsgs;
 };
 
 /*!
  * Checks the integrity message and groups
- * in rsDataService using computed hash
+ * in rsDataService using computed hash.
+ * Groups are walked by bounded batches, and only the rows received since the
+ * last completed pass have their data loaded and hashed. The progress is
+ * stored in the data service after each batch, so that a pass interrupted by
+ * a shutdown resumes from the last checked group.
  */
 class RsGxsIntegrityCheck : public RsSingleJobThread
 {
@@ -211,6 +222,25 @@ public:
 
 private:
 
+	/*!
+	 * Checks a batch of groups and their messages, and removes the ones
+	 * which are corrupted or not wanted anymore
+	 * @param grpIds groups to check
+	 * @param changedSince only rows received after this time are hashed
+	 * @param used_gxs_ids collects the identities in use
+	 */
+	void checkGroups( const std::vector<RsGxsGroupId>& grpIds,
+	                  uint32_t changedSince,
+	                  std::map<RsGxsId,RsIdentityUsage>& used_gxs_ids );
+
+	/*!
+	 * Hashes a batch of messages of a group, and adds the corrupted ones to
+	 * \p msgsToDel
+	 */
+	void checkMsgs( const RsGxsGroupId& grpId,
+	                const std::set<RsGxsMessageId>& msgIds, bool indexPosts,
+	                GxsMsgReq& msgsToDel );
+
 	RsGeneralDataService* const mDs;
 	RsGenExchange *mGenExchangeClient;
 #ifdef RS_DEEP_SEARCH
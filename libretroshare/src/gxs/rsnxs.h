@@ -229,6 +229,14 @@ public:
      */
     virtual bool stampMsgServerUpdateTS(const RsGxsGroupId& gid) =0;
 
+    /*!
+     * \brief announceNewMessages
+     * 		Called when new messages have been validated and stored, so that they can be pushed to the
+     * 		friends that supply these groups without waiting for the next sync round.
+     * \param msgIds ids of the new messages, per group
+     */
+    virtual void announceNewMessages(const GxsMsgReq& msgIds) =0;
+
     /*!
      * \brief isDistantPeer
      * \param pid		peer that is a virtual peer provided by GxsNetTunnel
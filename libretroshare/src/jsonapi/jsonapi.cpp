@@ -26,6 +26,16 @@
 #include <restbed>
 #include <vector>
 #include <openssl/crypto.h>
+#include <thread>
+#include <algorithm>
+
+#ifdef HAS_RAPIDJSON
+#	include <rapidjson/writer.h>
+#	include <rapidjson/prettywriter.h>
+#else
+#	include <rapid_json/writer.h>
+#	include <rapid_json/prettywriter.h>
+#endif // HAS_RAPIDJSON
 
 #include "util/rsjson.h"
 #include "retroshare/rsfiles.h"
@@ -86,14 +96,64 @@ JsonApiServer::corsOptionsHeaders =
 	    jAns.AddMember(kcd, jReq[kcd], jAns.GetAllocator())
 
 #define DEFAULT_API_CALL_JSON_RETURN(RET_CODE) \
-	std::stringstream ss; \
-	ss << jAns; \
-	std::string&& ans(ss.str()); \
+	rb::Bytes ans; \
+	rsJsonPrettyWrite(jAns, ans); \
 	auto headers = corsHeaders; \
 	headers.insert({ "Content-Type", "text/json" }); \
-	headers.insert({ "Content-Length", std::to_string(ans.length()) }); \
+	headers.insert({ "Content-Length", std::to_string(ans.size()) }); \
 	session->close(RET_CODE, ans, headers)
 
+/* Streaming counterpart of DEFAULT_API_CALL_JSON_RETURN, each answer member is
+ * written into the answer bytes as soon as it is serialized, without building
+ * the whole answer Document first. Members already in jAns (like caller_data)
+ * are written at the beginning, after PREFIX. WRITER is the rapidjson writer
+ * template to use, rapidjson::PrettyWriter for plain answers and
+ * rapidjson::Writer for event stream messages which must fit in one line. */
+#define STREAMING_API_CALL_JSON_BEGIN(WRITER, PREFIX) \
+	const std::string jPrefix(PREFIX); \
+	rb::Bytes ans(jPrefix.begin(), jPrefix.end()); \
+	RsJsonByteStream ansStream(ans); \
+	typedef WRITER<RsJsonByteStream> JsonApiWriter; \
+	JsonApiWriter jWriter(ansStream); \
+	bool jStreamOk = true; \
+	jWriter.StartObject(); \
+	for(auto& jMember : jAns.GetObject()) \
+	{ \
+		jWriter.Key( jMember.name.GetString(), \
+		             jMember.name.GetStringLength() ); \
+		jMember.value.Accept(jWriter); \
+	}
+
+#define RS_JSON_STREAM_PROCESS(MEMBER) \
+	jStreamOk = RsTypeSerializer::to_JSON_stream( \
+	            jWriter, MEMBER, #MEMBER, cAns.mFlags ) && jStreamOk
+
+/* If some member failed to serialize the partially written answer is replaced
+ * by one carrying only jsonApiError, so the caller never get incomplete data
+ * looking like a successful answer. */
+#define STREAMING_API_CALL_JSON_END \
+	jWriter.EndObject(); \
+	if(!jStreamOk) \
+	{ \
+		std::string jsonApiError = __PRETTY_FUNCTION__; \
+		jsonApiError += " failed to serialize answer to JSON"; \
+		std::cerr << jsonApiError << std::endl; \
+		RsGenericSerializer::SerializeContext& ctx(cAns); \
+		RsGenericSerializer::SerializeJob j(RsGenericSerializer::TO_JSON); \
+		RS_SERIAL_PROCESS(jsonApiError); \
+		ans.resize(jPrefix.size()); \
+		JsonApiWriter eWriter(ansStream); \
+		jAns.Accept(eWriter); \
+	}
+
+#define STREAMING_API_CALL_JSON_RETURN(RET_CODE) \
+	STREAMING_API_CALL_JSON_END; \
+	auto headers = corsHeaders; \
+	headers.insert({ "Content-Type", "text/json" }); \
+	headers.insert({ "Content-Length", std::to_string(ans.size()) }); \
+	session->close( jStreamOk ? RET_CODE : rb::INTERNAL_SERVER_ERROR, \
+	                ans, headers )
+
 
 /*static*/ bool JsonApiServer::checkRsServicePtrReady(
         const void* serviceInstance, const std::string& serviceName,
@@ -116,8 +176,10 @@ JsonApiServer::corsOptionsHeaders =
 }
 
 JsonApiServer::JsonApiServer(uint16_t port, const std::string& bindAddress,
-        const std::function<bool(const std::string&)> newAccessRequestCallback ) :
+        const std::function<bool(const std::string&)> newAccessRequestCallback,
+        uint32_t workerThreads ) :
     mPort(port), mBindAddress(bindAddress),
+    mWorkerThreads(workerThreads ? workerThreads : defaultWorkerThreads()),
     mNewAccessRequestCallback(newAccessRequestCallback),
     configMutex("JsonApiServer config")
 {
@@ -347,6 +409,7 @@ void JsonApiServer::run()
 	settings->set_port(mPort);
 	settings->set_bind_address(mBindAddress);
 	settings->set_default_header("Cache-Control", "no-cache");
+	settings->set_worker_limit(mWorkerThreads);
 
 	{
 		sockaddr_storage tmp;
@@ -357,6 +420,7 @@ void JsonApiServer::run()
 		tmpUrl.setScheme("http");
 
 		std::cerr << "JSON API listening on " << tmpUrl.toString()
+		          << " with " << mWorkerThreads << " worker threads"
 		          << std::endl;
 	}
 
@@ -481,6 +545,14 @@ bool JsonApiServer::authorizeToken(const std::string& token)
 	return false;
 }
 
+/*static*/ uint32_t JsonApiServer::defaultWorkerThreads()
+{
+	/* hardware_concurrency() may return 0 if the value is not computable, at
+	 * least two workers so a slow call doesn't stall every other client */
+	uint32_t hwThreads = std::thread::hardware_concurrency();
+	return std::min(std::max(hwThreads, 2u), 8u);
+}
+
 /*static*/ std::string JsonApiServer::decodeToken(const std::string& token)
 {
 	std::vector<uint8_t> decodedVect(Radix64::decode(token));
@@ -60,11 +60,14 @@ struct JsonApiServer : RsSingleJobThread, p3Config
 	 *	be authorized via JSON API, the auth token is passed as parameter, and
 	 *	the callback should return true if the new token get access granted and
 	 *	false otherwise, this usually requires user interacion to confirm access
+	 * @param[in] workerThreads number of threads serving API requests
+	 *	concurrently, 0 means use defaultWorkerThreads()
 	 */
 	JsonApiServer(
 	        uint16_t port = 9092,
 	        const std::string& bindAddress = "127.0.0.1",
-	        const std::function<bool(const std::string&)> newAccessRequestCallback = [](const std::string&){return false;} );
+	        const std::function<bool(const std::string&)> newAccessRequestCallback = [](const std::string&){return false;},
+	        uint32_t workerThreads = 0 );
 
 	/**
 	 * @param[in] path Path itno which publish the API call
@@ -165,6 +168,13 @@ struct JsonApiServer : RsSingleJobThread, p3Config
 	static void version( uint32_t& major, uint32_t& minor, uint32_t& mini,
 	                     std::string& extra, std::string&human );
 
+	/**
+	 * @brief Get default number of worker threads, based on the number of
+	 *	available CPU cores
+	 * @return number of worker threads
+	 */
+	static uint32_t defaultWorkerThreads();
+
 	/// @see RsSingleJobThread
 	virtual void run();
 
@@ -183,6 +193,7 @@ private:
 
 	const uint16_t mPort;
 	const std::string mBindAddress;
+	const uint32_t mWorkerThreads;
 	rb::Service mService;
 
 	/// Called when new JSON API auth token is requested to be authorized
@@ -403,6 +403,7 @@ HEADERS +=	pqi/authssl.h \
 			pqi/pqithreadstreamer.h \
 			pqi/pqiqosstreamer.h \
 			pqi/sslfns.h \
+			pqi/sslsessioncache.h \
 			pqi/pqinetstatebox.h \
 			pqi/p3servicecontrol.h \
 
@@ -464,6 +465,7 @@ HEADERS +=  services/autoproxy/p3i2pbob.h \
             services/rseventsservice.h \
             services/autoproxy/rsautoproxymonitor.h \
             services/p3msgservice.h \
+            services/msgmailboxstore.h \
 			services/p3service.h \
 			services/p3statusservice.h \
 			services/p3banlist.h \
@@ -476,7 +478,8 @@ HEADERS +=  services/autoproxy/p3i2pbob.h \
 HEADERS +=	turtle/p3turtle.h \
 			turtle/rsturtleitem.h \
 			turtle/turtletypes.h \
-			turtle/turtleclientservice.h
+			turtle/turtleclientservice.h \
+			turtle/turtlehashfilter.h
 
 HEADERS +=	util/folderiterator.h \
 			util/rsdebug.h \
@@ -495,6 +498,7 @@ HEADERS +=	util/folderiterator.h \
 			util/rsstring.h \
 			util/rsstd.h \
 			util/rsthreads.h \
+			util/rsworkerpool.h \
 			util/rswin.h \
 			util/rsrandom.h \
 			util/rsmemcache.h \
@@ -559,6 +563,7 @@ SOURCES +=	pqi/authgpg.cc \
 			pqi/pqithreadstreamer.cc \
 			pqi/pqiqosstreamer.cc \
 			pqi/sslfns.cc \
+			pqi/sslsessioncache.cc \
 			pqi/pqinetstatebox.cc \
                         pqi/p3servicecontrol.cc
 
@@ -612,6 +617,7 @@ SOURCES +=  services/autoproxy/rsautoproxymonitor.cc \
     services/rseventsservice.cc \
             services/autoproxy/p3i2pbob.cc \
             services/p3msgservice.cc \
+            services/msgmailboxstore.cc \
 			services/p3service.cc \
 			services/p3statusservice.cc \
 			services/p3banlist.cc \
@@ -622,7 +628,8 @@ SOURCES +=  services/autoproxy/rsautoproxymonitor.cc \
 			services/p3serviceinfo.cc \
 
 SOURCES +=	turtle/p3turtle.cc \
-                                turtle/rsturtleitem.cc
+                                turtle/rsturtleitem.cc \
+                                turtle/turtlehashfilter.cc
 
 SOURCES +=	util/folderiterator.cc \
 			util/rsdebug.cc \
@@ -638,6 +645,7 @@ SOURCES +=	util/folderiterator.cc \
 			util/rsprint.cc \
 			util/rsstring.cc \
 			util/rsthreads.cc \
+			util/rsworkerpool.cc \
 			util/rsrandom.cc \
 			util/rstickevent.cc \
 			util/rsrecogn.cc \
@@ -678,6 +686,7 @@ HEADERS += rsitems/rsnxsitems.h \
 	gxs/rsgds.h \
 	gxs/rsgxs.h \
 	gxs/rsdataservice.h \
+	gxs/rsgxsblobstore.h \
 	gxs/rsgxsnetservice.h \
 	gxs/rsgxsnettunnel.h \
 	gxs/rsgenexchange.h \
@@ -698,6 +707,7 @@ SOURCES += rsitems/rsnxsitems.cc \
 	gxs/gxssecurity.cc \
 	gxs/rsgxsdataaccess.cc \
 	gxs/rsdataservice.cc \
+	gxs/rsgxsblobstore.cc \
 	gxs/rsgenexchange.cc \
 	gxs/rsgxsnetservice.cc \
 	gxs/rsgxsnettunnel.cc \
@@ -751,9 +761,11 @@ SOURCES += services/p3gxscircles.cc \
 # GxsForums Service
 HEADERS += retroshare/rsgxsforums.h \
 	services/p3gxsforums.h \
+	services/gxsforumthreadindex.h \
 	rsitems/rsgxsforumitems.h
 
 SOURCES += services/p3gxsforums.cc \
+	services/gxsforumthreadindex.cc \
 	rsitems/rsgxsforumitems.cc \
 
 # GxsChannels Service
@@ -791,11 +803,13 @@ gxsthewire {
 # Posted Service
 HEADERS += services/p3postbase.h \
 	services/p3posted.h \
+	services/postedrankingindex.h \
 	retroshare/rsposted.h \
 	rsitems/rsposteditems.h
 
 SOURCES +=  services/p3postbase.cc \
 	services/p3posted.cc \
+	services/postedrankingindex.cc \
 	rsitems/rsposteditems.cc
 
 gxsphotoshare {
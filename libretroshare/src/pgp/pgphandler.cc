@@ -26,11 +26,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <openssl/evp.h>
 
 #ifdef WINDOWS_SYS
 #include <io.h>
 #include "util/rsstring.h"
 #include "util/rswin.h"
+#else
+#include <unistd.h>
 #endif
 
 extern "C" {
@@ -115,12 +118,15 @@ void PGPHandler::setPassphraseCallback(PassphraseCallback cb)
 }
 
 PGPHandler::PGPHandler(const std::string& pubring, const std::string& secring,const std::string& trustdb,const std::string& pgp_lock_filename)
-	: pgphandlerMtx(std::string("PGPHandler")), _pubring_path(pubring),_secring_path(secring),_trustdb_path(trustdb),_pgp_lock_filename(pgp_lock_filename)
+	: pgphandlerMtx(std::string("PGPHandler")), _pubring_path(pubring),_secring_path(secring),_trustdb_path(trustdb),_pgp_lock_filename(pgp_lock_filename),
+	  _signature_cache_path(pubring + ".sigcache")
 {
 	RsStackMutex mtx(pgphandlerMtx) ;				// lock access to PGP memory structures.
 
 	_pubring_changed = false ;
 	_trustdb_changed = false ;
+	_signature_cache_changed = false ;
+	_pubring_needs_rewrite = false ;
 
 	RsStackFileLock flck(_pgp_lock_filename) ;	// lock access to PGP directory.
 
@@ -154,6 +160,10 @@ PGPHandler::PGPHandler(const std::string& pubring, const std::string& secring,co
 	else
 		std::cerr << "pubring file \"" << pubring << "\" not found. Creating a void keyring." << std::endl;
 
+	// Signatures of keys that did not change since the last run do not need to be checked again.
+
+	locked_readSignatureCache() ;
+
 	const ops_keydata_t *keydata ;
 	int i=0 ;
 	while( (keydata = ops_keyring_get_key_by_index(_pubring,i)) != NULL )
@@ -171,8 +181,11 @@ PGPHandler::PGPHandler(const std::string& pubring, const std::string& secring,co
 		++i ;
 	}
 	_pubring_last_update_time = time(NULL) ;
+	_pubring_keys_on_disk = _pubring->nkeys ;
 	std::cerr << "Pubring read successfully." << std::endl;
 
+	locked_syncSignatureCache() ;
+
 	if(secring_exist)
 	{
 		if(ops_false == ops_keyring_read_from_file(_secring, false, secring.c_str()))
@@ -255,8 +268,51 @@ void PGPHandler::initCertificateInfo(PGPCertificateInfo& cert,const ops_keydata_
 	cert._fpr = PGPFingerprintType(f.fingerprint) ;
 }
 
+Sha1CheckSum PGPHandler::keyPacketsHash(const ops_keydata_t *keydata)
+{
+	EVP_MD_CTX *ctx = EVP_MD_CTX_create();
+	EVP_DigestInit_ex(ctx, EVP_sha1(), NULL);
+
+	for(uint32_t i=0;i<keydata->npackets;++i)
+		EVP_DigestUpdate(ctx, keydata->packets[i].raw, keydata->packets[i].length);
+
+	unsigned char sha_buf[Sha1CheckSum::SIZE_IN_BYTES];
+	EVP_DigestFinal_ex(ctx, sha_buf, NULL);
+	EVP_MD_CTX_destroy(ctx);
+
+	return Sha1CheckSum::fromBufferUnsafe(sha_buf) ;
+}
+
 bool PGPHandler::validateAndUpdateSignatures(PGPCertificateInfo& cert,const ops_keydata_t *keydata)
 {
+	RsPgpId id(keydata->key_id) ;
+	Sha1CheckSum packets_hash = keyPacketsHash(keydata) ;
+
+	// Use the cached result if the key did not change since it was validated, and none of its unknown signers
+	// was added to the keyring in the mean time.
+
+	std::map<RsPgpId,SignatureCacheEntry>::const_iterator cit = _signature_cache.find(id) ;
+
+	if(cit != _signature_cache.end() && cit->second.packets_hash == packets_hash)
+	{
+		bool up_to_date = true ;
+
+		for(std::set<RsPgpId>::const_iterator it(cit->second.unknown_signers.begin());it!=cit->second.unknown_signers.end() && up_to_date;++it)
+			if(ops_keyring_find_key_by_id(_pubring,it->toByteArray()) != NULL)
+				up_to_date = false ;
+
+		if(up_to_date)
+		{
+			bool ret = false ;
+
+			for(std::set<RsPgpId>::const_iterator it(cit->second.valid_signers.begin());it!=cit->second.valid_signers.end();++it)
+				if(cert.signers.insert(*it).second)
+					ret = true ;
+
+			return ret ;
+		}
+	}
+
 	ops_validate_result_t* result=(ops_validate_result_t*)ops_mallocz(sizeof *result);
 	ops_boolean_t res = ops_validate_key_signatures(result,keydata,_pubring,cb_get_passphrase) ;
 
@@ -272,14 +328,23 @@ bool PGPHandler::validateAndUpdateSignatures(PGPCertificateInfo& cert,const ops_
 
 	bool ret = false ;
 
+	SignatureCacheEntry& entry(_signature_cache[id]) ;
+	entry.packets_hash = packets_hash ;
+	entry.valid_signers.clear() ;
+	entry.unknown_signers.clear() ;
+	_signature_cache_changed = true ;
+
 	// Parse signers.
 	//
 
 	if(result != NULL)
+	{
 		for(size_t i=0;i<result->valid_count;++i)
 		{
 			RsPgpId signer_id(result->valid_sigs[i].signer_id);
 
+			entry.valid_signers.insert(signer_id) ;
+
 			if(cert.signers.find(signer_id) == cert.signers.end())
 			{
 				cert.signers.insert(signer_id) ;
@@ -287,6 +352,10 @@ bool PGPHandler::validateAndUpdateSignatures(PGPCertificateInfo& cert,const ops_
 			}
 		}
 
+		for(size_t i=0;i<result->unknown_signer_count;++i)
+			entry.unknown_signers.insert(RsPgpId(result->unknown_sigs[i].signer_id)) ;
+	}
+
 	ops_validate_result_free(result) ;
 
 	return ret ;
@@ -1187,6 +1256,11 @@ bool PGPHandler::locked_addOrMergeKey(ops_keyring_t *keyring,std::map<RsPgpId,PG
 
 		if(ret)
 			initCertificateInfo(kmap[id],existing_key,res->second._key_index) ;
+
+		// The key may already be on disk, in which case appending new keys is not enough to save the keyring.
+
+		if(ret && keyring == _pubring && res->second._key_index < _pubring_keys_on_disk)
+			_pubring_needs_rewrite = true ;
 	}
 
 	if(ret)
@@ -1514,6 +1588,7 @@ bool PGPHandler::privateSignCertificate(const RsPgpId& ownId,const RsPgpId& id_o
 	free(secret_key) ;
 
 	_pubring_changed = true ;
+	_pubring_needs_rewrite = true ;
 
 	// 4 - update signatures.
 	//
@@ -1863,6 +1938,124 @@ bool PGPHandler::locked_writePrivateTrustDatabase()
 		return true ;
 }
 
+static const uint32_t PGP_SIGNATURE_CACHE_MAGIC       = 0x52535343 ; // "RSSC"
+static const uint32_t PGP_SIGNATURE_CACHE_VERSION     = 0x0001 ;
+static const uint32_t PGP_SIGNATURE_CACHE_MAX_SIGNERS = 65536 ;	// sanity limit when reading the file.
+
+void PGPHandler::locked_readSignatureCache()
+{
+	FILE *fdb = RsDirUtil::rs_fopen(_signature_cache_path.c_str(),"rb") ;
+
+	if(fdb == NULL)
+	{
+		std::cerr << "  signature cache not found. All key signatures will be checked." << std::endl ;
+		return ;
+	}
+	uint32_t header[2] ;
+
+	if(fread((void*)header,sizeof(header),1,fdb) != 1 || header[0] != PGP_SIGNATURE_CACHE_MAGIC || header[1] != PGP_SIGNATURE_CACHE_VERSION)
+	{
+		std::cerr << "  (WW) signature cache " << _signature_cache_path << " has an unknown format. Ignoring it." << std::endl ;
+		fclose(fdb) ;
+		return ;
+	}
+	unsigned char id_buf[RsPgpId::SIZE_IN_BYTES] ;
+	unsigned char hash_buf[Sha1CheckSum::SIZE_IN_BYTES] ;
+	uint32_t counts[2] ;
+	int n_entries = 0 ;
+
+	while(fread((void*)id_buf,sizeof(id_buf),1,fdb) == 1)
+	{
+		if(fread((void*)hash_buf,sizeof(hash_buf),1,fdb) != 1 || fread((void*)counts,sizeof(counts),1,fdb) != 1
+		        || counts[0] > PGP_SIGNATURE_CACHE_MAX_SIGNERS || counts[1] > PGP_SIGNATURE_CACHE_MAX_SIGNERS)
+		{
+			std::cerr << "  (WW) signature cache " << _signature_cache_path << " is truncated or corrupted. Ignoring it." << std::endl ;
+			_signature_cache.clear() ;
+			break ;
+		}
+		RsPgpId key_id = RsPgpId::fromBufferUnsafe(id_buf) ;
+		SignatureCacheEntry entry ;
+		entry.packets_hash = Sha1CheckSum::fromBufferUnsafe(hash_buf) ;
+
+		bool ok = true ;
+
+		for(uint32_t k=0;k<counts[0]+counts[1] && ok;++k)
+		{
+			ok = (fread((void*)id_buf,sizeof(id_buf),1,fdb) == 1) ;
+			(k < counts[0] ? entry.valid_signers : entry.unknown_signers).insert(RsPgpId::fromBufferUnsafe(id_buf)) ;
+		}
+		if(!ok)
+		{
+			std::cerr << "  (WW) signature cache " << _signature_cache_path << " is truncated. Ignoring it." << std::endl ;
+			_signature_cache.clear() ;
+			break ;
+		}
+		_signature_cache[key_id] = entry ;
+		++n_entries ;
+	}
+
+	fclose(fdb) ;
+
+	std::cerr << "PGPHandler: read " << n_entries << " entries from signature cache." << std::endl;
+}
+
+bool PGPHandler::locked_writeSignatureCache()
+{
+	FILE *fdb = RsDirUtil::rs_fopen((_signature_cache_path+".tmp").c_str(),"wb") ;
+
+	if(fdb == NULL)
+	{
+		std::cerr << "  (EE) Can't open signature cache file " << _signature_cache_path << " for write. Giving up!" << std::endl ;
+		return false;
+	}
+	uint32_t header[2] = { PGP_SIGNATURE_CACHE_MAGIC, PGP_SIGNATURE_CACHE_VERSION } ;
+	bool ok = (fwrite((void*)header,sizeof(header),1,fdb) == 1) ;
+
+	for(std::map<RsPgpId,SignatureCacheEntry>::const_iterator it(_signature_cache.begin());it!=_signature_cache.end() && ok;++it)
+	{
+		if(_public_keyring_map.find(it->first) == _public_keyring_map.end())	// only keep keys that are still in the keyring
+			continue ;
+
+		uint32_t counts[2] = { (uint32_t)it->second.valid_signers.size(), (uint32_t)it->second.unknown_signers.size() } ;
+
+		ok = fwrite((void*)it->first.toByteArray(),RsPgpId::SIZE_IN_BYTES,1,fdb) == 1
+		        && fwrite((void*)it->second.packets_hash.toByteArray(),Sha1CheckSum::SIZE_IN_BYTES,1,fdb) == 1
+		        && fwrite((void*)counts,sizeof(counts),1,fdb) == 1 ;
+
+		for(std::set<RsPgpId>::const_iterator sit(it->second.valid_signers.begin());sit!=it->second.valid_signers.end() && ok;++sit)
+			ok = fwrite((void*)sit->toByteArray(),RsPgpId::SIZE_IN_BYTES,1,fdb) == 1 ;
+
+		for(std::set<RsPgpId>::const_iterator sit(it->second.unknown_signers.begin());sit!=it->second.unknown_signers.end() && ok;++sit)
+			ok = fwrite((void*)sit->toByteArray(),RsPgpId::SIZE_IN_BYTES,1,fdb) == 1 ;
+	}
+
+	fclose(fdb) ;
+
+	if(!ok)
+	{
+		std::cerr << "  (EE) Cannot write to signature cache " << _signature_cache_path << ". Disc full, or quota exceeded ? Leaving cache untouched." << std::endl;
+		return false;
+	}
+	if(!RsDirUtil::renameFile(_signature_cache_path+".tmp",_signature_cache_path))
+	{
+		std::cerr << "  (EE) Cannot move temp file " << _signature_cache_path+".tmp" << ". Bad write permissions?" << std::endl;
+		return false ;
+	}
+	return true ;
+}
+
+bool PGPHandler::locked_syncSignatureCache()
+{
+	if(!_signature_cache_changed)
+		return true ;
+
+	if(!locked_writeSignatureCache())
+		return false ;
+
+	_signature_cache_changed = false ;
+	return true ;
+}
+
 bool PGPHandler::syncDatabase()
 {
 	RsStackMutex mtx(pgphandlerMtx) ;				// lock access to PGP memory structures.
@@ -1877,6 +2070,7 @@ bool PGPHandler::syncDatabase()
 	// Now sync the trust database as well.
 	//
 	locked_syncTrustDatabase() ;
+	locked_syncSignatureCache() ;
 
 #ifdef DEBUG_PGPHANDLER
 	std::cerr << "Done. " << std::endl;
@@ -1902,9 +2096,30 @@ bool PGPHandler::locked_syncPublicKeyring()
 
 		locked_mergeKeyringFromDisk(_pubring,_public_keyring_map,_pubring_path) ;
 		_pubring_last_update_time = buf.st_mtime ;
+
+		// The order of keys in memory does not match the file anymore.
+
+		_pubring_needs_rewrite = true ;
+	}
+
+	// Now check if the pubring was locally modified, which needs saving it again. When only new keys
+	// were added, they are appended to the existing file, which avoids re-writing large keyrings.
+
+	if(_pubring_changed && !_pubring_needs_rewrite && _pubring_keys_on_disk > 0 && RsDiscSpace::checkForDiscSpace(RS_PGP_DIRECTORY))
+	{
+		std::cerr << "New keys in public keyring. Appending to disk..." << std::endl;
+
+		if(locked_appendNewKeysToPublicKeyring())
+		{
+			std::cerr << "Done." << std::endl;
+			_pubring_last_update_time = time(NULL) ;
+			_pubring_keys_on_disk = _pubring->nkeys ;
+			_pubring_changed = false ;
+		}
+		else
+			_pubring_needs_rewrite = true ;	// fall back to writing the entire keyring.
 	}
 
-	// Now check if the pubring was locally modified, which needs saving it again
 	if(_pubring_changed && RsDiscSpace::checkForDiscSpace(RS_PGP_DIRECTORY))
 	{
 		std::string tmp_keyring_file = _pubring_path + ".tmp" ;
@@ -1923,11 +2138,66 @@ bool PGPHandler::locked_syncPublicKeyring()
 
 		std::cerr << "Done." << std::endl;
 		_pubring_last_update_time = time(NULL) ;	// should we get this value from the disk instead??
+		_pubring_keys_on_disk = _pubring->nkeys ;
+		_pubring_needs_rewrite = false ;
 		_pubring_changed = false ;
 	}
 	return true ;
 }
 
+bool PGPHandler::locked_appendNewKeysToPublicKeyring()
+{
+	if(!RsDirUtil::fileExists(_pubring_path) || _pubring_keys_on_disk > (uint32_t)_pubring->nkeys)
+		return false ;
+
+	// Append in place rather than to a copy of the keyring, which would cost a full rewrite for every new key.
+	// The file is synced before returning, and truncated back to its old size if anything fails, so that
+	// the keys already on disk are never affected.
+
+	uint64_t old_size = 0 ;
+
+	if(!RsDirUtil::checkFile(_pubring_path,old_size))
+		return false ;
+
+	ops_create_info_t *cinfo = NULL ;
+	int fd = ops_setup_file_append(&cinfo, _pubring_path.c_str());
+
+	if(fd < 0)
+	{
+		std::cerr << "Cannot open pubring file " << _pubring_path << " for append." << std::endl;
+		return false ;
+	}
+
+	bool ok = true ;
+
+	for(uint32_t i=_pubring_keys_on_disk;i<(uint32_t)_pubring->nkeys && ok;++i)
+		if(!ops_write_transferable_public_key_from_packet_data(&_pubring->keys[i],ops_false,cinfo))
+		{
+			std::cerr << "Cannot append key " << RsPgpId(_pubring->keys[i].key_id).toStdString() << " to pubring file. Disk full? Disk quota exceeded?" << std::endl;
+			ok = false ;
+		}
+
+#ifdef WINDOWS_SYS
+	if(ok && _commit(fd) != 0)
+#else
+	if(ok && fsync(fd) != 0)
+#endif
+	{
+		std::cerr << "Cannot sync pubring file " << _pubring_path << " after append." << std::endl;
+		ok = false ;
+	}
+
+#ifdef WINDOWS_SYS
+	if(!ok && _chsize_s(fd,old_size) != 0)
+#else
+	if(!ok && ftruncate(fd,old_size) != 0)
+#endif
+		std::cerr << "(EE) Cannot truncate pubring file " << _pubring_path << " back to " << old_size << " bytes. It may now end with a partial key." << std::endl;
+
+	ops_teardown_file_write(cinfo,fd) ;
+	return ok ;
+}
+
 bool PGPHandler::locked_syncTrustDatabase()
 {
 	struct stat64 buf ;
@@ -2045,6 +2315,8 @@ bool PGPHandler::removeKeysFromPGPKeyring(const std::set<RsPgpId>& keys_to_remov
 
 	// Remove keys from the keyring, and update the keyring map.
 	//
+	std::set<RsPgpId> removed_keys ;
+
     for(std::set<RsPgpId>::const_iterator it(keys_to_remove.begin());it!=keys_to_remove.end();++it)
 	{
 		if(locked_getSecretKey(*it) != NULL)
@@ -2075,6 +2347,8 @@ bool PGPHandler::removeKeysFromPGPKeyring(const std::set<RsPgpId>& keys_to_remov
 		// Erase the info from the keyring map.
 		//
 		_public_keyring_map.erase(res) ;
+		_signature_cache.erase(*it) ;
+		removed_keys.insert(*it) ;
 
 		// now update all indices back. This internal look is very costly, but it avoids deleting the wrong keys, since the keyring structure is
 		// changed by ops_keyring_remove_key and therefore indices don't point to the correct location anymore.
@@ -2089,13 +2363,31 @@ bool PGPHandler::removeKeysFromPGPKeyring(const std::set<RsPgpId>& keys_to_remov
 		}
 	}
 
+	// Cached results that list a removed key as a valid signer are stale: that signature can't be checked anymore.
+
+	for(std::map<RsPgpId,SignatureCacheEntry>::iterator it(_signature_cache.begin());it!=_signature_cache.end();)
+	{
+		bool stale = false ;
+
+		for(std::set<RsPgpId>::const_iterator sit(it->second.valid_signers.begin());sit!=it->second.valid_signers.end() && !stale;++sit)
+			stale = removed_keys.find(*sit) != removed_keys.end() ;
+
+		if(stale)
+			_signature_cache.erase(it++) ;
+		else
+			++it ;
+	}
+
 	// Everything went well, sync back the keyring on disk
 	
 	_pubring_changed = true ;
+	_pubring_needs_rewrite = true ;
 	_trustdb_changed = true ;
+	_signature_cache_changed = true ;
 
 	locked_syncPublicKeyring() ;
 	locked_syncTrustDatabase() ;
+	locked_syncSignatureCache() ;
 
 	return true ;
 }
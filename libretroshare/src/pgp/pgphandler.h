@@ -28,6 +28,7 @@
 #include <set>
 #include <util/rsthreads.h>
 #include <retroshare/rstypes.h>
+#include <util/rsdir.h>
 
 extern "C" {
 #include <openpgpsdk/types.h>
@@ -194,6 +195,18 @@ class PGPHandler
 		bool locked_syncPublicKeyring() ;
 		bool locked_syncTrustDatabase() ;
 
+		// Appends the keys that were added to the public keyring since its last write at the end of
+		// the file on disk, rather than re-writing the whole keyring.
+		//
+		bool locked_appendNewKeysToPublicKeyring() ;
+
+		// Cache of signature validation results, so that only new or modified keys need to be checked
+		// at start. The cache is stored next to the public keyring and trusted as much as the keyring itself.
+		//
+		void locked_readSignatureCache() ;
+		bool locked_writeSignatureCache() ;
+		bool locked_syncSignatureCache() ;
+
 		void locked_mergeKeyringFromDisk(ops_keyring_t *keyring, std::map<RsPgpId,PGPCertificateInfo>& kmap, const std::string& keyring_file) ;
 		bool locked_addOrMergeKey(ops_keyring_t *keyring,std::map<RsPgpId,PGPCertificateInfo>& kmap,const ops_keydata_t *keydata) ;
 
@@ -219,6 +232,20 @@ class PGPHandler
 		rstime_t _secring_last_update_time ;
 		rstime_t _trustdb_last_update_time ;
 
+		struct SignatureCacheEntry
+		{
+			Sha1CheckSum packets_hash ;			// hash of all raw packets of the key when signatures were validated
+			std::set<RsPgpId> valid_signers ;
+			std::set<RsPgpId> unknown_signers ;	// signers that were not in the keyring. The key needs to be re-validated if one shows up.
+		};
+
+		const std::string _signature_cache_path ;
+		std::map<RsPgpId,SignatureCacheEntry> _signature_cache ;
+		bool _signature_cache_changed ;
+
+		uint32_t _pubring_keys_on_disk ;	// number of keys of _pubring that are already written in the keyring file
+		bool _pubring_needs_rewrite ;		// keys already on disk were modified or removed. Appending is not enough.
+
 		// Helper functions.
 		//
 		static std::string makeRadixEncodedPGPKey(const ops_keydata_t *key,bool include_signatures) ;
@@ -226,4 +253,5 @@ class PGPHandler
 		static void addNewKeyToOPSKeyring(ops_keyring_t*, const ops_keydata_t&) ;
 		static PassphraseCallback _passphrase_callback ;
 		static bool mergeKeySignatures(ops_keydata_t *dst,const ops_keydata_t *src) ;	// returns true if signature lists are different
+		static Sha1CheckSum keyPacketsHash(const ops_keydata_t *keydata) ;
 };
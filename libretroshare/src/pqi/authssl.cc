@@ -59,6 +59,13 @@ const uint32_t RS_SSL_HANDSHAKE_DIAGNOSTIC_HASH_ALGORITHM_NOT_ACCEPTED = 0x07 ;
 const uint32_t RS_SSL_HANDSHAKE_DIAGNOSTIC_WRONG_SIGNATURE_TYPE        = 0x09 ;
 const uint32_t RS_SSL_HANDSHAKE_DIAGNOSTIC_WRONG_SIGNATURE_VERSION     = 0x0a ;
 
+/* Reconnection caches */
+
+static const uint32_t SSL_SESSION_CACHE_LIFETIME   = 3600 ; // resume sessions established less than one hour ago
+static const uint32_t SSL_SESSION_CACHE_MAX_SIZE   = 1024 ; // at most one session per friend node
+static const uint32_t SSL_CERT_AUTH_CACHE_LIFETIME = 3600 ; // verify PGP signatures of certificates again after one hour
+static const uint32_t SSL_CERT_AUTH_CACHE_MAX_SIZE = 1024 ;
+
 /****
  * #define AUTHSSL_DEBUG 1
  ***/
@@ -305,7 +312,10 @@ std::string RsX509Cert::getCertOrg(const X509& x509)
 
 AuthSSLimpl::AuthSSLimpl() :
     p3Config(), sslctx(nullptr), mOwnCert(nullptr), sslMtx("AuthSSL"),
-    mOwnPrivateKey(nullptr), mOwnPublicKey(nullptr), init(0) {}
+    mOwnPrivateKey(nullptr), mOwnPublicKey(nullptr), init(0),
+    mSessionCache(SSL_SESSION_CACHE_LIFETIME, SSL_SESSION_CACHE_MAX_SIZE),
+    mCertAuthCache(SSL_CERT_AUTH_CACHE_LIFETIME, SSL_CERT_AUTH_CACHE_MAX_SIZE)
+{}
 
 bool AuthSSLimpl::active() { return init; }
 
@@ -502,6 +512,8 @@ int AuthSSLimpl::InitAuth(
 
 	std::cerr << "SSL Verification Set" << std::endl;
 
+	mSessionCache.setup(sslctx);
+
 	mOwnCert = x509;
 
 	std::cerr << "Inited SSL context: " << std::endl;
@@ -550,6 +562,8 @@ bool	AuthSSLimpl::CloseAuth()
 	std::cerr << "AuthSSLimpl::CloseAuth()";
 	std::cerr << std::endl;
 #endif
+	mSessionCache.clear();
+	mCertAuthCache.clear();
 	SSL_CTX_free(sslctx);
 
 	// clean up private key....
@@ -568,6 +582,37 @@ SSL_CTX *AuthSSLimpl::getCTX()
 	return sslctx;
 }
 
+void AuthSSLimpl::prepareSslConnection(SSL* ssl, const RsPeerId& sslId)
+{
+	if(mSessionCache.prepareConnection(ssl, sslId))
+		Dbg2() << __PRETTY_FUNCTION__ << " offering to resume the last session"
+		       << " with peer " << sslId << std::endl;
+}
+
+bool AuthSSLimpl::checkResumedSession(SSL* ssl)
+{
+	if(!SSL_session_reused(ssl))
+		return true;
+
+	X509* x509Cert = SSL_get_peer_certificate(ssl);
+	bool accepted = x509Cert && authenticatePeerCertificate(x509Cert);
+
+	if(!accepted)
+	{
+		RsInfo() << __PRETTY_FUNCTION__ << " resumed session refused"
+		         << std::endl;
+
+		if(x509Cert)
+			mSessionCache.removeSession(RsX509Cert::getCertSslId(*x509Cert));
+	}
+	else
+		Dbg1() << __PRETTY_FUNCTION__ << " resumed session with peer "
+		       << RsX509Cert::getCertSslId(*x509Cert) << std::endl;
+
+	if(x509Cert) X509_free(x509Cert);
+	return accepted;
+}
+
 const RsPeerId& AuthSSLimpl::OwnId()
 {
 #ifdef AUTHSSL_DEBUG
@@ -986,6 +1031,14 @@ bool AuthSSLimpl::AuthX509WithGPG(X509 *x509, uint32_t& diagnostic)
 		Dbg3() << __PRETTY_FUNCTION__ << " issuer: " << issuer << " found"
 		       << std::endl;
 
+	/* The PGP signature of a certificate never changes, so don't verify it
+	 * again each time the peer reconnects */
+	if(mCertAuthCache.isAuthenticated(x509))
+	{
+		diagnostic = RS_SSL_HANDSHAKE_DIAGNOSTIC_OK;
+		return true;
+	}
+
 	/* verify GPG signature */
 	/*** NOW The Manual signing bit (HACKED FROM asn1/a_sign.c) ***/
 
@@ -1138,6 +1191,7 @@ bool AuthSSLimpl::AuthX509WithGPG(X509 *x509, uint32_t& diagnostic)
 
 	OPENSSL_free(buf_in);
 
+	mCertAuthCache.setAuthenticated(x509);
 	diagnostic = RS_SSL_HANDSHAKE_DIAGNOSTIC_OK;
 
 	return true;
@@ -1173,9 +1227,6 @@ int AuthSSLimpl::VerifyX509Callback(int /*preverify_ok*/, X509_STORE_CTX* ctx)
 	constexpr int verificationFailed = 0;
 	constexpr int verificationSuccess = 1;
 
-	using Evt_t = RsAuthSslConnectionAutenticationEvent;
-	std::unique_ptr<Evt_t> ev = std::unique_ptr<Evt_t>(new Evt_t);
-
 	X509* x509Cert = X509_STORE_CTX_get_current_cert(ctx);
 	if(!x509Cert)
 	{
@@ -1187,6 +1238,8 @@ int AuthSSLimpl::VerifyX509Callback(int /*preverify_ok*/, X509_STORE_CTX* ctx)
 
 		if(rsEvents)
 		{
+			using Evt_t = RsAuthSslConnectionAutenticationEvent;
+			std::unique_ptr<Evt_t> ev = std::unique_ptr<Evt_t>(new Evt_t);
 			ev->mErrorMsg = errMsg;
 			rsEvents->postEvent(std::move(ev));
 		}
@@ -1194,6 +1247,18 @@ int AuthSSLimpl::VerifyX509Callback(int /*preverify_ok*/, X509_STORE_CTX* ctx)
 		return verificationFailed;
 	}
 
+	return authenticatePeerCertificate(x509Cert) ?
+	            verificationSuccess : verificationFailed;
+}
+
+bool AuthSSLimpl::authenticatePeerCertificate(X509* x509Cert)
+{
+	constexpr bool verificationFailed = false;
+	constexpr bool verificationSuccess = true;
+
+	using Evt_t = RsAuthSslConnectionAutenticationEvent;
+	std::unique_ptr<Evt_t> ev = std::unique_ptr<Evt_t>(new Evt_t);
+
 	RsPeerId sslId = RsX509Cert::getCertSslId(*x509Cert);
 	std::string sslCn = RsX509Cert::getCertIssuerString(*x509Cert);
 	RsPgpId pgpId(sslCn);
@@ -1590,6 +1655,8 @@ bool AuthSSLimpl::RemoveX509(RsPeerId id)
 	
 	RsStackMutex stack(sslMtx); /******* LOCKED ******/
 
+	mSessionCache.removeSession(id);
+
 	if (mCerts.end() != (it = mCerts.find(id)))
 	{
 		X509* cert = it->second;
@@ -33,6 +33,7 @@
 #include "pqi/pqi_base.h"
 #include "pqi/pqinetwork.h"
 #include "pqi/p3cfgmgr.h"
+#include "pqi/sslsessioncache.h"
 #include "util/rsmemory.h"
 #include "retroshare/rsevents.h"
 
@@ -163,6 +164,26 @@ public:
 	/// SSL specific functions used in pqissl/pqissllistener
 	virtual SSL_CTX* getCTX() = 0;
 
+	/**
+	 * @brief Offer to resume the last TLS session established with the peer
+	 * Must be called on outgoing connections before the handshake.
+	 * @param ssl connection not yet connected
+	 * @param sslId id of the peer we are connecting to
+	 */
+	virtual void prepareSslConnection(SSL* ssl, const RsPeerId& sslId) = 0;
+
+	/**
+	 * @brief Authenticate the peer of a resumed TLS session
+	 * OpenSSL doesn't call VerifyX509Callback when a session is resumed, so
+	 * this must be called once the handshake completed, to make sure the peer
+	 * is still a friend.
+	 * Emits @see RsAuthSslConnectionAutenticationEvent on resumed sessions.
+	 * @param ssl connected TLS connection
+	 * @return false if the session was resumed and the peer is not accepted
+	 *	anymore, true otherwise
+	 */
+	virtual bool checkResumedSession(SSL* ssl) = 0;
+
 	virtual void setCurrentConnectionAttemptInfo(
 	        const RsPgpId& gpg_id, const RsPeerId& ssl_id,
 	        const std::string& ssl_cn ) = 0;
@@ -256,6 +277,12 @@ public:
 	/* SSL specific functions used in pqissl/pqissllistener */
 	SSL_CTX* getCTX() override;
 
+	/// @see AuthSSL
+	void prepareSslConnection(SSL* ssl, const RsPeerId& sslId) override;
+
+	/// @see AuthSSL
+	bool checkResumedSession(SSL* ssl) override;
+
 	/* Restored these functions: */
 	void setCurrentConnectionAttemptInfo(
 	        const RsPgpId& gpg_id, const RsPeerId& ssl_id,
@@ -269,6 +296,10 @@ private:
 	bool LocalStoreCert(X509* x509);
 	bool RemoveX509(const RsPeerId id);
 
+	/** Authenticate a peer certificate and emit the matching
+	 * RsAuthSslConnectionAutenticationEvent */
+	bool authenticatePeerCertificate(X509* x509);
+
 	/*********** LOCKED Functions ******/
 	bool locked_FindCert(const RsPeerId& id, X509** cert);
 
@@ -297,4 +328,8 @@ private:
 	RsPgpId _last_gpgid_to_connect;
 	std::string _last_sslcn_to_connect;
 	RsPeerId _last_sslid_to_connect;
+
+	/* both have their own mutex */
+	SslSessionCache mSessionCache;
+	SslCertAuthCache mCertAuthCache;
 };
@@ -296,6 +296,15 @@ public:
 	 */
 	virtual int readdata(void *data, int len) = 0;
 
+	/**
+	 * reads whatever data is available, up to len bytes, instead of waiting
+	 * for exactly len bytes like readdata(). Only called when
+	 * readsAvailableData() returns true.
+	 *@return the number of bytes read, 0 if no data is available, -1 on error
+	 */
+	virtual int readavailable(void * /*data*/, int /*len*/) { return -1; }
+	virtual bool readsAvailableData() { return false; }
+
 	/**
 	 * Is more particular the case of the sending data through a socket (internet)
 	 * moretoread and candsend, take a microsec timeout argument.
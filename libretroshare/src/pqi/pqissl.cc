@@ -1030,6 +1030,9 @@ int 	pqissl::Initiate_SSL_Connection()
         
 	ssl_connection = ssl;
 
+	// reconnecting friends skip the full handshake when possible.
+	AuthSSL::instance().prepareSslConnection(ssl, PeerId());
+
 	net_internal_SSL_set_fd(ssl, sockfd);
 	if (err < 1)
 	{
@@ -1151,6 +1154,16 @@ int pqissl::Authorise_SSL_Connection()
 	// reset switch.
 	waiting = WAITING_NOT;
 
+	/* Resumed sessions don't go through AuthSSL::VerifyX509Callback, check
+	 * that the peer is still a friend */
+	if(!AuthSSL::instance().checkResumedSession(ssl_connection))
+	{
+		RsInfo() << __PRETTY_FUNCTION__ << " resumed session with peer: "
+		         << PeerId() << " refused." << std::endl;
+		reset_locked();
+		return failure;
+	}
+
 #ifdef RS_PQISSL_AUTH_DOUBLE_CHECK
 	X509* peercert = SSL_get_peer_certificate(ssl_connection);
 	if (!peercert)
@@ -1532,140 +1545,179 @@ int pqissl::readdata(void *data, int len)
 
 		// Need to catch errors.....
 		if (tmppktlen <= 0) // probably needs a reset.
-		{
-			std::string out;
+			return readError_locked(tmppktlen);
+
+		total_len+=tmppktlen ;
+	} while(total_len < len) ;
+
+#ifdef PQISSL_DEBUG
+	std::cerr << "pqissl: have read data of length " << total_len << ", expected is " << len << std::endl ;
+#endif
+
+	if (len != total_len)
+	{
+		std::string out;
+		rs_sprintf(out, "pqissl::readdata() Full Packet Not read!\n -> Expected len(%d) actually read(%d)", len, total_len);
+		std::cerr << out << std::endl;
+		rslog(RSL_WARNING, pqisslzone, out);
+	}
+	total_len = 0 ;		// reset the packet pointer as we have finished a packet.
+	n_read_zero = 0;
+	return len;//tmppktlen;
+}
+
+int pqissl::readavailable(void *data, int len)
+{
+	RS_STACK_MUTEX(mSslMtx);
+
+	// Safety check.  Apparently this avoids some SIGSEGV.
+	if (ssl_connection == NULL) return -1;
+
+	// SSL_read() returns at most one TLS record, so keep reading until
+	// the buffer is full or no more data is available.
+	int read_len = 0;
+
+	while(read_len < len)
+	{
+		ERR_clear_error();
 
+		int tmppktlen = SSL_read(ssl_connection,
+		                         (void*)( &(((uint8_t*)data)[read_len])),
+		                         len-read_len);
+		if (tmppktlen <= 0)
+		{
 			int error = SSL_get_error(ssl_connection, tmppktlen);
-			unsigned long err2 =  ERR_get_error();
 
-			if ((error == SSL_ERROR_ZERO_RETURN) && (err2 == 0))
-			{
-				/* this code will be called when
-				 * (1) moretoread -> returns true. +
-				 * (2) SSL_read fails.
-				 *
-				 * There are two ways this can happen:
-				 * (1) there is a little data on the socket, but not enough
-				 * for a full SSL record, so there legimitately is no error, and the moretoread()
-				 * was correct, but the read fails.
-				 *
-				 * (2) the socket has been closed correctly. this leads to moretoread() -> true, 
-				 * and ZERO error.... we catch this case by counting how many times
-				 * it occurs in a row (cos the other one will not).
-				 */
-				if (n_read_zero == 0)
-				{
-					/* first read_zero */
-					mReadZeroTS = time(NULL);
-				}
+			if (error == SSL_ERROR_WANT_READ)
+				break;
 
-				++n_read_zero;
-				out += "pqissl::readdata() " + PeerId().toStdString();
-				rs_sprintf_append(out, " SSL_read() SSL_ERROR_ZERO_RETURN : nReadZero: %d", n_read_zero);
+			if(read_len > 0)	// return what we have, the error will show up again next time.
+				break;
 
-				if ((PQISSL_MAX_READ_ZERO_COUNT < n_read_zero)
-					&& (time(NULL) - mReadZeroTS > PQISSL_MAX_READ_ZERO_TIME)) 
-				{
-					out += " Count passed Limit, shutting down!";
-					rs_sprintf_append(out, " ReadZero Age: %ld", time(NULL) - mReadZeroTS);
+			return readError_locked(tmppktlen);
+		}
+		read_len += tmppktlen;
+	}
 
-					rslog(RSL_ALERT, pqisslzone, "pqissl::readdata() -> calling reset()");
-					reset_locked();
-				}
+	if(read_len > 0)
+		n_read_zero = 0;
 
-				rslog(RSL_ALERT, pqisslzone, out);
-				//std::cerr << out << std::endl ;
-				return -1;
-			}
+	return read_len;
+}
 
-			/* the only real error we expect */
-			if (error == SSL_ERROR_SYSCALL)
-			{
-				out += "pqissl::readdata() " + PeerId().toStdString();
-				out += " SSL_read() SSL_ERROR_SYSCALL";
-				out += " SOCKET_DEAD -> calling reset()";
-				rs_sprintf_append(out, " errno: %d", errno);
-				out += " " + socket_errorType(errno);
-				rslog(RSL_ALERT, pqisslzone, out);
-
-				/* extra debugging - based on SSL_get_error() man page */
-				{
-					int syserr = errno;
-					int sslerr = 0;
-					std::string out2;
-					rs_sprintf(out2, "SSL_ERROR_SYSCALL, ret == %d errno: %d %s\n", tmppktlen, syserr, socket_errorType(syserr).c_str());
-	
-					while(0 != (sslerr = ERR_get_error()))
-					{
-						rs_sprintf_append(out2, "SSLERR:%d : ", sslerr);
-	
-						char sslbuf[256] = {0};
-						out2 += ERR_error_string(sslerr, sslbuf);
-						out2 += "\n";
-					}
-					rslog(RSL_ALERT, pqisslzone, out2);
-				}
+int pqissl::readError_locked(int sslret)
+{
+	std::string out;
+
+	int error = SSL_get_error(ssl_connection, sslret);
+	unsigned long err2 =  ERR_get_error();
+
+	if ((error == SSL_ERROR_ZERO_RETURN) && (err2 == 0))
+	{
+		/* this code will be called when
+		 * (1) moretoread -> returns true. +
+		 * (2) SSL_read fails.
+		 *
+		 * There are two ways this can happen:
+		 * (1) there is a little data on the socket, but not enough
+		 * for a full SSL record, so there legimitately is no error, and the moretoread()
+		 * was correct, but the read fails.
+		 *
+		 * (2) the socket has been closed correctly. this leads to moretoread() -> true, 
+		 * and ZERO error.... we catch this case by counting how many times
+		 * it occurs in a row (cos the other one will not).
+		 */
+		if (n_read_zero == 0)
+		{
+			/* first read_zero */
+			mReadZeroTS = time(NULL);
+		}
 
-				rslog(RSL_ALERT, pqisslzone, "pqissl::readdata() -> calling reset()");
-				reset_locked();
-				std::cerr << out << std::endl ;
-				return -1;
-			}
-			else if (error == SSL_ERROR_WANT_WRITE)
-			{
-				out += "SSL_read() SSL_ERROR_WANT_WRITE";
-				rslog(RSL_WARNING, pqisslzone, out);
-				std::cerr << out << std::endl ;
-				return -1;
-			}
-			else if (error == SSL_ERROR_WANT_READ)				
-			{							
-				// SSL_WANT_READ is not a crittical error. It's just a sign that
-				// the internal SSL buffer is not ready to accept more data. So -1 
-				// is returned, and the connection will be retried as is on next
-				// call of readdata().
+		++n_read_zero;
+		out += "pqissl::readdata() " + PeerId().toStdString();
+		rs_sprintf_append(out, " SSL_read() SSL_ERROR_ZERO_RETURN : nReadZero: %d", n_read_zero);
 
-#ifdef PQISSL_DEBUG
-				out += "SSL_read() SSL_ERROR_WANT_READ";
-				rslog(RSL_DEBUG_BASIC, pqisslzone, out);
-#endif
-				return -1;
-			}
-			else
+		if ((PQISSL_MAX_READ_ZERO_COUNT < n_read_zero)
+			&& (time(NULL) - mReadZeroTS > PQISSL_MAX_READ_ZERO_TIME)) 
+		{
+			out += " Count passed Limit, shutting down!";
+			rs_sprintf_append(out, " ReadZero Age: %ld", time(NULL) - mReadZeroTS);
+
+			rslog(RSL_ALERT, pqisslzone, "pqissl::readdata() -> calling reset()");
+			reset_locked();
+		}
+
+		rslog(RSL_ALERT, pqisslzone, out);
+		//std::cerr << out << std::endl ;
+		return -1;
+	}
+
+	/* the only real error we expect */
+	if (error == SSL_ERROR_SYSCALL)
+	{
+		out += "pqissl::readdata() " + PeerId().toStdString();
+		out += " SSL_read() SSL_ERROR_SYSCALL";
+		out += " SOCKET_DEAD -> calling reset()";
+		rs_sprintf_append(out, " errno: %d", errno);
+		out += " " + socket_errorType(errno);
+		rslog(RSL_ALERT, pqisslzone, out);
+
+		/* extra debugging - based on SSL_get_error() man page */
+		{
+			int syserr = errno;
+			int sslerr = 0;
+			std::string out2;
+			rs_sprintf(out2, "SSL_ERROR_SYSCALL, ret == %d errno: %d %s\n", sslret, syserr, socket_errorType(syserr).c_str());
+
+			while(0 != (sslerr = ERR_get_error()))
 			{
-				rs_sprintf_append(out, "SSL_read() UNKNOWN ERROR: %d Resetting!", error);
-				rslog(RSL_ALERT, pqisslzone, out);
-				std::cerr << out << std::endl ;
-				std::cerr << ", SSL_read() output is " << tmppktlen << std::endl ;
+				rs_sprintf_append(out2, "SSLERR:%d : ", sslerr);
 
-			printSSLError(ssl_connection, tmppktlen, error, err2, out);
-            
-				rslog(RSL_ALERT, pqisslzone, "pqissl::readdata() -> calling reset()");
-				reset_locked();
-				return -1;
+				char sslbuf[256] = {0};
+				out2 += ERR_error_string(sslerr, sslbuf);
+				out2 += "\n";
 			}
-
-			rslog(RSL_ALERT, pqisslzone, out);
-			//exit(1);
+			rslog(RSL_ALERT, pqisslzone, out2);
 		}
-		else
-			total_len+=tmppktlen ;
-	} while(total_len < len) ;
+
+		rslog(RSL_ALERT, pqisslzone, "pqissl::readdata() -> calling reset()");
+		reset_locked();
+		std::cerr << out << std::endl ;
+		return -1;
+	}
+	else if (error == SSL_ERROR_WANT_WRITE)
+	{
+		out += "SSL_read() SSL_ERROR_WANT_WRITE";
+		rslog(RSL_WARNING, pqisslzone, out);
+		std::cerr << out << std::endl ;
+		return -1;
+	}
+	else if (error == SSL_ERROR_WANT_READ)				
+	{							
+		// SSL_WANT_READ is not a crittical error. It's just a sign that
+		// the internal SSL buffer is not ready to accept more data. So -1 
+		// is returned, and the connection will be retried as is on next
+		// call of readdata().
 
 #ifdef PQISSL_DEBUG
-	std::cerr << "pqissl: have read data of length " << total_len << ", expected is " << len << std::endl ;
+		out += "SSL_read() SSL_ERROR_WANT_READ";
+		rslog(RSL_DEBUG_BASIC, pqisslzone, out);
 #endif
-
-	if (len != total_len)
+		return -1;
+	}
+	else
 	{
-		std::string out;
-		rs_sprintf(out, "pqissl::readdata() Full Packet Not read!\n -> Expected len(%d) actually read(%d)", len, total_len);
-		std::cerr << out << std::endl;
-		rslog(RSL_WARNING, pqisslzone, out);
+		rs_sprintf_append(out, "SSL_read() UNKNOWN ERROR: %d Resetting!", error);
+		rslog(RSL_ALERT, pqisslzone, out);
+		std::cerr << out << std::endl ;
+		std::cerr << ", SSL_read() output is " << sslret << std::endl ;
+
+		printSSLError(ssl_connection, sslret, error, err2, out);
+            
+		rslog(RSL_ALERT, pqisslzone, "pqissl::readdata() -> calling reset()");
+		reset_locked();
+		return -1;
 	}
-	total_len = 0 ;		// reset the packet pointer as we have finished a packet.
-	n_read_zero = 0;
-	return len;//tmppktlen;
 }
 
 
@@ -106,6 +106,8 @@ virtual int     status();
 
 virtual int senddata(void*, int);
 virtual int readdata(void*, int);
+virtual int readavailable(void*, int);
+virtual bool readsAvailableData() { return true ; }
 virtual int netstatus();
 virtual int isactive();
 virtual bool moretoread(uint32_t usec);
@@ -136,6 +138,9 @@ protected:
 
 virtual int reset_locked();
 
+	/// handles a failed SSL_read(), resetting the connection if needed. Returns -1.
+	int readError_locked(int sslret);
+
 	/// initiate incoming connection.
 	int accept_locked( SSL *ssl, int fd,
 	                   const sockaddr_storage& foreign_addr );
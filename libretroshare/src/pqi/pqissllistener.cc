@@ -781,6 +781,14 @@ int pqissllistener::completeConnection(int fd, IncomingSSLInfo& info)
 	RsPgpId pgpId = RsX509Cert::getCertIssuer(*peercert);
 	RsPeerId newPeerId = RsX509Cert::getCertSslId(*peercert);
 
+	/* Resumed sessions don't go through AuthSSL::VerifyX509Callback, check
+	 * that the peer is still a friend */
+	if(!AuthSSL::instance().checkResumedSession(info.ssl))
+	{
+		X509_free(peercert);
+		return failure;
+	}
+
 #ifdef RS_PQISSL_AUTH_DOUBLE_CHECK
 	/* At this point the actual connection authentication has already been
 	 * performed in AuthSSL::VerifyX509Callback, any furter authentication check
@@ -56,6 +56,12 @@ static const int   PQISTREAM_SLICE_PROTOCOL_VERSION_ID_01     = 0x10;		// Protoc
 static const int   PQISTREAM_PARTIAL_PACKET_HEADER_SIZE	= 8;   		// Same size than normal header, to make the code simpler.
 static const int   PQISTREAM_PACKET_SLICING_PROBE_DELAY	= 60;  		// send every 60 secs.
 
+static const int   PQISTREAM_COALESCED_PACKET_SIZE		= 16384 - PQISTREAM_OPTIMAL_PACKET_SIZE - PQISTREAM_PARTIAL_PACKET_HEADER_SIZE ;	// group slices up to this size when bulk data is queued,
+										// so that the last slice still fits in a single TLS record (16 KB).
+static const int   PQISTREAM_COALESCING_MIN_QUEUED_SIZE	= 16384;	// bytes that need to be queued to switch to coalescing.
+static const double PQISTREAM_COALESCING_FLUSH_DELAY		= 0.005;	// max time (in secs) an incomplete coalesced packet waits for more data.
+static const int   PQISTREAM_READ_BUFFER_EXTRA_SIZE	= 65536;	// room left after a packet of max size in the read buffer, for reading several TLS records at once.
+
 // This is a probe packet, that won't deserialise (it's empty) but will not cause problems to old peers either, since they will ignore
 // it. This packet however will be understood by new peers as a signal to enable packet slicing. This should go when all peers use the
 // same protocol.
@@ -65,6 +71,7 @@ static uint8_t PACKET_SLICING_PROBE_BYTES[8] =  { 0x02, 0xaa, 0xbb, 0xcc, 0x00,
 /* Change to true to disable packet slicing and/or packet grouping, if needed */
 #define DISABLE_PACKET_SLICING  false
 #define DISABLE_PACKET_GROUPING false
+#define DISABLE_PACKET_COALESCING false
 
 /* This removes the print statements (which hammer pqidebug) */
 /***
@@ -95,7 +102,8 @@ static double getCurrentTS()
 pqistreamer::pqistreamer(RsSerialiser *rss, const RsPeerId& id, BinInterface *bio_in, int bio_flags_in)
 	:PQInterface(id), mStreamerMtx("pqistreamer"),
 	mBio(bio_in), mBio_flags(bio_flags_in), mRsSerialiser(rss), 
-	mPkt_wpending(NULL), mPkt_wpending_size(0),
+	mPkt_wpending(NULL), mPkt_wpending_size(0), mPkt_wpending_capacity(0),
+	mPkt_wpending_retry(false), mPkt_wpending_flush_TS(0), mCoalescing(false),
 	mTotalRead(0), mTotalSent(0),
 	mCurrRead(0), mCurrSent(0),
 	mAvgReadCount(0), mAvgSentCount(0),
@@ -121,6 +129,7 @@ pqistreamer::pqistreamer(RsSerialiser *rss, const RsPeerId& id, BinInterface *bi
     /* allocated once */
     mPkt_rpend_size = 0;
     mPkt_rpending = 0;
+    mPkt_rpend_start = mPkt_rpend_end = 0 ;
     mReading_state = reading_state_initial ;
 
     pqioutput(PQL_DEBUG_ALL, pqistreamerzone, "pqistreamer::pqistreamer() Initialisation!");
@@ -290,7 +299,8 @@ int 	pqistreamer::tick_recv(uint32_t timeout)
 {
 	RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
 
-	if (mBio->moretoread(timeout))
+	// packets may be left in the read buffer when the incoming bandwidth limit is reached.
+	if (mBio->moretoread(timeout) || mPkt_rpend_end > mPkt_rpend_start)
 	{
 		handleincoming_locked();
 	}
@@ -512,12 +522,7 @@ int	pqistreamer::handleoutgoing_locked()
         	mAcceptsPacketSlicing = false ;
 
 	    /* also remove the pending packets */
-	    if (mPkt_wpending)
-	    {
-		    free(mPkt_wpending);
-		    mPkt_wpending = NULL;
-		    	mPkt_wpending_size = 0 ;
-	    }
+	    free_wpending_locked() ;
 
 	    return 0;
     }
@@ -545,29 +550,37 @@ int	pqistreamer::handleoutgoing_locked()
 	    // send a out_pkt., else send out_data. unless there is a pending packet. The strategy is to
             //	- grab as many packets as possible while below the optimal packet size, so as to allow some packing and decrease encryption padding overhead (suposeddly)
             //	- limit packets size to OPTIMAL_PACKET_SIZE when sending big packets so as to keep as much QoS as possible.
+            //	- when bulk data is queued, keep grouping the slices up to the size of a TLS record, so that each write carries a full record.
+            //	  The slices stay small, so QoS still applies between the records.
         
-	    if (!mPkt_wpending)
+	    if (!mPkt_wpending_retry)
 	{
 		void *dta;
-		mPkt_wpending_size = 0 ;
 		int k=0;
 
         	// Checks for inserting a packet slicing probe. We do that to send the other peer the information that packet slicing can be used.
         	// if so, we enable it for the session. This should be removed (because it's unnecessary) when all users have switched to the new version.
 		rstime_t now = time(NULL) ;
         
-            if(now > mLastSentPacketSlicingProbe + PQISTREAM_PACKET_SLICING_PROBE_DELAY)
+            if(mPkt_wpending_size == 0 && now > mLastSentPacketSlicingProbe + PQISTREAM_PACKET_SLICING_PROBE_DELAY)
         	{
 #ifdef DEBUG_PACKET_SLICING
                 	std::cerr << "(II) Inserting packet slicing probe in traffic" << std::endl;
 #endif
                     
-                    	mPkt_wpending_size = 8 ;
-                    	mPkt_wpending = rs_malloc(8) ;
+                    	reserve_wpending_locked(8) ;
                         memcpy(mPkt_wpending,PACKET_SLICING_PROBE_BYTES,8) ;
+                    	mPkt_wpending_size = 8 ;
                         
                 	mLastSentPacketSlicingProbe = now ;
         	}
+
+		// Once enough data is queued, coalescing goes on until the queue is empty.
+		if(!mCoalescing && !DISABLE_PACKET_COALESCING && locked_compute_out_pkt_size() >= PQISTREAM_COALESCING_MIN_QUEUED_SIZE)
+			mCoalescing = true ;
+
+		uint32_t group_size = mCoalescing?PQISTREAM_COALESCED_PACKET_SIZE:PQISTREAM_OPTIMAL_PACKET_SIZE ;
+		bool queue_empty = false ;
             
         	uint32_t slice_size=0;
 		bool slice_starts=true ;
@@ -581,14 +594,17 @@ int	pqistreamer::handleoutgoing_locked()
 			dta = locked_pop_out_data(desired_packet_size,slice_size,slice_starts,slice_ends,slice_packet_id) ;
 
 			if(!dta)
+			{
+				queue_empty = true ;
 				break ;
+			}
 
 			if(slice_starts && slice_ends)	// good old method. Send the packet as is, since it's a full packet.
 			{
 #ifdef DEBUG_PACKET_SLICING
 				std::cerr << "sending full slice, old style. Size=" << slice_size << std::endl;
 #endif
-				mPkt_wpending = realloc(mPkt_wpending,slice_size+mPkt_wpending_size) ;
+				reserve_wpending_locked(mPkt_wpending_size+slice_size) ;
 				memcpy( &((char*)mPkt_wpending)[mPkt_wpending_size],dta,slice_size) ;
 				free(dta);
 				mPkt_wpending_size += slice_size ;
@@ -599,15 +615,16 @@ int	pqistreamer::handleoutgoing_locked()
 				if(slice_size > 0xffff || !mAcceptsPacketSlicing)
 				{
 					std::cerr << "(EE) protocol error in pqitreamer: slice size is too large and cannot be encoded." ;
-					free(mPkt_wpending) ;
+					free(dta) ;
 					mPkt_wpending_size = 0;
+					mPkt_wpending_flush_TS = 0 ;
 					return -1 ;
 				}
 #ifdef DEBUG_PACKET_SLICING
 				std::cerr << "sending partial slice, packet ID=" << std::hex << slice_packet_id << std::dec << ", size=" << slice_size << std::endl;
 #endif
 
-				mPkt_wpending = realloc(mPkt_wpending,slice_size+mPkt_wpending_size+PQISTREAM_PARTIAL_PACKET_HEADER_SIZE) ;
+				reserve_wpending_locked(mPkt_wpending_size+slice_size+PQISTREAM_PARTIAL_PACKET_HEADER_SIZE) ;
 				memcpy( &((char*)mPkt_wpending)[mPkt_wpending_size+PQISTREAM_PARTIAL_PACKET_HEADER_SIZE],dta,slice_size) ;
 				free(dta);
 
@@ -630,15 +647,33 @@ int	pqistreamer::handleoutgoing_locked()
 				++k ;
 			}
 		} 
-                 while(mPkt_wpending_size < (uint32_t)maxbytes && mPkt_wpending_size < PQISTREAM_OPTIMAL_PACKET_SIZE && !DISABLE_PACKET_GROUPING) ;
+                 while(mPkt_wpending_size < (uint32_t)maxbytes && mPkt_wpending_size < group_size && !DISABLE_PACKET_GROUPING) ;
              
 #ifdef DEBUG_PQISTREAMER
 		if(k > 1)
 			std::cerr << "Packed " << k << " packets into " << mPkt_wpending_size << " bytes." << std::endl;
 #endif
+
+		// The queue ran dry before the record is full: wait a little for more bulk data, but not longer than
+		// PQISTREAM_COALESCING_FLUSH_DELAY, so that the last bytes of a transfer and the items sent meanwhile are not delayed.
+
+		if(mCoalescing && queue_empty)
+		{
+			if(mPkt_wpending_size > 0 && mPkt_wpending_size < group_size)
+			{
+				double now_TS = getCurrentTS() ;
+
+				if(mPkt_wpending_flush_TS == 0)
+					mPkt_wpending_flush_TS = now_TS + PQISTREAM_COALESCING_FLUSH_DELAY ;
+
+				if(now_TS < mPkt_wpending_flush_TS)
+					return 0 ;
+			}
+			mCoalescing = false ;	// the queue is drained, back to small packets for interactive traffic.
+		}
 	}
         
-	    if (mPkt_wpending)
+	    if (mPkt_wpending_size > 0)
 	    {
 		    // write packet.
 #ifdef DEBUG_PQISTREAMER
@@ -658,6 +693,7 @@ int	pqistreamer::handleoutgoing_locked()
 
 			    // pkt_wpending will kept til next time.
 			    // ensuring exactly the same data is written (openSSL requirement).
+			    mPkt_wpending_retry = true ;
 			    return -1;
 		    }
 #ifdef DEBUG_PQISTREAMER
@@ -676,9 +712,10 @@ int	pqistreamer::handleoutgoing_locked()
 
 		    sentbytes += mPkt_wpending_size;
             
-		    free(mPkt_wpending);
-		    mPkt_wpending = NULL;
+		    // the buffer is kept for the next packet
 		    mPkt_wpending_size = 0 ;
+		    mPkt_wpending_retry = false ;
+		    mPkt_wpending_flush_TS = 0 ;
 
 		    sent = true;
 	    }
@@ -690,6 +727,34 @@ int	pqistreamer::handleoutgoing_locked()
     return 1;
 }
 
+void pqistreamer::reserve_wpending_locked(uint32_t size)
+{
+	if(size <= mPkt_wpending_capacity)
+		return ;
+
+	// allocate a whole record at once, so that coalescing doesn't need to grow the buffer slice after slice
+	uint32_t capacity = std::max(size, (uint32_t)PQISTREAM_COALESCED_PACKET_SIZE + getRsPktMaxSize()) ;
+
+	mPkt_wpending = realloc(mPkt_wpending,capacity) ;
+	mPkt_wpending_capacity = capacity ;
+}
+
+void pqistreamer::free_wpending_locked()
+{
+	if (mPkt_wpending)
+	{
+#ifdef DEBUG_PQISTREAMER
+		std::cerr << "pqistreamer::free_wpending_locked(): pending output packet buffer" << std::endl;
+#endif
+		free(mPkt_wpending);
+		mPkt_wpending = NULL;
+	}
+	mPkt_wpending_size = 0 ;
+	mPkt_wpending_capacity = 0 ;
+	mPkt_wpending_retry = false ;
+	mPkt_wpending_flush_TS = 0 ;
+	mCoalescing = false ;
+}
 
 /* Handles reading from input stream.
  */
@@ -711,6 +776,11 @@ int pqistreamer::handleincoming_locked()
     else
 	    allocate_rpend_locked();
 
+    int maxin = inAllowedBytes_locked();
+
+    if(mBio->readsAvailableData())
+	    return handleincoming_buffered_locked(maxin) ;
+
     // enough space to read any packet.
     uint32_t maxlen = mPkt_rpend_size; 
     void *block = mPkt_rpending; 
@@ -718,8 +788,6 @@ int pqistreamer::handleincoming_locked()
     // initial read size: basic packet.
     int blen = getRsPktBaseSize();	// this is valid for both packet slices and normal un-sliced packets (same header size)
 
-    int maxin = inAllowedBytes_locked();
-
 #ifdef DEBUG_PQISTREAMER
     std::cerr << "[" << (void*)pthread_self() << "] " << "reading state = " << mReading_state << std::endl ;
 #endif
@@ -798,28 +866,9 @@ continue_packet:
     {
 	    // workout how much more to read.
 
-	    bool is_partial_packet  = false ;
-	    bool is_packet_starting = (((char*)block)[1] == PQISTREAM_SLICE_FLAG_STARTS) ; 	// STARTS and ENDS flags are actually never combined.
-	    bool is_packet_ending   = (((char*)block)[1] == PQISTREAM_SLICE_FLAG_ENDS) ; 
-	    bool is_packet_middle   = (((char*)block)[1] == 0x00) ; 
-
-	    uint32_t extralen =0;
-	    uint32_t slice_packet_id =0;
-
-	    if( ((char*)block)[0] == PQISTREAM_SLICE_PROTOCOL_VERSION_ID_01 && ( is_packet_starting || is_packet_middle || is_packet_ending))
-	    {
-		    extralen        = (uint32_t(((uint8_t*)block)[6]) << 8 ) + (uint32_t(((uint8_t*)block)[7]));
-		    slice_packet_id = (uint32_t(((uint8_t*)block)[2]) << 24) + (uint32_t(((uint8_t*)block)[3]) << 16) + (uint32_t(((uint8_t*)block)[4]) << 8) + (uint32_t(((uint8_t*)block)[5]) << 0);
-
-#ifdef DEBUG_PACKET_SLICING
-		    std::cerr << "Reading partial packet from mem block " << RsUtil::BinToHex((char*)block,8) << ": packet_id=" << std::hex << slice_packet_id << std::dec << ", len=" << extralen << std::endl;
-#endif
-		    is_partial_packet = true ;
-            
-                        mAcceptsPacketSlicing = !DISABLE_PACKET_SLICING; // this is needed
-	    }
-	    else
-		    extralen = getRsItemSize(block) - blen;	// old style packet type
+	    bool is_partial_packet, is_packet_starting, is_packet_ending ;
+	    uint32_t slice_packet_id ;
+	    uint32_t extralen = readPacketHeader_locked(block,is_partial_packet,is_packet_starting,is_packet_ending,slice_packet_id) ;
 
 #ifdef DEBUG_PACKET_SLICING
 	    std::cerr << "[" << (void*)pthread_self() << "] " << "continuing packet getRsItemSize(block) = " << getRsItemSize(block) << std::endl ;
@@ -830,48 +879,8 @@ continue_packet:
 #endif
 	    if (extralen + (uint32_t)blen > maxlen)
 	    {
-		    pqioutput(PQL_ALERT, pqistreamerzone, "ERROR: Read Packet too Big!");
-
-		    p3Notify *notify = RsServer::notify();
-		    if (notify)
-		    {
-			    std::string title =
-			                    "Warning: Bad Packet Read";
-
-			    std::string msg;
-			    msg =   "               **** WARNING ****     \n";
-			    msg +=  "Retroshare has caught a BAD Packet Read";
-			    msg +=  "\n";
-			    msg +=  "This is normally caused by connecting to an";
-			    msg +=  " OLD version of Retroshare";
-			    msg +=  "\n";
-			    rs_sprintf_append(msg, "(M:%d B:%d E:%d)\n", maxlen, blen, extralen);
-			    msg +=  "\n";
-			    msg +=  "block = " ;
-                	    msg += RsUtil::BinToHex((char*)block,8);
-
-			    msg +=  "\n";
-			    msg +=  "Please get your friends to upgrade to the latest version";
-			    msg +=  "\n";
-			    msg +=  "\n";
-			    msg +=  "If you are sure the error was not caused by an old version";
-			    msg +=  "\n";
-			    msg +=  "Please report the problem to Retroshare's developers";
-			    msg +=  "\n";
-
-			    notify->AddLogMessage(0, RS_SYS_WARNING, title, msg);
-
-			    std::cerr << "pqistreamer::handle_incoming() ERROR: Read Packet too Big" << std::endl;
-			    std::cerr << msg;
-			    std::cerr << std::endl;
-
-		    }
-		    mBio->close();	
-		    mReading_state = reading_state_initial ;	// restart at state 1.
-		    mFailed_read_attempts = 0 ;
+		    badPacketRead_locked(block,maxlen,blen,extralen) ;
 		    return -1;
-
-		    // Used to exit now! exit(1);
 	    }
 
 	    if (extralen > 0)
@@ -959,40 +968,7 @@ continue_packet:
 #ifdef DEBUG_PQISTREAMER
 	    std::cerr << "[" << (void*)pthread_self() << "] " << RsUtil::BinToHex((char*)block,8) << "...: deserializing. Size=" << pktlen << std::endl ;
 #endif
-	    RsItem *pkt ;
-
-	    if(is_partial_packet)
-	    {
-#ifdef DEBUG_PACKET_SLICING
-		    std::cerr << "Inputing partial packet " << RsUtil::BinToHex((char*)block,8) << std::endl;
-#endif
-            		uint32_t packet_length = 0 ;
-		    pkt = addPartialPacket_locked(block,pktlen,slice_packet_id,is_packet_starting,is_packet_ending,packet_length) ;
-            
-            		pktlen = packet_length ;
-	    }
-	    else
-		    pkt = mRsSerialiser->deserialise(block, &pktlen);
-
-	    if ((pkt != NULL) && (0  < handleincomingitem_locked(pkt,pktlen)))
-	    {
-#ifdef DEBUG_PQISTREAMER
-		    pqioutput(PQL_DEBUG_BASIC, pqistreamerzone, "Successfully Read a Packet!");
-#endif
-		    inReadBytes_locked(pktlen);	// only count deserialised packets, because that's what is actually been transfered.
-	    }
-	    else if (!is_partial_packet)
-	    {
-#ifdef DEBUG_PQISTREAMER
-		    pqioutput(PQL_ALERT, pqistreamerzone, "Failed to handle Packet!");
-#endif
-		    std::cerr << "Incoming Packet  could not be deserialised:" << std::endl;
-		    std::cerr << "  Incoming peer id: " << PeerId() << std::endl;
-		    if(pktlen >= 8)
-			    std::cerr << "  Packet header   : " << RsUtil::BinToHex((unsigned char*)block,8) << std::endl;
-		    if(pktlen >  8)
-			    std::cerr << "  Packet data     : " << RsUtil::BinToHex((unsigned char*)block+8,std::min(50u,pktlen-8)) << ((pktlen>58)?"...":"") << std::endl;
-	    }
+	    handleReadPacket_locked(block,pktlen,is_partial_packet,is_packet_starting,is_packet_ending,slice_packet_id) ;
 
 	    mReading_state = reading_state_initial ;	// restart at state 1.
 	    mFailed_read_attempts = 0 ;						// reset failed read, as the packet has been totally read.
@@ -1012,6 +988,103 @@ continue_packet:
     return 0;
 }
 
+/* Reads as much data as available into mPkt_rpending, and parses all the complete packets and
+ * slices directly from there. Only the beginning of an incomplete packet at the end of the buffer
+ * is ever moved, so the cost of a read is spread over all the packets it contains.
+ */
+int pqistreamer::handleincoming_buffered_locked(int maxin)
+{
+	int readbytes = 0;
+	uint32_t blen = getRsPktBaseSize();
+	uint32_t maxlen = getRsPktMaxSize();
+
+	while(true)
+	{
+		uint32_t missing = 0 ;	// bytes needed to complete the packet at the end of the buffer
+
+		while(readbytes == 0 || maxin > readbytes)	// always handle at least one packet, like unbuffered reads do
+		{
+			uint32_t available = mPkt_rpend_end - mPkt_rpend_start ;
+
+			if(available < blen)
+			{
+				missing = blen - available ;
+				break ;
+			}
+
+			void *block = &((char*)mPkt_rpending)[mPkt_rpend_start] ;
+
+			// Check for packet slicing probe (04/26/2016). To be removed when everyone uses it.
+
+			if(!memcmp(block,PACKET_SLICING_PROBE_BYTES,8))
+			{
+				mAcceptsPacketSlicing = !DISABLE_PACKET_SLICING;
+#ifdef DEBUG_PACKET_SLICING
+				std::cerr << "(II) Enabling packet slicing!" << std::endl;
+#endif
+			}
+
+			bool is_partial_packet, is_packet_starting, is_packet_ending ;
+			uint32_t slice_packet_id ;
+			uint32_t extralen = readPacketHeader_locked(block,is_partial_packet,is_packet_starting,is_packet_ending,slice_packet_id) ;
+
+			// An old style packet claiming to be smaller than its own header would make extralen wrap around,
+			// and the loop would never move forward in the buffer.
+
+			if ((!is_partial_packet && getRsItemSize(block) < blen) || extralen + blen > maxlen)
+			{
+				badPacketRead_locked(block,maxlen,blen,extralen) ;
+				mPkt_rpend_start = mPkt_rpend_end = 0 ;
+				return -1;
+			}
+
+			uint32_t pktlen = blen+extralen ;
+
+			if(available < pktlen)
+			{
+				missing = pktlen - available ;	// incomplete packet, wait for more data
+				break ;
+			}
+
+			mPkt_rpend_start += pktlen ;
+			readbytes += pktlen ;
+
+			handleReadPacket_locked(block,pktlen,is_partial_packet,is_packet_starting,is_packet_ending,slice_packet_id) ;
+		}
+
+		if(mPkt_rpend_start == mPkt_rpend_end)
+			mPkt_rpend_start = mPkt_rpend_end = 0 ;
+
+		if(readbytes > 0 && readbytes >= maxin)
+			break ;
+
+		// Move the incomplete packet to the beginning of the buffer when there's not enough room after it.
+		// It's always smaller than a packet of max size, so there's at least PQISTREAM_READ_BUFFER_EXTRA_SIZE bytes free afterwards.
+
+		if(mPkt_rpend_start > 0 && mPkt_rpend_size - mPkt_rpend_end < (uint32_t)PQISTREAM_READ_BUFFER_EXTRA_SIZE)
+		{
+			memmove(mPkt_rpending, &((char*)mPkt_rpending)[mPkt_rpend_start], mPkt_rpend_end - mPkt_rpend_start) ;
+			mPkt_rpend_end -= mPkt_rpend_start ;
+			mPkt_rpend_start = 0 ;
+		}
+
+		// don't read much more than allowed, so that the sender is slowed down by TCP when we're over the limit.
+		int toread = std::min<int>(mPkt_rpend_size - mPkt_rpend_end, std::max<int>(maxin - readbytes, missing)) ;
+		int tmplen = mBio->readavailable(&((char*)mPkt_rpending)[mPkt_rpend_end], toread) ;
+
+		if(tmplen <= 0)
+			break ;	// no more data, or an error that pqissl already handled.
+
+		mPkt_rpend_end += tmplen ;
+	}
+
+#ifdef DEBUG_TRANSFERS
+	if (readbytes >= maxin)
+		std::cerr << "pqistreamer::handleincoming_buffered_locked() Stopped reading as readbytes >= maxin. Read " << readbytes << " bytes " << std::endl;
+#endif
+	return 0;
+}
+
 RsItem *pqistreamer::addPartialPacket_locked(const void *block, uint32_t len, uint32_t slice_packet_id, bool is_packet_starting, bool is_packet_ending, uint32_t &total_len) 
 {
 #ifdef DEBUG_PACKET_SLICING
@@ -1100,6 +1173,115 @@ RsItem *pqistreamer::addPartialPacket_locked(const void *block, uint32_t len, ui
     }
 }
 
+uint32_t pqistreamer::readPacketHeader_locked(const void *block, bool& is_partial_packet, bool& is_packet_starting, bool& is_packet_ending, uint32_t& slice_packet_id)
+{
+	is_partial_packet  = false ;
+	is_packet_starting = (((char*)block)[1] == PQISTREAM_SLICE_FLAG_STARTS) ; 	// STARTS and ENDS flags are actually never combined.
+	is_packet_ending   = (((char*)block)[1] == PQISTREAM_SLICE_FLAG_ENDS) ; 
+	bool is_packet_middle   = (((char*)block)[1] == 0x00) ; 
+
+	uint32_t extralen =0;
+	slice_packet_id =0;
+
+	if( ((char*)block)[0] == PQISTREAM_SLICE_PROTOCOL_VERSION_ID_01 && ( is_packet_starting || is_packet_middle || is_packet_ending))
+	{
+		extralen        = (uint32_t(((uint8_t*)block)[6]) << 8 ) + (uint32_t(((uint8_t*)block)[7]));
+		slice_packet_id = (uint32_t(((uint8_t*)block)[2]) << 24) + (uint32_t(((uint8_t*)block)[3]) << 16) + (uint32_t(((uint8_t*)block)[4]) << 8) + (uint32_t(((uint8_t*)block)[5]) << 0);
+
+#ifdef DEBUG_PACKET_SLICING
+		std::cerr << "Reading partial packet from mem block " << RsUtil::BinToHex((const char*)block,8) << ": packet_id=" << std::hex << slice_packet_id << std::dec << ", len=" << extralen << std::endl;
+#endif
+		is_partial_packet = true ;
+
+		mAcceptsPacketSlicing = !DISABLE_PACKET_SLICING; // this is needed
+	}
+	else
+		extralen = getRsItemSize(const_cast<void*>(block)) - getRsPktBaseSize();	// old style packet type
+
+	return extralen ;
+}
+
+void pqistreamer::badPacketRead_locked(const void *block, uint32_t maxlen, uint32_t blen, uint32_t extralen)
+{
+	pqioutput(PQL_ALERT, pqistreamerzone, "ERROR: Read Packet too Big!");
+
+	p3Notify *notify = RsServer::notify();
+	if (notify)
+	{
+		std::string title =
+		                    "Warning: Bad Packet Read";
+
+		std::string msg;
+		msg =   "               **** WARNING ****     \n";
+		msg +=  "Retroshare has caught a BAD Packet Read";
+		msg +=  "\n";
+		msg +=  "This is normally caused by connecting to an";
+		msg +=  " OLD version of Retroshare";
+		msg +=  "\n";
+		rs_sprintf_append(msg, "(M:%d B:%d E:%d)\n", maxlen, blen, extralen);
+		msg +=  "\n";
+		msg +=  "block = " ;
+		msg += RsUtil::BinToHex((const char*)block,8);
+
+		msg +=  "\n";
+		msg +=  "Please get your friends to upgrade to the latest version";
+		msg +=  "\n";
+		msg +=  "\n";
+		msg +=  "If you are sure the error was not caused by an old version";
+		msg +=  "\n";
+		msg +=  "Please report the problem to Retroshare's developers";
+		msg +=  "\n";
+
+		notify->AddLogMessage(0, RS_SYS_WARNING, title, msg);
+
+		std::cerr << "pqistreamer::handle_incoming() ERROR: Read Packet too Big" << std::endl;
+		std::cerr << msg;
+		std::cerr << std::endl;
+
+	}
+	mBio->close();
+	mReading_state = reading_state_initial ;	// restart at state 1.
+	mFailed_read_attempts = 0 ;
+}
+
+void pqistreamer::handleReadPacket_locked(void *block, uint32_t pktlen, bool is_partial_packet, bool is_packet_starting, bool is_packet_ending, uint32_t slice_packet_id)
+{
+	RsItem *pkt ;
+
+	if(is_partial_packet)
+	{
+#ifdef DEBUG_PACKET_SLICING
+		std::cerr << "Inputing partial packet " << RsUtil::BinToHex((char*)block,8) << std::endl;
+#endif
+		uint32_t packet_length = 0 ;
+		pkt = addPartialPacket_locked(block,pktlen,slice_packet_id,is_packet_starting,is_packet_ending,packet_length) ;
+
+		pktlen = packet_length ;
+	}
+	else
+		pkt = mRsSerialiser->deserialise(block, &pktlen);
+
+	if ((pkt != NULL) && (0  < handleincomingitem_locked(pkt,pktlen)))
+	{
+#ifdef DEBUG_PQISTREAMER
+		pqioutput(PQL_DEBUG_BASIC, pqistreamerzone, "Successfully Read a Packet!");
+#endif
+		inReadBytes_locked(pktlen);	// only count deserialised packets, because that's what is actually been transfered.
+	}
+	else if (!is_partial_packet)
+	{
+#ifdef DEBUG_PQISTREAMER
+		pqioutput(PQL_ALERT, pqistreamerzone, "Failed to handle Packet!");
+#endif
+		std::cerr << "Incoming Packet  could not be deserialised:" << std::endl;
+		std::cerr << "  Incoming peer id: " << PeerId() << std::endl;
+		if(pktlen >= 8)
+			std::cerr << "  Packet header   : " << RsUtil::BinToHex((unsigned char*)block,8) << std::endl;
+		if(pktlen >  8)
+			std::cerr << "  Packet data     : " << RsUtil::BinToHex((unsigned char*)block+8,std::min(50u,pktlen-8)) << ((pktlen>58)?"...":"") << std::endl;
+	}
+}
+
 /* BandWidth Management Assistance */
 
 float   pqistreamer::outTimeSlice_locked()
@@ -1254,6 +1436,11 @@ void pqistreamer::allocate_rpend_locked()
         return;
 
     mPkt_rpend_size = getRsPktMaxSize();
+
+    if(mBio->readsAvailableData())
+        mPkt_rpend_size += PQISTREAM_READ_BUFFER_EXTRA_SIZE ;
+
+    mPkt_rpend_start = mPkt_rpend_end = 0 ;
     mPkt_rpending = rs_malloc(mPkt_rpend_size);
     
     if(mPkt_rpending == NULL)
@@ -1287,16 +1474,9 @@ void pqistreamer::free_pend_locked()
 		mPkt_rpending = 0;
 	}
 	mPkt_rpend_size = 0;
+	mPkt_rpend_start = mPkt_rpend_end = 0 ;
 
-	if (mPkt_wpending)
-	{
-#ifdef DEBUG_PQISTREAMER
-        		std::cerr << "pqistreamer::free_pend_locked(): pending output packet buffer" << std::endl;
-#endif
-		free(mPkt_wpending);
-		mPkt_wpending = NULL;
-	}
-	mPkt_wpending_size = 0 ;
+	free_wpending_locked() ;
 
 #ifdef DEBUG_PQISTREAMER
     if(!mPartialPackets.empty())
@@ -1392,6 +1572,7 @@ void *pqistreamer::locked_pop_out_data(uint32_t /*max_slice_size*/, uint32_t &si
 	{
 		res = *(mOutPkts.begin()); 
 		mOutPkts.pop_front();
+		size = getRsItemSize(res);
 #ifdef DEBUG_TRANSFERS
 		std::cerr << "pqistreamer::locked_pop_out_data() getting next pkt from mOutPkts queue";
 		std::cerr << std::endl;
@@ -110,6 +110,11 @@ class pqistreamer: public PQInterface
 		// via above interfaces.
 		virtual int	handleoutgoing_locked();
 		virtual int	handleincoming_locked();
+		int	handleincoming_buffered_locked(int maxin);	// used when mBio->readsAvailableData()
+
+		uint32_t readPacketHeader_locked(const void *block, bool& is_partial_packet, bool& is_packet_starting, bool& is_packet_ending, uint32_t& slice_packet_id);
+		void badPacketRead_locked(const void *block, uint32_t maxlen, uint32_t blen, uint32_t extralen);
+		void handleReadPacket_locked(void *block, uint32_t pktlen, bool is_partial_packet, bool is_packet_starting, bool is_packet_ending, uint32_t slice_packet_id);
 
 		// Bandwidth/Streaming Management.
 		float	outTimeSlice_locked();
@@ -126,13 +131,22 @@ class pqistreamer: public PQInterface
 		// RsSerialiser - determines which packets can be serialised.
 		RsSerialiser *mRsSerialiser;
 
-		void *mPkt_wpending; // storage for pending packet to write.
+		void *mPkt_wpending; // storage for pending packet to write, kept allocated between packets.
         	uint32_t mPkt_wpending_size; // ... and its size.
+        	uint32_t mPkt_wpending_capacity; // allocated size of mPkt_wpending
+        	bool mPkt_wpending_retry; // a write of mPkt_wpending failed, it has to be written again unchanged.
+        	double mPkt_wpending_flush_TS; // time at which a partly coalesced packet has to be sent (0 when none).
+        	bool mCoalescing; // bulk data is queued, packets are grouped up to the size of a TLS record.
+
+        void reserve_wpending_locked(uint32_t size); // grows mPkt_wpending to at least size bytes
+        void free_wpending_locked();
 
         void allocate_rpend_locked(); // use these two functions to allocate/free the buffer below
         
 		int   mPkt_rpend_size; // size of pkt_rpending.
 		void *mPkt_rpending; // storage for read in pending packets.
+		uint32_t mPkt_rpend_start; // with buffered reads: beginning of the data not parsed yet in mPkt_rpending,
+		uint32_t mPkt_rpend_end;   // ... and end of the data read so far.
 
 		enum {reading_state_packet_started=1,
 			reading_state_initial=0 } ;
@@ -0,0 +1,253 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: sslsessioncache.cc                                   *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include "pqi/sslsessioncache.h"
+#include "pqi/sslfns.h"
+
+#include <openssl/evp.h>
+
+// Telling resumable sessions apart (TLS 1.3 tickets) needs OpenSSL 1.1.1.
+// With older versions, connections just do a full handshake.
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L && !defined(LIBRESSL_VERSION_NUMBER)
+#	define RS_SSL_SESSION_RESUMPTION 1
+#endif
+
+/*#define DEBUG_SSL_SESSION_CACHE 1*/
+
+SslSessionCache::SslSessionCache(uint32_t lifetime, uint32_t max_sessions)
+    : mMtx("SslSessionCache"), mLifetime(lifetime), mMaxSessions(max_sessions) {}
+
+SslSessionCache::~SslSessionCache()
+{
+	clear();
+}
+
+int SslSessionCache::ctxIndex()
+{
+	static int index = SSL_CTX_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+	return index;
+}
+
+void SslSessionCache::setup(SSL_CTX *ctx)
+{
+#ifdef RS_SSL_SESSION_RESUMPTION
+	static const unsigned char sid_ctx[] = "RetroShare";
+
+	// without a session id context, a server that verifies its peers (SSL_VERIFY_PEER) refuses to resume sessions.
+	SSL_CTX_set_session_id_context(ctx, sid_ctx, sizeof(sid_ctx) - 1);
+	SSL_CTX_set_timeout(ctx, mLifetime);
+
+	// Server side, TLS 1.3 tickets need no storage and TLS 1.2 session ids are kept by OpenSSL's own cache.
+	// Client side, sessions are given to newSessionCallback() once established.
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_BOTH);
+	SSL_CTX_sess_set_cache_size(ctx, mMaxSessions);
+
+	SSL_CTX_set_ex_data(ctx, ctxIndex(), this);
+	SSL_CTX_sess_set_new_cb(ctx, &SslSessionCache::newSessionCallback);
+#else
+	(void) ctx;
+#endif
+}
+
+int SslSessionCache::newSessionCallback(SSL *ssl, SSL_SESSION *session)
+{
+	if(SSL_is_server(ssl))
+		return 0;
+
+	SslSessionCache *cache = static_cast<SslSessionCache*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ctxIndex()));
+
+	// returning 1 tells OpenSSL that we keep the reference to the session.
+	return (cache && cache->addSession(session)) ? 1 : 0;
+}
+
+bool SslSessionCache::addSession(SSL_SESSION *session)
+{
+#ifdef RS_SSL_SESSION_RESUMPTION
+	if(!SSL_SESSION_is_resumable(session))
+		return false;
+
+	RsPeerId sslId;
+	X509 *peer = SSL_SESSION_get0_peer(session);
+
+	if(!peer || !getX509id(peer, sslId) || sslId.isNull())
+		return false;
+
+	rstime_t now = time(NULL);
+
+	RS_STACK_MUTEX(mMtx);
+	locked_removeExpired(now);
+
+	std::map<RsPeerId, CachedSession>::iterator it = mSessions.find(sslId);
+
+	if(it != mSessions.end())
+		SSL_SESSION_free(it->second.mSession);
+	else if(mSessions.size() >= mMaxSessions)
+	{
+		// drop the oldest session
+		std::map<RsPeerId, CachedSession>::iterator oldest = mSessions.begin();
+
+		for(it = mSessions.begin(); it != mSessions.end(); ++it)
+			if(it->second.mTS < oldest->second.mTS)
+				oldest = it;
+
+		SSL_SESSION_free(oldest->second.mSession);
+		mSessions.erase(oldest);
+	}
+
+	CachedSession& cached(mSessions[sslId]);
+	cached.mSession = session;
+	cached.mTS = now;
+
+#ifdef DEBUG_SSL_SESSION_CACHE
+	std::cerr << __PRETTY_FUNCTION__ << " stored session for peer " << sslId << std::endl;
+#endif
+	return true;
+#else
+	(void) session;
+	return false;
+#endif
+}
+
+bool SslSessionCache::prepareConnection(SSL *ssl, const RsPeerId& sslId)
+{
+	RS_STACK_MUTEX(mMtx);
+	locked_removeExpired(time(NULL));
+
+	std::map<RsPeerId, CachedSession>::const_iterator it = mSessions.find(sslId);
+
+	if(it == mSessions.end())
+		return false;
+
+#ifdef DEBUG_SSL_SESSION_CACHE
+	std::cerr << __PRETTY_FUNCTION__ << " resuming session with peer " << sslId << std::endl;
+#endif
+	return SSL_set_session(ssl, it->second.mSession) == 1;
+}
+
+void SslSessionCache::removeSession(const RsPeerId& sslId)
+{
+	RS_STACK_MUTEX(mMtx);
+
+	std::map<RsPeerId, CachedSession>::iterator it = mSessions.find(sslId);
+
+	if(it != mSessions.end())
+	{
+		SSL_SESSION_free(it->second.mSession);
+		mSessions.erase(it);
+	}
+}
+
+void SslSessionCache::clear()
+{
+	RS_STACK_MUTEX(mMtx);
+
+	for(std::map<RsPeerId, CachedSession>::iterator it = mSessions.begin(); it != mSessions.end(); ++it)
+		SSL_SESSION_free(it->second.mSession);
+
+	mSessions.clear();
+}
+
+uint32_t SslSessionCache::size()
+{
+	RS_STACK_MUTEX(mMtx);
+	return mSessions.size();
+}
+
+void SslSessionCache::locked_removeExpired(rstime_t now)
+{
+	for(std::map<RsPeerId, CachedSession>::iterator it = mSessions.begin(); it != mSessions.end();)
+		if(it->second.mTS + mLifetime < now)
+		{
+			SSL_SESSION_free(it->second.mSession);
+			it = mSessions.erase(it);
+		}
+		else
+			++it;
+}
+
+SslCertAuthCache::SslCertAuthCache(uint32_t lifetime, uint32_t max_certs)
+    : mMtx("SslCertAuthCache"), mLifetime(lifetime), mMaxCerts(max_certs) {}
+
+bool SslCertAuthCache::certDigest(X509 *x509, Sha256CheckSum& digest)
+{
+	unsigned char md[EVP_MAX_MD_SIZE];
+	unsigned int len = 0;
+
+	// the digest covers the whole certificate, signature included.
+	if(!X509_digest(x509, EVP_sha256(), md, &len) || len != Sha256CheckSum::SIZE_IN_BYTES)
+		return false;
+
+	digest = Sha256CheckSum::fromBufferUnsafe(md);
+	return true;
+}
+
+bool SslCertAuthCache::isAuthenticated(X509 *x509)
+{
+	Sha256CheckSum digest;
+
+	if(!certDigest(x509, digest))
+		return false;
+
+	RS_STACK_MUTEX(mMtx);
+
+	std::map<Sha256CheckSum, rstime_t>::iterator it = mCerts.find(digest);
+
+	if(it == mCerts.end())
+		return false;
+
+	if(it->second + mLifetime < time(NULL))
+	{
+		mCerts.erase(it);
+		return false;
+	}
+	return true;
+}
+
+void SslCertAuthCache::setAuthenticated(X509 *x509)
+{
+	Sha256CheckSum digest;
+
+	if(!certDigest(x509, digest))
+		return;
+
+	rstime_t now = time(NULL);
+
+	RS_STACK_MUTEX(mMtx);
+
+	if(mCerts.size() >= mMaxCerts && mCerts.find(digest) == mCerts.end())
+	{
+		std::map<Sha256CheckSum, rstime_t>::iterator oldest = mCerts.begin();
+
+		for(std::map<Sha256CheckSum, rstime_t>::iterator it = mCerts.begin(); it != mCerts.end(); ++it)
+			if(it->second < oldest->second)
+				oldest = it;
+
+		mCerts.erase(oldest);
+	}
+	mCerts[digest] = now;
+}
+
+void SslCertAuthCache::clear()
+{
+	RS_STACK_MUTEX(mMtx);
+	mCerts.clear();
+}
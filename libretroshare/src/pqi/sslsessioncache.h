@@ -0,0 +1,115 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: sslsessioncache.h                                    *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <map>
+
+#include "retroshare/rsids.h"
+#include "util/rsthreads.h"
+#include "util/rstime.h"
+
+/*!
+ * Keeps the TLS session of the last connection to each friend, so that
+ * reconnecting to a friend that dropped recently resumes the session instead
+ * of doing a full handshake (key exchange, certificate and PGP signature
+ * verification).
+ * Sessions are keyed by the SSL id of the peer certificate they were
+ * established with, and expire after a bounded lifetime.
+ * Beware that OpenSSL doesn't call the certificate verification callback for
+ * resumed sessions, so the peer of a resumed session must be checked again.
+ */
+class SslSessionCache
+{
+public:
+	/*!
+	 * @param lifetime max age of the sessions, in seconds
+	 * @param max_sessions max number of sessions kept
+	 */
+	SslSessionCache(uint32_t lifetime, uint32_t max_sessions);
+	~SslSessionCache();
+
+	/*!
+	 * Enables session resumption on both client and server sides of the
+	 * connections created from ctx, and collects the client sessions.
+	 * The cache must outlive ctx.
+	 */
+	void setup(SSL_CTX *ctx);
+
+	/*!
+	 * Offers the cached session of the given peer, if any, for the
+	 * handshake of a client connection.
+	 * @return true if a session was set
+	 */
+	bool prepareConnection(SSL *ssl, const RsPeerId& sslId);
+
+	void removeSession(const RsPeerId& sslId);
+	void clear();
+	uint32_t size();
+
+private:
+	static int newSessionCallback(SSL *ssl, SSL_SESSION *session);
+	static int ctxIndex();
+
+	bool addSession(SSL_SESSION *session);
+	void locked_removeExpired(rstime_t now);
+
+	struct CachedSession
+	{
+		SSL_SESSION *mSession;
+		rstime_t mTS;
+	};
+
+	RsMutex mMtx;
+	uint32_t mLifetime;
+	uint32_t mMaxSessions;
+	std::map<RsPeerId, CachedSession> mSessions;
+};
+
+/*!
+ * Remembers the certificates whose PGP signature was successfully verified,
+ * by digest of the whole certificate, so that the signature of a
+ * reconnecting friend's certificate is not verified again and again.
+ */
+class SslCertAuthCache
+{
+public:
+	/*!
+	 * @param lifetime time after which a certificate is verified again, in seconds
+	 * @param max_certs max number of certificates kept
+	 */
+	SslCertAuthCache(uint32_t lifetime, uint32_t max_certs);
+
+	bool isAuthenticated(X509 *x509);
+	void setAuthenticated(X509 *x509);
+	void clear();
+
+private:
+	static bool certDigest(X509 *x509, Sha256CheckSum& digest);
+
+	RsMutex mMtx;
+	uint32_t mLifetime;
+	uint32_t mMaxCerts;
+	std::map<Sha256CheckSum, rstime_t> mCerts;
+};
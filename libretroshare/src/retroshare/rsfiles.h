@@ -619,6 +619,22 @@ public:
         virtual void setMaxShareDepth(int depth) =0;
         virtual int  maxShareDepth() const=0;
 
+		/**
+		 * @brief Set how much memory friends file lists can use, in MB. Least
+		 * recently used lists are unloaded from memory above that, and loaded
+		 * again from disk when needed.
+		 * @jsonapi{development}
+		 * @param[in] mb memory budget in MB, 0 means no limit
+		 */
+		virtual void setRemoteFileListsMemoryBudget(uint32_t mb) = 0;
+
+		/**
+		 * @brief Get how much memory friends file lists can use, in MB
+		 * @jsonapi{development}
+		 * @return memory budget in MB, 0 means no limit
+		 */
+		virtual uint32_t remoteFileListsMemoryBudget() const = 0;
+
 		virtual bool	ignoreDuplicates() = 0;
 		virtual void 	setIgnoreDuplicates(bool ignore) = 0;
 };
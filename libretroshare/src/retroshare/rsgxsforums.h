@@ -97,6 +97,37 @@ struct RsGxsForumMsg : RsSerializable
 };
 
 
+/** Forum message with its position in the discussion tree, as kept by the
+ * forum thread index. @see RsGxsForums::getForumThreadsPage */
+struct RsGxsForumThreadEntry : RsSerializable
+{
+	RsGxsForumThreadEntry() :
+	    mLastActivityTs(0), mChildrenCount(0), mDescendantsCount(0) {}
+	virtual ~RsGxsForumThreadEntry() {}
+
+	RsMsgMetaData mMeta;
+
+	/// Most recent publish time in the subtree rooted at this message
+	rstime_t mLastActivityTs;
+
+	/// Number of direct replies to this message
+	uint32_t mChildrenCount;
+
+	/// Number of messages in the subtree, this message excluded
+	uint32_t mDescendantsCount;
+
+	/// @see RsSerializable
+	virtual void serial_process( RsGenericSerializer::SerializeJob j,
+	                             RsGenericSerializer::SerializeContext& ctx )
+	{
+		RS_SERIAL_PROCESS(mMeta);
+		RS_SERIAL_PROCESS(mLastActivityTs);
+		RS_SERIAL_PROCESS(mChildrenCount);
+		RS_SERIAL_PROCESS(mDescendantsCount);
+	}
+};
+
+
 class RsGxsForums: public RsGxsIfaceHelper
 {
 public:
@@ -157,6 +188,36 @@ public:
 	virtual bool getForumMsgMetaData( const RsGxsGroupId& forumId,
 	                                  std::vector<RsMsgMetaData>& msgMetas) = 0;
 
+	/**
+	 * @brief Get a page of the top level threads of a forum, most recently
+	 *	active first. Only the metadata of the returned threads is loaded, so
+	 *	the cost doesn't depend on the size of the forum. Blocking API
+	 * @jsonapi{development}
+	 * @param[in] forumId id of the forum of which the threads are requested
+	 * @param[in] offset number of threads to skip
+	 * @param[in] count maximum number of threads to return
+	 * @param[out] threads storage for the threads root messages
+	 * @param[out] threadsCount total number of top level threads in the forum
+	 * @return false if something failed, true otherwhise
+	 */
+	virtual bool getForumThreadsPage(
+	        const RsGxsGroupId& forumId, uint32_t offset, uint32_t count,
+	        std::vector<RsGxsForumThreadEntry>& threads,
+	        uint32_t& threadsCount ) = 0;
+
+	/**
+	 * @brief Get a message and all the replies below it, parents always come
+	 *	before their children. Blocking API
+	 * @jsonapi{development}
+	 * @param[in] forumId id of the forum the message belongs to
+	 * @param[in] msgId id of the root of the requested subtree
+	 * @param[out] msgs storage for the subtree messages meta data
+	 * @return false if something failed, true otherwhise
+	 */
+	virtual bool getForumSubtree(
+	        const RsGxsGroupId& forumId, const RsGxsMessageId& msgId,
+	        std::vector<RsGxsForumThreadEntry>& msgs ) = 0;
+
 	/**
 	 * @brief Get specific list of messages from a single forums. Blocking API
 	 * @jsonapi{development}
@@ -290,7 +290,8 @@ protected:
 	 * Useful for blocking API implementation.
 	 * @param[in] token token associated to the request caller is waiting for
 	 * @param[in] maxWait maximum waiting time in milliseconds
-	 * @param[in] checkEvery time in millisecond between status checks
+	 * @param[in] checkEvery time in millisecond between status checks, only
+	 *	used if the token service cannot signal completion by itself
 	 */
 	RsTokenService::GxsRequestStatus waitToken(
 	        uint32_t token,
@@ -302,14 +303,7 @@ protected:
 		int maxWorkAroundCnt = 10;
 LLwaitTokenBeginLabel:
 #endif
-		auto timeout = std::chrono::steady_clock::now() + maxWait;
-		auto st = requestStatus(token);
-		while( !(st == RsTokenService::FAILED || st >= RsTokenService::COMPLETE)
-		       && std::chrono::steady_clock::now() < timeout )
-		{
-			std::this_thread::sleep_for(checkEvery);
-			st = requestStatus(token);
-		}
+		auto st = mTokenService.waitToken(token, maxWait, checkEvery);
 
 #if defined(__ANDROID__) && (__ANDROID_API__ < 24)
 		/* Work around for very slow/old android devices, we don't expect this
@@ -44,6 +44,7 @@
 #define RS_MSG_SENTBOX         0x01     /* Sentbox */
 #define RS_MSG_OUTBOX          0x03     /* Outbox */
 #define RS_MSG_DRAFTBOX        0x05     /* Draftbox */
+#define RS_MSG_ALLBOXES        0xffffffff /* Any box, trash included */
 
 #define RS_MSG_NEW                   0x000010   /* New */
 #define RS_MSG_TRASH                 0x000020   /* Trash */
@@ -514,6 +515,23 @@ public:
 	 */
 	virtual bool getMessageSummaries(std::list<Rs::Msgs::MsgInfoSummary> &msgList) = 0;
 
+	/**
+	 * @brief Get a page of message summaries, newest first. Meant for
+	 *	mailboxes too big to be listed at once.
+	 * @jsonapi{development}
+	 * @param[in] box one of RS_MSG_INBOX, RS_MSG_SENTBOX, RS_MSG_OUTBOX,
+	 *	RS_MSG_DRAFTBOX, RS_MSG_TRASH or RS_MSG_ALLBOXES
+	 * @param[in] tagId list only messages with this tag, 0 for any
+	 * @param[in] offset number of messages to skip
+	 * @param[in] count maximum number of messages to list, 0 for no limit
+	 * @param[out] msgList storage for the summaries
+	 * @param[out] total number of messages matching box and tag
+	 * @return false on error, true otherwise
+	 */
+	virtual bool getMessageSummariesPage(
+	        uint32_t box, uint32_t tagId, uint32_t offset, uint32_t count,
+	        std::list<Rs::Msgs::MsgInfoSummary>& msgList, uint32_t& total ) = 0;
+
 	/**
 	 * @brief getMessage
 	 * @jsonapi{development}
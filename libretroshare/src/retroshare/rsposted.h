@@ -103,6 +103,22 @@ virtual bool createPost(uint32_t &token, RsPostedPost &post) = 0;
 virtual bool updateGroup(uint32_t &token, RsPostedGroup &group) = 0;
 
     virtual bool groupShareKeys(const RsGxsGroupId& group,const std::set<RsPeerId>& peers) = 0 ;
+
+	/**
+	 * @brief Get the best ranked posts of a board. Scores are kept in an
+	 *	index updated as votes and comments arrive, so only the returned
+	 *	posts are loaded. Blocking API.
+	 * @param[in] boardId id of the board
+	 * @param[in] rank ranking to use, new, top or hot
+	 * @param[in] offset number of best ranked posts to skip
+	 * @param[in] count maximum number of posts to return
+	 * @param[out] posts storage for the posts, best ranked first
+	 * @return false if something failed, true otherwhise
+	 */
+	virtual bool getBoardRankedPosts( const RsGxsGroupId& boardId,
+	                                  RankType rank, uint32_t offset,
+	                                  uint32_t count,
+	                                  std::vector<RsPostedPost>& posts ) = 0;
 };
 
 
@@ -25,6 +25,8 @@
 #include <inttypes.h>
 #include <string>
 #include <list>
+#include <chrono>
+#include <thread>
 
 #include "retroshare/rsgxsifacetypes.h"
 #include "util/rsdeprecate.h"
@@ -193,6 +195,31 @@ public:
      */
 	virtual GxsRequestStatus requestStatus(const uint32_t token) = 0;
 
+	/*!
+	 * @brief Block until the request is completed, failed or maxWait expires.
+	 * This default implementation polls requestStatus() every checkEvery,
+	 * implementations able to signal completion wake the caller as soon as
+	 * the request is served instead.
+	 * @param token value of token to wait for
+	 * @param maxWait maximum time to wait
+	 * @param checkEvery polling period, if polling is needed
+	 * @return the status of request when returning
+	 */
+	virtual GxsRequestStatus waitToken(
+	        uint32_t token, std::chrono::milliseconds maxWait,
+	        std::chrono::milliseconds checkEvery = std::chrono::milliseconds(2) )
+	{
+		auto timeout = std::chrono::steady_clock::now() + maxWait;
+		auto st = requestStatus(token);
+		while( !(st == FAILED || st >= COMPLETE)
+		       && std::chrono::steady_clock::now() < timeout )
+		{
+			std::this_thread::sleep_for(checkEvery);
+			st = requestStatus(token);
+		}
+		return st;
+	}
+
     /*!
      * This request statistics on amount of data held
      * number of groups
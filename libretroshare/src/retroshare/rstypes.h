@@ -422,6 +422,9 @@ struct FileChunksInfo : RsSerializable
 	/// The list of pending requests, chunk per chunk (by chunk id)
 	std::map<uint32_t, std::vector<SliceInfo> > pending_slices;
 
+	/// For each source peer, the measured download rate in bytes per second
+	std::map<RsPeerId, uint32_t> source_rates;
+
 	/// @see RsSerializable
 	void serial_process(RsGenericSerializer::SerializeJob j,
 	                    RsGenericSerializer::SerializeContext& ctx)
@@ -433,6 +436,7 @@ struct FileChunksInfo : RsSerializable
 		RS_SERIAL_PROCESS(compressed_peer_availability_maps);
 		RS_SERIAL_PROCESS(active_chunks);
 		//RS_SERIAL_PROCESS(pending_slices);
+		RS_SERIAL_PROCESS(source_rates);
 	}
 };
 
@@ -39,6 +39,7 @@ const uint8_t RsNxsSyncGrpItem::FLAG_USE_SYNC_HASH       = 0x0001;
 const uint8_t RsNxsSyncMsgItem::FLAG_USE_SYNC_HASH       = 0x0001;
 
 const uint8_t RsNxsSyncMsgReqItem::FLAG_USE_HASHED_GROUP_ID = 0x02;
+const uint8_t RsNxsSyncMsgReqItem::FLAG_ACCEPTS_ENCRYPTED_BATCH = 0x04;
 
 /** transaction state **/
 const uint16_t RsNxsTransacItem::FLAG_BEGIN_P1         = 0x0001;
@@ -48,6 +49,7 @@ const uint16_t RsNxsTransacItem::FLAG_CANCEL           = 0x0008;
 const uint16_t RsNxsTransacItem::FLAG_END_FAIL_NUM     = 0x0010;
 const uint16_t RsNxsTransacItem::FLAG_END_FAIL_TIMEOUT = 0x0020;
 const uint16_t RsNxsTransacItem::FLAG_END_FAIL_FULL    = 0x0040;
+const uint16_t RsNxsTransacItem::FLAG_FRAGMENT_ACK     = 0x0080;
 
 
 /** transaction type **/
@@ -58,6 +60,7 @@ const uint16_t RsNxsTransacItem::FLAG_TYPE_MSG_LIST_REQ   = 0x0800;
 const uint16_t RsNxsTransacItem::FLAG_TYPE_GRPS           = 0x1000;
 const uint16_t RsNxsTransacItem::FLAG_TYPE_MSGS           = 0x2000;
 const uint16_t RsNxsTransacItem::FLAG_TYPE_ENCRYPTED_DATA = 0x4000;
+const uint16_t RsNxsTransacItem::FLAG_ENCRYPTED_BATCH     = 0x8000;
 
 RsItem *RsNxsSerialiser::create_item(uint16_t service_id,uint8_t item_subtype) const
 {
@@ -70,6 +73,9 @@ RsItem *RsNxsSerialiser::create_item(uint16_t service_id,uint8_t item_subtype) c
         case RS_PKT_SUBTYPE_NXS_SYNC_GRP_ITEM:       return new RsNxsSyncGrpItem(SERVICE_TYPE) ;
         case RS_PKT_SUBTYPE_NXS_SYNC_MSG_REQ_ITEM:   return new RsNxsSyncMsgReqItem(SERVICE_TYPE) ;
         case RS_PKT_SUBTYPE_NXS_SYNC_MSG_ITEM:       return new RsNxsSyncMsgItem(SERVICE_TYPE) ;
+        case RS_PKT_SUBTYPE_NXS_SYNC_MSG_BATCH_REQ_ITEM: return new RsNxsSyncMsgBatchReqItem(SERVICE_TYPE) ;
+        case RS_PKT_SUBTYPE_NXS_SYNC_MSG_DIGEST_ITEM:    return new RsNxsSyncMsgDigestItem(SERVICE_TYPE) ;
+        case RS_PKT_SUBTYPE_NXS_MSG_ANNOUNCE_ITEM:       return new RsNxsMsgAnnounceItem(SERVICE_TYPE) ;
         case RS_PKT_SUBTYPE_NXS_GRP_ITEM:            return new RsNxsGrp(SERVICE_TYPE) ;
         case RS_PKT_SUBTYPE_NXS_MSG_ITEM:            return new RsNxsMsg(SERVICE_TYPE) ;
         case RS_PKT_SUBTYPE_NXS_TRANSAC_ITEM:        return new RsNxsTransacItem(SERVICE_TYPE) ;
@@ -152,6 +158,19 @@ void RsNxsSyncMsgReqItem::serial_process(RsGenericSerializer::SerializeJob j,RsG
     RsTypeSerializer::serial_process          (j,ctx,grpId            ,"grpId") ;
     RsTypeSerializer::serial_process<uint32_t>(j,ctx,updateTS         ,"updateTS") ;
 }
+void RsNxsSyncMsgBatchReqItem::serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx)
+{
+    RsTypeSerializer::serial_process<uint8_t> (j,ctx,flag             ,"flag") ;
+    RsTypeSerializer::serial_process          (j,ctx,groups           ,"groups") ;
+}
+void RsNxsSyncMsgDigestItem::serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx)
+{
+    RsTypeSerializer::serial_process          (j,ctx,changedGroups    ,"changedGroups") ;
+}
+void RsNxsMsgAnnounceItem::serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx)
+{
+    RsTypeSerializer::serial_process          (j,ctx,msgs             ,"msgs") ;
+}
 void RsNxsGroupPublishKeyItem::serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx)
 {
     RsTypeSerializer::serial_process           (j,ctx,grpId            ,"grpId") ;
@@ -215,6 +234,11 @@ void RsNxsSyncMsgReqItem::clear()
     syncHash.clear();
     updateTS = 0;
 }
+void RsNxsSyncMsgBatchReqItem::clear()
+{
+    flag = 0;
+    groups.clear();
+}
 void RsNxsSyncGrpItem::clear()
 {
     flag = 0;
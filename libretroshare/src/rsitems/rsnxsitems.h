@@ -41,7 +41,10 @@ const uint8_t RS_PKT_SUBTYPE_NXS_SYNC_GRP_STATS_ITEM  = 0x03;
 const uint8_t RS_PKT_SUBTYPE_NXS_GRP_ITEM             = 0x04;
 const uint8_t RS_PKT_SUBTYPE_NXS_ENCRYPTED_DATA_ITEM  = 0x05;
 const uint8_t RS_PKT_SUBTYPE_NXS_SESSION_KEY_ITEM     = 0x06;
+const uint8_t RS_PKT_SUBTYPE_NXS_SYNC_MSG_BATCH_REQ_ITEM = 0x07;
 const uint8_t RS_PKT_SUBTYPE_NXS_SYNC_MSG_ITEM        = 0x08;
+const uint8_t RS_PKT_SUBTYPE_NXS_SYNC_MSG_DIGEST_ITEM = 0x09;
+const uint8_t RS_PKT_SUBTYPE_NXS_MSG_ANNOUNCE_ITEM    = 0x0a;
 const uint8_t RS_PKT_SUBTYPE_NXS_SYNC_MSG_REQ_ITEM    = 0x10;
 const uint8_t RS_PKT_SUBTYPE_NXS_MSG_ITEM             = 0x20;
 const uint8_t RS_PKT_SUBTYPE_NXS_TRANSAC_ITEM         = 0x40;
@@ -167,6 +170,7 @@ public:
     static const uint16_t FLAG_END_FAIL_NUM;
     static const uint16_t FLAG_END_FAIL_TIMEOUT;
     static const uint16_t FLAG_END_FAIL_FULL;
+    static const uint16_t FLAG_FRAGMENT_ACK; // nItems items of an incoming transaction were received so far
 
 
     /** transaction type **/
@@ -178,6 +182,9 @@ public:
     static const uint16_t FLAG_TYPE_MSGS;
     static const uint16_t FLAG_TYPE_ENCRYPTED_DATA;
 
+    /// the transaction starts with session key items, and all its encrypted items use these keys
+    static const uint16_t FLAG_ENCRYPTED_BATCH;
+
     explicit RsNxsTransacItem(uint16_t servtype) : RsNxsItem(servtype, RS_PKT_SUBTYPE_NXS_TRANSAC_ITEM) { clear(); }
     virtual ~RsNxsTransacItem() {}
 
@@ -323,6 +330,7 @@ public:
     static const uint8_t FLAG_USE_SYNC_HASH;
 #endif
     static const uint8_t FLAG_USE_HASHED_GROUP_ID;
+    static const uint8_t FLAG_ACCEPTS_ENCRYPTED_BATCH; // the requesting peer can decrypt FLAG_ENCRYPTED_BATCH transactions
 
     explicit RsNxsSyncMsgReqItem(uint16_t servtype) : RsNxsItem(servtype, RS_PKT_SUBTYPE_NXS_SYNC_MSG_REQ_ITEM) { clear(); }
 
@@ -337,6 +345,88 @@ public:
     std::string syncHash;
 };
 
+/*!
+ * Use to ask a peer which of many groups have new messages, in a single item
+ * instead of one RsNxsSyncMsgReqItem per group. Only sent to peers whose
+ * service version says they understand it. The peer answers with a single
+ * RsNxsSyncMsgDigestItem, and the message lists of the groups it names are
+ * then requested with RsNxsSyncMsgReqItem as usual.
+ */
+class RsNxsSyncMsgBatchReqItem : public RsNxsItem
+{
+public:
+    struct GroupEntry : RsSerializable
+    {
+        GroupEntry() : updateTS(0) {}
+
+        RsGxsGroupId grpId;
+        uint32_t updateTS; // time of last update received from that peer for this group
+
+		/// @see RsSerializable
+		void serial_process(RsGenericSerializer::SerializeJob j,
+		                    RsGenericSerializer::SerializeContext& ctx)
+		{
+			RS_SERIAL_PROCESS(grpId);
+			RS_SERIAL_PROCESS(updateTS);
+		}
+    };
+
+    explicit RsNxsSyncMsgBatchReqItem(uint16_t servtype) : RsNxsItem(servtype, RS_PKT_SUBTYPE_NXS_SYNC_MSG_BATCH_REQ_ITEM) { clear(); }
+
+    virtual void clear();
+
+	virtual void serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx);
+
+    uint8_t flag; // same flags as RsNxsSyncMsgReqItem, hashed group ids excepted
+    std::vector<GroupEntry> groups;
+};
+
+/*!
+ * Answer to RsNxsSyncMsgBatchReqItem: the requested groups that have messages
+ * more recent than the time stamp the requester sent.
+ */
+class RsNxsSyncMsgDigestItem : public RsNxsItem
+{
+public:
+    explicit RsNxsSyncMsgDigestItem(uint16_t servtype) : RsNxsItem(servtype, RS_PKT_SUBTYPE_NXS_SYNC_MSG_DIGEST_ITEM) { clear(); }
+
+    virtual void clear() { changedGroups.clear(); }
+
+	virtual void serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx);
+
+    std::vector<RsGxsGroupId> changedGroups;
+};
+
+/*!
+ * Pushed to the suppliers of a group as soon as new messages are stored, so
+ * that they do not have to wait for the next sync period to request them.
+ */
+class RsNxsMsgAnnounceItem : public RsNxsItem
+{
+public:
+    struct MsgEntry : RsSerializable
+    {
+        RsGxsGroupId grpId;
+        RsGxsMessageId msgId;
+
+		/// @see RsSerializable
+		void serial_process(RsGenericSerializer::SerializeJob j,
+		                    RsGenericSerializer::SerializeContext& ctx)
+		{
+			RS_SERIAL_PROCESS(grpId);
+			RS_SERIAL_PROCESS(msgId);
+		}
+    };
+
+    explicit RsNxsMsgAnnounceItem(uint16_t servtype) : RsNxsItem(servtype, RS_PKT_SUBTYPE_NXS_MSG_ANNOUNCE_ITEM) { clear(); }
+
+    virtual void clear() { msgs.clear(); }
+
+	virtual void serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx);
+
+    std::vector<MsgEntry> msgs;
+};
+
 /*!
  * Use to send list msgs for a group held by
  * a peer
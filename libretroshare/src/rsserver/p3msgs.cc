@@ -270,6 +270,14 @@ bool p3Msgs::getMessageSummaries(std::list<MsgInfoSummary> &msgList)
 	return mMsgSrv->getMessageSummaries(msgList);
 }
 
+bool p3Msgs::getMessageSummariesPage(
+        uint32_t box, uint32_t tagId, uint32_t offset, uint32_t count,
+        std::list<MsgInfoSummary>& msgList, uint32_t& total )
+{
+	return mMsgSrv->getMessageSummariesPage( box, tagId, offset, count,
+	                                         msgList, total );
+}
+
 
 uint32_t p3Msgs::getDistantMessagingPermissionFlags()
 {
@@ -51,6 +51,9 @@ class p3Msgs: public RsMsgs
 	   * @param msgList ref to list summarising client's msgs
 	   */
 	  virtual bool getMessageSummaries(std::list<Rs::Msgs::MsgInfoSummary> &msgList);
+	  virtual bool getMessageSummariesPage(
+	          uint32_t box, uint32_t tagId, uint32_t offset, uint32_t count,
+	          std::list<Rs::Msgs::MsgInfoSummary>& msgList, uint32_t& total );
 	  virtual bool getMessage(const std::string &mId, Rs::Msgs::MessageInfo &msg);
 	  virtual void getMessageCount(uint32_t &nInbox, uint32_t &nInboxNew, uint32_t &nOutbox, uint32_t &nDraftbox, uint32_t &nSentbox, uint32_t &nTrashbox);
 
@@ -116,7 +116,8 @@ RsAccounts* rsAccounts = nullptr;
 
 struct RsInitConfig
 {
-	RsInitConfig() : jsonApiPort(0), jsonApiBindAddress("127.0.0.1") {}
+	RsInitConfig() :
+	    jsonApiPort(0), jsonApiBindAddress("127.0.0.1"), jsonApiWorkers(0) {}
 
 	RsFileHash main_executable_hash;
 
@@ -160,6 +161,7 @@ struct RsInitConfig
 
 		uint16_t jsonApiPort;
 		std::string jsonApiBindAddress;
+		uint32_t jsonApiWorkers;
 };
 
 static RsInitConfig* rsInitConfig = nullptr;
@@ -310,7 +312,11 @@ int RsInit::InitRetroShare(int argc, char **argv, bool /* strictCheck */)
 	            "Enable JSON API on the specified port", false )
 	        >> parameter(
 	               "jsonApiBindAddress", rsInitConfig->jsonApiBindAddress,
-	               "jsonApiBindAddress", "JSON API Bind Address.", false);
+	               "jsonApiBindAddress", "JSON API Bind Address.", false)
+	        >> parameter(
+	               "jsonApiWorkers", rsInitConfig->jsonApiWorkers,
+	               "jsonApiWorkers",
+	               "Number of JSON API worker threads (0 = automatic).", false);
 #endif // ifdef RS_JSONAPI
 
 #ifdef LOCALNET_TESTING
@@ -447,7 +453,9 @@ int RsInit::InitRetroShare(int argc, char **argv, bool /* strictCheck */)
 	{
 		jsonApiServer = new JsonApiServer(
 		            rsInitConfig->jsonApiPort,
-		            rsInitConfig->jsonApiBindAddress );
+		            rsInitConfig->jsonApiBindAddress,
+		            [](const std::string&){ return false; },
+		            rsInitConfig->jsonApiWorkers );
 		jsonApiServer->start("JSON API Server");
 	}
 #endif // ifdef RS_JSONAPI
@@ -1325,7 +1333,9 @@ int RsServer::StartupRetroShare()
                         RS_SERVICE_GXS_TYPE_POSTED, 
 			NULL, rsInitConfig->gxs_passwd);
 
-        p3Posted *mPosted = new p3Posted(posted_ds, NULL, mGxsIdService);
+        p3Posted *mPosted = new p3Posted(posted_ds, NULL, mGxsIdService,
+                                         currGxsDir + "/posted_ranking_db",
+                                         rsInitConfig->gxs_passwd);
 
         // create GXS photo service
         RsGxsNetService* posted_ns = new RsGxsNetService(
@@ -1334,6 +1344,11 @@ int RsServer::StartupRetroShare()
 			mReputations, mGxsCircles,mGxsIdService,
 			pgpAuxUtils);
 
+		// sync protocol extensions, each used with the peers whose negotiated service version introduced it
+		posted_ns->setBatchedSyncMinVersion(1, RsGxsNetService::BATCHED_SYNC_MINOR_VERSION);
+		posted_ns->setPushAnnounceMinVersion(1, RsGxsNetService::MSG_ANNOUNCE_MINOR_VERSION);
+		posted_ns->setFragmentedMsgMinVersion(1, RsGxsNetService::FRAGMENTED_MSG_MINOR_VERSION);
+
 		mPosted->setNetworkExchangeService(posted_ns) ;
 
         /**** Wiki GXS service ****/
@@ -1360,7 +1375,9 @@ int RsServer::StartupRetroShare()
                                                             RS_SERVICE_GXS_TYPE_FORUMS, NULL, rsInitConfig->gxs_passwd);
 
 
-        p3GxsForums *mGxsForums = new p3GxsForums(gxsforums_ds, NULL, mGxsIdService);
+        p3GxsForums *mGxsForums = new p3GxsForums(gxsforums_ds, NULL, mGxsIdService,
+                                                  currGxsDir + "/gxsforums_threads_db",
+                                                  rsInitConfig->gxs_passwd);
 
         // create GXS photo service
         RsGxsNetService* gxsforums_ns = new RsGxsNetService(
@@ -1369,13 +1386,21 @@ int RsServer::StartupRetroShare()
 			mReputations, mGxsCircles,mGxsIdService,
 		    pgpAuxUtils);//,mGxsNetTunnel,true,true,true);
 
+        // sync protocol extensions, each used with the peers whose negotiated service version introduced it
+        gxsforums_ns->setBatchedSyncMinVersion(1, RsGxsNetService::BATCHED_SYNC_MINOR_VERSION);
+        gxsforums_ns->setPushAnnounceMinVersion(1, RsGxsNetService::MSG_ANNOUNCE_MINOR_VERSION);
+        gxsforums_ns->setFragmentedMsgMinVersion(1, RsGxsNetService::FRAGMENTED_MSG_MINOR_VERSION);
+
     mGxsForums->setNetworkExchangeService(gxsforums_ns) ;
 
         /**** Channel GXS service ****/
 
-        RsGeneralDataService* gxschannels_ds = new RsDataService(currGxsDir + "/", "gxschannels_db",
+        RsDataService* gxschannels_ds = new RsDataService(currGxsDir + "/", "gxschannels_db",
                                                             RS_SERVICE_GXS_TYPE_CHANNELS, NULL, rsInitConfig->gxs_passwd);
 
+        // Channel posts often carry images and files, keep the big ones out of the database
+        gxschannels_ds->setExternalDataThreshold(32 * 1024);
+
         p3GxsChannels *mGxsChannels = new p3GxsChannels(gxschannels_ds, NULL, mGxsIdService);
 
         // create GXS photo service
@@ -1385,6 +1410,11 @@ int RsServer::StartupRetroShare()
 		            mReputations, mGxsCircles,mGxsIdService,
 		    		pgpAuxUtils,mGxsNetTunnel,true,true,true);
 
+        // sync protocol extensions, each used with the peers whose negotiated service version introduced it
+        gxschannels_ns->setBatchedSyncMinVersion(1, RsGxsNetService::BATCHED_SYNC_MINOR_VERSION);
+        gxschannels_ns->setPushAnnounceMinVersion(1, RsGxsNetService::MSG_ANNOUNCE_MINOR_VERSION);
+        gxschannels_ns->setFragmentedMsgMinVersion(1, RsGxsNetService::FRAGMENTED_MSG_MINOR_VERSION);
+
     mGxsChannels->setNetworkExchangeService(gxschannels_ns) ;
 
 #if 0 // PHOTO IS DISABLED FOR THE MOMENT
@@ -1444,16 +1474,19 @@ int RsServer::StartupRetroShare()
 	pqih->addService(gxstrans_ns, true);
 #	endif // RS_GXS_TRANS
 
-	// remove pword from memory
-	rsInitConfig->gxs_passwd = "";
-
 #endif // RS_ENABLE_GXS.
 
 	/* create Services */
 	p3ServiceInfo *serviceInfo = new p3ServiceInfo(serviceCtrl);
 	mDisc = new p3discovery2(mPeerMgr, mLinkMgr, mNetMgr, serviceCtrl,mGxsIdService);
 	mHeart = new p3heartbeat(serviceCtrl, pqih);
-	msgSrv = new p3MsgService( serviceCtrl, mGxsIdService, *mGxsTrans );
+	msgSrv = new p3MsgService( serviceCtrl, mGxsIdService, *mGxsTrans,
+	                           RsAccounts::AccountDirectory() + "/msgs_db",
+	                           rsInitConfig->gxs_passwd );
+
+	// remove pword from memory
+	rsInitConfig->gxs_passwd = "";
+
 	chatSrv = new p3ChatService( serviceCtrl,mGxsIdService, mLinkMgr,
 	                             mHistoryMgr, *mGxsTrans );
 	mStatusSrv = new p3StatusService(serviceCtrl);
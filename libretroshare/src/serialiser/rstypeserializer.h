@@ -35,6 +35,7 @@
 
 #include <typeinfo> // for typeid
 #include <type_traits>
+#include <memory>
 #include <errno.h>
 
 
@@ -791,7 +792,103 @@ struct RsTypeSerializer
 		serial_process(j, ctx, static_cast<RsTlvItem&>(member), memberName);
 	}
 
+	/**
+	 * @brief Serialize given member to JSON writing it directly through a
+	 *	rapidjson SAX Writer, instead of accumulating it into a Document.
+	 *	This is used by JSON API wrappers to avoid keeping the whole answer in
+	 *	memory twice. Writer must be positioned inside an object.
+	 * @param[inout] writer rapidjson Writer (or PrettyWriter) to write to
+	 * @param[in] member member to serialize
+	 * @param[in] memberName name of the JSON member
+	 * @param[in] flags serialization flags passed down to serial_process
+	 * @return false if the member could not be serialized
+	 */
+	template<typename W, typename T>
+	static bool to_JSON_stream(
+	        W& writer, T& member, const std::string& memberName,
+	        SerializationFlags flags =
+	            RsGenericSerializer::SERIALIZATION_FLAG_NONE )
+	{
+		RsGenericSerializer::SerializeContext ctx(nullptr, 0, flags);
+		serial_process(RsGenericSerializer::TO_JSON, ctx, member, memberName);
+
+		auto mIt = ctx.mJson.FindMember(memberName.c_str());
+		if(mIt == ctx.mJson.MemberEnd()) return false;
+
+		writer.Key(memberName.c_str(), memberName.length());
+		return mIt->value.Accept(writer) && ctx.mOk;
+	}
+
+	/// std::vector<T> streamed one element at time
+	template<typename W, typename T>
+	static bool to_JSON_stream(
+	        W& writer, std::vector<T>& v, const std::string& memberName,
+	        SerializationFlags flags =
+	            RsGenericSerializer::SERIALIZATION_FLAG_NONE )
+	{ return to_JSON_stream_array(writer, v, memberName, flags); }
+
+	/// std::list<T> streamed one element at time
+	template<typename W, typename T>
+	static bool to_JSON_stream(
+	        W& writer, std::list<T>& v, const std::string& memberName,
+	        SerializationFlags flags =
+	            RsGenericSerializer::SERIALIZATION_FLAG_NONE )
+	{ return to_JSON_stream_array(writer, v, memberName, flags); }
+
+	/// std::set<T> streamed one element at time
+	template<typename W, typename T>
+	static bool to_JSON_stream(
+	        W& writer, std::set<T>& v, const std::string& memberName,
+	        SerializationFlags flags =
+	            RsGenericSerializer::SERIALIZATION_FLAG_NONE )
+	{ return to_JSON_stream_array(writer, v, memberName, flags); }
+
 protected:
+	/* INTERNAL ONLY helper for to_JSON_stream of std::{vector,list,set}<T>,
+	 * produce the same output of RsTypeSerializer_PRIVATE_TO_JSON_ARRAY but
+	 * only one element at time is kept in a Document, the element allocator
+	 * is recycled so elements smaller then the buffer cause no heap
+	 * allocation at all */
+	template<typename W, typename C>
+	static bool to_JSON_stream_array(
+	        W& writer, C& v, const std::string& memberName,
+	        SerializationFlags flags )
+	{
+		typedef typename C::value_type T;
+		constexpr size_t bufferSize = 16*1024;
+		std::unique_ptr<char[]> buffer(new char[bufferSize]);
+		RsJson::AllocatorType allocator(buffer.get(), bufferSize);
+
+		writer.Key(memberName.c_str(), memberName.length());
+		writer.StartArray();
+
+		bool ok = true;
+		rapidjson::SizeType count = 0;
+		for(auto& el : v)
+		{
+			{
+				RsGenericSerializer::SerializeContext elCtx(
+				            nullptr, 0, flags, &allocator );
+
+				/* If el is const the default serial_process template is
+				 * matched also when specialization is necessary */
+				serial_process( RsGenericSerializer::TO_JSON, elCtx,
+				                const_cast<T&>(el), memberName );
+
+				auto mIt = elCtx.mJson.FindMember(memberName.c_str());
+				ok = elCtx.mOk && mIt != elCtx.mJson.MemberEnd();
+				ok = ok && mIt->value.Accept(writer);
+			}
+			allocator.Clear();
+
+			if(!ok) break;
+			++count;
+		}
+
+		writer.EndArray(count);
+		return ok;
+	}
+
 
 //============================================================================//
 // Generic types declarations                                                 //
@@ -0,0 +1,460 @@
+/*******************************************************************************
+ * libretroshare/src/services: gxsforumthreadindex.cc                          *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <algorithm>
+#include <memory>
+
+#include "services/gxsforumthreadindex.h"
+#include "util/retrodb.h"
+
+#define INDEX_TABLE_NAME std::string("FORUM_THREAD_INDEX")
+#define FORUMS_TABLE_NAME std::string("FORUM_THREAD_INDEX_FORUMS")
+
+#define KEY_GRP_ID std::string("grpId")
+#define KEY_MSG_ID std::string("msgId")
+#define KEY_PARENT_ID std::string("parentId")
+#define KEY_PUBLISH_TS std::string("publishTs")
+#define KEY_ACTIVITY_TS std::string("lastActivityTs")
+#define KEY_DESCENDANTS std::string("descendants")
+#define KEY_TOP_LEVEL std::string("topLevel")
+
+GxsForumThreadIndex::GxsForumThreadIndex(
+        const std::string& dbPath, const std::string& key ) :
+    mDbMutex("GxsForumThreadIndex"),
+    mDb(new RetroDb(dbPath, RetroDb::OPEN_READWRITE_CREATE, key))
+{ initTables(); }
+
+GxsForumThreadIndex::~GxsForumThreadIndex()
+{
+	mDb->closeDb();
+	delete mDb;
+}
+
+bool GxsForumThreadIndex::isOpen()
+{
+	RS_STACK_MUTEX(mDbMutex);
+	return mDb->isOpen();
+}
+
+void GxsForumThreadIndex::initTables()
+{
+	RS_STACK_MUTEX(mDbMutex);
+	if(!mDb->isOpen()) return;
+
+	if(!mDb->tableExists(INDEX_TABLE_NAME))
+	{
+		mDb->execSQL("CREATE TABLE " + INDEX_TABLE_NAME + "(" +
+		             KEY_GRP_ID + " TEXT," +
+		             KEY_MSG_ID + " TEXT," +
+		             KEY_PARENT_ID + " TEXT," +
+		             KEY_PUBLISH_TS + " INT," +
+		             KEY_ACTIVITY_TS + " INT," +
+		             KEY_DESCENDANTS + " INT," +
+		             KEY_TOP_LEVEL + " INT," +
+		             "PRIMARY KEY (" + KEY_GRP_ID + "," + KEY_MSG_ID + "));");
+
+		mDb->execSQL("CREATE TABLE " + FORUMS_TABLE_NAME + "(" +
+		             KEY_GRP_ID + " TEXT PRIMARY KEY);");
+
+		/* threads pages are read straight from this one */
+		mDb->execSQL("CREATE INDEX " + INDEX_TABLE_NAME + "_ACTIVITY_INDEX ON " +
+		             INDEX_TABLE_NAME + " (" + KEY_GRP_ID + "," +
+		             KEY_TOP_LEVEL + "," + KEY_ACTIVITY_TS + "," +
+		             KEY_MSG_ID + ");");
+		mDb->execSQL("CREATE INDEX " + INDEX_TABLE_NAME + "_PARENT_INDEX ON " +
+		             INDEX_TABLE_NAME + " (" + KEY_GRP_ID + "," +
+		             KEY_PARENT_ID + ");");
+	}
+
+	std::list<std::string> columns;
+	columns.push_back(KEY_GRP_ID);
+
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery(FORUMS_TABLE_NAME, columns, "", "") );
+	if(!c) return;
+
+	RsGxsGroupId forumId;
+	for(bool valid = c->moveToFirst(); valid; valid = c->moveToNext())
+	{
+		c->getStringT(0, forumId);
+		mIndexedForums.insert(forumId);
+	}
+}
+
+static std::string forumWhere(const RsGxsGroupId& forumId)
+{ return KEY_GRP_ID + "='" + forumId.toStdString() + "'"; }
+
+static std::string msgWhere(
+        const RsGxsGroupId& forumId, const RsGxsMessageId& msgId )
+{
+	return forumWhere(forumId) + " AND " + KEY_MSG_ID + "='" +
+	        msgId.toStdString() + "'";
+}
+
+static std::string childrenWhere(
+        const RsGxsGroupId& forumId, const RsGxsMessageId& parentId )
+{
+	return forumWhere(forumId) + " AND " + KEY_PARENT_ID + "='" +
+	        parentId.toStdString() + "'";
+}
+
+bool GxsForumThreadIndex::locked_getNode(
+        const RsGxsGroupId& forumId, const RsGxsMessageId& msgId, Node& node )
+{
+	std::list<std::string> columns;
+	columns.push_back(KEY_PARENT_ID);
+	columns.push_back(KEY_PUBLISH_TS);
+	columns.push_back(KEY_ACTIVITY_TS);
+	columns.push_back(KEY_DESCENDANTS);
+	columns.push_back(KEY_TOP_LEVEL);
+
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery( INDEX_TABLE_NAME, columns,
+	                           msgWhere(forumId, msgId), "" ) );
+	if(!c || !c->moveToFirst()) return false;
+
+	c->getStringT(0, node.mParentId);
+	node.mPublishTs = c->getInt64(1);
+	node.mLastActivityTs = c->getInt64(2);
+	node.mDescendantsCount = static_cast<uint32_t>(c->getInt64(3));
+	node.mTopLevel = c->getInt32(4) != 0;
+	return true;
+}
+
+bool GxsForumThreadIndex::locked_updateNode(
+        const RsGxsGroupId& forumId, const RsGxsMessageId& msgId,
+        const Node& node )
+{
+	ContentValue cv;
+	cv.put(KEY_ACTIVITY_TS, static_cast<int64_t>(node.mLastActivityTs));
+	cv.put(KEY_DESCENDANTS, static_cast<int64_t>(node.mDescendantsCount));
+	cv.put(KEY_TOP_LEVEL, static_cast<int32_t>(node.mTopLevel));
+	return mDb->sqlUpdate(INDEX_TABLE_NAME, msgWhere(forumId, msgId), cv);
+}
+
+void GxsForumThreadIndex::locked_propagateAdd(
+        const RsGxsGroupId& forumId, const RsGxsMessageId& parentId,
+        rstime_t activityTs, uint32_t addedCount )
+{
+	// Stop on loops, which malicious peers can forge with parent ids
+	std::set<RsGxsMessageId> visited;
+	RsGxsMessageId curId = parentId;
+	Node node;
+
+	while(visited.insert(curId).second && locked_getNode(forumId, curId, node))
+	{
+		node.mDescendantsCount += addedCount;
+		node.mLastActivityTs = std::max(node.mLastActivityTs, activityTs);
+		locked_updateNode(forumId, curId, node);
+
+		if(node.mTopLevel) break;
+		curId = node.mParentId;
+	}
+}
+
+void GxsForumThreadIndex::locked_propagateRemove(
+        const RsGxsGroupId& forumId, const RsGxsMessageId& parentId,
+        uint32_t removedCount )
+{
+	std::list<std::string> columns;
+	columns.push_back("MAX(" + KEY_ACTIVITY_TS + ")");
+
+	std::set<RsGxsMessageId> visited;
+	RsGxsMessageId curId = parentId;
+	Node node;
+
+	while(visited.insert(curId).second && locked_getNode(forumId, curId, node))
+	{
+		node.mDescendantsCount -= std::min(removedCount, node.mDescendantsCount);
+
+		node.mLastActivityTs = node.mPublishTs;
+		std::unique_ptr<RetroCursor> c(
+		            mDb->sqlQuery( INDEX_TABLE_NAME, columns,
+		                           childrenWhere(forumId, curId), "" ) );
+		if(c && c->moveToFirst())
+			node.mLastActivityTs =
+			        std::max<rstime_t>(node.mLastActivityTs, c->getInt64(0));
+
+		locked_updateNode(forumId, curId, node);
+
+		if(node.mTopLevel) break;
+		curId = node.mParentId;
+	}
+}
+
+bool GxsForumThreadIndex::locked_addMessage(
+        const RsGxsGroupId& forumId, const GxsForumThreadIndexRecord& record )
+{
+	const RsGxsMessageId& msgId(record.mMsgId);
+	Node node;
+	if(msgId.isNull() || locked_getNode(forumId, msgId, node)) return false;
+
+	if(record.mParentId != msgId) node.mParentId = record.mParentId;
+	node.mPublishTs = record.mPublishTs;
+	node.mLastActivityTs = record.mPublishTs;
+
+	/* Adopt children received before their parent, they are top level
+	 * threads until now */
+	std::list<std::string> columns;
+	columns.push_back("COUNT(*)");
+	columns.push_back("SUM(" + KEY_DESCENDANTS + ")");
+	columns.push_back("MAX(" + KEY_ACTIVITY_TS + ")");
+
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery( INDEX_TABLE_NAME, columns,
+	                           childrenWhere(forumId, msgId), "" ) );
+	if(c && c->moveToFirst() && c->getInt64(0) > 0)
+	{
+		node.mDescendantsCount =
+		        static_cast<uint32_t>(c->getInt64(0) + c->getInt64(1));
+		node.mLastActivityTs =
+		        std::max<rstime_t>(node.mLastActivityTs, c->getInt64(2));
+
+		ContentValue cv;
+		cv.put(KEY_TOP_LEVEL, static_cast<int32_t>(0));
+		mDb->sqlUpdate(INDEX_TABLE_NAME, childrenWhere(forumId, msgId), cv);
+	}
+
+	Node parent;
+	node.mTopLevel = node.mParentId.isNull() ||
+	        !locked_getNode(forumId, node.mParentId, parent);
+
+	ContentValue cv;
+	cv.put(KEY_GRP_ID, forumId.toStdString());
+	cv.put(KEY_MSG_ID, msgId.toStdString());
+	cv.put(KEY_PARENT_ID, node.mParentId.toStdString());
+	cv.put(KEY_PUBLISH_TS, static_cast<int64_t>(node.mPublishTs));
+	cv.put(KEY_ACTIVITY_TS, static_cast<int64_t>(node.mLastActivityTs));
+	cv.put(KEY_DESCENDANTS, static_cast<int64_t>(node.mDescendantsCount));
+	cv.put(KEY_TOP_LEVEL, static_cast<int32_t>(node.mTopLevel));
+	if(!mDb->sqlInsert(INDEX_TABLE_NAME, "", cv)) return false;
+
+	if(!node.mTopLevel)
+		locked_propagateAdd( forumId, node.mParentId, node.mLastActivityTs,
+		                     1 + node.mDescendantsCount );
+
+	return true;
+}
+
+bool GxsForumThreadIndex::isIndexed(const RsGxsGroupId& forumId)
+{
+	RS_STACK_MUTEX(mDbMutex);
+	return mIndexedForums.find(forumId) != mIndexedForums.end();
+}
+
+bool GxsForumThreadIndex::buildIndex(
+        const RsGxsGroupId& forumId,
+        const std::vector<GxsForumThreadIndexRecord>& records )
+{
+	RS_STACK_MUTEX(mDbMutex);
+	if(!mDb->isOpen()) return false;
+
+	mDb->beginTransaction();
+	locked_removeForum(forumId);
+
+	for(auto it(records.begin()); it != records.end(); ++it)
+		locked_addMessage(forumId, *it);
+
+	ContentValue cv;
+	cv.put(KEY_GRP_ID, forumId.toStdString());
+	if(!mDb->sqlInsert(FORUMS_TABLE_NAME, "", cv) || !mDb->commitTransaction())
+	{
+		std::cerr << __PRETTY_FUNCTION__ << " Error! Failed building index of "
+		          << "forum: " << forumId << std::endl;
+		mDb->rollbackTransaction();
+		return false;
+	}
+
+	mIndexedForums.insert(forumId);
+	return true;
+}
+
+bool GxsForumThreadIndex::addMessages(
+        const RsGxsGroupId& forumId,
+        const std::vector<GxsForumThreadIndexRecord>& records )
+{
+	RS_STACK_MUTEX(mDbMutex);
+	if(!mDb->isOpen()) return false;
+
+	mDb->beginTransaction();
+	for(auto it(records.begin()); it != records.end(); ++it)
+		locked_addMessage(forumId, *it);
+	return mDb->commitTransaction();
+}
+
+bool GxsForumThreadIndex::addMessage(
+        const RsGxsGroupId& forumId, const GxsForumThreadIndexRecord& record )
+{
+	RS_STACK_MUTEX(mDbMutex);
+	return locked_addMessage(forumId, record);
+}
+
+bool GxsForumThreadIndex::removeMessage(
+        const RsGxsGroupId& forumId, const RsGxsMessageId& msgId )
+{
+	RS_STACK_MUTEX(mDbMutex);
+
+	Node node;
+	if(!locked_getNode(forumId, msgId, node)) return false;
+
+	mDb->beginTransaction();
+	mDb->sqlDelete(INDEX_TABLE_NAME, msgWhere(forumId, msgId), "");
+
+	if(!node.mTopLevel)
+		locked_propagateRemove( forumId, node.mParentId,
+		                        1 + node.mDescendantsCount );
+
+	/* Children keep their parent id so they are adopted again if the
+	 * message comes back, meanwhile they are top level threads */
+	ContentValue cv;
+	cv.put(KEY_TOP_LEVEL, static_cast<int32_t>(1));
+	mDb->sqlUpdate(INDEX_TABLE_NAME, childrenWhere(forumId, msgId), cv);
+
+	return mDb->commitTransaction();
+}
+
+bool GxsForumThreadIndex::locked_removeForum(const RsGxsGroupId& forumId)
+{
+	mIndexedForums.erase(forumId);
+	return mDb->sqlDelete(INDEX_TABLE_NAME, forumWhere(forumId), "") &&
+	        mDb->sqlDelete(FORUMS_TABLE_NAME, forumWhere(forumId), "");
+}
+
+bool GxsForumThreadIndex::removeForum(const RsGxsGroupId& forumId)
+{
+	RS_STACK_MUTEX(mDbMutex);
+	return locked_removeForum(forumId);
+}
+
+bool GxsForumThreadIndex::hasMessage(
+        const RsGxsGroupId& forumId, const RsGxsMessageId& msgId )
+{
+	RS_STACK_MUTEX(mDbMutex);
+	Node node;
+	return locked_getNode(forumId, msgId, node);
+}
+
+uint32_t GxsForumThreadIndex::locked_count(const std::string& selection)
+{
+	std::list<std::string> columns;
+	columns.push_back("COUNT(*)");
+
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery(INDEX_TABLE_NAME, columns, selection, "") );
+	if(!c || !c->moveToFirst()) return 0;
+	return static_cast<uint32_t>(c->getInt64(0));
+}
+
+uint32_t GxsForumThreadIndex::messagesCount(const RsGxsGroupId& forumId)
+{
+	RS_STACK_MUTEX(mDbMutex);
+	return locked_count(forumWhere(forumId));
+}
+
+uint32_t GxsForumThreadIndex::threadsCount(const RsGxsGroupId& forumId)
+{
+	RS_STACK_MUTEX(mDbMutex);
+	return locked_count(forumWhere(forumId) + " AND " + KEY_TOP_LEVEL + "=1");
+}
+
+bool GxsForumThreadIndex::getThreadsPage(
+        const RsGxsGroupId& forumId, uint32_t offset, uint32_t count,
+        std::vector<RsGxsMessageId>& threads )
+{
+	threads.clear();
+	if(!count) return true;
+
+	std::list<std::string> columns;
+	columns.push_back(KEY_MSG_ID);
+
+	RS_STACK_MUTEX(mDbMutex);
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery( INDEX_TABLE_NAME, columns,
+	                           forumWhere(forumId) + " AND " + KEY_TOP_LEVEL +
+	                           "=1", KEY_ACTIVITY_TS + " DESC," + KEY_MSG_ID +
+	                           " DESC", "", count, offset ) );
+	if(!c) return false;
+
+	threads.reserve(count);
+	RsGxsMessageId msgId;
+	for(bool valid = c->moveToFirst(); valid; valid = c->moveToNext())
+	{
+		c->getStringT(0, msgId);
+		threads.push_back(msgId);
+	}
+
+	return true;
+}
+
+bool GxsForumThreadIndex::getSubtree(
+        const RsGxsGroupId& forumId, const RsGxsMessageId& rootId,
+        std::vector<RsGxsMessageId>& msgIds )
+{
+	msgIds.clear();
+
+	RS_STACK_MUTEX(mDbMutex);
+	Node root;
+	if(!locked_getNode(forumId, rootId, root)) return false;
+
+	msgIds.reserve(1 + root.mDescendantsCount);
+	msgIds.push_back(rootId);
+
+	std::set<RsGxsMessageId> visited;
+	visited.insert(rootId);
+
+	std::list<std::string> columns;
+	columns.push_back(KEY_MSG_ID);
+
+	RsGxsMessageId childId;
+	for(uint32_t i = 0; i < msgIds.size(); ++i)
+	{
+		std::unique_ptr<RetroCursor> c(
+		            mDb->sqlQuery( INDEX_TABLE_NAME, columns,
+		                           childrenWhere(forumId, msgIds[i]),
+		                           KEY_MSG_ID ) );
+		if(!c) return false;
+
+		for(bool valid = c->moveToFirst(); valid; valid = c->moveToNext())
+		{
+			c->getStringT(0, childId);
+			if(visited.insert(childId).second) msgIds.push_back(childId);
+		}
+	}
+
+	return true;
+}
+
+bool GxsForumThreadIndex::getStats(
+        const RsGxsGroupId& forumId, const RsGxsMessageId& msgId,
+        rstime_t& lastActivityTs, uint32_t& childrenCount,
+        uint32_t& descendantsCount )
+{
+	RS_STACK_MUTEX(mDbMutex);
+
+	Node node;
+	if(!locked_getNode(forumId, msgId, node)) return false;
+
+	lastActivityTs = node.mLastActivityTs;
+	descendantsCount = node.mDescendantsCount;
+	childrenCount = locked_count(childrenWhere(forumId, msgId));
+	return true;
+}
@@ -0,0 +1,183 @@
+/*******************************************************************************
+ * libretroshare/src/services: gxsforumthreadindex.h                           *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "retroshare/rsgxsifacetypes.h"
+#include "util/rsthreads.h"
+#include "util/rstime.h"
+
+class RetroDb;
+
+/// A message of a forum as seen by the thread index
+struct GxsForumThreadIndexRecord
+{
+	GxsForumThreadIndexRecord() : mPublishTs(0) {}
+
+	RsGxsMessageId mMsgId;
+	RsGxsMessageId mParentId;
+	rstime_t mPublishTs;
+};
+
+/**
+ * Parent/child adjacency of forum messages, kept up to date message by
+ * message so that the threads of a forum can be listed one page at a time,
+ * and a single thread can be walked without loading the metadata of the whole
+ * forum.
+ *
+ * Each message is a row of a RetroDb table holding its latest activity time
+ * stamp and descendants count, so an update only touches the message and its
+ * ancestors on disk, and top level threads are paged through a
+ * (forum, lastActivity) index instead of being kept in memory.
+ *
+ * Messages whose parent is not (yet) known are listed as top level threads,
+ * like the GUI does with missing parents, and get attached to their parent
+ * as soon as it is added.
+ */
+class GxsForumThreadIndex
+{
+public:
+	/**
+	 * @param[in] dbPath path of the database file, created if missing
+	 * @param[in] key encryption key, empty for plain sqlite
+	 */
+	GxsForumThreadIndex(const std::string& dbPath, const std::string& key);
+	~GxsForumThreadIndex();
+
+	/// @return false if the database couldn't be opened
+	bool isOpen();
+
+	/// @return true if the forum index has been built
+	bool isIndexed(const RsGxsGroupId& forumId);
+
+	/**
+	 * @brief Build the index of a forum from all its messages in a single
+	 *	transaction, replacing the existing one if any.
+	 * @return false on database error
+	 */
+	bool buildIndex( const RsGxsGroupId& forumId,
+	                 const std::vector<GxsForumThreadIndexRecord>& records );
+
+	/**
+	 * @brief Add new messages to an already built index in a single
+	 *	transaction, messages already known are skipped.
+	 * @return false on database error
+	 */
+	bool addMessages( const RsGxsGroupId& forumId,
+	                  const std::vector<GxsForumThreadIndexRecord>& records );
+
+	/**
+	 * @brief Add a message to the index.
+	 * @return false if the message was already known, true otherwise
+	 */
+	bool addMessage( const RsGxsGroupId& forumId,
+	                 const GxsForumThreadIndexRecord& record );
+
+	/**
+	 * @brief Remove a message from the index, its children become top level
+	 *	threads until the message is added again.
+	 * @return false if the message was not indexed, true otherwise
+	 */
+	bool removeMessage( const RsGxsGroupId& forumId,
+	                    const RsGxsMessageId& msgId );
+
+	/// Remove the whole index of a forum
+	bool removeForum(const RsGxsGroupId& forumId);
+
+	bool hasMessage(const RsGxsGroupId& forumId, const RsGxsMessageId& msgId);
+
+	uint32_t messagesCount(const RsGxsGroupId& forumId);
+	uint32_t threadsCount(const RsGxsGroupId& forumId);
+
+	/**
+	 * @brief Get top level threads ordered by most recent activity first.
+	 * @param[in] forumId forum to list
+	 * @param[in] offset number of threads to skip
+	 * @param[in] count maximum number of threads to return
+	 * @param[out] threads ids of the thread root messages
+	 * @return false on database error
+	 */
+	bool getThreadsPage( const RsGxsGroupId& forumId, uint32_t offset,
+	                     uint32_t count, std::vector<RsGxsMessageId>& threads );
+
+	/**
+	 * @brief Get the ids of the given message and of all its descendants, in
+	 *	breadth first order so parents always come before their children.
+	 * @return false if the message is not indexed
+	 */
+	bool getSubtree( const RsGxsGroupId& forumId, const RsGxsMessageId& rootId,
+	                 std::vector<RsGxsMessageId>& msgIds );
+
+	/**
+	 * @brief Get the statistics of a message subtree
+	 * @return false if the message is not indexed
+	 */
+	bool getStats( const RsGxsGroupId& forumId, const RsGxsMessageId& msgId,
+	               rstime_t& lastActivityTs, uint32_t& childrenCount,
+	               uint32_t& descendantsCount );
+
+private:
+	struct Node
+	{
+		Node() :
+		    mPublishTs(0), mLastActivityTs(0), mDescendantsCount(0),
+		    mTopLevel(false) {}
+
+		RsGxsMessageId mParentId;
+		rstime_t mPublishTs;
+		rstime_t mLastActivityTs;
+		uint32_t mDescendantsCount;
+		bool mTopLevel;
+	};
+
+	void initTables();
+
+	bool locked_getNode( const RsGxsGroupId& forumId,
+	                     const RsGxsMessageId& msgId, Node& node );
+	bool locked_updateNode( const RsGxsGroupId& forumId,
+	                        const RsGxsMessageId& msgId, const Node& node );
+	bool locked_addMessage( const RsGxsGroupId& forumId,
+	                        const GxsForumThreadIndexRecord& record );
+	bool locked_removeForum(const RsGxsGroupId& forumId);
+	uint32_t locked_count(const std::string& selection);
+
+	/** Propagate activity time and descendants count of a newly attached
+	 * subtree to all its ancestors */
+	void locked_propagateAdd( const RsGxsGroupId& forumId,
+	                          const RsGxsMessageId& parentId,
+	                          rstime_t activityTs, uint32_t addedCount );
+
+	/** Update ancestors after a subtree has been detached, activity time is
+	 * recomputed from the remaining children */
+	void locked_propagateRemove( const RsGxsGroupId& forumId,
+	                             const RsGxsMessageId& parentId,
+	                             uint32_t removedCount );
+
+	RsMutex mDbMutex;
+	RetroDb* mDb;
+
+	/// Forums which index has been built, small enough to be kept in memory
+	std::set<RsGxsGroupId> mIndexedForums;
+};
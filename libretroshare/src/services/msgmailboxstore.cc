@@ -0,0 +1,530 @@
+/*******************************************************************************
+ * libretroshare/src/services: msgmailboxstore.cc                              *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#include <memory>
+
+#include "services/msgmailboxstore.h"
+#include "util/retrodb.h"
+#include "util/rsstring.h"
+
+//#define MAILBOX_DEBUG 1
+
+#define MSG_TABLE_NAME std::string("MESSAGES")
+#define TAG_TABLE_NAME std::string("MSG_TAGS")
+
+#define KEY_MSG_ID std::string("msgId")
+#define KEY_MSG_FLAGS std::string("msgFlags")
+#define KEY_MSG_BOX std::string("box")
+#define KEY_SEND_TIME std::string("sendTime")
+#define KEY_RECV_TIME std::string("recvTime")
+#define KEY_PEER_ID std::string("peerId")
+#define KEY_SUBJECT std::string("subject")
+#define KEY_ATTACH_COUNT std::string("attachCount")
+#define KEY_SRC_ID std::string("srcId")
+#define KEY_PARENT_ID std::string("parentId")
+#define KEY_MSG_DATA std::string("msgData")
+#define KEY_TAG_ID std::string("tagId")
+
+MsgMailboxStore::MsgMailboxStore(
+        const std::string& dbPath, const std::string& key ) :
+    mDbMutex("MsgMailboxStore"),
+    mDb(new RetroDb(dbPath, RetroDb::OPEN_READWRITE_CREATE, key)),
+    mSerialiser(RsServiceSerializer::SERIALIZATION_FLAG_CONFIG)
+{ initTables(); }
+
+MsgMailboxStore::~MsgMailboxStore()
+{
+	mDb->closeDb();
+	delete mDb;
+}
+
+bool MsgMailboxStore::isOpen()
+{
+	RS_STACK_MUTEX(mDbMutex);
+	return mDb->isOpen();
+}
+
+void MsgMailboxStore::initTables()
+{
+	RS_STACK_MUTEX(mDbMutex);
+	if(!mDb->isOpen() || mDb->tableExists(MSG_TABLE_NAME)) return;
+
+	mDb->execSQL("CREATE TABLE " + MSG_TABLE_NAME + "(" +
+	             KEY_MSG_ID + " INTEGER PRIMARY KEY," +
+	             KEY_MSG_FLAGS + " INT," +
+	             KEY_MSG_BOX + " INT," +
+	             KEY_SEND_TIME + " INT," +
+	             KEY_RECV_TIME + " INT," +
+	             KEY_PEER_ID + " TEXT," +
+	             KEY_SUBJECT + " TEXT," +
+	             KEY_ATTACH_COUNT + " INT," +
+	             KEY_SRC_ID + " TEXT," +
+	             KEY_PARENT_ID + " INTEGER," +
+	             KEY_MSG_DATA + " BLOB);");
+
+	mDb->execSQL("CREATE TABLE " + TAG_TABLE_NAME + "(" +
+	             KEY_MSG_ID + " INTEGER," +
+	             KEY_TAG_ID + " INTEGER," +
+	             "PRIMARY KEY (" + KEY_MSG_ID + "," + KEY_TAG_ID + "));");
+
+	mDb->execSQL("CREATE INDEX " + MSG_TABLE_NAME + "_BOX_INDEX ON " +
+	             MSG_TABLE_NAME + " (" + KEY_MSG_BOX + "," +
+	             KEY_SEND_TIME + ");");
+	mDb->execSQL("CREATE INDEX " + MSG_TABLE_NAME + "_TIME_INDEX ON " +
+	             MSG_TABLE_NAME + " (" + KEY_SEND_TIME + ");");
+	mDb->execSQL("CREATE INDEX " + TAG_TABLE_NAME + "_TAG_INDEX ON " +
+	             TAG_TABLE_NAME + " (" + KEY_TAG_ID + ");");
+}
+
+/*static*/ uint32_t MsgMailboxStore::flagsToBox(uint32_t msgFlags)
+{
+	if(msgFlags & RS_MSG_FLAGS_TRASH) return RS_MSG_TRASH;
+
+	/* internal box flags have the same values of the public ones */
+	return msgFlags & (RS_MSG_FLAGS_OUTGOING | RS_MSG_FLAGS_PENDING |
+	                   RS_MSG_FLAGS_DRAFT);
+}
+
+/* ids are unsigned 32 bit, store them as 64 bit integers so the ones above
+ * INT32_MAX keep their value and order */
+static int64_t idValue(uint32_t id) { return static_cast<int64_t>(id); }
+static uint32_t idFromDb(int64_t value) { return static_cast<uint32_t>(value); }
+
+static std::string msgIdWhere(uint32_t msgId)
+{ return KEY_MSG_ID + "=" + std::to_string(msgId); }
+
+bool MsgMailboxStore::locked_exists(uint32_t msgId)
+{
+	std::list<std::string> columns;
+	columns.push_back(KEY_MSG_ID);
+
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery(MSG_TABLE_NAME, columns, msgIdWhere(msgId), "") );
+	return c && c->moveToFirst();
+}
+
+bool MsgMailboxStore::storeMessage(const RsMsgItem& msg, const RsPeerId& srcId)
+{
+	RS_STACK_MUTEX(mDbMutex);
+	return locked_storeMessage(msg, srcId);
+}
+
+bool MsgMailboxStore::locked_storeMessage(
+        const RsMsgItem& msg, const RsPeerId& srcId )
+{
+	RsMsgItem* item = const_cast<RsMsgItem*>(&msg);
+	uint32_t size = mSerialiser.size(item);
+	std::vector<uint8_t> data(size);
+	if(!mSerialiser.serialise(item, data.data(), &size))
+	{
+		std::cerr << __PRETTY_FUNCTION__ << " Error! Failed serializing msg: "
+		          << msg.msgId << std::endl;
+		return false;
+	}
+
+	ContentValue cv;
+	cv.put(KEY_MSG_FLAGS, static_cast<int32_t>(msg.msgFlags));
+	cv.put(KEY_MSG_BOX, static_cast<int32_t>(flagsToBox(msg.msgFlags)));
+	cv.put(KEY_SEND_TIME, static_cast<int64_t>(msg.sendTime));
+	cv.put(KEY_RECV_TIME, static_cast<int64_t>(msg.recvTime));
+	cv.put(KEY_PEER_ID, msg.PeerId().toStdString());
+	cv.put(KEY_SUBJECT, msg.subject);
+	cv.put(KEY_ATTACH_COUNT, static_cast<int32_t>(msg.attachment.items.size()));
+	cv.put(KEY_MSG_DATA, size, reinterpret_cast<const char*>(data.data()));
+	if(!srcId.isNull()) cv.put(KEY_SRC_ID, srcId.toStdString());
+
+	if(locked_exists(msg.msgId))
+		return mDb->sqlUpdate(MSG_TABLE_NAME, msgIdWhere(msg.msgId), cv);
+
+	cv.put(KEY_MSG_ID, idValue(msg.msgId));
+	cv.put(KEY_PARENT_ID, idValue(0));
+	return mDb->sqlInsert(MSG_TABLE_NAME, "", cv);
+}
+
+RsMsgItem* MsgMailboxStore::loadMessage(uint32_t msgId, RsPeerId& srcId)
+{
+	std::list<std::string> columns;
+	columns.push_back(KEY_MSG_DATA);
+	columns.push_back(KEY_MSG_FLAGS);
+	columns.push_back(KEY_PEER_ID);
+	columns.push_back(KEY_SRC_ID);
+
+	RS_STACK_MUTEX(mDbMutex);
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery(MSG_TABLE_NAME, columns, msgIdWhere(msgId), "") );
+	if(!c || !c->moveToFirst()) return nullptr;
+
+	uint32_t size = 0;
+	const void* data = c->getData(0, size);
+	RsItem* item = mSerialiser.deserialise(const_cast<void*>(data), &size);
+	RsMsgItem* msg = dynamic_cast<RsMsgItem*>(item);
+	if(!msg)
+	{
+		std::cerr << __PRETTY_FUNCTION__ << " Error! Failed deserializing msg: "
+		          << msgId << std::endl;
+		delete item;
+		return nullptr;
+	}
+
+	std::string str;
+	msg->msgId = msgId;
+	msg->msgFlags = static_cast<uint32_t>(c->getInt32(1));
+	c->getString(2, str);
+	msg->PeerId(RsPeerId(str));
+	c->getStringT(3, srcId);
+
+	return msg;
+}
+
+bool MsgMailboxStore::loadMessages(
+        uint32_t flagsMask, uint32_t flagsValue, std::list<RsMsgItem*>& msgs )
+{
+	std::list<std::string> columns;
+	columns.push_back(KEY_MSG_ID);
+
+	std::string where;
+	rs_sprintf( where, "(%s & %u) = %u", KEY_MSG_FLAGS.c_str(),
+	            flagsMask, flagsValue );
+
+	std::list<uint32_t> ids;
+	{
+		RS_STACK_MUTEX(mDbMutex);
+		std::unique_ptr<RetroCursor> c(
+		            mDb->sqlQuery(MSG_TABLE_NAME, columns, where, "") );
+		if(!c) return false;
+
+		for(bool valid = c->moveToFirst(); valid; valid = c->moveToNext())
+			ids.push_back(idFromDb(c->getInt64(0)));
+	}
+
+	RsPeerId srcId;
+	for(uint32_t msgId : ids)
+		if(RsMsgItem* msg = loadMessage(msgId, srcId)) msgs.push_back(msg);
+
+	return true;
+}
+
+bool MsgMailboxStore::removeMessage(uint32_t msgId)
+{
+	RS_STACK_MUTEX(mDbMutex);
+	if(!locked_exists(msgId)) return false;
+
+	mDb->beginTransaction();
+	mDb->sqlDelete(TAG_TABLE_NAME, msgIdWhere(msgId), "");
+	mDb->sqlDelete(MSG_TABLE_NAME, msgIdWhere(msgId), "");
+	return mDb->commitTransaction();
+}
+
+bool MsgMailboxStore::getFlags(uint32_t msgId, uint32_t& msgFlags)
+{
+	std::list<std::string> columns;
+	columns.push_back(KEY_MSG_FLAGS);
+
+	RS_STACK_MUTEX(mDbMutex);
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery(MSG_TABLE_NAME, columns, msgIdWhere(msgId), "") );
+	if(!c || !c->moveToFirst()) return false;
+
+	msgFlags = static_cast<uint32_t>(c->getInt32(0));
+	return true;
+}
+
+bool MsgMailboxStore::setFlags(uint32_t msgId, uint32_t msgFlags)
+{
+	ContentValue cv;
+	cv.put(KEY_MSG_FLAGS, static_cast<int32_t>(msgFlags));
+	cv.put(KEY_MSG_BOX, static_cast<int32_t>(flagsToBox(msgFlags)));
+
+	RS_STACK_MUTEX(mDbMutex);
+	return locked_exists(msgId) &&
+	        mDb->sqlUpdate(MSG_TABLE_NAME, msgIdWhere(msgId), cv);
+}
+
+bool MsgMailboxStore::getParentId(uint32_t msgId, uint32_t& parentId)
+{
+	std::list<std::string> columns;
+	columns.push_back(KEY_PARENT_ID);
+
+	RS_STACK_MUTEX(mDbMutex);
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery(MSG_TABLE_NAME, columns, msgIdWhere(msgId), "") );
+	if(!c || !c->moveToFirst()) return false;
+
+	parentId = idFromDb(c->getInt64(0));
+	return parentId != 0;
+}
+
+bool MsgMailboxStore::setParentId(uint32_t msgId, uint32_t parentId)
+{
+	RS_STACK_MUTEX(mDbMutex);
+	return locked_setParentId(msgId, parentId);
+}
+
+bool MsgMailboxStore::locked_setParentId(uint32_t msgId, uint32_t parentId)
+{
+	ContentValue cv;
+	cv.put(KEY_PARENT_ID, idValue(parentId));
+	return locked_exists(msgId) &&
+	        mDb->sqlUpdate(MSG_TABLE_NAME, msgIdWhere(msgId), cv);
+}
+
+bool MsgMailboxStore::getTags(uint32_t msgId, std::list<uint32_t>& tagIds)
+{
+	std::list<std::string> columns;
+	columns.push_back(KEY_TAG_ID);
+
+	RS_STACK_MUTEX(mDbMutex);
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery( TAG_TABLE_NAME, columns, msgIdWhere(msgId),
+	                           KEY_TAG_ID ) );
+	if(!c) return false;
+
+	for(bool valid = c->moveToFirst(); valid; valid = c->moveToNext())
+		tagIds.push_back(idFromDb(c->getInt64(0)));
+	return true;
+}
+
+bool MsgMailboxStore::addTag(uint32_t msgId, uint32_t tagId)
+{
+	RS_STACK_MUTEX(mDbMutex);
+	return locked_addTag(msgId, tagId);
+}
+
+bool MsgMailboxStore::locked_addTag(uint32_t msgId, uint32_t tagId)
+{
+	std::list<std::string> columns;
+	columns.push_back(KEY_TAG_ID);
+
+	std::string where = msgIdWhere(msgId) + " AND " + KEY_TAG_ID + "=" +
+	        std::to_string(tagId);
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery(TAG_TABLE_NAME, columns, where, "") );
+	if(c && c->moveToFirst()) return true;
+
+	ContentValue cv;
+	cv.put(KEY_MSG_ID, idValue(msgId));
+	cv.put(KEY_TAG_ID, idValue(tagId));
+	return mDb->sqlInsert(TAG_TABLE_NAME, "", cv);
+}
+
+bool MsgMailboxStore::removeTag(uint32_t msgId, uint32_t tagId)
+{
+	std::string where = msgIdWhere(msgId);
+	if(tagId) where += " AND " + KEY_TAG_ID + "=" + std::to_string(tagId);
+
+	RS_STACK_MUTEX(mDbMutex);
+	return mDb->sqlDelete(TAG_TABLE_NAME, where, "");
+}
+
+bool MsgMailboxStore::removeTagType(uint32_t tagId)
+{
+	RS_STACK_MUTEX(mDbMutex);
+	return mDb->sqlDelete( TAG_TABLE_NAME,
+	                       KEY_TAG_ID + "=" + std::to_string(tagId), "" );
+}
+
+std::string MsgMailboxStore::boxSelection(uint32_t box, uint32_t tagId)
+{
+	std::string where;
+	if(box != RS_MSG_ALLBOXES)
+		where = KEY_MSG_BOX + "=" + std::to_string(box);
+
+	if(tagId)
+	{
+		if(!where.empty()) where += " AND ";
+		where += KEY_MSG_ID + " IN (SELECT " + KEY_MSG_ID + " FROM " +
+		        TAG_TABLE_NAME + " WHERE " + KEY_TAG_ID + "=" +
+		        std::to_string(tagId) + ")";
+	}
+
+	return where;
+}
+
+uint32_t MsgMailboxStore::locked_count(const std::string& selection)
+{
+	std::list<std::string> columns;
+	columns.push_back("COUNT(*)");
+
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery(MSG_TABLE_NAME, columns, selection, "") );
+	if(!c || !c->moveToFirst()) return 0;
+	return static_cast<uint32_t>(c->getInt32(0));
+}
+
+bool MsgMailboxStore::getHeaders(
+        uint32_t box, uint32_t tagId, uint32_t offset, uint32_t count,
+        std::list<MsgMailboxHeader>& headers, uint32_t& total )
+{
+	std::list<std::string> columns;
+	columns.push_back(KEY_MSG_ID);
+	columns.push_back(KEY_MSG_FLAGS);
+	columns.push_back(KEY_SEND_TIME);
+	columns.push_back(KEY_RECV_TIME);
+	columns.push_back(KEY_PEER_ID);
+	columns.push_back(KEY_SUBJECT);
+	columns.push_back(KEY_ATTACH_COUNT);
+
+	std::string where = boxSelection(box, tagId);
+	std::string orderBy = KEY_SEND_TIME + " DESC," + KEY_MSG_ID + " DESC";
+
+	std::map<uint32_t, MsgMailboxHeader*> byId;
+
+	RS_STACK_MUTEX(mDbMutex);
+	total = locked_count(where);
+
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery( MSG_TABLE_NAME, columns, where, orderBy, "",
+	                           count ? static_cast<int64_t>(count) : -1,
+	                           offset ) );
+	if(!c) return false;
+
+	for(bool valid = c->moveToFirst(); valid; valid = c->moveToNext())
+	{
+		headers.push_back(MsgMailboxHeader());
+		MsgMailboxHeader& h(headers.back());
+
+		h.mMsgId = idFromDb(c->getInt64(0));
+		h.mMsgFlags = static_cast<uint32_t>(c->getInt32(1));
+		h.mSendTime = static_cast<uint32_t>(c->getInt64(2));
+		h.mRecvTime = static_cast<uint32_t>(c->getInt64(3));
+		c->getStringT(4, h.mPeerId);
+		c->getString(5, h.mSubject);
+		h.mAttachmentsCount = static_cast<uint32_t>(c->getInt32(6));
+
+		byId[h.mMsgId] = &h;
+	}
+
+	if(byId.empty()) return true;
+
+	/* fetch tags of the whole page at once */
+	std::string tagWhere = KEY_MSG_ID + " IN (";
+	for(auto it = byId.begin(); it != byId.end(); ++it)
+	{
+		if(it != byId.begin()) tagWhere += ",";
+		tagWhere += std::to_string(it->first);
+	}
+	tagWhere += ")";
+
+	columns.clear();
+	columns.push_back(KEY_MSG_ID);
+	columns.push_back(KEY_TAG_ID);
+
+	c.reset(mDb->sqlQuery(TAG_TABLE_NAME, columns, tagWhere, KEY_TAG_ID));
+	if(!c) return false;
+
+	for(bool valid = c->moveToFirst(); valid; valid = c->moveToNext())
+	{
+		auto it = byId.find(idFromDb(c->getInt64(0)));
+		if(it != byId.end())
+			it->second->mTagIds.push_back(
+			            idFromDb(c->getInt64(1)) );
+	}
+
+	return true;
+}
+
+bool MsgMailboxStore::getBoxCounts(
+        uint32_t& nInbox, uint32_t& nInboxNew, uint32_t& nOutbox,
+        uint32_t& nDraftbox, uint32_t& nSentbox, uint32_t& nTrashbox )
+{
+	std::list<std::string> columns;
+	columns.push_back(KEY_MSG_BOX);
+	columns.push_back("COUNT(*)");
+	columns.push_back("SUM((" + KEY_MSG_FLAGS + " & " +
+	                  std::to_string(RS_MSG_FLAGS_NEW) + ") != 0)");
+
+	nInbox = nInboxNew = nOutbox = nDraftbox = nSentbox = nTrashbox = 0;
+
+	RS_STACK_MUTEX(mDbMutex);
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery( MSG_TABLE_NAME, columns, "", "", KEY_MSG_BOX,
+	                           -1 ) );
+	if(!c) return false;
+
+	for(bool valid = c->moveToFirst(); valid; valid = c->moveToNext())
+	{
+		uint32_t n = static_cast<uint32_t>(c->getInt32(1));
+		switch(static_cast<uint32_t>(c->getInt32(0)))
+		{
+		case RS_MSG_INBOX:
+			nInbox += n;
+			nInboxNew += static_cast<uint32_t>(c->getInt32(2));
+			break;
+		case RS_MSG_SENTBOX: nSentbox += n; break;
+		case RS_MSG_OUTBOX: nOutbox += n; break;
+		case RS_MSG_DRAFTBOX: nDraftbox += n; break;
+		case RS_MSG_TRASH: nTrashbox += n; break;
+		default: break;
+		}
+	}
+
+	return true;
+}
+
+uint32_t MsgMailboxStore::getMaxMsgId()
+{
+	std::list<std::string> columns;
+	columns.push_back("MAX(" + KEY_MSG_ID + ")");
+
+	RS_STACK_MUTEX(mDbMutex);
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery(MSG_TABLE_NAME, columns, "", "") );
+	if(!c || !c->moveToFirst()) return 0;
+	return idFromDb(c->getInt64(0));
+}
+
+bool MsgMailboxStore::importMessages(
+        const std::list<RsMsgItem*>& msgs,
+        const std::map<uint32_t, RsPeerId>& srcIds,
+        const std::map<uint32_t, uint32_t>& parentIds,
+        const std::map<uint32_t, std::list<uint32_t> >& tags )
+{
+	RS_STACK_MUTEX(mDbMutex);
+	if(!mDb->isOpen()) return false;
+
+	mDb->beginTransaction();
+
+	bool ok = true;
+	for(const RsMsgItem* msg : msgs)
+	{
+		auto sit = srcIds.find(msg->msgId);
+		ok = ok && locked_storeMessage(
+		            *msg, sit != srcIds.end() ? sit->second : RsPeerId() );
+	}
+
+	for(auto& pit : parentIds)
+		if(pit.second) locked_setParentId(pit.first, pit.second);
+
+	for(auto& tit : tags)
+		if(locked_exists(tit.first))
+			for(uint32_t tagId : tit.second)
+				ok = ok && locked_addTag(tit.first, tagId);
+
+	if(!ok)
+	{
+		std::cerr << __PRETTY_FUNCTION__ << " Error! Failed importing "
+		          << msgs.size() << " messages, rolling back" << std::endl;
+		mDb->rollbackTransaction();
+		return false;
+	}
+
+	return mDb->commitTransaction();
+}
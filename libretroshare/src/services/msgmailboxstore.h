@@ -0,0 +1,163 @@
+/*******************************************************************************
+ * libretroshare/src/services: msgmailboxstore.h                               *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "retroshare/rsmsgs.h"
+#include "retroshare/rstypes.h"
+#include "rsitems/rsmsgitems.h"
+#include "util/rsthreads.h"
+
+class RetroDb;
+class RetroCursor;
+
+/**
+ * Fields of a stored message needed to list it, available without loading
+ * and deserializing the message body.
+ */
+struct MsgMailboxHeader
+{
+	MsgMailboxHeader() :
+	    mMsgId(0), mMsgFlags(0), mSendTime(0), mRecvTime(0),
+	    mAttachmentsCount(0) {}
+
+	uint32_t mMsgId;
+	uint32_t mMsgFlags;
+	uint32_t mSendTime;
+	uint32_t mRecvTime;
+	RsPeerId mPeerId;
+	std::string mSubject;
+	uint32_t mAttachmentsCount;
+	std::list<uint32_t> mTagIds;
+};
+
+/**
+ * Persistent mailbox of p3MsgService.
+ * Messages are kept in a RetroDb database with box, send time and tags
+ * indexed, so folders can be listed a page at a time, while the serialized
+ * message body is read only when a single message is requested.
+ * Flags, source and parent ids are stored in dedicated columns and are
+ * authoritative over the values serialized in the body.
+ * Box values are the RS_MSG_*BOX ones, RS_MSG_TRASH for trashed messages.
+ */
+class MsgMailboxStore
+{
+public:
+	/**
+	 * @param[in] dbPath path of the database file, created if missing
+	 * @param[in] key encryption key, empty for plain sqlite
+	 */
+	MsgMailboxStore(const std::string& dbPath, const std::string& key);
+	~MsgMailboxStore();
+
+	/// @return false if the database couldn't be opened
+	bool isOpen();
+
+	/**
+	 * @brief Insert a message or replace an existing one with the same id.
+	 * Parent id and tags of a replaced message are kept.
+	 * @param[in] msg message to store, ownership is not taken
+	 * @param[in] srcId peer the message was received from, null to keep the
+	 *	stored one
+	 * @return false on database error
+	 */
+	bool storeMessage(const RsMsgItem& msg, const RsPeerId& srcId = RsPeerId());
+
+	/**
+	 * @brief Load and deserialize a full message
+	 * @param[in] msgId id of the message
+	 * @param[out] srcId peer the message was received from, if known
+	 * @return the message, to be deleted by the caller, nullptr if not found
+	 */
+	RsMsgItem* loadMessage(uint32_t msgId, RsPeerId& srcId);
+
+	/// @return messages which flags match value once masked, caller owns them
+	bool loadMessages( uint32_t flagsMask, uint32_t flagsValue,
+	                   std::list<RsMsgItem*>& msgs );
+
+	/// Remove a message with its tags, return false if it didn't exist
+	bool removeMessage(uint32_t msgId);
+
+	bool getFlags(uint32_t msgId, uint32_t& msgFlags);
+	bool setFlags(uint32_t msgId, uint32_t msgFlags);
+
+	bool getParentId(uint32_t msgId, uint32_t& parentId);
+	/// parentId == 0 removes the parent
+	bool setParentId(uint32_t msgId, uint32_t parentId);
+
+	bool getTags(uint32_t msgId, std::list<uint32_t>& tagIds);
+	bool addTag(uint32_t msgId, uint32_t tagId);
+	/// tagId == 0 removes all the tags of the message
+	bool removeTag(uint32_t msgId, uint32_t tagId);
+	/// Remove a tag from every message
+	bool removeTagType(uint32_t tagId);
+
+	/**
+	 * @brief List message headers, newest first
+	 * @param[in] box box to list, RS_MSG_ALLBOXES for all of them
+	 * @param[in] tagId list only messages with this tag, 0 for any
+	 * @param[in] offset number of matching messages to skip
+	 * @param[in] count maximum number of headers to return, 0 for no limit
+	 * @param[out] headers storage for the headers
+	 * @param[out] total number of matching messages, ignoring offset and count
+	 * @return false on database error
+	 */
+	bool getHeaders( uint32_t box, uint32_t tagId, uint32_t offset,
+	                 uint32_t count, std::list<MsgMailboxHeader>& headers,
+	                 uint32_t& total );
+
+	bool getBoxCounts( uint32_t& nInbox, uint32_t& nInboxNew,
+	                   uint32_t& nOutbox, uint32_t& nDraftbox,
+	                   uint32_t& nSentbox, uint32_t& nTrashbox );
+
+	/// @return the highest stored message id, 0 if the store is empty
+	uint32_t getMaxMsgId();
+
+	/**
+	 * @brief Import messages from the former config file storage in a
+	 * single transaction.
+	 * @return false if nothing was imported due to a database error
+	 */
+	bool importMessages( const std::list<RsMsgItem*>& msgs,
+	                     const std::map<uint32_t, RsPeerId>& srcIds,
+	                     const std::map<uint32_t, uint32_t>& parentIds,
+	                     const std::map<uint32_t, std::list<uint32_t> >& tags );
+
+	/// @return box of a message with the given flags
+	static uint32_t flagsToBox(uint32_t msgFlags);
+
+private:
+	void initTables();
+	bool locked_exists(uint32_t msgId);
+	bool locked_storeMessage(const RsMsgItem& msg, const RsPeerId& srcId);
+	bool locked_setParentId(uint32_t msgId, uint32_t parentId);
+	bool locked_addTag(uint32_t msgId, uint32_t tagId);
+	uint32_t locked_count(const std::string& selection);
+	std::string boxSelection(uint32_t box, uint32_t tagId);
+
+	RsMutex mDbMutex;
+	RetroDb* mDb;
+	RsMsgSerialiser mSerialiser;
+};
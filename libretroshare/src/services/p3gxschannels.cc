@@ -100,7 +100,10 @@ p3GxsChannels::p3GxsChannels(
 
 const std::string GXS_CHANNELS_APP_NAME = "gxschannels";
 const uint16_t GXS_CHANNELS_APP_MAJOR_VERSION  =       1;
-const uint16_t GXS_CHANNELS_APP_MINOR_VERSION  =       0;
+// 1.1: batched message sync requests, see RsGxsNetService::BATCHED_SYNC_MINOR_VERSION
+// 1.2: new message announces, see RsGxsNetService::MSG_ANNOUNCE_MINOR_VERSION
+// 1.3: fragmented messages, see RsGxsNetService::FRAGMENTED_MSG_MINOR_VERSION
+const uint16_t GXS_CHANNELS_APP_MINOR_VERSION  =       3;
 const uint16_t GXS_CHANNELS_MIN_MAJOR_VERSION  =       1;
 const uint16_t GXS_CHANNELS_MIN_MINOR_VERSION  =       0;
 
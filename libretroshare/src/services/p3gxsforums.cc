@@ -43,16 +43,24 @@ RsGxsForums *rsGxsForums = NULL;
 #define FORUM_TESTEVENT_DUMMYDATA	0x0001
 #define DUMMYDATA_PERIOD		60	// long enough for some RsIdentities to be generated.
 
+#define GXSFORUMS_THREAD_INDEX_META	0x0021
+#define GXSFORUMS_THREAD_INDEX_MSG_CHECK	0x0022
+#define GXSFORUMS_THREAD_INDEX_GRP_CHECK	0x0023
+
 /********************************************************************************/
 /******************* Startup / Tick    ******************************************/
 /********************************************************************************/
 
 p3GxsForums::p3GxsForums( RsGeneralDataService *gds,
-                          RsNetworkExchangeService *nes, RsGixs* gixs ) :
+                          RsNetworkExchangeService *nes, RsGixs* gixs,
+                          const std::string& threadIndexDbPath,
+                          const std::string& dbKey ) :
     RsGenExchange( gds, nes, new RsGxsForumSerialiser(),
                    RS_SERVICE_GXS_TYPE_FORUMS, gixs, forumsAuthenPolicy()),
-    RsGxsForums(static_cast<RsGxsIface&>(*this)), mGenToken(0),
-    mGenActive(false), mGenCount(0)
+    RsGxsForums(static_cast<RsGxsIface&>(*this)), GxsTokenQueue(this),
+    mGenToken(0), mGenActive(false), mGenCount(0),
+    mThreadIndex(threadIndexDbPath, dbKey),
+    mThreadIndexMtx("GxsForumsThreadIndexMtx")
 {
 	// Test Data disabled in Repo.
 	//RsTickEvent::schedule_in(FORUM_TESTEVENT_DUMMYDATA, DUMMYDATA_PERIOD);
@@ -61,7 +69,10 @@ p3GxsForums::p3GxsForums( RsGeneralDataService *gds,
 
 const std::string GXS_FORUMS_APP_NAME = "gxsforums";
 const uint16_t GXS_FORUMS_APP_MAJOR_VERSION  =       1;
-const uint16_t GXS_FORUMS_APP_MINOR_VERSION  =       0;
+// 1.1: batched message sync requests, see RsGxsNetService::BATCHED_SYNC_MINOR_VERSION
+// 1.2: new message announces, see RsGxsNetService::MSG_ANNOUNCE_MINOR_VERSION
+// 1.3: fragmented messages, see RsGxsNetService::FRAGMENTED_MSG_MINOR_VERSION
+const uint16_t GXS_FORUMS_APP_MINOR_VERSION  =       3;
 const uint16_t GXS_FORUMS_MIN_MAJOR_VERSION  =       1;
 const uint16_t GXS_FORUMS_MIN_MINOR_VERSION  =       0;
 
@@ -167,6 +178,7 @@ bool p3GxsForums::loadList(std::list<RsItem *>& loadList)
 
 		delete item ;
 	}
+
 	return true;
 }
 
@@ -180,6 +192,44 @@ RsSerialiser* p3GxsForums::setupSerialiser()
 
 void p3GxsForums::notifyChanges(std::vector<RsGxsNotify *> &changes)
 {
+	for(auto it(changes.begin()); it != changes.end(); ++it)
+	{
+		RsGxsMsgChange *msgChange = dynamic_cast<RsGxsMsgChange*>(*it);
+		RsGxsGroupChange *grpChange = dynamic_cast<RsGxsGroupChange*>(*it);
+
+		RS_STACK_MUTEX(mThreadIndexMtx);
+
+		if(msgChange && !msgChange->metaChange())
+		{
+			// New messages are added, processed ones may have been removed
+			GxsMsgReq *msgReq = NULL;
+			switch(msgChange->getType())
+			{
+			case RsGxsNotify::TYPE_RECEIVED_NEW:
+			case RsGxsNotify::TYPE_PUBLISHED: msgReq = &mThreadIndexPending; break;
+			case RsGxsNotify::TYPE_PROCESSED: msgReq = &mThreadIndexCheckMsgs; break;
+			default: break;
+			}
+
+			if(msgReq)
+				for(auto mit(msgChange->msgChangeMap.begin()); mit != msgChange->msgChangeMap.end(); ++mit)
+					if( mThreadIndex.isIndexed(mit->first) ||
+					        mThreadIndexBuilding.find(mit->first) != mThreadIndexBuilding.end() )
+						(*msgReq)[mit->first].insert(mit->second.begin(), mit->second.end());
+		}
+		else if( grpChange &&
+		         ( grpChange->getType() == RsGxsNotify::TYPE_PROCESSED ||
+		           grpChange->getType() == RsGxsNotify::TYPE_PUBLISHED ) )
+		{
+			// Deleted forums come as published or processed, unsubscribed
+			// ones as processed meta changes
+			for(auto git(grpChange->mGrpIdList.begin()); git != grpChange->mGrpIdList.end(); ++git)
+				if( mThreadIndex.isIndexed(*git) ||
+				        mThreadIndexBuilding.find(*git) != mThreadIndexBuilding.end() )
+					mThreadIndexCheckForums.insert(*git);
+		}
+	}
+
 	if (!changes.empty())
 	{
 		p3Notify *notify = RsServer::notify();
@@ -265,6 +315,10 @@ void	p3GxsForums::service_tick()
 {
 	dummy_tick();
 	RsTickEvent::tick_events();
+	GxsTokenQueue::checkRequests();
+
+	threadIndexRequestPending();
+	threadIndexRequestChecks();
 	return;
 }
 
@@ -498,6 +552,310 @@ bool p3GxsForums::getForumMsgMetaData(const RsGxsGroupId& forumId, std::vector<R
     return res;
 }
 
+bool p3GxsForums::getForumThreadsPage(
+        const RsGxsGroupId& forumId, uint32_t offset, uint32_t count,
+        std::vector<RsGxsForumThreadEntry>& threads, uint32_t& threadsCount )
+{
+	threads.clear();
+	if(!threadIndexEnsure(forumId)) return false;
+
+	std::vector<RsGxsMessageId> msgIds;
+	if(!mThreadIndex.getThreadsPage(forumId, offset, count, msgIds))
+		return false;
+	threadsCount = mThreadIndex.threadsCount(forumId);
+
+	return threadIndexFillEntries(forumId, msgIds, threads);
+}
+
+bool p3GxsForums::getForumSubtree(
+        const RsGxsGroupId& forumId, const RsGxsMessageId& msgId,
+        std::vector<RsGxsForumThreadEntry>& msgs )
+{
+	msgs.clear();
+	if(!threadIndexEnsure(forumId)) return false;
+
+	std::vector<RsGxsMessageId> msgIds;
+	if(!mThreadIndex.getSubtree(forumId, msgId, msgIds)) return false;
+
+	return threadIndexFillEntries(forumId, msgIds, msgs);
+}
+
+static std::vector<GxsForumThreadIndexRecord> threadIndexRecords(
+        const std::vector<RsMsgMetaData>& metas )
+{
+	std::vector<GxsForumThreadIndexRecord> records(metas.size());
+	for(uint32_t i = 0; i < metas.size(); ++i)
+	{
+		records[i].mMsgId = metas[i].mMsgId;
+		records[i].mParentId = metas[i].mParentId;
+		records[i].mPublishTs = metas[i].mPublishTs;
+	}
+	return records;
+}
+
+bool p3GxsForums::threadIndexEnsure(const RsGxsGroupId& forumId)
+{
+	{
+		RS_STACK_MUTEX(mThreadIndexMtx);
+
+		// Another caller is building it, use its result
+		if(mThreadIndexBuilding.find(forumId) != mThreadIndexBuilding.end())
+		{
+			mThreadIndexBuilt.wait( mThreadIndexMtx, [&]() {
+				return mThreadIndexBuilding.find(forumId) == mThreadIndexBuilding.end(); } );
+			return mThreadIndex.isIndexed(forumId);
+		}
+
+		if(mThreadIndex.isIndexed(forumId)) return true;
+
+		// New messages arriving meanwhile are kept pending until it's done
+		mThreadIndexBuilding.insert(forumId);
+	}
+
+	std::vector<RsMsgMetaData> metas;
+	bool ok = getForumMsgMetaData(forumId, metas);
+	if(!ok)
+		std::cerr << __PRETTY_FUNCTION__ << " Error! Failed getting "
+		          << "metadata of forum: " << forumId << std::endl;
+	else
+		ok = mThreadIndex.buildIndex(forumId, threadIndexRecords(metas));
+
+	{
+		RS_STACK_MUTEX(mThreadIndexMtx);
+		mThreadIndexBuilding.erase(forumId);
+	}
+	mThreadIndexBuilt.notify_all();
+	return ok;
+}
+
+bool p3GxsForums::threadIndexFillEntries(
+        const RsGxsGroupId& forumId, const std::vector<RsGxsMessageId>& msgIds,
+        std::vector<RsGxsForumThreadEntry>& entries )
+{
+	entries.clear();
+	if(msgIds.empty()) return true;
+
+	uint32_t token;
+	RsTokReqOptions opts;
+	opts.mReqType = GXS_REQUEST_TYPE_MSG_META;
+
+	GxsMsgReq msgReq;
+	msgReq[forumId].insert(msgIds.begin(), msgIds.end());
+
+	GxsMsgMetaMap metaMap;
+	if( !requestMsgInfo(token, opts, msgReq) ||
+	        waitToken(token,std::chrono::milliseconds(5000)) != RsTokenService::COMPLETE ||
+	        !getMsgMetaData(token, metaMap) )
+		return false;
+
+	std::map<RsGxsMessageId, const RsMsgMetaData*> metaById;
+	const std::vector<RsMsgMetaData>& metas(metaMap[forumId]);
+	for(auto it(metas.begin()); it != metas.end(); ++it)
+		metaById[it->mMsgId] = &(*it);
+
+	entries.reserve(msgIds.size());
+	for(auto it(msgIds.begin()); it != msgIds.end(); ++it)
+	{
+		auto mit = metaById.find(*it);
+		if(mit == metaById.end())
+		{
+			// Deleted by cleanup since it was indexed
+			mThreadIndex.removeMessage(forumId, *it);
+			continue;
+		}
+
+		RsGxsForumThreadEntry entry;
+		entry.mMeta = *mit->second;
+		mThreadIndex.getStats( forumId, *it, entry.mLastActivityTs,
+		                       entry.mChildrenCount, entry.mDescendantsCount );
+		entries.push_back(entry);
+	}
+
+	return true;
+}
+
+void p3GxsForums::threadIndexRequestPending()
+{
+	GxsMsgReq msgReq;
+	{
+		RS_STACK_MUTEX(mThreadIndexMtx);
+		for(auto it(mThreadIndexPending.begin()); it != mThreadIndexPending.end();)
+			if(mThreadIndexBuilding.find(it->first) == mThreadIndexBuilding.end())
+			{
+				if(mThreadIndex.isIndexed(it->first))
+					msgReq[it->first].swap(it->second);
+				it = mThreadIndexPending.erase(it);
+			}
+			else ++it;
+	}
+
+	if(msgReq.empty()) return;
+
+	uint32_t token;
+	uint32_t ansType = RS_TOKREQ_ANSTYPE_SUMMARY;
+	RsTokReqOptions opts;
+	opts.mReqType = GXS_REQUEST_TYPE_MSG_META;
+
+	RsGenExchange::getTokenService()->requestMsgInfo(token, ansType, opts, msgReq);
+	GxsTokenQueue::queueRequest(token, GXSFORUMS_THREAD_INDEX_META);
+}
+
+void p3GxsForums::threadIndexLoadPending(const uint32_t &token)
+{
+	GxsMsgMetaMap metaMap;
+	if(!getMsgMetaData(token, metaMap))
+	{
+		std::cerr << __PRETTY_FUNCTION__ << " Error! Failed getting metadata "
+		          << "of new messages." << std::endl;
+		return;
+	}
+
+	for(auto mit(metaMap.begin()); mit != metaMap.end(); ++mit)
+		if(mThreadIndex.isIndexed(mit->first))
+			mThreadIndex.addMessages(mit->first, threadIndexRecords(mit->second));
+}
+
+void p3GxsForums::threadIndexRequestChecks()
+{
+	GxsMsgReq msgReq;
+	std::list<RsGxsGroupId> forumIds;
+	{
+		RS_STACK_MUTEX(mThreadIndexMtx);
+
+		// Forums being built are checked once done
+		for(auto it(mThreadIndexCheckMsgs.begin()); it != mThreadIndexCheckMsgs.end();)
+			if(mThreadIndexBuilding.find(it->first) == mThreadIndexBuilding.end())
+			{
+				if(mThreadIndex.isIndexed(it->first))
+					msgReq[it->first].swap(it->second);
+				it = mThreadIndexCheckMsgs.erase(it);
+			}
+			else ++it;
+
+		for(auto it(mThreadIndexCheckForums.begin()); it != mThreadIndexCheckForums.end();)
+			if(mThreadIndexBuilding.find(*it) == mThreadIndexBuilding.end())
+			{
+				if(mThreadIndex.isIndexed(*it))
+					forumIds.push_back(*it);
+				it = mThreadIndexCheckForums.erase(it);
+			}
+			else ++it;
+	}
+
+	uint32_t ansType = RS_TOKREQ_ANSTYPE_SUMMARY;
+
+	if(!msgReq.empty())
+	{
+		uint32_t token;
+		RsTokReqOptions opts;
+		opts.mReqType = GXS_REQUEST_TYPE_MSG_META;
+
+		RsGenExchange::getTokenService()->requestMsgInfo(token, ansType, opts, msgReq);
+		{
+			RS_STACK_MUTEX(mThreadIndexMtx);
+			mThreadIndexMsgChecks[token].swap(msgReq);
+		}
+		GxsTokenQueue::queueRequest(token, GXSFORUMS_THREAD_INDEX_MSG_CHECK);
+	}
+
+	if(!forumIds.empty())
+	{
+		uint32_t token;
+		RsTokReqOptions opts;
+		opts.mReqType = GXS_REQUEST_TYPE_GROUP_META;
+
+		RsGenExchange::getTokenService()->requestGroupInfo(token, ansType, opts, forumIds);
+		{
+			RS_STACK_MUTEX(mThreadIndexMtx);
+			mThreadIndexForumChecks[token].swap(forumIds);
+		}
+		GxsTokenQueue::queueRequest(token, GXSFORUMS_THREAD_INDEX_GRP_CHECK);
+	}
+}
+
+void p3GxsForums::threadIndexCheckMessages(const uint32_t &token)
+{
+	GxsMsgReq msgReq;
+	{
+		RS_STACK_MUTEX(mThreadIndexMtx);
+		auto it = mThreadIndexMsgChecks.find(token);
+		if(it == mThreadIndexMsgChecks.end()) return;
+		msgReq.swap(it->second);
+		mThreadIndexMsgChecks.erase(it);
+	}
+
+	GxsMsgMetaMap metaMap;
+	if(!getMsgMetaData(token, metaMap))
+	{
+		std::cerr << __PRETTY_FUNCTION__ << " Error! Failed getting metadata "
+		          << "of processed messages." << std::endl;
+		return;
+	}
+
+	// Whatever is still there is kept, the rest has been removed
+	for(auto mit(metaMap.begin()); mit != metaMap.end(); ++mit)
+		for(auto it(mit->second.begin()); it != mit->second.end(); ++it)
+			msgReq[mit->first].erase(it->mMsgId);
+
+	for(auto mit(msgReq.begin()); mit != msgReq.end(); ++mit)
+		for(auto it(mit->second.begin()); it != mit->second.end(); ++it)
+			mThreadIndex.removeMessage(mit->first, *it);
+}
+
+void p3GxsForums::threadIndexCheckForums(const uint32_t &token)
+{
+	std::list<RsGxsGroupId> forumIds;
+	{
+		RS_STACK_MUTEX(mThreadIndexMtx);
+		auto it = mThreadIndexForumChecks.find(token);
+		if(it == mThreadIndexForumChecks.end()) return;
+		forumIds.swap(it->second);
+		mThreadIndexForumChecks.erase(it);
+	}
+
+	std::list<RsGroupMetaData> forums;
+	if(!getGroupMeta(token, forums))
+	{
+		std::cerr << __PRETTY_FUNCTION__ << " Error! Failed getting metadata "
+		          << "of processed forums." << std::endl;
+		return;
+	}
+
+	// Messages of unsubscribed forums are removed by the next cleanup
+	std::set<RsGxsGroupId> kept;
+	for(auto it(forums.begin()); it != forums.end(); ++it)
+		if(it->mSubscribeFlags & GXS_SERV::GROUP_SUBSCRIBE_SUBSCRIBED)
+			kept.insert(it->mGroupId);
+
+	for(auto it(forumIds.begin()); it != forumIds.end(); ++it)
+		if(kept.find(*it) == kept.end())
+		{
+			RS_STACK_MUTEX(mThreadIndexMtx);
+			if(mThreadIndexBuilding.find(*it) == mThreadIndexBuilding.end())
+				mThreadIndex.removeForum(*it);
+		}
+}
+
+void p3GxsForums::handleResponse(uint32_t token, uint32_t req_type)
+{
+	switch(req_type)
+	{
+	case GXSFORUMS_THREAD_INDEX_META:
+		threadIndexLoadPending(token);
+		break;
+	case GXSFORUMS_THREAD_INDEX_MSG_CHECK:
+		threadIndexCheckMessages(token);
+		break;
+	case GXSFORUMS_THREAD_INDEX_GRP_CHECK:
+		threadIndexCheckForums(token);
+		break;
+	default:
+		std::cerr << "p3GxsForums::handleResponse() Unknown Request Type: "
+		          << req_type << std::endl;
+		break;
+	}
+}
+
 bool p3GxsForums::markRead(const RsGxsGrpMsgIdPair& msgId, bool read)
 {
 	uint32_t token;
@@ -25,9 +25,12 @@
 
 #include "retroshare/rsgxsforums.h"
 #include "gxs/rsgenexchange.h"
+#include "gxs/gxstokenqueue.h"
+#include "services/gxsforumthreadindex.h"
 
 #include "util/rstickevent.h"
 
+#include <condition_variable>
 #include <map>
 #include <string>
 
@@ -35,12 +38,18 @@
  *
  */
 
-class p3GxsForums: public RsGenExchange, public RsGxsForums, public p3Config,
+class p3GxsForums: public RsGenExchange, public RsGxsForums,
+	public GxsTokenQueue, public p3Config,
 	public RsTickEvent	/* only needed for testing - remove after */
 {
 public:
+	/**
+	 * @param[in] threadIndexDbPath path of the thread index database
+	 * @param[in] dbKey encryption key of the thread index database
+	 */
 	p3GxsForums(
-	        RsGeneralDataService* gds, RsNetworkExchangeService* nes, RsGixs* gixs);
+	        RsGeneralDataService* gds, RsNetworkExchangeService* nes, RsGixs* gixs,
+	        const std::string& threadIndexDbPath, const std::string& dbKey );
 
 	virtual RsServiceInfo getServiceInfo();
 	virtual void service_tick();
@@ -50,6 +59,9 @@ protected:
 	/// Overloaded from RsTickEvent.
 	virtual void handle_event(uint32_t event_type, const std::string &elabel);
 
+	/// Overloaded from GxsTokenQueue for Request callbacks.
+	virtual void handleResponse(uint32_t token, uint32_t req_type);
+
 	virtual RsSerialiser* setupSerialiser();                            // @see p3Config::setupSerialiser()
 	virtual bool saveList(bool &cleanup, std::list<RsItem *>&saveList); // @see p3Config::saveList(bool &cleanup, std::list<RsItem *>&)
 	virtual bool loadList(std::list<RsItem *>& loadList);               // @see p3Config::loadList(std::list<RsItem *>&)
@@ -75,6 +87,17 @@ public:
 	/// @see RsGxsForums::getForumMsgMetaData
 	virtual bool getForumMsgMetaData(const RsGxsGroupId& forumId, std::vector<RsMsgMetaData>& msg_metas) ;
 
+	/// @see RsGxsForums::getForumThreadsPage
+	virtual bool getForumThreadsPage(
+	        const RsGxsGroupId& forumId, uint32_t offset, uint32_t count,
+	        std::vector<RsGxsForumThreadEntry>& threads,
+	        uint32_t& threadsCount );
+
+	/// @see RsGxsForums::getForumSubtree
+	virtual bool getForumSubtree(
+	        const RsGxsGroupId& forumId, const RsGxsMessageId& msgId,
+	        std::vector<RsGxsForumThreadEntry>& msgs );
+
 	/// @see RsGxsForums::getForumContent
 	virtual bool getForumContent(
 	        const RsGxsGroupId& forumId,
@@ -100,6 +123,28 @@ private:
 
 static uint32_t forumsAuthenPolicy();
 
+	/** Build the thread index of a forum from the whole forum metadata if it
+	 * doesn't exist yet. This is done once per forum, the index database is
+	 * then kept up to date as messages arrive. Callers asking for a forum
+	 * being built wait for that build instead of starting another one. */
+	bool threadIndexEnsure(const RsGxsGroupId& forumId);
+
+	/** Load the metadata of the given messages and wrap them with the index
+	 * statistics. Messages that no longer exist are dropped from the index. */
+	bool threadIndexFillEntries( const RsGxsGroupId& forumId,
+	                             const std::vector<RsGxsMessageId>& msgIds,
+	                             std::vector<RsGxsForumThreadEntry>& entries );
+
+	void threadIndexRequestPending();
+	void threadIndexLoadPending(const uint32_t &token);
+
+	/** Messages and forums reported as changed by deletion, cleanup or
+	 * unsubscription are looked up again, and dropped from the index if they
+	 * are gone. */
+	void threadIndexRequestChecks();
+	void threadIndexCheckMessages(const uint32_t &token);
+	void threadIndexCheckForums(const uint32_t &token);
+
 virtual bool generateDummyData();
 
 std::string genRandomId();
@@ -128,6 +173,23 @@ bool generateGroup(uint32_t &token, std::string groupName);
 	std::vector<ForumDummyRef> mGenRefs;
 	RsGxsMessageId mGenThreadId;
     std::map<RsGxsGroupId,rstime_t> mKnownForums ;
+
+	GxsForumThreadIndex mThreadIndex;
+
+	/// Protects the thread index build and update state below
+	RsMutex mThreadIndexMtx;
+	/// Forums which index is being built from scratch
+	std::set<RsGxsGroupId> mThreadIndexBuilding;
+	/// Signaled when a build ends, waited by the callers of the same forum
+	std::condition_variable_any mThreadIndexBuilt;
+	/// New messages waiting for their metadata to be added to the index
+	GxsMsgReq mThreadIndexPending;
+	/// Messages and forums which may have been removed, waiting to be checked
+	GxsMsgReq mThreadIndexCheckMsgs;
+	std::set<RsGxsGroupId> mThreadIndexCheckForums;
+	/// Ids looked up by the check requests in flight, by token
+	std::map<uint32_t, GxsMsgReq> mThreadIndexMsgChecks;
+	std::map<uint32_t, std::list<RsGxsGroupId> > mThreadIndexForumChecks;
 	
 };
 
@@ -140,6 +140,7 @@ RsIdentity *rsIdentity = NULL;
 #define PGPHASH_PERIOD			60
 #define PGPHASH_RETRY_PERIOD		11
 #define PGPHASH_PROC_PERIOD		1
+#define PGPHASH_PROC_BATCH_SIZE		256
 
 #define RECOGN_PERIOD			90
 #define RECOGN_RETRY_PERIOD		17
@@ -160,7 +161,7 @@ p3IdService::p3IdService(
                      RS_SERVICE_GXS_TYPE_GXSID, idAuthenPolicy() ),
     RsIdentity(static_cast<RsGxsIface&>(*this)), GxsTokenQueue(this),
     RsTickEvent(), mKeyCache(GXSID_MAX_CACHE_SIZE, "GxsIdKeyCache"),
-    mIdMtx("p3IdService"), mNes(nes), mPgpUtils(pgpUtils)
+    mPgpHashPool("gxsid pgphash"), mIdMtx("p3IdService"), mNes(nes), mPgpUtils(pgpUtils)
 {
 	mBgSchedule_Mode = 0;
     mBgSchedule_Active = false;
@@ -3663,28 +3664,16 @@ bool p3IdService::pgphash_handlerequest(uint32_t token)
 
 bool p3IdService::pgphash_process()
 {
-	/* each time this is called - process one Id from mGroupsToProcess */
-	RsGxsIdGroup pg;
-	bool isDone = false;
-	{
-		RsStackMutex stack(mIdMtx); /********** STACK LOCKED MTX ******/
-		if (!mGroupsToProcess.empty())
-		{
-			pg = mGroupsToProcess.front();
-			mGroupsToProcess.pop_front();
-
-#ifdef DEBUG_IDS
-			std::cerr << "p3IdService::pgphash_process() Popped Group: " << pg.mMeta.mGroupId;
-			std::cerr << std::endl;
-#endif // DEBUG_IDS
-		}
-		else
-		{
-			isDone = true;
-		}
-	}
+	/* each time this is called - process a batch of Ids from mGroupsToProcess.
+	 * The signature checks of the batch run in mPgpHashPool, the results are
+	 * then applied from this thread.
+	 */
+	std::vector<RsGxsIdGroup> groups;
+	std::vector<RsPgpId> pgpIds;
+	std::vector<uint8_t> matches;
+	std::vector<uint8_t> errors;
 
-	if (isDone)
+	if (!pgphash_checkBatch(groups, pgpIds, matches, errors))
 	{
 #ifdef DEBUG_IDS
 		std::cerr << "p3IdService::pgphash_process() List Empty... Done";
@@ -3694,68 +3683,108 @@ bool p3IdService::pgphash_process()
 		CacheArbitrationDone(BG_PGPHASH);
 		return true;
 	}
-	
-
-	SSGxsIdGroup ssdata;
-	ssdata.load(pg.mMeta.mServiceString); // attempt load - okay if fails.
 
-    RsPgpId pgpId;
-    bool error = false ;
+#ifdef DEBUG_IDS
+	std::cerr << "p3IdService::pgphash_process() Popped " << groups.size() << " Groups";
+	std::cerr << std::endl;
+#endif // DEBUG_IDS
 
-    if (checkId(pg, pgpId,error))
+	for(uint32_t i = 0; i < groups.size(); ++i)
 	{
-		/* found a match - update everything */
-		/* Consistency issues here - what if Reputation was recently updated? */
+		const RsGxsIdGroup& pg = groups[i];
+		const RsPgpId& pgpId = pgpIds[i];
+
+		SSGxsIdGroup ssdata;
+		ssdata.load(pg.mMeta.mServiceString); // attempt load - okay if fails.
+
+		if (matches[i])
+		{
+			/* found a match - update everything */
+			/* Consistency issues here - what if Reputation was recently updated? */
 
 #ifdef DEBUG_IDS
-		std::cerr << "p3IdService::pgphash_process() CheckId Success for Group: " << pg.mMeta.mGroupId;
-        std::cerr << " PgpId: " << pgpId;
-		std::cerr << std::endl;
+			std::cerr << "p3IdService::pgphash_process() CheckId Success for Group: " << pg.mMeta.mGroupId;
+			std::cerr << " PgpId: " << pgpId;
+			std::cerr << std::endl;
 #endif // DEBUG_IDS
 
-		/* update */
-		ssdata.pgp.validatedSignature = true;
-		ssdata.pgp.pgpId = pgpId;
-
-	}
-    else if(error)
-    {
-            std::cerr << "Identity has an invalid signature. It will be deleted." << std::endl;
+			/* update */
+			ssdata.pgp.validatedSignature = true;
+			ssdata.pgp.pgpId = pgpId;
+		}
+		else if(errors[i])
+		{
+			std::cerr << "Identity has an invalid signature. It will be deleted." << std::endl;
 
-            uint32_t token ;
-            deleteIdentity(token,pg) ;
-    }
-    else
-	{
+			uint32_t token ;
+			deleteIdentity(token,groups[i]) ;
+			continue;
+		}
+		else
+		{
 #ifdef DEBUG_IDS
-		std::cerr << "p3IdService::pgphash_process() No Match for Group: " << pg.mMeta.mGroupId;
-		std::cerr << std::endl;
+			std::cerr << "p3IdService::pgphash_process() No Match for Group: " << pg.mMeta.mGroupId;
+			std::cerr << std::endl;
 #endif // DEBUG_IDS
 
-		ssdata.pgp.lastCheckTs = time(NULL);
-		ssdata.pgp.checkAttempts++;
-		ssdata.pgp.pgpId = pgpId;	// read from the signature, but not verified
-	}
+			ssdata.pgp.lastCheckTs = time(NULL);
+			ssdata.pgp.checkAttempts++;
+			ssdata.pgp.pgpId = pgpId;	// read from the signature, but not verified
+		}
 
-    if(!error)
-    {
-        // update IdScore too.
-        ssdata.score.rep.updateIdScore(true, ssdata.pgp.validatedSignature);
-        ssdata.score.rep.update();
+		// update IdScore too.
+		ssdata.score.rep.updateIdScore(true, ssdata.pgp.validatedSignature);
+		ssdata.score.rep.update();
 
-        /* set new Group ServiceString */
-        uint32_t dummyToken = 0;
-        std::string serviceString = ssdata.save();
-        setGroupServiceString(dummyToken, pg.mMeta.mGroupId, serviceString);
+		/* set new Group ServiceString */
+		uint32_t dummyToken = 0;
+		std::string serviceString = ssdata.save();
+		setGroupServiceString(dummyToken, pg.mMeta.mGroupId, serviceString);
 
-        cache_update_if_cached(RsGxsId(pg.mMeta.mGroupId), serviceString);
-    }
+		cache_update_if_cached(RsGxsId(pg.mMeta.mGroupId), serviceString);
+	}
 
 	// Schedule Next Processing.
 	RsTickEvent::schedule_in(GXSID_EVENT_PGPHASH_PROC, PGPHASH_PROC_PERIOD);
 	return false; // as there are more items on the queue to process.
 }
 
+bool p3IdService::pgphash_checkBatch( std::vector<RsGxsIdGroup>& groups,
+                                      std::vector<RsPgpId>& pgpIds,
+                                      std::vector<uint8_t>& matches,
+                                      std::vector<uint8_t>& errors )
+{
+	groups.clear();
+	{
+		RsStackMutex stack(mIdMtx); /********** STACK LOCKED MTX ******/
+		while(!mGroupsToProcess.empty() && groups.size() < PGPHASH_PROC_BATCH_SIZE)
+		{
+			groups.push_back(mGroupsToProcess.front());
+			mGroupsToProcess.pop_front();
+		}
+	}
+
+	pgpIds.assign(groups.size(), RsPgpId());
+	matches.assign(groups.size(), 0);
+	errors.assign(groups.size(), 0);
+
+	if (groups.empty())
+		return false;
+
+	std::vector<std::function<void()> > jobs;
+	jobs.reserve(groups.size());
+
+	for(uint32_t i = 0; i < groups.size(); ++i)
+		jobs.push_back([this,i,&groups,&pgpIds,&matches,&errors]()
+		{
+			bool error = false;
+			matches[i] = checkId(groups[i], pgpIds[i], error);
+			errors[i] = error;
+		});
+
+	mPgpHashPool.runAndWait(jobs);
+	return true;
+}
 
 
 bool p3IdService::checkId(const RsGxsIdGroup &grp, RsPgpId &pgpId,bool& error)
@@ -3784,6 +3813,7 @@ bool p3IdService::checkId(const RsGxsIdGroup &grp, RsPgpId &pgpId,bool& error)
     std::cerr << "Checking group signature " << esign << std::endl;
 #endif
     RsPgpId issuer_id ;
+    bool issuer_known = false ;
 
     if(mPgpUtils->parseSignature((unsigned char *) grp.mPgpIdSign.c_str(), grp.mPgpIdSign.length(),issuer_id))
     {
@@ -3791,6 +3821,7 @@ bool p3IdService::checkId(const RsGxsIdGroup &grp, RsPgpId &pgpId,bool& error)
 	    std::cerr << "Issuer found: " << issuer_id << std::endl;
 #endif
 	    pgpId = issuer_id ;
+	    issuer_known = true ;
     }
     else
     {
@@ -3803,10 +3834,27 @@ bool p3IdService::checkId(const RsGxsIdGroup &grp, RsPgpId &pgpId,bool& error)
 	std::cerr << std::endl;
 #endif // DEBUG_IDS
 
-	RsStackMutex stack(mIdMtx); /********** STACK LOCKED MTX ******/
+	/* The signature issuer is the only key that can produce a valid match, so
+	 * use it to index mPgpFingerprintMap directly. All the known keys are only
+	 * tried when the signature cannot be parsed. The candidates are copied so
+	 * that the hashing and signature checks run without holding mIdMtx.
+	 */
+	std::map<RsPgpId, PGPFingerprintType> candidates;
+	{
+		RsStackMutex stack(mIdMtx); /********** STACK LOCKED MTX ******/
+
+		if(issuer_known)
+		{
+			std::map<RsPgpId, PGPFingerprintType>::const_iterator it = mPgpFingerprintMap.find(issuer_id);
+			if(it != mPgpFingerprintMap.end())
+				candidates.insert(*it);
+		}
+		else
+			candidates = mPgpFingerprintMap;
+	}
 
 	std::map<RsPgpId, PGPFingerprintType>::iterator mit;
-	for(mit = mPgpFingerprintMap.begin(); mit != mPgpFingerprintMap.end(); ++mit)
+	for(mit = candidates.begin(); mit != candidates.end(); ++mit)
 	{
 		Sha1CheckSum hash;
         calcPGPHash(RsGxsId(grp.mMeta.mGroupId), mit->second, hash);
@@ -3861,7 +3909,7 @@ bool p3IdService::checkId(const RsGxsIdGroup &grp, RsPgpId &pgpId,bool& error)
 	}
 
 #ifdef DEBUG_IDS
-	std::cerr << "p3IdService::checkId() Checked " << mPgpFingerprintMap.size() << " Hashes without Match";
+	std::cerr << "p3IdService::checkId() Checked " << candidates.size() << " Hashes without Match";
 	std::cerr << std::endl;
 #endif // DEBUG_IDS
 
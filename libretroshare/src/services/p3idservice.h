@@ -36,6 +36,7 @@
 #include "util/rsmemcache.h"
 #include "util/rstickevent.h"
 #include "util/rsrecogn.h"
+#include "util/rsworkerpool.h"
 
 #include "pqi/authgpg.h"
 
@@ -499,6 +500,20 @@ private:
 	bool pgphash_process();
 
 	bool checkId(const RsGxsIdGroup &grp, RsPgpId &pgp_id, bool &error);
+
+	/// Runs the checkId() calls of a pgphash_process() batch in parallel
+	RsWorkerPool mPgpHashPool;
+
+protected:
+	/**
+	 * Pops up to PGPHASH_PROC_BATCH_SIZE groups from mGroupsToProcess into
+	 * groups and runs checkId() on each of them in mPgpHashPool.
+	 * @return false if there was nothing left to check
+	 */
+	bool pgphash_checkBatch( std::vector<RsGxsIdGroup>& groups,
+	                         std::vector<RsPgpId>& pgpIds,
+	                         std::vector<uint8_t>& matches,
+	                         std::vector<uint8_t>& errors );
 	void getPgpIdList();
 
 	/* MUTEX PROTECTED DATA (mIdMtx - maybe should use a 2nd?) */
@@ -506,6 +521,8 @@ private:
 	std::map<RsPgpId, PGPFingerprintType> mPgpFingerprintMap;
 	std::list<RsGxsIdGroup> mGroupsToProcess;
 
+private:
+
 	/************************************************************************
  * recogn processing.
  *
@@ -52,7 +52,9 @@
 
 #include <unistd.h>
 #include <iomanip>
+#include <algorithm>
 #include <map>
+#include <memory>
 #include <sstream>
 
 //#define MSG_DEBUG 1
@@ -68,6 +70,7 @@ static struct RsLog::logInfo msgservicezoneInfo = {RsLog::Default, "msgservice"}
 #define msgservicezone &msgservicezoneInfo
 
 static const uint32_t RS_MSG_DISTANT_MESSAGE_HASH_KEEP_TIME = 2*30*86400 ; // keep msg hashes for 2 months to avoid re-sent msgs
+static const rstime_t MIGRATION_RETRY_PERIOD = 60 ; // retry moving config messages to the mailbox every minute
 
 /* Another little hack ..... unique message Ids
  * will be handled in this class.....
@@ -81,11 +84,15 @@ static const uint32_t RS_MSG_DISTANT_MESSAGE_HASH_KEEP_TIME = 2*30*86400 ; // ke
  */
 
 p3MsgService::p3MsgService( p3ServiceControl *sc, p3IdService *id_serv,
-                            p3GxsTrans& gxsMS )
+                            p3GxsTrans& gxsMS,
+                            const std::string& mailboxDbPath,
+                            const std::string& mailboxDbKey )
     : p3Service(), p3Config(),
       gxsOngoingMutex("p3MsgService Gxs Outgoing Mutex"), mIdService(id_serv),
-      mServiceCtrl(sc), mMsgMtx("p3MsgService"), mMsgUniqueId(0),
+      mServiceCtrl(sc), mMsgMtx("p3MsgService"),
+      mMailbox(mailboxDbPath, mailboxDbKey), mMsgUniqueId(0),
       recentlyReceivedMutex("p3MsgService recently received hash mutex"),
+      mLastMigrationTs(0),
       mGxsTransServ(gxsMS)
 {
 	_serialiser = new RsMsgSerialiser(RsServiceSerializer::SERIALIZATION_FLAG_NONE);	// this serialiser is used for services. It's not the same than the one returned by setupSerialiser(). We need both!!
@@ -93,7 +100,16 @@ p3MsgService::p3MsgService( p3ServiceControl *sc, p3IdService *id_serv,
 
 	/* MsgIds are not transmitted, but only used locally as a storage index.
 	 * As such, thay do not need to be different at friends nodes. */
-	mMsgUniqueId = 1;
+	mMsgUniqueId = mMailbox.getMaxMsgId() + 1;
+
+	if(!mMailbox.isOpen())
+		std::cerr << __PRETTY_FUNCTION__ << " Error! Cannot open mailbox "
+		          << "database: " << mailboxDbPath << std::endl;
+
+	/* messages that haven't made it out yet are kept in memory */
+	std::list<RsMsgItem*> pending;
+	mMailbox.loadMessages(RS_MSG_FLAGS_PENDING, RS_MSG_FLAGS_PENDING, pending);
+	for(RsMsgItem* mitem : pending) msgOutgoing[mitem->msgId] = mitem;
 
 	mShouldEnableDistantMessaging = true;
 	mDistantMessagingEnabled = false;
@@ -151,6 +167,18 @@ int	p3MsgService::tick()
 		last_management_time = now;
 	}
 
+	bool unmigrated;
+	{
+		RS_STACK_MUTEX(mMsgMtx);
+		unmigrated = !mUnmigratedItems.empty() &&
+		        now > mLastMigrationTs + MIGRATION_RETRY_PERIOD;
+	}
+	if(unmigrated && migrateLegacyItems())
+	{
+		IndicateConfigChanged(); /* save config without the migrated items */
+		RsServer::notify()->notifyListChange(NOTIFY_LIST_MESSAGELIST,NOTIFY_TYPE_ADD);
+	}
+
 	return 0;
 }
 
@@ -204,13 +232,7 @@ void p3MsgService::processIncomingMsg(RsMsgItem *mi)
 			notify->AddFeedItem(RS_FEED_ITEM_MESSAGE, out, "", "");
 		}
 
-		imsg[mi->msgId] = mi;
-		RsMsgSrcId* msi = new RsMsgSrcId();
-		msi->msgId = mi->msgId;
-		msi->srcId = mi->PeerId();
-		mSrcIds.insert(std::pair<uint32_t, RsMsgSrcId*>(msi->msgId, msi));
-
-		IndicateConfigChanged(); /**** INDICATE MSG CONFIG CHANGED! *****/
+		mMailbox.storeMessage(*mi, mi->PeerId());
 
 		/**** STACK UNLOCKED ***/
 	}
@@ -225,6 +247,8 @@ void p3MsgService::processIncomingMsg(RsMsgItem *mi)
 				rsFiles->FileRequest((*it).name,(*it).hash,(*it).filesize,std::string(),RS_FILE_REQ_ANONYMOUS_ROUTING,srcIds) ;
 		}
 
+	delete mi;
+
 	RsServer::notify()->notifyListChange(NOTIFY_LIST_MESSAGELIST,NOTIFY_TYPE_ADD);
 }
 
@@ -410,6 +434,7 @@ int p3MsgService::checkOutgoingMessages()
 					          << std::endl;
 #endif
 					mit->second->msgFlags |= RS_MSG_FLAGS_ROUTED;
+					mMailbox.setFlags(mit->first, mit->second->msgFlags);
 				}
 			}
 			else
@@ -425,15 +450,9 @@ int p3MsgService::checkOutgoingMessages()
 			mit = msgOutgoing.find(*it);
 			if ( mit != msgOutgoing.end() ) msgOutgoing.erase(mit);
 
-			std::map<uint32_t, RsMsgSrcId*>::iterator srcIt = mSrcIds.find(*it);
-			if (srcIt != mSrcIds.end())
-			{
-				delete (srcIt->second);
-				mSrcIds.erase(srcIt);
-			}
+			/* the sent copy has been stored separately by MessageSend */
+			mMailbox.removeMessage(*it);
 		}
-
-		if (toErase.size() > 0) IndicateConfigChanged();
 	}
 
 	for( std::list<RsMsgItem*>::const_iterator it(output_queue.begin());
@@ -458,35 +477,30 @@ bool p3MsgService::saveList(bool& cleanup, std::list<RsItem*>& itemList)
 	}
 	itemList.push_front(gxsmailmap);
 
-	std::map<uint32_t, RsMsgItem *>::iterator mit;
 	std::map<uint32_t, RsMsgTagType* >::iterator mit2;
-	std::map<uint32_t, RsMsgTags* >::iterator mit3;
-	std::map<uint32_t, RsMsgSrcId* >::iterator lit;
-	std::map<uint32_t, RsMsgParentId* >::iterator mit4;
 
 	cleanup = true;
 
 	mMsgMtx.lock();
 
-	for(mit = imsg.begin(); mit != imsg.end(); ++mit)
-        itemList.push_back(new RsMsgItem(*mit->second));
-
-	for(lit = mSrcIds.begin(); lit != mSrcIds.end(); ++lit)
-        itemList.push_back(new RsMsgSrcId(*lit->second));
-
-
-	for(mit = msgOutgoing.begin(); mit != msgOutgoing.end(); ++mit)
-        itemList.push_back(new RsMsgItem(*mit->second)) ;
+	/* Messages are stored in the mailbox database, only items which could
+	 * not be migrated there are saved back, so they are not lost */
+	for(RsItem* item : mUnmigratedItems)
+	{
+		RsMsgItem* mi; RsMsgSrcId* msi; RsMsgTags* mti; RsMsgParentId* msp;
+		if((mi = dynamic_cast<RsMsgItem*>(item)))
+			itemList.push_back(new RsMsgItem(*mi));
+		else if((msi = dynamic_cast<RsMsgSrcId*>(item)))
+			itemList.push_back(new RsMsgSrcId(*msi));
+		else if((mti = dynamic_cast<RsMsgTags*>(item)))
+			itemList.push_back(new RsMsgTags(*mti));
+		else if((msp = dynamic_cast<RsMsgParentId*>(item)))
+			itemList.push_back(new RsMsgParentId(*msp));
+	}
 
 	for(mit2 = mTags.begin();  mit2 != mTags.end(); ++mit2)
         itemList.push_back(new RsMsgTagType(*mit2->second));
 
-	for(mit3 = mMsgTags.begin();  mit3 != mMsgTags.end(); ++mit3)
-        itemList.push_back(new RsMsgTags(*mit3->second));
-
-	for(mit4 = mParentId.begin();  mit4 != mParentId.end(); ++mit4)
-        itemList.push_back(new RsMsgParentId(*mit4->second));
-
     RsMsgGRouterMap *grmap = new RsMsgGRouterMap ;
     grmap->ongoing_msgs = _ongoing_messages ;
 
@@ -593,6 +607,7 @@ bool p3MsgService::loadList(std::list<RsItem*>& load)
     RsMsgDistantMessagesHashMap *ghm;
 
     std::list<RsMsgItem*> items;
+    std::list<RsItem*> legacyItems;
 	std::list<RsItem*>::iterator it;
     std::map<uint32_t, RsMsgTagType*>::iterator tagIt;
     std::map<uint32_t, RsPeerId> srcIdMsgMap;
@@ -652,16 +667,16 @@ bool p3MsgService::loadList(std::list<RsItem*>& load)
 	    }
 		else if(NULL != (mti = dynamic_cast<RsMsgTags *>(*it)))
 	    {
-		    mMsgTags.insert(std::pair<uint32_t, RsMsgTags* >(mti->msgId, mti));
+		    legacyItems.push_back(mti);
 	    }
 		else if(NULL != (msi = dynamic_cast<RsMsgSrcId *>(*it)))
 	    {
 		    srcIdMsgMap.insert(std::pair<uint32_t, RsPeerId>(msi->msgId, msi->srcId));
-		    mSrcIds.insert(std::pair<uint32_t, RsMsgSrcId*>(msi->msgId, msi)); // does not need to be kept
+		    legacyItems.push_back(msi);
 	    }
 		else if(NULL != (msp = dynamic_cast<RsMsgParentId *>(*it)))
 	    {
-		    mParentId.insert(std::pair<uint32_t, RsMsgParentId*>(msp->msgId, msp));
+		    legacyItems.push_back(msp);
 	    }
 
 	    RsConfigKeyValueSet *vitem = NULL ;
@@ -701,10 +716,15 @@ bool p3MsgService::loadList(std::list<RsItem*>& load)
 		    continue ;
 	    }
     }
-    mMsgUniqueId = max_msg_id + 1;	// make it unique with respect to what was loaded. Not totally safe, but works 99.9999% of the cases.
+    {
+	    RS_STACK_MUTEX(mMsgMtx);
+	    // make it unique with respect to what was loaded. Not totally safe, but works 99.9999% of the cases.
+	    mMsgUniqueId = std::max(mMsgUniqueId, max_msg_id + 1);
+    }
     load.clear() ;
 
-    // sort items into lists
+    if(items.empty() && legacyItems.empty()) return true;
+
     std::list<RsMsgItem*>::iterator msgIt;
     for (msgIt = items.begin(); msgIt != items.end(); ++msgIt)
     {
@@ -715,58 +735,79 @@ bool p3MsgService::loadList(std::list<RsItem*>& load)
 		    mitem->msgId = getNewUniqueMsgId();
 	    }
 
-		RS_STACK_MUTEX(mMsgMtx);
-
 	    srcIt = srcIdMsgMap.find(mitem->msgId);
 	    if(srcIt != srcIdMsgMap.end()) {
 		    mitem->PeerId(srcIt->second);
-		    srcIdMsgMap.erase(srcIt);
 	    }
+    }
 
-	    /* switch depending on the PENDING
-		 * flags
-		 */
-	    if (mitem -> msgFlags & RS_MSG_FLAGS_PENDING)
-	    {
+    {
+	    RS_STACK_MUTEX(mMsgMtx);
+	    mUnmigratedItems.insert(mUnmigratedItems.end(), items.begin(), items.end());
+	    mUnmigratedItems.insert(mUnmigratedItems.end(), legacyItems.begin(), legacyItems.end());
+    }
 
-		    //std::cerr << "MSG_PENDING";
-		    //std::cerr << std::endl;
-		    //mitem->print(std::cerr);
+    if(migrateLegacyItems())
+	    IndicateConfigChanged(); /* save config without the migrated items */
 
-		    msgOutgoing[mitem->msgId] = mitem;
-	    }
-	    else
-	    {
-		    imsg[mitem->msgId] = mitem;
-	    }
-    }
+    return true;
+}
 
-    RsStackMutex stack(mMsgMtx); /********** STACK LOCKED MTX ******/
+bool p3MsgService::migrateLegacyItems()
+{
+	uint32_t count = 0;
+	{
+		RS_STACK_MUTEX(mMsgMtx);
+		mLastMigrationTs = time(NULL);
+		if(mUnmigratedItems.empty()) return true;
 
-    /* remove missing msgId in mSrcIds */
-    for (srcIt = srcIdMsgMap.begin(); srcIt != srcIdMsgMap.end(); ++srcIt) {
-	    std::map<uint32_t, RsMsgSrcId*>::iterator it = mSrcIds.find(srcIt->first);
-	    if (it != mSrcIds.end()) {
-		    delete(it->second);
-		    mSrcIds.erase(it);
-	    }
-    }
+		std::list<RsMsgItem*> items;
+		std::map<uint32_t, RsPeerId> srcIdMsgMap;
+		std::map<uint32_t, uint32_t> parentIdMsgMap;
+		std::map<uint32_t, std::list<uint32_t> > tagsMsgMap;
 
-    /* remove missing msgId in mParentId */
-    std::map<uint32_t, RsMsgParentId *>::iterator mit = mParentId.begin();
-    while (mit != mParentId.end()) {
-	    if (imsg.find(mit->first) == imsg.end()) {
-		    if (msgOutgoing.find(mit->first) == msgOutgoing.end()) {
-			    /* not found */
-			    mParentId.erase(mit++);
-			    continue;
-		    }
-	    }
+		for(RsItem* item : mUnmigratedItems)
+		{
+			RsMsgItem* mi; RsMsgSrcId* msi; RsMsgTags* mti; RsMsgParentId* msp;
+			if((mi = dynamic_cast<RsMsgItem*>(item)))
+				items.push_back(mi);
+			else if((msi = dynamic_cast<RsMsgSrcId*>(item)))
+				srcIdMsgMap[msi->msgId] = msi->srcId;
+			else if((mti = dynamic_cast<RsMsgTags*>(item)))
+				tagsMsgMap[mti->msgId] = mti->tagIds;
+			else if((msp = dynamic_cast<RsMsgParentId*>(item)))
+				parentIdMsgMap[msp->msgId] = msp->msgParentId;
+		}
 
-	    ++mit;
-    }
+		if(!mMailbox.importMessages(items, srcIdMsgMap, parentIdMsgMap, tagsMsgMap))
+		{
+			RsErr() << __PRETTY_FUNCTION__ << " Failed migrating " << items.size()
+			        << " messages to the mailbox database, keeping them in "
+			        << "config and retrying later" << std::endl;
+			return false;
+		}
 
-    return true;
+		/* ones that haven't made it out yet are kept in memory */
+		for(RsItem* item : mUnmigratedItems)
+		{
+			RsMsgItem* mi = dynamic_cast<RsMsgItem*>(item);
+			if(mi && (mi->msgFlags & RS_MSG_FLAGS_PENDING))
+			{
+				std::map<uint32_t, RsMsgItem *>::iterator mit = msgOutgoing.find(mi->msgId);
+				if(mit != msgOutgoing.end()) delete mit->second;
+
+				msgOutgoing[mi->msgId] = mi;
+			}
+			else delete item;
+		}
+
+		count = items.size();
+		mUnmigratedItems.clear();
+	}
+
+	std::cerr << "p3MsgService::migrateLegacyItems() migrated " << count
+	          << " messages to the mailbox database" << std::endl;
+	return true;
 }
 
 void p3MsgService::loadWelcomeMsg()
@@ -789,11 +830,8 @@ void p3MsgService::loadWelcomeMsg()
 
 	msg -> msgId = getNewUniqueMsgId();
 
-	RsStackMutex stack(mMsgMtx); /********** STACK LOCKED MTX ******/
-
-	imsg[msg->msgId] = msg;
-
-	IndicateConfigChanged();
+	mMailbox.storeMessage(*msg);
+	delete msg;
 }
 
 
@@ -808,96 +846,50 @@ void p3MsgService::loadWelcomeMsg()
 
 bool p3MsgService::getMessageSummaries(std::list<MsgInfoSummary> &msgList)
 {
-	/* do stuff */
-	msgList.clear();
+	uint32_t total;
+	return getMessageSummariesPage( RS_MSG_ALLBOXES, 0, 0, 0, msgList,
+	                                total );
+}
 
-	RsStackMutex stack(mMsgMtx); /********** STACK LOCKED MTX ******/
+bool p3MsgService::getMessageSummariesPage(
+        uint32_t box, uint32_t tagId, uint32_t offset, uint32_t count,
+        std::list<MsgInfoSummary>& msgList, uint32_t& total )
+{
+	msgList.clear();
 
-	std::map<uint32_t, RsMsgItem *>::iterator mit;
-	for(mit = imsg.begin(); mit != imsg.end(); ++mit)
-	{
-		MsgInfoSummary mis;
-		initRsMIS(mit->second, mis);
-		msgList.push_back(mis);
-	}
+	std::list<MsgMailboxHeader> headers;
+	if(!mMailbox.getHeaders(box, tagId, offset, count, headers, total))
+		return false;
 
-	for(mit = msgOutgoing.begin(); mit != msgOutgoing.end(); ++mit)
+	for(const MsgMailboxHeader& header : headers)
 	{
-		MsgInfoSummary mis;
-		initRsMIS(mit->second, mis);
-		msgList.push_back(mis);
+		msgList.push_back(MsgInfoSummary());
+		initRsMIS(header, msgList.back());
 	}
 	return true;
 }
 
 bool p3MsgService::getMessage(const std::string &mId, MessageInfo &msg)
 {
-  	std::map<uint32_t, RsMsgItem *>::iterator mit;
 	uint32_t msgId = atoi(mId.c_str());
 
-	RsStackMutex stack(mMsgMtx); /********** STACK LOCKED MTX ******/
-
-	mit = imsg.find(msgId);
-	if (mit == imsg.end())
-	{
-		mit = msgOutgoing.find(msgId);
-		if (mit == msgOutgoing.end())
-		{
-			return false;
-		}
-	}
+	/* bodies are only loaded from the mailbox when requested */
+	RsPeerId srcId;
+	std::unique_ptr<RsMsgItem> mi(mMailbox.loadMessage(msgId, srcId));
+	if(!mi) return false;
 
-	/* mit valid */
-	initRsMI(mit->second, msg);
+	initRsMI(mi.get(), msg);
 
-	std::map<uint32_t, RsMsgSrcId*>::const_iterator it = mSrcIds.find(msgId) ;
-	if(it != mSrcIds.end())
-		msg.rsgxsid_srcId = RsGxsId(it->second->srcId) ;	// (cyril) this is a hack. Not good. I'm not removing it because it may have consequences, but I dont like this.
+	if(!srcId.isNull())
+		msg.rsgxsid_srcId = RsGxsId(srcId) ;	// (cyril) this is a hack. Not good. I'm not removing it because it may have consequences, but I dont like this.
 
 	return true;
 }
 
 void p3MsgService::getMessageCount(uint32_t &nInbox, uint32_t &nInboxNew, uint32_t &nOutbox, uint32_t &nDraftbox, uint32_t &nSentbox, uint32_t &nTrashbox)
 {
-    RsStackMutex stack(mMsgMtx); /********** STACK LOCKED MTX ******/
-
-	nInbox = 0;
-	nInboxNew = 0;
-	nOutbox = 0;
-	nDraftbox = 0;
-	nSentbox = 0;
-	nTrashbox = 0;
-
-    std::map<uint32_t, RsMsgItem *>::iterator mit;
-    std::map<uint32_t, RsMsgItem *> *apMsg [2] = { &imsg, &msgOutgoing };
-
-    for (int i = 0; i < 2; i++) {
-        for (mit = apMsg [i]->begin(); mit != apMsg [i]->end(); ++mit) {
-            MsgInfoSummary mis;
-            initRsMIS(mit->second, mis);
-
-            if (mis.msgflags & RS_MSG_TRASH) {
-				++nTrashbox;
-                continue;
-            }
-            switch (mis.msgflags & RS_MSG_BOXMASK) {
-            case RS_MSG_INBOX:
-				    ++nInbox;
-				    if ((mis.msgflags & RS_MSG_NEW) == RS_MSG_NEW)
-						++nInboxNew;
-                    break;
-            case RS_MSG_OUTBOX:
-				    ++nOutbox;
-                    break;
-            case RS_MSG_DRAFTBOX:
-				   ++nDraftbox;
-                    break;
-            case RS_MSG_SENTBOX:
-				    ++nSentbox;
-                    break;
-            }
-        }
-    }
+	mMailbox.getBoxCounts( nInbox, nInboxNew, nOutbox, nDraftbox, nSentbox,
+	                       nTrashbox );
 }
 
 /* remove based on the unique mid (stored in sid) */
@@ -915,38 +907,19 @@ bool    p3MsgService::removeMsgId(const std::string &mid)
 	{
 		RsStackMutex stack(mMsgMtx); /********** STACK LOCKED MTX ******/
 
-		mit = imsg.find(msgId);
-		if (mit != imsg.end())
-		{
-			changed = true;
-			RsMsgItem *mi = mit->second;
-			imsg.erase(mit);
-			delete mi;
-		}
-
 		mit = msgOutgoing.find(msgId);
 		if (mit != msgOutgoing.end())
 		{
-			changed = true ;
 			RsMsgItem *mi = mit->second;
 			msgOutgoing.erase(mit);
 			delete mi;
 		}
 
-		std::map<uint32_t, RsMsgSrcId*>::iterator srcIt = mSrcIds.find(msgId);
-		if (srcIt != mSrcIds.end()) {
-			changed = true;
-			delete (srcIt->second);
-			mSrcIds.erase(srcIt);
-		}
+		/* tags and parent id are removed along with the message */
+		changed = mMailbox.removeMessage(msgId);
 	}
 
 	if(changed) {
-		IndicateConfigChanged(); /**** INDICATE MSG CONFIG CHANGED! *****/
-
-		setMessageTag(mid, 0, false);
-		setMsgParentId(msgId, 0);
-
 		RsServer::notify()->notifyListChange(NOTIFY_LIST_MESSAGELIST,NOTIFY_TYPE_MOD);
 	}
 
@@ -955,38 +928,18 @@ bool    p3MsgService::removeMsgId(const std::string &mid)
 
 bool    p3MsgService::markMsgIdRead(const std::string &mid, bool unreadByUser)
 {
-	std::map<uint32_t, RsMsgItem *>::iterator mit;
 	uint32_t msgId = atoi(mid.c_str());
 	bool changed = false;
 
 	{
 		RsStackMutex stack(mMsgMtx); /********** STACK LOCKED MTX ******/
 
-		mit = imsg.find(msgId);
-		if (mit != imsg.end())
-		{
-			RsMsgItem *mi = mit->second;
-
-			uint32_t msgFlags = mi->msgFlags;
-
-			/* remove new state */
-			mi->msgFlags &= ~(RS_MSG_FLAGS_NEW);
-
-			/* set state from user */
-			if (unreadByUser) {
-				mi->msgFlags |= RS_MSG_FLAGS_UNREAD_BY_USER;
-			} else {
-				mi->msgFlags &= ~RS_MSG_FLAGS_UNREAD_BY_USER;
-			}
-
-			if (mi->msgFlags != msgFlags)
-			{
-				changed = true;
-				IndicateConfigChanged(); /**** INDICATE MSG CONFIG CHANGED! *****/
-			}
-		} else {
+		/* remove new state, and set state from user */
+		if(!locked_updateMsgFlags( msgId,
+		                           unreadByUser ? RS_MSG_FLAGS_UNREAD_BY_USER : 0,
+		                           RS_MSG_FLAGS_NEW | RS_MSG_FLAGS_UNREAD_BY_USER,
+		                           changed ))
 			return false;
-		}
 	} /* UNLOCKED */
 
 	if (changed) {
@@ -998,7 +951,6 @@ bool    p3MsgService::markMsgIdRead(const std::string &mid, bool unreadByUser)
 
 bool    p3MsgService::setMsgFlag(const std::string &mid, uint32_t flag, uint32_t mask)
 {
-  	std::map<uint32_t, RsMsgItem *>::iterator mit;
 	uint32_t msgId = atoi(mid.c_str());
 
 	bool changed = false;
@@ -1006,25 +958,8 @@ bool    p3MsgService::setMsgFlag(const std::string &mid, uint32_t flag, uint32_t
 	{
 		RsStackMutex stack(mMsgMtx); /********** STACK LOCKED MTX ******/
 
-		mit = imsg.find(msgId);
-		if (mit == imsg.end())
-		{
-			mit = msgOutgoing.find(msgId);
-			if (mit == msgOutgoing.end())
-			{
-				return false;
-			}
-		}
-
-		uint32_t oldFlag = mit->second->msgFlags;
-
-		mit->second->msgFlags &= ~mask;
-		mit->second->msgFlags |= flag;
-
-		if (mit->second->msgFlags != oldFlag) {
-			changed = true;
-			IndicateConfigChanged(); /**** INDICATE MSG CONFIG CHANGED! *****/
-		}
+		if(!locked_updateMsgFlags(msgId, flag, mask, changed))
+			return false;
 	} /* UNLOCKED */
 
 	if (changed) {
@@ -1034,62 +969,42 @@ bool    p3MsgService::setMsgFlag(const std::string &mid, uint32_t flag, uint32_t
 	return true;
 }
 
+bool p3MsgService::locked_updateMsgFlags(
+        uint32_t msgId, uint32_t flag, uint32_t mask, bool& changed )
+{
+	changed = false;
+
+	uint32_t oldFlags;
+	if(!mMailbox.getFlags(msgId, oldFlags)) return false;
+
+	uint32_t newFlags = (oldFlags & ~mask) | flag;
+	if(newFlags == oldFlags) return true;
+
+	/* keep the copy waiting to be sent in sync */
+	std::map<uint32_t, RsMsgItem *>::iterator mit = msgOutgoing.find(msgId);
+	if (mit != msgOutgoing.end()) mit->second->msgFlags = newFlags;
+
+	changed = true;
+	return mMailbox.setFlags(msgId, newFlags);
+}
+
 bool    p3MsgService::getMsgParentId(const std::string &msgId, std::string &msgParentId)
 {
 	msgParentId.clear();
 
-	RsStackMutex stack(mMsgMtx); /********** STACK LOCKED MTX ******/
-
-	std::map<uint32_t, RsMsgParentId *>::iterator mit = mParentId.find(atoi(msgId.c_str()));
-	if (mit == mParentId.end()) {
+	uint32_t parentId;
+	if (!mMailbox.getParentId(atoi(msgId.c_str()), parentId)) {
 		return false;
 	}
 
-	rs_sprintf(msgParentId, "%lu", mit->second->msgParentId);
+	rs_sprintf(msgParentId, "%lu", parentId);
 	
 	return true;
 }
 
 bool    p3MsgService::setMsgParentId(uint32_t msgId, uint32_t msgParentId)
 {
-	std::map<uint32_t, RsMsgParentId *>::iterator mit;
-
-	bool changed = false;
-
-	{
-		RsStackMutex stack(mMsgMtx); /********** STACK LOCKED MTX ******/
-
-		mit = mParentId.find(msgId);
-		if (mit == mParentId.end())
-		{
-			if (msgParentId) {
-				RsMsgParentId* msp = new RsMsgParentId();
-				msp->PeerId (mServiceCtrl->getOwnId());
-				msp->msgId = msgId;
-				msp->msgParentId = msgParentId;
-				mParentId.insert(std::pair<uint32_t, RsMsgParentId*>(msgId, msp));
-
-				changed = true;
-			}
-		} else {
-			if (msgParentId) {
-				if (mit->second->msgParentId != msgParentId) {
-					mit->second->msgParentId = msgParentId;
-					changed = true;
-				}
-			} else {
-				delete mit->second;
-				mParentId.erase(mit);
-				changed = true;
-			}
-		}
-	} /* UNLOCKED */
-
-	if (changed) {
-		IndicateConfigChanged(); /**** INDICATE MSG CONFIG CHANGED! *****/
-	}
-
-	return true;
+	return mMailbox.setParentId(msgId, msgParentId);
 }
 
 /****************************************/
@@ -1111,19 +1026,13 @@ uint32_t     p3MsgService::sendMessage(RsMsgItem *item)	// no from field because
 	    /* STORE MsgID */
 	    msgOutgoing[item->msgId] = item;
 
-	    if (item->PeerId() != mServiceCtrl->getOwnId()) 
-	    {
-		    /* not to the loopback device */
-            
-		    RsMsgSrcId* msi = new RsMsgSrcId();
-		    msi->msgId = item->msgId;
-		    msi->srcId = mServiceCtrl->getOwnId();	
-		    mSrcIds.insert(std::pair<uint32_t, RsMsgSrcId*>(msi->msgId, msi));
-	    }
+	    /* not to the loopback device */
+	    if (item->PeerId() != mServiceCtrl->getOwnId())
+		    mMailbox.storeMessage(*item, mServiceCtrl->getOwnId());
+	    else
+		    mMailbox.storeMessage(*item);
     }
 
-    IndicateConfigChanged(); /**** INDICATE MSG CONFIG CHANGED! *****/
-
     RsServer::notify()->notifyListChange(NOTIFY_LIST_MESSAGELIST, NOTIFY_TYPE_ADD);
 
     return item->msgId;
@@ -1144,19 +1053,13 @@ uint32_t p3MsgService::sendDistantMessage(RsMsgItem *item, const RsGxsId& from)
 		msgOutgoing[item->msgId] = item;
 		mDistantOutgoingMsgSigners[item->msgId] = from ;
 
-		if (item->PeerId() != mServiceCtrl->getOwnId()) 
-		{
-			/* not to the loopback device */
-
-			RsMsgSrcId* msi = new RsMsgSrcId();
-			msi->msgId = item->msgId;
-			msi->srcId = RsPeerId(from);
-			mSrcIds.insert(std::pair<uint32_t, RsMsgSrcId*>(msi->msgId, msi));
-		}
+		/* not to the loopback device */
+		if (item->PeerId() != mServiceCtrl->getOwnId())
+			mMailbox.storeMessage(*item, RsPeerId(from));
+		else
+			mMailbox.storeMessage(*item);
 	}
 
-	IndicateConfigChanged(); /**** INDICATE MSG CONFIG CHANGED! *****/
-
 	RsServer::notify()->notifyListChange( NOTIFY_LIST_MESSAGELIST,
 	                                      NOTIFY_TYPE_ADD );
 	return item->msgId;
@@ -1189,7 +1092,8 @@ bool 	p3MsgService::MessageSend(MessageInfo &info)
                 
 		msg->msgFlags |= RS_MSG_OUTGOING;
 
-		imsg[msg->msgId] = msg;
+		mMailbox.storeMessage(*msg);
+		delete msg;
 
 		RsServer::notify()->notifyListChange(NOTIFY_LIST_MESSAGELIST,NOTIFY_TYPE_ADD);
 		//
@@ -1261,26 +1165,19 @@ bool p3MsgService::MessageToDraft(MessageInfo &info, const std::string &msgParen
             /* add pending flag */
             msg->msgFlags |= (RS_MSG_OUTGOING | RS_MSG_FLAGS_DRAFT);
 
-            if (msgId) {
-                // remove existing message
-                std::map<uint32_t, RsMsgItem *>::iterator mit;
-                mit = imsg.find(msgId);
-                if (mit != imsg.end()) {
-                    RsMsgItem *mi = mit->second;
-                    imsg.erase(mit);
-                    delete mi;
-                }
-            }
-            /* STORE MsgID */
-            imsg[msg->msgId] = msg;
+            /* STORE MsgID, replacing the existing message if any */
+            mMailbox.storeMessage(*msg);
 
             // return new message id
             rs_sprintf(info.msgId, "%lu", msg->msgId);
         }
 
-        setMsgParentId(msg->msgId, atoi(msgParentId.c_str()));
-
-        IndicateConfigChanged(); /**** INDICATE MSG CONFIG CHANGED! *****/
+        uint32_t parentId = strtoul(msgParentId.c_str(), NULL, 10);
+        if(!setMsgParentId(msg->msgId, parentId))
+            std::cerr << "p3MsgService::MessageToDraft() Error! Failed "
+                      << "setting parent " << parentId << " of draft "
+                      << msg->msgId << std::endl;
+        delete msg;
 
 		  RsServer::notify()->notifyListChange(NOTIFY_LIST_MESSAGELIST,NOTIFY_TYPE_MOD);
 
@@ -1385,26 +1282,8 @@ bool    p3MsgService::removeMessageTagType(uint32_t tagId)
 			return false;
 		}
 
-		/* search for messages with this tag type */
-		std::map<uint32_t, RsMsgTags*>::iterator mit1;
-                for (mit1 = mMsgTags.begin(); mit1 != mMsgTags.end(); ) {
-			RsMsgTags* tag = mit1->second;
-
-			std::list<uint32_t>::iterator lit;
-			lit = std::find(tag->tagIds.begin(), tag->tagIds.end(), tagId);
-			if (lit != tag->tagIds.end()) {
-				tag->tagIds.erase(lit);
-
-				if (tag->tagIds.empty()) {
-					/* remove empty tag */
-					delete(tag);
-
-					mMsgTags.erase(mit1++);
-					continue;
-				}
-			}
-			++mit1;
-		}
+		/* remove the tag type from the messages */
+		mMailbox.removeTagType(tagId);
 
 		/* remove tag type */
 		delete(mit->second);
@@ -1427,11 +1306,9 @@ bool 	p3MsgService::locked_getMessageTag(const std::string &msgId, MsgTagInfo& i
 		return false;
 	}
 
-	std::map<uint32_t, RsMsgTags*>::iterator mit;
-
-	if(mMsgTags.end() != (mit = mMsgTags.find(mid))) {
-		rs_sprintf(info.msgId, "%lu", mit->second->msgId);
-		info.tagIds = mit->second->tagIds;
+	info.tagIds.clear();
+	if(mMailbox.getTags(mid, info.tagIds) && !info.tagIds.empty()) {
+		rs_sprintf(info.msgId, "%lu", mid);
 
 		return true;
 	}
@@ -1460,66 +1337,29 @@ bool 	p3MsgService::setMessageTag(const std::string &msgId, uint32_t tagId, bool
 	{
 		RsStackMutex stack(mMsgMtx); /********** STACK LOCKED MTX ******/
 
-		std::map<uint32_t, RsMsgTags*>::iterator mit;
-		mit = mMsgTags.find(mid);
-
-		if (mit == mMsgTags.end()) {
-			if (set) {
-				/* new msg */
-				RsMsgTags* tag = new RsMsgTags();
-				tag->PeerId (mServiceCtrl->getOwnId());
-
-				tag->msgId = mid;
-				tag->tagIds.push_back(tagId);
+		std::list<uint32_t> tagIds;
+		mMailbox.getTags(mid, tagIds);
 
-				mMsgTags.insert(std::pair<uint32_t, RsMsgTags*>(tag->msgId, tag));
+		/* search existing tagId */
+		bool found = tagId &&
+		        std::find(tagIds.begin(), tagIds.end(), tagId) != tagIds.end();
 
+		if (set) {
+			if (!found && mMailbox.addTag(mid, tagId)) {
 				nNotifyType = NOTIFY_TYPE_ADD;
 			}
-		} else {
-			RsMsgTags* tag = mit->second;
-
-			/* search existing tagId */
-			std::list<uint32_t>::iterator lit;
-			if (tagId) {
-				lit = std::find(tag->tagIds.begin(), tag->tagIds.end(), tagId);
-			} else {
-				lit = tag->tagIds.end();
-			}
-
-			if (set) {
-				if (lit == tag->tagIds.end()) {
-					tag->tagIds.push_back(tagId);
-					/* keep the list sorted */
-					tag->tagIds.sort();
-					nNotifyType = NOTIFY_TYPE_ADD;
-				}
-			} else {
-				if (tagId == 0) {
-					/* remove all */
-					delete(tag);
-					mMsgTags.erase(mit);
-					nNotifyType = NOTIFY_TYPE_DEL;
-				} else {
-					if (lit != tag->tagIds.end()) {
-						tag->tagIds.erase(lit);
-						nNotifyType = NOTIFY_TYPE_DEL;
-
-						if (tag->tagIds.empty()) {
-							/* remove empty tag */
-							delete(tag);
-							mMsgTags.erase(mit);
-						}
-					}
-				}
+		} else if (tagId == 0) {
+			/* remove all */
+			if (!tagIds.empty() && mMailbox.removeTag(mid, 0)) {
+				nNotifyType = NOTIFY_TYPE_DEL;
 			}
+		} else if (found && mMailbox.removeTag(mid, tagId)) {
+			nNotifyType = NOTIFY_TYPE_DEL;
 		}
 
 	} /* UNLOCKED */
 
 	if (nNotifyType) {
-		IndicateConfigChanged(); /**** INDICATE MSG CONFIG CHANGED! *****/
-
 		RsServer::notify()->notifyListChange(NOTIFY_LIST_MESSAGE_TAGS, nNotifyType);
 
 		return true;
@@ -1544,7 +1384,6 @@ bool    p3MsgService::resetMessageStandardTagTypes(MsgTagType& tags)
 /* move message to trash based on the unique mid */
 bool p3MsgService::MessageToTrash(const std::string &mid, bool bTrash)
 {
-    std::map<uint32_t, RsMsgItem *>::iterator mit;
     uint32_t msgId = atoi(mid.c_str());
 
     bool bChanged = false;
@@ -1553,38 +1392,11 @@ bool p3MsgService::MessageToTrash(const std::string &mid, bool bTrash)
     {
         RsStackMutex stack(mMsgMtx); /********** STACK LOCKED MTX ******/
 
-        RsMsgItem *mi = NULL;
-
-        mit = imsg.find(msgId);
-        if (mit != imsg.end()) {
-            mi = mit->second;
-        } else {
-            mit = msgOutgoing.find(msgId);
-            if (mit != msgOutgoing.end()) {
-                mi = mit->second;
-            }
-        }
-
-        if (mi) {
-            bFound = true;
-
-            if (bTrash) {
-                if ((mi->msgFlags & RS_MSG_FLAGS_TRASH) == 0) {
-                    mi->msgFlags |= RS_MSG_FLAGS_TRASH;
-                    bChanged = true;
-                }
-            } else {
-                if (mi->msgFlags & RS_MSG_FLAGS_TRASH) {
-                    mi->msgFlags &= ~RS_MSG_FLAGS_TRASH;
-                    bChanged = true;
-                }
-            }
-        }
+        bFound = locked_updateMsgFlags( msgId, bTrash ? RS_MSG_FLAGS_TRASH : 0,
+                                        RS_MSG_FLAGS_TRASH, bChanged );
     }
 
     if (bChanged) {
-        IndicateConfigChanged(); /**** INDICATE MSG CONFIG CHANGED! *****/
-
         checkOutgoingMessages();
 
 		  RsServer::notify()->notifyListChange(NOTIFY_LIST_MESSAGELIST,NOTIFY_TYPE_MOD);
@@ -1666,88 +1478,85 @@ void p3MsgService::initRsMI(RsMsgItem *msg, MessageInfo &mi)
 	}
 }
 
-void p3MsgService::initRsMIS(RsMsgItem *msg, MsgInfoSummary &mis)
+void p3MsgService::initRsMIS(const MsgMailboxHeader& msg, MsgInfoSummary &mis)
 {
 	mis.msgflags = 0;
 
-	if(msg->msgFlags & RS_MSG_FLAGS_DISTANT)
+	if(msg.mMsgFlags & RS_MSG_FLAGS_DISTANT)
 		mis.msgflags |= RS_MSG_DISTANT ;
 
-	if (msg->msgFlags & RS_MSG_FLAGS_SIGNED)
+	if (msg.mMsgFlags & RS_MSG_FLAGS_SIGNED)
 		mis.msgflags |= RS_MSG_SIGNED ;
 
-	if (msg->msgFlags & RS_MSG_FLAGS_SIGNATURE_CHECKS)
+	if (msg.mMsgFlags & RS_MSG_FLAGS_SIGNATURE_CHECKS)
 		mis.msgflags |= RS_MSG_SIGNATURE_CHECKS ;
 
 	/* translate flags, if we sent it... outgoing */
-	if ((msg->msgFlags & RS_MSG_FLAGS_OUTGOING)
+	if ((msg.mMsgFlags & RS_MSG_FLAGS_OUTGOING)
 	   /*|| (msg->PeerId() == mServiceCtrl->getOwnId())*/)
 	{
 		mis.msgflags |= RS_MSG_OUTGOING;
 	}
 	/* if it has a pending flag, then its in the outbox */
-	if (msg->msgFlags & RS_MSG_FLAGS_PENDING)
+	if (msg.mMsgFlags & RS_MSG_FLAGS_PENDING)
 	{
 		mis.msgflags |= RS_MSG_PENDING;
 	}
-	if (msg->msgFlags & RS_MSG_FLAGS_DRAFT)
+	if (msg.mMsgFlags & RS_MSG_FLAGS_DRAFT)
 	{
 		mis.msgflags |= RS_MSG_DRAFT;
 	}
-	if (msg->msgFlags & RS_MSG_FLAGS_NEW)
+	if (msg.mMsgFlags & RS_MSG_FLAGS_NEW)
 	{
 		mis.msgflags |= RS_MSG_NEW;
 	}
-	if (msg->msgFlags & RS_MSG_FLAGS_TRASH)
+	if (msg.mMsgFlags & RS_MSG_FLAGS_TRASH)
 	{
 		mis.msgflags |= RS_MSG_TRASH;
 	}
-	if (msg->msgFlags & RS_MSG_FLAGS_UNREAD_BY_USER)
+	if (msg.mMsgFlags & RS_MSG_FLAGS_UNREAD_BY_USER)
 	{
 		mis.msgflags |= RS_MSG_UNREAD_BY_USER;
 	}
-	if (msg->msgFlags & RS_MSG_FLAGS_REPLIED)
+	if (msg.mMsgFlags & RS_MSG_FLAGS_REPLIED)
 	{
 		mis.msgflags |= RS_MSG_REPLIED;
 	}
-	if (msg->msgFlags & RS_MSG_FLAGS_FORWARDED)
+	if (msg.mMsgFlags & RS_MSG_FLAGS_FORWARDED)
 	{
 		mis.msgflags |= RS_MSG_FORWARDED;
 	}
-	if (msg->msgFlags & RS_MSG_FLAGS_STAR)
+	if (msg.mMsgFlags & RS_MSG_FLAGS_STAR)
 	{
 		mis.msgflags |= RS_MSG_STAR;
 	}
-	if (msg->msgFlags & RS_MSG_FLAGS_USER_REQUEST)
+	if (msg.mMsgFlags & RS_MSG_FLAGS_USER_REQUEST)
 	{
 		mis.msgflags |= RS_MSG_USER_REQUEST;
 	}
-	if (msg->msgFlags & RS_MSG_FLAGS_FRIEND_RECOMMENDATION)
+	if (msg.mMsgFlags & RS_MSG_FLAGS_FRIEND_RECOMMENDATION)
 	{
 		mis.msgflags |= RS_MSG_FRIEND_RECOMMENDATION;
 	}
-	if (msg->msgFlags & RS_MSG_FLAGS_PUBLISH_KEY)
+	if (msg.mMsgFlags & RS_MSG_FLAGS_PUBLISH_KEY)
 	{
 		mis.msgflags |= RS_MSG_PUBLISH_KEY;
 	}
-	if (msg->msgFlags & RS_MSG_FLAGS_LOAD_EMBEDDED_IMAGES)
+	if (msg.mMsgFlags & RS_MSG_FLAGS_LOAD_EMBEDDED_IMAGES)
 	{
 		mis.msgflags |= RS_MSG_LOAD_EMBEDDED_IMAGES;
 	}
 
-	mis.srcId = msg->PeerId();
+	mis.srcId = msg.mPeerId;
 	{
 		//msg->msgId;
-		rs_sprintf(mis.msgId, "%lu", msg->msgId);
+		rs_sprintf(mis.msgId, "%lu", msg.mMsgId);
 	}
 
-	mis.title = msg->subject;
-	mis.count = msg->attachment.items.size();
-	mis.ts = msg->sendTime;
-
-    MsgTagInfo taginfo;
-    locked_getMessageTag(mis.msgId,taginfo);
-    mis.msgtags = taginfo.tagIds ;
+	mis.title = msg.mSubject;
+	mis.count = msg.mAttachmentsCount;
+	mis.ts = msg.mSendTime;
+	mis.msgtags = msg.mTagIds;
 }
 
 void p3MsgService::initMIRsMsg(RsMsgItem *msg,const MessageInfo& info)
@@ -1924,6 +1733,7 @@ void p3MsgService::notifyDataStatus( const GRouterMsgPropagationId& id,
 
 			// clear the routed flag so that the message is requested again
 			mit->second->msgFlags &= ~RS_MSG_FLAGS_ROUTED;
+			mMailbox.setFlags(msg_id, mit->second->msgFlags);
 		}
 		return;
 	}
@@ -1956,6 +1766,7 @@ void p3MsgService::notifyDataStatus( const GRouterMsgPropagationId& id,
 
 		delete it2->second;
 		msgOutgoing.erase(it2);
+		mMailbox.removeMessage(msg_id);
 
 		RsServer::notify()->notifyListChange( NOTIFY_LIST_MESSAGELIST,
 		                                      NOTIFY_TYPE_ADD );
@@ -2091,6 +1902,7 @@ bool p3MsgService::notifyGxsTransSendStatus( RsGxsTransId mailId,
 
 			delete it2->second;
 			msgOutgoing.erase(it2);
+			mMailbox.removeMessage(msg_id);
 		}
 
 		RsServer::notify()->notifyListChange( NOTIFY_LIST_MESSAGELIST,
@@ -2139,6 +1951,7 @@ bool p3MsgService::notifyGxsTransSendStatus( RsGxsTransId mailId,
 
 			// clear the routed flag so that the message is requested again
 			mit->second->msgFlags &= ~RS_MSG_FLAGS_ROUTED;
+			mMailbox.setFlags(msg_id, mit->second->msgFlags);
 			return true;
 		}
 	}
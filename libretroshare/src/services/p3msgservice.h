@@ -35,6 +35,7 @@
 #include "pqi/p3cfgmgr.h"
 
 #include "services/p3service.h"
+#include "services/msgmailboxstore.h"
 #include "rsitems/rsmsgitems.h"
 #include "util/rsthreads.h"
 
@@ -55,12 +56,22 @@ class p3MsgService :
         GxsTransClient
 {
 public:
-	p3MsgService(p3ServiceControl *sc, p3IdService *id_service, p3GxsTrans& gxsMS);
+	/**
+	 * @param[in] mailboxDbPath path of the database storing messages
+	 * @param[in] mailboxDbKey key to encrypt the message database
+	 */
+	p3MsgService( p3ServiceControl *sc, p3IdService *id_service,
+	              p3GxsTrans& gxsMS, const std::string& mailboxDbPath,
+	              const std::string& mailboxDbKey );
 
 	virtual RsServiceInfo getServiceInfo();
 
     /* External Interface */
     bool 	getMessageSummaries(std::list<Rs::Msgs::MsgInfoSummary> &msgList);
+    bool 	getMessageSummariesPage( uint32_t box, uint32_t tagId,
+	                                 uint32_t offset, uint32_t count,
+	                                 std::list<Rs::Msgs::MsgInfoSummary>& msgList,
+	                                 uint32_t& total );
     bool 	getMessage(const std::string &mid, Rs::Msgs::MessageInfo &msg);
 	void	getMessageCount(uint32_t &nInbox, uint32_t &nInboxNew, uint32_t &nOutbox, uint32_t &nDraftbox, uint32_t &nSentbox, uint32_t &nTrashbox);
 
@@ -108,6 +119,12 @@ public:
 
 	/// iterate through the outgoing queue if online, send
 	int checkOutgoingMessages();
+
+	/** Move the messages loaded from the legacy config to the mailbox
+	 * database. They are kept and saved back to config if it fails, and the
+	 * migration is retried from tick().
+	 * @return false if some messages are still waiting to be migrated */
+	bool migrateLegacyItems();
     /*** Overloaded from pqiMonitor ***/
 
     /*** overloaded from p3turtle   ***/
@@ -143,6 +160,9 @@ public:
 private:
 	void sendDistantMsgItem(RsMsgItem *msgitem);
     bool locked_getMessageTag(const std::string &msgId, Rs::Msgs::MsgTagInfo& info);
+    /// set flags of a stored message, return false if it doesn't exist
+    bool locked_updateMsgFlags( uint32_t msgId, uint32_t flag, uint32_t mask,
+                                bool& changed );
 
 	/** This contains the ongoing tunnel handling contacts.
 	 * The map is indexed by the hash */
@@ -178,7 +198,7 @@ private:
     bool checkAndRebuildPartialMessage(RsMsgItem*) ;
 
     void 	initRsMI(RsMsgItem *msg, Rs::Msgs::MessageInfo &mi);
-    void 	initRsMIS(RsMsgItem *msg, Rs::Msgs::MsgInfoSummary &mis);
+    void 	initRsMIS(const MsgMailboxHeader& msg, Rs::Msgs::MsgInfoSummary &mis);
 
     RsMsgItem *initMIRsMsg(const Rs::Msgs::MessageInfo &info, const RsPeerId& to);
     RsMsgItem *initMIRsMsg(const Rs::Msgs::MessageInfo &info, const RsGxsId& to);
@@ -195,9 +215,9 @@ private:
     RsMutex mMsgMtx;
     RsMsgSerialiser *_serialiser ;
 
-    /* stored list of messages */
-    std::map<uint32_t, RsMsgItem *> imsg;
-    /* ones that haven't made it out yet! */
+    /* stored messages, tags and parent ids */
+    MsgMailboxStore mMailbox;
+    /* ones that haven't made it out yet! Also kept in mMailbox */
     std::map<uint32_t, RsMsgItem *> msgOutgoing; 
 
     std::map<RsPeerId, RsMsgItem *> _pendingPartialMessages ;
@@ -205,20 +225,17 @@ private:
     /* maps for tags types and msg tags */
 
     std::map<uint32_t, RsMsgTagType*> mTags;
-    std::map<uint32_t, RsMsgTags*> mMsgTags;
 
 	uint32_t mMsgUniqueId;
 	std::map<Sha1CheckSum, uint32_t> mRecentlyReceivedMessageHashes;
 	RsMutex recentlyReceivedMutex;
 
-    // used delete msgSrcIds after config save
-    std::map<uint32_t, RsMsgSrcId*> mSrcIds;
-
     // temporary storage. Will not be needed when messages have a proper "from" field. Not saved!
     std::map<uint32_t, RsGxsId> mDistantOutgoingMsgSigners;
 
-    // save the parent of the messages in draft for replied and forwarded
-    std::map<uint32_t, RsMsgParentId*> mParentId;
+    // legacy config items that could not be moved to mMailbox, saved back
+    std::list<RsItem*> mUnmigratedItems;
+    rstime_t mLastMigrationTs;
 
     std::string config_dir;
 
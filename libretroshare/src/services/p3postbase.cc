@@ -482,6 +482,10 @@ void p3PostBase::background_loadMsgs(const uint32_t &token, bool unprocessed)
 
 				/* but we need to notify GUI about them */	
 				msgChanges->msgChangeMap[mit->first].insert((*vit)->meta.mMsgId);
+
+				PostStats stats;
+				extractPostCache((*vit)->meta.mServiceString, stats);
+				postStatsUpdated((*vit)->meta, stats);
 			}
 			else if (NULL != (commentItem = dynamic_cast<RsGxsCommentItem *>(*vit)))
 			{
@@ -726,6 +730,9 @@ void p3PostBase::background_updateVoteCounts(const uint32_t &token)
 				uint32_t token_c;
 				RsGxsGrpMsgIdPair msgId = std::make_pair(vit->mGroupId, vit->mMsgId);
 				RsGenExchange::setMsgServiceString(token_c, msgId, str);
+
+				if (vit->mParentId.isNull())
+					postStatsUpdated(*vit, stats);
 			}
 		}
 	}
@@ -85,6 +85,14 @@ virtual void handleResponse(uint32_t token, uint32_t req_type);
         // Overloaded from RsTickEvent.
 virtual void handle_event(uint32_t event_type, const std::string &elabel);
 
+	/**
+	 * Called by background processing when a new post is processed or when
+	 * the vote and comment counters of a post change.
+	 * @param postMeta meta data of the post
+	 * @param stats up to date counters of the post
+	 */
+virtual void postStatsUpdated(const RsMsgMetaData& /*postMeta*/, const PostStats& /*stats*/) {}
+
 	public:
 
         //////////////////////////////////////////////////////////////////////////////
@@ -21,6 +21,7 @@
  *******************************************************************************/
 #include "services/p3posted.h"
 #include "rsitems/rsposteditems.h"
+#include "retroshare/rsgxsflags.h"
 
 #include <math.h>
 #include <typeinfo>
@@ -38,14 +39,20 @@ RsPosted *rsPosted = NULL;
 
 p3Posted::p3Posted(
         RsGeneralDataService *gds, RsNetworkExchangeService *nes,
-        RsGixs* gixs ) :
+        RsGixs* gixs, const std::string& rankingDbPath,
+        const std::string& dbKey ) :
     p3PostBase( gds, nes, gixs, new RsGxsPostedSerialiser(),
                 RS_SERVICE_GXS_TYPE_POSTED ),
-    RsPosted(static_cast<RsGxsIface&>(*this)) {}
+    RsPosted(static_cast<RsGxsIface&>(*this)),
+    mRankingIndex(rankingDbPath, dbKey),
+    mRankingIndexMtx("PostedRankingIndexMtx") {}
 
 const std::string GXS_POSTED_APP_NAME = "gxsposted";
 const uint16_t GXS_POSTED_APP_MAJOR_VERSION  =       1;
-const uint16_t GXS_POSTED_APP_MINOR_VERSION  =       0;
+// 1.1: batched message sync requests, see RsGxsNetService::BATCHED_SYNC_MINOR_VERSION
+// 1.2: new message announces, see RsGxsNetService::MSG_ANNOUNCE_MINOR_VERSION
+// 1.3: fragmented messages, see RsGxsNetService::FRAGMENTED_MSG_MINOR_VERSION
+const uint16_t GXS_POSTED_APP_MINOR_VERSION  =       3;
 const uint16_t GXS_POSTED_MIN_MAJOR_VERSION  =       1;
 const uint16_t GXS_POSTED_MIN_MINOR_VERSION  =       0;
 
@@ -59,6 +66,153 @@ RsServiceInfo p3Posted::getServiceInfo()
                 GXS_POSTED_MIN_MINOR_VERSION);
 }
 
+static PostedRankingRecord rankingRecord(
+        const RsGxsMessageId& msgId, rstime_t publishTs,
+        const PostStats& stats )
+{
+	PostedRankingRecord record;
+	record.mMsgId = msgId;
+	record.mPublishTs = publishTs;
+	record.mUpVotes = stats.up_votes;
+	record.mDownVotes = stats.down_votes;
+	record.mComments = stats.comments;
+	return record;
+}
+
+void p3Posted::postStatsUpdated(const RsMsgMetaData& postMeta, const PostStats& stats)
+{
+	PostedRankingRecord record = rankingRecord( postMeta.mMsgId,
+	                                            postMeta.mPublishTs, stats );
+
+	RS_STACK_MUTEX(mRankingIndexMtx);
+
+	auto bit = mRankingIndexBuilding.find(postMeta.mGroupId);
+	if(bit != mRankingIndexBuilding.end())
+	{
+		bit->second[postMeta.mMsgId] = record;
+		return;
+	}
+
+	// Boards never browsed are indexed from scratch on first access
+	if(!mRankingIndex.isIndexed(postMeta.mGroupId)) return;
+
+	mRankingIndex.updatePost(postMeta.mGroupId, record);
+}
+
+bool p3Posted::rankingIndexEnsure(const RsGxsGroupId& boardId)
+{
+	{
+		RS_STACK_MUTEX(mRankingIndexMtx);
+
+		// Another caller is building it, use its result
+		if(mRankingIndexBuilding.find(boardId) != mRankingIndexBuilding.end())
+		{
+			mRankingIndexBuilt.wait( mRankingIndexMtx, [&]() {
+				return mRankingIndexBuilding.find(boardId) == mRankingIndexBuilding.end(); } );
+			return mRankingIndex.isIndexed(boardId);
+		}
+
+		if(mRankingIndex.isIndexed(boardId)) return true;
+
+		// Post updates arriving meanwhile are kept until it's done
+		mRankingIndexBuilding[boardId];
+	}
+
+	bool ok = rankingIndexBuild(boardId);
+
+	{
+		RS_STACK_MUTEX(mRankingIndexMtx);
+
+		auto bit = mRankingIndexBuilding.find(boardId);
+		if(ok)
+			for(auto it(bit->second.begin()); it != bit->second.end(); ++it)
+				mRankingIndex.updatePost(boardId, it->second);
+		mRankingIndexBuilding.erase(bit);
+	}
+	mRankingIndexBuilt.notify_all();
+	return ok;
+}
+
+bool p3Posted::rankingIndexBuild(const RsGxsGroupId& boardId)
+{
+	uint32_t token;
+	RsTokReqOptions opts;
+	opts.mReqType = GXS_REQUEST_TYPE_MSG_META;
+	opts.mOptions = RS_TOKREQOPT_MSG_THREAD;
+
+	std::list<RsGxsGroupId> boardIds;
+	boardIds.push_back(boardId);
+
+	GxsMsgMetaMap metaMap;
+	if( !requestMsgInfo(token, opts, boardIds) ||
+	        waitToken(token,std::chrono::milliseconds(5000)) != RsTokenService::COMPLETE ||
+	        !RsGenExchange::getMsgMeta(token, metaMap) )
+	{
+		std::cerr << __PRETTY_FUNCTION__ << " Error! Failed getting metadata "
+		          << "of board: " << boardId << std::endl;
+		return false;
+	}
+
+	std::vector<PostedRankingRecord> records;
+	const std::vector<RsMsgMetaData>& metas(metaMap[boardId]);
+	for(auto it(metas.begin()); it != metas.end(); ++it)
+	{
+		if(!it->mParentId.isNull()) continue;
+
+		PostStats stats;
+		extractPostCache(it->mServiceString, stats);
+		records.push_back(rankingRecord(it->mMsgId, it->mPublishTs, stats));
+	}
+
+	return mRankingIndex.buildIndex(boardId, records);
+}
+
+bool p3Posted::getBoardRankedPosts(
+        const RsGxsGroupId& boardId, RankType rank, uint32_t offset,
+        uint32_t count, std::vector<RsPostedPost>& posts )
+{
+	posts.clear();
+	if(!rankingIndexEnsure(boardId)) return false;
+
+	std::vector<RsGxsMessageId> msgIds;
+	if(!mRankingIndex.getRanked(boardId, rank, time(NULL), offset, count, msgIds))
+		return false;
+	if(msgIds.empty()) return true;
+
+	uint32_t token;
+	RsTokReqOptions opts;
+	opts.mReqType = GXS_REQUEST_TYPE_MSG_DATA;
+
+	GxsMsgReq msgReq;
+	msgReq[boardId].insert(msgIds.begin(), msgIds.end());
+
+	std::vector<RsPostedPost> loaded;
+	if( !requestMsgInfo(token, opts, msgReq) ||
+	        waitToken(token,std::chrono::milliseconds(5000)) != RsTokenService::COMPLETE ||
+	        !getPostData(token, loaded) )
+		return false;
+
+	std::map<RsGxsMessageId, RsPostedPost*> postById;
+	for(auto it(loaded.begin()); it != loaded.end(); ++it)
+		postById[it->mMeta.mMsgId] = &(*it);
+
+	posts.reserve(msgIds.size());
+	for(auto it(msgIds.begin()); it != msgIds.end(); ++it)
+	{
+		auto pit = postById.find(*it);
+		if(pit != postById.end())
+		{
+			posts.push_back(*pit->second);
+			continue;
+		}
+
+		// Deleted by cleanup since it was indexed
+		mRankingIndex.removePost(boardId, *it);
+	}
+
+	return true;
+}
+
 bool p3Posted::groupShareKeys(const RsGxsGroupId& groupId,const std::set<RsPeerId>& peers)
 {
         RsGenExchange::shareGroupPublishKey(groupId,peers) ;
@@ -237,20 +391,9 @@ bool RsPostedPost::calculateScores(rstime_t ref_time)
 	mHaveVoted = (mMeta.mMsgStatus & GXS_SERV::GXS_MSG_STATUS_VOTE_MASK);
 
 	rstime_t age_secs = ref_time - mMeta.mPublishTs;
-#define POSTED_AGESHIFT (2.0)
-#define POSTED_AGEFACTOR (3600.0)
 
 	mTopScore = ((int) mUpVotes - (int) mDownVotes);
-	if (mTopScore > 0)
-	{
-		// score drops with time.
-		mHotScore =  mTopScore / pow(POSTED_AGESHIFT + age_secs / POSTED_AGEFACTOR, 1.5);
-	}
-	else
-	{
-		// gets more negative with time.
-		mHotScore =  mTopScore * pow(POSTED_AGESHIFT + age_secs / POSTED_AGEFACTOR, 1.5);
-	}
+	mHotScore = PostedRankingIndex::hotScore(mTopScore, age_secs);
 	mNewScore = -age_secs;
 
 	return true;
@@ -26,9 +26,11 @@
 
 #include "retroshare/rsposted.h"
 #include "services/p3postbase.h"
+#include "services/postedrankingindex.h"
 
 #include <retroshare/rsidentity.h>
 
+#include <condition_variable>
 #include <map>
 #include <string>
 #include <list>
@@ -41,7 +43,12 @@ class p3Posted: public p3PostBase, public RsPosted
 {
 	public:
 
-	p3Posted(RsGeneralDataService* gds, RsNetworkExchangeService* nes, RsGixs* gixs);
+	/**
+	 * @param[in] rankingDbPath path of the ranking index database
+	 * @param[in] dbKey encryption key of the ranking index database
+	 */
+	p3Posted(RsGeneralDataService* gds, RsNetworkExchangeService* nes, RsGixs* gixs,
+	         const std::string& rankingDbPath, const std::string& dbKey);
 virtual RsServiceInfo getServiceInfo();
 
 	protected:
@@ -51,6 +58,9 @@ virtual void notifyChanges(std::vector<RsGxsNotify*>& changes)
 	return p3PostBase::notifyChanges(changes);
 }
 
+	/// @see p3PostBase::postStatsUpdated
+virtual void postStatsUpdated(const RsMsgMetaData& postMeta, const PostStats& stats);
+
 	public:
 
 virtual void receiveHelperChanges(std::vector<RsGxsNotify*>& changes)
@@ -71,6 +81,11 @@ virtual bool createPost(uint32_t &token, RsPostedPost &post);
 virtual bool updateGroup(uint32_t &token, RsPostedGroup &group);
 virtual bool groupShareKeys(const RsGxsGroupId &group, const std::set<RsPeerId>& peers);
 
+	/// @see RsPosted::getBoardRankedPosts
+virtual bool getBoardRankedPosts( const RsGxsGroupId& boardId, RankType rank,
+                                  uint32_t offset, uint32_t count,
+                                  std::vector<RsPostedPost>& posts );
+
         //////////////////////////////////////////////////////////////////////////////
 	// WRAPPERS due to the separate Interface.
 
@@ -109,6 +124,27 @@ virtual void setMessageReadStatus(uint32_t& token, const RsGxsGrpMsgIdPair& msgI
 		if (mCommentService->acknowledgeVote(token, msgId)) return true;
 		return acknowledgeMsg(token, msgId);
 	}
+
+	private:
+
+	/** Build the ranking index of a board from the posts meta data if it
+	 * doesn't exist yet, the vote counters are taken from the service string
+	 * so no post needs to be deserialized. Callers asking for a board being
+	 * built wait for that build instead of starting another one. */
+	bool rankingIndexEnsure(const RsGxsGroupId& boardId);
+	/// Load the board posts meta data and build its index, unlocked
+	bool rankingIndexBuild(const RsGxsGroupId& boardId);
+
+	PostedRankingIndex mRankingIndex;
+
+	/// Protects mRankingIndexBuilding, and orders the index updates with it
+	RsMutex mRankingIndexMtx;
+	/** Boards which index is being built from scratch, with the post updates
+	 * received meanwhile, replayed once the build is done as the snapshot
+	 * may predate them */
+	std::map<RsGxsGroupId, std::map<RsGxsMessageId, PostedRankingRecord> > mRankingIndexBuilding;
+	/// Signaled when a build ends, waited by the callers of the same board
+	std::condition_variable_any mRankingIndexBuilt;
 };
 
 #endif 
@@ -0,0 +1,360 @@
+/*******************************************************************************
+ * libretroshare/src/services: postedrankingindex.cc                           *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+#include "services/postedrankingindex.h"
+#include "util/retrodb.h"
+
+/*static*/ const rstime_t PostedRankingIndex::HOT_REFRESH_PERIOD = 600;
+
+#define POSTED_AGESHIFT (2.0)
+#define POSTED_AGEFACTOR (3600.0)
+
+#define POSTS_TABLE_NAME std::string("POSTED_RANKING")
+#define BOARDS_TABLE_NAME std::string("POSTED_RANKING_BOARDS")
+
+#define KEY_GRP_ID std::string("grpId")
+#define KEY_MSG_ID std::string("msgId")
+#define KEY_PUBLISH_TS std::string("publishTs")
+#define KEY_UP_VOTES std::string("upVotes")
+#define KEY_DOWN_VOTES std::string("downVotes")
+#define KEY_COMMENTS std::string("comments")
+#define KEY_TOP_SCORE std::string("topScore")
+
+/*static*/ double PostedRankingIndex::hotScore(
+        int32_t topScore, rstime_t ageSecs )
+{
+	double decay = pow(POSTED_AGESHIFT + ageSecs / POSTED_AGEFACTOR, 1.5);
+
+	// score drops with time, negative ones get more negative with time.
+	if (topScore > 0) return topScore / decay;
+	return topScore * decay;
+}
+
+static int32_t topScore(const PostedRankingRecord& r)
+{ return static_cast<int32_t>(r.mUpVotes) - static_cast<int32_t>(r.mDownVotes); }
+
+PostedRankingIndex::PostedRankingIndex(
+        const std::string& dbPath, const std::string& key ) :
+    mDbMutex("PostedRankingIndex"),
+    mDb(new RetroDb(dbPath, RetroDb::OPEN_READWRITE_CREATE, key))
+{ initTables(); }
+
+PostedRankingIndex::~PostedRankingIndex()
+{
+	mDb->closeDb();
+	delete mDb;
+}
+
+bool PostedRankingIndex::isOpen()
+{
+	RS_STACK_MUTEX(mDbMutex);
+	return mDb->isOpen();
+}
+
+void PostedRankingIndex::initTables()
+{
+	RS_STACK_MUTEX(mDbMutex);
+	if(!mDb->isOpen()) return;
+
+	if(!mDb->tableExists(POSTS_TABLE_NAME))
+	{
+		mDb->execSQL("CREATE TABLE " + POSTS_TABLE_NAME + "(" +
+		             KEY_GRP_ID + " TEXT," +
+		             KEY_MSG_ID + " TEXT," +
+		             KEY_PUBLISH_TS + " INT," +
+		             KEY_UP_VOTES + " INT," +
+		             KEY_DOWN_VOTES + " INT," +
+		             KEY_COMMENTS + " INT," +
+		             KEY_TOP_SCORE + " INT," +
+		             "PRIMARY KEY (" + KEY_GRP_ID + "," + KEY_MSG_ID + "));");
+
+		mDb->execSQL("CREATE TABLE " + BOARDS_TABLE_NAME + "(" +
+		             KEY_GRP_ID + " TEXT PRIMARY KEY);");
+
+		mDb->execSQL("CREATE INDEX " + POSTS_TABLE_NAME + "_NEW_INDEX ON " +
+		             POSTS_TABLE_NAME + " (" + KEY_GRP_ID + "," +
+		             KEY_PUBLISH_TS + "," + KEY_MSG_ID + ");");
+		mDb->execSQL("CREATE INDEX " + POSTS_TABLE_NAME + "_TOP_INDEX ON " +
+		             POSTS_TABLE_NAME + " (" + KEY_GRP_ID + "," +
+		             KEY_TOP_SCORE + "," + KEY_PUBLISH_TS + "," +
+		             KEY_MSG_ID + ");");
+	}
+
+	std::list<std::string> columns;
+	columns.push_back(KEY_GRP_ID);
+
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery(BOARDS_TABLE_NAME, columns, "", "") );
+	if(!c) return;
+
+	RsGxsGroupId boardId;
+	for(bool valid = c->moveToFirst(); valid; valid = c->moveToNext())
+	{
+		c->getStringT(0, boardId);
+		mIndexedBoards.insert(boardId);
+	}
+}
+
+static std::string boardWhere(const RsGxsGroupId& boardId)
+{ return KEY_GRP_ID + "='" + boardId.toStdString() + "'"; }
+
+static std::string postWhere(
+        const RsGxsGroupId& boardId, const RsGxsMessageId& msgId )
+{
+	return boardWhere(boardId) + " AND " + KEY_MSG_ID + "='" +
+	        msgId.toStdString() + "'";
+}
+
+bool PostedRankingIndex::locked_getPost(
+        const RsGxsGroupId& boardId, const RsGxsMessageId& msgId,
+        PostedRankingRecord& record )
+{
+	std::list<std::string> columns;
+	columns.push_back(KEY_PUBLISH_TS);
+	columns.push_back(KEY_UP_VOTES);
+	columns.push_back(KEY_DOWN_VOTES);
+	columns.push_back(KEY_COMMENTS);
+
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery( POSTS_TABLE_NAME, columns,
+	                           postWhere(boardId, msgId), "" ) );
+	if(!c || !c->moveToFirst()) return false;
+
+	record.mMsgId = msgId;
+	record.mPublishTs = c->getInt64(0);
+	record.mUpVotes = static_cast<uint32_t>(c->getInt64(1));
+	record.mDownVotes = static_cast<uint32_t>(c->getInt64(2));
+	record.mComments = static_cast<uint32_t>(c->getInt64(3));
+	return true;
+}
+
+bool PostedRankingIndex::locked_updatePost(
+        const RsGxsGroupId& boardId, const PostedRankingRecord& record )
+{
+	PostedRankingRecord old;
+	bool exists = locked_getPost(boardId, record.mMsgId, old);
+	if( exists && old.mPublishTs == record.mPublishTs &&
+	        old.mUpVotes == record.mUpVotes &&
+	        old.mDownVotes == record.mDownVotes &&
+	        old.mComments == record.mComments )
+		return false;
+
+	ContentValue cv;
+	cv.put(KEY_PUBLISH_TS, static_cast<int64_t>(record.mPublishTs));
+	cv.put(KEY_UP_VOTES, static_cast<int64_t>(record.mUpVotes));
+	cv.put(KEY_DOWN_VOTES, static_cast<int64_t>(record.mDownVotes));
+	cv.put(KEY_COMMENTS, static_cast<int64_t>(record.mComments));
+	cv.put(KEY_TOP_SCORE, topScore(record));
+
+	bool ok;
+	if(exists)
+		ok = mDb->sqlUpdate(POSTS_TABLE_NAME, postWhere(boardId, record.mMsgId), cv);
+	else
+	{
+		cv.put(KEY_GRP_ID, boardId.toStdString());
+		cv.put(KEY_MSG_ID, record.mMsgId.toStdString());
+		ok = mDb->sqlInsert(POSTS_TABLE_NAME, "", cv);
+	}
+
+	auto hit = mHotRankings.find(boardId);
+	if(hit != mHotRankings.end()) hit->second.mDirty = true;
+
+	return ok;
+}
+
+bool PostedRankingIndex::isIndexed(const RsGxsGroupId& boardId)
+{
+	RS_STACK_MUTEX(mDbMutex);
+	return mIndexedBoards.find(boardId) != mIndexedBoards.end();
+}
+
+bool PostedRankingIndex::buildIndex(
+        const RsGxsGroupId& boardId,
+        const std::vector<PostedRankingRecord>& records )
+{
+	RS_STACK_MUTEX(mDbMutex);
+	if(!mDb->isOpen()) return false;
+
+	mDb->beginTransaction();
+	locked_removeBoard(boardId);
+
+	for(auto it(records.begin()); it != records.end(); ++it)
+		locked_updatePost(boardId, *it);
+
+	ContentValue cv;
+	cv.put(KEY_GRP_ID, boardId.toStdString());
+	if(!mDb->sqlInsert(BOARDS_TABLE_NAME, "", cv) || !mDb->commitTransaction())
+	{
+		std::cerr << __PRETTY_FUNCTION__ << " Error! Failed building index of "
+		          << "board: " << boardId << std::endl;
+		mDb->rollbackTransaction();
+		return false;
+	}
+
+	mIndexedBoards.insert(boardId);
+	return true;
+}
+
+bool PostedRankingIndex::updatePost(
+        const RsGxsGroupId& boardId, const PostedRankingRecord& record )
+{
+	RS_STACK_MUTEX(mDbMutex);
+	return locked_updatePost(boardId, record);
+}
+
+bool PostedRankingIndex::removePost(
+        const RsGxsGroupId& boardId, const RsGxsMessageId& msgId )
+{
+	RS_STACK_MUTEX(mDbMutex);
+
+	PostedRankingRecord record;
+	if(!locked_getPost(boardId, msgId, record)) return false;
+
+	auto hit = mHotRankings.find(boardId);
+	if(hit != mHotRankings.end()) hit->second.mDirty = true;
+
+	return mDb->sqlDelete(POSTS_TABLE_NAME, postWhere(boardId, msgId), "");
+}
+
+bool PostedRankingIndex::locked_removeBoard(const RsGxsGroupId& boardId)
+{
+	mIndexedBoards.erase(boardId);
+	mHotRankings.erase(boardId);
+	return mDb->sqlDelete(POSTS_TABLE_NAME, boardWhere(boardId), "") &&
+	        mDb->sqlDelete(BOARDS_TABLE_NAME, boardWhere(boardId), "");
+}
+
+bool PostedRankingIndex::removeBoard(const RsGxsGroupId& boardId)
+{
+	RS_STACK_MUTEX(mDbMutex);
+	return locked_removeBoard(boardId);
+}
+
+bool PostedRankingIndex::hasPost(
+        const RsGxsGroupId& boardId, const RsGxsMessageId& msgId )
+{
+	RS_STACK_MUTEX(mDbMutex);
+	PostedRankingRecord record;
+	return locked_getPost(boardId, msgId, record);
+}
+
+uint32_t PostedRankingIndex::postsCount(const RsGxsGroupId& boardId)
+{
+	std::list<std::string> columns;
+	columns.push_back("COUNT(*)");
+
+	RS_STACK_MUTEX(mDbMutex);
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery(POSTS_TABLE_NAME, columns, boardWhere(boardId), "") );
+	if(!c || !c->moveToFirst()) return 0;
+	return static_cast<uint32_t>(c->getInt64(0));
+}
+
+bool PostedRankingIndex::locked_refreshHot(
+        const RsGxsGroupId& boardId, rstime_t now, HotRanking& hot )
+{
+	if(!hot.mDirty && now < hot.mRefTs + HOT_REFRESH_PERIOD) return true;
+
+	std::list<std::string> columns;
+	columns.push_back(KEY_MSG_ID);
+	columns.push_back(KEY_TOP_SCORE);
+	columns.push_back(KEY_PUBLISH_TS);
+
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery(POSTS_TABLE_NAME, columns, boardWhere(boardId), "") );
+	if(!c) return false;
+
+	std::vector<std::pair<double, RsGxsMessageId> > scores;
+	RsGxsMessageId msgId;
+	for(bool valid = c->moveToFirst(); valid; valid = c->moveToNext())
+	{
+		c->getStringT(0, msgId);
+		scores.push_back(std::make_pair(
+		        hotScore( c->getInt32(1), now - c->getInt64(2) ), msgId ));
+	}
+
+	std::sort(scores.begin(), scores.end(),
+	          std::greater<std::pair<double, RsGxsMessageId> >());
+
+	hot.mMsgIds.clear();
+	hot.mMsgIds.reserve(scores.size());
+	for(auto it(scores.begin()); it != scores.end(); ++it)
+		hot.mMsgIds.push_back(it->second);
+
+	hot.mRefTs = now;
+	hot.mDirty = false;
+	return true;
+}
+
+bool PostedRankingIndex::getRanked(
+        const RsGxsGroupId& boardId, RsPosted::RankType rank, rstime_t now,
+        uint32_t offset, uint32_t count, std::vector<RsGxsMessageId>& msgIds )
+{
+	msgIds.clear();
+	if(!count) return true;
+
+	RS_STACK_MUTEX(mDbMutex);
+
+	std::string orderBy;
+	switch(rank)
+	{
+	case RsPosted::NewRankType:
+		orderBy = KEY_PUBLISH_TS + " DESC," + KEY_MSG_ID + " DESC";
+		break;
+	case RsPosted::TopRankType:
+		orderBy = KEY_TOP_SCORE + " DESC," + KEY_PUBLISH_TS + " DESC," +
+		        KEY_MSG_ID + " DESC";
+		break;
+	case RsPosted::HotRankType:
+	{
+		HotRanking& hot(mHotRankings[boardId]);
+		if(!locked_refreshHot(boardId, now, hot)) return false;
+		if(offset >= hot.mMsgIds.size()) return true;
+
+		uint32_t end = std::min<size_t>(hot.mMsgIds.size(), offset + count);
+		msgIds.assign(hot.mMsgIds.begin() + offset, hot.mMsgIds.begin() + end);
+		return true;
+	}
+	}
+
+	std::list<std::string> columns;
+	columns.push_back(KEY_MSG_ID);
+
+	std::unique_ptr<RetroCursor> c(
+	            mDb->sqlQuery( POSTS_TABLE_NAME, columns, boardWhere(boardId),
+	                           orderBy, "", count, offset ) );
+	if(!c) return false;
+
+	msgIds.reserve(count);
+	RsGxsMessageId msgId;
+	for(bool valid = c->moveToFirst(); valid; valid = c->moveToNext())
+	{
+		c->getStringT(0, msgId);
+		msgIds.push_back(msgId);
+	}
+
+	return true;
+}
@@ -0,0 +1,149 @@
+/*******************************************************************************
+ * libretroshare/src/services: postedrankingindex.h                            *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "retroshare/rsposted.h"
+#include "util/rsthreads.h"
+#include "util/rstime.h"
+
+class RetroDb;
+
+/// Counters of a post as seen by the ranking index
+struct PostedRankingRecord
+{
+	PostedRankingRecord() :
+	    mPublishTs(0), mUpVotes(0), mDownVotes(0), mComments(0) {}
+
+	RsGxsMessageId mMsgId;
+	rstime_t mPublishTs;
+	uint32_t mUpVotes;
+	uint32_t mDownVotes;
+	uint32_t mComments;
+};
+
+/**
+ * Scores of the posts of Posted boards, updated incrementally as votes and
+ * comments get processed, so the best posts of a board can be listed without
+ * loading and deserializing all of them.
+ * Each post is a row of a RetroDb table, a vote only rewrites that row, and
+ * new and top pages are read through (board, publishTs) and
+ * (board, topScore) indexes.
+ * The time decayed hot ordering can't be indexed, so the ids of each browsed
+ * board are sorted lazily when requested, at most once every
+ * HOT_REFRESH_PERIOD unless scores changed meanwhile.
+ */
+class PostedRankingIndex
+{
+public:
+	/**
+	 * @param[in] dbPath path of the database file, created if missing
+	 * @param[in] key encryption key, empty for plain sqlite
+	 */
+	PostedRankingIndex(const std::string& dbPath, const std::string& key);
+	~PostedRankingIndex();
+
+	/// Maximum age of the cached hot ordering, in seconds
+	static const rstime_t HOT_REFRESH_PERIOD;
+
+	/// @return false if the database couldn't be opened
+	bool isOpen();
+
+	/// @return true if the board index has been built
+	bool isIndexed(const RsGxsGroupId& boardId);
+
+	/**
+	 * @brief Build the index of a board from all its posts in a single
+	 *	transaction, replacing the existing one if any.
+	 * @return false on database error
+	 */
+	bool buildIndex( const RsGxsGroupId& boardId,
+	                 const std::vector<PostedRankingRecord>& records );
+
+	/**
+	 * @brief Add a post or update its counters
+	 * @return false if nothing changed, true otherwise
+	 */
+	bool updatePost( const RsGxsGroupId& boardId,
+	                 const PostedRankingRecord& record );
+
+	/// @return false if the post was not indexed, true otherwise
+	bool removePost(const RsGxsGroupId& boardId, const RsGxsMessageId& msgId);
+
+	/// Remove the whole index of a board
+	bool removeBoard(const RsGxsGroupId& boardId);
+
+	bool hasPost(const RsGxsGroupId& boardId, const RsGxsMessageId& msgId);
+
+	uint32_t postsCount(const RsGxsGroupId& boardId);
+
+	/**
+	 * @brief Get a page of the board posts, best ranked first
+	 * @param[in] boardId board to list
+	 * @param[in] rank ranking to use
+	 * @param[in] now reference time for time dependent rankings
+	 * @param[in] offset number of posts to skip
+	 * @param[in] count maximum number of posts to return
+	 * @param[out] msgIds ids of the posts
+	 * @return false on database error
+	 */
+	bool getRanked( const RsGxsGroupId& boardId, RsPosted::RankType rank,
+	                rstime_t now, uint32_t offset, uint32_t count,
+	                std::vector<RsGxsMessageId>& msgIds );
+
+	/// Time decayed score shared with RsPostedPost::calculateScores
+	static double hotScore(int32_t topScore, rstime_t ageSecs);
+
+private:
+	struct HotRanking
+	{
+		HotRanking() : mRefTs(0), mDirty(true) {}
+
+		std::vector<RsGxsMessageId> mMsgIds;
+		rstime_t mRefTs;
+		bool mDirty;
+	};
+
+	void initTables();
+
+	bool locked_getPost( const RsGxsGroupId& boardId,
+	                     const RsGxsMessageId& msgId,
+	                     PostedRankingRecord& record );
+	bool locked_updatePost( const RsGxsGroupId& boardId,
+	                        const PostedRankingRecord& record );
+	bool locked_removeBoard(const RsGxsGroupId& boardId);
+	bool locked_refreshHot( const RsGxsGroupId& boardId, rstime_t now,
+	                        HotRanking& hot );
+
+	RsMutex mDbMutex;
+	RetroDb* mDb;
+
+	/// Boards which index has been built, small enough to be kept in memory
+	std::set<RsGxsGroupId> mIndexedBoards;
+
+	/// Hot ordering of the boards browsed since startup
+	std::map<RsGxsGroupId, HotRanking> mHotRankings;
+};
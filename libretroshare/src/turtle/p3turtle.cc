@@ -39,8 +39,10 @@
 #include "ft/ftcontroller.h"
 
 #include "p3turtle.h"
+#include "turtlehashfilter.h"
 
 #include <iostream>
+#include <sstream>
 #include <errno.h>
 #include <cmath>
 
@@ -89,6 +91,8 @@ static const uint32_t MAX_TUNNEL_REQS_PER_SECOND               =   1 ; /// maxim
 static const uint32_t MAX_ALLOWED_SR_IN_CACHE                  = 120 ; /// maximum number of search requests allowed in cache. That makes 2 per sec.
 static const uint32_t TURTLE_SEARCH_RESULT_MAX_HITS_FILES      =5000 ; /// maximum number of search results forwarded back to the source.
 static const uint32_t TURTLE_SEARCH_RESULT_MAX_HITS_DEFAULT    = 100 ; /// default maximum number of search results forwarded back source.
+static const rstime_t LOCAL_SEARCH_CACHE_LIFE_TIME             =  20 ; /// life time of local file search results in the cache.
+static const uint32_t TURTLE_SEARCH_WORKER_THREADS             =   2 ; /// threads matching local file searches. They mostly wait on the file list mutex anyway.
 
 static const float depth_peer_probability[7] = { 1.0f,0.99f,0.9f,0.7f,0.6f,0.5,0.4f } ;
 
@@ -101,7 +105,7 @@ static const int DISTANCE_SQUEEZING_POWER               =  8 ;
 #define HEX_PRINT(a) std::hex << a << std::dec
 
 p3turtle::p3turtle(p3ServiceControl *sc,p3LinkMgr *lm)
-	:p3Service(), p3Config(), mServiceControl(sc), mLinkMgr(lm), mTurtleMtx("p3turtle")
+	:p3Service(), p3Config(), mServiceControl(sc), mLinkMgr(lm), mTurtleMtx("p3turtle"), mSearchPool("turtle search", TURTLE_SEARCH_WORKER_THREADS)
 {
 	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
 
@@ -130,6 +134,22 @@ p3turtle::p3turtle(p3ServiceControl *sc,p3LinkMgr *lm)
 	_service_type = getServiceInfo().mServiceType ;
 }
 
+p3turtle::~p3turtle()
+{
+	// Let the running local searches finish, then free the search requests that were never answered.
+
+	mSearchPool.stop() ;
+
+	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+
+	for(auto it(_pending_local_searches.begin());it!=_pending_local_searches.end();++it)
+		for(auto lit(it->second.begin());lit!=it->second.end();++lit)
+			delete *lit ;
+
+	for(auto it(_completed_local_searches.begin());it!=_completed_local_searches.end();++it)
+		delete it->first ;
+}
+
 const std::string TURTLE_APP_NAME = "turtle";
 const uint16_t TURTLE_APP_MAJOR_VERSION  =       1;
 const uint16_t TURTLE_APP_MINOR_VERSION  =       0;
@@ -208,6 +228,7 @@ int p3turtle::tick()
 	// Handle tunnel trafic
 	//
 	handleIncoming();		// handle incoming packets
+	handleCompletedLocalSearches();	// answer and forward search requests which local search is done
 
 	rstime_t now = time(NULL) ;
 
@@ -510,6 +531,12 @@ void p3turtle::autoWash()
 			}
 			else
 				++it;
+
+		for(std::map<std::string,TurtleLocalSearchCacheEntry>::iterator it(_local_search_cache.begin());it!=_local_search_cache.end();)
+			if(now > it->second.time_stamp + LOCAL_SEARCH_CACHE_LIFE_TIME)
+				it = _local_search_cache.erase(it) ;
+			else
+				++it;
 	}
 
 	// Tunnel requests
@@ -908,30 +935,122 @@ void p3turtle::handleSearchRequest(RsTurtleSearchRequestItem *item)
 		}
 	}
 
+    // File searches that are not in the cache are matched in the worker pool, so that search floods do not
+    // delay tunnel routing. The request is registered right away so that bouncing copies get dropped, and
+    // answered and forwarded by handleCompletedLocalSearches() when the search is done. Identical searches
+    // wait for the same job.
+
+    RsTurtleFileSearchRequestItem *ftsearch = dynamic_cast<RsTurtleFileSearchRequestItem*>(item) ;
+
+	if(ftsearch != NULL && item->PeerId() != _own_id)
+	{
+		std::string key = localSearchCacheKey(ftsearch) ;
+		std::list<TurtleFileInfo> cached_results ;
+		RsTurtleFileSearchRequestItem *search_item = NULL ;
+		bool start_job = false ;
+
+		{
+			RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+
+			if(!key.empty() && !locked_getCachedLocalSearch(key,cached_results))
+			{
+				TurtleSearchRequestInfo& req( _search_requests_origins[item->request_id] ) ;
+				req.origin = item->PeerId() ;
+				req.time_stamp = time(NULL) ;
+				req.depth = item->depth ;
+				req.result_count = 0 ;
+				req.keywords = item->GetKeywords() ;
+				req.service_id = item->serviceId() ;
+				req.max_allowed_hits = TURTLE_SEARCH_RESULT_MAX_HITS_FILES ;
+
+				std::list<RsTurtleFileSearchRequestItem*>& waiting(_pending_local_searches[key]) ;
+				start_job = waiting.empty() ;
+
+				search_item = dynamic_cast<RsTurtleFileSearchRequestItem*>(item->clone()) ;
+				waiting.push_back(search_item) ;
+			}
+		}
+
+		if(search_item != NULL)
+		{
+#ifdef P3TURTLE_DEBUG
+			std::cerr << "  Request not from us. Queuing local search" << (start_job?"":" behind an identical one") << std::endl ;
+#endif
+			if(start_job)
+				mSearchPool.run([this,key,search_item]()
+				{
+					std::list<TurtleFileInfo> results ;
+					search_item->search(results) ;
+
+					RS_STACK_MUTEX(mTurtleMtx) ;
+
+					TurtleLocalSearchCacheEntry& entry(_local_search_cache[key]) ;
+					entry.time_stamp = time(NULL) ;
+					entry.results = results ;
+
+					std::list<RsTurtleFileSearchRequestItem*>& waiting(_pending_local_searches[key]) ;
+
+					for(std::list<RsTurtleFileSearchRequestItem*>::const_iterator it(waiting.begin());it!=waiting.end();++it)
+						_completed_local_searches.push_back(std::make_pair(*it,results)) ;
+
+					_pending_local_searches.erase(key) ;
+				});
+			return ;
+		}
+	}
+
     // Perform local search off-mutex,because this might call some services that are above turtle in the mutex chain.
 
     uint32_t search_result_count = 0;
     uint32_t max_allowed_hits = TURTLE_SEARCH_RESULT_MAX_HITS_DEFAULT;
+    std::list<RsTurtleSearchResultItem*> search_results ;
 
 	if(item->PeerId() != _own_id) // is the request not coming from us?
 	{
 #ifdef P3TURTLE_DEBUG
 		std::cerr << "  Request not from us. Performing local search" << std::endl ;
 #endif
-        std::list<RsTurtleSearchResultItem*> search_results ;
-
         performLocalSearch(item,search_result_count,search_results,max_allowed_hits) ;
+	}
 
-        for(auto it(search_results.begin());it!=search_results.end();++it)
-        {
-            (*it)->request_id = item->request_id ;
-            (*it)->PeerId(item->PeerId()) ;
+	completeSearchRequest(item,search_results,search_result_count,max_allowed_hits) ;
+}
+
+void p3turtle::handleCompletedLocalSearches()
+{
+	std::list<std::pair<RsTurtleFileSearchRequestItem*,std::list<TurtleFileInfo> > > completed ;
+
+	{
+		RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+		completed.swap(_completed_local_searches) ;
+	}
+
+	for(auto it(completed.begin());it!=completed.end();++it)
+	{
+		uint32_t search_result_count = 0;
+		uint32_t max_allowed_hits = TURTLE_SEARCH_RESULT_MAX_HITS_DEFAULT;
+		std::list<RsTurtleSearchResultItem*> search_results ;
+
+		if(_turtle_routing_enabled && _turtle_routing_session_enabled)
+		{
+			makeFileSearchResults(it->second,search_result_count,search_results,max_allowed_hits) ;
+			completeSearchRequest(it->first,search_results,search_result_count,max_allowed_hits) ;
+		}
+		delete it->first ;
+	}
+}
+
+void p3turtle::completeSearchRequest(RsTurtleSearchRequestItem *item,std::list<RsTurtleSearchResultItem*>& search_results,uint32_t search_result_count,uint32_t max_allowed_hits)
+{
+	for(auto it(search_results.begin());it!=search_results.end();++it)
+	{
+		(*it)->request_id = item->request_id ;
+		(*it)->PeerId(item->PeerId()) ;
 
 #ifdef P3TURTLE_DEBUG
-			std::cerr << "  sending back search result for request " << item->request_id << " to back to peer " << item->PeerId() << std::endl ;
+		std::cerr << "  sending back search result for request " << item->request_id << " to back to peer " << item->PeerId() << std::endl ;
 #endif
-            sendItem(*it) ;
-        }
+		sendItem(*it) ;
 	}
 
 	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
@@ -1060,15 +1179,88 @@ void p3turtle::performLocalSearch_generic(RsTurtleGenericSearchRequestItem *item
     }
 }
 
+std::string p3turtle::localSearchCacheKey(const RsTurtleFileSearchRequestItem *item)
+{
+	// Search results only depend on the query: turtle searches only return files flagged for anonymous
+	// search, whatever the requesting peer. Substring search ignores case.
+
+	const RsTurtleStringSearchRequestItem *string_item = dynamic_cast<const RsTurtleStringSearchRequestItem*>(item) ;
+
+	if(string_item != NULL)
+	{
+		std::string key("s:") ;
+
+		for(uint32_t i=0;i<string_item->match_string.size();++i)
+			key += tolower(static_cast<unsigned char>(string_item->match_string[i])) ;
+
+		return key ;
+	}
+
+	const RsTurtleRegExpSearchRequestItem *regexp_item = dynamic_cast<const RsTurtleRegExpSearchRequestItem*>(item) ;
+
+	if(regexp_item != NULL)
+	{
+		const RsRegularExpression::LinearizedExpression& expr(regexp_item->expr) ;
+		std::ostringstream key ;
+		key << "r:" ;
+
+		for(uint32_t i=0;i<expr._tokens.size();++i) key << (int)expr._tokens[i] << "," ;
+		key << ":" ;
+		for(uint32_t i=0;i<expr._ints.size();++i) key << expr._ints[i] << "," ;
+		key << ":" ;
+		for(uint32_t i=0;i<expr._strings.size();++i) key << expr._strings[i].size() << ":" << expr._strings[i] ;
+
+		return key.str() ;
+	}
+
+	return std::string() ;
+}
+
+bool p3turtle::locked_getCachedLocalSearch(const std::string& key,std::list<TurtleFileInfo>& results)
+{
+	std::map<std::string,TurtleLocalSearchCacheEntry>::const_iterator it = _local_search_cache.find(key) ;
+
+	if(key.empty() || it == _local_search_cache.end() || time(NULL) > it->second.time_stamp + LOCAL_SEARCH_CACHE_LIFE_TIME)
+		return false ;
+
+	results = it->second.results ;
+	return true ;
+}
+
 void p3turtle::performLocalSearch_files(RsTurtleFileSearchRequestItem *item,uint32_t& req_result_count,std::list<RsTurtleSearchResultItem*>& result,uint32_t& max_allowed_hits)
 {
+    std::string key = localSearchCacheKey(item) ;
+    std::list<TurtleFileInfo> initialResults ;
+    bool cached ;
+
+    {
+        RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+        cached = locked_getCachedLocalSearch(key,initialResults) ;
+    }
+
+    if(!cached)
+    {
 #ifdef P3TURTLE_DEBUG
-	std::cerr << "Performing rsFiles->search()" << std::endl ;
+        std::cerr << "Performing rsFiles->search()" << std::endl ;
 #endif
-	// now, search!
-    std::list<TurtleFileInfo> initialResults ;
-    item->search(initialResults) ;
+        // now, search!
+        item->search(initialResults) ;
 
+        if(!key.empty())
+        {
+            RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+
+            TurtleLocalSearchCacheEntry& entry(_local_search_cache[key]) ;
+            entry.time_stamp = time(NULL) ;
+            entry.results = initialResults ;
+        }
+    }
+
+    makeFileSearchResults(initialResults,req_result_count,result,max_allowed_hits) ;
+}
+
+void p3turtle::makeFileSearchResults(const std::list<TurtleFileInfo>& initialResults,uint32_t& req_result_count,std::list<RsTurtleSearchResultItem*>& result,uint32_t& max_allowed_hits)
+{
 #ifdef P3TURTLE_DEBUG
 	std::cerr << initialResults.size() << " matches found." << std::endl ;
 #endif
@@ -2169,14 +2361,54 @@ bool p3turtle::performLocalHashSearch(const TurtleFileHash& hash,const RsPeerId&
 		client_map = _registered_services ;
 	}
 
-	for(auto it(client_map.begin());it!=client_map.end();++it)
+	// Services that keep a filter of their hashes are only asked for the full lookup when the filter passes.
+	// Most tunnel requests are for hashes we don't have, so this saves most of the lookups.
+
+	std::map<uint16_t,TurtleTunnelRequestFilterStatistics> stats ;
+	bool found = false ;
+
+	for(auto it(client_map.begin());it!=client_map.end() && !found;++it)
+	{
+		TurtleTunnelRequestFilterStatistics& s(stats[it->first]) ;
+		const TurtleHashFilter *filter = it->second->tunnelRequestFilter() ;
+
+		++s.requests ;
+
+		if(filter != NULL && !filter->mayContain(hash))
+		{
+			++s.filtered ;
+			continue ;
+		}
+		++s.passed ;
+
 		if( (*it).second->handleTunnelRequest(hash,peer_id))
 		{
+			++s.found ;
 			service = it->second ;
-			return true ;
+			found = true ;
 		}
+	}
+
+	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+
+	for(auto it(stats.begin());it!=stats.end();++it)
+	{
+		TurtleTunnelRequestFilterStatistics& s(_tunnel_request_filter_stats[it->first]) ;
 
-	return false ;
+		s.requests += it->second.requests ;
+		s.filtered += it->second.filtered ;
+		s.passed   += it->second.passed ;
+		s.found    += it->second.found ;
+	}
+
+	return found ;
+}
+
+void p3turtle::getTunnelRequestFilterStatistics(std::map<uint16_t,TurtleTunnelRequestFilterStatistics>& stats) const
+{
+	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+
+	stats = _tunnel_request_filter_stats ;
 }
 
 
@@ -2423,6 +2655,11 @@ void p3turtle::dumpState()
 						<< ", ts=" << it->second.time_stamp << " (" << now-it->second.time_stamp
 						<< " secs ago)" << std::endl ;
 
+	std::cerr << "  Tunnel request filters:" << std::endl ;
+	for(std::map<uint16_t,TurtleTunnelRequestFilterStatistics>::const_iterator it(_tunnel_request_filter_stats.begin());it!=_tunnel_request_filter_stats.end();++it)
+		std::cerr << "    service=" << std::hex << it->first << std::dec << ": requests=" << it->second.requests << ", filtered=" << it->second.filtered
+		          << ", passed=" << it->second.passed << ", found=" << it->second.found << std::endl ;
+
 	std::cerr << "  Virtual peers:" << std::endl ;
 	for(std::map<TurtleVirtualPeerId,TurtleTunnelId>::const_iterator it(_virtual_peers.begin());it!=_virtual_peers.end();++it)
 		std::cerr << "    id=" << it->first << ", tunnel=" << HEX_PRINT(it->second) << std::endl ;
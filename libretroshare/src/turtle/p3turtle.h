@@ -149,6 +149,7 @@
 #include "rsturtleitem.h"
 #include "turtleclientservice.h"
 #include "turtlestatistics.h"
+#include "util/rsworkerpool.h"
 
 //#define TUNNEL_STATISTICS
 
@@ -173,6 +174,15 @@ class TurtleSearchRequestInfo
         uint16_t     service_id;      // ID of the client service who issues the request. This is null if the request does not have a local origin.
         uint32_t     max_allowed_hits;// Max number of hits allowed for this search. This actually depends on the type of search (files, GXS groups, GXS group data, etc)
 };
+// Results of a local file search, kept for a short while so that identical searches
+// relayed by different peers are only matched once.
+//
+class TurtleLocalSearchCacheEntry
+{
+	public:
+		rstime_t time_stamp ;
+		std::list<TurtleFileInfo> results ;
+};
 class TurtleTunnelRequestInfo
 {
 	public:
@@ -227,6 +237,7 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 {
 	public:
 		p3turtle(p3ServiceControl *sc,p3LinkMgr *lm) ;
+		virtual ~p3turtle() ;
 		virtual RsServiceInfo getServiceInfo();
 
 		// Enables/disable the service. Still ticks, but does nothing. Default is true.
@@ -298,6 +309,9 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 		
 		virtual void getTrafficStatistics(TurtleTrafficStatisticsInfo& info) const ;
 
+		/// get the counters of tunnel requests handled by each client service, by service id.
+		void getTunnelRequestFilterStatistics(std::map<uint16_t,TurtleTunnelRequestFilterStatistics>& stats) const ;
+
 		/************* from p3service *******************/
 
 		/// This function does many things:
@@ -388,6 +402,8 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 
 		// following functions should go to ftServer
 		void handleSearchRequest(RsTurtleSearchRequestItem *item);		
+		void handleCompletedLocalSearches();
+		void completeSearchRequest(RsTurtleSearchRequestItem *item,std::list<RsTurtleSearchResultItem*>& search_results,uint32_t search_result_count,uint32_t max_allowed_hits);
 		void handleSearchResult(RsTurtleSearchResultItem *item);
 		void handleTunnelRequest(RsTurtleOpenTunnelItem *item);		
 		void handleTunnelResult(RsTurtleTunnelOkItem *item);		
@@ -397,6 +413,9 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 		/// Performs a search calling local cache and search structure.
 		void performLocalSearch        (RsTurtleSearchRequestItem        *item, uint32_t& req_result_count,std::list<RsTurtleSearchResultItem*>& result,uint32_t& max_allowed_hits) ;
 		void performLocalSearch_files  (RsTurtleFileSearchRequestItem    *item, uint32_t& req_result_count, std::list<RsTurtleSearchResultItem*>& result, uint32_t &max_allowed_hits) ;
+		void makeFileSearchResults     (const std::list<TurtleFileInfo>& files, uint32_t& req_result_count, std::list<RsTurtleSearchResultItem*>& result, uint32_t &max_allowed_hits) ;
+		bool locked_getCachedLocalSearch(const std::string& key,std::list<TurtleFileInfo>& results) ;
+		static std::string localSearchCacheKey(const RsTurtleFileSearchRequestItem *item) ;
 		void performLocalSearch_generic(RsTurtleGenericSearchRequestItem *item, uint32_t& req_result_count, std::list<RsTurtleSearchResultItem*>& result, uint32_t &max_allowed_hits) ;
 
 		/// Returns true if the file with given hash is hosted locally, and accessible in anonymous mode the supplied peer.
@@ -436,6 +455,18 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 		/// List of client services that have regitered.
 		std::map<uint16_t,RsTurtleClientService*>						_registered_services ;
 
+		/// How tunnel requests were handled by each client service, by service id.
+		std::map<uint16_t,TurtleTunnelRequestFilterStatistics>			_tunnel_request_filter_stats ;
+
+		/// Recent local file search results, by normalized query.
+		std::map<std::string,TurtleLocalSearchCacheEntry>				_local_search_cache ;
+
+		/// File search requests waiting for a local search running in the worker pool, by normalized query.
+		std::map<std::string,std::list<RsTurtleFileSearchRequestItem*> >	_pending_local_searches ;
+
+		/// File search requests which local search is done, waiting to be answered and forwarded by the turtle thread.
+		std::list<std::pair<RsTurtleFileSearchRequestItem*,std::list<TurtleFileInfo> > > _completed_local_searches ;
+
 		rstime_t _last_clean_time ;
 		rstime_t _last_tunnel_management_time ;
 		rstime_t _last_tunnel_campaign_time ;
@@ -464,6 +495,11 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 
 		uint32_t _service_type ;
 
+		// Local file searches run here, so that search floods never delay tunnel routing. Stopped by the
+		// destructor before the members the jobs use are destroyed.
+
+		RsWorkerPool mSearchPool ;
+
 #ifdef P3TURTLE_DEBUG
 		// debug function
 		void dumpState() ;
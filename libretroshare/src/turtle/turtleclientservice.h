@@ -35,6 +35,7 @@
 
 struct RsItem;
 class p3turtle ;
+class TurtleHashFilter ;
 
 class RsTurtleClientService
 {
@@ -60,6 +61,16 @@ class RsTurtleClientService
 		 * \return true if the service
 		 */
 		virtual bool handleTunnelRequest(const RsFileHash& /*hash*/,const RsPeerId& /*peer_id*/) { return false ; }
+
+		/*!
+		 * \brief tunnelRequestFilter
+		 *           Optional Bloom filter of the hashes handleTunnelRequest() may accept. When provided, the turtle router checks it first
+		 *           and skips handleTunnelRequest() for hashes that are certainly not handled. Services whose lookup is cheap do not need it.
+		 *           The filter must stay alive as long as the service is registered.
+		 *
+		 * \return the filter, or NULL (default) if the service does not keep one.
+		 */
+		virtual const TurtleHashFilter *tunnelRequestFilter() const { return NULL ; }
 		
 	    /*!
 		 * \brief receiveTurtleData
@@ -0,0 +1,152 @@
+/*******************************************************************************
+ * libretroshare/src/turtle: turtlehashfilter.cc                               *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <algorithm>
+#include <iostream>
+
+#include "turtle/turtlehashfilter.h"
+
+static const uint32_t TURTLE_HASH_FILTER_BITS_PER_HASH      = 10 ; /// ~1% of false positives with 7 hash functions
+static const uint32_t TURTLE_HASH_FILTER_NB_HASH_FUNCTIONS  =  7 ;
+static const uint32_t TURTLE_HASH_FILTER_MIN_CAPACITY       = 1024 ; /// avoids rebuilding too often while hashes are being added
+static const uint32_t TURTLE_HASH_FILTER_HEADROOM_PERCENT   = 50 ; /// room left for hashes added after a rebuild
+
+// Hashes are already uniformly distributed, so their first bytes make good seeds for double hashing.
+
+static void hashFilterProbes(const TurtleFileHash& hash,uint32_t& h1,uint32_t& h2)
+{
+	const unsigned char *bytes = hash.toByteArray() ;
+
+	h1 = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24) ;
+	h2 = (uint32_t)bytes[4] | ((uint32_t)bytes[5] << 8) | ((uint32_t)bytes[6] << 16) | ((uint32_t)bytes[7] << 24) ;
+	h2 |= 1 ;
+}
+
+TurtleHashFilter::TurtleHashFilter()
+    : mFilterMtx("TurtleHashFilter"), mNbHashes(0), mCapacity(0), mBuilt(false), mRebuilding(false)
+{
+}
+
+void TurtleHashFilter::locked_addBits(const TurtleFileHash& hash)
+{
+	uint32_t nbits = mBits.size()*8 ;
+	uint32_t h1,h2 ;
+	hashFilterProbes(hash,h1,h2) ;
+
+	for(uint32_t i=0;i<TURTLE_HASH_FILTER_NB_HASH_FUNCTIONS;++i)
+	{
+		uint32_t bit = (h1 + i*h2) % nbits ;
+		mBits[bit >> 3] |= 1 << (bit & 7) ;
+	}
+	++mNbHashes ;
+}
+
+void TurtleHashFilter::add(const TurtleFileHash& hash)
+{
+	RS_STACK_MUTEX(mFilterMtx) ;
+
+	if(mRebuilding)
+		mAddedDuringRebuild.push_back(hash) ;
+
+	if(mBuilt)
+		locked_addBits(hash) ;
+}
+
+bool TurtleHashFilter::mayContain(const TurtleFileHash& hash) const
+{
+	RS_STACK_MUTEX(mFilterMtx) ;
+
+	if(!mBuilt)
+		return true ;
+
+	uint32_t nbits = mBits.size()*8 ;
+	uint32_t h1,h2 ;
+	hashFilterProbes(hash,h1,h2) ;
+
+	for(uint32_t i=0;i<TURTLE_HASH_FILTER_NB_HASH_FUNCTIONS;++i)
+	{
+		uint32_t bit = (h1 + i*h2) % nbits ;
+
+		if(!(mBits[bit >> 3] & (1 << (bit & 7))))
+			return false ;
+	}
+	return true ;
+}
+
+void TurtleHashFilter::beginRebuild()
+{
+	RS_STACK_MUTEX(mFilterMtx) ;
+
+	mRebuilding = true ;
+	mAddedDuringRebuild.clear() ;
+}
+
+void TurtleHashFilter::finishRebuild(const std::vector<TurtleFileHash>& hashes)
+{
+	RS_STACK_MUTEX(mFilterMtx) ;
+
+	if(!mRebuilding)
+	{
+		std::cerr << "(EE) TurtleHashFilter::finishRebuild() called without beginRebuild(). Ignoring." << std::endl;
+		return ;
+	}
+
+	uint32_t n = hashes.size() + mAddedDuringRebuild.size() ;
+
+	mCapacity = std::max(TURTLE_HASH_FILTER_MIN_CAPACITY, n + n*TURTLE_HASH_FILTER_HEADROOM_PERCENT/100) ;
+	std::vector<uint8_t>((mCapacity*TURTLE_HASH_FILTER_BITS_PER_HASH + 7)/8,0).swap(mBits) ;
+	mNbHashes = 0 ;
+
+	for(uint32_t i=0;i<hashes.size();++i)
+		locked_addBits(hashes[i]) ;
+
+	for(uint32_t i=0;i<mAddedDuringRebuild.size();++i)
+		locked_addBits(mAddedDuringRebuild[i]) ;
+
+	std::vector<TurtleFileHash>().swap(mAddedDuringRebuild) ;
+	mRebuilding = false ;
+	mBuilt = true ;
+}
+
+bool TurtleHashFilter::isBuilt() const
+{
+	RS_STACK_MUTEX(mFilterMtx) ;
+	return mBuilt ;
+}
+
+bool TurtleHashFilter::isOverloaded() const
+{
+	RS_STACK_MUTEX(mFilterMtx) ;
+	return mBuilt && mNbHashes > mCapacity ;
+}
+
+uint32_t TurtleHashFilter::size() const
+{
+	RS_STACK_MUTEX(mFilterMtx) ;
+	return mNbHashes ;
+}
+
+size_t TurtleHashFilter::memoryUsage() const
+{
+	RS_STACK_MUTEX(mFilterMtx) ;
+	return sizeof(*this) + mBits.capacity() + mAddedDuringRebuild.capacity()*sizeof(TurtleFileHash) ;
+}
@@ -0,0 +1,78 @@
+/*******************************************************************************
+ * libretroshare/src/turtle: turtlehashfilter.h                                *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <vector>
+
+#include "turtle/turtletypes.h"
+#include "util/rsthreads.h"
+
+// Bloom filter of the hashes a turtle client service can open tunnels for. The turtle router checks it before
+// calling RsTurtleClientService::handleTunnelRequest(), so that the (usually vast) majority of tunnel requests
+// for hashes we do not have are dropped without the full lookup.
+//
+// mayContain() never returns false for a hash that was add()ed since the last rebuild. Until the first rebuild
+// it returns true for everything, so that a service never misses a tunnel before its filter is ready.
+// Removed hashes are only forgotten by the next rebuild, which the owner calls periodically or when
+// isOverloaded() says the false positive rate is above what the filter was sized for.
+//
+// All methods are thread safe.
+//
+class TurtleHashFilter
+{
+public:
+	TurtleHashFilter() ;
+
+	void add(const TurtleFileHash& hash) ;
+	bool mayContain(const TurtleFileHash& hash) const ;
+
+	// Rebuilding is done in two steps, so that the owner can collect the hashes from components that have their
+	// own mutex, while these components keep calling add():
+	//
+	//    filter.beginRebuild() ;
+	//    ... collect all the current hashes ...
+	//    filter.finishRebuild(hashes) ;
+	//
+	// Hashes added between the two calls are kept in the new filter.
+	//
+	void beginRebuild() ;
+	void finishRebuild(const std::vector<TurtleFileHash>& hashes) ;
+
+	bool isBuilt() const ;
+	bool isOverloaded() const ;
+
+	uint32_t size() const ;			// number of hashes added since the last rebuild, possibly with duplicates
+	size_t memoryUsage() const ;
+
+private:
+	void locked_addBits(const TurtleFileHash& hash) ;
+
+	mutable RsMutex mFilterMtx ;
+
+	std::vector<uint8_t> mBits ;
+	uint32_t mNbHashes ;
+	uint32_t mCapacity ;	// number of hashes the filter was sized for
+	bool mBuilt ;
+	bool mRebuilding ;
+
+	std::vector<TurtleFileHash> mAddedDuringRebuild ;
+};
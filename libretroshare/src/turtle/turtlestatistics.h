@@ -49,3 +49,18 @@ class TurtleTrafficStatisticsInfoOp: public TurtleTrafficStatisticsInfo
 		}
 };
 
+
+// Counts how the tunnel requests for a given client service were handled, in order to measure the efficiency
+// of the service's TurtleHashFilter: filtered/requests is the hit rate of the filter, and (passed-found)/passed
+// the rate of false positives (plus the hashes the full lookup rejected for other reasons, e.g. permissions).
+//
+class TurtleTunnelRequestFilterStatistics
+{
+	public:
+		TurtleTunnelRequestFilterStatistics() : requests(0),filtered(0),passed(0),found(0) {}
+
+		uint64_t requests ;		// tunnel requests submitted to the service
+		uint64_t filtered ;		// rejected by the filter, without calling handleTunnelRequest()
+		uint64_t passed ;		// checked by handleTunnelRequest(), either because the filter passed or because there is no filter
+		uint64_t found ;		// accepted by handleTunnelRequest()
+};
@@ -25,6 +25,7 @@
 #include <memory.h>
 #include "util/rstime.h"
 #include <inttypes.h>
+#include <algorithm>
 
 #include "retrodb.h"
 #include "rsdbbind.h"
@@ -196,6 +197,13 @@ bool RetroDb::execSQL(const std::string &query){
 RetroCursor* RetroDb::sqlQuery(const std::string& tableName, const std::list<std::string>& columns,
                                const std::string& selection, const std::string& orderBy){
 
+    return sqlQuery(tableName, columns, selection, orderBy, "", -1);
+}
+
+RetroCursor* RetroDb::sqlQuery(const std::string& tableName, const std::list<std::string>& columns,
+                               const std::string& selection, const std::string& orderBy,
+                               const std::string& groupBy, int64_t limit, int64_t offset){
+
     if(tableName.empty() || columns.empty()){
         std::cerr << "RetroDb::sqlQuery(): No table or columns given" << std::endl;
         return NULL;
@@ -222,12 +230,20 @@ RetroCursor* RetroDb::sqlQuery(const std::string& tableName, const std::list<std
     if(!selection.empty())
         sqlQuery += " WHERE " + selection;
 
+    // add 'group by' clause if present
+    if(!groupBy.empty())
+        sqlQuery += " GROUP BY " + groupBy;
 
     // add 'order by' clause if present
     if(!orderBy.empty())
-        sqlQuery += " ORDER BY " + orderBy + ";";
-    else
-        sqlQuery += ";";
+        sqlQuery += " ORDER BY " + orderBy;
+
+    // paging, sqlite only accepts OFFSET after a LIMIT, -1 meaning none
+    if(limit >= 0 || offset > 0)
+        sqlQuery += " LIMIT " + std::to_string(limit >= 0 ? limit : -1) +
+                    " OFFSET " + std::to_string(offset > 0 ? offset : 0);
+
+    sqlQuery += ";";
 
 #ifdef RETRODB_DEBUG
     std::cerr << "RetroDb::sqlQuery(): " << sqlQuery << std::endl;
@@ -618,6 +634,132 @@ bool RetroDb::tableExists(const std::string &tableName)
     return result;
 }
 
+static int journalModeCallback(void* mode, int argc, char** argv, char** /* columns */)
+{
+    if(argc > 0 && argv[0])
+        *static_cast<std::string*>(mode) = argv[0];
+
+    return 0;
+}
+
+bool RetroDb::enableWriteAheadLog()
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    std::string mode;
+    char *err = NULL;
+
+    int rc = sqlite3_exec(mDb, "PRAGMA journal_mode=WAL;", journalModeCallback, &mode, &err);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "RetroDb::enableWriteAheadLog(): Error code: " << rc;
+        if (err)
+        {
+            std::cerr << ", " << err;
+        }
+        std::cerr << std::endl;
+        sqlite3_free(err);
+        return false;
+    }
+
+    return mode == "wal";
+}
+
+void RetroDb::setBusyTimeout(int ms)
+{
+    if (isOpen()) {
+        sqlite3_busy_timeout(mDb, ms);
+    }
+}
+
+/********************** RetroDbReadPool ************************/
+
+#define READ_POOL_BUSY_TIMEOUT_MS 5000
+
+RetroDbReadPool::RetroDbReadPool(const std::string& dbPath, const std::string& key, uint32_t maxConnections)
+    : mDbPath(dbPath), mKey(key), mMaxConnections(std::max(maxConnections, 1u)), mOpened(0), mOpenFailed(false) {}
+
+RetroDbReadPool::~RetroDbReadPool()
+{
+    std::unique_lock<std::mutex> lock(mMtx);
+
+    if(mIdle.size() != mOpened)
+        std::cerr << "RetroDbReadPool::~RetroDbReadPool(): " << mOpened - mIdle.size()
+                  << " connection(s) to " << mDbPath << " still in use!" << std::endl;
+
+    for(std::vector<RetroDb*>::iterator it = mIdle.begin(); it != mIdle.end(); ++it)
+        delete *it;
+
+    mIdle.clear();
+}
+
+RetroDb* RetroDbReadPool::openConnection()
+{
+    // Opened read/write so that sqlcipher migration and the WAL index work as
+    // with the main connection, but any write is refused by sqlite.
+    RetroDb* db = new RetroDb(mDbPath, RetroDb::OPEN_READWRITE, mKey);
+
+    if(!db->isOpen() || !db->execSQL("PRAGMA query_only = ON;"))
+    {
+        std::cerr << "RetroDbReadPool::openConnection(): cannot open " << mDbPath << std::endl;
+        delete db;
+        return NULL;
+    }
+
+    db->setBusyTimeout(READ_POOL_BUSY_TIMEOUT_MS);
+    return db;
+}
+
+RetroDb* RetroDbReadPool::acquire()
+{
+    std::unique_lock<std::mutex> lock(mMtx);
+
+    for(;;)
+    {
+        if(!mIdle.empty())
+        {
+            RetroDb* db = mIdle.back();
+            mIdle.pop_back();
+            return db;
+        }
+
+        if(mOpenFailed)
+            return NULL;
+
+        if(mOpened < mMaxConnections)
+        {
+            ++mOpened;
+
+            // opening may be slow with an encrypted database, don't keep others waiting
+            lock.unlock();
+            RetroDb* db = openConnection();
+            lock.lock();
+
+            if(!db)
+            {
+                --mOpened;
+                mOpenFailed = true;
+                mReleased.notify_all();
+            }
+            return db;
+        }
+
+        mReleased.wait(lock);
+    }
+}
+
+void RetroDbReadPool::release(RetroDb* db)
+{
+    if(!db)
+        return;
+
+    std::unique_lock<std::mutex> lock(mMtx);
+    mIdle.push_back(db);
+    mReleased.notify_one();
+}
+
 /********************** RetroCursor ************************/
 
 RetroCursor::RetroCursor(sqlite3_stmt *stmt)
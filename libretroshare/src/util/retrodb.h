@@ -32,6 +32,9 @@
 #include <set>
 #include <list>
 #include <map>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
 #include "rsdbbind.h"
 
 #include "contentvalue.h"
@@ -151,6 +154,21 @@ public:
     RetroCursor* sqlQuery(const std::string& tableName, const std::list<std::string>& columns,
                           const std::string& selection, const std::string& orderBy);
 
+    /*!
+     * Query the given table grouping and paging the result set
+     * @param tableName the table name
+     * @param columns list columns that should be returned and their order (the list's order)
+     * @param selection filter formatted as an SQL WHERE clause (excluding the WHERE itself), empty for all rows
+     * @param orderBy formatted as an SQL ORDER BY clause (excluding the ORDER BY itself), empty for no ordering
+     * @param groupBy formatted as an SQL GROUP BY clause (excluding the GROUP BY itself), empty for no grouping
+     * @param limit maximum number of rows to return, negative for no limit
+     * @param offset number of rows to skip before the first returned one
+     * @return cursor over result set, this allocated resource should be free'd after use
+     */
+    RetroCursor* sqlQuery(const std::string& tableName, const std::list<std::string>& columns,
+                          const std::string& selection, const std::string& orderBy,
+                          const std::string& groupBy, int64_t limit, int64_t offset = 0);
+
     /*!
      * delete row in an sql table
      * @param tableName the table on which to apply the DELETE
@@ -172,6 +190,20 @@ public:
      */
     bool tableExists(const std::string& tableName);
 
+    /*!
+     * Switch the database to write-ahead logging, so that readers using
+     * other connections are not blocked by a write transaction (and
+     * conversely). The setting is persistent in the database file.
+     * @return true if the database is now in WAL mode
+     */
+    bool enableWriteAheadLog();
+
+    /*!
+     * Make sqlite retry for up to \p ms milliseconds when the database is
+     * locked by another connection, instead of failing with SQLITE_BUSY
+     */
+    void setBusyTimeout(int ms);
+
 public:
 
     static const int OPEN_READONLY;
@@ -204,6 +236,82 @@ private:
     const std::string mKey;
 };
 
+/*!
+ * Pool of query-only connections to a database file in WAL mode, so that
+ * reads can run in parallel with each other and with the writer connection.
+ * Connections are opened on demand, up to a fixed maximum, and kept open
+ * until the pool is destroyed.
+ */
+class RetroDbReadPool
+{
+public:
+
+    /*!
+     * @param dbPath path of a database already opened (and created) by a writer
+     * @param key key used to encrypt the database
+     * @param maxConnections maximum number of connections opened at once
+     */
+    RetroDbReadPool(const std::string& dbPath, const std::string& key, uint32_t maxConnections);
+
+    /*!
+     * closes all connections, which must have been released beforehand
+     */
+    ~RetroDbReadPool();
+
+    /*!
+     * Get an idle connection, opening a new one if the pool is not full
+     * or waiting for another thread to release one otherwise
+     * @return NULL if no connection could be opened
+     */
+    RetroDb* acquire();
+
+    /*!
+     * Give back a connection obtained with acquire(). All cursors
+     * created from it must have been deleted.
+     */
+    void release(RetroDb* db);
+
+private:
+
+    RetroDb* openConnection();
+
+    const std::string mDbPath;
+    const std::string mKey;
+    const uint32_t mMaxConnections;
+
+    std::mutex mMtx;
+    std::condition_variable mReleased;
+    std::vector<RetroDb*> mIdle;
+    uint32_t mOpened;
+    bool mOpenFailed;
+};
+
+/*!
+ * Holds a connection of a RetroDbReadPool for the lifetime of the object
+ */
+class RetroDbReadHandle
+{
+public:
+
+    explicit RetroDbReadHandle(RetroDbReadPool* pool)
+        : mPool(pool), mDb(pool ? pool->acquire() : NULL) {}
+
+    ~RetroDbReadHandle() { if(mDb) mPool->release(mDb); }
+
+    /*!
+     * @return the connection, NULL if there is no pool or it failed to open one
+     */
+    RetroDb* db() const { return mDb; }
+
+private:
+
+    RetroDbReadHandle(const RetroDbReadHandle&);
+    RetroDbReadHandle& operator=(const RetroDbReadHandle&);
+
+    RetroDbReadPool* mPool;
+    RetroDb* mDb;
+};
+
 /*!
  * Exposes result set from retrodb query
  */
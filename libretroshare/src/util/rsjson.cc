@@ -66,3 +66,17 @@ std::ostream& operator<<(std::ostream &out, const RsJson &jDoc)
 
 	return out << buffer.GetString();
 }
+
+void rsJsonCompactWrite(const RsJson& jDoc, std::vector<uint8_t>& out)
+{
+	RsJsonByteStream os(out);
+	rapidjson::Writer<RsJsonByteStream> writer(os);
+	jDoc.Accept(writer);
+}
+
+void rsJsonPrettyWrite(const RsJson& jDoc, std::vector<uint8_t>& out)
+{
+	RsJsonByteStream os(out);
+	rapidjson::PrettyWriter<RsJsonByteStream> writer(os);
+	jDoc.Accept(writer);
+}
@@ -21,6 +21,8 @@
 #pragma once
 
 #include <iostream>
+#include <vector>
+#include <cstdint>
 
 #ifdef HAS_RAPIDJSON
 #	include <rapidjson/document.h>
@@ -54,3 +56,35 @@ std::ostream& compactJSON(std::ostream &out);
  * @return same output stream passed as out parameter
  */
 std::ostream& prettyJSON(std::ostream &out);
+
+/**
+ * rapidjson output stream which append to a bytes vector, permits to write
+ * JSON with a rapidjson Writer directly into a network buffer, without passing
+ * through std::stringstream and std::string copies
+ */
+struct RsJsonByteStream
+{
+	typedef char Ch;
+
+	explicit RsJsonByteStream(std::vector<uint8_t>& out) : mOut(out) {}
+
+	void Put(Ch c) { mOut.push_back(static_cast<uint8_t>(c)); }
+	void Flush() {}
+
+	std::vector<uint8_t>& mOut;
+};
+
+/**
+ * Write RsJson in compact format appending it to the given bytes vector
+ * @param[in] jDoc JSON document to write
+ * @param[out] out storage for the serialized JSON
+ */
+void rsJsonCompactWrite(const RsJson& jDoc, std::vector<uint8_t>& out);
+
+/**
+ * Write RsJson in pretty format, same as operator<< default, appending it to
+ * the given bytes vector
+ * @param[in] jDoc JSON document to write
+ * @param[out] out storage for the serialized JSON
+ */
+void rsJsonPrettyWrite(const RsJson& jDoc, std::vector<uint8_t>& out);
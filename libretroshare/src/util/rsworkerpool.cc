@@ -0,0 +1,149 @@
+/*******************************************************************************
+ * libretroshare/src/util: rsworkerpool.cc                                     *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "util/rsworkerpool.h"
+
+RsWorkerPool::RsWorkerPool(const std::string& name, uint32_t threads) :
+    mName(name), mThreadCount(threads ? threads : defaultThreadCount()),
+    mStopping(false) {}
+
+RsWorkerPool::~RsWorkerPool() { stop(); }
+
+/*static*/ uint32_t RsWorkerPool::defaultThreadCount()
+{
+	uint32_t n = std::thread::hardware_concurrency();
+	if(n < 1) n = 1;
+	if(n > 8) n = 8;
+	return n;
+}
+
+void RsWorkerPool::run(const std::function<void()>& job)
+{
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+
+		if(mStopping)
+		{
+			lock.unlock();
+			job();
+			return;
+		}
+
+		mJobs.push_back(job);
+
+		if(mWorkers.size() < mThreadCount && mWorkers.size() < mJobs.size())
+		{
+			mWorkers.push_back(std::unique_ptr<Worker>(new Worker(*this)));
+			mWorkers.back()->start(mName);
+		}
+	}
+	mCondition.notify_one();
+}
+
+void RsWorkerPool::runAndWait(const std::vector<std::function<void()> >& jobs)
+{
+	if(jobs.empty()) return;
+
+	struct Batch
+	{
+		std::mutex mtx;
+		std::condition_variable cv;
+		std::vector<std::function<void()> > jobs;
+		std::atomic<size_t> next;
+		size_t done;
+	};
+	std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+	batch->jobs = jobs;
+	batch->next = 0;
+	batch->done = 0;
+
+	/* Each helper picks jobs from the shared batch until it is exhausted, so
+	 * the caller does not wait on a job still sitting in the queue behind
+	 * unrelated work. */
+	auto worker = [batch]()
+	{
+		const size_t count = batch->jobs.size();
+		size_t i;
+		while((i = batch->next++) < count)
+		{
+			batch->jobs[i]();
+
+			std::lock_guard<std::mutex> lock(batch->mtx);
+			if(++batch->done == count) batch->cv.notify_all();
+		}
+	};
+
+	size_t helpers = std::min<size_t>(mThreadCount, jobs.size() - 1);
+	for(size_t i = 0; i < helpers; ++i) run(worker);
+
+	worker();
+
+	std::unique_lock<std::mutex> lock(batch->mtx);
+	batch->cv.wait(lock, [&]() { return batch->done == jobs.size(); });
+}
+
+void RsWorkerPool::stop()
+{
+	std::vector<std::unique_ptr<Worker> > workers;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+		workers.swap(mWorkers);
+	}
+	mCondition.notify_all();
+
+	for(auto& worker : workers) worker->fullstop();
+
+	/* Jobs the workers did not pick before stopping are run here, so the
+	 * queue is always drained */
+	std::deque<std::function<void()> > left;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		left.swap(mJobs);
+	}
+	for(auto& job : left) job();
+}
+
+bool RsWorkerPool::runNextJob()
+{
+	std::function<void()> job;
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mCondition.wait(lock, [this]() { return mStopping || !mJobs.empty(); });
+
+		if(mJobs.empty()) return false; // stopping and nothing left to do
+
+		job = std::move(mJobs.front());
+		mJobs.pop_front();
+	}
+	job();
+	return true;
+}
+
+void RsWorkerPool::Worker::data_tick()
+{
+	if(!mPool.runNextJob()) ask_for_stop();
+}
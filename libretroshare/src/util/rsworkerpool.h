@@ -0,0 +1,99 @@
+/*******************************************************************************
+ * libretroshare/src/util: rsworkerpool.h                                      *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "util/rsthreads.h"
+
+/**
+ * Fixed size pool of worker threads executing queued jobs.
+ * Workers are RsThread so they are named and stopped like any other
+ * RetroShare thread. They are spawned lazily when jobs are queued, so owning a
+ * pool that is never used costs nothing. Destroying the pool waits for all the
+ * queued jobs to complete.
+ */
+class RsWorkerPool
+{
+public:
+	/**
+	 * @param[in] name name given to the worker threads
+	 * @param[in] threads number of worker threads, 0 means
+	 *	defaultThreadCount()
+	 */
+	explicit RsWorkerPool(const std::string& name, uint32_t threads = 0);
+	~RsWorkerPool();
+
+	/// Queue a job for asynchronous execution
+	void run(const std::function<void()>& job);
+
+	/**
+	 * Run the given jobs in the pool and return once they are all done.
+	 * The calling thread executes jobs too, so this can be used even from a
+	 *	worker thread without risking a dead lock.
+	 */
+	void runAndWait(const std::vector<std::function<void()> >& jobs);
+
+	/// Wait for all queued jobs to complete and join the worker threads
+	void stop();
+
+	uint32_t threadCount() const { return mThreadCount; }
+
+	/// Number of hardware threads, clamped to [1, 8]
+	static uint32_t defaultThreadCount();
+
+private:
+	/// Worker thread, runs queued jobs until the pool is stopped
+	class Worker : public RsTickingThread
+	{
+	public:
+		explicit Worker(RsWorkerPool& pool) : mPool(pool) {}
+		virtual void data_tick();
+
+	private:
+		RsWorkerPool& mPool;
+	};
+
+	/**
+	 * Wait for a queued job and run it
+	 * @return false if the pool is stopping and there is no job left
+	 */
+	bool runNextJob();
+
+	const std::string mName;
+	uint32_t mThreadCount;
+	std::vector<std::unique_ptr<Worker> > mWorkers;
+	std::deque<std::function<void()> > mJobs;
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	bool mStopping;
+
+	RsWorkerPool(const RsWorkerPool&) = delete;
+	RsWorkerPool& operator=(const RsWorkerPool&) = delete;
+};
@@ -45,6 +45,7 @@ SOURCES =	FeedReaderPlugin.cpp \
 			gui/FeedReaderUserNotify.cpp \
 			gui/FeedReaderFeedItem.cpp \
 			util/CURLWrapper.cpp \
+			util/CURLMultiWrapper.cpp \
 			util/XMLWrapper.cpp \
 			util/HTMLWrapper.cpp \
 			util/XPathWrapper.cpp
@@ -65,6 +66,7 @@ HEADERS =	FeedReaderPlugin.h \
 			gui/FeedReaderUserNotify.h \
 			gui/FeedReaderFeedItem.h \
 			util/CURLWrapper.h \
+			util/CURLMultiWrapper.h \
 			util/XMLWrapper.h \
 			util/HTMLWrapper.h \
 			util/XPathWrapper.h
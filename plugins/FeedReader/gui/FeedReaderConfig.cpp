@@ -48,6 +48,7 @@ FeedReaderConfig::~FeedReaderConfig()
 void FeedReaderConfig::load()
 {
 	ui->updateIntervalSpinBox->setValue(rsFeedReader->getStandardUpdateInterval() / 60);
+	ui->concurrentDownloadsSpinBox->setValue(rsFeedReader->getMaxConcurrentDownloads());
 	ui->storageTimeSpinBox->setValue(rsFeedReader->getStandardStorageTime() / (60 * 60 *24));
 	ui->saveInBackgroundCheckBox->setChecked(rsFeedReader->getSaveInBackground());
 	ui->setMsgToReadOnActivate->setChecked(FeedReaderSetting_SetMsgToReadOnActivate());
@@ -65,6 +66,7 @@ void FeedReaderConfig::load()
 bool FeedReaderConfig::save(QString &/*errmsg*/)
 {
 	rsFeedReader->setStandardUpdateInterval(ui->updateIntervalSpinBox->value() * 60);
+	rsFeedReader->setMaxConcurrentDownloads(ui->concurrentDownloadsSpinBox->value());
 	rsFeedReader->setStandardStorageTime(ui->storageTimeSpinBox->value() * 60 *60 * 24);
 	rsFeedReader->setStandardProxy(ui->useProxyCheckBox->isChecked(), ui->proxyAddressLineEdit->text().toUtf8().constData(), ui->proxyPortSpinBox->value());
 	rsFeedReader->setSaveInBackground(ui->saveInBackgroundCheckBox->isChecked());
@@ -200,6 +200,8 @@ public:
 	virtual void     setStandardProxy(bool useProxy, const std::string &proxyAddress, uint16_t proxyPort) = 0;
 	virtual bool     getSaveInBackground() = 0;
 	virtual void     setSaveInBackground(bool saveInBackground) = 0;
+	virtual uint32_t getMaxConcurrentDownloads() = 0;
+	virtual void     setMaxConcurrentDownloads(uint32_t maxDownloads) = 0;
 
 	virtual RsFeedAddResult addFolder(const std::string parentId, const std::string &name, std::string &feedId) = 0;
 	virtual RsFeedAddResult setFolder(const std::string &feedId, const std::string &name) = 0;
@@ -37,6 +37,10 @@ RsFeedReader *rsFeedReader = NULL;
 
 #define MAX_REQUEST_AGE 30 // 30 seconds
 
+#define FEEDREADER_DEFAULT_CONCURRENT_DOWNLOADS 8
+#define FEEDREADER_MAX_CONCURRENT_DOWNLOADS     64
+#define FEEDREADER_PROCESS_THREADS              4 // messages of different feeds are processed in parallel
+
 /*********
  * #define FEEDREADER_DEBUG
  *********/
@@ -57,20 +61,23 @@ p3FeedReader::p3FeedReader(RsPluginHandler* pgHandler, RsGxsForums *forums)
 	mForums = forums;
 	mNotify = NULL;
 	mSaveInBackground = false;
+	mMaxConcurrentDownloads = FEEDREADER_DEFAULT_CONCURRENT_DOWNLOADS;
 	mStopped = false;
 
 	mPreviewDownloadThread = NULL;
 	mPreviewProcessThread = NULL;
 
-	/* start download thread */
+	/* start download thread, it runs up to mMaxConcurrentDownloads downloads at the same time */
 	p3FeedReaderThread *frt = new p3FeedReaderThread(this, p3FeedReaderThread::DOWNLOAD, "");
 	mThreads.push_back(frt);
 	frt->start("fr download");
 
-	/* start process thread */
-	frt = new p3FeedReaderThread(this, p3FeedReaderThread::PROCESS, "");
-	mThreads.push_back(frt);
-	frt->start("fr process");
+	/* start process threads */
+	for (int i = 0; i < FEEDREADER_PROCESS_THREADS; ++i) {
+		frt = new p3FeedReaderThread(this, p3FeedReaderThread::PROCESS, "");
+		mThreads.push_back(frt);
+		frt->start("fr process");
+	}
 }
 
 /***************************************************************************/
@@ -305,6 +312,29 @@ void p3FeedReader::setSaveInBackground(bool saveInBackground)
 	}
 }
 
+uint32_t p3FeedReader::getMaxConcurrentDownloads()
+{
+	RsStackMutex stack(mFeedReaderMtx); /******* LOCK STACK MUTEX *********/
+
+	return mMaxConcurrentDownloads;
+}
+
+void p3FeedReader::setMaxConcurrentDownloads(uint32_t maxDownloads)
+{
+	if (maxDownloads < 1) {
+		maxDownloads = 1;
+	} else if (maxDownloads > FEEDREADER_MAX_CONCURRENT_DOWNLOADS) {
+		maxDownloads = FEEDREADER_MAX_CONCURRENT_DOWNLOADS;
+	}
+
+	RsStackMutex stack(mFeedReaderMtx); /******* LOCK STACK MUTEX *********/
+
+	if (maxDownloads != mMaxConcurrentDownloads) {
+		mMaxConcurrentDownloads = maxDownloads;
+		IndicateConfigChanged();
+	}
+}
+
 void p3FeedReader::stop()
 {
 	mStopped = true;
@@ -526,6 +556,10 @@ RsFeedAddResult p3FeedReader::setFeed(const std::string &feedId, const FeedInfo
 
 		infoToFeed(feedInfo, fi);
 
+		/* the next download has to be processed with the new settings, even when the document didn't change */
+		fi->etag.clear();
+		fi->lastModified = 0;
+
 		if ((fi->flag & RS_FEED_FLAG_FORUM) && (fi->flag & RS_FEED_FLAG_UPDATE_FORUM_INFO) && !fi->forumId.empty() &&
 		    (fi->forumId != oldForumId || fi->name != oldName || fi->description != oldDescription)) {
 			/* name or description changed, update forum */
@@ -1252,6 +1286,10 @@ bool p3FeedReader::clearMessageCache(const std::string &feedId)
 
 		RsFeedReaderFeed *fi = feedIt->second;
 
+		/* download the document again on the next update to get back the removed messages */
+		fi->etag.clear();
+		fi->lastModified = 0;
+
 		std::map<std::string, RsFeedReaderMsg*>::iterator msgIt;
 		for (msgIt = fi->msgs.begin(); msgIt != fi->msgs.end(); ) {
 			RsFeedReaderMsg *mi = msgIt->second;
@@ -1461,6 +1499,10 @@ bool p3FeedReader::saveList(bool &cleanup, std::list<RsItem *> &saveData)
 	rs_sprintf(kv.value, "%hu", mSaveInBackground ? 1 : 0);
 	rskv->tlvkvs.pairs.push_back(kv);
 
+	kv.key = "MaxConcurrentDownloads";
+	rs_sprintf(kv.value, "%u", mMaxConcurrentDownloads);
+	rskv->tlvkvs.pairs.push_back(kv);
+
 	/* Add KeyValue to saveList */
 	saveData.push_back(rskv);
 	if (!cleanup) {
@@ -1584,6 +1626,11 @@ bool p3FeedReader::loadList(std::list<RsItem *>& load)
 					if (sscanf(kit->value.c_str(), "%hu", &value) == 1) {
 						mSaveInBackground = value == 1 ? true : false;
 					}
+				} else if (kit->key == "MaxConcurrentDownloads") {
+					uint32_t value;
+					if (sscanf(kit->value.c_str(), "%u", &value) == 1 && value >= 1 && value <= FEEDREADER_MAX_CONCURRENT_DOWNLOADS) {
+						mMaxConcurrentDownloads = value;
+					}
 				}
 			}
 		} else {
@@ -1689,7 +1736,7 @@ bool p3FeedReader::getFeedToDownload(RsFeedReaderFeed &feed, const std::string &
 	return true;
 }
 
-void p3FeedReader::onDownloadSuccess(const std::string &feedId, const std::string &content, std::string &icon)
+void p3FeedReader::onDownloadSuccess(const std::string &feedId, const std::string &content, std::string &icon, const std::string &etag, time_t lastModified)
 {
 	bool preview;
 
@@ -1709,6 +1756,8 @@ void p3FeedReader::onDownloadSuccess(const std::string &feedId, const std::strin
 		RsFeedReaderFeed *fi = it->second;
 		fi->workstate = RsFeedReaderFeed::WAITING_TO_PROCESS;
 		fi->content = content;
+		fi->contentEtag = etag;
+		fi->contentLastModified = lastModified;
 		preview = fi->preview;
 
 		if (fi->icon != icon) {
@@ -1738,6 +1787,44 @@ void p3FeedReader::onDownloadSuccess(const std::string &feedId, const std::strin
 	}
 }
 
+void p3FeedReader::onDownloadNotModified(const std::string &feedId)
+{
+	{
+		RsStackMutex stack(mFeedReaderMtx); /******* LOCK STACK MUTEX *********/
+
+		/* find feed */
+		std::map<std::string, RsFeedReaderFeed*>::iterator it = mFeeds.find(feedId);
+		if (it == mFeeds.end()) {
+			/* feed not found */
+#ifdef FEEDREADER_DEBUG
+			std::cerr << "p3FeedReader::onDownloadNotModified - feed " << feedId << " not found" << std::endl;
+#endif
+			return;
+		}
+
+		/* nothing new, the messages of the document are already processed */
+		RsFeedReaderFeed *fi = it->second;
+		fi->workstate = RsFeedReaderFeed::WAITING;
+		fi->lastUpdate = time(NULL);
+		fi->content.clear();
+
+		fi->errorState = RS_FEED_ERRORSTATE_OK;
+		fi->errorString.clear();
+
+#ifdef FEEDREADER_DEBUG
+		std::cerr << "p3FeedReader::onDownloadNotModified - feed " << fi->feedId << " (" << fi->name << ") not modified" << std::endl;
+#endif
+
+		if (!fi->preview) {
+			IndicateConfigChanged();
+		}
+	}
+
+	if (mNotify) {
+		mNotify->notifyFeedChanged(feedId, NOTIFY_TYPE_MOD);
+	}
+}
+
 void p3FeedReader::onDownloadError(const std::string &feedId, RsFeedReaderErrorState result, const std::string &errorString)
 {
 	{
@@ -1981,6 +2068,12 @@ void p3FeedReader::onProcessSuccess_addMsgs(const std::string &feedId, std::list
 			fi->content.clear();
 			fi->errorState = errorState;
 			fi->lastUpdate = time(NULL);
+
+			if (errorState == RS_FEED_ERRORSTATE_OK && !fi->preview) {
+				/* the document is processed, it doesn't need to be downloaded again while it is unchanged */
+				fi->etag = fi->contentEtag;
+				fi->lastModified = fi->contentLastModified;
+			}
 		}
 
 		if (!fi->preview) {
@@ -51,6 +51,8 @@ public:
 	virtual void     setStandardProxy(bool useProxy, const std::string &proxyAddress, uint16_t proxyPort);
 	virtual bool     getSaveInBackground();
 	virtual void     setSaveInBackground(bool saveInBackground);
+	virtual uint32_t getMaxConcurrentDownloads();
+	virtual void     setMaxConcurrentDownloads(uint32_t maxDownloads);
 
 	virtual RsFeedAddResult addFolder(const std::string parentId, const std::string &name, std::string &feedId);
 	virtual RsFeedAddResult setFolder(const std::string &feedId, const std::string &name);
@@ -80,7 +82,8 @@ public:
 
 	/****************** internal STUFF *******************/
 	bool getFeedToDownload(RsFeedReaderFeed &feed, const std::string &neededFeedId);
-	void onDownloadSuccess(const std::string &feedId, const std::string &content, std::string &icon);
+	void onDownloadSuccess(const std::string &feedId, const std::string &content, std::string &icon, const std::string &etag, time_t lastModified);
+	void onDownloadNotModified(const std::string &feedId);
 	void onDownloadError(const std::string &feedId, RsFeedReaderErrorState result, const std::string &errorString);
 	void onProcessSuccess_filterMsg(const std::string &feedId, std::list<RsFeedReaderMsg*> &msgs);
 	void onProcessSuccess_addMsgs(const std::string &feedId, std::list<RsFeedReaderMsg*> &msgs, bool single);
@@ -115,6 +118,7 @@ private:
 	RsMutex mFeedReaderMtx;
 	std::list<RsItem*> cleanSaveData;
 	bool mSaveInBackground;
+	uint32_t mMaxConcurrentDownloads;
 	std::list<p3FeedReaderThread*> mThreads;
 	uint32_t mNextFeedId;
 	uint32_t mNextMsgId;
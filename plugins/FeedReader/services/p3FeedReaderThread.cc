@@ -23,6 +23,7 @@
 #include "util/rsstring.h"
 #include "util/rstime.h"
 #include "util/CURLWrapper.h"
+#include "util/CURLMultiWrapper.h"
 #include "util/XMLWrapper.h"
 #include "util/HTMLWrapper.h"
 #include "util/XPathWrapper.h"
@@ -32,17 +33,46 @@
 
 enum FeedFormat { FORMAT_RSS, FORMAT_RDF, FORMAT_ATOM };
 
+#define FEEDREADER_MULTI_WAIT_MS 100 // wait for network activity of the running downloads
+
 /*********
  * #define FEEDREADER_DEBUG
  *********/
 
+/* a download of the concurrent download thread, the feed and then its favicon */
+class p3FeedReaderDownload
+{
+public:
+	p3FeedReaderDownload(const RsFeedReaderFeed &feed, const std::string &proxy)
+	    : mFeed(feed), mCURL(proxy), mIconStarted(false), mLastModified(0) {}
+
+	RsFeedReaderFeed mFeed;
+	CURLWrapper mCURL;
+	std::string mContent;
+	std::vector<unsigned char> mIcon;
+	bool mIconStarted;
+	std::string mEtag;
+	time_t mLastModified;
+};
+
 p3FeedReaderThread::p3FeedReaderThread(p3FeedReader *feedReader, Type type, const std::string &feedId) :
-    RsTickingThread(), mFeedReader(feedReader), mType(type), mFeedId(feedId)
+    RsTickingThread(), mFeedReader(feedReader), mType(type), mFeedId(feedId), mMulti(NULL)
 {
+	if (mType == DOWNLOAD && mFeedId.empty()) {
+		mMulti = new CURLMultiWrapper;
+	}
 }
 
 p3FeedReaderThread::~p3FeedReaderThread()
 {
+	std::list<p3FeedReaderDownload*>::iterator it;
+	for (it = mDownloads.begin(); it != mDownloads.end(); ++it) {
+		mMulti->remove(&(*it)->mCURL);
+		delete(*it);
+	}
+	mDownloads.clear();
+
+	delete(mMulti);
 }
 
 /***************************************************************************/
@@ -51,6 +81,11 @@ p3FeedReaderThread::~p3FeedReaderThread()
 
 void p3FeedReaderThread::data_tick()
 {
+		if (mMulti) {
+			downloadConcurrently();
+			return;
+		}
+
 		rstime::rs_usleep(1000000);
 
 		/* every second */
@@ -69,7 +104,7 @@ void p3FeedReaderThread::data_tick()
 						/* trim */
 						XMLWrapper::trimString(content);
 
-						mFeedReader->onDownloadSuccess(feed.feedId, content, icon);
+						mFeedReader->onDownloadSuccess(feed.feedId, content, icon, "", 0);
 					} else {
 						mFeedReader->onDownloadError(feed.feedId, result, errorString);
 					}
@@ -234,14 +269,12 @@ static std::string calculateLink(const std::string &baseLink, const std::string
 	return resultLink;
 }
 
-static bool getFavicon(CURLWrapper &CURL, const std::string &url, std::string &icon)
+static bool getFaviconResult(CURLWrapper &CURL, CURLcode code, const std::vector<unsigned char> &vicon, std::string &icon)
 {
 	icon.clear();
 
 	bool result = false;
 
-	std::vector<unsigned char> vicon;
-	CURLcode code = CURL.downloadBinary(calculateLink(url, "/favicon.ico"), vicon);
 	if (code == CURLE_OK) {
 		if (CURL.responseCode() == 200) {
 			std::string contentType = CURL.contentType();
@@ -259,25 +292,28 @@ static bool getFavicon(CURLWrapper &CURL, const std::string &url, std::string &i
 	return result;
 }
 
-RsFeedReaderErrorState p3FeedReaderThread::download(const RsFeedReaderFeed &feed, std::string &content, std::string &icon, std::string &errorString)
+static bool getFavicon(CURLWrapper &CURL, const std::string &url, std::string &icon)
 {
-#ifdef FEEDREADER_DEBUG
-	std::cerr << "p3FeedReaderThread::download - feed " << feed.feedId << " (" << feed.name << ")" << std::endl;
-#endif
+	std::vector<unsigned char> vicon;
+	CURLcode code = CURL.downloadBinary(calculateLink(url, "/favicon.ico"), vicon);
 
-	content.clear();
-	errorString.clear();
+	return getFaviconResult(CURL, code, vicon, icon);
+}
 
+static RsFeedReaderErrorState getDownloadResult(CURLWrapper &CURL, CURLcode code, bool &notModified, std::string &errorString)
+{
 	RsFeedReaderErrorState result;
-
-	std::string proxy = getProxyForFeed(feed);
-	CURLWrapper CURL(proxy);
-	CURLcode code = CURL.downloadText(feed.url, content);
+	notModified = false;
 
 	if (code == CURLE_OK) {
 		long responseCode = CURL.responseCode();
 
 		switch (responseCode) {
+		case 304:
+			/* answer to a conditional request, the document is unchanged */
+			notModified = true;
+			result = RS_FEED_ERRORSTATE_OK;
+			break;
 		case 200:
 			{
 				std::string contentType = CURL.contentType();
@@ -303,13 +339,34 @@ RsFeedReaderErrorState p3FeedReaderThread::download(const RsFeedReaderFeed &feed
 			result = RS_FEED_ERRORSTATE_DOWNLOAD_UNKOWN_RESPONSE_CODE;
 			rs_sprintf(errorString, "%ld", responseCode);
 		}
-
-		getFavicon(CURL, feed.url, icon);
 	} else {
 		result = RS_FEED_ERRORSTATE_DOWNLOAD_ERROR;
 		errorString = curl_easy_strerror(code);
 	}
 
+	return result;
+}
+
+RsFeedReaderErrorState p3FeedReaderThread::download(const RsFeedReaderFeed &feed, std::string &content, std::string &icon, std::string &errorString)
+{
+#ifdef FEEDREADER_DEBUG
+	std::cerr << "p3FeedReaderThread::download - feed " << feed.feedId << " (" << feed.name << ")" << std::endl;
+#endif
+
+	content.clear();
+	errorString.clear();
+
+	std::string proxy = getProxyForFeed(feed);
+	CURLWrapper CURL(proxy);
+	CURLcode code = CURL.downloadText(feed.url, content);
+
+	bool notModified;
+	RsFeedReaderErrorState result = getDownloadResult(CURL, code, notModified, errorString);
+
+	if (code == CURLE_OK) {
+		getFavicon(CURL, feed.url, icon);
+	}
+
 #ifdef FEEDREADER_DEBUG
 	std::cerr << "p3FeedReaderThread::download - feed " << feed.feedId << " (" << feed.name << "), result " << result << ", error = " << errorString << std::endl;
 #endif
@@ -317,6 +374,111 @@ RsFeedReaderErrorState p3FeedReaderThread::download(const RsFeedReaderFeed &feed
 	return result;
 }
 
+void p3FeedReaderThread::downloadConcurrently()
+{
+	/* fill the free download slots */
+	uint32_t maxDownloads = mFeedReader->getMaxConcurrentDownloads();
+	while (mDownloads.size() < maxDownloads && isRunning()) {
+		RsFeedReaderFeed feed;
+		if (!mFeedReader->getFeedToDownload(feed, "")) {
+			break;
+		}
+		startDownload(feed);
+	}
+
+	if (mDownloads.empty()) {
+		/* nothing to do, check again in a second */
+		rstime::rs_usleep(1000000);
+		return;
+	}
+
+	std::list<std::pair<CURLWrapper*, CURLcode> > finished;
+	mMulti->perform(FEEDREADER_MULTI_WAIT_MS, finished);
+
+	std::list<std::pair<CURLWrapper*, CURLcode> >::iterator finishedIt;
+	for (finishedIt = finished.begin(); finishedIt != finished.end(); ++finishedIt) {
+		std::list<p3FeedReaderDownload*>::iterator it;
+		for (it = mDownloads.begin(); it != mDownloads.end(); ++it) {
+			if (&(*it)->mCURL == finishedIt->first) {
+				break;
+			}
+		}
+		if (it == mDownloads.end()) {
+			continue;
+		}
+
+		/* the download is deleted when it is complete */
+		onTransferFinished(*it, finishedIt->second);
+	}
+}
+
+void p3FeedReaderThread::startDownload(const RsFeedReaderFeed &feed)
+{
+#ifdef FEEDREADER_DEBUG
+	std::cerr << "p3FeedReaderThread::startDownload - feed " << feed.feedId << " (" << feed.name << ")" << std::endl;
+#endif
+
+	p3FeedReaderDownload *download = new p3FeedReaderDownload(feed, getProxyForFeed(feed));
+
+	if (!download->mCURL.prepareText(feed.url, download->mContent, feed.etag, feed.lastModified) || !mMulti->add(&download->mCURL)) {
+		mFeedReader->onDownloadError(feed.feedId, RS_FEED_ERRORSTATE_DOWNLOAD_ERROR, curl_easy_strerror(CURLE_FAILED_INIT));
+		delete(download);
+		return;
+	}
+
+	mDownloads.push_back(download);
+}
+
+void p3FeedReaderThread::onTransferFinished(p3FeedReaderDownload *download, CURLcode code)
+{
+	const RsFeedReaderFeed &feed = download->mFeed;
+
+	if (!download->mIconStarted) {
+		/* the feed is downloaded */
+		std::string errorString;
+		bool notModified;
+		RsFeedReaderErrorState result = getDownloadResult(download->mCURL, code, notModified, errorString);
+
+#ifdef FEEDREADER_DEBUG
+		std::cerr << "p3FeedReaderThread::onTransferFinished - feed " << feed.feedId << " (" << feed.name << "), result " << result << ", not modified " << notModified << ", error = " << errorString << std::endl;
+#endif
+
+		if (result == RS_FEED_ERRORSTATE_OK && !notModified) {
+			download->mEtag = download->mCURL.etag();
+			download->mLastModified = download->mCURL.lastModified();
+
+			/* download the favicon with the same connection */
+			download->mIconStarted = true;
+			if (download->mCURL.prepareBinary(calculateLink(feed.url, "/favicon.ico"), download->mIcon) && mMulti->add(&download->mCURL)) {
+				return;
+			}
+			code = CURLE_FAILED_INIT;
+		} else {
+			if (notModified) {
+				mFeedReader->onDownloadNotModified(feed.feedId);
+			} else {
+				mFeedReader->onDownloadError(feed.feedId, result, errorString);
+			}
+
+			mDownloads.remove(download);
+			delete(download);
+			return;
+		}
+	}
+
+	/* the favicon is downloaded (or failed) */
+	std::string icon;
+	getFaviconResult(download->mCURL, code, download->mIcon, icon);
+
+	/* trim */
+	XMLWrapper::trimString(download->mContent);
+
+	mFeedReader->onDownloadSuccess(feed.feedId, download->mContent, icon, download->mEtag, download->mLastModified);
+
+	mDownloads.remove(download);
+	delete(download);
+}
+
 /***************************************************************************/
 /****************************** Process ************************************/
 /***************************************************************************/
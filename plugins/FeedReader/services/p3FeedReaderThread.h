@@ -25,12 +25,17 @@
 
 #include "util/rsthreads.h"
 #include <list>
+#include <vector>
+#include <curl/curl.h>
 
 class p3FeedReader;
 class RsFeedReaderFeed;
 class RsFeedReaderMsg;
 class HTMLWrapper;
 class RsFeedReaderXPath;
+class CURLWrapper;
+class CURLMultiWrapper;
+class p3FeedReaderDownload;
 
 class p3FeedReaderThread : public RsTickingThread
 {
@@ -58,6 +63,11 @@ private:
     virtual void data_tick();
 
 	RsFeedReaderErrorState download(const RsFeedReaderFeed &feed, std::string &content, std::string &icon, std::string &errorString);
+
+	/* concurrent downloads of the feeds, used when the thread isn't bound to a feed */
+	void downloadConcurrently();
+	void startDownload(const RsFeedReaderFeed &feed);
+	void onTransferFinished(p3FeedReaderDownload *download, CURLcode code);
 	RsFeedReaderErrorState process(const RsFeedReaderFeed &feed, std::list<RsFeedReaderMsg*> &entries, std::string &errorString);
 
 	std::string getProxyForFeed(const RsFeedReaderFeed &feed);
@@ -66,6 +76,9 @@ private:
 	p3FeedReader *mFeedReader;
 	Type mType;
 	std::string mFeedId;
+
+	CURLMultiWrapper *mMulti;
+	std::list<p3FeedReaderDownload*> mDownloads;
 };
 
 #endif 
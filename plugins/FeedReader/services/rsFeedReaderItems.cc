@@ -54,10 +54,14 @@ void RsFeedReaderFeed::clear()
 	xpathsToUse.ids.clear();
 	xpathsToRemove.ids.clear();
 	xslt.clear();
+	etag.clear();
+	lastModified = 0;
 
 	preview = false;
 	workstate = WAITING;
 	content.clear();
+	contentEtag.clear();
+	contentLastModified = 0;
 }
 
 std::ostream &RsFeedReaderFeed::print(std::ostream &out, uint16_t /*indent*/)
@@ -90,6 +94,8 @@ uint32_t RsFeedReaderSerialiser::sizeFeed(RsFeedReaderFeed *item)
 	s += item->xpathsToUse.TlvSize();
 	s += item->xpathsToRemove.TlvSize();
 	s += GetTlvStringSize(item->xslt);
+	s += GetTlvStringSize(item->etag);
+	s += sizeof(uint32_t); /* lastModified */
 
 	return s;
 }
@@ -113,7 +119,7 @@ bool RsFeedReaderSerialiser::serialiseFeed(RsFeedReaderFeed *item, void *data, u
 	offset += 8;
 
 	/* add values */
-	ok &= setRawUInt16(data, tlvsize, &offset, 1); /* version */
+	ok &= setRawUInt16(data, tlvsize, &offset, 2); /* version */
 	ok &= SetTlvString(data, tlvsize, &offset, TLV_TYPE_STR_GENID, item->feedId);
 	ok &= SetTlvString(data, tlvsize, &offset, TLV_TYPE_STR_VALUE, item->parentId);
 	ok &= SetTlvString(data, tlvsize, &offset, TLV_TYPE_STR_LINK, item->url);
@@ -135,6 +141,8 @@ bool RsFeedReaderSerialiser::serialiseFeed(RsFeedReaderFeed *item, void *data, u
 	ok &= item->xpathsToUse.SetTlv(data, tlvsize, &offset);
 	ok &= item->xpathsToRemove.SetTlv(data, tlvsize, &offset);
 	ok &= SetTlvString(data, tlvsize, &offset, TLV_TYPE_STR_VALUE, item->xslt);
+	ok &= SetTlvString(data, tlvsize, &offset, TLV_TYPE_STR_VALUE, item->etag);
+	ok &= setRawUInt32(data, tlvsize, &offset, item->lastModified);
 
 	if (offset != tlvsize)
 	{
@@ -210,6 +218,12 @@ RsFeedReaderFeed *RsFeedReaderSerialiser::deserialiseFeed(void *data, uint32_t *
 	if (version >= 1) {
 		ok &= GetTlvString(data, rssize, &offset, TLV_TYPE_STR_VALUE, item->xslt);
 	}
+	if (version >= 2) {
+		ok &= GetTlvString(data, rssize, &offset, TLV_TYPE_STR_VALUE, item->etag);
+		uint32_t value = 0;
+		ok &= getRawUInt32(data, rssize, &offset, &value);
+		item->lastModified = value;
+	}
 
 	if (version == 0)
 	{
@@ -87,10 +87,16 @@ public:
 	RsTlvStringSet           xpathsToRemove;
 	std::string              xslt;
 
+	/* validators of the last processed download, sent back for a conditional request */
+	std::string              etag;
+	time_t                   lastModified;
+
 	/* Not Serialised */
 	bool        preview;
 	WorkState   workstate;
 	std::string content;
+	std::string contentEtag;
+	time_t      contentLastModified;
 
 	std::map<std::string, RsFeedReaderMsg*> msgs;
 };
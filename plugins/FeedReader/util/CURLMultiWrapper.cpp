@@ -0,0 +1,106 @@
+/*******************************************************************************
+ * plugins/FeedReader/util/CURLMultiWrapper.cpp                                *
+ *                                                                             *
+ * Copyright (C) 2019 by Retroshare Team <retroshare.project@gmail.com>        *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Affero General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Affero General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include "CURLMultiWrapper.h"
+#include "CURLWrapper.h"
+
+CURLMultiWrapper::CURLMultiWrapper()
+{
+	mMulti = curl_multi_init();
+}
+
+CURLMultiWrapper::~CURLMultiWrapper()
+{
+	if (mMulti) {
+		std::map<CURL*, CURLWrapper*>::iterator it;
+		for (it = mTransfers.begin(); it != mTransfers.end(); ++it) {
+			curl_multi_remove_handle(mMulti, it->first);
+		}
+		curl_multi_cleanup(mMulti);
+	}
+}
+
+bool CURLMultiWrapper::add(CURLWrapper *curl)
+{
+	if (!mMulti || !curl || !curl->mCurl) {
+		return false;
+	}
+
+	if (curl_multi_add_handle(mMulti, curl->mCurl) != CURLM_OK) {
+		return false;
+	}
+
+	mTransfers[curl->mCurl] = curl;
+
+	return true;
+}
+
+void CURLMultiWrapper::remove(CURLWrapper *curl)
+{
+	if (!mMulti || !curl) {
+		return;
+	}
+
+	std::map<CURL*, CURLWrapper*>::iterator it = mTransfers.find(curl->mCurl);
+	if (it == mTransfers.end()) {
+		return;
+	}
+
+	curl_multi_remove_handle(mMulti, it->first);
+	mTransfers.erase(it);
+}
+
+void CURLMultiWrapper::perform(int timeoutMs, std::list<std::pair<CURLWrapper*, CURLcode> > &finished)
+{
+	finished.clear();
+
+	if (!mMulti || mTransfers.empty()) {
+		return;
+	}
+
+	int running = 0;
+	curl_multi_perform(mMulti, &running);
+
+	if (running) {
+		curl_multi_wait(mMulti, NULL, 0, timeoutMs, NULL);
+		curl_multi_perform(mMulti, &running);
+	}
+
+	CURLMsg *msg;
+	int queued = 0;
+	while ((msg = curl_multi_info_read(mMulti, &queued)) != NULL) {
+		if (msg->msg != CURLMSG_DONE) {
+			continue;
+		}
+
+		std::map<CURL*, CURLWrapper*>::iterator it = mTransfers.find(msg->easy_handle);
+		if (it == mTransfers.end()) {
+			continue;
+		}
+
+		/* remove the handle first, so that it can be prepared and added again by the caller */
+		CURLcode result = msg->data.result;
+		CURLWrapper *curl = it->second;
+		curl_multi_remove_handle(mMulti, it->first);
+		mTransfers.erase(it);
+
+		finished.push_back(std::make_pair(curl, result));
+	}
+}
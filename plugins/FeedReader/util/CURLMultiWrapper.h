@@ -0,0 +1,50 @@
+/*******************************************************************************
+ * plugins/FeedReader/util/CURLMultiWrapper.h                                  *
+ *                                                                             *
+ * Copyright (C) 2019 by Retroshare Team <retroshare.project@gmail.com>        *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Affero General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Affero General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#ifndef CURLMULTIWRAPPER
+#define CURLMULTIWRAPPER
+
+#include <list>
+#include <map>
+#include <curl/curl.h>
+
+class CURLWrapper;
+
+/* Runs the downloads prepared in several CURLWrapper at the same time */
+class CURLMultiWrapper
+{
+public:
+	CURLMultiWrapper();
+	~CURLMultiWrapper();
+
+	/* start the download prepared in curl, curl must stay valid until it is finished or removed */
+	bool add(CURLWrapper *curl);
+	void remove(CURLWrapper *curl);
+	size_t count() { return mTransfers.size(); }
+
+	/* run the transfers, wait at most timeoutMs for network activity and return the finished transfers */
+	void perform(int timeoutMs, std::list<std::pair<CURLWrapper*, CURLcode> > &finished);
+
+private:
+	CURLM *mMulti;
+	std::map<CURL*, CURLWrapper*> mTransfers;
+};
+
+#endif 
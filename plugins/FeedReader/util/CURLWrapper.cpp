@@ -23,6 +23,7 @@
 
 CURLWrapper::CURLWrapper(const std::string &proxy)
 {
+	mHeaders = NULL;
 	mCurl = curl_easy_init();
 	if (mCurl) {
 		curl_easy_setopt(mCurl, CURLOPT_NOPROGRESS, 0);
@@ -31,6 +32,9 @@ CURLWrapper::CURLWrapper(const std::string &proxy)
 		curl_easy_setopt(mCurl, CURLOPT_FOLLOWLOCATION, 1);
 		curl_easy_setopt(mCurl, CURLOPT_CONNECTTIMEOUT, 60);
 		curl_easy_setopt(mCurl, CURLOPT_TIMEOUT, 120);
+		curl_easy_setopt(mCurl, CURLOPT_FILETIME, 1);
+		curl_easy_setopt(mCurl, CURLOPT_HEADERFUNCTION, headerFunction);
+		curl_easy_setopt(mCurl, CURLOPT_HEADERDATA, this);
 
 		if (!proxy.empty()) {
 			curl_easy_setopt(mCurl, CURLOPT_PROXY, proxy.c_str());
@@ -43,6 +47,50 @@ CURLWrapper::~CURLWrapper()
 	if (mCurl) {
 		curl_easy_cleanup(mCurl);
 	}
+	if (mHeaders) {
+		curl_slist_free_all(mHeaders);
+	}
+}
+
+size_t CURLWrapper::headerFunction(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+	CURLWrapper *wrapper = (CURLWrapper*) userdata;
+	std::string header(ptr, size * nmemb);
+
+	if (strncasecmp(header.c_str(), "HTTP/", 5) == 0) {
+		/* status line of a new response (redirect), forget the previous headers */
+		wrapper->mEtag.clear();
+	} else if (strncasecmp(header.c_str(), "ETag:", 5) == 0) {
+		std::string::size_type start = header.find_first_not_of(" \t", 5);
+		std::string::size_type end = header.find_last_not_of(" \t\r\n");
+		if (start != std::string::npos && end != std::string::npos && end >= start) {
+			wrapper->mEtag = header.substr(start, end - start + 1);
+		}
+	}
+
+	return size * nmemb;
+}
+
+void CURLWrapper::setConditions(const std::string &ifNoneMatch, time_t ifModifiedSince)
+{
+	if (mHeaders) {
+		curl_slist_free_all(mHeaders);
+		mHeaders = NULL;
+	}
+	if (!ifNoneMatch.empty()) {
+		mHeaders = curl_slist_append(mHeaders, ("If-None-Match: " + ifNoneMatch).c_str());
+	}
+	curl_easy_setopt(mCurl, CURLOPT_HTTPHEADER, mHeaders);
+
+	if (ifModifiedSince) {
+		curl_easy_setopt(mCurl, CURLOPT_TIMECONDITION, (long) CURL_TIMECOND_IFMODSINCE);
+		curl_easy_setopt(mCurl, CURLOPT_TIMEVALUE, (long) ifModifiedSince);
+	} else {
+		curl_easy_setopt(mCurl, CURLOPT_TIMECONDITION, (long) CURL_TIMECOND_NONE);
+		curl_easy_setopt(mCurl, CURLOPT_TIMEVALUE, 0L);
+	}
+
+	mEtag.clear();
 }
 
 static size_t writeFunctionString (void *ptr, size_t size, size_t nmemb, void *stream)
@@ -53,19 +101,30 @@ static size_t writeFunctionString (void *ptr, size_t size, size_t nmemb, void *s
 	return nmemb * size;
 }
 
-CURLcode CURLWrapper::downloadText(const std::string &link, std::string &data)
+bool CURLWrapper::prepareText(const std::string &link, std::string &data, const std::string &ifNoneMatch, time_t ifModifiedSince)
 {
 	data.clear();
 
 	if (!mCurl) {
-		return CURLE_FAILED_INIT;
+		return false;
 	}
 
+	setConditions(ifNoneMatch, ifModifiedSince);
+
 	curl_easy_setopt(mCurl, CURLOPT_URL, link.c_str());
 	curl_easy_setopt(mCurl, CURLOPT_WRITEFUNCTION, writeFunctionString);
 	curl_easy_setopt(mCurl, CURLOPT_WRITEDATA, &data);
 	curl_easy_setopt(mCurl, CURLOPT_SSL_VERIFYPEER, false);
 
+	return true;
+}
+
+CURLcode CURLWrapper::downloadText(const std::string &link, std::string &data, const std::string &ifNoneMatch, time_t ifModifiedSince)
+{
+	if (!prepareText(link, data, ifNoneMatch, ifModifiedSince)) {
+		return CURLE_FAILED_INIT;
+	}
+
 	return curl_easy_perform(mCurl);
 }
 
@@ -73,31 +132,45 @@ static size_t writeFunctionBinary (void *ptr, size_t size, size_t nmemb, void *s
 {
 	std::vector<unsigned char> *bytes = (std::vector<unsigned char>*) stream;
 
-	std::vector<unsigned char> newBytes;
-	newBytes.resize(size * nmemb);
-	memcpy(newBytes.data(), ptr, newBytes.size());
-
-	bytes->insert(bytes->end(), newBytes.begin(), newBytes.end());
+	bytes->insert(bytes->end(), (unsigned char*) ptr, (unsigned char*) ptr + size * nmemb);
 
 	return nmemb * size;
 }
 
-CURLcode CURLWrapper::downloadBinary(const std::string &link, std::vector<unsigned char> &data)
+bool CURLWrapper::prepareBinary(const std::string &link, std::vector<unsigned char> &data)
 {
 	data.clear();
 
 	if (!mCurl) {
-		return CURLE_FAILED_INIT;
+		return false;
 	}
 
+	setConditions("", 0);
+
 	curl_easy_setopt(mCurl, CURLOPT_NOPROGRESS, 1);
 	curl_easy_setopt(mCurl, CURLOPT_URL, link.c_str());
 	curl_easy_setopt(mCurl, CURLOPT_WRITEFUNCTION, writeFunctionBinary);
 	curl_easy_setopt(mCurl, CURLOPT_WRITEDATA, &data);
 
+	return true;
+}
+
+CURLcode CURLWrapper::downloadBinary(const std::string &link, std::vector<unsigned char> &data)
+{
+	if (!prepareBinary(link, data)) {
+		return CURLE_FAILED_INIT;
+	}
+
 	return curl_easy_perform(mCurl);
 }
 
+time_t CURLWrapper::lastModified()
+{
+	long value = longInfo(CURLINFO_FILETIME);
+
+	return value > 0 ? value : 0;
+}
+
 long CURLWrapper::longInfo(CURLINFO info)
 {
 	if (!mCurl) {
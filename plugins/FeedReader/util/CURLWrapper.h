@@ -23,27 +23,44 @@
 
 #include <string>
 #include <vector>
+#include <time.h>
 #include <curl/curl.h>
 
 class CURLWrapper
 {
+	friend class CURLMultiWrapper;
+
 public:
 	CURLWrapper(const std::string &proxy);
 	~CURLWrapper();
 
-	CURLcode downloadText(const std::string &link, std::string &data);
+	/* ifNoneMatch and ifModifiedSince make a conditional request, the server answers 304 when the document is unchanged */
+	CURLcode downloadText(const std::string &link, std::string &data, const std::string &ifNoneMatch = "", time_t ifModifiedSince = 0);
 	CURLcode downloadBinary(const std::string &link, std::vector<unsigned char> &data);
 
+	/* set up a download without performing it, used with CURLMultiWrapper */
+	bool prepareText(const std::string &link, std::string &data, const std::string &ifNoneMatch = "", time_t ifModifiedSince = 0);
+	bool prepareBinary(const std::string &link, std::vector<unsigned char> &data);
+
 	long responseCode() { return longInfo(CURLINFO_RESPONSE_CODE); }
 	std::string contentType() { return stringInfo(CURLINFO_CONTENT_TYPE); }
 	std::string effectiveUrl() { return stringInfo(CURLINFO_EFFECTIVE_URL); }
 
+	/* validators of the last response, empty or 0 when the server didn't send them */
+	std::string etag() { return mEtag; }
+	time_t lastModified();
+
 protected:
 	long longInfo(CURLINFO info);
 	std::string stringInfo(CURLINFO info);
 
 private:
+	void setConditions(const std::string &ifNoneMatch, time_t ifModifiedSince);
+	static size_t headerFunction(char *ptr, size_t size, size_t nmemb, void *userdata);
+
 	CURL *mCurl;
+	struct curl_slist *mHeaders;
+	std::string mEtag;
 };
 
 #endif 
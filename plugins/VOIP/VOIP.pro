@@ -157,6 +157,8 @@ SOURCES = VOIPPlugin.cpp               \
           gui/SpeexProcessor.cpp       \
           gui/audiodevicehelper.cpp    \
           gui/VideoProcessor.cpp       \
+          gui/JPEGVideo.cpp            \
+          gui/VideoFrameDiff.cpp       \
           gui/QVideoDevice.cpp         \
           gui/VOIPChatWidgetHolder.cpp \
           gui/VOIPGUIHandler.cpp       \
@@ -173,6 +175,7 @@ HEADERS = VOIPPlugin.h                 \
           gui/SpeexProcessor.h         \
           gui/audiodevicehelper.h      \
           gui/VideoProcessor.h         \
+          gui/VideoFrameDiff.h         \
           gui/QVideoDevice.h           \
           gui/VOIPChatWidgetHolder.h   \
           gui/VOIPGUIHandler.h         \
@@ -0,0 +1,169 @@
+/*******************************************************************************
+ * plugins/VOIP/bench/VideoCodecBench.cpp                                      *
+ *                                                                             *
+ * Copyright (C) 2019 by Retroshare Team <retroshare.project@gmail.com>        *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Affero General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Affero General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+// Encodes and decodes synthetic 640x480 frames with the JPEG video codec,
+// and measures the frame differencing kernels against the scalar version.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QImage>
+
+#include "gui/VideoProcessor.h"
+#include "gui/VideoFrameDiff.h"
+
+static const int FRAME_WIDTH  = 640 ;
+static const int FRAME_HEIGHT = 480 ;
+
+typedef std::chrono::steady_clock Clock ;
+
+static double elapsedMs(const Clock::time_point& start)
+{
+    return std::chrono::duration<double,std::milli>(Clock::now() - start).count() ;
+}
+
+// A gradient scrolling with time, a moving square and some sensor noise,
+// in the RGB888 format produced by the camera capture.
+static QImage syntheticFrame(int n)
+{
+    QImage img(FRAME_WIDTH,FRAME_HEIGHT,QImage::Format_RGB888) ;
+
+    int sx = (n*7) % (FRAME_WIDTH - 64) ;
+    int sy = (n*3) % (FRAME_HEIGHT - 64) ;
+
+    for(int y=0;y<FRAME_HEIGHT;++y)
+    {
+        uchar *line = img.scanLine(y) ;
+
+        for(int x=0;x<FRAME_WIDTH;++x)
+        {
+            bool in_square = x >= sx && x < sx+64 && y >= sy && y < sy+64 ;
+            int noise = rand() % 5 ;
+
+            line[3*x+0] = in_square ? 230 : (uchar)((x + n) / 3 + noise) ;
+            line[3*x+1] = in_square ?  40 : (uchar)((y + 2*n) / 2 + noise) ;
+            line[3*x+2] = in_square ?  40 : (uchar)((x + y) / 5 + noise) ;
+        }
+    }
+    return img ;
+}
+
+static void benchKernels(int nb_frames)
+{
+    size_t size = FRAME_WIDTH * FRAME_HEIGHT * 4 ;
+    std::vector<uint8_t> frame(size),ref(size),diff(size),out(size) ;
+
+    for(size_t i=0;i<size;++i)
+    {
+        frame[i] = rand() ;
+        ref[i] = rand() ;
+    }
+
+    Clock::time_point start = Clock::now() ;
+    for(int i=0;i<nb_frames;++i)
+    {
+        VideoFrameDiff::computeDiffScalar(frame.data(),ref.data(),diff.data(),size) ;
+        VideoFrameDiff::applyDiffScalar(ref.data(),diff.data(),out.data(),size) ;
+    }
+    double scalar_ms = elapsedMs(start) ;
+
+    start = Clock::now() ;
+    for(int i=0;i<nb_frames;++i)
+    {
+        VideoFrameDiff::computeDiff(frame.data(),ref.data(),diff.data(),size) ;
+        VideoFrameDiff::applyDiff(ref.data(),diff.data(),out.data(),size) ;
+    }
+    double simd_ms = elapsedMs(start) ;
+
+    std::vector<uint8_t> check(size) ;
+    VideoFrameDiff::computeDiffScalar(frame.data(),ref.data(),check.data(),size) ;
+    bool same = !memcmp(check.data(),diff.data(),size) ;
+
+    std::cout << "Frame diff + apply, " << FRAME_WIDTH << "x" << FRAME_HEIGHT << " RGB32:" << std::endl;
+    std::cout << "  scalar : " << scalar_ms / nb_frames << " ms/frame" << std::endl;
+    std::cout << "  " << VideoFrameDiff::kernelName() << "   : " << simd_ms / nb_frames << " ms/frame"
+              << (same ? "" : "  (MISMATCH with scalar!)") << std::endl;
+}
+
+static void benchCodec(int nb_frames)
+{
+    std::vector<QImage> frames ;
+    for(int i=0;i<nb_frames;++i)
+        frames.push_back(syntheticFrame(i)) ;
+
+    JPEGVideo encoder, decoder ;
+    VideoCodec& enc(encoder) ;
+    VideoCodec& dec(decoder) ;
+
+    double encode_ms = 0, decode_ms = 0 ;
+    uint64_t total_size = 0 ;
+    int decoded = 0 ;
+
+    for(int i=0;i<nb_frames;++i)
+    {
+        RsVOIPDataChunk chunk ;
+
+        Clock::time_point start = Clock::now() ;
+        if(!enc.encodeData(frames[i],0,chunk))
+        {
+            std::cerr << "Encoding failed at frame " << i << std::endl;
+            return ;
+        }
+        encode_ms += elapsedMs(start) ;
+        total_size += chunk.size ;
+
+        QImage img ;
+        start = Clock::now() ;
+        if(dec.decodeData(chunk,img))
+            ++decoded ;
+        decode_ms += elapsedMs(start) ;
+
+        free(chunk.data) ;
+    }
+
+    std::cout << "JPEG video codec, " << nb_frames << " frames:" << std::endl;
+    std::cout << "  encode : " << encode_ms / nb_frames << " ms/frame" << std::endl;
+    std::cout << "  decode : " << decode_ms / nb_frames << " ms/frame (" << decoded << " frames decoded)" << std::endl;
+    std::cout << "  size   : " << total_size / nb_frames << " bytes/frame" << std::endl;
+}
+
+int main(int argc,char *argv[])
+{
+    // needed to load the JPEG image format plugin
+    QCoreApplication app(argc,argv) ;
+
+    int nb_frames = argc > 1 ? atoi(argv[1]) : 250 ;
+
+    if(nb_frames <= 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " [nb_frames]" << std::endl;
+        return 1 ;
+    }
+
+    benchKernels(nb_frames) ;
+    benchCodec(nb_frames) ;
+
+    return 0 ;
+}
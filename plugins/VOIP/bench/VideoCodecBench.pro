@@ -0,0 +1,46 @@
+################################################################################
+# VideoCodecBench.pro                                                          #
+# Copyright (C) 2019 by Retroshare Team <retroshare.project@gmail.com>         #
+#                                                                              #
+# This program is free software: you can redistribute it and/or modify         #
+# it under the terms of the GNU Affero General Public License as               #
+# published by the Free Software Foundation, either version 3 of the           #
+# License, or (at your option) any later version.                              #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU Lesser General Public License for more details.                          #
+#                                                                              #
+# You should have received a copy of the GNU Lesser General Public License     #
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.       #
+################################################################################
+
+# Headless benchmark of the JPEG video codec over synthetic frames. It is not
+# part of the plugin build:
+#
+#   qmake VideoCodecBench.pro && make && ./VideoCodecBench [nb_frames]
+
+TEMPLATE = app
+TARGET = VideoCodecBench
+CONFIG += console
+CONFIG -= app_bundle
+QT -= widgets
+
+INCLUDEPATH += .. ../gui ../../../libretroshare/src ../../../rapidjson-1.1.0
+
+# ffmpeg headers are pulled by VideoProcessor.h
+QMAKE_CXXFLAGS += -D__STDC_CONSTANT_MACROS
+
+linux-* {
+	CONFIG += link_pkgconfig
+	PKGCONFIG += libavcodec
+}
+
+SOURCES = VideoCodecBench.cpp                        \
+          ../gui/JPEGVideo.cpp                       \
+          ../gui/VideoFrameDiff.cpp                  \
+          ../../../libretroshare/src/util/rsmemory.cc
+
+HEADERS = ../gui/VideoProcessor.h                    \
+          ../gui/VideoFrameDiff.h
@@ -0,0 +1,136 @@
+/*******************************************************************************
+ * plugins/VOIP/gui/JPEGVideo.cpp                                              *
+ *                                                                             *
+ * Copyright (C) 2012 by Retroshare Team <retroshare.project@gmail.com>        *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Affero General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Affero General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <iostream>
+#include <assert.h>
+#include <string.h>
+
+#include <QBuffer>
+#include <QImage>
+
+#include "util/rsmemory.h"
+
+#include "VideoProcessor.h"
+#include "VideoFrameDiff.h"
+
+// Enough for a 640x480 frame at the default JPEG quality, so that the output buffer is not reallocated for each frame.
+static const int JPEG_VIDEO_OUTPUT_BUFFER_INITIAL_SIZE = 128*1024 ;
+
+JPEGVideo::JPEGVideo()
+    : _encoded_ref_frame_max_distance(10),_encoded_ref_frame_count(10)
+{
+    _encoded_jpeg_data.reserve(JPEG_VIDEO_OUTPUT_BUFFER_INITIAL_SIZE) ;
+}
+
+bool JPEGVideo::decodeData(const RsVOIPDataChunk& chunk,QImage& image)
+{
+    // now see if the frame is a differential frame, or just a reference frame.
+
+    uint16_t codec = ((unsigned char *)chunk.data)[0] + (((unsigned char *)chunk.data)[1] << 8) ;
+    uint16_t flags = ((unsigned char *)chunk.data)[2] + (((unsigned char *)chunk.data)[3] << 8) ;
+
+    assert(codec == VideoProcessor::VIDEO_PROCESSOR_CODEC_ID_JPEG_VIDEO) ;
+
+    //  un-compress image data, straight from the chunk
+
+    if(!image.loadFromData(&((uchar*)chunk.data)[HEADER_SIZE],(int)chunk.size - HEADER_SIZE,"JPEG"))
+    {
+	    std::cerr << "image.loadFromData(): returned an error.: " << std::endl;
+	    return false ;
+    }
+
+    if(flags & JPEG_VIDEO_FLAGS_DIFFERENTIAL_FRAME)
+    {
+	    if(_decoded_reference_frame.size() != image.size() || _decoded_reference_frame.format() != image.format())
+	    {
+		    std::cerr << "Bad reference frame!" << std::endl;
+		    return false ;
+	    }
+
+	    // The decoded image is not shared yet, so the difference is applied in place.
+
+	    uchar *data = image.bits() ;
+	    VideoFrameDiff::applyDiff(_decoded_reference_frame.constBits(),data,data,image.byteCount()) ;
+    }
+    else
+        _decoded_reference_frame = image ;
+
+    return true ;
+}
+
+bool JPEGVideo::encodeData(const QImage& image,uint32_t /* size_hint */,RsVOIPDataChunk& voip_chunk)
+{
+    // check if we make a diff image, or if we use the full frame.
+
+    const QImage *encoded_frame ;
+    bool differential_frame ;
+
+    if (_encoded_ref_frame_count++ < _encoded_ref_frame_max_distance
+        && image.size() == _encoded_reference_frame.size()
+        && image.format() == _encoded_reference_frame.format()
+        && image.byteCount() == _encoded_reference_frame.byteCount())
+	{
+	    // compute difference with reference frame, into a buffer that is kept from one frame to the next.
+
+	    if(_encoded_diff_frame.size() != image.size() || _encoded_diff_frame.format() != image.format())
+		    _encoded_diff_frame = QImage(image.size(),image.format()) ;
+
+	    VideoFrameDiff::computeDiff(image.constBits(),_encoded_reference_frame.constBits(),_encoded_diff_frame.bits(),image.byteCount()) ;
+
+	    encoded_frame = &_encoded_diff_frame ;
+	    differential_frame = true ;
+    }
+    else
+    {
+	    _encoded_ref_frame_count = 0 ;
+	    _encoded_reference_frame = image.copy() ;
+	    encoded_frame = &image ;
+
+	    differential_frame = false ;
+    }
+
+    // resize(0) keeps the reserved capacity
+
+    _encoded_jpeg_data.resize(0) ;
+
+    QBuffer buffer(&_encoded_jpeg_data) ;
+    buffer.open(QIODevice::WriteOnly) ;
+    encoded_frame->save(&buffer,"JPEG") ;
+
+    voip_chunk.data = rs_malloc(HEADER_SIZE + _encoded_jpeg_data.size());
+    
+    if(!voip_chunk.data)
+        return false ;
+
+    // build header
+    uint32_t flags = differential_frame ? JPEG_VIDEO_FLAGS_DIFFERENTIAL_FRAME : 0x0 ;
+
+    ((unsigned char *)voip_chunk.data)[0] =  VideoProcessor::VIDEO_PROCESSOR_CODEC_ID_JPEG_VIDEO       & 0xff ;
+    ((unsigned char *)voip_chunk.data)[1] = (VideoProcessor::VIDEO_PROCESSOR_CODEC_ID_JPEG_VIDEO >> 8) & 0xff ;
+    ((unsigned char *)voip_chunk.data)[2] = flags & 0xff ;
+    ((unsigned char *)voip_chunk.data)[3] = (flags >> 8) & 0xff ;
+
+    memcpy(&((unsigned char*)voip_chunk.data)[HEADER_SIZE],_encoded_jpeg_data.constData(),_encoded_jpeg_data.size()) ;
+
+    voip_chunk.size = HEADER_SIZE + _encoded_jpeg_data.size() ;
+    voip_chunk.type = RsVOIPDataChunk::RS_VOIP_DATA_TYPE_VIDEO ;
+
+    return true ;
+}
@@ -0,0 +1,177 @@
+/*******************************************************************************
+ * plugins/VOIP/gui/VideoFrameDiff.cpp                                         *
+ *                                                                             *
+ * Copyright (C) 2019 by Retroshare Team <retroshare.project@gmail.com>        *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Affero General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Affero General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include "VideoFrameDiff.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define VOIP_FRAME_DIFF_SSE2
+#	include <emmintrin.h>
+#endif
+
+// AVX2 is selected at runtime, so that the plugin still runs on older CPUs
+#if defined(VOIP_FRAME_DIFF_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#	define VOIP_FRAME_DIFF_AVX2
+#	include <immintrin.h>
+#endif
+
+namespace VideoFrameDiff
+{
+
+static inline uint8_t clampByte(int v) { return v < 0 ? 0 : (v > 255 ? 255 : v) ; }
+
+void computeDiffScalar(const uint8_t *frame, const uint8_t *ref, uint8_t *diff, size_t size)
+{
+	for(size_t i=0;i<size;++i)
+		diff[i] = clampByte((int)frame[i] - (int)ref[i] + 128) ;
+}
+
+void applyDiffScalar(const uint8_t *ref, const uint8_t *diff, uint8_t *frame, size_t size)
+{
+	for(size_t i=0;i<size;++i)
+		frame[i] = clampByte((int)ref[i] + (int)diff[i] - 128) ;
+}
+
+// Both kernels only use unsigned saturating arithmetic: of the two
+// saturated differences a-b and b-a, at most one is non zero.
+//
+//   diff  = (128 +sat (frame -sat ref)) -sat (ref -sat frame)
+//   frame = (ref +sat (diff -sat 128)) -sat (128 -sat diff)
+
+#ifdef VOIP_FRAME_DIFF_SSE2
+static size_t computeDiffSSE2(const uint8_t *frame, const uint8_t *ref, uint8_t *diff, size_t size)
+{
+	const __m128i offset = _mm_set1_epi8((char)128) ;
+	size_t i = 0 ;
+
+	for(;i+16<=size;i+=16)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(frame+i)) ;
+		__m128i b = _mm_loadu_si128((const __m128i*)(ref+i)) ;
+		__m128i r = _mm_subs_epu8(_mm_adds_epu8(offset,_mm_subs_epu8(a,b)),_mm_subs_epu8(b,a)) ;
+		_mm_storeu_si128((__m128i*)(diff+i),r) ;
+	}
+	return i ;
+}
+
+static size_t applyDiffSSE2(const uint8_t *ref, const uint8_t *diff, uint8_t *frame, size_t size)
+{
+	const __m128i offset = _mm_set1_epi8((char)128) ;
+	size_t i = 0 ;
+
+	for(;i+16<=size;i+=16)
+	{
+		__m128i r = _mm_loadu_si128((const __m128i*)(ref+i)) ;
+		__m128i d = _mm_loadu_si128((const __m128i*)(diff+i)) ;
+		__m128i f = _mm_subs_epu8(_mm_adds_epu8(r,_mm_subs_epu8(d,offset)),_mm_subs_epu8(offset,d)) ;
+		_mm_storeu_si128((__m128i*)(frame+i),f) ;
+	}
+	return i ;
+}
+#endif
+
+#ifdef VOIP_FRAME_DIFF_AVX2
+__attribute__((target("avx2")))
+static size_t computeDiffAVX2(const uint8_t *frame, const uint8_t *ref, uint8_t *diff, size_t size)
+{
+	const __m256i offset = _mm256_set1_epi8((char)128) ;
+	size_t i = 0 ;
+
+	for(;i+32<=size;i+=32)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*)(frame+i)) ;
+		__m256i b = _mm256_loadu_si256((const __m256i*)(ref+i)) ;
+		__m256i r = _mm256_subs_epu8(_mm256_adds_epu8(offset,_mm256_subs_epu8(a,b)),_mm256_subs_epu8(b,a)) ;
+		_mm256_storeu_si256((__m256i*)(diff+i),r) ;
+	}
+	return i ;
+}
+
+__attribute__((target("avx2")))
+static size_t applyDiffAVX2(const uint8_t *ref, const uint8_t *diff, uint8_t *frame, size_t size)
+{
+	const __m256i offset = _mm256_set1_epi8((char)128) ;
+	size_t i = 0 ;
+
+	for(;i+32<=size;i+=32)
+	{
+		__m256i r = _mm256_loadu_si256((const __m256i*)(ref+i)) ;
+		__m256i d = _mm256_loadu_si256((const __m256i*)(diff+i)) ;
+		__m256i f = _mm256_subs_epu8(_mm256_adds_epu8(r,_mm256_subs_epu8(d,offset)),_mm256_subs_epu8(offset,d)) ;
+		_mm256_storeu_si256((__m256i*)(frame+i),f) ;
+	}
+	return i ;
+}
+#endif
+
+typedef size_t (*ComputeKernel)(const uint8_t *, const uint8_t *, uint8_t *, size_t) ;
+typedef size_t (*ApplyKernel)(const uint8_t *, const uint8_t *, uint8_t *, size_t) ;
+
+static size_t computeDiffNone(const uint8_t *, const uint8_t *, uint8_t *, size_t) { return 0 ; }
+static size_t applyDiffNone(const uint8_t *, const uint8_t *, uint8_t *, size_t) { return 0 ; }
+
+struct Kernels
+{
+	Kernels() : compute(computeDiffNone), apply(applyDiffNone), name("scalar")
+	{
+#ifdef VOIP_FRAME_DIFF_AVX2
+		if(__builtin_cpu_supports("avx2"))
+		{
+			compute = computeDiffAVX2 ;
+			apply = applyDiffAVX2 ;
+			name = "avx2" ;
+			return ;
+		}
+#endif
+#ifdef VOIP_FRAME_DIFF_SSE2
+		compute = computeDiffSSE2 ;
+		apply = applyDiffSSE2 ;
+		name = "sse2" ;
+#endif
+	}
+
+	ComputeKernel compute ;
+	ApplyKernel apply ;
+	const char *name ;
+};
+
+static const Kernels& kernels()
+{
+	static const Kernels k ;
+	return k ;
+}
+
+void computeDiff(const uint8_t *frame, const uint8_t *ref, uint8_t *diff, size_t size)
+{
+	size_t done = kernels().compute(frame,ref,diff,size) ;
+	computeDiffScalar(frame+done,ref+done,diff+done,size-done) ;
+}
+
+void applyDiff(const uint8_t *ref, const uint8_t *diff, uint8_t *frame, size_t size)
+{
+	size_t done = kernels().apply(ref,diff,frame,size) ;
+	applyDiffScalar(ref+done,diff+done,frame+done,size-done) ;
+}
+
+const char *kernelName()
+{
+	return kernels().name ;
+}
+
+}
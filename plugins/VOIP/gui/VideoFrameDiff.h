@@ -0,0 +1,48 @@
+/*******************************************************************************
+ * plugins/VOIP/gui/VideoFrameDiff.h                                           *
+ *                                                                             *
+ * Copyright (C) 2019 by Retroshare Team <retroshare.project@gmail.com>        *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Affero General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Affero General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Saturating frame differencing used by the JPEG video codec. A differential
+// frame stores, for each byte, the difference with the reference frame offset
+// by 128 and clamped to [0,255], because the decompressed JPEG frames are
+// clamped too and modulo 256 arithmetic would cause color blotches.
+//
+// The kernels use AVX2 or SSE2 when the CPU supports them, and fall back to
+// plain C++ otherwise.
+
+namespace VideoFrameDiff
+{
+	// diff[i] = clamp(frame[i] - ref[i] + 128)
+	void computeDiff(const uint8_t *frame, const uint8_t *ref, uint8_t *diff, size_t size) ;
+
+	// frame[i] = clamp(ref[i] + diff[i] - 128). frame may be the same buffer as diff.
+	void applyDiff(const uint8_t *ref, const uint8_t *diff, uint8_t *frame, size_t size) ;
+
+	// Reference implementations, also used for the unaligned tails.
+	void computeDiffScalar(const uint8_t *frame, const uint8_t *ref, uint8_t *diff, size_t size) ;
+	void applyDiffScalar(const uint8_t *ref, const uint8_t *diff, uint8_t *frame, size_t size) ;
+
+	// Name of the kernels selected for this CPU ("avx2", "sse2" or "scalar")
+	const char *kernelName() ;
+}
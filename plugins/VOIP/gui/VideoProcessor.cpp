@@ -319,116 +319,6 @@ void VideoProcessor::setMaximumBandwidth(uint32_t bytes_per_sec)
 //
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-JPEGVideo::JPEGVideo()
-    : _encoded_ref_frame_max_distance(10),_encoded_ref_frame_count(10)
-{
-}
-
-bool JPEGVideo::decodeData(const RsVOIPDataChunk& chunk,QImage& image)
-{
-    // now see if the frame is a differential frame, or just a reference frame.
-
-    uint16_t codec = ((unsigned char *)chunk.data)[0] + (((unsigned char *)chunk.data)[1] << 8) ;
-    uint16_t flags = ((unsigned char *)chunk.data)[2] + (((unsigned char *)chunk.data)[3] << 8) ;
-
-    assert(codec == VideoProcessor::VIDEO_PROCESSOR_CODEC_ID_JPEG_VIDEO) ;
-
-    //  un-compress image data
-
-    QByteArray qb((char*)&((uint8_t*)chunk.data)[HEADER_SIZE],(int)chunk.size - HEADER_SIZE) ;
-
-    if(!image.loadFromData(qb,"JPEG"))
-    {
-	    std::cerr << "image.loadFromData(): returned an error.: " << std::endl;
-	    return false ;
-    }
-
-    if(flags & JPEG_VIDEO_FLAGS_DIFFERENTIAL_FRAME)
-    {
-	    if(_decoded_reference_frame.size() != image.size())
-	    {
-		    std::cerr << "Bad reference frame!" << std::endl;
-		    return false ;
-	    }
-
-	    QImage res = _decoded_reference_frame ;
-
-	    for(int i=0;i<image.byteCount();++i)
-	    {
-		    int new_val = (int)res.bits()[i] + ((int)image.bits()[i] - 128) ;
-
-		    res.bits()[i] = std::max(0,std::min(255,new_val)) ;
-	    }
-
-	    image = res ;
-    }
-    else
-        _decoded_reference_frame = image ;
-
-    return true ;
-}
-
-bool JPEGVideo::encodeData(const QImage& image,uint32_t /* size_hint */,RsVOIPDataChunk& voip_chunk)
-{
-    // check if we make a diff image, or if we use the full frame.
-
-    QImage encoded_frame ;
-    bool differential_frame ;
-
-    if (_encoded_ref_frame_count++ < _encoded_ref_frame_max_distance
-        && image.size() == _encoded_reference_frame.size()
-        && image.byteCount() == _encoded_reference_frame.byteCount())
-	{
-	    // compute difference with reference frame.
-	    encoded_frame = image ;
-
-	    for(int i=0;i<image.byteCount();++i)
-	    {
-		    // We cannot use basic modulo 256 arithmetic, because the decompressed JPeg frames do not follow the same rules (values are clamped)
-		    // and cause color blotches when perturbated by a differential frame.
-
-		    int diff = ( (int)image.bits()[i] - (int)_encoded_reference_frame.bits()[i]) + 128;
-		    encoded_frame.bits()[i] = (unsigned char)std::max(0,std::min(255,diff)) ;
-	    }
-
-	    differential_frame = true ;
-    }
-    else
-    {
-	    _encoded_ref_frame_count = 0 ;
-	    _encoded_reference_frame = image.copy() ;
-	    encoded_frame = image ;
-
-	    differential_frame = false ;
-    }
-
-    QByteArray qb ;
-
-    QBuffer buffer(&qb) ;
-    buffer.open(QIODevice::WriteOnly) ;
-    encoded_frame.save(&buffer,"JPEG") ;
-
-    voip_chunk.data = rs_malloc(HEADER_SIZE + qb.size());
-    
-    if(!voip_chunk.data)
-        return false ;
-
-    // build header
-    uint32_t flags = differential_frame ? JPEG_VIDEO_FLAGS_DIFFERENTIAL_FRAME : 0x0 ;
-
-    ((unsigned char *)voip_chunk.data)[0] =  VideoProcessor::VIDEO_PROCESSOR_CODEC_ID_JPEG_VIDEO       & 0xff ;
-    ((unsigned char *)voip_chunk.data)[1] = (VideoProcessor::VIDEO_PROCESSOR_CODEC_ID_JPEG_VIDEO >> 8) & 0xff ;
-    ((unsigned char *)voip_chunk.data)[2] = flags & 0xff ;
-    ((unsigned char *)voip_chunk.data)[3] = (flags >> 8) & 0xff ;
-
-    memcpy(&((unsigned char*)voip_chunk.data)[HEADER_SIZE],qb.data(),qb.size()) ;
-
-    voip_chunk.size = HEADER_SIZE + qb.size() ;
-    voip_chunk.type = RsVOIPDataChunk::RS_VOIP_DATA_TYPE_VIDEO ;
-
-    return true ;
-}
-
 FFmpegVideo::FFmpegVideo()
 {
     avcodec_register_all();
@@ -21,6 +21,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <QByteArray>
 #include <QImage>
 #include "interface/rsVOIP.h"
 
@@ -57,6 +58,10 @@ private:
     QImage _decoded_reference_frame ;
     QImage _encoded_reference_frame ;
 
+    // reused from one frame to the next
+    QImage _encoded_diff_frame ;
+    QByteArray _encoded_jpeg_data ;
+
     uint32_t _encoded_ref_frame_max_distance ;	// max distance between two reference frames.
     uint32_t _encoded_ref_frame_count ;
 };
@@ -0,0 +1,249 @@
+/*******************************************************************************
+ * tests/feedreader/curlmultiwrapper_test.cc                                   *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "util/CURLWrapper.h"
+#include "util/CURLMultiWrapper.h"
+
+static const char *TEST_FEED_BODY = "<rss version=\"2.0\"><channel><title>test</title></channel></rss>";
+static const char *TEST_FEED_ETAG = "\"v1\"";
+static const char *TEST_FEED_DATE = "Wed, 01 May 2019 10:00:00 GMT";
+static const int   TEST_RESPONSE_DELAY_MS = 300;
+
+/* Minimal HTTP server standing in for the feed sites. Every answer is delayed
+ * by TEST_RESPONSE_DELAY_MS, and the feed is served with an ETag and a
+ * Last-Modified date. Conditional requests matching them get a 304. */
+class TestHttpServer
+{
+public:
+	TestHttpServer() : mSocket(-1), mPort(0), mRequests(0), mNotModified(0), mStop(false)
+	{
+		mSocket = socket(AF_INET, SOCK_STREAM, 0);
+
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = 0;
+
+		socklen_t len = sizeof(addr);
+		if (bind(mSocket, (struct sockaddr*) &addr, sizeof(addr)) == 0 &&
+		    listen(mSocket, 64) == 0 &&
+		    getsockname(mSocket, (struct sockaddr*) &addr, &len) == 0) {
+			mPort = ntohs(addr.sin_port);
+			mThread = std::thread(&TestHttpServer::acceptLoop, this);
+		}
+	}
+
+	~TestHttpServer()
+	{
+		mStop = true;
+		shutdown(mSocket, SHUT_RDWR);
+		close(mSocket);
+		if (mThread.joinable()) {
+			mThread.join();
+		}
+		for (size_t i = 0; i < mClients.size(); ++i) {
+			mClients[i].join();
+		}
+	}
+
+	std::string url(const std::string &path)
+	{
+		return "http://127.0.0.1:" + std::to_string(mPort) + path;
+	}
+
+	uint16_t port() { return mPort; }
+	int requests() { return mRequests; }
+	int notModified() { return mNotModified; }
+
+private:
+	void acceptLoop()
+	{
+		while (!mStop) {
+			int client = accept(mSocket, NULL, NULL);
+			if (client < 0) {
+				break;
+			}
+			mClients.push_back(std::thread(&TestHttpServer::serve, this, client));
+		}
+	}
+
+	void serve(int client)
+	{
+		std::string request;
+		char buffer[1024];
+		while (request.find("\r\n\r\n") == std::string::npos) {
+			ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+			if (n <= 0) {
+				close(client);
+				return;
+			}
+			request.append(buffer, n);
+		}
+		++mRequests;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(TEST_RESPONSE_DELAY_MS));
+
+		std::string response;
+		if (request.compare(0, 10, "GET /feed ") != 0) {
+			response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+		} else if (request.find(std::string("If-None-Match: ") + TEST_FEED_ETAG + "\r\n") != std::string::npos ||
+		           request.find(std::string("If-Modified-Since: ") + TEST_FEED_DATE + "\r\n") != std::string::npos) {
+			++mNotModified;
+			response = "HTTP/1.1 304 Not Modified\r\nConnection: close\r\n\r\n";
+		} else {
+			response = "HTTP/1.1 200 OK\r\nContent-Type: application/rss+xml\r\n";
+			response += std::string("ETag: ") + TEST_FEED_ETAG + "\r\n";
+			response += std::string("Last-Modified: ") + TEST_FEED_DATE + "\r\n";
+			response += "Content-Length: " + std::to_string(strlen(TEST_FEED_BODY)) + "\r\n";
+			response += "Connection: close\r\n\r\n";
+			response += TEST_FEED_BODY;
+		}
+
+		send(client, response.c_str(), response.size(), MSG_NOSIGNAL);
+		close(client);
+	}
+
+	int mSocket;
+	uint16_t mPort;
+	std::atomic<int> mRequests;
+	std::atomic<int> mNotModified;
+	std::atomic<bool> mStop;
+	std::thread mThread;
+	std::vector<std::thread> mClients;
+};
+
+TEST(libretroshare_plugins, FeedReader_ConditionalGet)
+{
+	TestHttpServer server;
+	ASSERT_NE(server.port(), 0);
+
+	CURLWrapper CURL("");
+	std::string data;
+
+	/* first download gets the document and its validators */
+	ASSERT_EQ(CURL.downloadText(server.url("/feed"), data), CURLE_OK);
+	EXPECT_EQ(CURL.responseCode(), 200);
+	EXPECT_EQ(data, TEST_FEED_BODY);
+	EXPECT_EQ(CURL.etag(), TEST_FEED_ETAG);
+	EXPECT_EQ(CURL.lastModified(), curl_getdate(TEST_FEED_DATE, NULL));
+
+	std::string etag = CURL.etag();
+	time_t lastModified = CURL.lastModified();
+
+	/* unchanged document isn't downloaded again */
+	ASSERT_EQ(CURL.downloadText(server.url("/feed"), data, etag, 0), CURLE_OK);
+	EXPECT_EQ(CURL.responseCode(), 304);
+	EXPECT_TRUE(data.empty());
+
+	ASSERT_EQ(CURL.downloadText(server.url("/feed"), data, "", lastModified), CURLE_OK);
+	EXPECT_EQ(CURL.responseCode(), 304);
+	EXPECT_TRUE(data.empty());
+
+	/* other validator gets the document */
+	ASSERT_EQ(CURL.downloadText(server.url("/feed"), data, "\"v0\"", 0), CURLE_OK);
+	EXPECT_EQ(CURL.responseCode(), 200);
+	EXPECT_EQ(data, TEST_FEED_BODY);
+
+	/* binary downloads don't send the conditions of the previous request */
+	std::vector<unsigned char> icon;
+	CURL.downloadText(server.url("/feed"), data, etag, lastModified);
+	ASSERT_EQ(CURL.downloadBinary(server.url("/feed"), icon), CURLE_OK);
+	EXPECT_EQ(CURL.responseCode(), 200);
+	EXPECT_EQ(icon.size(), strlen(TEST_FEED_BODY));
+
+	EXPECT_EQ(server.notModified(), 3);
+}
+
+TEST(libretroshare_plugins, FeedReader_ConcurrentDownloads)
+{
+	TestHttpServer server;
+	ASSERT_NE(server.port(), 0);
+
+	const int count = 8;
+	std::vector<CURLWrapper*> curls;
+	std::vector<std::string> data(count);
+	CURLMultiWrapper multi;
+
+	for (int i = 0; i < count; ++i) {
+		CURLWrapper *CURL = new CURLWrapper("");
+		/* half of them are conditional requests */
+		ASSERT_TRUE(CURL->prepareText(server.url(i < count - 1 ? "/feed" : "/missing"), data[i], (i % 2) ? TEST_FEED_ETAG : "", 0));
+		ASSERT_TRUE(multi.add(CURL));
+		curls.push_back(CURL);
+	}
+	EXPECT_EQ(multi.count(), (size_t) count);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	std::map<CURLWrapper*, CURLcode> results;
+	while (multi.count() > 0 && std::chrono::steady_clock::now() - start < std::chrono::seconds(10)) {
+		std::list<std::pair<CURLWrapper*, CURLcode> > finished;
+		multi.perform(100, finished);
+		results.insert(finished.begin(), finished.end());
+	}
+
+	std::chrono::milliseconds elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+	ASSERT_EQ(results.size(), (size_t) count);
+	EXPECT_EQ(server.requests(), count);
+
+	/* the downloads ran at the same time */
+	EXPECT_LT(elapsed.count(), count * TEST_RESPONSE_DELAY_MS / 2);
+
+	for (int i = 0; i < count; ++i) {
+		EXPECT_EQ(results[curls[i]], CURLE_OK);
+		if (i == count - 1) {
+			EXPECT_EQ(curls[i]->responseCode(), 404);
+		} else if (i % 2) {
+			EXPECT_EQ(curls[i]->responseCode(), 304);
+			EXPECT_TRUE(data[i].empty());
+		} else {
+			EXPECT_EQ(curls[i]->responseCode(), 200);
+			EXPECT_EQ(data[i], TEST_FEED_BODY);
+			EXPECT_EQ(curls[i]->etag(), TEST_FEED_ETAG);
+		}
+	}
+
+	/* a finished download can be started again */
+	ASSERT_TRUE(curls[0]->prepareText(server.url("/feed"), data[0], curls[0]->etag(), 0));
+	ASSERT_TRUE(multi.add(curls[0]));
+	std::list<std::pair<CURLWrapper*, CURLcode> > finished;
+	while (multi.count() > 0) {
+		multi.perform(100, finished);
+	}
+	EXPECT_EQ(curls[0]->responseCode(), 304);
+
+	for (int i = 0; i < count; ++i) {
+		delete curls[i];
+	}
+}
@@ -0,0 +1,65 @@
+################################################################################
+# feedreader_tests.pro                                                         #
+# Copyright (C) 2019, Retroshare team <retroshare.team@gmailcom>               #
+#                                                                              #
+# This program is free software: you can redistribute it and/or modify         #
+# it under the terms of the GNU Affero General Public License as               #
+# published by the Free Software Foundation, either version 3 of the           #
+# License, or (at your option) any later version.                              #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU Lesser General Public License for more details.                          #
+#                                                                              #
+# You should have received a copy of the GNU Lesser General Public License     #
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.       #
+################################################################################
+
+# Tests of the FeedReader plugin which don't need libretroshare, kept out of
+# the unittests so that these don't depend on the plugin and its libraries.
+
+CONFIG += console c++11
+CONFIG -= qt app_bundle
+
+TEMPLATE = app
+TARGET = feedreader_tests
+
+# it is impossible to use precompield googletest lib
+# because googletest must be compiled with same compiler flags as the tests!
+!exists(../googletest/googletest/src/gtest-all.cc){
+    message(trying to git clone googletest...)
+    !system(git clone https://github.com/google/googletest.git ../googletest){
+        error(Could not git clone googletest files. You can manually download them to /tests/googletest)
+    }
+}
+
+INCLUDEPATH += \
+    ../googletest/googletest/include   \
+    ../googletest/googletest
+
+SOURCES += ../googletest/googletest/src/gtest-all.cc \
+	../googletest/googletest/src/gtest_main.cc
+
+# FeedReader downloads, tested against a local HTTP server
+INCLUDEPATH += ../../plugins/FeedReader
+
+SOURCES += curlmultiwrapper_test.cc \
+	../../plugins/FeedReader/util/CURLWrapper.cpp \
+	../../plugins/FeedReader/util/CURLMultiWrapper.cpp \
+
+LIBS *= -lpthread
+
+linux-* {
+	CONFIG += link_pkgconfig
+
+	PKGCONFIG *= libcurl
+}
+
+macx {
+	LIBS += -lcurl
+}
+
+freebsd-*|openbsd-*|haiku-* {
+	LIBS += -lcurl
+}
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+################################################################################
+# tests/jsonapi/jsonapi-loadtest.py                                            #
+#                                                                              #
+# Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>           #
+#                                                                              #
+# This program is free software: you can redistribute it and/or modify         #
+# it under the terms of the GNU Affero General Public License as               #
+# published by the Free Software Foundation, either version 3 of the           #
+# License, or (at your option) any later version.                              #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU Affero General Public License for more details.                          #
+#                                                                              #
+# You should have received a copy of the GNU Affero General Public License     #
+# along with this program. If not, see <https://www.gnu.org/licenses/>.        #
+#                                                                              #
+################################################################################
+
+"""
+Load test a running RetroShare JSON API instance.
+
+Start retroshare-service (or retroshare-nogui) with --jsonApiPort and
+optionally --jsonApiWorkers, login, then run for example:
+
+  ./jsonapi-loadtest.py --token "$LOCATION_ID:$PASSWORD" \\
+      --path /rsGxsForums/getForumsSummaries --concurrency 8 --requests 2000
+
+Several --path may be given, they are requested round robin. The request body
+is passed with --data as JSON. Throughput, latency percentiles and answer size
+are printed at the end, run it once per worker configuration to compare.
+"""
+
+import argparse
+import base64
+import json
+import threading
+import time
+import urllib.error
+import urllib.request
+
+
+def percentile(sortedValues, p):
+	if not sortedValues:
+		return 0.0
+	k = min(len(sortedValues) - 1, int(round(p / 100.0 * (len(sortedValues) - 1))))
+	return sortedValues[k]
+
+
+def worker(args, authHeader, counter, lock, latencies, stats):
+	while True:
+		with lock:
+			if counter[0] >= args.requests:
+				return
+			i = counter[0]
+			counter[0] += 1
+
+		path = args.path[i % len(args.path)]
+		req = urllib.request.Request(
+			args.url.rstrip("/") + path, data=args.data.encode("utf-8"),
+			method="POST")
+		req.add_header("Content-Type", "application/json")
+		if authHeader:
+			req.add_header("Authorization", authHeader)
+
+		start = time.monotonic()
+		try:
+			with urllib.request.urlopen(req, timeout=args.timeout) as resp:
+				body = resp.read()
+				json.loads(body.decode("utf-8"))
+				ok = True
+		except (urllib.error.URLError, ValueError, OSError) as e:
+			ok = False
+			body = b""
+			if args.verbose:
+				print("request", i, path, "failed:", e)
+		elapsed = time.monotonic() - start
+
+		with lock:
+			latencies.append(elapsed)
+			stats["bytes"] += len(body)
+			if not ok:
+				stats["errors"] += 1
+
+
+def main():
+	parser = argparse.ArgumentParser(
+		description="RetroShare JSON API load test")
+	parser.add_argument("--url", default="http://127.0.0.1:9092")
+	parser.add_argument("--token", default="",
+		help="authorized token as LOCATION_ID:PASSWORD")
+	parser.add_argument("--path", action="append",
+		help="API call path, may be repeated (default /rsPeers/getFriendList)")
+	parser.add_argument("--data", default="{}", help="JSON request body")
+	parser.add_argument("--concurrency", type=int, default=4)
+	parser.add_argument("--requests", type=int, default=1000)
+	parser.add_argument("--timeout", type=float, default=30.0)
+	parser.add_argument("--verbose", action="store_true")
+	args = parser.parse_args()
+	if not args.path:
+		args.path = ["/rsPeers/getFriendList"]
+
+	authHeader = ""
+	if args.token:
+		authHeader = "Basic " + base64.b64encode(
+			args.token.encode("utf-8")).decode("ascii")
+
+	counter = [0]
+	lock = threading.Lock()
+	latencies = []
+	stats = {"bytes": 0, "errors": 0}
+
+	threads = [threading.Thread(target=worker,
+		args=(args, authHeader, counter, lock, latencies, stats))
+		for _ in range(args.concurrency)]
+
+	start = time.monotonic()
+	for t in threads:
+		t.start()
+	for t in threads:
+		t.join()
+	total = time.monotonic() - start
+
+	latencies.sort()
+	done = len(latencies)
+	print("requests:    %d (%d errors)" % (done, stats["errors"]))
+	print("concurrency: %d" % args.concurrency)
+	print("elapsed:     %.3f s" % total)
+	print("throughput:  %.1f req/s" % (done / total if total else 0))
+	print("answer size: %.1f KiB average" %
+		(stats["bytes"] / 1024.0 / max(1, done - stats["errors"])))
+	for p in (50, 90, 99):
+		print("latency p%d: %.2f ms" % (p, percentile(latencies, p) * 1000))
+	print("latency max: %.2f ms" % ((latencies[-1] if latencies else 0) * 1000))
+	return 1 if stats["errors"] else 0
+
+
+if __name__ == "__main__":
+	exit(main())
@@ -0,0 +1,162 @@
+/*******************************************************************************
+ * unittests/libretroshare/crypto/pgphandler_test.cc                           *
+ *                                                                             *
+ * Copyright (C) 2018, Retroshare team <retroshare.team@gmailcom>              *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <memory>
+#include <sys/stat.h>
+
+// from libretroshare
+
+#include "pgp/pgphandler.h"
+#include "util/rsdir.h"
+
+#define PGPHANDLER_TEST_DIR "pgphandler_test"
+#define PGPHANDLER_TEST_PASSWD "test"
+
+static std::string testPassphrase( void*, const char*, const char*,
+                                   const char*, int, bool* cancelled )
+{
+	if(cancelled) *cancelled = false;
+	return PGPHANDLER_TEST_PASSWD;
+}
+
+static PGPHandler* createHandler(const std::string& name)
+{
+	std::string prefix = std::string(PGPHANDLER_TEST_DIR) + "/" + name;
+	return new PGPHandler( prefix + "_pubring.gpg", prefix + "_secring.gpg",
+	                       prefix + "_trustdb.gpg", prefix + "_lock" );
+}
+
+static bool hasSigner(PGPHandler& handler, const RsPgpId& id, const RsPgpId& signer)
+{
+	const PGPCertificateInfo* cert = handler.getCertificateInfo(id);
+	return cert && cert->signers.find(signer) != cert->signers.end();
+}
+
+/* Adds a valid signer to the cached entry of a key, so that the test can tell
+ * whether a handler used the signature cache or checked the signatures again.
+ * The layout is the one of PGPHandler::locked_writeSignatureCache(). */
+static bool addCachedSigner( const std::string& cacheFile, const RsPgpId& id,
+                             const RsPgpId& signer )
+{
+	std::string data;
+	if(!RsDirUtil::loadStringFromFile(cacheFile, data)) return false;
+
+	size_t offset = 2*sizeof(uint32_t);
+	while(offset < data.size())
+	{
+		uint32_t counts[2];
+		size_t countsOffset = offset + RsPgpId::SIZE_IN_BYTES + Sha1CheckSum::SIZE_IN_BYTES;
+		if(countsOffset + sizeof(counts) > data.size()) return false;
+		memcpy(counts, &data[countsOffset], sizeof(counts));
+
+		if(!memcmp(&data[offset], id.toByteArray(), RsPgpId::SIZE_IN_BYTES))
+		{
+			++counts[0];
+			memcpy(&data[countsOffset], counts, sizeof(counts));
+			data.insert( countsOffset + sizeof(counts),
+			             (const char*)signer.toByteArray(), RsPgpId::SIZE_IN_BYTES );
+			return RsDirUtil::saveStringToFile(cacheFile, data);
+		}
+		offset = countsOffset + sizeof(counts) + (counts[0]+counts[1])*RsPgpId::SIZE_IN_BYTES;
+	}
+	return false;
+}
+
+TEST(libretroshare_crypto, PGPHandler_AppendAndSignatureCache)
+{
+	RsDirUtil::checkCreateDirectory(PGPHANDLER_TEST_DIR);
+	RsDirUtil::cleanupDirectory(PGPHANDLER_TEST_DIR, std::set<std::string>());
+	PGPHandler::setPassphraseCallback(testPassphrase);
+
+	std::string pubring = std::string(PGPHANDLER_TEST_DIR) + "/own_pubring.gpg";
+	std::string sigcache = pubring + ".sigcache";
+	std::string error;
+	RsPgpId ownId, signerId;
+
+	std::unique_ptr<PGPHandler> own(createHandler("own"));
+	ASSERT_TRUE(own->GeneratePGPCertificate( "own", "", PGPHANDLER_TEST_PASSWD,
+	                                         ownId, 1024, error ));
+
+	// The signer lives in its own keyring, so that its key is a public key for
+	// the handler under test and can be removed from it.
+	std::string signedOwnCert, signerCert;
+	{
+		std::unique_ptr<PGPHandler> signer(createHandler("signer"));
+		ASSERT_TRUE(signer->GeneratePGPCertificate( "signer", "", PGPHANDLER_TEST_PASSWD,
+		                                            signerId, 1024, error ));
+		RsPgpId id;
+		ASSERT_TRUE(signer->LoadCertificateFromString( own->SaveCertificateToString(ownId, true),
+		                                               id, error ));
+		ASSERT_TRUE(signer->privateSignCertificate(signerId, ownId));
+		signedOwnCert = signer->SaveCertificateToString(ownId, true);
+		signerCert = signer->SaveCertificateToString(signerId, false);
+	}
+
+	// A new key is appended in place to the keyring on disk, leaving the keys
+	// already written untouched.
+	ASSERT_TRUE(own->syncDatabase());
+	own.reset(createHandler("own"));
+	std::string before, after;
+	ASSERT_TRUE(RsDirUtil::loadStringFromFile(pubring, before));
+	struct stat statBefore, statAfter;
+	ASSERT_EQ(stat(pubring.c_str(), &statBefore), 0);
+
+	RsPgpId id;
+	ASSERT_TRUE(own->LoadCertificateFromString(signerCert, id, error));
+	EXPECT_EQ(id, signerId);
+	ASSERT_TRUE(own->syncDatabase());
+
+	ASSERT_TRUE(RsDirUtil::loadStringFromFile(pubring, after));
+	EXPECT_GT(after.size(), before.size());
+	EXPECT_EQ(after.substr(0, before.size()), before);
+	ASSERT_EQ(stat(pubring.c_str(), &statAfter), 0);
+	EXPECT_EQ(statAfter.st_ino, statBefore.st_ino);
+
+	ASSERT_TRUE(own->LoadCertificateFromString(signedOwnCert, id, error));
+	EXPECT_TRUE(hasSigner(*own, ownId, signerId));
+	ASSERT_TRUE(own->syncDatabase());
+	own.reset();
+
+	// The appended keyring reads back, and the cached signers are used as long
+	// as the key packets did not change.
+	RsPgpId bogusSigner = RsPgpId::random();
+	ASSERT_TRUE(addCachedSigner(sigcache, ownId, bogusSigner));
+
+	own.reset(createHandler("own"));
+	EXPECT_TRUE(own->getCertificateInfo(signerId) != NULL);
+	EXPECT_TRUE(hasSigner(*own, ownId, signerId));
+	EXPECT_TRUE(hasSigner(*own, ownId, bogusSigner));
+
+	// Removing a signer drops the cached entries that list it, so the
+	// signatures are checked again at next start.
+	std::set<RsPgpId> toRemove;
+	toRemove.insert(signerId);
+	std::string backupFile;
+	uint32_t errorCode = 0;
+	ASSERT_TRUE(own->removeKeysFromPGPKeyring(toRemove, backupFile, errorCode));
+	own.reset();
+
+	own.reset(createHandler("own"));
+	EXPECT_TRUE(own->getCertificateInfo(signerId) == NULL);
+	EXPECT_FALSE(hasSigner(*own, ownId, signerId));
+	EXPECT_FALSE(hasSigner(*own, ownId, bogusSigner));
+}
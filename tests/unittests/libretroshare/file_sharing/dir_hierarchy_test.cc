@@ -0,0 +1,410 @@
+/*******************************************************************************
+ * unittests/libretroshare/file_sharing/dir_hierarchy_test.cc                  *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <malloc.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <iostream>
+#include <vector>
+
+#include "file_sharing/dir_hierarchy.h"
+
+typedef DirectoryStorage::EntryIndex EntryIndex;
+
+static double now_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static size_t heapInUse()
+{
+	return mallinfo2().uordblks;
+}
+
+/* Fills the storage the way RemoteDirectoryStorage does when receiving a
+ * friend's file list: n_dirs directories of n_files files below the root. */
+static void buildRemoteHierarchy(InternalFileHierarchyStorage& storage, uint32_t n_dirs, uint32_t n_files,
+                                 std::vector<RsFileHash>& dir_hashes, std::vector<RsFileHash>& file_hashes)
+{
+	for (uint32_t i = 0; i < n_dirs; ++i) {
+		dir_hashes.push_back(RsFileHash::random());
+	}
+
+	std::vector<InternalFileHierarchyStorage::FileEntry> no_files;
+	storage.updateDirEntry(0, "", 0, 0, dir_hashes, no_files);
+
+	char name[64];
+	std::vector<RsFileHash> no_dirs;
+
+	for (uint32_t i = 0; i < n_dirs; ++i) {
+		std::vector<InternalFileHierarchyStorage::FileEntry> files;
+
+		for (uint32_t j = 0; j < n_files; ++j) {
+			// half of the names are common to all directories
+			if (j % 2) {
+				snprintf(name, sizeof(name), "%02u - Track.mp3", j);
+			} else {
+				snprintf(name, sizeof(name), "Holiday picture %u-%u.jpg", i, j);
+			}
+
+			RsFileHash hash = RsFileHash::random();
+			files.push_back(InternalFileHierarchyStorage::FileEntry(name, 1000 + j, 1500000000 + j, hash));
+			file_hashes.push_back(hash);
+		}
+
+		EntryIndex indx;
+		ASSERT_TRUE(storage.getIndexFromDirHash(dir_hashes[i], indx));
+
+		snprintf(name, sizeof(name), "Album %u", i);
+		storage.updateDirEntry(indx, name, 1500000000, 1500000000, no_dirs, files);
+	}
+}
+
+TEST(InternalFileHierarchyStorageTest, MemoryAndLookupBenchmark)
+{
+	const uint32_t n_dirs = 2000;
+	const uint32_t n_files = 100;
+	const uint32_t n_lookups = 1000000;
+
+	std::vector<RsFileHash> dir_hashes, file_hashes;
+	dir_hashes.reserve(n_dirs);
+	file_hashes.reserve(n_dirs * n_files);
+
+	size_t heap_before = heapInUse();
+	InternalFileHierarchyStorage *storage = new InternalFileHierarchyStorage;
+
+	double start = now_us();
+	buildRemoteHierarchy(*storage, n_dirs, n_files, dir_hashes, file_hashes);
+	double build_time = now_us() - start;
+
+	size_t storage_size = heapInUse() - heap_before;
+
+	uint32_t found = 0;
+	EntryIndex indx;
+
+	start = now_us();
+	for (uint32_t i = 0; i < n_lookups; ++i) {
+		if (storage->getIndexFromFileHash(file_hashes[(i * 7919) % file_hashes.size()], indx)) {
+			++found;
+		}
+	}
+	double lookup_time = now_us() - start;
+
+	start = now_us();
+	for (uint32_t i = 0; i < n_dirs; ++i) {
+		EntryIndex dir;
+		for (uint32_t row = 0; storage->getChildIndex(storage->getSubDirIndex(0, i), row, dir); ++row) {
+			++found;
+		}
+	}
+	double browse_time = now_us() - start;
+
+	std::cerr << n_dirs * n_files << " files: " << storage_size / (n_dirs * n_files) << " bytes per file, built in "
+	          << build_time / 1000 << " ms, " << lookup_time * 1000 / n_lookups << " ns per hash lookup, "
+	          << browse_time * 1000 / (n_dirs * n_files) << " ns per child index" << std::endl;
+
+	EXPECT_EQ(n_lookups + n_dirs * n_files, found);
+
+	// the former layout used 193 bytes per file on this hierarchy
+	EXPECT_LT(storage_size / (n_dirs * n_files), 100u);
+
+	delete storage;
+}
+
+TEST(InternalFileHierarchyStorageTest, RemoteDirectoryUpdates)
+{
+	InternalFileHierarchyStorage storage;
+	std::vector<RsFileHash> dir_hashes, file_hashes;
+
+	buildRemoteHierarchy(storage, 20, 10, dir_hashes, file_hashes);
+
+	SharedDirStats stats;
+	storage.getStatistics(stats);
+	EXPECT_EQ(200u, stats.total_number_of_files);
+
+	EntryIndex dir, file;
+	ASSERT_TRUE(storage.getIndexFromDirHash(dir_hashes[3], dir));
+	ASSERT_TRUE(storage.getIndexFromFileHash(file_hashes[35], file));
+
+	EXPECT_EQ(dir, storage.getParentIndex(file));
+	EXPECT_EQ("Album 3", storage.getName(dir));
+	EXPECT_EQ("05 - Track.mp3", storage.getName(file));
+	EXPECT_EQ(1005u, storage.getFileSize(file));
+	EXPECT_EQ(1500000005, storage.getFileModTime(file));
+	EXPECT_EQ(file_hashes[35], storage.getFileHash(file));
+	EXPECT_EQ(3, storage.parentRow(file));
+
+	// rename a file, change the hash of another one and drop the rest
+
+	std::vector<InternalFileHierarchyStorage::FileEntry> files;
+	RsFileHash new_hash = RsFileHash::random();
+	files.push_back(InternalFileHierarchyStorage::FileEntry("05 - Track.mp3", 2000, 1600000000, new_hash));
+	files.push_back(InternalFileHierarchyStorage::FileEntry("New file.txt", 10, 1600000000, file_hashes[31]));
+
+	storage.updateDirEntry(dir, "Album 3 (remastered)", 1600000000, 1600000000, std::vector<RsFileHash>(), files);
+
+	EXPECT_FALSE(storage.getIndexFromFileHash(file_hashes[35], file));
+	ASSERT_TRUE(storage.getIndexFromFileHash(new_hash, file));
+	EXPECT_EQ("05 - Track.mp3", storage.getName(file));
+	EXPECT_EQ(2000u, storage.getFileSize(file));
+	ASSERT_TRUE(storage.getIndexFromFileHash(file_hashes[31], file));
+	EXPECT_EQ("New file.txt", storage.getName(file));
+	EXPECT_EQ("Album 3 (remastered)", storage.getName(dir));
+
+	for (uint32_t i = 30; i < 40; ++i) {
+		if (i != 31 && i != 35) {
+			EXPECT_FALSE(storage.getIndexFromFileHash(file_hashes[i], file));
+		}
+	}
+
+	storage.getStatistics(stats);
+	EXPECT_EQ(192u, stats.total_number_of_files);
+
+	// remove half of the directories from the root
+
+	std::vector<RsFileHash> kept_dirs(dir_hashes.begin(), dir_hashes.begin() + 10);
+	storage.updateDirEntry(0, "", 0, 0, kept_dirs, std::vector<InternalFileHierarchyStorage::FileEntry>());
+
+	for (uint32_t i = 0; i < 20; ++i) {
+		EXPECT_EQ(i < 10, storage.getIndexFromDirHash(dir_hashes[i], dir));
+	}
+	for (uint32_t i = 100; i < 200; ++i) {
+		EXPECT_FALSE(storage.getIndexFromFileHash(file_hashes[i], file));
+	}
+	for (uint32_t i = 0; i < 30; ++i) {
+		ASSERT_TRUE(storage.getIndexFromFileHash(file_hashes[i], file));
+		EXPECT_EQ(file_hashes[i], storage.getFileHash(file));
+		EXPECT_EQ(1000u + i % 10, storage.getFileSize(file));
+	}
+
+	storage.getStatistics(stats);
+	EXPECT_EQ(92u, stats.total_number_of_files);
+
+	std::string error;
+	EXPECT_TRUE(storage.check(error)) << error;
+
+	ASSERT_TRUE(storage.getIndexFromFileHash(file_hashes[0], file));
+	EXPECT_EQ("Holiday picture 0-0.jpg", storage.getName(file));
+	ASSERT_TRUE(storage.getIndexFromDirHash(dir_hashes[0], dir));
+	EXPECT_EQ("Album 0", storage.getDirPath(dir));
+}
+
+TEST(InternalFileHierarchyStorageTest, LocalDirectoryUpdates)
+{
+	InternalFileHierarchyStorage storage;
+	RsFileHash seed = RsFileHash::random();
+
+	std::set<std::string> subdirs;
+	subdirs.insert("music");
+	subdirs.insert("pictures");
+	ASSERT_TRUE(storage.updateSubDirectoryList(0, subdirs, seed));
+
+	EntryIndex music = storage.getSubDirIndex(0, 0);
+	EntryIndex pictures = storage.getSubDirIndex(0, 1);
+	if (storage.getName(music) != "music") {
+		std::swap(music, pictures);
+	}
+	EXPECT_EQ("music", storage.getName(music));
+	EXPECT_EQ("pictures", storage.getName(pictures));
+
+	std::set<std::string> albums;
+	albums.insert("Album");
+	ASSERT_TRUE(storage.updateSubDirectoryList(music, albums, seed));
+	EntryIndex album = storage.getSubDirIndex(music, 0);
+	EXPECT_EQ("music/Album", storage.getDirPath(album));
+
+	std::map<std::string, DirectoryStorage::FileTS> subfiles, new_files;
+	subfiles["01 - Intro.mp3"].size = 100;
+	subfiles["01 - Intro.mp3"].modtime = 1000;
+	subfiles["02 - Outro.mp3"].size = 200;
+	subfiles["02 - Outro.mp3"].modtime = 1000;
+	ASSERT_TRUE(storage.updateSubFilesList(album, subfiles, new_files));
+	EXPECT_EQ(2u, new_files.size());
+
+	SharedDirStats stats;
+	storage.getStatistics(stats);
+	EXPECT_EQ(2u, stats.total_number_of_files);
+	EXPECT_EQ(300u, stats.total_shared_size);
+
+	// files without a hash are not indexed, and are not found by searches yet
+
+	std::list<std::string> terms;
+	terms.push_back("intro");
+	std::list<EntryIndex> results;
+	storage.searchTerms(terms, results);
+	EXPECT_TRUE(results.empty());
+
+	EntryIndex intro = storage.getSubFileIndex(album, 0);
+	if (storage.getName(intro) != "01 - Intro.mp3") {
+		intro = storage.getSubFileIndex(album, 1);
+	}
+	RsFileHash hash = RsFileHash::random();
+	ASSERT_TRUE(storage.updateHash(intro, hash));
+
+	EntryIndex found;
+	ASSERT_TRUE(storage.searchHash(hash, found));
+	EXPECT_EQ(intro, found);
+
+	storage.searchTerms(terms, results);
+	ASSERT_EQ(1u, results.size());
+	EXPECT_EQ(intro, results.front());
+
+	// a modified file loses its hash until it is hashed again
+
+	subfiles["01 - Intro.mp3"].modtime = 2000;
+	subfiles["01 - Intro.mp3"].size = 150;
+	subfiles.erase("02 - Outro.mp3");
+	ASSERT_TRUE(storage.updateSubFilesList(album, subfiles, new_files));
+	EXPECT_TRUE(new_files.empty());
+	EXPECT_FALSE(storage.searchHash(hash, found));
+	EXPECT_TRUE(storage.getFileHash(intro).isNull());
+	EXPECT_EQ(150u, storage.getFileSize(intro));
+
+	storage.getStatistics(stats);
+	EXPECT_EQ(1u, stats.total_number_of_files);
+	EXPECT_EQ(150u, stats.total_shared_size);
+
+	// removing a directory removes everything below it
+
+	ASSERT_TRUE(storage.updateHash(intro, hash));
+	subdirs.erase("music");
+	ASSERT_TRUE(storage.updateSubDirectoryList(0, subdirs, seed));
+	EXPECT_FALSE(storage.searchHash(hash, found));
+	EXPECT_FALSE(storage.isIndexValid(album));
+	EXPECT_FALSE(storage.isIndexValid(intro));
+	EXPECT_TRUE(storage.isIndexValid(pictures));
+
+	std::string error;
+	EXPECT_TRUE(storage.check(error)) << error;
+	EXPECT_EQ("pictures", storage.getName(pictures));
+}
+
+TEST(InternalFileHierarchyStorageTest, SerialisationAndSummary)
+{
+	InternalFileHierarchyStorage storage;
+	std::vector<RsFileHash> dir_hashes, file_hashes;
+
+	buildRemoteHierarchy(storage, 20, 10, dir_hashes, file_hashes);
+
+	unsigned char *data = NULL;
+	uint32_t size = 0;
+	ASSERT_TRUE(storage.serialise(data, size));
+
+	InternalFileHierarchyStorage copy;
+	ASSERT_TRUE(copy.deserialise(data, size));
+	free(data);
+
+	std::string error;
+	EXPECT_TRUE(copy.check(error)) << error;
+
+	SharedDirStats stats;
+	copy.getStatistics(stats);
+	EXPECT_EQ(200u, stats.total_number_of_files);
+
+	EntryIndex indx, copy_indx;
+	for (uint32_t i = 0; i < file_hashes.size(); ++i) {
+		ASSERT_TRUE(storage.getIndexFromFileHash(file_hashes[i], indx));
+		ASSERT_TRUE(copy.getIndexFromFileHash(file_hashes[i], copy_indx));
+		EXPECT_EQ(indx, copy_indx);
+		EXPECT_EQ(storage.getName(indx), copy.getName(copy_indx));
+		EXPECT_EQ(storage.getFileSize(indx), copy.getFileSize(copy_indx));
+	}
+	for (uint32_t i = 0; i < dir_hashes.size(); ++i) {
+		ASSERT_TRUE(storage.getIndexFromDirHash(dir_hashes[i], indx));
+		ASSERT_TRUE(copy.getIndexFromDirHash(dir_hashes[i], copy_indx));
+		EXPECT_EQ(indx, copy_indx);
+		EXPECT_EQ(storage.getDirPath(indx), copy.getDirPath(copy_indx));
+	}
+
+	// all directories were updated, so only the root needs to be synced
+
+	DirectoryStorage::Summary summary;
+	storage.getSummary(summary);
+	ASSERT_EQ(1u, summary.dirs.size());
+	EXPECT_EQ(0u, summary.dirs[0].index);
+	EXPECT_EQ(200u, summary.stats.total_number_of_files);
+
+	// updating the root resets the update TS of its sub-directories
+
+	storage.updateDirEntry(0, "", 0, 0, dir_hashes, std::vector<InternalFileHierarchyStorage::FileEntry>());
+	storage.getSummary(summary);
+	ASSERT_EQ(21u, summary.dirs.size());
+	EXPECT_EQ(0u, summary.dirs[0].index);
+	EXPECT_NE(0, summary.dirs[0].update_TS);
+
+	for (uint32_t i = 1; i < summary.dirs.size(); ++i) {
+		ASSERT_TRUE(storage.getIndexFromDirHash(summary.dirs[i].hash, indx));
+		EXPECT_EQ(indx, summary.dirs[i].index);
+		EXPECT_EQ(0, summary.dirs[i].update_TS);
+		EXPECT_EQ(1500000000, summary.dirs[i].recurs_modf_TS);
+	}
+
+	// the file hash filter has no false negatives, and about 1% false positives
+
+	for (uint32_t i = 0; i < file_hashes.size(); ++i) {
+		EXPECT_TRUE(summary.mayContainFileHash(file_hashes[i]));
+	}
+	uint32_t false_positives = 0;
+	for (uint32_t i = 0; i < 10000; ++i) {
+		if (summary.mayContainFileHash(RsFileHash::random())) {
+			++false_positives;
+		}
+	}
+	EXPECT_LT(false_positives, 300u);
+
+	ASSERT_TRUE(summary.serialise(data, size));
+
+	DirectoryStorage::Summary summary_copy;
+	ASSERT_TRUE(summary_copy.deserialise(data, size));
+	free(data);
+
+	ASSERT_EQ(summary.dirs.size(), summary_copy.dirs.size());
+	for (uint32_t i = 0; i < summary.dirs.size(); ++i) {
+		EXPECT_EQ(summary.dirs[i].index, summary_copy.dirs[i].index);
+		EXPECT_EQ(summary.dirs[i].hash, summary_copy.dirs[i].hash);
+		EXPECT_EQ(summary.dirs[i].update_TS, summary_copy.dirs[i].update_TS);
+		EXPECT_EQ(summary.dirs[i].recurs_modf_TS, summary_copy.dirs[i].recurs_modf_TS);
+	}
+	EXPECT_EQ(200u, summary_copy.stats.total_number_of_files);
+	EXPECT_EQ(summary.stats.total_shared_size, summary_copy.stats.total_shared_size);
+	for (uint32_t i = 0; i < file_hashes.size(); ++i) {
+		EXPECT_TRUE(summary_copy.mayContainFileHash(file_hashes[i]));
+	}
+
+	// clearing gives the memory back and leaves an empty root
+
+	InternalFileHierarchyStorage empty;
+	uint64_t memory = storage.memoryUsage();
+	storage.clear();
+	EXPECT_LT(storage.memoryUsage(), memory);
+	EXPECT_EQ(empty.memoryUsage(), storage.memoryUsage());
+	EXPECT_TRUE(storage.check(error)) << error;
+	EXPECT_FALSE(storage.getIndexFromFileHash(file_hashes[0], indx));
+	EXPECT_FALSE(storage.getIndexFromDirHash(dir_hashes[0], indx));
+	EXPECT_FALSE(storage.isIndexValid(storage.getSubDirIndex(0, 0)));
+
+	storage.getStatistics(stats);
+	EXPECT_EQ(0u, stats.total_number_of_files);
+}
@@ -0,0 +1,245 @@
+/*******************************************************************************
+ * unittests/libretroshare/ft/chunkmap_scheduler_test.cc                       *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <iostream>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "ft/ftchunkmap.h"
+
+/* ChunkMap running on a simulated clock, one tick per second. */
+class SimulatedChunkMap: public ChunkMap
+{
+public:
+	SimulatedChunkMap(uint64_t size) : ChunkMap(size, true), now(1000) {}
+
+	rstime_t now;
+
+protected:
+	virtual rstime_t currentTime() const { return now; }
+};
+
+struct SimulatedRequest
+{
+	uint64_t offset;
+	uint32_t size;
+	uint32_t sent;
+};
+
+/* A file source sending at a fixed speed, asked for data the way
+ * ftTransferModule does: every second, a bit more than what it sent
+ * recently. The request rate starts at the source speed, so that the
+ * simulation measures the chunk scheduling and not the ramp up of
+ * ftTransferModule. Sources stop sending at stall_time, if any. */
+struct SimulatedSource
+{
+	SimulatedSource(const std::string& n, uint32_t s, rstime_t stall = 0)
+	    : id(RsPeerId::random()), name(n), speed(s), stall_time(stall), request_rate(s),
+	      last_transfers(0), last_data_time(0), max_pending(0), estimated_rate(0) {}
+
+	uint64_t pendingBytes() const
+	{
+		uint64_t n = 0;
+		for (uint32_t i = 0; i < queue.size(); ++i) {
+			n += queue[i].size - queue[i].sent;
+		}
+		return n;
+	}
+
+	RsPeerId id;
+	std::string name;
+	uint32_t speed;
+	rstime_t stall_time;
+	float request_rate;
+	uint32_t last_transfers;
+	rstime_t last_data_time;
+	uint64_t max_pending;
+	uint32_t estimated_rate;	// as reported by the chunk map in the middle of the download
+	std::deque<SimulatedRequest> queue;
+};
+
+/* Runs the download until the file is complete and returns how long it took.
+ * Source rates estimated by the chunk map are recorded at rate_time. */
+static rstime_t simulateDownload(SimulatedChunkMap& map, std::vector<SimulatedSource>& sources, rstime_t rate_time, rstime_t max_duration)
+{
+	const rstime_t start = map.now;
+	std::set<uint64_t> pending_slices;
+
+	for (; map.now < start + max_duration; ++map.now) {
+		// 1 - sources send data
+
+		for (uint32_t i = 0; i < sources.size(); ++i) {
+			SimulatedSource& s(sources[i]);
+			uint32_t budget = (s.stall_time > 0 && map.now >= start + s.stall_time) ? 0 : s.speed;
+			uint32_t sent = 0;
+
+			while (budget > 0 && !s.queue.empty()) {
+				SimulatedRequest& r(s.queue.front());
+				uint32_t n = std::min(budget, r.size - r.sent);
+
+				r.sent += n;
+				budget -= n;
+				sent += n;
+
+				if (r.sent == r.size) {
+					if (pending_slices.erase(r.offset)) {	// otherwise, another source sent it already
+						map.dataReceived(r.offset);
+					}
+					s.queue.pop_front();
+				}
+			}
+			if (sent > 0) {
+				map.sourceDataReceived(s.id, sent);
+				s.last_data_time = map.now;
+			}
+			s.last_transfers += sent;
+		}
+
+		std::vector<uint32_t> chunks_to_check;
+		map.getChunksToCheck(chunks_to_check);
+		for (uint32_t i = 0; i < chunks_to_check.size(); ++i) {
+			map.setChunkCheckingResult(chunks_to_check[i], true);
+		}
+
+		if (map.isComplete()) {
+			return map.now - start;
+		}
+
+		if (map.now == start + rate_time) {
+			std::map<RsPeerId, uint32_t> rates;
+			map.getSourceRates(rates);
+
+			for (uint32_t i = 0; i < sources.size(); ++i) {
+				sources[i].estimated_rate = rates[sources[i].id];
+			}
+		}
+
+		// 2 - ask sources for more data
+
+		for (uint32_t i = 0; i < sources.size(); ++i) {
+			SimulatedSource& s(sources[i]);
+
+			s.request_rate = 0.75 * s.request_rate + 0.25 * s.last_transfers;
+			s.last_transfers = 0;
+
+			// ftTransferModule stops asking sources that haven't sent anything for 10 seconds.
+			if (s.last_data_time > 0 && map.now > s.last_data_time + 10) {
+				continue;
+			}
+
+			uint32_t next_req = std::max(1024.0f, s.request_rate * 1.3f);
+
+			while (next_req > 0) {
+				ftChunk chunk;
+				bool map_needed;
+				uint64_t offset;
+				uint32_t size;
+
+				if (map.getDataChunk(s.id, next_req, chunk, map_needed)) {
+					offset = chunk.offset;
+					size = chunk.size;
+					pending_slices.insert(offset);
+				} else if (!map.reAskPendingChunk(s.id, next_req, offset, size)) {
+					break;
+				}
+
+				SimulatedRequest r = { offset, size, 0 };
+				s.queue.push_back(r);
+				next_req -= std::min(size, next_req);
+			}
+			s.max_pending = std::max(s.max_pending, s.pendingBytes());
+		}
+	}
+	return max_duration;
+}
+
+TEST(ChunkMapSchedulerTest, HeterogeneousSources)
+{
+	const uint64_t file_size = 96 * 1024 * 1024;
+
+	SimulatedChunkMap map(file_size);
+
+	std::vector<SimulatedSource> sources;
+	sources.push_back(SimulatedSource("friend", 1536 * 1024));
+	sources.push_back(SimulatedSource("fast tunnel", 400 * 1024));
+	sources.push_back(SimulatedSource("slow tunnel 1", 15 * 1024));
+	sources.push_back(SimulatedSource("slow tunnel 2", 15 * 1024));
+	sources.push_back(SimulatedSource("stalling tunnel", 600 * 1024, 20));
+
+	rstime_t duration = simulateDownload(map, sources, 35, 3600);
+
+	// time needed if the bandwidth of all sources had been fully used from the start
+	uint64_t aggregate = 0, aggregate_after_stall = 0;
+	for (uint32_t i = 0; i < sources.size(); ++i) {
+		aggregate += sources[i].speed;
+		if (sources[i].stall_time == 0) {
+			aggregate_after_stall += sources[i].speed;
+		}
+	}
+	float ideal = 20 + (file_size - 20.0 * aggregate) / aggregate_after_stall;
+
+	std::cerr << "Downloaded " << file_size / (1024 * 1024) << " MB in " << duration << " s (ideal: " << ideal << " s)" << std::endl;
+	for (uint32_t i = 0; i < sources.size(); ++i) {
+		std::cerr << "  " << sources[i].name << ": speed " << sources[i].speed / 1024 << " KB/s, estimated " << sources[i].estimated_rate / 1024
+		          << " KB/s, max pending " << sources[i].max_pending / 1024 << " KB" << std::endl;
+	}
+
+	ASSERT_TRUE(map.isComplete());
+
+	// the request rate of ftTransferModule is ahead of what sources can send, and the last slices of the stalling source need to be re-asked
+	EXPECT_LT(duration, ideal * 1.25);
+
+	for (uint32_t i = 0; i < sources.size(); ++i) {
+		if (sources[i].stall_time == 0) {
+			EXPECT_NEAR(sources[i].estimated_rate, sources[i].speed, sources[i].speed * 0.35) << sources[i].name;
+		} else {
+			EXPECT_LT(sources[i].estimated_rate, sources[i].speed / 10) << sources[i].name;
+		}
+	}
+
+	// slow sources never hold more than a chunk, and fast ones pipeline more than one
+	const uint64_t chunk_size = ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE;
+
+	EXPECT_LE(sources[2].max_pending, chunk_size);
+	EXPECT_LE(sources[3].max_pending, chunk_size);
+	EXPECT_GT(sources[0].max_pending, chunk_size);
+}
+
+TEST(ChunkMapSchedulerTest, StalledSlicesMoveToFasterSources)
+{
+	SimulatedChunkMap map(64 * 1024 * 1024);
+
+	std::vector<SimulatedSource> sources;
+	sources.push_back(SimulatedSource("friend", 1024 * 1024));
+	sources.push_back(SimulatedSource("dead tunnel", 1024 * 1024, 5));
+
+	rstime_t duration = simulateDownload(map, sources, 35, 3600);
+
+	std::cerr << "Downloaded 64 MB in " << duration << " s with a source stalled after 5 s" << std::endl;
+
+	ASSERT_TRUE(map.isComplete());
+
+	// The friend alone needs 64 s. The slices held by the dead tunnel must not wait until the end of the file.
+	EXPECT_LT(duration, 90);
+}
@@ -263,6 +263,52 @@ void init_item(RsNxsTransacItem &rstx,RsSerialType **ser)
 		*ser = new RsNxsSerialiser(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
 }
 
+void init_item(RsNxsSyncMsgBatchReqItem& rsbr,RsSerialType **ser)
+{
+	rsbr.clear();
+
+	rsbr.flag = RsNxsSyncMsgReqItem::FLAG_ACCEPTS_ENCRYPTED_BATCH;
+	rsbr.groups.resize(1 + rand()%50);
+
+	for(uint32_t i=0;i<rsbr.groups.size();++i)
+	{
+		init_random(rsbr.groups[i].grpId) ;
+		rsbr.groups[i].updateTS = rand()%24232;
+	}
+
+	if(ser)
+		*ser = new RsNxsSerialiser(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+}
+
+void init_item(RsNxsSyncMsgDigestItem& rsmd,RsSerialType **ser)
+{
+	rsmd.clear();
+
+	rsmd.changedGroups.resize(1 + rand()%50);
+
+	for(uint32_t i=0;i<rsmd.changedGroups.size();++i)
+		init_random(rsmd.changedGroups[i]) ;
+
+	if(ser)
+		*ser = new RsNxsSerialiser(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+}
+
+void init_item(RsNxsMsgAnnounceItem& rsma,RsSerialType **ser)
+{
+    rsma.clear();
+
+    rsma.msgs.resize(1 + rand()%50);
+
+    for(uint32_t i=0;i<rsma.msgs.size();++i)
+    {
+        init_random(rsma.msgs[i].grpId) ;
+        init_random(rsma.msgs[i].msgId) ;
+    }
+
+	if(ser)
+		*ser = new RsNxsSerialiser(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+}
+
 
 bool operator==(const RsNxsSyncGrpReqItem& l, const RsNxsSyncGrpReqItem& r)
 {
@@ -287,6 +333,38 @@ bool operator==(const RsNxsSyncMsgReqItem& l, const RsNxsSyncMsgReqItem& r)
     return true;
 }
 
+bool operator==(const RsNxsSyncMsgBatchReqItem& l, const RsNxsSyncMsgBatchReqItem& r)
+{
+	if(l.flag != r.flag) return false;
+	if(l.groups.size() != r.groups.size()) return false;
+
+	for(uint32_t i=0;i<l.groups.size();++i)
+	{
+		if(l.groups[i].grpId != r.groups[i].grpId) return false;
+		if(l.groups[i].updateTS != r.groups[i].updateTS) return false;
+	}
+
+	return true;
+}
+
+bool operator==(const RsNxsSyncMsgDigestItem& l, const RsNxsSyncMsgDigestItem& r)
+{
+	return l.changedGroups == r.changedGroups;
+}
+
+bool operator==(const RsNxsMsgAnnounceItem& l, const RsNxsMsgAnnounceItem& r)
+{
+    if(l.msgs.size() != r.msgs.size()) return false;
+
+    for(uint32_t i=0;i<l.msgs.size();++i)
+    {
+        if(l.msgs[i].grpId != r.msgs[i].grpId) return false;
+        if(l.msgs[i].msgId != r.msgs[i].msgId) return false;
+    }
+
+    return true;
+}
+
 bool operator==(const RsNxsSyncGrpItem& l, const RsNxsSyncGrpItem& r)
 {
     if(l.flag != r.flag) return false;
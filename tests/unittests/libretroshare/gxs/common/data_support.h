@@ -34,6 +34,9 @@ bool operator==(const RsNxsSyncMsgItem& l, const RsNxsSyncMsgItem& r);
 bool operator==(const RsNxsSyncGrpItem& l, const RsNxsSyncGrpItem& r);
 bool operator==(const RsNxsSyncMsgItem& l, const RsNxsSyncMsgItem& r);
 bool operator==(const RsNxsTransacItem& l, const RsNxsTransacItem& r);
+bool operator==(const RsNxsSyncMsgBatchReqItem& l, const RsNxsSyncMsgBatchReqItem& r);
+bool operator==(const RsNxsSyncMsgDigestItem& l, const RsNxsSyncMsgDigestItem& r);
+bool operator==(const RsNxsMsgAnnounceItem& l, const RsNxsMsgAnnounceItem& r);
 
 //void init_item(RsNxsGrp& nxg);
 //void init_item(RsNxsMsg& nxm);
@@ -48,6 +51,9 @@ void init_item(RsNxsSyncMsgReqItem &rsgm,RsSerialType ** = NULL);
 void init_item(RsNxsSyncGrpItem& rsgl   ,RsSerialType ** = NULL);
 void init_item(RsNxsSyncMsgItem& rsgml  ,RsSerialType ** = NULL);
 void init_item(RsNxsTransacItem& rstx   ,RsSerialType ** = NULL);
+void init_item(RsNxsSyncMsgBatchReqItem& rsbr,RsSerialType ** = NULL);
+void init_item(RsNxsSyncMsgDigestItem& rsmd ,RsSerialType ** = NULL);
+void init_item(RsNxsMsgAnnounceItem& rsma   ,RsSerialType ** = NULL);
 
 template<typename T>
 void copy_all_but(T& ex, const std::list<T>& s, std::list<T>& d)
@@ -0,0 +1,220 @@
+/*******************************************************************************
+ * unittests/libretroshare/gxs/data_service/rsdataservice_blobstore_test.cc    *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+#include "libretroshare/gxs/common/data_support.h"
+#include "gxs/rsdataservice.h"
+#include "gxs/rsgxsblobstore.h"
+#include "rsitems/rsserviceids.h"
+#include "util/rsdir.h"
+#include "util/folderiterator.h"
+#include "util/rsrandom.h"
+
+#define BLOB_DATA_BASE_NAME "blob_msg_grp_Store"
+#define BLOB_DIRECTORY      "./" BLOB_DATA_BASE_NAME "_blobs"
+
+static const uint32_t BLOB_THRESHOLD = 4096;
+
+static RsNxsMsg *createMessage(const RsGxsGroupId& grpId, uint32_t payloadSize)
+{
+	RsNxsMsg* msg = new RsNxsMsg(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+	RsGxsMsgMetaData* msgMeta = new RsGxsMsgMetaData();
+
+	init_item(*msg);
+	init_item(msgMeta);
+
+	std::vector<uint8_t> payload(payloadSize);
+	RsRandom::random_bytes(payload.data(), payloadSize);
+	msg->msg.setBinData(payload.data(), payloadSize);
+
+	msgMeta->mMsgId = msg->msgId;
+	msgMeta->mGroupId = msg->grpId = grpId;
+	msgMeta->mHash = RsDirUtil::sha1sum((uint8_t*)msg->msg.bin_data, msg->msg.bin_len);
+	msg->metaData = msgMeta;
+
+	return msg;
+}
+
+static uint32_t countBlobs()
+{
+	uint32_t n = 0;
+
+	for(librs::util::FolderIterator it(BLOB_DIRECTORY, false); it.isValid(); it.next())
+		if(it.file_type() == librs::util::FolderIterator::TYPE_FILE)
+			++n;
+
+	return n;
+}
+
+static void cleanUp()
+{
+	RsDirUtil::cleanupDirectory(BLOB_DIRECTORY, std::set<std::string>());
+	remove(BLOB_DIRECTORY);
+	remove(BLOB_DATA_BASE_NAME);
+}
+
+/*!
+ * Checks that all messages of \p msgs can be read back from \p store with
+ * the same payload
+ */
+static void checkRetrieved(RsDataService *store, const RsGxsGroupId& grpId, RsNxsMsgDataTemporaryList& msgs)
+{
+	GxsMsgReq req;
+	req[grpId];
+
+	GxsMsgResult result;
+	store->retrieveNxsMsgs(req, result, false, true);
+
+	std::vector<RsNxsMsg*>& retrieved = result[grpId];
+	EXPECT_EQ(retrieved.size(), msgs.size());
+
+	for(uint32_t i = 0; i < retrieved.size(); ++i)
+	{
+		RsNxsMsg *r = retrieved[i];
+
+		for(std::list<RsNxsMsg*>::iterator it = msgs.begin(); it != msgs.end(); ++it)
+			if((*it)->msgId == r->msgId)
+			{
+				EXPECT_EQ((*it)->msg.bin_len, r->msg.bin_len);
+				EXPECT_EQ(0, memcmp((*it)->msg.bin_data, r->msg.bin_data, r->msg.bin_len));
+				EXPECT_EQ((*it)->metaData->mHash, r->metaData->mHash);
+			}
+
+		delete r;
+	}
+}
+
+TEST(libretroshare_gxs, RsDataServiceBlobStore)
+{
+	cleanUp();
+
+	RsGxsGroupId grpId = RsGxsGroupId::random();
+	RsNxsMsgDataTemporaryList msgs;
+
+	// one small and two big messages, stored before the threshold is set
+	msgs.push_back(createMessage(grpId, 100));
+	msgs.push_back(createMessage(grpId, 3 * BLOB_THRESHOLD));
+	msgs.push_back(createMessage(grpId, 5 * BLOB_THRESHOLD));
+
+	RsDataService *store = new RsDataService(".", BLOB_DATA_BASE_NAME, RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+	store->storeMessage(msgs);
+	EXPECT_EQ(0u, countBlobs());
+	delete store;
+
+	// reopening with a threshold moves the big payloads out of the database,
+	// a batch at each call of migrateExternalData()
+	store = new RsDataService(".", BLOB_DATA_BASE_NAME, RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+	store->setExternalDataThreshold(BLOB_THRESHOLD);
+	EXPECT_EQ(0u, countBlobs());
+	checkRetrieved(store, grpId, msgs);
+
+	int calls = 0;
+	while(!store->migrateExternalData() && calls < 100)
+		++calls;
+
+	EXPECT_LT(calls, 100);
+	EXPECT_EQ(2u, countBlobs());
+	EXPECT_TRUE(store->migrateExternalData());
+	checkRetrieved(store, grpId, msgs);
+
+	// new big messages go straight to the blob store
+	RsNxsMsg *newMsg = createMessage(grpId, 2 * BLOB_THRESHOLD);
+	store->storeMessage(std::list<RsNxsMsg*>(1, newMsg));
+	EXPECT_EQ(3u, countBlobs());
+
+	msgs.push_back(newMsg);
+	checkRetrieved(store, grpId, msgs);
+
+	// blobs of removed messages are released by the integrity check
+	GxsMsgReq toRemove;
+	toRemove[grpId].insert(msgs.back()->msgId);
+	store->removeMsgs(toRemove);
+	EXPECT_EQ(3u, countBlobs());
+	EXPECT_EQ(1, store->removeUnreferencedData());
+	EXPECT_EQ(2u, countBlobs());
+
+	delete msgs.back();
+	msgs.pop_back();
+	checkRetrieved(store, grpId, msgs);
+
+	std::set<RsGxsMessageId> noData;
+	EXPECT_EQ(1, store->retrieveMsgIdsWithoutData(grpId, noData));
+	EXPECT_TRUE(noData.empty());
+
+	// a message which lost its payload is not returned, so that the
+	// integrity check removes it and it can be synced again
+	RsDirUtil::cleanupDirectory(BLOB_DIRECTORY, std::set<std::string>());
+
+	// the integrity check finds it without reading any payload
+	EXPECT_EQ(1, store->retrieveMsgIdsWithoutData(grpId, noData));
+	EXPECT_EQ(2u, noData.size());
+	EXPECT_EQ(0u, noData.count(msgs.front()->msgId));
+
+	GxsMsgReq req;
+	req[grpId];
+	GxsMsgResult result;
+	store->retrieveNxsMsgs(req, result, false, true);
+	EXPECT_EQ(1u, result[grpId].size());
+
+	for(uint32_t i = 0; i < result[grpId].size(); ++i)
+		delete result[grpId][i];
+
+	delete store;
+	cleanUp();
+}
+
+TEST(libretroshare_gxs, GxsBlobStoreEncryption)
+{
+	cleanUp();
+
+	std::vector<uint8_t> payload(10000);
+	RsRandom::random_bytes(payload.data(), payload.size());
+	RsFileHash hash = RsDirUtil::sha1sum(payload.data(), payload.size());
+
+	RsGxsBlobStore blobs(BLOB_DIRECTORY, "database key");
+	EXPECT_TRUE(blobs.store(hash, payload.data(), payload.size()));
+	EXPECT_EQ(1u, countBlobs());
+
+	// neither the hash nor the payload appear on disk
+	EXPECT_FALSE(RsDirUtil::fileExists(std::string(BLOB_DIRECTORY) + "/" + hash.toStdString()));
+
+	for(librs::util::FolderIterator it(BLOB_DIRECTORY, false); it.isValid(); it.next())
+	{
+		uint64_t size = 0;
+		EXPECT_TRUE(RsDirUtil::checkFile(it.file_fullpath(), size));
+		EXPECT_NE(payload.size(), size);
+	}
+
+	uint8_t *data = NULL;
+	uint32_t size = 0;
+	EXPECT_TRUE(blobs.load(hash, data, size));
+	ASSERT_EQ(payload.size(), size);
+	EXPECT_EQ(0, memcmp(payload.data(), data, size));
+	free(data);
+
+	// a store with another key cannot read it
+	RsGxsBlobStore otherBlobs(BLOB_DIRECTORY, "another key");
+	EXPECT_FALSE(otherBlobs.load(hash, data, size));
+
+	cleanUp();
+}
@@ -0,0 +1,199 @@
+/*******************************************************************************
+ * unittests/libretroshare/gxs/data_service/rsdataservice_concurrency_test.cc  *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+
+#include "libretroshare/gxs/common/data_support.h"
+#include "gxs/rsgxsutil.h"
+#include "gxs/rsdataservice.h"
+#include "rsitems/rsserviceids.h"
+
+#define CONCURRENT_DATA_BASE_NAME "concurrent_msg_grp_Store"
+
+static const int NUM_GROUPS    = 4;
+static const int NUM_READERS   = 4;
+static const int NUM_BATCHES   = 30;
+static const int MSGS_PER_BATCH = 40;
+
+/*!
+ * Stores batches of messages from one thread while several threads keep
+ * reading messages and meta data of the same groups. Every read must return
+ * complete items, and the number of messages seen in a group can only grow.
+ */
+TEST(libretroshare_gxs, RsDataServiceConcurrentReadWrite)
+{
+	remove(CONCURRENT_DATA_BASE_NAME);
+
+	RsDataService* store = new RsDataService(".", CONCURRENT_DATA_BASE_NAME, RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+
+	std::vector<RsGxsGroupId> grpIds;
+	RsNxsGrpDataTemporaryList grps;
+
+	for(int i = 0; i < NUM_GROUPS; ++i)
+	{
+		RsNxsGrp* grp = new RsNxsGrp(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+		RsGxsGrpMetaData* grpMeta = new RsGxsGrpMetaData();
+
+		init_item(*grp);
+		init_item(grpMeta);
+		grpMeta->mGroupId = grp->grpId;
+		grp->metaData = grpMeta;
+
+		grpIds.push_back(grp->grpId);
+		grps.push_back(grp);
+	}
+	store->storeGroup(grps);
+
+	std::atomic<bool> writing(true);
+	std::atomic<bool> failed(false);
+	std::atomic<int> reads(0);
+	std::atomic<int> readsDuringWrite(0);
+	std::atomic<int> batchInProgress(-1);
+
+	std::thread writer([&]()
+	{
+		for(int b = 0; b < NUM_BATCHES; ++b)
+		{
+			RsNxsMsgDataTemporaryList msgs;
+
+			for(int i = 0; i < MSGS_PER_BATCH; ++i)
+			{
+				RsNxsMsg* msg = new RsNxsMsg(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+				RsGxsMsgMetaData* msgMeta = new RsGxsMsgMetaData();
+
+				init_item(*msg);
+				init_item(msgMeta);
+
+				msgMeta->mMsgId = msg->msgId;
+				msgMeta->mGroupId = msg->grpId = grpIds[i % NUM_GROUPS];
+				msg->metaData = msgMeta;
+
+				msgs.push_back(msg);
+			}
+
+			batchInProgress = b;
+			store->storeMessage(msgs);
+			batchInProgress = -1;
+		}
+		writing = false;
+	});
+
+	std::vector<std::thread> readers;
+
+	for(int r = 0; r < NUM_READERS; ++r)
+		readers.push_back(std::thread([&, r]()
+		{
+			std::vector<size_t> seen(NUM_GROUPS, 0);
+
+			for(int n = 0; writing || n < 10; ++n)
+			{
+				int g = (r + n) % NUM_GROUPS;
+				int batchBefore = batchInProgress;
+
+				GxsMsgReq req;
+				req[grpIds[g]];
+
+				if(n % 3 == 0)
+				{
+					GxsMsgResult msgs;
+					store->retrieveNxsMsgs(req, msgs, false, true);
+
+					for(uint32_t i = 0; i < msgs[grpIds[g]].size(); ++i)
+					{
+						RsNxsMsg* msg = msgs[grpIds[g]][i];
+
+						if(!msg->metaData || msg->grpId != grpIds[g] || msg->metaData->mMsgId != msg->msgId)
+							failed = true;
+
+						delete msg;
+					}
+					if(msgs[grpIds[g]].size() < seen[g])
+						failed = true;
+
+					seen[g] = msgs[grpIds[g]].size();
+				}
+				else if(n % 3 == 1)
+				{
+					GxsMsgMetaResult metas;
+					store->retrieveGxsMsgMetaData(req, metas);
+
+					for(uint32_t i = 0; i < metas[grpIds[g]].size(); ++i)
+					{
+						if(metas[grpIds[g]][i]->mGroupId != grpIds[g])
+							failed = true;
+
+						delete metas[grpIds[g]][i];
+					}
+
+					if(metas[grpIds[g]].size() < seen[g])
+						failed = true;
+
+					seen[g] = metas[grpIds[g]].size();
+				}
+				else
+				{
+					RsGxsGrpMetaTemporaryMap grpMetas;
+					store->retrieveGxsGrpMetaData(grpMetas);
+
+					if(grpMetas.size() != (size_t)NUM_GROUPS)
+						failed = true;
+
+					// meta data belong to the cache of the data service, don't delete them
+				}
+
+				if(batchBefore >= 0 && batchInProgress == batchBefore)
+					++readsDuringWrite;
+				++reads;
+			}
+		}));
+
+	writer.join();
+	for(uint32_t i = 0; i < readers.size(); ++i)
+		readers[i].join();
+
+	std::cerr << "RsDataService concurrency: " << reads << " reads, " << readsDuringWrite
+	          << " completed while a batch was being stored" << std::endl;
+
+	EXPECT_FALSE(failed);
+
+	GxsMsgReq req;
+	for(int g = 0; g < NUM_GROUPS; ++g)
+		req[grpIds[g]];
+
+	GxsMsgMetaResult metas;
+	store->retrieveGxsMsgMetaData(req, metas);
+
+	for(int g = 0; g < NUM_GROUPS; ++g)
+	{
+		EXPECT_EQ(metas[grpIds[g]].size(), (size_t)(NUM_BATCHES * MSGS_PER_BATCH / NUM_GROUPS));
+
+		for(uint32_t i = 0; i < metas[grpIds[g]].size(); ++i)
+			delete metas[grpIds[g]][i];
+	}
+
+	delete store;
+	remove(CONCURRENT_DATA_BASE_NAME);
+}
@@ -0,0 +1,73 @@
+/*******************************************************************************
+ * unittests/libretroshare/gxs/data_service/rsdataservice_integrity_test.cc    *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+#include "libretroshare/gxs/common/data_support.h"
+#include "gxs/rsdataservice.h"
+#include "rsitems/rsserviceids.h"
+
+#define INTEGRITY_DATA_BASE_NAME "integrity_msg_grp_Store"
+
+TEST(libretroshare_gxs, RsDataServiceIntegrityCheckpoint)
+{
+	remove(INTEGRITY_DATA_BASE_NAME);
+
+	RsDataService *store = new RsDataService(".", INTEGRITY_DATA_BASE_NAME, RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+
+	// nothing stored yet
+	RsGxsIntegrityCheckpoint checkpoint;
+	checkpoint.mPassStartTS = 12;
+	EXPECT_EQ(1, store->retrieveIntegrityCheckpoint(checkpoint));
+	EXPECT_EQ(0u, checkpoint.mLastPassTS);
+	EXPECT_EQ(0u, checkpoint.mLastFullPassTS);
+	EXPECT_EQ(0u, checkpoint.mPassStartTS);
+	EXPECT_TRUE(checkpoint.mLastGrpId.isNull());
+
+	checkpoint.mLastPassTS = 1000;
+	checkpoint.mLastFullPassTS = 500;
+	checkpoint.mPassStartTS = 2000;
+	checkpoint.mLastGrpId = RsGxsGroupId::random();
+	EXPECT_EQ(1, store->storeIntegrityCheckpoint(checkpoint));
+
+	// a pass interrupted by a shutdown finds its progress back
+	delete store;
+	store = new RsDataService(".", INTEGRITY_DATA_BASE_NAME, RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+
+	RsGxsIntegrityCheckpoint retrieved;
+	EXPECT_EQ(1, store->retrieveIntegrityCheckpoint(retrieved));
+	EXPECT_EQ(checkpoint.mLastPassTS, retrieved.mLastPassTS);
+	EXPECT_EQ(checkpoint.mLastFullPassTS, retrieved.mLastFullPassTS);
+	EXPECT_EQ(checkpoint.mPassStartTS, retrieved.mPassStartTS);
+	EXPECT_EQ(checkpoint.mLastGrpId, retrieved.mLastGrpId);
+
+	// storing again replaces the previous checkpoint
+	checkpoint.mPassStartTS = 0;
+	checkpoint.mLastGrpId.clear();
+	EXPECT_EQ(1, store->storeIntegrityCheckpoint(checkpoint));
+	EXPECT_EQ(1, store->retrieveIntegrityCheckpoint(retrieved));
+	EXPECT_EQ(0u, retrieved.mPassStartTS);
+	EXPECT_TRUE(retrieved.mLastGrpId.isNull());
+
+	delete store;
+	remove(INTEGRITY_DATA_BASE_NAME);
+}
@@ -0,0 +1,97 @@
+/*******************************************************************************
+ * unittests/libretroshare/gxs/gen_exchange/gxstokenlatency_test.cc            *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "genexchangetestservice.h"
+#include "gxs/rsdataservice.h"
+#include "retroshare/rsgxsflags.h"
+#include "retroshare/rsgxscircles.h"
+
+/*!
+ * Measures the time blocking V2 API calls take to get their answer, that is
+ * from submitting a request to waitToken() returning, with the service thread
+ * running as in the real application.
+ * Requests used to wait for the next 100ms service tick, and then to be
+ * noticed by the 2ms polling of waitToken().
+ */
+TEST(libretroshare_gxs, TokenWaitLatency)
+{
+	RsGeneralDataService* dataStore = new RsDataService("./", "testServiceDb", RS_SERVICE_TYPE_DUMMY, NULL, "");
+	dataStore->resetDataStore();
+
+	GenExchangeTestService testService(dataStore, NULL, NULL);
+	RsTokenService* tokenService = testService.getTokenService();
+	testService.start("gxs latency");
+
+	uint32_t token;
+	RsDummyGrp* grp = new RsDummyGrp();
+	grp->grpData = "some data";
+	grp->meta.mGroupName = "latency test";
+	grp->meta.mGroupFlags = GXS_SERV::FLAG_PRIVACY_PUBLIC;
+	grp->meta.mCircleType = GXS_CIRCLE_TYPE_PUBLIC;
+	testService.publishDummyGrp(token, grp);
+
+	ASSERT_EQ(RsTokenService::COMPLETE, tokenService->waitToken(token, std::chrono::seconds(5)));
+
+	RsGxsGroupId grpId;
+	EXPECT_TRUE(testService.acknowledgeTokenGrp(token, grpId));
+
+	const int N = 50;
+	std::vector<double> latencies;
+
+	for(int i=0; i<N; ++i)
+	{
+		RsTokReqOptions opts;
+		opts.mReqType = GXS_REQUEST_TYPE_GROUP_META;
+
+		auto start = std::chrono::steady_clock::now();
+
+		tokenService->requestGroupInfo(token, 0, opts);
+		auto st = tokenService->waitToken(token, std::chrono::seconds(5));
+
+		latencies.push_back( std::chrono::duration<double, std::milli>(
+		                     std::chrono::steady_clock::now() - start ).count() );
+
+		ASSERT_EQ(RsTokenService::COMPLETE, st);
+
+		std::list<RsGroupMetaData> groupInfo;
+		EXPECT_TRUE(testService.getGroupMetaTS(token, groupInfo));
+		EXPECT_EQ(1u, groupInfo.size());
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+	double median = latencies[N/2];
+
+	std::cerr << "  blocking group meta request latency over " << N
+	          << " calls: min=" << latencies.front() << "ms median=" << median
+	          << "ms p90=" << latencies[(N*9)/10] << "ms max="
+	          << latencies.back() << "ms" << std::endl;
+
+	// waiting for the service tick alone used to take 50ms on average
+	EXPECT_LT(median, 25.0);
+
+	testService.fullstop();
+	dataStore->resetDataStore();
+}
@@ -0,0 +1,150 @@
+/*******************************************************************************
+ * unittests/libretroshare/gxs/nxs_test/nxsmsgreassembler_test.cc              *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include "gxs/rsgxsnetutils.h"
+#include "rsitems/rsserviceids.h"
+#include "util/rsrandom.h"
+
+static const uint32_t TEST_FRAGMENT_SIZE = 1000;
+static const uint32_t TEST_MAX_MSG_SIZE  = 10000;
+
+static RsNxsMsg *createFragment(const RsGxsMessageId& msgId, const std::vector<uint8_t>& payload, uint8_t pos, uint8_t count)
+{
+	RsNxsMsg *frag = new RsNxsMsg(RS_SERVICE_GXS_TYPE_CHANNELS);
+	frag->msgId = msgId;
+	frag->pos = pos;
+	frag->count = count;
+
+	uint32_t offset = pos * TEST_FRAGMENT_SIZE;
+	uint32_t size = std::min<uint32_t>(TEST_FRAGMENT_SIZE, payload.size() - offset);
+	frag->msg.setBinData(payload.data() + offset, size);
+
+	if(pos == 0)
+	{
+		uint8_t meta[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+		frag->meta.setBinData(meta, sizeof(meta));
+	}
+
+	return frag;
+}
+
+TEST(libretroshare_gxs, NxsMsgReassembler)
+{
+	NxsMsgReassembler reassembler(TEST_FRAGMENT_SIZE, TEST_MAX_MSG_SIZE, 20);
+
+	std::vector<uint8_t> payload(3 * TEST_FRAGMENT_SIZE + 123);
+	RsRandom::random_bytes(payload.data(), payload.size());
+	RsGxsMessageId msgId = RsGxsMessageId::random();
+
+	// out of order, with a duplicate, and the meta data arriving last
+	EXPECT_TRUE(reassembler.addFragment(createFragment(msgId, payload, 3, 4)) == NULL);
+	EXPECT_TRUE(reassembler.addFragment(createFragment(msgId, payload, 1, 4)) == NULL);
+	EXPECT_TRUE(reassembler.addFragment(createFragment(msgId, payload, 1, 4)) == NULL);
+	EXPECT_TRUE(reassembler.addFragment(createFragment(msgId, payload, 2, 4)) == NULL);
+	EXPECT_EQ(1u, reassembler.pendingCount());
+
+	RsNxsMsg *msg = reassembler.addFragment(createFragment(msgId, payload, 0, 4));
+	ASSERT_TRUE(msg != NULL);
+	EXPECT_EQ(0u, reassembler.pendingCount());
+
+	EXPECT_EQ(msgId, msg->msgId);
+	EXPECT_EQ(1, msg->count);
+	EXPECT_EQ(payload.size(), msg->msg.bin_len);
+	EXPECT_EQ(0, memcmp(payload.data(), msg->msg.bin_data, payload.size()));
+	EXPECT_EQ(8u, msg->meta.bin_len);
+	delete msg;
+
+	// a whole message goes through untouched
+	RsNxsMsg *whole = createFragment(msgId, payload, 0, 1);
+	EXPECT_EQ(whole, reassembler.addFragment(whole));
+	delete whole;
+
+	// fragments which do not fit the announced layout are dropped
+	EXPECT_TRUE(reassembler.addFragment(createFragment(msgId, payload, 5, 4)) == NULL);
+	EXPECT_TRUE(reassembler.addFragment(createFragment(msgId, payload, 0, 20)) == NULL);
+	EXPECT_EQ(0u, reassembler.pendingCount());
+
+	EXPECT_TRUE(reassembler.addFragment(createFragment(msgId, payload, 0, 4)) == NULL);
+	EXPECT_TRUE(reassembler.addFragment(createFragment(msgId, payload, 3, 5)) == NULL);
+	EXPECT_EQ(1u, reassembler.pendingCount());
+
+	// incomplete messages are released with the reassembler
+}
+
+TEST(libretroshare_gxs, NxsMsgReassembler_Reservation)
+{
+	std::vector<uint8_t> payload(5 * TEST_FRAGMENT_SIZE);
+	RsRandom::random_bytes(payload.data(), payload.size());
+
+	// a transaction of 6 items cannot hold two messages of 5 fragments
+	NxsMsgReassembler reassembler(TEST_FRAGMENT_SIZE, TEST_MAX_MSG_SIZE, 6);
+
+	RsGxsMessageId msgId1 = RsGxsMessageId::random();
+	RsGxsMessageId msgId2 = RsGxsMessageId::random();
+
+	EXPECT_TRUE(reassembler.addFragment(createFragment(msgId1, payload, 0, 5)) == NULL);
+	EXPECT_EQ(5u * TEST_FRAGMENT_SIZE, reassembler.reservedSize());
+	EXPECT_TRUE(reassembler.addFragment(createFragment(msgId2, payload, 0, 5)) == NULL);
+	EXPECT_EQ(1u, reassembler.pendingCount());
+
+	RsNxsMsg *msg = NULL;
+	for(uint8_t pos = 1; pos < 5; ++pos)
+		msg = reassembler.addFragment(createFragment(msgId1, payload, pos, 5));
+	ASSERT_TRUE(msg != NULL);
+	EXPECT_EQ(0u, reassembler.reservedSize());
+	delete msg;
+
+	// even once the first message is complete, its fragments still count in the transaction
+	EXPECT_TRUE(reassembler.addFragment(createFragment(msgId2, payload, 0, 2)) == NULL);
+	EXPECT_EQ(0u, reassembler.pendingCount());
+
+	// memory budget given by the caller
+	NxsMsgReassembler reassembler2(TEST_FRAGMENT_SIZE, TEST_MAX_MSG_SIZE, 20);
+
+	EXPECT_TRUE(reassembler2.addFragment(createFragment(msgId1, payload, 0, 5), 5 * TEST_FRAGMENT_SIZE - 1) == NULL);
+	EXPECT_EQ(0u, reassembler2.pendingCount());
+	EXPECT_TRUE(reassembler2.addFragment(createFragment(msgId1, payload, 0, 5), 5 * TEST_FRAGMENT_SIZE) == NULL);
+	EXPECT_EQ(1u, reassembler2.pendingCount());
+}
+
+TEST(libretroshare_gxs, NxsTransaction_FragmentAck)
+{
+	NxsTransaction tr;
+	tr.mTransaction = new RsNxsTransacItem(RS_SERVICE_GXS_TYPE_CHANNELS);
+	tr.mTransaction->nItems = 10;
+	tr.mTimeOut = 1000 + 2000;
+
+	// an ack pushes back the timeout, based on our own clock
+	EXPECT_TRUE(tr.fragmentsAcknowledged(3, 1500, 2000));
+	EXPECT_EQ(1500u + 2000u, tr.mTimeOut);
+
+	// a late ack never brings it closer
+	EXPECT_TRUE(tr.fragmentsAcknowledged(4, 1200, 2000));
+	EXPECT_EQ(1500u + 2000u, tr.mTimeOut);
+
+	// acks that don't match the transaction are ignored
+	EXPECT_FALSE(tr.fragmentsAcknowledged(11, 1800, 2000));
+	EXPECT_FALSE(tr.fragmentsAcknowledged(0, 1800, 2000));
+	EXPECT_EQ(1500u + 2000u, tr.mTimeOut);
+}
@@ -23,7 +23,8 @@
 #include <iostream>
 #include <sstream>
 #include "gxs/gxssecurity.h"
-#include "util/rsdir.h"
+#include "util/rsdir.h"
+#include "util/rsworkerpool.h"
 
 TEST(libretroshare_gxs, GxsSecurity)
 {
@@ -93,3 +94,93 @@ TEST(libretroshare_gxs, GxsSecurity)
 }
 
 
+
+TEST(libretroshare_gxs, GxsSecuritySessionKey)
+{
+	// Same scheme as batch encrypted GXS transactions: the session key is
+	// multi-encrypted once, then items are encrypted with it and decrypted in
+	// parallel.
+
+	std::vector<RsTlvPublicRSAKey> pub_keys(2) ;
+	std::vector<RsTlvPrivateRSAKey> priv_keys(2) ;
+
+	for(uint32_t i=0;i<pub_keys.size();++i)
+		EXPECT_TRUE(GxsSecurity::generateKeyPair(pub_keys[i],priv_keys[i])) ;
+
+	uint8_t session_key[GxsSecurity::SESSION_KEY_SIZE] ;
+	RSRandom::random_bytes(session_key,GxsSecurity::SESSION_KEY_SIZE) ;
+
+	uint8_t *enc_key = NULL ;
+	uint32_t enc_key_len = 0 ;
+	EXPECT_TRUE(GxsSecurity::encrypt(enc_key,enc_key_len,session_key,GxsSecurity::SESSION_KEY_SIZE,pub_keys)) ;
+
+	// any recipient can get the key back
+
+	std::vector<RsTlvPrivateRSAKey> one_key(1,priv_keys[1]) ;
+	uint8_t *dec_key = NULL ;
+	uint32_t dec_key_len = 0 ;
+	EXPECT_TRUE(GxsSecurity::decrypt(dec_key,dec_key_len,enc_key,enc_key_len,one_key)) ;
+	ASSERT_EQ(GxsSecurity::SESSION_KEY_SIZE,dec_key_len) ;
+	EXPECT_TRUE(!memcmp(session_key,dec_key,dec_key_len)) ;
+
+	free(enc_key) ;
+	free(dec_key) ;
+
+	const uint32_t N = 64 ;
+	std::vector<std::vector<uint8_t> > clear(N), encrypted(N), decrypted(N) ;
+
+	for(uint32_t i=0;i<N;++i)
+	{
+		clear[i].resize(1 + RSRandom::random_u32()%500) ;
+		RSRandom::random_bytes(clear[i].data(),clear[i].size()) ;
+
+		uint8_t *out = NULL ;
+		uint32_t outlen = 0 ;
+		EXPECT_TRUE(GxsSecurity::encryptWithSessionKey(out,outlen,clear[i].data(),clear[i].size(),session_key)) ;
+		encrypted[i].assign(out,out+outlen) ;
+		free(out) ;
+	}
+
+	// the IV is random, so that the same data never looks the same twice
+
+	uint8_t *out1 = NULL, *out2 = NULL ;
+	uint32_t outlen1 = 0, outlen2 = 0 ;
+	EXPECT_TRUE(GxsSecurity::encryptWithSessionKey(out1,outlen1,clear[0].data(),clear[0].size(),session_key)) ;
+	EXPECT_TRUE(GxsSecurity::encryptWithSessionKey(out2,outlen2,clear[0].data(),clear[0].size(),session_key)) ;
+	EXPECT_TRUE(outlen1 == outlen2 && memcmp(out1,out2,outlen1) != 0) ;
+	free(out1) ;
+	free(out2) ;
+
+	RsWorkerPool pool("test pool",4) ;
+	std::vector<std::function<void()> > jobs ;
+
+	for(uint32_t i=0;i<N;++i)
+		jobs.push_back([&,i]()
+		{
+			uint8_t *out = NULL ;
+			uint32_t outlen = 0 ;
+
+			if(GxsSecurity::decryptWithSessionKey(out,outlen,encrypted[i].data(),encrypted[i].size(),session_key))
+				decrypted[i].assign(out,out+outlen) ;
+			free(out) ;
+		});
+
+	pool.runAndWait(jobs) ;
+
+	for(uint32_t i=0;i<N;++i)
+		EXPECT_TRUE(clear[i] == decrypted[i]) ;
+
+	// a wrong key or truncated data is rejected
+
+	uint8_t wrong_key[GxsSecurity::SESSION_KEY_SIZE] ;
+	memcpy(wrong_key,session_key,GxsSecurity::SESSION_KEY_SIZE) ;
+	wrong_key[0] ^= 0xff ;
+
+	uint8_t *out = NULL ;
+	uint32_t outlen = 0 ;
+	bool ok = GxsSecurity::decryptWithSessionKey(out,outlen,encrypted[1].data(),encrypted[1].size(),wrong_key) ;
+	EXPECT_TRUE(!ok || std::vector<uint8_t>(out,out+outlen) != clear[1]) ;
+	free(out) ;
+
+	EXPECT_FALSE(GxsSecurity::decryptWithSessionKey(out,outlen,encrypted[1].data(),8,session_key)) ;
+}
@@ -0,0 +1,221 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/pqistreamer_coalescing_test.cc                  *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+
+#include "pqi/pqistreamer.h"
+#include "serialiser/rsserial.h"
+
+#include "tls_support.h"
+
+static const uint32_t TEST_ITEM_TYPE = 0x02aa0001;
+
+/* Records the writes of the streamer, or forwards them to a TLS connection */
+class TestBin: public BinInterface
+{
+public:
+	TestBin(SSL *ssl = NULL) : mSsl(ssl), mRecords(0) {}
+
+	virtual int tick() { return 1; }
+	virtual int senddata(void *data, int len)
+	{
+		++mRecords;
+		if (mSsl) {
+			return SSL_write(mSsl, data, len);
+		}
+		mWrites.push_back(len);
+		mData.append((const char*) data, len);
+		return len;
+	}
+	virtual int readdata(void *, int) { return 0; }
+	virtual int netstatus() { return 1; }
+	virtual int isactive() { return 1; }
+	virtual bool moretoread(uint32_t) { return false; }
+	virtual bool cansend(uint32_t) { return true; }
+	virtual int close() { return 1; }
+	virtual RsFileHash gethash() { return RsFileHash(); }
+	virtual bool bandwidthLimited() { return false; }
+
+	SSL *mSsl;
+	uint32_t mRecords;
+	std::vector<int> mWrites;
+	std::string mData;
+};
+
+class TestStreamer: public pqistreamer
+{
+public:
+	TestStreamer(BinInterface *bio) : pqistreamer(new RsSerialiser(), RsPeerId::random(), bio, BIN_FLAGS_NO_CLOSE)
+	{
+		setMaxRate(false, 1e9);
+	}
+
+	/* queue a raw item filled with the byte c, returns the serialised item */
+	std::string queue(uint32_t size, char c)
+	{
+		void *data = malloc(size);
+		memset(data, c, size);
+		setRsItemHeader(data, size, TEST_ITEM_TYPE, size);
+		std::string item((const char*) data, size);
+
+		RS_STACK_MUTEX(mStreamerMtx);
+		locked_storeInOutputQueue(data, size, 3);
+		return item;
+	}
+
+	void send() { tick_send(0); }
+};
+
+/* drops the probe packet inserted at the beginning of the stream */
+static std::string streamData(const TestBin& bin)
+{
+	return bin.mData.substr(8);
+}
+
+TEST(libretroshare_pqi, pqistreamer_Coalescing_Interactive)
+{
+	TestBin bin;
+	TestStreamer streamer(&bin);
+
+	std::string expected;
+	expected += streamer.queue(100, 'a');
+	expected += streamer.queue(100, 'b');
+	streamer.send();
+
+	/* a few small items are sent at once, without waiting for more data */
+	ASSERT_EQ(bin.mWrites.size(), 1u);
+	EXPECT_EQ(streamData(bin), expected);
+
+	expected += streamer.queue(300, 'c');
+	streamer.send();
+	ASSERT_EQ(bin.mWrites.size(), 2u);
+	EXPECT_EQ(bin.mWrites[1], 300);
+	EXPECT_EQ(streamData(bin), expected);
+}
+
+TEST(libretroshare_pqi, pqistreamer_Coalescing_Bulk)
+{
+	TestBin bin;
+	TestStreamer streamer(&bin);
+
+	std::string expected;
+	for (int i = 0; i < 200; ++i) {
+		expected += streamer.queue(1000, 'a' + i % 26);
+	}
+	streamer.send();
+
+	/* bulk data is written by TLS record sized blocks */
+	ASSERT_GT(bin.mWrites.size(), 1u);
+	for (size_t i = 0; i < bin.mWrites.size(); ++i) {
+		EXPECT_GE(bin.mWrites[i], 15000);
+		EXPECT_LE(bin.mWrites[i], 16384);
+	}
+
+	/* the tail is kept a short while for more data... */
+	size_t writes = bin.mWrites.size();
+	EXPECT_LT(bin.mData.size(), expected.size() + 8);
+
+	expected += streamer.queue(500, 'z');
+	streamer.send();
+	EXPECT_EQ(bin.mWrites.size(), writes);
+
+	/* ...and then sent, even if no more data came */
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	streamer.send();
+	EXPECT_EQ(bin.mWrites.size(), writes + 1);
+	EXPECT_EQ(streamData(bin), expected);
+}
+
+/* Sends nb_items items through a pqistreamer over a TLS connection on a
+ * socket pair, queueing them one by one (interactive traffic) or all at
+ * once (bulk), and returns the throughput in MB/s */
+static double measureTlsThroughput(bool bulk, uint32_t nb_items, uint32_t item_size, uint32_t& records)
+{
+	TlsSocketPair tls;
+	if (!tls.isConnected()) {
+		return 0;
+	}
+
+	uint64_t total = uint64_t(nb_items) * item_size;
+	uint64_t received = 0;
+
+	std::thread reader([&]() {
+		std::vector<char> buffer(65536);
+		while (received < total + 8) {
+			int n = SSL_read(tls.mServer, buffer.data(), buffer.size());
+			if (n <= 0) {
+				break;
+			}
+			received += n;
+		}
+	});
+
+	TestBin bin(tls.mClient);
+	TestStreamer streamer(&bin);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (bulk) {
+		for (uint32_t i = 0; i < nb_items; ++i) {
+			streamer.queue(item_size, 'x');
+		}
+		while (bin.mRecords == 0 || received < total + 8) {
+			streamer.send();
+			if (received < total + 8) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+	} else {
+		for (uint32_t i = 0; i < nb_items; ++i) {
+			streamer.queue(item_size, 'x');
+			streamer.send();
+		}
+	}
+	reader.join();
+
+	double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	records = bin.mRecords;
+
+	return total / (1024.0 * 1024.0) / secs;
+}
+
+TEST(libretroshare_pqi, pqistreamer_Coalescing_TlsThroughput)
+{
+	const uint32_t nb_items = 16384;
+	const uint32_t item_size = 512;
+	uint32_t single_records = 0;
+	uint32_t bulk_records = 0;
+
+	double single = measureTlsThroughput(false, nb_items, item_size, single_records);
+	double bulk = measureTlsThroughput(true, nb_items, item_size, bulk_records);
+
+	std::cerr << "pqistreamer over TLS, " << nb_items << " items of " << item_size << " bytes:" << std::endl;
+	std::cerr << "  one write per item : " << single << " MB/s, " << single_records << " writes" << std::endl;
+	std::cerr << "  coalesced writes   : " << bulk << " MB/s, " << bulk_records << " writes" << std::endl;
+
+	ASSERT_GT(single, 0);
+	ASSERT_GT(bulk, 0);
+	EXPECT_LT(bulk_records * 20, single_records);
+	EXPECT_GT(bulk, single);
+}
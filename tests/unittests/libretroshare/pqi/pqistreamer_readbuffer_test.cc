@@ -0,0 +1,342 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/pqistreamer_readbuffer_test.cc                  *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+
+#include <random>
+#include <thread>
+
+#include "pqi/pqistreamer.h"
+#include "rsitems/rsitem.h"
+#include "serialiser/rsserial.h"
+#include "serialiser/rsserializer.h"
+
+#include "tls_support.h"
+
+static const uint32_t TEST_ITEM_TYPE = 0x02aa0002;
+
+/* Serialised raw item of the given size, filled with a pattern depending on n */
+static std::string makeItem(uint32_t size, uint32_t n)
+{
+	std::string item(size, '\0');
+	for (uint32_t i = 8; i < size; ++i) {
+		item[i] = char(n + i);
+	}
+	setRsItemHeader(&item[0], size, TEST_ITEM_TYPE, size);
+	return item;
+}
+
+/* Cuts an item into slices, the way pqistreamer sends large items to recent peers */
+static std::string makeSlices(const std::string& item, uint32_t packet_id, uint32_t slice_size)
+{
+	std::string slices;
+	for (uint32_t offset = 0; offset < item.size(); offset += slice_size) {
+		uint32_t len = std::min<uint32_t>(slice_size, item.size() - offset);
+		uint8_t flags = 0x00;
+		if (offset == 0) {
+			flags = 0x01;
+		} else if (offset + len == item.size()) {
+			flags = 0x02;
+		}
+		uint8_t header[8] = { 0x10, flags, uint8_t(packet_id >> 24), uint8_t(packet_id >> 16),
+		                      uint8_t(packet_id >> 8), uint8_t(packet_id), uint8_t(len >> 8), uint8_t(len) };
+		slices.append((const char*) header, 8);
+		slices.append(item, offset, len);
+	}
+	return slices;
+}
+
+/* Reads a stream from memory, giving it by chunks of random sizes when
+ * available data is read */
+class MemReadBin: public BinInterface
+{
+public:
+	MemReadBin(const std::string& data, bool buffered) : mData(data), mPos(0), mBuffered(buffered), mRandom(42) {}
+
+	virtual int tick() { return 1; }
+	virtual int senddata(void *, int len) { return len; }
+	virtual int readdata(void *data, int len)
+	{
+		if (mPos + len > mData.size()) {
+			return -1;
+		}
+		memcpy(data, &mData[mPos], len);
+		mPos += len;
+		return len;
+	}
+	virtual int readavailable(void *data, int len)
+	{
+		int n = std::min<int>(std::min<int>(len, mData.size() - mPos), mRandom() % 5000 + 1);
+		memcpy(data, &mData[mPos], n);
+		mPos += n;
+		return n;
+	}
+	virtual bool readsAvailableData() { return mBuffered; }
+	virtual int netstatus() { return 1; }
+	virtual int isactive() { return 1; }
+	virtual bool moretoread(uint32_t) { return mPos < mData.size(); }
+	virtual bool cansend(uint32_t) { return true; }
+	virtual int close() { return 1; }
+	virtual RsFileHash gethash() { return RsFileHash(); }
+	virtual bool bandwidthLimited() { return false; }
+
+	std::string mData;
+	size_t mPos;
+	bool mBuffered;
+	std::mt19937 mRandom;
+};
+
+/* Reads from the server side of a TLS connection, like pqissl does */
+class TlsReadBin: public BinInterface
+{
+public:
+	TlsReadBin(SSL *ssl, int fd, bool buffered) : mSsl(ssl), mFd(fd), mBuffered(buffered), mPartial(0), mSslReads(0) {}
+
+	virtual int tick() { return 1; }
+	virtual int senddata(void *, int len) { return len; }
+
+	/* all or nothing: a partly read packet is completed by the next calls */
+	virtual int readdata(void *data, int len)
+	{
+		while (mPartial < len) {
+			++mSslReads;
+			int n = SSL_read(mSsl, (char*) data + mPartial, len - mPartial);
+			if (n <= 0) {
+				return -1;
+			}
+			mPartial += n;
+		}
+		mPartial = 0;
+		return len;
+	}
+	virtual int readavailable(void *data, int len)
+	{
+		int read_len = 0;
+		while (read_len < len) {
+			++mSslReads;
+			int n = SSL_read(mSsl, (char*) data + read_len, len - read_len);
+			if (n <= 0) {
+				break;
+			}
+			read_len += n;
+		}
+		return read_len;
+	}
+	virtual bool readsAvailableData() { return mBuffered; }
+	virtual int netstatus() { return 1; }
+	virtual int isactive() { return 1; }
+	virtual bool moretoread(uint32_t usec)
+	{
+		if (SSL_pending(mSsl) > 0) {
+			return true;
+		}
+		struct pollfd pfd = { mFd, POLLIN, 0 };
+		return poll(&pfd, 1, usec / 1000) > 0;
+	}
+	virtual bool cansend(uint32_t) { return true; }
+	virtual int close() { return 1; }
+	virtual RsFileHash gethash() { return RsFileHash(); }
+	virtual bool bandwidthLimited() { return false; }
+
+	SSL *mSsl;
+	int mFd;
+	bool mBuffered;
+	int mPartial;
+	uint64_t mSslReads;
+};
+
+class TestStreamer: public pqistreamer
+{
+public:
+	TestStreamer(BinInterface *bio) : pqistreamer(createSerialiser(), RsPeerId::random(), bio, BIN_FLAGS_NO_CLOSE)
+	{
+		setMaxRate(true, 1e9);
+	}
+
+	static RsSerialiser *createSerialiser()
+	{
+		RsSerialiser *rss = new RsSerialiser();
+		rss->addSerialType(new RsRawSerialiser());
+		return rss;
+	}
+
+	/* receives until nb_items items arrived or nothing can be read anymore */
+	std::vector<std::string> receive(size_t nb_items, uint32_t timeout)
+	{
+		std::vector<std::string> items;
+		int idle_rounds = 0;
+
+		while (items.size() < nb_items && idle_rounds < 1000) {
+			tick_recv(timeout);
+
+			size_t n = items.size();
+			RsItem *item;
+			while ((item = GetItem()) != NULL) {
+				/* the slicing probe comes out as an empty raw item */
+				RsRawItem *raw = dynamic_cast<RsRawItem*>(item);
+				if (raw && raw->getRawLength() > 8) {
+					items.push_back(std::string((const char*) raw->getRawData(), raw->getRawLength()));
+				}
+				delete item;
+			}
+			idle_rounds = (items.size() == n) ? idle_rounds + 1 : 0;
+		}
+		return items;
+	}
+};
+
+static const uint8_t PACKET_SLICING_PROBE[8] = { 0x02, 0xaa, 0xbb, 0xcc, 0x00, 0x00, 0x00, 0x08 };
+
+static std::string makeStream(std::vector<std::string>& expected)
+{
+	std::string stream((const char*) PACKET_SLICING_PROBE, 8);
+
+	for (uint32_t i = 0; i < 20000; ++i) {
+		std::string item;
+		if (i % 5000 == 1234) {
+			/* large packet, sent as a whole by old peers */
+			item = makeItem(100000 + i, i);
+			stream += item;
+		} else if (i % 1000 == 567) {
+			item = makeItem(3000 + i, i);
+			stream += makeSlices(item, i, 512);
+		} else {
+			item = makeItem(40 + (i * 37) % 260, i);
+			stream += item;
+		}
+		expected.push_back(item);
+	}
+	return stream;
+}
+
+TEST(libretroshare_pqi, pqistreamer_ReadBuffer_Parsing)
+{
+	std::vector<std::string> expected;
+	std::string stream = makeStream(expected);
+
+	for (int buffered = 0; buffered < 2; ++buffered) {
+		MemReadBin bin(stream, buffered);
+		TestStreamer streamer(&bin);
+
+		std::vector<std::string> items = streamer.receive(expected.size(), 0);
+
+		EXPECT_EQ(bin.mPos, stream.size());
+		ASSERT_EQ(items.size(), expected.size()) << "buffered=" << buffered;
+		for (size_t i = 0; i < items.size(); ++i) {
+			ASSERT_EQ(items[i], expected[i]) << "item " << i << ", buffered=" << buffered;
+		}
+	}
+}
+
+/* An old style header whose size field is smaller than the header itself must
+ * be rejected, instead of being parsed as an empty packet over and over. */
+TEST(libretroshare_pqi, pqistreamer_ReadBuffer_TruncatedHeader)
+{
+	for (uint32_t bad_size = 0; bad_size < 8; ++bad_size) {
+		std::vector<std::string> expected;
+		std::string stream((const char*) PACKET_SLICING_PROBE, 8);
+
+		for (uint32_t i = 0; i < 10; ++i) {
+			expected.push_back(makeItem(40 + i, i));
+			stream += expected.back();
+		}
+		std::string bad_header(8, '\0');
+		setRsItemHeader(&bad_header[0], 8, TEST_ITEM_TYPE, bad_size);
+		stream += bad_header;
+
+		MemReadBin bin(stream, true);
+		TestStreamer streamer(&bin);
+
+		std::vector<std::string> items = streamer.receive(expected.size() + 1, 0);
+
+		EXPECT_EQ(bin.mPos, stream.size());
+		ASSERT_EQ(items.size(), expected.size()) << "size=" << bad_size;
+		for (size_t i = 0; i < items.size(); ++i) {
+			ASSERT_EQ(items[i], expected[i]) << "item " << i << ", size=" << bad_size;
+		}
+	}
+}
+
+static double threadCpuTime()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Sends a stream of small items (chat, status, GXS sync...) over a TLS
+ * connection and returns the number of packets received per second of CPU
+ * time of the receiving thread (the sender is slower than the receiver) */
+static double measureTlsPacketRate(bool buffered, const std::string& stream, size_t nb_items, uint64_t& ssl_reads)
+{
+	TlsSocketPair tls;
+	if (!tls.isConnected()) {
+		return 0;
+	}
+	tls.setServerNonBlocking();
+
+	TlsReadBin bin(tls.mServer, tls.mServerFd, buffered);
+	TestStreamer streamer(&bin);
+
+	std::thread writer([&]() {
+		for (size_t offset = 0; offset < stream.size(); offset += 16384) {
+			if (SSL_write(tls.mClient, &stream[offset], std::min<size_t>(16384, stream.size() - offset)) <= 0) {
+				break;
+			}
+		}
+	});
+
+	double start = threadCpuTime();
+	size_t received = streamer.receive(nb_items, 1000).size();
+	double secs = threadCpuTime() - start;
+
+	writer.join();
+	ssl_reads = bin.mSslReads;
+
+	return (received == nb_items) ? nb_items / secs : 0;
+}
+
+TEST(libretroshare_pqi, pqistreamer_ReadBuffer_TlsPacketRate)
+{
+	std::string stream((const char*) PACKET_SLICING_PROBE, 8);
+	const size_t nb_items = 200000;
+	for (uint32_t i = 0; i < nb_items; ++i) {
+		stream += makeItem(40 + (i * 37) % 260, i);
+	}
+
+	uint64_t single_reads = 0;
+	uint64_t buffered_reads = 0;
+	double single = measureTlsPacketRate(false, stream, nb_items, single_reads);
+	double buffered = measureTlsPacketRate(true, stream, nb_items, buffered_reads);
+
+	std::cerr << "pqistreamer over TLS, " << nb_items << " items of 40-300 bytes:" << std::endl;
+	std::cerr << "  one read per header/body : " << single << " packets/s, " << single_reads << " SSL_read calls" << std::endl;
+	std::cerr << "  buffered reads           : " << buffered << " packets/s, " << buffered_reads << " SSL_read calls" << std::endl;
+
+	/* the packet rates are only reported: on a loopback connection, most SSL_read()
+	 * calls of the unbuffered reads are served from OpenSSL's buffer, without a syscall. */
+	ASSERT_GT(single, 0);
+	ASSERT_GT(buffered, 0);
+	EXPECT_LT(buffered_reads * 20, single_reads);
+}
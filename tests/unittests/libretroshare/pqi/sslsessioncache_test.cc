@@ -0,0 +1,264 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/sslsessioncache_test.cc                         *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "pqi/sslsessioncache.h"
+#include "pqi/sslfns.h"
+
+#include "tls_support.h"
+
+static int verifyCalls = 0;
+
+/* stands for AuthSSL::VerifyX509Callback, which accepts the self-signed certificates */
+static int countingVerifyCallback(int /*preverify_ok*/, X509_STORE_CTX * /*ctx*/)
+{
+	++verifyCalls;
+	return 1;
+}
+
+static double now_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* Two RetroShare-like nodes: both authenticate the other side, and the
+ * client side keeps the sessions in a SslSessionCache. */
+class SslSessionCacheTest : public ::testing::Test
+{
+protected:
+	SslSessionCacheTest() : mClientCache(3600, 16), mServerCache(3600, 16) {}
+
+	virtual void SetUp()
+	{
+		verifyCalls = 0;
+
+		mServerKey = createTestKey(true);
+		mServerCert = createTestCertificate(mServerKey);
+		mClientKey = createTestKey(true);
+		mClientCert = createTestCertificate(mClientKey);
+
+		ASSERT_TRUE(getX509id(mServerCert, mServerId));
+
+		mServerCtx = createContext(TLS_server_method(), mServerCert, mServerKey);
+		mServerCache.setup(mServerCtx);
+		mClientCtx = createContext(TLS_client_method(), mClientCert, mClientKey);
+		mClientCache.setup(mClientCtx);
+	}
+
+	virtual void TearDown()
+	{
+		mClientCache.clear();
+		SSL_CTX_free(mClientCtx);
+		SSL_CTX_free(mServerCtx);
+		X509_free(mClientCert);
+		X509_free(mServerCert);
+		EVP_PKEY_free(mClientKey);
+		EVP_PKEY_free(mServerKey);
+	}
+
+	static SSL_CTX *createContext(const SSL_METHOD *method, X509 *cert, EVP_PKEY *key)
+	{
+		SSL_CTX *ctx = SSL_CTX_new(method);
+		SSL_CTX_use_certificate(ctx, cert);
+		SSL_CTX_use_PrivateKey(ctx, key);
+		SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, countingVerifyCallback);
+		return ctx;
+	}
+
+	/* Connects to the server, exchanges a byte so that the client gets the
+	 * session tickets, and disconnects.
+	 * Returns the handshake duration in microseconds, or a negative value on failure. */
+	double connectOnce(bool resume, bool& clientReused, bool& serverReused)
+	{
+		int fds[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+			return -1;
+		}
+
+		SSL *server = SSL_new(mServerCtx);
+		SSL_set_fd(server, fds[0]);
+		SSL *client = SSL_new(mClientCtx);
+		SSL_set_fd(client, fds[1]);
+
+		if (resume) {
+			mClientCache.prepareConnection(client, mServerId);
+		}
+
+		bool accepted = false;
+		char c = 'x';
+
+		double start = now_us();
+		std::thread peer([&]() {
+			accepted = (SSL_accept(server) == 1);
+			if (accepted) {
+				SSL_write(server, &c, 1);
+			}
+		});
+
+		bool connected = (SSL_connect(client) == 1);
+		if (!connected) {
+			shutdown(fds[1], SHUT_RDWR);
+		}
+		peer.join();
+		double elapsed = now_us() - start;
+
+		bool ok = connected && accepted && SSL_read(client, &c, 1) == 1;
+
+		clientReused = SSL_session_reused(client);
+		serverReused = SSL_session_reused(server);
+
+		SSL_shutdown(client);
+		SSL_free(client);
+		SSL_free(server);
+		close(fds[0]);
+		close(fds[1]);
+
+		return ok ? elapsed : -1;
+	}
+
+	SslSessionCache mClientCache;
+	SslSessionCache mServerCache;
+	SSL_CTX *mServerCtx;
+	SSL_CTX *mClientCtx;
+	EVP_PKEY *mServerKey;
+	EVP_PKEY *mClientKey;
+	X509 *mServerCert;
+	X509 *mClientCert;
+	RsPeerId mServerId;
+};
+
+TEST_F(SslSessionCacheTest, ResumesSessions)
+{
+	bool clientReused, serverReused;
+
+	ASSERT_GT(connectOnce(true, clientReused, serverReused), 0);
+	EXPECT_FALSE(clientReused);
+	EXPECT_FALSE(serverReused);
+
+	int fullHandshakeCalls = verifyCalls;
+	EXPECT_GT(fullHandshakeCalls, 0);
+
+	// only the client side keeps sessions
+	EXPECT_EQ(1u, mClientCache.size());
+	EXPECT_EQ(0u, mServerCache.size());
+
+	// the certificates are not verified again on resumption
+	ASSERT_GT(connectOnce(true, clientReused, serverReused), 0);
+	EXPECT_TRUE(clientReused);
+	EXPECT_TRUE(serverReused);
+	EXPECT_EQ(fullHandshakeCalls, verifyCalls);
+
+	// unknown peers get a full handshake
+	SSL *ssl = SSL_new(mClientCtx);
+	EXPECT_FALSE(mClientCache.prepareConnection(ssl, RsPeerId::random()));
+	SSL_free(ssl);
+}
+
+TEST_F(SslSessionCacheTest, RemovedSessionIsNotResumed)
+{
+	bool clientReused, serverReused;
+
+	ASSERT_GT(connectOnce(true, clientReused, serverReused), 0);
+	int fullHandshakeCalls = verifyCalls;
+
+	mClientCache.removeSession(mServerId);
+	EXPECT_EQ(0u, mClientCache.size());
+
+	ASSERT_GT(connectOnce(true, clientReused, serverReused), 0);
+	EXPECT_FALSE(clientReused);
+	EXPECT_EQ(2 * fullHandshakeCalls, verifyCalls);
+
+	mClientCache.clear();
+	EXPECT_EQ(0u, mClientCache.size());
+}
+
+TEST_F(SslSessionCacheTest, ReconnectLatency)
+{
+	const int count = 40;
+	bool clientReused, serverReused;
+
+	std::vector<double> full, resumed;
+
+	for (int i = 0; i < count; ++i) {
+		double t = connectOnce(false, clientReused, serverReused);
+		ASSERT_GT(t, 0);
+		ASSERT_FALSE(clientReused);
+		full.push_back(t);
+
+		t = connectOnce(true, clientReused, serverReused);
+		ASSERT_GT(t, 0);
+		ASSERT_TRUE(clientReused);
+		resumed.push_back(t);
+	}
+
+	std::sort(full.begin(), full.end());
+	std::sort(resumed.begin(), resumed.end());
+
+	double full_median = full[count / 2];
+	double resumed_median = resumed[count / 2];
+
+	std::cerr << "Reconnection handshake, median of " << count << ": full " << full_median
+	          << " us, resumed " << resumed_median << " us" << std::endl;
+
+	// resumed handshakes skip the RSA signatures and the certificate checks
+	EXPECT_LT(resumed_median, full_median);
+}
+
+TEST(SslCertAuthCacheTest, RemembersCertificates)
+{
+	EVP_PKEY *key = createTestKey();
+	X509 *cert1 = createTestCertificate(key);
+	X509 *cert2 = createTestCertificate(key);
+
+	// another certificate of the same key
+	ASN1_INTEGER_set(X509_get_serialNumber(cert2), 2);
+	X509_sign(cert2, key, EVP_sha256());
+
+	SslCertAuthCache cache(3600, 1);
+
+	EXPECT_FALSE(cache.isAuthenticated(cert1));
+	cache.setAuthenticated(cert1);
+	EXPECT_TRUE(cache.isAuthenticated(cert1));
+	EXPECT_FALSE(cache.isAuthenticated(cert2));
+
+	// the cache is full, cert1 is dropped
+	cache.setAuthenticated(cert2);
+	EXPECT_TRUE(cache.isAuthenticated(cert2));
+	EXPECT_FALSE(cache.isAuthenticated(cert1));
+
+	cache.clear();
+	EXPECT_FALSE(cache.isAuthenticated(cert2));
+
+	X509_free(cert2);
+	X509_free(cert1);
+	EVP_PKEY_free(key);
+}
@@ -0,0 +1,115 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/tls_support.cc                                  *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include "tls_support.h"
+
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include <openssl/x509.h>
+#include <openssl/evp.h>
+
+EVP_PKEY *createTestKey(bool rsa)
+{
+	EVP_PKEY *key = NULL;
+	EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_id(rsa ? EVP_PKEY_RSA : EVP_PKEY_EC, NULL);
+	EVP_PKEY_keygen_init(ctx);
+	if (rsa) {
+		EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048);
+	} else {
+		EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx, NID_X9_62_prime256v1);
+	}
+	EVP_PKEY_keygen(ctx, &key);
+	EVP_PKEY_CTX_free(ctx);
+	return key;
+}
+
+X509 *createTestCertificate(EVP_PKEY *key)
+{
+	X509 *x509 = X509_new();
+	ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+	X509_gmtime_adj(X509_get_notBefore(x509), 0);
+	X509_gmtime_adj(X509_get_notAfter(x509), 3600);
+	X509_set_pubkey(x509, key);
+	X509_NAME_add_entry_by_txt(X509_get_subject_name(x509), "CN", MBSTRING_ASC, (const unsigned char*) "test", -1, -1, 0);
+	X509_set_issuer_name(x509, X509_get_subject_name(x509));
+	X509_sign(x509, key, EVP_sha256());
+	return x509;
+}
+
+TlsSocketPair::TlsSocketPair()
+    : mServer(NULL), mClient(NULL), mServerFd(-1), mClientFd(-1),
+      mServerCtx(NULL), mClientCtx(NULL), mKey(NULL), mCert(NULL), mConnected(false)
+{
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+		return;
+	}
+	mServerFd = fds[0];
+	mClientFd = fds[1];
+
+	mKey = createTestKey();
+	mCert = createTestCertificate(mKey);
+
+	mServerCtx = SSL_CTX_new(TLS_server_method());
+	SSL_CTX_use_certificate(mServerCtx, mCert);
+	SSL_CTX_use_PrivateKey(mServerCtx, mKey);
+	mClientCtx = SSL_CTX_new(TLS_client_method());
+
+	mServer = SSL_new(mServerCtx);
+	SSL_set_fd(mServer, mServerFd);
+	mClient = SSL_new(mClientCtx);
+	SSL_set_fd(mClient, mClientFd);
+
+	bool accepted = false;
+	std::thread server([&]() { accepted = (SSL_accept(mServer) == 1); });
+
+	bool connected = (SSL_connect(mClient) == 1);
+	if (!connected) {
+		shutdown(mClientFd, SHUT_RDWR);
+	}
+	server.join();
+
+	mConnected = connected && accepted;
+}
+
+TlsSocketPair::~TlsSocketPair()
+{
+	SSL_free(mClient);
+	SSL_free(mServer);
+	SSL_CTX_free(mClientCtx);
+	SSL_CTX_free(mServerCtx);
+	X509_free(mCert);
+	EVP_PKEY_free(mKey);
+	if (mServerFd >= 0) {
+		close(mServerFd);
+	}
+	if (mClientFd >= 0) {
+		close(mClientFd);
+	}
+}
+
+void TlsSocketPair::setServerNonBlocking()
+{
+	fcntl(mServerFd, F_SETFL, fcntl(mServerFd, F_GETFL) | O_NONBLOCK);
+}
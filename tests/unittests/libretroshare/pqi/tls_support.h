@@ -0,0 +1,53 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/tls_support.h                                   *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#pragma once
+
+#include <openssl/ssl.h>
+
+/* throw-away keys and self-signed certificates */
+EVP_PKEY *createTestKey(bool rsa = false);
+X509 *createTestCertificate(EVP_PKEY *key);
+
+/* A TLS connection between the two ends of a socket pair, with a throw-away
+ * self-signed certificate. The handshake is done by the constructor. */
+class TlsSocketPair
+{
+public:
+	TlsSocketPair();
+	~TlsSocketPair();
+
+	bool isConnected() const { return mConnected; }
+
+	/* make the reads of the server side return immediately */
+	void setServerNonBlocking();
+
+	SSL *mServer;
+	SSL *mClient;
+	int mServerFd;
+	int mClientFd;
+
+private:
+	SSL_CTX *mServerCtx;
+	SSL_CTX *mClientCtx;
+	EVP_PKEY *mKey;
+	X509 *mCert;
+	bool mConnected;
+};
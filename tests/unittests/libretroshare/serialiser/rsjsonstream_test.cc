@@ -0,0 +1,129 @@
+/*******************************************************************************
+ * unittests/libretroshare/serialiser/rsjsonstream_test.cc                     *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+#include <list>
+#include <set>
+
+#ifdef HAS_RAPIDJSON
+#	include <rapidjson/writer.h>
+#	include <rapidjson/prettywriter.h>
+#else
+#	include <rapid_json/writer.h>
+#	include <rapid_json/prettywriter.h>
+#endif // HAS_RAPIDJSON
+
+#include "serialiser/rstypeserializer.h"
+#include "serialiser/rsserializable.h"
+#include "retroshare/rsids.h"
+#include "util/rsjson.h"
+
+struct JsonStreamTestEntry : RsSerializable
+{
+	std::string mName;
+	uint32_t mCount;
+	std::vector<std::string> mTags;
+	RsPeerId mPeerId;
+
+	void serial_process( RsGenericSerializer::SerializeJob j,
+	                     RsGenericSerializer::SerializeContext& ctx ) override
+	{
+		RS_SERIAL_PROCESS(mName);
+		RS_SERIAL_PROCESS(mCount);
+		RS_SERIAL_PROCESS(mTags);
+		RS_SERIAL_PROCESS(mPeerId);
+	}
+};
+
+TEST(libretroshare_serialiser, RsTypeSerializer_to_JSON_stream)
+{
+	std::vector<JsonStreamTestEntry> entries(200);
+	for(uint32_t i = 0; i < entries.size(); ++i)
+	{
+		entries[i].mName = "entry " + std::to_string(i);
+		entries[i].mCount = i;
+		entries[i].mTags.assign(i % 5, std::string(i, 'x'));
+		entries[i].mPeerId = RsPeerId::random();
+	}
+	std::list<std::string> names = { "one", "two", "three" };
+	std::set<RsPeerId> peers = { RsPeerId::random(), RsPeerId::random() };
+	JsonStreamTestEntry single = entries[42];
+	bool retval = true;
+
+	// Reference answer built into a Document like the old JSON API wrappers
+	RsGenericSerializer::SerializeContext cAns;
+	{
+		RsGenericSerializer::SerializeContext& ctx(cAns);
+		RsGenericSerializer::SerializeJob j(RsGenericSerializer::TO_JSON);
+		RS_SERIAL_PROCESS(entries);
+		RS_SERIAL_PROCESS(names);
+		RS_SERIAL_PROCESS(peers);
+		RS_SERIAL_PROCESS(single);
+		RS_SERIAL_PROCESS(retval);
+	}
+	std::vector<uint8_t> domBytes;
+	rsJsonCompactWrite(cAns.mJson, domBytes);
+
+	std::vector<uint8_t> streamBytes;
+	RsJsonByteStream os(streamBytes);
+	rapidjson::Writer<RsJsonByteStream> writer(os);
+	writer.StartObject();
+	EXPECT_TRUE(RsTypeSerializer::to_JSON_stream(writer, entries, "entries"));
+	EXPECT_TRUE(RsTypeSerializer::to_JSON_stream(writer, names, "names"));
+	EXPECT_TRUE(RsTypeSerializer::to_JSON_stream(writer, peers, "peers"));
+	EXPECT_TRUE(RsTypeSerializer::to_JSON_stream(writer, single, "single"));
+	EXPECT_TRUE(RsTypeSerializer::to_JSON_stream(writer, retval, "retval"));
+	writer.EndObject();
+
+	EXPECT_TRUE(writer.IsComplete());
+	EXPECT_EQ(streamBytes, domBytes);
+
+	// JSON API answers are pretty printed, streaming must not change that
+	std::vector<uint8_t> prettyDomBytes;
+	rsJsonPrettyWrite(cAns.mJson, prettyDomBytes);
+
+	std::vector<uint8_t> prettyStreamBytes;
+	RsJsonByteStream pos(prettyStreamBytes);
+	rapidjson::PrettyWriter<RsJsonByteStream> pWriter(pos);
+	pWriter.StartObject();
+	EXPECT_TRUE(RsTypeSerializer::to_JSON_stream(pWriter, entries, "entries"));
+	EXPECT_TRUE(RsTypeSerializer::to_JSON_stream(pWriter, names, "names"));
+	EXPECT_TRUE(RsTypeSerializer::to_JSON_stream(pWriter, peers, "peers"));
+	EXPECT_TRUE(RsTypeSerializer::to_JSON_stream(pWriter, single, "single"));
+	EXPECT_TRUE(RsTypeSerializer::to_JSON_stream(pWriter, retval, "retval"));
+	pWriter.EndObject();
+
+	EXPECT_TRUE(pWriter.IsComplete());
+	EXPECT_EQ(prettyStreamBytes, prettyDomBytes);
+
+	// Empty containers must still produce an empty array
+	std::vector<JsonStreamTestEntry> empty;
+	std::vector<uint8_t> emptyBytes;
+	RsJsonByteStream eos(emptyBytes);
+	rapidjson::Writer<RsJsonByteStream> eWriter(eos);
+	eWriter.StartObject();
+	EXPECT_TRUE(RsTypeSerializer::to_JSON_stream(eWriter, empty, "empty"));
+	eWriter.EndObject();
+	EXPECT_EQ( std::string(emptyBytes.begin(), emptyBytes.end()),
+	           "{\"empty\":[]}" );
+}
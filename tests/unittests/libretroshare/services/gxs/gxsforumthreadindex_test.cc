@@ -0,0 +1,195 @@
+/*******************************************************************************
+ * unittests/libretroshare/services/gxs/gxsforumthreadindex_test.cc            *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <cstdio>
+
+// from libretroshare
+#include "services/gxsforumthreadindex.h"
+
+#define THREAD_INDEX_DB_NAME "gxsforumthreadindex_test_db"
+
+static GxsForumThreadIndexRecord record(
+        const RsGxsMessageId& msgId, const RsGxsMessageId& parentId,
+        rstime_t publishTs )
+{
+	GxsForumThreadIndexRecord r;
+	r.mMsgId = msgId;
+	r.mParentId = parentId;
+	r.mPublishTs = publishTs;
+	return r;
+}
+
+TEST(libretroshare_services, GxsForumThreadIndex)
+{
+	remove(THREAD_INDEX_DB_NAME);
+
+	RsGxsGroupId forumId = RsGxsGroupId::random();
+	RsGxsGroupId otherForumId = RsGxsGroupId::random();
+	RsGxsMessageId nullId;
+
+	RsGxsMessageId t1 = RsGxsMessageId::random();
+	RsGxsMessageId t2 = RsGxsMessageId::random();
+	RsGxsMessageId r1 = RsGxsMessageId::random();
+	RsGxsMessageId r2 = RsGxsMessageId::random();
+
+	{
+		GxsForumThreadIndex index(THREAD_INDEX_DB_NAME, "");
+		ASSERT_TRUE(index.isOpen());
+		EXPECT_FALSE(index.isIndexed(forumId));
+
+		std::vector<GxsForumThreadIndexRecord> records;
+		records.push_back(record(t1, nullId, 100));
+		records.push_back(record(t2, nullId, 200));
+		EXPECT_TRUE(index.buildIndex(forumId, records));
+		EXPECT_TRUE(index.isIndexed(forumId));
+		EXPECT_FALSE(index.addMessage(forumId, record(t2, nullId, 200)));
+
+		// r2 arrives before its parent r1, it is a top level thread until then
+		EXPECT_TRUE(index.addMessage(forumId, record(r2, r1, 400)));
+		EXPECT_EQ(index.threadsCount(forumId), 3u);
+
+		records.clear();
+		records.push_back(record(r1, t1, 300));
+		EXPECT_TRUE(index.addMessages(forumId, records));
+		EXPECT_EQ(index.threadsCount(forumId), 2u);
+		EXPECT_EQ(index.messagesCount(forumId), 4u);
+
+		// other forums are not affected
+		EXPECT_TRUE(index.addMessage(otherForumId, record(t1, nullId, 500)));
+		EXPECT_EQ(index.messagesCount(otherForumId), 1u);
+		EXPECT_EQ(index.messagesCount(forumId), 4u);
+	}
+
+	// the index lives in the database, nothing has to be saved on exit
+	GxsForumThreadIndex index(THREAD_INDEX_DB_NAME, "");
+	ASSERT_TRUE(index.isOpen());
+	EXPECT_TRUE(index.isIndexed(forumId));
+	EXPECT_FALSE(index.isIndexed(otherForumId));
+
+	// t1 is now the most recently active thread
+	std::vector<RsGxsMessageId> page;
+	EXPECT_TRUE(index.getThreadsPage(forumId, 0, 1, page));
+	ASSERT_EQ(page.size(), 1u);
+	EXPECT_EQ(page[0], t1);
+
+	EXPECT_TRUE(index.getThreadsPage(forumId, 1, 10, page));
+	ASSERT_EQ(page.size(), 1u);
+	EXPECT_EQ(page[0], t2);
+
+	EXPECT_TRUE(index.getThreadsPage(forumId, 2, 10, page));
+	EXPECT_TRUE(page.empty());
+
+	rstime_t lastActivity;
+	uint32_t children, descendants;
+	EXPECT_TRUE(index.getStats(forumId, t1, lastActivity, children, descendants));
+	EXPECT_EQ(lastActivity, 400);
+	EXPECT_EQ(children, 1u);
+	EXPECT_EQ(descendants, 2u);
+
+	std::vector<RsGxsMessageId> subtree;
+	EXPECT_TRUE(index.getSubtree(forumId, t1, subtree));
+	ASSERT_EQ(subtree.size(), 3u);
+	EXPECT_EQ(subtree[0], t1);
+	EXPECT_EQ(subtree[1], r1);
+	EXPECT_EQ(subtree[2], r2);
+
+	// Removing r2 must bring t1 activity back to r1 publish time
+	EXPECT_TRUE(index.removeMessage(forumId, r2));
+	EXPECT_FALSE(index.removeMessage(forumId, r2));
+	EXPECT_TRUE(index.getStats(forumId, t1, lastActivity, children, descendants));
+	EXPECT_EQ(lastActivity, 300);
+	EXPECT_EQ(descendants, 1u);
+
+	EXPECT_TRUE(index.getThreadsPage(forumId, 0, 10, page));
+	ASSERT_EQ(page.size(), 2u);
+	EXPECT_EQ(page[0], t1);
+	EXPECT_EQ(page[1], t2);
+
+	// Removing r1 turns its children into threads, until it comes back
+	EXPECT_TRUE(index.addMessage(forumId, record(r2, r1, 400)));
+	EXPECT_TRUE(index.removeMessage(forumId, r1));
+	EXPECT_EQ(index.threadsCount(forumId), 3u);
+	EXPECT_TRUE(index.getStats(forumId, t1, lastActivity, children, descendants));
+	EXPECT_EQ(lastActivity, 100);
+	EXPECT_EQ(descendants, 0u);
+
+	EXPECT_TRUE(index.addMessage(forumId, record(r1, t1, 300)));
+	EXPECT_EQ(index.threadsCount(forumId), 2u);
+	EXPECT_TRUE(index.getStats(forumId, t1, lastActivity, children, descendants));
+	EXPECT_EQ(lastActivity, 400);
+	EXPECT_EQ(descendants, 2u);
+
+	// Parent loops forged by peers must not hang the index
+	RsGxsMessageId l1 = RsGxsMessageId::random();
+	RsGxsMessageId l2 = RsGxsMessageId::random();
+	EXPECT_TRUE(index.addMessage(forumId, record(l1, l2, 600)));
+	EXPECT_TRUE(index.addMessage(forumId, record(l2, l1, 700)));
+	EXPECT_TRUE(index.removeMessage(forumId, l1));
+	EXPECT_TRUE(index.getSubtree(forumId, l2, subtree));
+	EXPECT_EQ(subtree.size(), 1u);
+
+	EXPECT_TRUE(index.removeForum(forumId));
+	EXPECT_FALSE(index.isIndexed(forumId));
+	EXPECT_EQ(index.messagesCount(forumId), 0u);
+
+	remove(THREAD_INDEX_DB_NAME);
+}
+
+TEST(libretroshare_services, GxsForumThreadIndex_Paging)
+{
+	remove(THREAD_INDEX_DB_NAME);
+
+	GxsForumThreadIndex index(THREAD_INDEX_DB_NAME, "");
+	ASSERT_TRUE(index.isOpen());
+
+	RsGxsGroupId forumId = RsGxsGroupId::random();
+	std::vector<GxsForumThreadIndexRecord> records;
+	std::vector<RsGxsMessageId> threads;
+	for(uint32_t i = 0; i < 100; ++i)
+	{
+		threads.push_back(RsGxsMessageId::random());
+		records.push_back(record(threads.back(), RsGxsMessageId(), 1000 + i));
+
+		// a reply every other thread bumps its activity above the others
+		if(i % 2) records.push_back(record( RsGxsMessageId::random(),
+		                                    threads.back(), 5000 + i ));
+	}
+	EXPECT_TRUE(index.buildIndex(forumId, records));
+	EXPECT_EQ(index.threadsCount(forumId), 100u);
+	EXPECT_EQ(index.messagesCount(forumId), 150u);
+
+	std::vector<RsGxsMessageId> all, page;
+	for(uint32_t offset = 0; offset < 100; offset += 7)
+	{
+		EXPECT_TRUE(index.getThreadsPage(forumId, offset, 7, page));
+		all.insert(all.end(), page.begin(), page.end());
+	}
+	ASSERT_EQ(all.size(), 100u);
+
+	// replied threads first, most recent first, then the others
+	for(uint32_t i = 0; i < 50; ++i)
+	{
+		EXPECT_EQ(all[i], threads[99 - 2*i]);
+		EXPECT_EQ(all[50 + i], threads[98 - 2*i]);
+	}
+
+	remove(THREAD_INDEX_DB_NAME);
+}
@@ -0,0 +1,259 @@
+/*******************************************************************************
+ * unittests/libretroshare/services/gxs/gxsidpgphash_test.cc                   *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <cstring>
+
+// from libretroshare
+#include "services/p3idservice.h"
+#include "gxs/rsdataservice.h"
+#include "pgp/pgpauxutils.h"
+#include "util/rsdir.h"
+
+#define PGPHASH_TEST_DIR "gxsidpgphash_test"
+
+/* The hash p3IdService puts in PGP linked identities: SHA1 of the identity id
+ * string followed by the key fingerprint. */
+static void calcPGPHash(const RsGxsId &id, const PGPFingerprintType &pgp, Sha1CheckSum &hash)
+{
+	std::string data = id.toStdString();
+	data.append((const char*) pgp.toByteArray(), pgp.SIZE_IN_BYTES);
+	hash = RsDirUtil::sha1sum((const uint8_t*) data.data(), data.size());
+}
+
+/* Fake PGP signatures made of a tag byte, the issuer id and the signed hash.
+ * Only the 'K' tag can be parsed, so that the test also covers signatures
+ * whose issuer is unknown to checkId(). A signature only verifies with the
+ * fingerprint of its issuer, like a real one. */
+class SignaturePgpAuxUtils : public PgpAuxUtils
+{
+public:
+	void addKey(const RsPgpId& id)
+	{ mFingerprints[id] = PGPFingerprintType::random(); }
+
+	PGPFingerprintType fingerprint(const RsPgpId& id) const
+	{
+		std::map<RsPgpId,PGPFingerprintType>::const_iterator it = mFingerprints.find(id);
+		return it == mFingerprints.end() ? PGPFingerprintType() : it->second;
+	}
+
+	static std::string sign(char tag, const RsPgpId& issuer, const Sha1CheckSum& hash)
+	{
+		std::string sig(1, tag);
+		sig.append((const char*) issuer.toByteArray(), RsPgpId::SIZE_IN_BYTES);
+		sig.append((const char*) hash.toByteArray(), Sha1CheckSum::SIZE_IN_BYTES);
+		return sig;
+	}
+
+	virtual const RsPgpId &getPGPOwnId() { return mOwnId; }
+	virtual RsPgpId getPGPId(const RsPeerId&) { return RsPgpId(); }
+
+	virtual bool getGPGAllList(std::list<RsPgpId> &ids)
+	{
+		ids.clear();
+		for(auto it(mFingerprints.begin()); it != mFingerprints.end(); ++it)
+			ids.push_back(it->first);
+		return true;
+	}
+
+	virtual bool getKeyFingerprint(const RsPgpId& id, PGPFingerprintType& fp) const
+	{
+		fp = fingerprint(id);
+		return !fp.isNull();
+	}
+
+	virtual bool parseSignature(unsigned char *sign, unsigned int signlen, RsPgpId& issuer) const
+	{
+		if(signlen != SIGNATURE_SIZE || sign[0] != 'K') return false;
+		issuer = RsPgpId::fromBufferUnsafe(sign + 1);
+		return true;
+	}
+
+	virtual bool VerifySignBin( const void *data, uint32_t len, unsigned char *sign,
+	                            unsigned int signlen, const PGPFingerprintType& withfingerprint )
+	{
+		if(signlen != SIGNATURE_SIZE || len != Sha1CheckSum::SIZE_IN_BYTES) return false;
+		RsPgpId issuer = RsPgpId::fromBufferUnsafe(sign + 1);
+		return fingerprint(issuer) == withfingerprint
+		        && !memcmp(sign + 1 + RsPgpId::SIZE_IN_BYTES, data, len);
+	}
+
+	virtual bool askForDeferredSelfSignature( const void*, const uint32_t, unsigned char*,
+	                                          unsigned int*, int&, std::string )
+	{ return false; }
+
+	static const unsigned int SIGNATURE_SIZE = 1 + RsPgpId::SIZE_IN_BYTES + Sha1CheckSum::SIZE_IN_BYTES;
+
+private:
+	RsPgpId mOwnId;
+	std::map<RsPgpId, PGPFingerprintType> mFingerprints;
+};
+
+class p3IdServiceTester : public p3IdService
+{
+public:
+	p3IdServiceTester(RsGeneralDataService* gds, PgpAuxUtils* pgpUtils) :
+	    p3IdService(gds, NULL, pgpUtils) {}
+
+	void queueGroups(const std::list<RsGxsIdGroup>& groups)
+	{ mGroupsToProcess.insert(mGroupsToProcess.end(), groups.begin(), groups.end()); }
+
+	using p3IdService::pgphash_checkBatch;
+	using p3IdService::getPgpIdList;
+};
+
+/* p3IdService::checkId() as it was before the fingerprint index: the identity
+ * hash is computed with every known key. */
+static bool linearScanCheckId( const RsGxsIdGroup& grp, const std::list<RsPgpId>& keys,
+                               SignaturePgpAuxUtils& pgpUtils, RsPgpId& pgpId, bool& error )
+{
+	error = false;
+	if(!pgpUtils.parseSignature((unsigned char *) grp.mPgpIdSign.c_str(), grp.mPgpIdSign.length(), pgpId))
+		pgpId.clear();
+
+	for(auto it(keys.begin()); it != keys.end(); ++it)
+	{
+		Sha1CheckSum hash;
+		calcPGPHash(RsGxsId(grp.mMeta.mGroupId), pgpUtils.fingerprint(*it), hash);
+
+		if(hash == grp.mPgpIdHash)
+		{
+			if(pgpUtils.VerifySignBin( hash.toByteArray(), hash.SIZE_IN_BYTES,
+			                           (unsigned char *) grp.mPgpIdSign.c_str(),
+			                           grp.mPgpIdSign.length(), pgpUtils.fingerprint(*it) ))
+			{
+				pgpId = *it;
+				return true;
+			}
+			error = true;
+			return false;
+		}
+	}
+	return false;
+}
+
+TEST(libretroshare_services, GxsIdPgpHashBatch)
+{
+	RsDirUtil::checkCreateDirectory(PGPHASH_TEST_DIR);
+	RsDirUtil::cleanupDirectory(PGPHASH_TEST_DIR, std::set<std::string>());
+
+	SignaturePgpAuxUtils pgpUtils;
+	std::vector<RsPgpId> keys;
+	for(int i = 0; i < 50; ++i)
+	{
+		keys.push_back(RsPgpId::random());
+		pgpUtils.addKey(keys.back());
+	}
+	std::list<RsPgpId> knownKeys;
+	pgpUtils.getGPGAllList(knownKeys);
+
+	// One group per case, cycling through: signed by a known key, signed by an
+	// unknown key, signed by a known key with an unparsable signature, hash of
+	// a known key with a bad signature, and hash of no known key.
+	const uint32_t groupCount = 600;
+	std::list<RsGxsIdGroup> groups;
+	std::map<RsGxsGroupId, RsGxsIdGroup> groupsById;
+
+	for(uint32_t i = 0; i < groupCount; ++i)
+	{
+		RsGxsIdGroup grp;
+		grp.mMeta.mGroupId = RsGxsGroupId::random();
+		RsGxsId id(grp.mMeta.mGroupId);
+		RsPgpId key = keys[i % keys.size()];
+
+		switch(i % 5)
+		{
+		case 0:
+			calcPGPHash(id, pgpUtils.fingerprint(key), grp.mPgpIdHash);
+			grp.mPgpIdSign = SignaturePgpAuxUtils::sign('K', key, grp.mPgpIdHash);
+			break;
+		case 1:
+			calcPGPHash(id, PGPFingerprintType::random(), grp.mPgpIdHash);
+			grp.mPgpIdSign = SignaturePgpAuxUtils::sign('K', RsPgpId::random(), grp.mPgpIdHash);
+			break;
+		case 2:
+			calcPGPHash(id, pgpUtils.fingerprint(key), grp.mPgpIdHash);
+			grp.mPgpIdSign = SignaturePgpAuxUtils::sign('U', key, grp.mPgpIdHash);
+			break;
+		case 3:
+			calcPGPHash(id, pgpUtils.fingerprint(key), grp.mPgpIdHash);
+			grp.mPgpIdSign = SignaturePgpAuxUtils::sign('K', key, Sha1CheckSum::random());
+			break;
+		case 4:
+			calcPGPHash(id, PGPFingerprintType::random(), grp.mPgpIdHash);
+			grp.mPgpIdSign = SignaturePgpAuxUtils::sign('K', key, grp.mPgpIdHash);
+			break;
+		}
+
+		groups.push_back(grp);
+		groupsById[grp.mMeta.mGroupId] = grp;
+	}
+
+	RsDataService* gds = new RsDataService( PGPHASH_TEST_DIR, "gxsid_db",
+	                                        RS_SERVICE_GXS_TYPE_GXSID, NULL, "" );
+	p3IdServiceTester idService(gds, &pgpUtils);
+	idService.getPgpIdList();
+	idService.queueGroups(groups);
+
+	// The queue drains 256 identities at a time, and every result is the one
+	// the linear scan gives.
+	std::vector<uint32_t> batchSizes;
+	uint32_t matchCount = 0, errorCount = 0;
+
+	std::vector<RsGxsIdGroup> batch;
+	std::vector<RsPgpId> pgpIds;
+	std::vector<uint8_t> matches;
+	std::vector<uint8_t> errors;
+
+	while(idService.pgphash_checkBatch(batch, pgpIds, matches, errors))
+	{
+		batchSizes.push_back(batch.size());
+		ASSERT_EQ(pgpIds.size(), batch.size());
+		ASSERT_EQ(matches.size(), batch.size());
+		ASSERT_EQ(errors.size(), batch.size());
+
+		for(uint32_t i = 0; i < batch.size(); ++i)
+		{
+			ASSERT_EQ(groupsById.count(batch[i].mMeta.mGroupId), 1u);
+
+			RsPgpId expectedId;
+			bool expectedError = false;
+			bool expectedMatch = linearScanCheckId( batch[i], knownKeys, pgpUtils,
+			                                        expectedId, expectedError );
+
+			EXPECT_EQ(bool(matches[i]), expectedMatch);
+			EXPECT_EQ(bool(errors[i]), expectedError);
+			EXPECT_EQ(pgpIds[i], expectedId);
+
+			matchCount += matches[i];
+			errorCount += errors[i];
+			groupsById.erase(batch[i].mMeta.mGroupId);
+		}
+	}
+
+	ASSERT_EQ(batchSizes.size(), 3u);
+	EXPECT_EQ(batchSizes[0], 256u);
+	EXPECT_EQ(batchSizes[1], 256u);
+	EXPECT_EQ(batchSizes[2], groupCount - 512);
+	EXPECT_TRUE(groupsById.empty());
+
+	EXPECT_EQ(matchCount, 2*groupCount/5);
+	EXPECT_EQ(errorCount, groupCount/5);
+}
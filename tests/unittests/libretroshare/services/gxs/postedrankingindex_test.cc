@@ -0,0 +1,125 @@
+/*******************************************************************************
+ * unittests/libretroshare/services/gxs/postedrankingindex_test.cc             *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <cstdio>
+
+// from libretroshare
+#include "services/postedrankingindex.h"
+
+#define RANKING_DB_NAME "postedrankingindex_test_db"
+
+static PostedRankingRecord record(
+        const RsGxsMessageId& msgId, rstime_t publishTs, uint32_t upVotes,
+        uint32_t downVotes, uint32_t comments )
+{
+	PostedRankingRecord r;
+	r.mMsgId = msgId;
+	r.mPublishTs = publishTs;
+	r.mUpVotes = upVotes;
+	r.mDownVotes = downVotes;
+	r.mComments = comments;
+	return r;
+}
+
+TEST(libretroshare_services, PostedRankingIndex)
+{
+	remove(RANKING_DB_NAME);
+
+	const rstime_t now = 1000000;
+	RsGxsGroupId boardId = RsGxsGroupId::random();
+
+	RsGxsMessageId oldPopular = RsGxsMessageId::random();
+	RsGxsMessageId recent = RsGxsMessageId::random();
+	RsGxsMessageId downVoted = RsGxsMessageId::random();
+
+	{
+		PostedRankingIndex index(RANKING_DB_NAME, "");
+		ASSERT_TRUE(index.isOpen());
+		EXPECT_FALSE(index.isIndexed(boardId));
+
+		std::vector<PostedRankingRecord> records;
+		records.push_back(record(oldPopular, now - 7*86400, 50, 2, 10));
+		records.push_back(record(recent, now - 3600, 5, 0, 1));
+		EXPECT_TRUE(index.buildIndex(boardId, records));
+		EXPECT_TRUE(index.isIndexed(boardId));
+
+		EXPECT_TRUE(index.updatePost(boardId, record(downVoted, now - 60, 0, 3, 0)));
+		EXPECT_FALSE(index.updatePost(boardId, record(recent, now - 3600, 5, 0, 1)));
+		EXPECT_EQ(index.postsCount(boardId), 3u);
+	}
+
+	// the index lives in the database, nothing has to be saved on exit
+	PostedRankingIndex index(RANKING_DB_NAME, "");
+	ASSERT_TRUE(index.isOpen());
+	EXPECT_TRUE(index.isIndexed(boardId));
+	EXPECT_EQ(index.postsCount(boardId), 3u);
+
+	std::vector<RsGxsMessageId> ids;
+	EXPECT_TRUE(index.getRanked(boardId, RsPosted::NewRankType, now, 0, 10, ids));
+	ASSERT_EQ(ids.size(), 3u);
+	EXPECT_EQ(ids[0], downVoted);
+	EXPECT_EQ(ids[1], recent);
+	EXPECT_EQ(ids[2], oldPopular);
+
+	EXPECT_TRUE(index.getRanked(boardId, RsPosted::TopRankType, now, 0, 2, ids));
+	ASSERT_EQ(ids.size(), 2u);
+	EXPECT_EQ(ids[0], oldPopular);
+	EXPECT_EQ(ids[1], recent);
+
+	// A week old post decayed below a fresh one with fewer votes
+	EXPECT_TRUE(index.getRanked(boardId, RsPosted::HotRankType, now, 0, 10, ids));
+	ASSERT_EQ(ids.size(), 3u);
+	EXPECT_EQ(ids[0], recent);
+	EXPECT_EQ(ids[1], oldPopular);
+	EXPECT_EQ(ids[2], downVoted);
+
+	// Votes update the cached hot ranking without waiting for the refresh
+	EXPECT_TRUE(index.updatePost(boardId, record(downVoted, now - 60, 40, 3, 0)));
+	EXPECT_TRUE(index.getRanked(boardId, RsPosted::HotRankType, now, 0, 1, ids));
+	ASSERT_EQ(ids.size(), 1u);
+	EXPECT_EQ(ids[0], downVoted);
+
+	EXPECT_TRUE(index.getRanked(boardId, RsPosted::TopRankType, now, 3, 10, ids));
+	EXPECT_TRUE(ids.empty());
+
+	EXPECT_TRUE(index.getRanked(boardId, RsPosted::TopRankType, now, 1, 10, ids));
+	ASSERT_EQ(ids.size(), 2u);
+	EXPECT_EQ(ids[0], downVoted);
+	EXPECT_EQ(ids[1], recent);
+
+	EXPECT_TRUE(index.removePost(boardId, oldPopular));
+	EXPECT_FALSE(index.removePost(boardId, oldPopular));
+	EXPECT_TRUE(index.getRanked(boardId, RsPosted::HotRankType, now, 0, 10, ids));
+	ASSERT_EQ(ids.size(), 2u);
+	EXPECT_EQ(ids[0], downVoted);
+
+	// Other boards are not affected
+	RsGxsGroupId otherBoardId = RsGxsGroupId::random();
+	EXPECT_FALSE(index.isIndexed(otherBoardId));
+	EXPECT_TRUE(index.getRanked(otherBoardId, RsPosted::NewRankType, now, 0, 10, ids));
+	EXPECT_TRUE(ids.empty());
+
+	EXPECT_TRUE(index.removeBoard(boardId));
+	EXPECT_FALSE(index.isIndexed(boardId));
+	EXPECT_EQ(index.postsCount(boardId), 0u);
+
+	remove(RANKING_DB_NAME);
+}
@@ -0,0 +1,220 @@
+/*******************************************************************************
+ * unittests/libretroshare/services/msg/msgmailboxstore_test.cc                *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <memory>
+
+// from libretroshare
+#include "services/msgmailboxstore.h"
+
+#define MAILBOX_DB_NAME "msgmailbox_test_db"
+
+static RsMsgItem* createMsg(uint32_t msgId, uint32_t flags, uint32_t sendTime)
+{
+	RsMsgItem* msg = new RsMsgItem();
+	msg->msgId = msgId;
+	msg->msgFlags = flags;
+	msg->sendTime = sendTime;
+	msg->recvTime = sendTime + 1;
+	msg->subject = "subject " + std::to_string(msgId);
+	msg->message = std::string(1000, 'a' + msgId % 26);
+	msg->PeerId(RsPeerId::random());
+	msg->rspeerid_msgto.ids.insert(RsPeerId::random());
+	msg->attachment.items.push_back(RsTlvFileItem());
+	return msg;
+}
+
+TEST(libretroshare_services, MsgMailboxStore)
+{
+	remove(MAILBOX_DB_NAME);
+
+	{
+		MsgMailboxStore store(MAILBOX_DB_NAME, "");
+		ASSERT_TRUE(store.isOpen());
+		EXPECT_EQ(store.getMaxMsgId(), 0u);
+
+		std::list<RsMsgItem*> msgs;
+		for(uint32_t i = 1; i <= 20; ++i)
+			msgs.push_back(createMsg(i, i % 2 ? RS_MSG_FLAGS_NEW : 0, 1000 + i));
+		msgs.push_back(createMsg( 21, RS_MSG_FLAGS_OUTGOING |
+		                          RS_MSG_FLAGS_PENDING, 2000 ));
+
+		std::map<uint32_t, RsPeerId> srcIds;
+		RsPeerId src = RsPeerId::random();
+		srcIds[3] = src;
+		std::map<uint32_t, uint32_t> parentIds;
+		parentIds[4] = 2;
+		std::map<uint32_t, std::list<uint32_t> > tags;
+		tags[5].push_back(1);
+		tags[5].push_back(3);
+		tags[6].push_back(3);
+
+		EXPECT_TRUE(store.importMessages(msgs, srcIds, parentIds, tags));
+		EXPECT_EQ(store.getMaxMsgId(), 21u);
+
+		// lazy body loading
+		RsPeerId loadedSrc;
+		std::unique_ptr<RsMsgItem> loaded(store.loadMessage(3, loadedSrc));
+		ASSERT_TRUE(loaded != nullptr);
+		EXPECT_EQ(loadedSrc, src);
+		RsMsgItem* orig = *std::next(msgs.begin(), 2);
+		EXPECT_EQ(loaded->message, orig->message);
+		EXPECT_EQ(loaded->subject, orig->subject);
+		EXPECT_EQ(loaded->PeerId(), orig->PeerId());
+		EXPECT_EQ(loaded->rspeerid_msgto.ids, orig->rspeerid_msgto.ids);
+		EXPECT_TRUE(store.loadMessage(99, loadedSrc) == nullptr);
+
+		uint32_t parentId = 0;
+		EXPECT_TRUE(store.getParentId(4, parentId));
+		EXPECT_EQ(parentId, 2u);
+		EXPECT_FALSE(store.getParentId(5, parentId));
+
+		// paginated headers, newest first
+		std::list<MsgMailboxHeader> headers;
+		uint32_t total = 0;
+		EXPECT_TRUE(store.getHeaders(RS_MSG_INBOX, 0, 5, 5, headers, total));
+		EXPECT_EQ(total, 20u);
+		ASSERT_EQ(headers.size(), 5u);
+		EXPECT_EQ(headers.front().mMsgId, 15u);
+		EXPECT_EQ(headers.back().mMsgId, 11u);
+		EXPECT_EQ(headers.front().mAttachmentsCount, 1u);
+
+		headers.clear();
+		EXPECT_TRUE(store.getHeaders(RS_MSG_ALLBOXES, 3, 0, 0, headers, total));
+		EXPECT_EQ(total, 2u);
+		ASSERT_EQ(headers.size(), 2u);
+		EXPECT_EQ(headers.front().mMsgId, 6u);
+		EXPECT_EQ(headers.back().mTagIds, std::list<uint32_t>({1, 3}));
+
+		uint32_t nInbox, nInboxNew, nOutbox, nDraftbox, nSentbox, nTrashbox;
+		EXPECT_TRUE(store.getBoxCounts( nInbox, nInboxNew, nOutbox, nDraftbox,
+		                                nSentbox, nTrashbox ));
+		EXPECT_EQ(nInbox, 20u);
+		EXPECT_EQ(nInboxNew, 10u);
+		EXPECT_EQ(nOutbox, 1u);
+		EXPECT_EQ(nTrashbox, 0u);
+
+		// flags change moves messages between boxes
+		EXPECT_TRUE(store.setFlags(7, RS_MSG_FLAGS_TRASH | RS_MSG_FLAGS_NEW));
+		headers.clear();
+		EXPECT_TRUE(store.getHeaders(RS_MSG_TRASH, 0, 0, 0, headers, total));
+		ASSERT_EQ(headers.size(), 1u);
+		EXPECT_EQ(headers.front().mMsgId, 7u);
+
+		// replacing keeps tags and parent
+		std::unique_ptr<RsMsgItem> draft(createMsg(4, RS_MSG_FLAGS_OUTGOING |
+		                                           RS_MSG_FLAGS_DRAFT, 3000));
+		EXPECT_TRUE(store.addTag(4, 2));
+		EXPECT_TRUE(store.storeMessage(*draft));
+		EXPECT_TRUE(store.getParentId(4, parentId));
+		std::list<uint32_t> tagIds;
+		EXPECT_TRUE(store.getTags(4, tagIds));
+		EXPECT_EQ(tagIds, std::list<uint32_t>({2}));
+
+		EXPECT_TRUE(store.removeTagType(3));
+		tagIds.clear();
+		EXPECT_TRUE(store.getTags(5, tagIds));
+		EXPECT_EQ(tagIds, std::list<uint32_t>({1}));
+
+		EXPECT_TRUE(store.removeMessage(5));
+		EXPECT_FALSE(store.removeMessage(5));
+		tagIds.clear();
+		EXPECT_TRUE(store.getTags(5, tagIds));
+		EXPECT_TRUE(tagIds.empty());
+
+		for(RsMsgItem* msg : msgs) delete msg;
+	}
+
+	// everything survives reopening the database
+	{
+		MsgMailboxStore store(MAILBOX_DB_NAME, "");
+		ASSERT_TRUE(store.isOpen());
+
+		std::list<RsMsgItem*> pending;
+		EXPECT_TRUE(store.loadMessages( RS_MSG_FLAGS_PENDING,
+		                                RS_MSG_FLAGS_PENDING, pending ));
+		ASSERT_EQ(pending.size(), 1u);
+		EXPECT_EQ(pending.front()->msgId, 21u);
+		delete pending.front();
+
+		uint32_t nInbox, nInboxNew, nOutbox, nDraftbox, nSentbox, nTrashbox;
+		EXPECT_TRUE(store.getBoxCounts( nInbox, nInboxNew, nOutbox, nDraftbox,
+		                                nSentbox, nTrashbox ));
+		EXPECT_EQ(nInbox, 17u);
+		EXPECT_EQ(nDraftbox, 1u);
+		EXPECT_EQ(nTrashbox, 1u);
+	}
+
+	remove(MAILBOX_DB_NAME);
+}
+
+TEST(libretroshare_services, MsgMailboxStore_UnsignedIds)
+{
+	remove(MAILBOX_DB_NAME);
+
+	{
+		MsgMailboxStore store(MAILBOX_DB_NAME, "");
+		ASSERT_TRUE(store.isOpen());
+
+		// ids above INT32_MAX must keep their value and order
+		const uint32_t bigId = 0xfffffff0u;
+		std::unique_ptr<RsMsgItem> small(createMsg(10, 0, 1000));
+		std::unique_ptr<RsMsgItem> big(createMsg(bigId, 0, 1000));
+		EXPECT_TRUE(store.storeMessage(*small));
+		EXPECT_TRUE(store.storeMessage(*big));
+		EXPECT_EQ(store.getMaxMsgId(), bigId);
+
+		EXPECT_TRUE(store.setParentId(10, bigId + 1));
+		uint32_t parentId = 0;
+		EXPECT_TRUE(store.getParentId(10, parentId));
+		EXPECT_EQ(parentId, bigId + 1);
+
+		EXPECT_TRUE(store.addTag(bigId, 0x80000001u));
+		std::list<uint32_t> tagIds;
+		EXPECT_TRUE(store.getTags(bigId, tagIds));
+		EXPECT_EQ(tagIds, std::list<uint32_t>({0x80000001u}));
+
+		std::list<MsgMailboxHeader> headers;
+		uint32_t total = 0;
+		EXPECT_TRUE(store.getHeaders(RS_MSG_INBOX, 0, 0, 1, headers, total));
+		EXPECT_EQ(total, 2u);
+		ASSERT_EQ(headers.size(), 1u);
+		EXPECT_EQ(headers.front().mMsgId, bigId);
+		EXPECT_EQ(headers.front().mTagIds, tagIds);
+
+		headers.clear();
+		EXPECT_TRUE(store.getHeaders(RS_MSG_INBOX, 0, 1, 0, headers, total));
+		ASSERT_EQ(headers.size(), 1u);
+		EXPECT_EQ(headers.front().mMsgId, 10u);
+
+		RsPeerId srcId;
+		std::unique_ptr<RsMsgItem> loaded(store.loadMessage(bigId, srcId));
+		ASSERT_TRUE(loaded != nullptr);
+		EXPECT_EQ(loaded->msgId, bigId);
+
+		// setting the parent of a missing message fails
+		EXPECT_FALSE(store.setParentId(11, 10));
+		EXPECT_TRUE(store.removeMessage(bigId));
+		EXPECT_EQ(store.getMaxMsgId(), 10u);
+	}
+
+	remove(MAILBOX_DB_NAME);
+}
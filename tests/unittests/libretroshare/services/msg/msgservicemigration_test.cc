@@ -0,0 +1,130 @@
+/*******************************************************************************
+ * unittests/libretroshare/services/msg/msgservicemigration_test.cc            *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+// from libretroshare
+#include "services/p3msgservice.h"
+#include "services/p3idservice.h"
+#include "gxstrans/p3gxstrans.h"
+#include "gxs/rsdataservice.h"
+#include "rsitems/rsmsgitems.h"
+#include "util/retrodb.h"
+#include "util/rsdir.h"
+
+// from unittests
+#include "libretroshare/services/gxs/FakePgpAuxUtils.h"
+
+#define MIGRATION_TEST_DIR "msgservicemigration_test"
+#define MIGRATION_MAILBOX_DB MIGRATION_TEST_DIR "/msg_mailbox_db"
+
+static RsMsgItem* createMsg(uint32_t msgId, uint32_t flags)
+{
+	RsMsgItem* msg = new RsMsgItem();
+	msg->msgId = msgId;
+	msg->msgFlags = flags;
+	msg->sendTime = 1000 + msgId;
+	msg->recvTime = 1001 + msgId;
+	msg->subject = "subject " + std::to_string(msgId);
+	msg->message = "message " + std::to_string(msgId);
+	msg->rspeerid_msgto.ids.insert(RsPeerId::random());
+	return msg;
+}
+
+static std::set<std::string> listedIds(p3MsgService& msgService)
+{
+	std::set<std::string> ids;
+	std::list<Rs::Msgs::MsgInfoSummary> msgList;
+	if(msgService.getMessageSummaries(msgList))
+		for(auto it(msgList.begin()); it != msgList.end(); ++it)
+			ids.insert(it->msgId);
+	return ids;
+}
+
+static uint32_t savedMsgCount(p3MsgService& msgService)
+{
+	bool cleanup;
+	std::list<RsItem*> saved;
+	msgService.saveList(cleanup, saved);
+	msgService.saveDone();
+
+	uint32_t count = 0;
+	for(auto it(saved.begin()); it != saved.end(); ++it)
+	{
+		if(dynamic_cast<RsMsgItem*>(*it)) ++count;
+		delete *it;
+	}
+	return count;
+}
+
+TEST(libretroshare_services, MsgServiceMigrationRetry)
+{
+	RsDirUtil::checkCreateDirectory(MIGRATION_TEST_DIR);
+	RsDirUtil::cleanupDirectory(MIGRATION_TEST_DIR, std::set<std::string>());
+
+	FakePgpAuxUtils pgpUtils(RsPeerId::random());
+	p3IdService idService( new RsDataService( MIGRATION_TEST_DIR, "gxsid_db",
+	                                          RS_SERVICE_GXS_TYPE_GXSID, NULL, "" ),
+	                       NULL, &pgpUtils );
+	p3GxsTrans gxsTrans( new RsDataService( MIGRATION_TEST_DIR, "gxstrans_db",
+	                                        RS_SERVICE_TYPE_GXS_TRANS, NULL, "" ),
+	                     NULL, idService );
+	p3MsgService msgService(NULL, &idService, gxsTrans, MIGRATION_MAILBOX_DB, "");
+
+	// Another connection holding the database makes the migration fail
+	RetroDb lockDb(MIGRATION_MAILBOX_DB, RetroDb::OPEN_READWRITE, "");
+	ASSERT_TRUE(lockDb.isOpen());
+	ASSERT_TRUE(lockDb.execSQL("BEGIN EXCLUSIVE;"));
+
+	std::list<RsItem*> load;
+	load.push_back(createMsg(1, RS_MSG_FLAGS_NEW));
+	load.push_back(createMsg(2, RS_MSG_FLAGS_OUTGOING | RS_MSG_FLAGS_PENDING));
+	RsMsgParentId* parentId = new RsMsgParentId();
+	parentId->msgId = 2;
+	parentId->msgParentId = 1;
+	load.push_back(parentId);
+
+	EXPECT_TRUE(msgService.loadList(load));
+	EXPECT_FALSE(msgService.migrateLegacyItems());
+
+	// The messages are saved back to config meanwhile, so they are not lost
+	EXPECT_EQ(savedMsgCount(msgService), 2u);
+
+	// Once the database is available again the retry moves them there
+	ASSERT_TRUE(lockDb.execSQL("COMMIT;"));
+	EXPECT_TRUE(msgService.migrateLegacyItems());
+
+	std::set<std::string> ids = listedIds(msgService);
+	EXPECT_EQ(ids.size(), 2u);
+	EXPECT_EQ(ids.count("1"), 1u);
+	EXPECT_EQ(ids.count("2"), 1u);
+
+	Rs::Msgs::MessageInfo info;
+	ASSERT_TRUE(msgService.getMessage("2", info));
+	EXPECT_EQ(info.title, "subject 2");
+	EXPECT_TRUE(info.msgflags & RS_MSG_PENDING);
+
+	std::string parent;
+	EXPECT_TRUE(msgService.getMsgParentId("2", parent));
+	EXPECT_EQ(parent, "1");
+
+	EXPECT_EQ(savedMsgCount(msgService), 0u);
+	EXPECT_TRUE(msgService.migrateLegacyItems());
+}
@@ -0,0 +1,218 @@
+/*******************************************************************************
+ * unittests/libretroshare/turtle/turtlehashfilter_test.cc                     *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <time.h>
+
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "turtle/turtlehashfilter.h"
+#include "util/rsthreads.h"
+
+static double now_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static std::vector<TurtleFileHash> randomHashes(uint32_t n)
+{
+	std::vector<TurtleFileHash> hashes;
+	hashes.reserve(n);
+
+	for (uint32_t i = 0; i < n; ++i) {
+		hashes.push_back(TurtleFileHash::random());
+	}
+	return hashes;
+}
+
+/* Stands for the lookups ftServer::handleTunnelRequest() does for a hash it
+ * does not have: local files (real and encrypted hashes), extra files,
+ * encrypted hashes of downloads and downloads, each behind its own mutex. */
+class FakeFileServer
+{
+public:
+	FakeFileServer()
+	    : mDbMtx("db"), mExtraMtx("extra"), mSrvMtx("srv"), mCtrlMtx("ctrl") {}
+
+	void addLocalFile(const TurtleFileHash& hash) { mLocalFiles[hash] = 1; }
+
+	bool handleTunnelRequest(const TurtleFileHash& hash)
+	{
+		{
+			RS_STACK_MUTEX(mDbMtx);
+			if (mEncryptedHashes.find(hash) != mEncryptedHashes.end() || mLocalFiles.find(hash) != mLocalFiles.end()) {
+				return true;
+			}
+		}
+		{
+			RS_STACK_MUTEX(mExtraMtx);
+			if (mExtraFiles.find(hash) != mExtraFiles.end() || mExtraHashOfHash.find(hash) != mExtraHashOfHash.end()) {
+				return true;
+			}
+		}
+		TurtleFileHash real_hash = hash;
+		{
+			RS_STACK_MUTEX(mSrvMtx);
+			std::map<TurtleFileHash, TurtleFileHash>::const_iterator it = mEncryptedDownloads.find(hash);
+			if (it != mEncryptedDownloads.end()) {
+				real_hash = it->second;
+			}
+		}
+		RS_STACK_MUTEX(mCtrlMtx);
+		return mDownloads.find(real_hash) != mDownloads.end();
+	}
+
+private:
+	RsMutex mDbMtx, mExtraMtx, mSrvMtx, mCtrlMtx;
+	std::map<TurtleFileHash, TurtleFileHash> mEncryptedHashes, mExtraHashOfHash, mEncryptedDownloads;
+	std::map<TurtleFileHash, int> mLocalFiles, mExtraFiles, mDownloads;
+};
+
+TEST(TurtleHashFilterTest, PassesEverythingUntilBuilt)
+{
+	TurtleHashFilter filter;
+	std::vector<TurtleFileHash> hashes = randomHashes(100);
+
+	filter.add(hashes[0]);
+
+	EXPECT_FALSE(filter.isBuilt());
+	for (uint32_t i = 0; i < hashes.size(); ++i) {
+		EXPECT_TRUE(filter.mayContain(hashes[i]));
+	}
+}
+
+TEST(TurtleHashFilterTest, NoFalseNegatives)
+{
+	TurtleHashFilter filter;
+	std::vector<TurtleFileHash> hashes = randomHashes(20000);
+	std::vector<TurtleFileHash> others = randomHashes(100000);
+
+	filter.beginRebuild();
+	filter.finishRebuild(std::vector<TurtleFileHash>(hashes.begin(), hashes.begin() + 10000));
+
+	for (uint32_t i = 10000; i < hashes.size(); ++i) {
+		filter.add(hashes[i]);
+	}
+
+	ASSERT_TRUE(filter.isBuilt());
+	for (uint32_t i = 0; i < hashes.size(); ++i) {
+		ASSERT_TRUE(filter.mayContain(hashes[i]));
+	}
+
+	uint32_t false_positives = 0;
+	for (uint32_t i = 0; i < others.size(); ++i) {
+		if (filter.mayContain(others[i])) {
+			++false_positives;
+		}
+	}
+
+	// 20000 hashes in a filter sized for 15000: a bit above the 1% it is designed for
+	EXPECT_LT(false_positives, others.size() * 4 / 100);
+	EXPECT_TRUE(filter.isOverloaded());
+}
+
+TEST(TurtleHashFilterTest, RebuildKeepsConcurrentAdditionsAndForgetsRemovedHashes)
+{
+	TurtleHashFilter filter;
+	std::vector<TurtleFileHash> old_hashes = randomHashes(5000);
+	std::vector<TurtleFileHash> new_hashes = randomHashes(5000);
+
+	filter.beginRebuild();
+	filter.finishRebuild(old_hashes);
+
+	// while the owner collects the current hashes, a component adds a new one
+	filter.beginRebuild();
+	filter.add(new_hashes[0]);
+	EXPECT_TRUE(filter.mayContain(new_hashes[0]));
+	filter.finishRebuild(std::vector<TurtleFileHash>(new_hashes.begin() + 1, new_hashes.end()));
+
+	for (uint32_t i = 0; i < new_hashes.size(); ++i) {
+		ASSERT_TRUE(filter.mayContain(new_hashes[i]));
+	}
+
+	uint32_t remaining = 0;
+	for (uint32_t i = 0; i < old_hashes.size(); ++i) {
+		if (filter.mayContain(old_hashes[i])) {
+			++remaining;
+		}
+	}
+	EXPECT_LT(remaining, old_hashes.size() * 2 / 100);
+	EXPECT_FALSE(filter.isOverloaded());
+}
+
+TEST(TurtleHashFilterTest, TunnelRequestThroughputBenchmark)
+{
+	const uint32_t n_files = 200000;
+	const uint32_t n_requests = 2000000;
+	const uint32_t hit_every = 100;		// 1% of the requests are for a hash we have
+
+	FakeFileServer server;
+	TurtleHashFilter filter;
+
+	std::vector<TurtleFileHash> files = randomHashes(n_files);
+	std::vector<TurtleFileHash> unknown = randomHashes(n_files);
+
+	for (uint32_t i = 0; i < files.size(); ++i) {
+		server.addLocalFile(files[i]);
+	}
+
+	filter.beginRebuild();
+	filter.finishRebuild(files);
+
+	std::vector<TurtleFileHash> requests;
+	requests.reserve(n_requests);
+	for (uint32_t i = 0; i < n_requests; ++i) {
+		requests.push_back((i % hit_every) ? unknown[(i * 7919) % n_files] : files[(i * 104729) % n_files]);
+	}
+
+	uint32_t found_plain = 0;
+	double start = now_us();
+	for (uint32_t i = 0; i < n_requests; ++i) {
+		if (server.handleTunnelRequest(requests[i])) {
+			++found_plain;
+		}
+	}
+	double plain_time = now_us() - start;
+
+	uint32_t found_filtered = 0, filtered = 0;
+	start = now_us();
+	for (uint32_t i = 0; i < n_requests; ++i) {
+		if (!filter.mayContain(requests[i])) {
+			++filtered;
+		} else if (server.handleTunnelRequest(requests[i])) {
+			++found_filtered;
+		}
+	}
+	double filtered_time = now_us() - start;
+
+	std::cerr << n_files << " files, " << n_requests << " tunnel requests: " << n_requests / plain_time << " M requests/s without filter, "
+	          << n_requests / filtered_time << " M requests/s with filter (" << 100.0 * filtered / n_requests << "% filtered, "
+	          << filter.memoryUsage() / 1024 << " KB)" << std::endl;
+
+	EXPECT_EQ(n_requests / hit_every, found_plain);
+	EXPECT_EQ(found_plain, found_filtered);
+	EXPECT_GT(filtered, n_requests * 97 / 100);
+	EXPECT_LT(filtered_time, plain_time);
+}
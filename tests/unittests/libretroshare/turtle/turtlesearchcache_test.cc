@@ -0,0 +1,224 @@
+/*******************************************************************************
+ * unittests/libretroshare/turtle/turtlesearchcache_test.cc                    *
+ *                                                                             *
+ * Copyright (C) 2019  Retroshare Team <retroshare.project@gmail.com>          *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+
+// from librssimulator
+#include "retroshare/rspeers.h"
+#include "peer/FakeLinkMgr.h"
+#include "peer/FakeServiceControl.h"
+
+// from libretroshare
+#include "turtle/p3turtle.h"
+#include "turtle/rsturtleitem.h"
+
+/* String search answering one file named after the query instead of searching
+ * the shared files. It counts its calls, can be held in the worker until the
+ * test releases it, and counts its live instances to detect leaked clones. */
+class TestSearchItem : public RsTurtleStringSearchRequestItem
+{
+public:
+	TestSearchItem() { ++sLive; }
+	TestSearchItem(const TestSearchItem& item) :
+	    RsTurtleStringSearchRequestItem(item) { ++sLive; }
+	virtual ~TestSearchItem() { --sLive; }
+
+	virtual RsTurtleSearchRequestItem* clone() const
+	{ return new TestSearchItem(*this); }
+
+	virtual void search(std::list<TurtleFileInfo>& result) const
+	{
+		std::unique_lock<std::mutex> lock(sMtx);
+		++sSearches;
+		sCondition.wait(lock, []() { return !sHold; });
+
+		TurtleFileInfo info;
+		info.hash = RsFileHash::random();
+		info.name = match_string;
+		info.size = 1;
+		result.push_back(info);
+	}
+
+	static void hold(bool h)
+	{
+		{
+			std::lock_guard<std::mutex> lock(sMtx);
+			sHold = h;
+		}
+		sCondition.notify_all();
+	}
+
+	static int searches()
+	{
+		std::lock_guard<std::mutex> lock(sMtx);
+		return sSearches;
+	}
+
+	static int sLive;
+
+private:
+	static std::mutex sMtx;
+	static std::condition_variable sCondition;
+	static bool sHold;
+	static int sSearches;
+};
+
+int TestSearchItem::sLive = 0;
+std::mutex TestSearchItem::sMtx;
+std::condition_variable TestSearchItem::sCondition;
+bool TestSearchItem::sHold = false;
+int TestSearchItem::sSearches = 0;
+
+/* Keeps the items the turtle router sends, so that the test can check who got
+ * answers and forwarded requests. */
+class CaptureServiceServer : public p3ServiceServerIface
+{
+public:
+	CaptureServiceServer() : mMtx("CaptureServiceServer") {}
+	virtual ~CaptureServiceServer() { clear(); }
+
+	virtual bool recvItem(RsRawItem* item) { delete item; return true; }
+	virtual bool sendItem(RsRawItem* item)
+	{
+		RS_STACK_MUTEX(mMtx);
+		mItems.push_back(item);
+		return true;
+	}
+	virtual bool getServiceItemNames(uint32_t, std::map<uint8_t,std::string>&)
+	{ return false; }
+
+	int count(uint8_t subtype, const RsPeerId& peer)
+	{
+		RS_STACK_MUTEX(mMtx);
+		int n = 0;
+		for(RsRawItem* item : mItems)
+			if(item->PacketSubType() == subtype && item->PeerId() == peer) ++n;
+		return n;
+	}
+
+	int count()
+	{
+		RS_STACK_MUTEX(mMtx);
+		return mItems.size();
+	}
+
+	void clear()
+	{
+		RS_STACK_MUTEX(mMtx);
+		for(RsRawItem* item : mItems) delete item;
+		mItems.clear();
+	}
+
+private:
+	RsMutex mMtx;
+	std::list<RsRawItem*> mItems;
+};
+
+static TestSearchItem* searchItem( const RsPeerId& from, uint32_t requestId,
+                                   const std::string& query )
+{
+	TestSearchItem* item = new TestSearchItem();
+	item->PeerId(from);
+	item->request_id = requestId;
+	item->depth = 1;
+	item->match_string = query;
+	return item;
+}
+
+static bool tickUntil(p3turtle& turtle, const std::function<bool()>& done)
+{
+	for(int i = 0; i < 500; ++i)
+	{
+		turtle.tick();
+		if(done()) return true;
+		usleep(10000);
+	}
+	return false;
+}
+
+TEST(libretroshare_turtle, LocalSearchCache)
+{
+	RsPeerId ownId = RsPeerId::random();
+	RsPeerId peerA = RsPeerId::random();
+	RsPeerId peerB = RsPeerId::random();
+	RsPeerId peerC = RsPeerId::random();
+
+	FakeLinkMgr linkMgr(ownId, { peerA, peerB, peerC }, true);
+	FakeServiceControl serviceControl(&linkMgr);
+	CaptureServiceServer server;
+
+	{
+		p3turtle turtle(&serviceControl, &linkMgr);
+		turtle.setServiceServer(&server);
+
+		// Queries differing only by case wait for one running search, and are
+		// neither answered nor forwarded before it completes.
+		TestSearchItem::hold(true);
+		turtle.recvItem(searchItem(peerA, 1, "Some File"));
+		turtle.recvItem(searchItem(peerB, 2, "some FILE"));
+
+		EXPECT_TRUE(tickUntil(turtle, []() { return TestSearchItem::searches() == 1; }));
+		turtle.tick();
+		EXPECT_EQ(TestSearchItem::searches(), 1);
+		EXPECT_EQ(server.count(), 0);
+
+		TestSearchItem::hold(false);
+		EXPECT_TRUE(tickUntil(turtle, [&]() {
+			return server.count(RS_TURTLE_SUBTYPE_FT_SEARCH_RESULT, peerA) == 1
+			        && server.count(RS_TURTLE_SUBTYPE_FT_SEARCH_RESULT, peerB) == 1; }));
+		EXPECT_EQ(TestSearchItem::searches(), 1);
+
+		// Once answered, each request is forwarded to the other online peers.
+		EXPECT_EQ(server.count(RS_TURTLE_SUBTYPE_STRING_SEARCH_REQUEST, peerA), 1);
+		EXPECT_EQ(server.count(RS_TURTLE_SUBTYPE_STRING_SEARCH_REQUEST, peerB), 1);
+		EXPECT_EQ(server.count(RS_TURTLE_SUBTYPE_STRING_SEARCH_REQUEST, peerC), 2);
+
+		// The same query is answered from the cache right away, a different
+		// one runs a new search.
+		server.clear();
+		turtle.recvItem(searchItem(peerC, 3, "SOME file"));
+		turtle.tick();
+		EXPECT_EQ(TestSearchItem::searches(), 1);
+		EXPECT_EQ(server.count(RS_TURTLE_SUBTYPE_FT_SEARCH_RESULT, peerC), 1);
+		EXPECT_EQ(server.count(RS_TURTLE_SUBTYPE_STRING_SEARCH_REQUEST, peerA), 1);
+		EXPECT_EQ(server.count(RS_TURTLE_SUBTYPE_STRING_SEARCH_REQUEST, peerB), 1);
+
+		turtle.recvItem(searchItem(peerA, 4, "other file"));
+		EXPECT_TRUE(tickUntil(turtle, [&]() {
+			return server.count(RS_TURTLE_SUBTYPE_FT_SEARCH_RESULT, peerA) == 1; }));
+		EXPECT_EQ(TestSearchItem::searches(), 2);
+
+		// A search still in the pool when the router is destroyed is waited
+		// for, and its request freed.
+		TestSearchItem::hold(true);
+		turtle.recvItem(searchItem(peerB, 5, "unanswered"));
+		EXPECT_TRUE(tickUntil(turtle, []() { return TestSearchItem::searches() == 3; }));
+		TestSearchItem::hold(false);
+	}
+
+	EXPECT_EQ(TestSearchItem::sLive, 0);
+}
@@ -292,7 +292,8 @@ SOURCES +=  unittests.cc \
 
 ################################## Crypto ##################################
 
-SOURCES += libretroshare/crypto/chacha20_test.cc
+SOURCES += libretroshare/crypto/chacha20_test.cc \
+	libretroshare/crypto/pgphandler_test.cc
 
 ################################ Serialiser ################################
 HEADERS +=  libretroshare/serialiser/support.h \
@@ -314,6 +315,7 @@ SOURCES +=  libretroshare/serialiser/rsturtleitem_test.cc \
 #		libretroshare/serialiser/rsgrouteritem_test.cc \
 		libretroshare/serialiser/tlvtypes_test.cc \
 		libretroshare/serialiser/tlvkey_test.cc \
+		libretroshare/serialiser/rsjsonstream_test.cc \
 		libretroshare/serialiser/support.cc \
 		libretroshare/serialiser/rstlvutil.cc \
 
@@ -344,7 +346,8 @@ SOURCES +=  libretroshare/gxs/nxs_test/nxsdummyservices.cc \
 	libretroshare/gxs/nxs_test/rsgxsnetservice_test.cc \
 	libretroshare/gxs/nxs_test/nxsmsgsync_test.cc \
 	libretroshare/gxs/nxs_test/nxsgrpsync_test.cc \ 
-	libretroshare/gxs/nxs_test/nxsgrpsyncdelayed.cc
+	libretroshare/gxs/nxs_test/nxsgrpsyncdelayed.cc \
+	libretroshare/gxs/nxs_test/nxsmsgreassembler_test.cc
 	
 HEADERS += libretroshare/gxs/gen_exchange/genexchangetester.h \
 	libretroshare/gxs/gen_exchange/gxspublishmsgtest.h \
@@ -362,6 +365,7 @@ SOURCES += libretroshare/gxs/gen_exchange/gxspublishgrouptest.cc \
 	libretroshare/gxs/gen_exchange/rsgenexchange_test.cc \
 	libretroshare/gxs/gen_exchange/genexchangetester.cc \
 	libretroshare/gxs/gen_exchange/genexchangetestservice.cc \
+	libretroshare/gxs/gen_exchange/gxstokenlatency_test.cc \
 
 SOURCES += libretroshare/gxs/security/gxssecurity_test.cc
 
@@ -371,6 +375,9 @@ HEADERS += libretroshare/gxs/data_service/rsdataservice_test.h \
 
 SOURCES += libretroshare/gxs/data_service/rsdataservice_test.cc \
 	libretroshare/gxs/data_service/rsgxsdata_test.cc \
+	libretroshare/gxs/data_service/rsdataservice_concurrency_test.cc \
+	libretroshare/gxs/data_service/rsdataservice_blobstore_test.cc \
+	libretroshare/gxs/data_service/rsdataservice_integrity_test.cc \
 
 
 ################################ dbase #####################################
@@ -383,10 +390,33 @@ SOURCES += libretroshare/gxs/data_service/rsdataservice_test.cc \
 #	libretroshare/dbase/ficachetest.cc \
 #	libretroshare/dbase/fimontest.cc \
 
+############################## file_sharing ################################
+
+SOURCES += libretroshare/file_sharing/dir_hierarchy_test.cc \
+
+################################### ft #####################################
+
+SOURCES += libretroshare/ft/chunkmap_scheduler_test.cc \
+
+################################# turtle ###################################
+
+SOURCES += libretroshare/turtle/turtlehashfilter_test.cc \
+	libretroshare/turtle/turtlesearchcache_test.cc \
+
+################################## pqi #####################################
+
+HEADERS += libretroshare/pqi/tls_support.h \
+
+SOURCES += libretroshare/pqi/tls_support.cc \
+	libretroshare/pqi/pqistreamer_coalescing_test.cc \
+	libretroshare/pqi/pqistreamer_readbuffer_test.cc \
+	libretroshare/pqi/sslsessioncache_test.cc \
 
 ############################### services ###################################
 
 SOURCES += libretroshare/services/status/status_test.cc \
+	libretroshare/services/msg/msgmailboxstore_test.cc \
+	libretroshare/services/msg/msgservicemigration_test.cc \
 
 ############################### gxs ########################################
 
@@ -408,6 +438,9 @@ SOURCES += libretroshare/services/gxs/rsgxstestitems.cc \
 	libretroshare/services/gxs/nxsbasic_test.cc \
 	libretroshare/services/gxs/nxspair_tests.cc \
 	libretroshare/services/gxs/gxscircle_tests.cc \
+	libretroshare/services/gxs/gxsforumthreadindex_test.cc \
+	libretroshare/services/gxs/postedrankingindex_test.cc \
+	libretroshare/services/gxs/gxsidpgphash_test.cc \
 
 #	libretroshare/services/gxs/gxscircle_mintest.cc \
 